@@ -1875,6 +1875,45 @@ int Asc_AnonMergeCmpInstances(CONST struct Instance *i1,
   return cmp;
 }
 
+/*
+ * Hashes what AnonMergeCmpMLists compares: the number of merged
+ * descendants, the number of paths to each, and the child numbers
+ * along each path.
+ */
+unsigned long Asc_AnonMergeHashInstance(CONST struct Instance *i)
+{
+  struct AnonMergeIP *amip;
+  CONST struct gl_list_t *aml;
+  struct gl_list_t *pathlist, *path;
+  unsigned long h, pl, len1, p, len2, c, len3;
+  int flags;
+  assert(i!=NULL);
+  flags = GetAnonFlags(i);
+  if (flags == (AMUFLAG | AMIPFLAG) || (flags & AMIPFLAG) == 0) {
+    return 0;
+  }
+  amip = (struct AnonMergeIP *)GetInterfacePtr(i);
+  if (amip == NULL || (aml = amip->amlist) == NULL) {
+    return 0;
+  }
+  len1 = gl_length(aml);
+  h = len1;
+  for (pl = 1; pl <= len1; pl++) {
+    pathlist = (struct gl_list_t *)gl_fetch(aml,pl);
+    len2 = gl_length(pathlist);
+    h = (h ^ len2) * 1000003UL;
+    for (p = 1; p <= len2; p++) {
+      path = (struct gl_list_t *)gl_fetch(pathlist,p);
+      len3 = gl_length(path);
+      h = (h ^ len3) * 1000003UL;
+      for (c = 1; c <= len3; c++) {
+        h = (h ^ (asc_intptr_t)gl_fetch(path,c)) * 1000003UL;
+      }
+    }
+  }
+  return h;
+}
+
 /*
  * frees data structures returned by AnonMergeMarkIPs.
  */
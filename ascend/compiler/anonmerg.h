@@ -199,6 +199,16 @@ extern VOIDPTR Asc_AnonMergeMarkIPs(struct Instance *root);
 extern int Asc_AnonMergeCmpInstances(CONST struct Instance *i1,
                                      CONST struct Instance *i2);
 
+/**
+ * <!--  unsigned long h = Asc_AnonMergeHashInstance(i);             -->
+ * <!--  CONST struct Instance *i;                                     -->
+ * Returns a hash code of the merge information stored in i, such
+ * that two instances that Asc_AnonMergeCmpInstances finds equal
+ * have the same code. Instances without merges, UNIVERSAL ones and
+ * those with no list of merges all return 0.
+ */
+extern unsigned long Asc_AnonMergeHashInstance(CONST struct Instance *i);
+
 /**
  * <!--  AnonMergeUnmarkIPs(vp)                                        -->
  * Frees data structure returned by AnonMergeMarkIPs.
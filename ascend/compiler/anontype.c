@@ -27,6 +27,7 @@
 */
 
 #include <limits.h> /* for LONG_MAX */
+#include <string.h> /* for memcpy */
 #include <ascend/general/platform.h>
 #include <ascend/general/ascMalloc.h>
 #include <ascend/general/panic.h>
@@ -46,6 +47,7 @@
 #include "instance_types.h"
 #include "tmpnum.h"
 #include "atomvalue.h"
+#include "setinstval.h"
 #include "mathinst.h"
 #include "parentchild.h"
 #include "instquery.h"
@@ -59,9 +61,7 @@
  * Yo! Pinhead! Don't optimize anything until it has proved slow!
  */
 
-/* These two macros are defined again in the portion of this file
- * dealing with MODEL/array classification. They should not be used
- * elsewhere.
+/* These two macros should not be used elsewhere.
  */
 #define GAIN(inst) GetInstanceAnonIndex(inst)
 #define GAP(atp) Asc_GetAnonPrototype(atp)
@@ -79,23 +79,12 @@
 # include <stdio.h>
 #endif
 
-
-/*
- * enum for use in sorting compound types
- */
-enum search_status {
-  at_notdone,	/* weirdness */
-  at_exact,	/* duplicate instance */
-  at_previous, /* insert */
-  at_append	/* new entry at list tail */
-};
-
 /*
  * Each bucket in the hash table will correspond to one formal type.
  * A doubly linked list of the formal type's anonymous refinements
- * is kept in the bucket. It's a linked list because we may have
- * lots of AT for constant or ATOM types, though usually there are
- * not many for MODEL types.
+ * is kept in the bucket, in the order they were found. The buckets
+ * are only needed to write the ATs out grouped by formal type;
+ * classification goes through the signature table below.
  *
  * We may need to add another field to accomodate anonymous, but
  * formal in the sense that the system maintains an internal type
@@ -105,6 +94,7 @@ struct AnonBucket {
   struct AnonBucket *next;	/* next hash element */
   struct TypeDescription *d;	/* type for this bucket. */
   struct AnonType *anonlist;	/* ptr to an AnonType */
+  struct AnonType *last;	/* last AT in anonlist */
   unsigned long indirected;	/* subscript number for arrays */
   int size;			/* length of anonlist, the number of
                                  * anonymous types based on formal type d.
@@ -116,11 +106,11 @@ struct AnonBucket {
  */
 struct AnonVisitInfo {
   struct AnonBucket **t;
+  struct AnonType **sigt;	/* ATs hashed by signature */
+  unsigned long sigsize;	/* buckets in sigt, a power of 2 */
   struct gl_list_t *atl;
   struct Instance *root;
   int errors;
-  int nextfamily;	/* counter for getting unique exactfamily numbers */
-  /* there is no direct sortability to nextfamily values */
 };
 
 static
@@ -242,38 +232,26 @@ struct AnonBucket *AddAnonBucket(struct TypeDescription *d,
   b->d = d;
   b->indirected = indirected;
   b->anonlist = NULL;
+  b->last = NULL;
   b->size = 0;
   return b;
 }
 
 /*
- * Insert 'at' in anonlist of b after the AT 'after'.
- * after == NULL --> insert at head of anonlist of b.
+ * Append 'at' to the anonlist of b.
  */
 static
-void InsertAnonType(struct AnonBucket *b, struct AnonType *at,
-                    struct AnonType *after)
+void AppendAnonType(struct AnonBucket *b, struct AnonType *at)
 {
   (b->size)++;
-  at->prev = after;
-  if (after == NULL) {
-    /* insert at head of anonlist */
-    at->next = b->anonlist;
-    if (b->anonlist != NULL) {
-      /* This check shouldn't be necessary, as b was created with 1st
-       * element of anonlist, yes? hmm.
-       */
-      b->anonlist->prev = at;
-    }
+  at->prev = b->last;
+  at->next = NULL;
+  if (b->last == NULL) {
     b->anonlist = at;
   } else {
-    at->next = after->next;
-    if (at->next != NULL) {
-      /* are we appending the bucket list? */
-      at->next->prev = at;
-    }
-    after->next = at;
+    b->last->next = at;
   }
+  b->last = at;
 }
 
 /* Create an AT and append to the user's ultimate result.
@@ -290,9 +268,9 @@ struct AnonType *ExpandAnonResult(struct gl_list_t *atl)
   }
   gl_append_ptr(atl,(void *)at);
   at->index = gl_length(atl);
-  at->next = at->prev = NULL;
+  at->next = at->prev = at->hnext = NULL;
+  at->signature = 0;
   at->visited = 0;
-  at->exactfamily = 0;
   at->instances = gl_create(INSTANCES_PER_AT);
   return at;
 }
@@ -331,142 +309,12 @@ double AnonRealAtomValue(struct Instance *i)
   }
 }
 
-/* In the following atom/constant cases it is simply cheaper to
- * check the value directly instead of checking first to see that
- * the FT defines value or dimensionality.
- * In all atom-like cases, we are ignoring subatomic structure,
- * since all subatomic values are variable and their existence
- * determined by the FT of the atom.
- * The lists are ordered so insertion/search are faster.
- *
- * Anon type -> FT, dimens, value, unassigned comes before values
- * in each dimensionally compatible subset of the list.
- * Can we just redo this entirely? That whole wild/unassigned
- * business make this thing just way too combinatorial.
- */
-static
-struct AnonType *NearestAnonTypeRC(struct Instance *i, struct AnonType *after,
-                                   int *exact)
-{
-  struct AnonType *testat;
-  CONST dim_type *dim;
-  struct Instance *testi = NULL; /* unnec init to avoid warning */
-  double val;
-
-  if (after==NULL) {
-    *exact = 0;
-    return after;
-  }
-  testat = after;
-  dim = RealAtomDims(i);
-  /* find same dimens. sorted by increasing dim address. */
-  while (testat != NULL &&
-         ((testi = GAP(testat)), dim > RealAtomDims(testi))) {
-    /* C comma syntax: testi = in the logic above does nothing to
-     * the logic, except make the second test possible.
-     */
-    after = testat;
-    testat = testat->next;
-  }
-  if (testat == after && dim != RealAtomDims(testi)) {
-    /* dimen to insert at head */
-    *exact = 0;
-    return NULL;
-  }
-  /* Now either testat == NULL, in which case done, or need to check
-   * value because dim(testi(testat)) == dim(i).
-   * We get rid of the NULL case so we can cope more easily with
-   * unassigned.
-   */
-  if (testat == NULL) {
-    /* off end */
-    *exact = 0;
-    return after;
-  }
-
-  val = AnonRealAtomValue(i);
-  /* Find same value. Sorted by decreasing value. */
-  while (testat != NULL &&
-         ((testi = GAP(testat)), dim == RealAtomDims(testi)) &&
-         val < AnonRealAtomValue(testi)) {
-    /* C comma syntax: testi = in the logic above does nothing to
-     * the logic, except make the second test possible.
-     */
-    after = testat;
-    testat = testat->next;
-  }
-  if (testat == NULL) {
-    /* off end */
-    *exact = 0;
-    return after;
-  }
-  if (val > AnonRealAtomValue(testi) ||
-      dim != RealAtomDims(testi)) {
-    /* insert at head or after */
-    *exact = 0;
-    if (testat != after) {
-      return after;
-    } else {
-      return NULL; /* insert @ head */
-    }
-  }
-  *exact = 1;
-  return testat;
-}
-
-/* Anon type -> FT, dimens, not subatomic dimens since they may be
- * reassignable eventually, as in lagrange multipliers.
- * In any case subatomic dimen cannot affect compiled structure.
- * So, the only sort criteria is really just DIMENSION ptr,
- * because we're all in the same FT type.
- */
-static
-struct AnonType *NearestAnonTypeRA(struct Instance *i,
-                                   struct AnonType *after,
-                                   int *exact)
-{
-  struct AnonType *testat;
-  CONST dim_type *dim;
-  struct Instance *testi = NULL;
-
-  if (after==NULL) {
-    *exact = 0;
-    return after;
-  }
-  dim = RealAtomDims(i);
-  /* check for add at front */
-  if (dim < RealAtomDims(GAP(after))) {
-    *exact = 0;
-    return NULL;
-  }
-  testat = after;
-  /* find same dimens. sorted by decreasing dim address. */
-  while (testat != NULL &&
-         ((testi = GAP(testat)), dim > RealAtomDims(testi))) {
-    /* C comma syntax: testi = in the logic above does nothing to
-     * the logic, except make the second test possible.
-     */
-    after = testat;
-    testat = testat->next;
-  }
-  /* ran off end of anonlist? */
-  if (testat == NULL) {
-    *exact = 0;
-    return after; /* Works if after NULL or not. */
-  }
-  if (dim == RealAtomDims(testi)) {
-    *exact = 1;
-    return testat;
-  } else {
-    *exact = 0;
-    return after; /* insert at head */
-  }
-}
-
 /*
  * cheating, we're just cheating.
  * the parser has been jiggered so that the max int
  * symbolically defined is machine LONG_MAX-1.
+ * As it is, unassigned and long_max are lumped together
+ * in the hope that no one ever uses long_max.
  */
 static
 long AnonIntegerAtomValue(CONST struct Instance *i)
@@ -478,59 +326,6 @@ long AnonIntegerAtomValue(CONST struct Instance *i)
   }
 }
 
-/* Anon type -> FT, value.
- * buggy: need to handle unassigned as a special case at
- * beginning of list.
- * as it is, unassigned and long_max are lumped together
- * in the hope that no one ever uses long_max.
- * The parser has been adjusted in evil ways to make this
- * less likely.
- */
-static
-struct AnonType *NearestAnonTypeIC(struct Instance *i,
-                                   struct AnonType *after,
-                                   int *exact)
-{
-  struct AnonType *testat;
-  CONST struct Instance *testi = NULL;
-  long val;
-
-  if (after==NULL) {
-    *exact = 0;
-    return after;
-  }
-  val = AnonIntegerAtomValue(i);
-  /* check for add at front */
-  if (val >AnonIntegerAtomValue(GAP(after))) {
-    *exact = 0;
-    return NULL;
-  }
-  /* Find same value. Sorted by decreasing integer value.  */
-  testat = after;
-  while (testat != NULL &&
-         ((testi = GAP(testat)), val < AnonIntegerAtomValue(testi))) {
-    /* C comma syntax: testi = in the logic above does nothing to
-     * the logic, except make the second test possible.
-     */
-    after = testat;
-    testat = testat->next;
-  }
-  /* ran off end of anonlist? */
-  if (testat == NULL) {
-    *exact = 0;
-    return after; /* Works if after NULL or not. */
-  }
-  if ( val == AnonIntegerAtomValue(testi) ) {
-    /* stopped within list on a match */
-    *exact = 1;
-    return testat;
-  } else {
-    /* stopped on insertion point */
-    *exact = 0;
-    return after;
-  }
-}
-
 /*
  * returns the symbol_atom value of i, or NULL if
  * i is not assigned. This wrapper keeps us from
@@ -546,267 +341,6 @@ symchar *GetAnonInstSymbol(CONST struct Instance *i)
   }
 }
 
-/* Anon type -> FT, value.
- * Unassigned constant detected merely by NULL symchar value,
- * so just sorting by ptr will handle unassigned.
- */
-static
-struct AnonType *NearestAnonTypeSC(struct Instance *i,
-                                   struct AnonType *after,
-                                   int *exact)
-{
-  struct AnonType *testat;
-  CONST struct Instance *testi = NULL;
-  symchar *val;
-
-  if (after==NULL) {
-    *exact = 0;
-    return after;
-  }
-  val = GetAnonInstSymbol(i);
-  /* check for add at front */
-  if (val < GetAnonInstSymbol(GAP(after))) {
-    *exact = 0;
-    return NULL;
-  }
-  /* Find same value. Sorted by increasing ptr value.
-   * alpha no matter, and both must be from symbol table.
-   */
-  testat = after;
-  while (testat != NULL &&
-         ((testi = GAP(testat)), val > GetAnonInstSymbol(testi))) {
-    /* C comma syntax: testi = in the logic above does nothing to
-     * the logic, except make the second test possible.
-     */
-    after = testat;
-    testat = testat->next;
-  }
-  /* ran off end of anonlist? */
-  if (testat == NULL) {
-    *exact = 0;
-    return after; /* Works if after NULL or not. */
-  }
-  if ( val == GetAnonInstSymbol(testi) ) {
-    /* stopped within list on a match */
-    *exact = 1;
-    return testat;
-  } else {
-    /* stopped on insertion point */
-    *exact = 0;
-    return after;
-  }
-}
-
-/* Anon type -> FT, value.
- */
-static
-struct AnonType *NearestAnonTypeBC(struct Instance *i,
-                                   struct AnonType *after,
-                                   int *exact)
-{
-  struct AnonType *testat;
-  CONST struct Instance *testi = NULL;
-  int val;
-
-  if (after == NULL) {
-    *exact = 0;
-    return after;
-  }
-  testat = after;
-  testi = GAP(testat);
-  /* sort order is UNDEFINED,T,F or UNDEFINED,F,T */
-  if (!AtomAssigned(i)) {
-    if (!AtomAssigned(testi)) {
-      *exact = 1; /* there already */
-      return after;
-    } else {
-      *exact = 0; /* add undefined at head */
-      return NULL;
-    }
-  } else {
-    /* i is not unassigned */
-    val = GetBooleanAtomValue(i);
-    if (!AtomAssigned(testi)) {
-      /* unassigned first list element */
-      if (testat->next == NULL) {
-        *exact = 0;     /* unassigned only */
-        return after;
-      } else {
-        testat = testat->next;  /* move to first assigned AT and value */
-        testi = GAP(testat);
-      } /* else T/F first */
-    }
-  }
-  /* T/F first (possibly after undefined) */
-  if (val != GetBooleanAtomValue(testi)) {
-    if (testat->next != NULL) { /* return 2nd boolean */
-      *exact = 1;
-      return testat->next;
-    } else {
-      *exact = 0;       /* add boolean */
-      return testat;
-    }
-  } else {
-    *exact = 1; /* return 1st boolean */
-    return testat;
-  }
-}
-
-/*
- * compare two sets. want ordering undefint-undefsym-int-sym,
- * but will settle for undefint-int-undefsym-sym.
- * Wouldn't it be lovely if all the CmpAtomValues functions
- * had semantics which gave us the undefined values first
- * so that we could write one function for all the ATOM
- * types?
- */
-static
-struct AnonType *NearestAnonTypeSA(struct Instance *i,
-                                   struct AnonType *after,
-                                   int *exact)
-{
-  struct AnonType *testat;
-  struct Instance *testi = NULL;  /* initialize to satisfy dumb compilers */
-  int cmp;
-  if (after == NULL) {
-    *exact = 0;
-    return after;
-  }
-
-  /* check for add at front */
-  cmp = CmpAtomValues(i,GAP(after));
-  if (cmp < 0) {
-    *exact = 0;
-    return NULL;
-  }
-  /* Find same value. Sorted by decreasing integer value.  */
-  testat = after;
-  while (testat != NULL &&
-         ((testi = GAP(testat)), CmpAtomValues(i,testi) > 0)) {
-    /* C comma syntax: testi = in the logic above does nothing to
-     * the logic, except make the second test possible.
-     */
-    after = testat;
-    testat = testat->next;
-  }
-  /* ran off end of anonlist? */
-  if (testat == NULL) {
-    *exact = 0;
-    return after; /* Works if after NULL or not. */
-  }
-  if ( CmpAtomValues(i,testi)==0 ) {
-    /* stopped within list on a match */
-    *exact = 1;
-    return testat;
-  } else {
-    /* stopped on insertion point */
-    *exact = 0;
-    return after;
-  }
-}
-
-/*
- * anon type -> FT, parent FT, hollowness.
- * We aren't doing a full treatment because parent ft is
- * available only after a full pass with this partial treatment.
- * Finished comes first, then hollow, in the very limited
- * sort order. NULL is not to be here.
- */
-static
-struct AnonType *NearestAnonTypeRelation(struct Instance *i,
-                                         struct AnonType *after,
-                                         int *exact)
-{
-  CONST struct Instance *testi = NULL;
-
-  if (after != NULL) {
-    testi = GAP(after);
-  } else {
-    *exact = 0;
-    return after;
-  }
-  /* now testi != NULL */
-  if (GetInstanceRelationOnly(i) != NULL) {
-    /* i not hollow */
-    if (GetInstanceRelationOnly(testi) != NULL) {
-      /* filled already seen */
-      *exact = 1;
-      return after;
-    } else {
-      /* i is the first filled relation */
-      *exact = 0;
-      return NULL; /* add first non-hollow relation at head */
-    }
-  } else {
-    /* i hollow */
-    if (GetInstanceRelationOnly(testi) != NULL) {
-      /* filled already seen */
-      if (after->next != NULL) {
-        *exact = 1;
-        return after->next;
-      } else {
-        *exact = 0;
-        return after; /* add first hollow after head */
-      }
-    } else {
-      /* filled not seen, means only hollow left, since trapped NULL above. */
-      *exact = 1;
-      return after;
-    }
-  }
-}
-
-/*
- * anon type -> FT, parent FT, hollowness.
- * We aren't doing a full treatment because parent ft is
- * available only after a full pass with this partial treatment.
- * Finished comes first, then hollow, in the very limited
- * sort order. NULL is not to be here.
- */
-static
-struct AnonType *NearestAnonTypeLogRel(struct Instance *i,
-                                         struct AnonType *after,
-                                         int *exact)
-{
-  CONST struct Instance *testi = NULL;
-
-  if (after != NULL) {
-    testi = GAP(after);
-  } else {
-    *exact = 0;
-    return after;
-  }
-  /* now testi != NULL */
-  if (GetInstanceLogRel(i) != NULL) {
-    /* i not hollow */
-    if (GetInstanceLogRel(testi) != NULL) {
-      /* filled already seen */
-      *exact = 1;
-      return after;
-    } else {
-      /* i is the first filled relation */
-      *exact = 0;
-      return NULL; /* add first non-hollow relation at head */
-    }
-  } else {
-    /* i hollow */
-    if (GetInstanceLogRel(testi) != NULL) {
-      /* filled already seen */
-      if (after->next != NULL) {
-        *exact = 1;
-        return after->next;
-      } else {
-        *exact = 0;
-        return after; /* add first hollow after head */
-      }
-    } else {
-      /* filled not seen, means only hollow left, since trapped NULL above. */
-      *exact = 1;
-      return after;
-    }
-  }
-}
-
 /*
  * This function handles the special case where we want TmpNum
  * of a NULL instance to be 0 instead of LONG_MAX as it is defined
@@ -832,74 +366,6 @@ unsigned long GetInstanceAnonIndex(struct Instance *i)
   }
 }
 
-/*
- * On entry, testat matches i except possibly in merges and after is either
- * testat (and first of the FT list) or the AT before testat
- * in the FT list.
- */
-static
-enum search_status MatchATMerges(struct Instance *i,
-                                 struct AnonType **after_p,
-                                 struct AnonType **testat_p,
-                                 int *exactfamily)
-{
-  struct AnonType *after;
-  struct AnonType *testat;
-  struct Instance *testi;
-  int cmp;
-  enum search_status s;
-
-  after = *after_p;
-  testat = *testat_p;
-  testi = GAP(testat);
-
-  *exactfamily = testat->exactfamily;
-  assert(*exactfamily != 0);
-  cmp = Asc_AnonMergeCmpInstances(i,testi);
-  assert(cmp != 2);
-  if (cmp == 0) {
-    s = at_exact;
-  } else {
-    if (cmp < 0) {
-      /* insert at beginning of family section of ATs */
-      s = at_previous;
-    } else {
-      /* move right until out of family, or NULL AT or found location. */
-      while (cmp > 0) {
-        if (testat->next == NULL) {
-          s = at_append;  /* testat is end of at list, exact is 0 */
-          break;          /* exit while early */
-        }
-        if (testat->next->exactfamily != *exactfamily) {
-          /* ok, so testat is the right edge of our exactfamily
-           * and we want to append the family.
-           */
-          s = at_append;
-          break;
-        } else {
-          /* move right */
-          after = testat;
-          testat = testat->next;
-          testi = GAP(testat);
-          cmp = Asc_AnonMergeCmpInstances(i,testi);
-          assert(cmp != 2);
-        }
-      }
-      /* cmp <= 0 but there is at least one family member i is > than. */
-      if (cmp == 0) {
-        /* found it */
-        s = at_exact;
-      } else {
-        /* passed it. insert after 'after'. */
-        s = at_previous;
-      }
-    }
-  }
-  *after_p = after;
-  *testat_p = testat;
-  return s;
-}
-
 /* i1, i2 assumed != and not NULL.
  * The ArrayAnonCmp function assume that the arrays to be compared have the
  * same array type description and level of indirection so that
@@ -970,423 +436,150 @@ int ArrayAnonCmpEnum(CONST struct Instance *i1, CONST struct Instance *i2)
   return 0;
 }
 
-static
-struct AnonType *NearestAnonTypeArrayEnum(struct Instance *i,
-                                          struct AnonType *after,
-                                          int *exact,
-                                          int *exactfamily)
-{
-  struct AnonType *testat;
-  struct Instance *testi;
-  enum search_status s;
-
-  if (after == NULL) {
-    *exact = 0;
-    return NULL;
-  }
-  if (ArrayAnonCmpEnum(i,GAP(after)) < 0) {
-    *exact = 0;
-    return NULL;
-  }
-  testat = after;
-  while (testat != NULL &&
-         ((testi = GAP(testat)), ArrayAnonCmpEnum(i,testi) > 0)) {
-    after = testat;
-    testat = testat->next;
-  }
-  if (testat == NULL) {
-    /* append */
-    *exact = 0;
-    return after;
-  }
-  if (testat == after) {
-    /* didn't enter while, and < case ruled out before entry */
-    /* check for mergedness same here. if not identical,
-     * return 0 for *exact and cause append or insert(ret NULL) of new AT.
-     * i and testi are in the same family.
-     */
-    s = MatchATMerges(i,&after,&testat,exactfamily);
-    switch (s) {
-    case at_exact:
-      *exact = 1;
-      return testat;
-    case at_previous:
-      *exact = 0;
-      return NULL; /* new AT at head of list */
-    case at_append:
-      *exact = 0;
-      return after;
-    case at_notdone:
-      /* we screwed up */
-    default:
-      ASC_PANIC("Returning while not (1) done");
-      exit(2); /* NOTREACHED, but quiets gcc */
-    }
-  }
-  if (ArrayAnonCmpEnum(i,GAP(after)) < 0) {
-    *exact = 0;
-    return after;
-  } else {
-    s = MatchATMerges(i,&after,&testat,exactfamily);
-    switch (s) {
-    case at_exact:
-      *exact = 1;
-      return testat;
-    case at_previous:
-      *exact = 0;
-      return after; /* new AT at head of family */
-    case at_append:
-      *exact = 0;
-      return after;
-    case at_notdone:
-      /* we screwed up */
-    default:
-      ASC_PANIC("Returning while not (2) done");
-      exit(2); /* NOTREACHED, but quiets gcc */
-    }
-  }
-}
-
 /*
- * The anonymous type of an array is really determined by its
- * formal type (statement+basetype) and it parent MODEL's anonymous
- * type. But since we work bottom up, we instead classify by
- * the system generated array typedescription, the # of children,
- * and the subscript name/AT of each child.
- * This classification function looks rather simple, mainly
- * because the real dirt goes on in the ArrayAnonCmpInt call.
- *
- * We also have to compare mergedness of arrays of models/vars.
+ * Returns 1 if the children of MODELs i1 and i2 have the same
+ * anonymous types, child by child, or 0 if not.
  */
 static
-struct AnonType *NearestAnonTypeArrayInt(struct Instance *i,
-                                         struct AnonType *after,
-                                         int *exact,
-                                         int *exactfamily)
+int ModelAnonSame(CONST struct Instance *i1, CONST struct Instance *i2)
 {
-
-  struct AnonType *testat;
-  struct Instance *testi;
-  enum search_status s;
-
-  if (after == NULL) {
-    *exact = 0;
-    return NULL;
-  }
-  if (ArrayAnonCmpInt(i,GAP(after)) < 0) {
-    *exact = 0;
-    return NULL;
-  }
-  testat = after;
-  while (testat != NULL &&
-         ((testi = GAP(testat)), ArrayAnonCmpInt(i,testi) > 0)) {
-    after = testat;
-    testat = testat->next;
-  }
-  /* at this point, testi is from after */
-  if (testat == NULL) {
-    /* append */
-    *exact = 0;
-    return after;
-  }
-  if (testat == after) {
-    /* didn't enter while, and < case ruled out before entry */
-    /* check for mergedness same here. if not identical,
-     * return 0 for *exact and cause append or insert(ret NULL) of new AT.
-     * i and testi are in the same family.
-     */
-    s = MatchATMerges(i,&after,&testat,exactfamily);
-    switch (s) {
-    case at_exact:
-      *exact = 1;
-      return testat;
-    case at_previous:
-      *exact = 0;
-      return NULL; /* new AT at head of list */
-    case at_append:
-      *exact = 0;
-      return after;
-    case at_notdone:
-      /* we screwed up */
-    default:
-      ASC_PANIC("Returning while not (1) done");
-      exit(2); /* NOTREACHED, but quiets gcc */
-    }
-  }
-  if (ArrayAnonCmpInt(i,GAP(after)) < 0) {
-    *exact = 0;
-    return after;
-  } else {
-    s = MatchATMerges(i,&after,&testat,exactfamily);
-    switch (s) {
-    case at_exact:
-      *exact = 1;
-      return testat;
-    case at_previous:
-      *exact = 0;
-      return after; /* new AT at head of family */
-    case at_append:
-      *exact = 0;
-      return after;
-    case at_notdone:
-      /* we screwed up */
-    default:
-      ASC_PANIC("Returning while not (2) done");
-      exit(2); /* NOTREACHED, but quiets gcc */
+  unsigned long c,len;
+  len = NumberChildren(i1);
+  for (c = 1; c <= len; c++) {
+    if (GAIN(InstanceChild(i1,c)) != GAIN(InstanceChild(i2,c))) {
+      return 0;
     }
   }
+  return 1;
 }
 
 /*
- * anon type -> FT, child ATs
- * Now, this is an interesting function. The idea is that we want
- * as simple as data structure as can be reasonably had and still
- * find exact matches (or the need for a new AT) in linear time.
- * Presumably a sorted strucure is faster as it permits us to do
- * fewer than nAT comparisons of the instance being classified
- * against the anonlist.
- * The minimum time to diagnose an exact match of two instances,
- * assuming all children already classified or NULL, is linear
- * in the number of children.
- * So the sort order/search can be explained with the following
- * example assume for a formal type there are 5 existing ATs.
- * Represent each AT as a column of numbers where the numbers
- * are the AT->index of each child. Here nAT == 5.
- * example anonlist linked in order abcde       instance to be classified:
- *  AT: a       b       c       d       e       CH       f
- * CH:------------------------------------              -
- * 1'|  1*      1       1       1       1       1^      1*
- * 2'|  2*      2*      3*      3       3       2^      3*
- * 3'|  3       4       3*      4*      4       3^      4*
- * 4'|  5       5       5       5*<     5       4^      4*
- * 5'|  6       6       6       6       7       5^      6
- *
- * The maximum cost is k*(nAT+nCH) integer comparisons.
- * We can search by doing integer comparisons with the *'d numbers.
- * When we reach the final point where 4' > 4^ (index 5 > 4)
- * we no we have a new at and it should go in before AT d.
+ * Signatures.
+ * Rather than keeping the ATs of each formal type sorted and searching
+ * them, as this file did once, we hash each instance on the things
+ * that decide its AT and look for an AT with the same hash code,
+ * which is then checked by comparing the instance with its prototype.
+ * The signature of compound instances is built bottom up from the
+ * AT indices of their children, which are already numbers unique to
+ * each AT (we hash-cons the tree, in effect), so no instance has to
+ * be hashed twice or looked at below its children.
  *
- * So, the logic required for this picture is given in the function body.
- * The obscuring boundary case (there's always one of those :-() is
- * what to do with NULL instances. They can be most conveniently dealt
- * with by assigning them all (regardless of eventual kind) the
- * AT index of 0 (convenient since real indices start at 1, as they
- * are stored in a gl_list). Unfortunately, this makes a special case
- * out of them for TmpNum purposes because GetTmpNum returns
- * LONG_MAX when it is called on a NULL instance. It would be nice
- * if TmpNum had originally been designed to return 0 on NULL,
- * but we can't mess with the TmpNum convention now.
- * We get rid of the special case with a TmpNum wrapper.
- * This function is really the pivot for the design of the
- * rest of the file.
- *
- * The above tells most of the story. In addition to comparing
- * anonymous types of children, we must then also compare the
- * merges listed on the instance being classified. Things are
- * going to be down-right twisty, but the basic idea of the
- * picture above still holds. The comparison of merges in
- * effect adds an extra row (think of the merges, in toto, as
- * a really weird child). Very seldom in practical models will
- * a merge comparison turn up anything other than equal, but
- * we must do it to have a correct compiler.
- *
- * Note that we could do the rightward search in the grid above
- * on the children by looking at the child's at index. Merge
- * information isn't typed, however, so we can't use it as a
- * criteria for moving (and stopping) rightward. So we invent
- * the exact family identifier in an AT. A set of AT's which
- * are identical up to (but not including) the merge information
- * will all have the same family identifier. Within a family
- * identifier group, a comparison search (initially linear until
- * we prove it needs speedup) for the proper place to add an
- * instance is necessary.
- *
- * exactfamily is assumed to hold 0 on entry. If an instance matches
- * an existing AT up to but not including the merged descendant
- * information, then exactfamily will be set to the family id of
- * the group the instance belongs to.
+ * anon type of:
+ *   real constant  -> FT, dimens, value.
+ *   real atom      -> FT, dimens. Subatomic structure is ignored,
+ *                     since it cannot affect compiled structure.
+ *   int/sym/bool constant, set -> FT, value.
+ *   relation, logrel -> FT, hollowness.
+ *   array          -> FT, indirection, subscripts and child ATs, merges.
+ *   MODEL          -> FT, child ATs, merges.
+ *   everything else -> FT.
+ * Unassigned values count as values, as described with the wrappers
+ * above.
  */
+#define ATMIX(h,x) ((h) = ((h) ^ (unsigned long)(x)) * 1000003UL)
+
 static
-struct AnonType *NearestAnonTypeModel(struct Instance *i,
-                                      struct AnonBucket *b,
-                                      int *exact,
-                                      int *exactfamily)
+unsigned long SetAnonSignature(CONST struct Instance *i, unsigned long h)
 {
-  /* make the code more compact but not too obscure with GAIN,GAP */
-
-  struct AnonType *testat, *after;
-  CONST struct Instance *testi = NULL;
-  unsigned long bindex, testindex; /* 0 = NULL child */
+  CONST struct set_t *s;
   unsigned long c,len;
-  enum search_status s;
-
-  assert(b!=NULL);
-  after = b->anonlist;
-#if ATDEBUG
-  FPRINTF(ASCERR,"NearestAnonTypeModel: checking children\n",c);
-#endif
-  if (after == NULL) {
-    *exact = 0;
-    return after;
-  }
-  len = ChildListLen(GetChildList(b->d));
-  if (!len) {
-    /* childless --> AT == FT */
-    *exact = 1;
-    return after;
-  }
-  s = at_notdone;
-#if ATDEBUG
-  FPRINTF(ASCERR,"NearestAnonTypeModel: at_notdone set starting len = %lu\n",len);
-#endif
-  testat = after;
-  /* for loop will be entered */
-  for (c = 1; c <= len && s == at_notdone; c++) {
-    bindex = GAIN(InstanceChild(i,c));
-    testi = GAP(testat); /* if at never changes, this is redundant,
-                          * but redundant is cheaper than the logic
-                          * to avoid redundancy.
-                          */
-    testindex = GAIN(InstanceChild(testi,c));
-    while (testindex < bindex) {
-      if (testat->next == NULL) {
-        s = at_append;  /* testat is end of at list, exact is 0 */
-#if ATDEBUG
-        FPRINTF(ASCERR,"NearestAnonTypeModel: at_append set (index=%lu, testindex=%lu)\n",bindex, testindex);
-#endif
-        break;          /* exit while early */
-      } else {
-        /* move right */
-#if ATDEBUG
-        FPRINTF(ASCERR,"NearestAnonTypeModel: moving right(index=%lu, testindex=%lu)\n",bindex, testindex);
-#endif
-        after = testat;
-        testat = testat->next;
-        testi = GAP(testat);
-        testindex = GAIN(InstanceChild(testi,c));
-      }
+  ATMIX(h,GetSetAtomKind(i));
+  if (!AtomAssigned(i)) {
+    return h;
+  }
+  s = SetAtomList(i);
+  ATMIX(h,SetKind(s));
+  len = Cardinality(s);
+  ATMIX(h,len);
+  if (SetKind(s) == integer_set) {
+    for (c = 1; c <= len; c++) {
+      ATMIX(h,FetchIntMember(s,c));
     }
-    /* append, or testindex >= bindex. = -> on to next child, > -> insert. */
-    if (s == at_notdone && testindex > bindex) {
-      s = at_previous;  /* insert new at between after, testat */
-#if ATDEBUG
-      FPRINTF(ASCERR,"NearestAnonTypeModel: at_previous set at c = %lu (index=%lu, testindex=%lu)\n",c, bindex, testindex);
-#endif
-      break;            /* exit for early */
+  } else if (SetKind(s) == string_set) {
+    for (c = 1; c <= len; c++) {
+      ATMIX(h,(asc_intptr_t)FetchStrMember(s,c));
     }
-    /* bindex == test index */
-  }
-
-#if ATDEBUG
-  FPRINTF(ASCERR,"NearestAnonTypeModel: after loop c = %lu, s = %d\n",c,s);
-#endif
-  if (c > len && s == at_notdone) {
-    /* now we have to compare the merge lists, sigh.  The for loop
-     * leaves us with the first AT in our exact family.
-     */
-    s = MatchATMerges(i,&after,&testat,exactfamily);
-  }
-#if ATDEBUG
-  FPRINTF(ASCERR,"NearestAnonTypeModel: after merge check c = %lu, s = %d\n",c,s);
-#endif
-
-  switch (s) {
-  case at_exact:
-    *exact = 1;
-    return testat;
-  case at_previous:
-    *exact = 0;
-    if (after == testat) {
-      /* very first at in formal type list */
-      return NULL;
-    } else {
-      /* we moved 1 past the place after which i belongs */
-      return after;
-    }
-  case at_append:
-    /* we are at the place after which i belongs */
-    *exact = 0;
-    return testat;
-  case at_notdone:
-    /* we screwed up */
-  default:
-    ASC_PANIC("Returning while not done");
-    exit(2); /* NOTREACHED, but quiets gcc */
   }
+  return h;
 }
 
 /*
- * This is where the evil comparisons and linked list traversal are
- * all distributed. Particularly complex cases are arrays/models.
- * We're searching for the AT nearest to the yet undetermined
- * AT of i. All the children of compound i are assumed already
- * classified or NULL. b is the bucket for the formal type of
- * i. *exact is returned 1 if match is found, or 0 if not.
- * If not, then the AT returned is the AT in b after which the
- * new AT that i implies should be inserted.
- * In the comments of this function, CT -> context, FT -> formal type.
- * By the time we reach this function, there isn't a question of
- * competing types with the same name, so anything determined entirely
- * by the formal type of the bucket, b, will have a bucket with length
- * 0 or 1. Every existing AT encountered is assumed to have at least
- * 1 instance associated with it.
- *
- * exactfamily will be 0 and meaningless if the match is exact.
- * it will be 0 if the match is inexact and a new family is
- * needed (only arrays and models need families at all, but it
- * doesn't hurt to give all ATs a family so we do. If exactfamily
- * is nonzero, then the AT to be created (because exact will be 0)
- * should have as its family id the value of *exactfamily.
+ * Returns the signature of i. All the children of compound i
+ * are assumed already classified or NULL.
+ * Merge information is included for arrays and models, so
+ * instances which differ only in their merged descendants will
+ * seldom share a hash chain.
  */
 static
-struct AnonType *NearestAnonType(struct Instance *i,
-                                 struct AnonBucket *b,
-                                 int *exact,
-                                 int *exactfamily)
+unsigned long AnonSignature(struct Instance *i)
 {
+  unsigned long h, c, len;
+  double val;
+  unsigned int word[sizeof(double)/sizeof(unsigned int)];
 
-  *exactfamily = 0;
+  h = 0x2545F491UL;
+  ATMIX(h,(asc_intptr_t)InstanceTypeDesc(i));
   switch(InstanceKind(i)) {
   case REAL_CONSTANT_INST:
-    return NearestAnonTypeRC(i,b->anonlist,exact); /* done? */
+    ATMIX(h,(asc_intptr_t)RealAtomDims(i));
+    val = AnonRealAtomValue(i);
+    if (val == 0.0) {
+      val = 0.0; /* -0 == 0 */
+    }
+    memcpy(word,&val,sizeof(double));
+    for (c = 0; c < sizeof(double)/sizeof(unsigned int); c++) {
+      ATMIX(h,word[c]);
+    }
+    break;
   case REAL_ATOM_INST:
-    return NearestAnonTypeRA(i,b->anonlist,exact); /* done */
+    ATMIX(h,(asc_intptr_t)RealAtomDims(i));
+    break;
   case INTEGER_CONSTANT_INST:
-    return NearestAnonTypeIC(i,b->anonlist,exact); /* done */
+    ATMIX(h,AnonIntegerAtomValue(i));
+    break;
   case SYMBOL_CONSTANT_INST:
-    return NearestAnonTypeSC(i,b->anonlist,exact); /* done */
+    ATMIX(h,(asc_intptr_t)GetAnonInstSymbol(i));
+    break;
   case BOOLEAN_CONSTANT_INST:
-    return NearestAnonTypeBC(i,b->anonlist,exact); /* done */
+    ATMIX(h,(AtomAssigned(i) ? 1 + (GetBooleanAtomValue(i) != 0) : 0));
+    break;
   case SET_ATOM_INST:
-    return NearestAnonTypeSA(i,b->anonlist,exact); /* done */
-
-  case ARRAY_ENUM_INST:
-    return NearestAnonTypeArrayEnum(i,b->anonlist,exact,exactfamily);
+    h = SetAnonSignature(i,h);
+    break;
+  case REL_INST:
+    ATMIX(h,(GetInstanceRelationOnly(i) != NULL));
+    break;
+  case LREL_INST:
+    ATMIX(h,(GetInstanceLogRel(i) != NULL));
+    break;
   case ARRAY_INT_INST:
-    return NearestAnonTypeArrayInt(i,b->anonlist,exact,exactfamily);
-
+  case ARRAY_ENUM_INST:
+    ATMIX(h,InstanceIndirected(i));
+    len = NumberChildren(i);
+    ATMIX(h,len);
+    for (c = 1; c <= len; c++) {
+      if (InstanceKind(i) == ARRAY_INT_INST) {
+        ATMIX(h,InstanceIntIndex(ChildName(i,c)));
+      } else {
+        ATMIX(h,(asc_intptr_t)InstanceStrIndex(ChildName(i,c)));
+      }
+      ATMIX(h,GAIN(InstanceChild(i,c)));
+    }
+    ATMIX(h,Asc_AnonMergeHashInstance(i));
+    break;
   case MODEL_INST:
-    return NearestAnonTypeModel(i,b, /* need the whole bucket */
-                                exact, exactfamily);
-
-  /* For all the following anon type -> FT.
-   * either there's already an AT or there isn't.
-   * Strictly speaking, the wheninst is determined by parent AT,
-   * but this is not available.
-   */
+    len = NumberChildren(i);
+    for (c = 1; c <= len; c++) {
+      ATMIX(h,GAIN(InstanceChild(i,c)));
+    }
+    ATMIX(h,Asc_AnonMergeHashInstance(i));
+    break;
   case INTEGER_ATOM_INST:       /* FALL THROUGH */
   case SYMBOL_ATOM_INST:        /* FALL THROUGH */
   case BOOLEAN_ATOM_INST:       /* FALL THROUGH */
   case WHEN_INST:               /* FALL THROUGH */
   case DUMMY_INST:
-    *exact = (b->anonlist != NULL);
-    return b->anonlist;		/* done */
-
-  /* log/rels can be one of: (NULL not seen), created hollow, or done. */
-  case REL_INST:                /* done? */
-    return NearestAnonTypeRelation(i,b->anonlist,exact);
-  case LREL_INST:             /* done? */
-    return NearestAnonTypeLogRel(i,b->anonlist,exact);
+    break;
 
   /* For these anon type -> FT, but who cares? we don't classify these. */
   case REAL_INST:               /* FALL THROUGH */
@@ -1395,16 +588,111 @@ struct AnonType *NearestAnonType(struct Instance *i,
   case BOOLEAN_INST:            /* FALL THROUGH */
   case SET_INST:
     ASC_PANIC("Called with subatomic instance");
-    return NULL; /* NOT REACHED, but shuts up gcc */
+    return 0; /* NOT REACHED, but shuts up gcc */
 
   case SIM_INST:
     ASC_PANIC("Called with SIM_INST kind");
-    return NULL; /* NOT REACHED, but shuts up gcc */
+    return 0; /* NOT REACHED, but shuts up gcc */
 
   default:
     ASC_PANIC("Called with unknown instance kind");
-    return NULL; /* NOT REACHED, but shuts up gcc */
+    return 0; /* NOT REACHED, but shuts up gcc */
+  }
+  /* spread the low bits, which pick the hash chain */
+  h ^= (h >> 29);
+  h *= 1103515245UL;
+  h ^= (h >> 16);
+  return h;
+}
+
+/*
+ * Returns 1 if i belongs to the AT of testi, which has the same
+ * formal type (and indirection) as i, or 0 if not.
+ * All the children of compound i and testi are assumed already
+ * classified or NULL.
+ */
+static
+int SameAnonType(struct Instance *i, struct Instance *testi)
+{
+  int cmp;
+  switch(InstanceKind(i)) {
+  case REAL_CONSTANT_INST:
+    return (RealAtomDims(i) == RealAtomDims(testi) &&
+            AnonRealAtomValue(i) == AnonRealAtomValue(testi));
+  case REAL_ATOM_INST:
+    return (RealAtomDims(i) == RealAtomDims(testi));
+  case INTEGER_CONSTANT_INST:
+    return (AnonIntegerAtomValue(i) == AnonIntegerAtomValue(testi));
+  case SYMBOL_CONSTANT_INST:
+    return (GetAnonInstSymbol(i) == GetAnonInstSymbol(testi));
+  case BOOLEAN_CONSTANT_INST:
+    if (!AtomAssigned(i) || !AtomAssigned(testi)) {
+      return (AtomAssigned(i) == AtomAssigned(testi));
+    }
+    return (GetBooleanAtomValue(i) == GetBooleanAtomValue(testi));
+  case SET_ATOM_INST:
+    return (CmpAtomValues(i,testi) == 0);
+  case REL_INST:
+    return ((GetInstanceRelationOnly(i) != NULL) ==
+            (GetInstanceRelationOnly(testi) != NULL));
+  case LREL_INST:
+    return ((GetInstanceLogRel(i) != NULL) ==
+            (GetInstanceLogRel(testi) != NULL));
+  case ARRAY_INT_INST:
+  case ARRAY_ENUM_INST:
+    if (InstanceKind(i) == ARRAY_INT_INST) {
+      cmp = ArrayAnonCmpInt(i,testi);
+    } else {
+      cmp = ArrayAnonCmpEnum(i,testi);
+    }
+    if (cmp != 0) {
+      return 0;
+    }
+    break;
+  case MODEL_INST:
+    if (!ModelAnonSame(i,testi)) {
+      return 0;
+    }
+    break;
+  default:
+    /* anon type -> FT. Strictly speaking, the wheninst is determined by
+     * parent AT, but this is not available.
+     */
+    return 1;
   }
+  /* arrays and models identical up to merges. Very seldom in practical
+   * models will a merge comparison turn up anything other than equal,
+   * but we must do it to have a correct compiler.
+   */
+  cmp = Asc_AnonMergeCmpInstances(i,testi);
+  assert(cmp != 2);
+  return (cmp == 0);
+}
+
+/*
+ * Doubles the size of the signature table, rehashing the ATs in it.
+ */
+static
+void GrowSignatureTable(struct AnonVisitInfo *info)
+{
+  struct AnonType **t, *at;
+  unsigned long c, size, mask;
+  size = 2*info->sigsize;
+  mask = size - 1;
+  t = ASC_NEW_ARRAY_CLEAR(struct AnonType *,size);
+  if (t == NULL) {
+    return; /* the chains just get longer */
+  }
+  for (c = 0; c < info->sigsize; c++) {
+    while ((at = info->sigt[c]) != NULL) {
+      info->sigt[c] = at->hnext;
+      at->hnext = t[at->signature & mask];
+      t[at->signature & mask] = at;
+    }
+  }
+  ascfree(info->sigt);
+  info->sigt = t;
+  info->sigsize = size;
 }
 
 /*
@@ -1417,9 +705,11 @@ struct AnonType *NearestAnonType(struct Instance *i,
 static
 void DeriveAnonType(struct Instance *i, struct AnonVisitInfo *info)
 {
-  struct AnonType  *at, *after;
+  struct AnonType  *at;
   struct AnonBucket *b;
-  int exact =0, exactfamily;
+  struct Instance *testi;
+  struct TypeDescription *d;
+  unsigned long sig, indirected;
 
   if (i==NULL) {
     info->errors++;
@@ -1432,36 +722,46 @@ void DeriveAnonType(struct Instance *i, struct AnonVisitInfo *info)
     FPRINTF(ASCERR,"\n");
     return;
   }
-  b = FindAnonBucket(InstanceTypeDesc(i),InstanceIndirected(i),info->t);
-  if (b == NULL) {
-    b = AddAnonBucket(InstanceTypeDesc(i),InstanceIndirected(i),info->t);
-    if (b == NULL) {
-      ASC_PANIC("AddAnonBucket returned NULL");
+  d = InstanceTypeDesc(i);
+  indirected = InstanceIndirected(i);
+  sig = AnonSignature(i);
+  for (at = info->sigt[sig & (info->sigsize - 1)]; at != NULL; at = at->hnext) {
+    if (at->signature == sig) {
+      testi = GAP(at);
+      if (InstanceTypeDesc(testi) == d &&
+          InstanceIndirected(testi) == indirected &&
+          SameAnonType(i,testi)) {
+        break;
+      }
     }
   }
-  exactfamily = 0;
-  after = NearestAnonType(i,b,&exact,&exactfamily);
 
 #if ATDEBUG
   WriteInstanceName(ASCERR,i,info->root);
-  FPRINTF(ASCERR,"\nexact = %d. after = 0x%p\n",exact,(void *)after);
+  FPRINTF(ASCERR,"\nsignature = %lx. at = 0x%p\n",sig,(void *)at);
 #endif
 
-  if (!exact) {
+  if (at == NULL) {
+    b = FindAnonBucket(d,indirected,info->t);
+    if (b == NULL) {
+      b = AddAnonBucket(d,indirected,info->t);
+      if (b == NULL) {
+        ASC_PANIC("AddAnonBucket returned NULL");
+      }
+    }
     at = ExpandAnonResult(info->atl); /* create, add to atl , set index */
-    if (exactfamily != 0) {
-      at->exactfamily = exactfamily;
-    } else {
-      at->exactfamily = ++(info->nextfamily);
+    AppendAnonType(b,at);
+    at->signature = sig;
+    at->hnext = info->sigt[sig & (info->sigsize - 1)];
+    info->sigt[sig & (info->sigsize - 1)] = at;
+    if (at->index > info->sigsize) {
+      GrowSignatureTable(info);
     }
-    InsertAnonType(b,at,after);
 
 #if ATDEBUG
     FPRINTF(ASCERR,"\tnew-at = 0x%p\n",(void *)at);
 #endif
 
-  } else {
-    at = after;
   }
   gl_append_ptr(at->instances,(void *)i);
   /* make damn sure this doesn't give us a big list of universal instances
@@ -1520,7 +820,9 @@ struct gl_list_t *Asc_DeriveAnonList(struct Instance *i)
 
 #endif
 
-  ZeroTmpNums(i,0);
+  /* Asc_AnonMergeMarkIPs zeroes the tmpnums of the instances we visit,
+   * so no ZeroTmpNums here.
+   */
   t = CreateAnonTable(ANONTABLESIZE);
   if (t == NULL) {
     return NULL;
@@ -1530,10 +832,16 @@ struct gl_list_t *Asc_DeriveAnonList(struct Instance *i)
     DestroyAnonTable(t);
     return NULL;
   }
+  info.sigsize = ANONTABLESIZE;
+  info.sigt = ASC_NEW_ARRAY_CLEAR(struct AnonType *,info.sigsize);
+  if (info.sigt == NULL) {
+    gl_destroy(atl);
+    DestroyAnonTable(t);
+    return NULL;
+  }
   info.t = t;
   info.root = i;
   info.atl = atl;
-  info.nextfamily = 1;
   info.errors = 0;
   /*
    * Apply function in a bottom up fashion, so that children
@@ -1590,6 +898,7 @@ struct gl_list_t *Asc_DeriveAnonList(struct Instance *i)
 
   Asc_AnonMergeUnmarkIPs(vp);
   DestroyAnonTable(t);
+  ascfree(info.sigt);
   /* ZeroTmpNums(i,0);  */
   /* not necessary, really, as any tn user should assume they are dirty */
   return atl;
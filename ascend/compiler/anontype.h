@@ -20,7 +20,9 @@
 	The idea of this module is to find and report groups of
 	isomorphic instances (instances with the same Anonymous Type).
 	We do not actually produce type definitions, or anything like them,
-	but instead use various sorting techniques. Note that anonymous
+	but instead hash each instance, bottom up, on what decides its
+	anonymous type (formal type, values, the ATs of its children and
+	its merged descendants) and look the hash up. Note that anonymous
 	type is a dynamic quantity in the ascend language definition which
 	allows deferred binding.
 	This should be named something like isomorph.c, but half the compiler
@@ -43,8 +45,8 @@
 	gl_list returned. There is no useful ordering of the gl_list returned.
 	Each AT knows its formal family as a doubly linked list, and each
 	AT has a counter, visited, that the user can do arbitrary things
-	with. The doubly linked list is ordered in some way that is an
-	artifact of the classification algorithm. The head and tail of
+	with. The doubly linked list is in the order the ATs were found,
+	which is an artifact of the classification algorithm. The head and tail of
 	the linked list are NULL.
 
 	Special cases:
@@ -110,8 +112,11 @@ struct AnonType {
    struct gl_list_t *instances;   /**< list of this AT's instances */
    struct AnonType *prev, *next;  /**< other ATs related by
                                        all being the same formally. */
-   int exactfamily;               /**< group id of anonymous types which are
-                                       identical except for merged substructure. */
+   unsigned long signature;       /**< hash of the formal type and of
+                                       the values, child ATs and merges
+                                       that decide the AT. */
+   struct AnonType *hnext;        /**< next AT in the same hash chain
+                                       while classifying. */
    int visited;                   /**< counter for arbitrary use. */
 };
 
@@ -141,6 +146,8 @@ struct AnonType {
  * One such hash table is used while classifying an instance tree
  * into AT groups. The user never sees this table, however.
  * This size must be even power of 2 and shouldn't be messed with.
+ * It is also the starting size of the table of ATs by signature,
+ * which doubles as it fills.
  */
 #define ANONTABLESIZE 1024
 
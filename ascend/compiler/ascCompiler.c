@@ -72,6 +72,7 @@
 #include "find.h"
 #include "rel_blackbox.h"
 #include "relation.h"
+#include "relation_util.h"
 #include "logical_relation.h"
 #include "logrelation.h"
 #include "instantiate.h"
@@ -272,4 +273,5 @@ void Asc_CompilerDestroy(void)
   statio_clear_stattypenames();
 
   tmpalloc(0); /* free temporary scratch memory allocated by relation_util.c */
+  RelEvalContextThreadDestroy(); /* and this thread's evaluation scratch */
 }
@@ -49,6 +49,7 @@
 #include "setinst_io.h"
 #include "instance_types.h"
 #include "cmpfunc.h"
+#include "valstore.h"
 #include "atomvalue.h"
 
 unsigned AtomAssigned(CONST struct Instance *i){
@@ -120,6 +121,13 @@ unsigned DepthAssigned(CONST struct Instance *i){
   }
 }
 
+/* keep the value store copy of a bound, nominal or fixed flag */
+static void NoteStoreChild(struct Instance *child, struct Instance *atom){
+  if (atom->t == REAL_ATOM_INST && RA_INST(atom)->store != NULL) {
+    ValueStoreNoteChild(atom,child);
+  }
+}
+
 double RealAtomValue(CONST struct Instance *i){
   assert(i!=NULL);
   AssertMemory(i);
@@ -129,6 +137,9 @@ double RealAtomValue(CONST struct Instance *i){
   case REAL_CONSTANT_INST:
     return RC_INST(i)->value;
   case REAL_ATOM_INST:
+    if (RA_INST(i)->store != NULL) {
+      return RA_INST(i)->store->value[RA_INST(i)->vid];
+    }
     return RA_INST(i)->value;
   default:
     ASC_PANIC("called with non-real instance");
@@ -161,12 +172,16 @@ void SetRealAtomValue(struct Instance *i, double d, unsigned int depth){
     R_INST(i)->assigned++;
     R_INST(i)->value = d;
     R_INST(i)->depth = depth;
+    if (R_INST(i)->parent_offset != NULL) NoteStoreChild(i,R_PARENT(i));
     break;
   case REAL_ATOM_INST:
 	/* CONSOLE_DEBUG("SETTING REAL ATOM INSTANCE %p TO VALUE %f, DEPTH %u (WAS %f)",i,d,depth,RA_INST(i)->value); */
     RA_INST(i)->assigned++;
     RA_INST(i)->value = d;
     RA_INST(i)->depth = depth;
+    if (RA_INST(i)->store != NULL) {
+      RA_INST(i)->store->value[RA_INST(i)->vid] = d;
+    }
     break;
   default:
     ASC_PANIC("called on non-real instance.\n");
@@ -299,6 +314,7 @@ void SetBooleanAtomValue(struct Instance *i, int truth, unsigned int depth){
     B_INST(i)->value = truth ? 1 : 0;
     B_INST(i)->assigned++;
     B_INST(i)->depth = depth;
+    if (B_INST(i)->parent_offset != NULL) NoteStoreChild(i,B_PARENT(i));
     break;
   case BOOLEAN_ATOM_INST:
     BA_INST(i)->value = truth ? 1 : 0;
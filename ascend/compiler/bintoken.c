@@ -55,6 +55,7 @@ TIMESTAMP = -DTIMESTAMP="\"by `whoami`@`hostname`\""
 #include "relation.h"
 #include "relation_util.h"
 #include "mathinst.h"
+#include "bintoken_jit.h"
 /* last */
 
 #include <ascend/bintokens/btprolog.h>
@@ -76,6 +77,7 @@ struct bt_table {
   enum bintoken_kind type;
   char *name;
   union TableUnion *tu;
+  struct BinTokenJITTable *jit; /* for type BT_JIT, instead of tu */
   int btable; /* check id */
   int refcount; /* total number of relation shares with btable = our number */
   int size; /* may be larger than refcount. */
@@ -102,7 +104,10 @@ struct bt_data {
   unsigned long maxrels; /* no more than this many C relations per file */
   int verbose; /* comments in generated code */
   int housekeep; /* if !=0, generated src files are deleted sometimes. */
-} g_bt_data = {NULL,0,0,NULL,0,"ERRARCHIVE",NULL,NULL,NULL,NULL,NULL,1,0,0};
+  enum bintoken_kind method; /* kind to use from instantiation */
+  char *jitcache; /* BT_JIT code cache file */
+  unsigned long jithits; /* relations found in it by the last BT_JIT build */
+} g_bt_data = {NULL,0,0,NULL,0,"ERRARCHIVE",NULL,NULL,NULL,NULL,NULL,1,0,0,BT_C,NULL,0};
 
 /**
  *  In the C++ interface, the arguments of BinTokenSetOptions need to be
@@ -156,12 +161,35 @@ int BinTokenSetOptions(CONST char *srcname,
   g_bt_data.maxrels = maxrels;
   g_bt_data.verbose = verbose;
   g_bt_data.housekeep = housekeep;
+  g_bt_data.method = BT_C;
 #ifdef BINTOKEN_VERBOSE
   CONSOLE_DEBUG("make command = %s",buildcommand);
 #endif
   return err;
 }
 
+int BinTokenSetJITOptions(CONST char *cachename, unsigned long maxrels){
+  int err;
+  err = bt_string_replace(cachename,&(g_bt_data.jitcache));
+  BinTokenJITClearCache(); /* so that the file is read again */
+  g_bt_data.maxrels = maxrels;
+  g_bt_data.method = BT_JIT;
+  if (!BinTokenJITAvailable()) {
+    ERROR_REPORTER_HERE(ASC_PROG_NOTE,"Binary tokens by JIT are not available on this platform");
+    g_bt_data.maxrels = 0;
+    return 1;
+  }
+  return err;
+}
+
+enum bintoken_kind BinTokenGetMethod(void){
+  return g_bt_data.method;
+}
+
+unsigned long BinTokenJITCacheHits(void){
+  return g_bt_data.jithits;
+}
+
 
 /*
  * grows the table when need be.
@@ -194,13 +222,21 @@ int BinTokenCheckCapacity()
 */
 void BinTokenClearTables(void)
 {
+  int c;
   if (g_bt_data.tables != NULL) {
+    for (c = 1; c <= g_bt_data.nextid; c++) {
+      if (g_bt_data.tables[c].type == BT_JIT) {
+        BinTokenJITDestroy(g_bt_data.tables[c].jit);
+      }
+    }
     ASC_FREE(g_bt_data.tables);
     g_bt_data.tables = NULL;
   }
   g_bt_data.captables = 0;
   g_bt_data.nextid = 0;
   BinTokenSetOptions(NULL,NULL,NULL,NULL,NULL,1,0,0);
+  bt_string_replace(NULL,&(g_bt_data.jitcache));
+  BinTokenJITClearCache();
 }
 
 /*
@@ -218,7 +254,15 @@ void BinTokenDeleteReference(int btable)
      */
   }
   g_bt_data.tables[btable].refcount--;
-  if (g_bt_data.tables[btable].refcount == 0) {
+  if (g_bt_data.tables[btable].refcount == 0
+      && g_bt_data.tables[btable].type == BT_JIT) {
+    /* generated code is ours to free */
+    BinTokenJITDestroy(g_bt_data.tables[btable].jit);
+    g_bt_data.tables[btable].jit = NULL;
+    ASC_FREE(g_bt_data.tables[btable].name);
+    g_bt_data.tables[btable].name = NULL;
+    g_bt_data.tables[btable].type = BT_error;
+  }else if (g_bt_data.tables[btable].refcount == 0) {
     /* unload the library if possible here */
 #if HAVE_DL_UNLOAD
     /*ERROR_REPORTER_NOLINE(ASC_PROG_ERR,"UNLOADING %s",g_bt_data.tables[btable].name);*/
@@ -695,6 +739,7 @@ static
 void BinTokenHookToTable(int entry, enum bintoken_kind type)
 {
   g_bt_data.tables[entry].tu = g_bt_data.newtable;
+  g_bt_data.tables[entry].jit = NULL;
   g_bt_data.tables[entry].size = g_bt_data.newtablesize;
   g_bt_data.tables[entry].btable = entry;
   g_bt_data.tables[entry].type = type;
@@ -734,6 +779,41 @@ enum bintoken_error BinTokenLoadC(struct gl_list_t *rellist,
   return BTE_ok;
 }
 
+/*
+ * generates native code for the relations in rellist without leaving
+ * the process, and hooks it up as a new table.
+ */
+static
+enum bintoken_error BinTokenLoadJIT(struct gl_list_t *rellist,
+                                    char *cachename)
+{
+  struct BinTokenJITTable *jt;
+  unsigned long c,len,nhit;
+  len = gl_length(rellist);
+  jt = BinTokenJITCreate(rellist,cachename,&nhit);
+  g_bt_data.jithits = nhit;
+  if (jt == NULL) {
+    return BTE_build;
+  }
+  g_bt_data.nextid++;
+  BinTokenCheckCapacity();
+  g_bt_data.tables[g_bt_data.nextid].tu = NULL;
+  g_bt_data.tables[g_bt_data.nextid].jit = jt;
+  g_bt_data.tables[g_bt_data.nextid].size = jt->size - 1;
+  g_bt_data.tables[g_bt_data.nextid].btable = g_bt_data.nextid;
+  g_bt_data.tables[g_bt_data.nextid].type = BT_JIT;
+  for (c=1;c <= len; c++) {
+    RelationSetBinTokens((struct Instance *)gl_fetch(rellist,c),
+                         g_bt_data.nextid,(int)c);
+  }
+  g_bt_data.tables[g_bt_data.nextid].refcount = (int)len;
+  g_bt_data.tables[g_bt_data.nextid].name = ASC_STRDUP("JIT");
+  if (g_bt_data.verbose) {
+    CONSOLE_DEBUG("Generated code for %lu relations (%lu from cache)",len,nhit);
+  }
+  return BTE_ok;
+}
+
 /*
  * this function should be more helpful.
  */
@@ -795,7 +875,8 @@ void BinTokensCreate(struct Instance *root, enum bintoken_kind method){
 #endif
     return;
   }
-  if (srcname == NULL || buildcommand == NULL || unlinkcommand == NULL) {
+  if (method == BT_C &&
+      (srcname == NULL || buildcommand == NULL || unlinkcommand == NULL)) {
 #ifdef BINTOKEN_VERBOSE
     ERROR_REPORTER_HERE(ASC_PROG_WARNING,"BinaryTokensCreate called with no options set: ignoring");
 #endif
@@ -853,6 +934,12 @@ void BinTokensCreate(struct Instance *root, enum bintoken_kind method){
       }
     }
     break;
+  case BT_JIT:
+    status = BinTokenLoadJIT(rellist,g_bt_data.jitcache);
+    if(status != BTE_ok){
+      BinTokenErrorMessage(status,root,"JIT",NULL);
+    }
+    break;
   default:
     ERROR_REPORTER_HERE(ASC_PROG_ERR,"BinaryTokensCreate called with unavailable method '%d'",(int)method);
     break;
@@ -868,7 +955,7 @@ void BinTokensCreate(struct Instance *root, enum bintoken_kind method){
  */
 int BinTokenCalcResidual(int btable, int bindex, double *vars, double *residual)
 {
-  if (btable < 1 || bindex < 1) {
+  if (btable < 1 || bindex < 1 || btable > g_bt_data.nextid) {
     return 1;
   }
   switch (g_bt_data.tables[btable].type) {
@@ -883,21 +970,21 @@ int BinTokenCalcResidual(int btable, int bindex, double *vars, double *residual)
         return 1;
       }
       func = ctable[bindex].F;
-#if 0 /* setting this to 1 is a major performance hit. */
-      if (func != NULL) {
-        if (SETJMP(g_fpe_env)==0) {
-          (*func)(vars,residual);
-          return 0;
-        } else {
-          Asc_SignalRecover();
-          return 1;
-        }
-      }
-      return 1;
-#else
+      /* callers check the residual is finite; testing flags here costs */
       (*func)(vars,residual);
       return 0;
-#endif
+    }
+  case BT_JIT: {
+      struct BinTokenJITEntry *e;
+      if (bindex >= g_bt_data.tables[btable].jit->size) {
+        return 1;
+      }
+      e = &(g_bt_data.tables[btable].jit->entries[bindex]);
+      if (e->F == NULL) {
+        return 1;
+      }
+      (*(e->F))(vars,residual,e->ftab);
+      return 0;
     }
   case BT_F77: {
       /* this case needs to be cleaned up to match the C case above. */
@@ -912,21 +999,12 @@ int BinTokenCalcResidual(int btable, int bindex, double *vars, double *residual)
       if (subroutine != NULL) {
         int ForG,status;
         ForG = BinTokenRESIDUAL;
-#ifdef ASC_SIGNAL_TRAPS
-        Asc_SignalHandlerPush(SIGFPE,Asc_SignalTrap);
-        if (SETJMP(g_fpe_env)==0) {
-#endif /* ASC_SIGNAL_TRAPS */
-          (*subroutine)(vars,NULL,residual,&ForG,&bindex,&status);
-#ifdef ASC_SIGNAL_TRAPS
-          Asc_SignalHandlerPop(SIGFPE,Asc_SignalTrap);
-#endif /* ASC_SIGNAL_TRAPS */
-          return status;
-#ifdef ASC_SIGNAL_TRAPS
-        } else {
-          Asc_SignalHandlerPop(SIGFPE,Asc_SignalTrap);
+        Asc_FPEClear();
+        (*subroutine)(vars,NULL,residual,&ForG,&bindex,&status);
+        if (Asc_FPETest()) {
           return 1;
         }
-#endif /* ASC_SIGNAL_TRAPS */
+        return status;
       }
       return 1;
     }
@@ -942,14 +1020,14 @@ int BinTokenCalcResidual(int btable, int bindex, double *vars, double *residual)
 int BinTokenCalcGradient(int btable, int bindex,double *vars,
                          double *residual, double *gradient)
 {
-  if (btable == 0) {
+  if (btable < 1 || btable > g_bt_data.nextid) {
     return 1;
   }
   switch (g_bt_data.tables[btable].type) {
   case BT_error:
     return 1; /* expired table! */
   case BT_C: {
-      /* signal handling needs to match func above. this is slow here. */
+      /* FPE checking needs to match func above. */
       struct TableC *ctable;
       BinTokenGPtr func;
       ctable = (struct TableC *)g_bt_data.tables[btable].tu;
@@ -959,24 +1037,27 @@ int BinTokenCalcGradient(int btable, int bindex,double *vars,
       }
       func = ctable[bindex].G;
       if (func != NULL) {
-#ifdef ASC_SIGNAL_TRAPS
-        Asc_SignalHandlerPush(SIGFPE,Asc_SignalTrap);
-        if (SETJMP(g_fpe_env)==0) {
-#endif /* ASC_SIGNAL_TRAPS */
-          (*func)(vars,gradient,residual);
-#ifdef ASC_SIGNAL_TRAPS
-          Asc_SignalHandlerPop(SIGFPE,Asc_SignalTrap);
-#endif /* ASC_SIGNAL_TRAPS */
-          return 0;
-#ifdef ASC_SIGNAL_TRAPS
-        } else {
-          Asc_SignalHandlerPop(SIGFPE,Asc_SignalTrap);
+        Asc_FPEClear();
+        (*func)(vars,gradient,residual);
+        if (Asc_FPETest()) {
           return 1;
         }
-#endif /* ASC_SIGNAL_TRAPS */
+        return 0;
       }
       return 1;
     }
+  case BT_JIT: {
+      struct BinTokenJITEntry *e;
+      if (bindex < 1 || bindex >= g_bt_data.tables[btable].jit->size) {
+        return 1;
+      }
+      e = &(g_bt_data.tables[btable].jit->entries[bindex]);
+      if (e->G == NULL) {
+        return 1;
+      }
+      (*(e->G))(vars,residual,gradient,e->ftab);
+      return 0;
+    }
   case BT_F77: {
       struct TableF *ftable;
       BinTokenSPtr subroutine;
@@ -989,22 +1070,12 @@ int BinTokenCalcGradient(int btable, int bindex,double *vars,
       if (subroutine != NULL) {
         int ForG,status;
         ForG = BinTokenGRADIENT;
-#ifdef ASC_SIGNAL_TRAPS
-        Asc_SignalHandlerPush(SIGFPE,Asc_SignalTrap);
-        if (SETJMP(g_fpe_env)==0) {
-#endif /* ASC_SIGNAL_TRAPS */
-          (*subroutine)(vars,gradient,residual,&ForG,&bindex,&status);
-#ifdef ASC_SIGNAL_TRAPS
-          Asc_SignalHandlerPop(SIGFPE,Asc_SignalTrap);
-#endif /* ASC_SIGNAL_TRAPS */
-          return status;
-#ifdef ASC_SIGNAL_TRAPS
-        } else {
-          status = 1;
+        Asc_FPEClear();
+        (*subroutine)(vars,gradient,residual,&ForG,&bindex,&status);
+        if (Asc_FPETest()) {
+          return 1;
         }
-        Asc_SignalHandlerPop(SIGFPE,Asc_SignalTrap);
         return status;
-#endif /* ASC_SIGNAL_TRAPS */
       }
       return 1;
     }
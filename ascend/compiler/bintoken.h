@@ -43,7 +43,8 @@
 enum bintoken_kind {
   BT_error,
   BT_C,
-  BT_F77 /**< ansi f77, unimplemented */
+  BT_F77, /**< ansi f77, unimplemented */
+  BT_JIT  /**< native code generated in-process, see bintoken_jit.h */
 };
 
 /**
@@ -81,6 +82,34 @@ ASC_DLLSPEC int BinTokenSetOptions(
 	,int verbose, int housekeep
 );
 
+/**
+	Select in-process native code generation (BT_JIT) for relations, so
+	that no external C compiler is needed. This replaces any options set
+	with BinTokenSetOptions, and vice versa.
+
+	@param cachename  file in which generated code is kept between runs,
+	                  keyed by a hash of each relation share, or NULL for
+	                  no disk cache. The file is read again at the next
+	                  build after each call.
+	@param maxreln    largest number of relations to compile at one time;
+	                  0 disables binary tokens.
+	@return 0 on success, 1 if BT_JIT is not available on this platform
+	        (in which case binary tokens are disabled).
+*/
+ASC_DLLSPEC int BinTokenSetJITOptions(CONST char *cachename, unsigned long maxreln);
+
+/**
+	Return the method selected by the last call to BinTokenSetOptions
+	(BT_C) or BinTokenSetJITOptions (BT_JIT).
+*/
+ASC_DLLSPEC enum bintoken_kind BinTokenGetMethod(void);
+
+/**
+	@return the number of relations whose code the last BT_JIT build
+	found in the cache rather than generating it.
+*/
+ASC_DLLSPEC unsigned long BinTokenJITCacheHits(void);
+
 /**
  * Frees global data allocated during loading.
  * Do not call any previously loaded functions after this is
@@ -0,0 +1,1019 @@
+/*	ASCEND modelling environment
+	Copyright (C) 2015 Carnegie Mellon University
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2, or (at your option)
+	any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*//** @file
+	In-process native code generation for binary tokens.
+	@see bintoken_jit.h
+*/
+
+#include "bintoken_jit.h"
+
+#include <ascend/general/ascMalloc.h>
+#include <ascend/general/panic.h>
+#include <ascend/general/list.h>
+#include <ascend/utilities/error.h>
+
+#include "functype.h"
+#include "func.h"
+#include "expr_types.h"
+#include "instance_enum.h"
+#include "vlist.h"
+#include "find.h"
+#include "rel_blackbox.h"
+#include "relation.h"
+#include "relation_util.h"
+#include "mathinst.h"
+#include "rel_opcode.h"
+
+/* #define BTJIT_DEBUG */
+
+#if defined(__x86_64__) && !defined(_WIN32) \
+	&& (defined(__linux__) || defined(__APPLE__) || defined(__FreeBSD__))
+# define BTJIT_X86_64 1
+#endif
+
+#ifdef BTJIT_X86_64
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+/** Largest number of opcodes we will put in one stack frame. */
+#define BTJIT_MAXINSTR 8192
+
+/* fixed slots of the external function table */
+enum btjit_ftab {
+	FT_POW,
+	FT_LOG,
+	FT_IPOW,
+	FT_D1IPOW,
+	FT_FUNC0 /* value of func i at FT_FUNC0+2i, derivative at FT_FUNC0+2i+1 */
+};
+
+/* x86-64 register numbers */
+#define RAX 0
+#define RBX 3
+#define RBP 5
+#define EDI 7
+
+/* SSE2 scalar double opcodes (F2 0F xx) */
+#define SD_LOAD 0x10
+#define SD_STORE 0x11
+#define SD_ADD 0x58
+#define SD_MUL 0x59
+#define SD_SUB 0x5C
+#define SD_DIV 0x5E
+
+/* stack frame layout, offsets from rbp */
+#define S_RES 0
+#define S_GRAD 8
+#define S_FTAB 16
+#define S_TMP 24
+#define S_REG0 32
+
+/** Native code for one relation share, before loading. */
+struct btjit_code {
+	uint64_t key;
+	uint64_t check;
+	unsigned char *bytes;
+	uint32_t len;
+	uint32_t gradoff;  /**< offset of the gradient function */
+	uint32_t nfunc;
+	uint32_t *funcids; /**< enum Func_enum for each ASCEND function used */
+};
+
+/*------------------------------------------------------------------------------
+  CODE BUFFER
+*/
+
+struct btjit_buf {
+	unsigned char *b;
+	unsigned long len, cap;
+	/* constant pool, with rip-relative fixups into the code */
+	double *consts;
+	int nconst, capconst;
+	unsigned long *fixpos;
+	int *fixconst;
+	int nfix, capfix;
+	/* adjoint bookkeeping for the reverse sweep */
+	char *adjset;
+	char *gradset;
+	/* register file slot offsets */
+	long reg0, adj0;
+};
+
+static void bj_byte(struct btjit_buf *j, unsigned c){
+	if(j->len >= j->cap){
+		j->cap = 2*j->cap + 256;
+		j->b = (unsigned char *)ascrealloc(j->b, j->cap);
+	}
+	j->b[j->len++] = (unsigned char)c;
+}
+
+static void bj_u32(struct btjit_buf *j, uint32_t v){
+	bj_byte(j, v & 0xff);
+	bj_byte(j, (v >> 8) & 0xff);
+	bj_byte(j, (v >> 16) & 0xff);
+	bj_byte(j, (v >> 24) & 0xff);
+}
+
+/** modrm for [base + disp32] with register field reg */
+static void bj_mem(struct btjit_buf *j, int reg, int base, long disp){
+	bj_byte(j, 0x80 | (reg << 3) | base);
+	bj_u32(j, (uint32_t)(int32_t)disp);
+}
+
+/** scalar double op xmm, [base + disp] */
+static void bj_sd_mem(struct btjit_buf *j, int op, int xmm, int base, long disp){
+	bj_byte(j, 0xF2); bj_byte(j, 0x0F); bj_byte(j, op);
+	bj_mem(j, xmm, base, disp);
+}
+
+/** scalar double op xmmdst, xmmsrc */
+static void bj_sd_rr(struct btjit_buf *j, int op, int dst, int src){
+	bj_byte(j, 0xF2); bj_byte(j, 0x0F); bj_byte(j, op);
+	bj_byte(j, 0xC0 | (dst << 3) | src);
+}
+
+/** xorpd xmmdst, xmmsrc */
+static void bj_xorpd(struct btjit_buf *j, int dst, int src){
+	bj_byte(j, 0x66); bj_byte(j, 0x0F); bj_byte(j, 0x57);
+	bj_byte(j, 0xC0 | (dst << 3) | src);
+}
+
+/** movapd xmmdst, xmmsrc */
+static void bj_movapd(struct btjit_buf *j, int dst, int src){
+	bj_byte(j, 0x66); bj_byte(j, 0x0F); bj_byte(j, 0x28);
+	bj_byte(j, 0xC0 | (dst << 3) | src);
+}
+
+static int bj_const(struct btjit_buf *j, double v){
+	int i;
+	for(i = 0; i < j->nconst; ++i){
+		if(memcmp(&(j->consts[i]), &v, sizeof(double)) == 0)return i;
+	}
+	if(j->nconst >= j->capconst){
+		j->capconst = 2*j->capconst + 16;
+		j->consts = (double *)ascrealloc(j->consts, j->capconst*sizeof(double));
+	}
+	j->consts[j->nconst] = v;
+	return j->nconst++;
+}
+
+/** movsd xmm, [rip + constant] */
+static void bj_load_const(struct btjit_buf *j, int xmm, double v){
+	int ci = bj_const(j, v);
+	bj_byte(j, 0xF2); bj_byte(j, 0x0F); bj_byte(j, SD_LOAD);
+	bj_byte(j, (xmm << 3) | 5);
+	if(j->nfix >= j->capfix){
+		j->capfix = 2*j->capfix + 16;
+		j->fixpos = (unsigned long *)ascrealloc(j->fixpos, j->capfix*sizeof(unsigned long));
+		j->fixconst = (int *)ascrealloc(j->fixconst, j->capfix*sizeof(int));
+	}
+	j->fixpos[j->nfix] = j->len;
+	j->fixconst[j->nfix] = ci;
+	j->nfix++;
+	bj_u32(j, 0);
+}
+
+#define LOAD_R(J,X,K) bj_sd_mem((J),SD_LOAD,(X),RBP,(J)->reg0 + 8*(long)(K))
+#define LOAD_X(J,X,V) bj_sd_mem((J),SD_LOAD,(X),RBX,8*(long)(V))
+#define LOAD_ADJ(J,X,K) bj_sd_mem((J),SD_LOAD,(X),RBP,(J)->adj0 + 8*(long)(K))
+#define STORE_R(J,X,K) bj_sd_mem((J),SD_STORE,(X),RBP,(J)->reg0 + 8*(long)(K))
+#define STORE_ADJ(J,X,K) bj_sd_mem((J),SD_STORE,(X),RBP,(J)->adj0 + 8*(long)(K))
+
+/** call [ftab + 8*slot], ftab being kept in the frame */
+static void bj_call(struct btjit_buf *j, int slot){
+	bj_byte(j, 0x48); bj_byte(j, 0x8B); bj_mem(j, RAX, RBP, S_FTAB); /* mov rax,[rbp+S_FTAB] */
+	bj_byte(j, 0xFF); bj_mem(j, 2, RAX, 8*(long)slot);           /* call [rax+8*slot] */
+}
+
+/** edi = (int)r[k], truncating like a C cast */
+static void bj_int_arg_reg(struct btjit_buf *j, int k){
+	bj_byte(j, 0xF2); bj_byte(j, 0x0F); bj_byte(j, 0x2C);
+	bj_mem(j, EDI, RBP, j->reg0 + 8*(long)k);
+}
+
+static void bj_int_arg_imm(struct btjit_buf *j, int v){
+	bj_byte(j, 0xB8 + EDI);
+	bj_u32(j, (uint32_t)v);
+}
+
+static void bj_prologue(struct btjit_buf *j, long frame, int grad){
+	bj_byte(j, 0x53);                             /* push rbx */
+	bj_byte(j, 0x55);                             /* push rbp */
+	bj_byte(j, 0x48); bj_byte(j, 0x81); bj_byte(j, 0xEC); bj_u32(j, (uint32_t)frame); /* sub rsp,frame */
+	bj_byte(j, 0x48); bj_byte(j, 0x89); bj_byte(j, 0xE5); /* mov rbp,rsp */
+	bj_byte(j, 0x48); bj_byte(j, 0x89); bj_byte(j, 0xFB); /* mov rbx,rdi */
+	bj_byte(j, 0x48); bj_byte(j, 0x89); bj_mem(j, 6, RBP, S_RES); /* mov [rbp+S_RES],rsi */
+	if(grad){
+		bj_byte(j, 0x48); bj_byte(j, 0x89); bj_mem(j, 2, RBP, S_GRAD); /* rdx */
+		bj_byte(j, 0x48); bj_byte(j, 0x89); bj_mem(j, 1, RBP, S_FTAB); /* rcx */
+	}else{
+		bj_byte(j, 0x48); bj_byte(j, 0x89); bj_mem(j, 2, RBP, S_FTAB); /* rdx */
+	}
+}
+
+static void bj_epilogue(struct btjit_buf *j, long frame){
+	bj_byte(j, 0x48); bj_byte(j, 0x81); bj_byte(j, 0xC4); bj_u32(j, (uint32_t)frame); /* add rsp,frame */
+	bj_byte(j, 0x5D);                             /* pop rbp */
+	bj_byte(j, 0x5B);                             /* pop rbx */
+	bj_byte(j, 0xC3);                             /* ret */
+}
+
+/** frame size for n registers (doubled for the gradient), keeping rsp
+	16-byte aligned at calls: two pushes + return address + frame. */
+static long bj_frame(int n, int grad){
+	long f = S_REG0 + 8L*n*(grad ? 2 : 1);
+	if(f % 16 != 8)f += 8;
+	return f;
+}
+
+/** *residual = r[n-1] */
+static void bj_store_residual(struct btjit_buf *j, int n){
+	LOAD_R(j, 0, n - 1);
+	bj_byte(j, 0x48); bj_byte(j, 0x8B); bj_mem(j, RAX, RBP, S_RES);
+	bj_sd_mem(j, SD_STORE, 0, RAX, 0);
+}
+
+/*------------------------------------------------------------------------------
+  FORWARD SWEEP
+*/
+
+static void bj_forward(struct btjit_buf *j, CONST struct RelOpCodes *p){
+	CONST struct RelOpInstr *i;
+	CONST double *c = p->constants;
+	int k;
+	for(k = 0; k < p->ninstr; ++k){
+		i = &(p->code[k]);
+		switch(i->op){
+		case ROP_VAR:   LOAD_X(j, 0, i->a); break;
+		case ROP_CONST: bj_load_const(j, 0, c[i->a]); break;
+		case ROP_ADD:   LOAD_R(j, 0, i->a); bj_sd_mem(j, SD_ADD, 0, RBP, j->reg0 + 8L*i->b); break;
+		case ROP_SUB:   LOAD_R(j, 0, i->a); bj_sd_mem(j, SD_SUB, 0, RBP, j->reg0 + 8L*i->b); break;
+		case ROP_MUL:   LOAD_R(j, 0, i->a); bj_sd_mem(j, SD_MUL, 0, RBP, j->reg0 + 8L*i->b); break;
+		case ROP_DIV:   LOAD_R(j, 0, i->a); bj_sd_mem(j, SD_DIV, 0, RBP, j->reg0 + 8L*i->b); break;
+		case ROP_ADDV:  LOAD_R(j, 0, i->a); bj_sd_mem(j, SD_ADD, 0, RBX, 8L*i->b); break;
+		case ROP_SUBV:  LOAD_R(j, 0, i->a); bj_sd_mem(j, SD_SUB, 0, RBX, 8L*i->b); break;
+		case ROP_MULV:  LOAD_R(j, 0, i->a); bj_sd_mem(j, SD_MUL, 0, RBX, 8L*i->b); break;
+		case ROP_DIVV:  LOAD_R(j, 0, i->a); bj_sd_mem(j, SD_DIV, 0, RBX, 8L*i->b); break;
+		case ROP_ADDC:  LOAD_R(j, 0, i->a); bj_load_const(j, 1, c[i->b]); bj_sd_rr(j, SD_ADD, 0, 1); break;
+		case ROP_SUBC:  LOAD_R(j, 0, i->a); bj_load_const(j, 1, c[i->b]); bj_sd_rr(j, SD_SUB, 0, 1); break;
+		case ROP_MULC:  LOAD_R(j, 0, i->a); bj_load_const(j, 1, c[i->b]); bj_sd_rr(j, SD_MUL, 0, 1); break;
+		case ROP_DIVC:  LOAD_R(j, 0, i->a); bj_load_const(j, 1, c[i->b]); bj_sd_rr(j, SD_DIV, 0, 1); break;
+		case ROP_RSUBC: bj_load_const(j, 0, c[i->b]); bj_sd_mem(j, SD_SUB, 0, RBP, j->reg0 + 8L*i->a); break;
+		case ROP_RDIVC: bj_load_const(j, 0, c[i->b]); bj_sd_mem(j, SD_DIV, 0, RBP, j->reg0 + 8L*i->a); break;
+		case ROP_POW:   LOAD_R(j, 0, i->a); LOAD_R(j, 1, i->b); bj_call(j, FT_POW); break;
+		case ROP_POWC:  LOAD_R(j, 0, i->a); bj_load_const(j, 1, c[i->b]); bj_call(j, FT_POW); break;
+		case ROP_IPOW:  LOAD_R(j, 0, i->a); bj_int_arg_reg(j, i->b); bj_call(j, FT_IPOW); break;
+		case ROP_IPOWI: LOAD_R(j, 0, i->a); bj_int_arg_imm(j, i->b); bj_call(j, FT_IPOW); break;
+		case ROP_NEG:   LOAD_R(j, 0, i->a); bj_load_const(j, 1, -0.0); bj_xorpd(j, 0, 1); break;
+		case ROP_FUNC:  LOAD_R(j, 0, i->a); bj_call(j, FT_FUNC0 + 2*i->b); break;
+		default:
+			ASC_PANIC("Invalid opcode %d", i->op);
+		}
+		STORE_R(j, 0, k);
+	}
+}
+
+/*------------------------------------------------------------------------------
+  REVERSE SWEEP
+*/
+
+/* adj[t] += xmm0 */
+static void bj_adj_add(struct btjit_buf *j, int t){
+	if(j->adjset[t]){
+		bj_sd_mem(j, SD_ADD, 0, RBP, j->adj0 + 8L*t);
+	}
+	STORE_ADJ(j, 0, t);
+	j->adjset[t] = 1;
+}
+
+/* adj[t] -= xmm0 */
+static void bj_adj_sub(struct btjit_buf *j, int t){
+	if(j->adjset[t]){
+		LOAD_ADJ(j, 1, t);
+	}else{
+		bj_xorpd(j, 1, 1);
+	}
+	bj_sd_rr(j, SD_SUB, 1, 0);
+	STORE_ADJ(j, 1, t);
+	j->adjset[t] = 1;
+}
+
+/* grad[v] += xmm0, or -= if sub */
+static void bj_grad(struct btjit_buf *j, int v, int sub){
+	bj_byte(j, 0x48); bj_byte(j, 0x8B); bj_mem(j, RAX, RBP, S_GRAD);
+	if(sub){
+		if(j->gradset[v]){
+			bj_sd_mem(j, SD_LOAD, 1, RAX, 8L*v);
+		}else{
+			bj_xorpd(j, 1, 1);
+		}
+		bj_sd_rr(j, SD_SUB, 1, 0);
+		bj_sd_mem(j, SD_STORE, 1, RAX, 8L*v);
+	}else{
+		if(j->gradset[v]){
+			bj_sd_mem(j, SD_ADD, 0, RAX, 8L*v);
+		}
+		bj_sd_mem(j, SD_STORE, 0, RAX, 8L*v);
+	}
+	j->gradset[v] = 1;
+}
+
+/* adj[b] += w * log(r[a]) * r[k], for the exponent of pow */
+static void bj_dpow_exponent(struct btjit_buf *j, int k, int a, int b){
+	LOAD_R(j, 0, a);
+	bj_call(j, FT_LOG);
+	LOAD_ADJ(j, 1, k);
+	bj_sd_rr(j, SD_MUL, 1, 0);
+	bj_sd_mem(j, SD_MUL, 1, RBP, j->reg0 + 8L*k);
+	bj_movapd(j, 0, 1);
+	bj_adj_add(j, b);
+}
+
+static void bj_reverse(struct btjit_buf *j, CONST struct RelOpCodes *p){
+	CONST struct RelOpInstr *i;
+	CONST double *c = p->constants;
+	int k;
+	unsigned long v;
+
+	bj_load_const(j, 0, 1.0);
+	STORE_ADJ(j, 0, p->ninstr - 1);
+	j->adjset[p->ninstr - 1] = 1;
+
+	for(k = p->ninstr - 1; k >= 0; --k){
+		if(!j->adjset[k])continue; /* dead value */
+		i = &(p->code[k]);
+#define W LOAD_ADJ(j, 0, k)
+#define MULR(X,R) bj_sd_mem(j, SD_MUL, (X), RBP, j->reg0 + 8L*(R))
+#define DIVR(X,R) bj_sd_mem(j, SD_DIV, (X), RBP, j->reg0 + 8L*(R))
+		switch(i->op){
+		case ROP_VAR:   W; bj_grad(j, i->a, 0); break;
+		case ROP_CONST: break;
+		case ROP_ADD:   W; bj_adj_add(j, i->a); W; bj_adj_add(j, i->b); break;
+		case ROP_SUB:   W; bj_adj_add(j, i->a); W; bj_adj_sub(j, i->b); break;
+		case ROP_MUL:
+			W; MULR(0, i->b); bj_adj_add(j, i->a);
+			W; MULR(0, i->a); bj_adj_add(j, i->b);
+			break;
+		case ROP_DIV:
+			W; DIVR(0, i->b); bj_adj_add(j, i->a);
+			W; MULR(0, k); DIVR(0, i->b); bj_adj_sub(j, i->b);
+			break;
+		case ROP_ADDV:  W; bj_adj_add(j, i->a); W; bj_grad(j, i->b, 0); break;
+		case ROP_SUBV:  W; bj_adj_add(j, i->a); W; bj_grad(j, i->b, 1); break;
+		case ROP_MULV:
+			W; bj_sd_mem(j, SD_MUL, 0, RBX, 8L*i->b); bj_adj_add(j, i->a);
+			W; MULR(0, i->a); bj_grad(j, i->b, 0);
+			break;
+		case ROP_DIVV:
+			W; bj_sd_mem(j, SD_DIV, 0, RBX, 8L*i->b); bj_adj_add(j, i->a);
+			W; MULR(0, k); bj_sd_mem(j, SD_DIV, 0, RBX, 8L*i->b); bj_grad(j, i->b, 1);
+			break;
+		case ROP_ADDC:
+		case ROP_SUBC:  W; bj_adj_add(j, i->a); break;
+		case ROP_MULC:  W; bj_load_const(j, 1, c[i->b]); bj_sd_rr(j, SD_MUL, 0, 1); bj_adj_add(j, i->a); break;
+		case ROP_DIVC:  W; bj_load_const(j, 1, c[i->b]); bj_sd_rr(j, SD_DIV, 0, 1); bj_adj_add(j, i->a); break;
+		case ROP_RSUBC: W; bj_adj_sub(j, i->a); break;
+		case ROP_RDIVC: W; MULR(0, k); DIVR(0, i->a); bj_adj_sub(j, i->a); break;
+		case ROP_POW:
+			/* adj[a] += w * r[b] * pow(r[a], r[b] - 1) */
+			LOAD_R(j, 0, i->a); LOAD_R(j, 1, i->b);
+			bj_load_const(j, 2, 1.0); bj_sd_rr(j, SD_SUB, 1, 2);
+			bj_call(j, FT_POW);
+			bj_sd_mem(j, SD_STORE, 0, RBP, S_TMP);
+			W; MULR(0, i->b); bj_sd_mem(j, SD_MUL, 0, RBP, S_TMP);
+			bj_adj_add(j, i->a);
+			bj_dpow_exponent(j, k, i->a, i->b);
+			break;
+		case ROP_POWC:
+			LOAD_R(j, 0, i->a); bj_load_const(j, 1, c[i->b] - 1.0);
+			bj_call(j, FT_POW);
+			bj_sd_mem(j, SD_STORE, 0, RBP, S_TMP);
+			W; bj_load_const(j, 1, c[i->b]); bj_sd_rr(j, SD_MUL, 0, 1);
+			bj_sd_mem(j, SD_MUL, 0, RBP, S_TMP);
+			bj_adj_add(j, i->a);
+			break;
+		case ROP_IPOW:
+			LOAD_R(j, 0, i->a); bj_int_arg_reg(j, i->b);
+			bj_call(j, FT_D1IPOW);
+			bj_sd_mem(j, SD_STORE, 0, RBP, S_TMP);
+			W; bj_sd_mem(j, SD_MUL, 0, RBP, S_TMP);
+			bj_adj_add(j, i->a);
+			bj_dpow_exponent(j, k, i->a, i->b);
+			break;
+		case ROP_IPOWI:
+			LOAD_R(j, 0, i->a); bj_int_arg_imm(j, i->b);
+			bj_call(j, FT_D1IPOW);
+			bj_sd_mem(j, SD_STORE, 0, RBP, S_TMP);
+			W; bj_sd_mem(j, SD_MUL, 0, RBP, S_TMP);
+			bj_adj_add(j, i->a);
+			break;
+		case ROP_NEG:   W; bj_adj_sub(j, i->a); break;
+		case ROP_FUNC:
+			LOAD_R(j, 0, i->a);
+			bj_call(j, FT_FUNC0 + 2*i->b + 1);
+			bj_sd_mem(j, SD_STORE, 0, RBP, S_TMP);
+			W; bj_sd_mem(j, SD_MUL, 0, RBP, S_TMP);
+			bj_adj_add(j, i->a);
+			break;
+		default:
+			ASC_PANIC("Invalid opcode %d", i->op);
+		}
+#undef W
+#undef MULR
+#undef DIVR
+	}
+
+	/* variables that do not appear get a zero derivative */
+	for(v = 0; v < p->nvars; ++v){
+		if(!j->gradset[v]){
+			bj_xorpd(j, 0, 0);
+			bj_grad(j, (int)v, 0);
+		}
+	}
+}
+
+/**
+	Translate a compiled relation to machine code.
+	@return 0 on success, 1 if the relation is too big for us.
+*/
+static int btjit_emit(CONST struct RelOpCodes *p, struct btjit_code *out){
+	struct btjit_buf j;
+	long frame;
+	unsigned long pool;
+	int f;
+
+	if(p->ninstr > BTJIT_MAXINSTR)return 1;
+
+	memset(&j, 0, sizeof(j));
+	j.adjset = ASC_NEW_ARRAY_CLEAR(char, p->ninstr);
+	j.gradset = ASC_NEW_ARRAY_CLEAR(char, p->nvars + 1);
+	j.reg0 = S_REG0;
+
+	/* residual */
+	frame = bj_frame(p->ninstr, 0);
+	bj_prologue(&j, frame, 0);
+	bj_forward(&j, p);
+	bj_store_residual(&j, p->ninstr);
+	bj_epilogue(&j, frame);
+
+	/* gradient */
+	while(j.len % 16)bj_byte(&j, 0x90);
+	out->gradoff = (uint32_t)j.len;
+	frame = bj_frame(p->ninstr, 1);
+	j.adj0 = S_REG0 + 8L*p->ninstr;
+	bj_prologue(&j, frame, 1);
+	bj_forward(&j, p);
+	bj_store_residual(&j, p->ninstr);
+	bj_reverse(&j, p);
+	bj_epilogue(&j, frame);
+
+	/* constant pool after the code, then resolve rip-relative loads */
+	while(j.len % 8)bj_byte(&j, 0xCC);
+	pool = j.len;
+	for(f = 0; f < j.nconst; ++f){
+		unsigned char tmp[sizeof(double)];
+		unsigned s;
+		memcpy(tmp, &(j.consts[f]), sizeof(double));
+		for(s = 0; s < sizeof(double); ++s)bj_byte(&j, tmp[s]);
+	}
+	for(f = 0; f < j.nfix; ++f){
+		int32_t disp = (int32_t)((long)(pool + 8*j.fixconst[f]) - (long)(j.fixpos[f] + 4));
+		memcpy(j.b + j.fixpos[f], &disp, 4);
+	}
+
+	out->bytes = j.b;
+	out->len = (uint32_t)j.len;
+	out->nfunc = (uint32_t)p->nfunc;
+	out->funcids = NULL;
+	if(p->nfunc){
+		out->funcids = ASC_NEW_ARRAY(uint32_t, p->nfunc);
+		for(f = 0; f < p->nfunc; ++f){
+			out->funcids[f] = (uint32_t)FuncId(p->funcs[f]);
+		}
+	}
+	if(j.consts)ASC_FREE(j.consts);
+	if(j.fixpos)ASC_FREE(j.fixpos);
+	if(j.fixconst)ASC_FREE(j.fixconst);
+	ASC_FREE(j.adjset);
+	ASC_FREE(j.gradset);
+#ifdef BTJIT_DEBUG
+	CONSOLE_DEBUG("%d opcodes -> %u bytes", p->ninstr, out->len);
+#endif
+	return 0;
+}
+
+static void btjit_code_free(struct btjit_code *c){
+	if(c == NULL)return;
+	if(c->bytes)ASC_FREE(c->bytes);
+	if(c->funcids)ASC_FREE(c->funcids);
+	ASC_FREE(c);
+}
+
+/*------------------------------------------------------------------------------
+  SHARE HASHING
+*/
+
+#define FNV_OFFSET 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+static void btjit_hash(uint64_t *h, uint64_t *check, CONST void *data, unsigned long n){
+	CONST unsigned char *d = (CONST unsigned char *)data;
+	unsigned long i;
+	for(i = 0; i < n; ++i){
+		*h = (*h ^ d[i]) * FNV_PRIME;
+		*check = (*check * 33) + d[i] + 1;
+	}
+}
+
+static void btjit_hash_side(uint64_t *h, uint64_t *check, CONST struct relation *r, int lhs){
+	CONST struct relation_term *term;
+	unsigned long t, len;
+	long lval;
+	double dval;
+	int type;
+
+	len = RelationLength(r, lhs);
+	btjit_hash(h, check, &len, sizeof(len));
+	for(t = 0; t < len; ++t){
+		term = NewRelationTerm(r, t, lhs);
+		type = (int)RelationTermType(term);
+		btjit_hash(h, check, &type, sizeof(type));
+		switch(RelationTermType(term)){
+		case e_real:
+			dval = TermReal(term);
+			btjit_hash(h, check, &dval, sizeof(dval));
+			break;
+		case e_int:
+			lval = TermInteger(term);
+			btjit_hash(h, check, &lval, sizeof(lval));
+			break;
+		case e_var:
+			lval = (long)TermVarNumber(term);
+			btjit_hash(h, check, &lval, sizeof(lval));
+			break;
+		case e_func:
+			lval = (long)FuncId(TermFunc(term));
+			btjit_hash(h, check, &lval, sizeof(lval));
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+/** Key of a token relation share, and a second independent checksum. */
+static void btjit_share_key(CONST struct relation *r, uint64_t *key, uint64_t *check){
+	*key = FNV_OFFSET;
+	*check = 5381;
+	btjit_hash_side(key, check, r, 1);
+	btjit_hash_side(key, check, r, 0);
+}
+
+/*------------------------------------------------------------------------------
+  CODE CACHE
+
+  In memory, a list of btjit_code sorted by key. On disk, a header of
+    magic, BTJIT_VERSION, number of records (uint32), hash, check (uint64)
+  followed by records of
+    key, check (uint64), len, gradoff, nfunc (uint32), funcids, code bytes
+  where hash and check are taken over all the records. The file is only
+  used if all of that agrees, since its contents will be run as code. It
+  is rewritten whole, through a temporary file renamed over the old one,
+  so that other processes reading it never see half a file; if two write
+  at once, the records of one are lost and simply generated again later.
+*/
+
+#define BTJIT_MAGIC "ASCJIT01x86-64sysv"
+
+/** Change this whenever btjit_emit or the cache layout changes. */
+#define BTJIT_VERSION 2
+
+#define BTJIT_HEADERSIZE (sizeof(BTJIT_MAGIC) + 2*sizeof(uint32_t) + 2*sizeof(uint64_t))
+
+static struct gl_list_t *g_btjit_cache = NULL;
+static char *g_btjit_cachename = NULL;
+
+static int btjit_cmp(CONST struct btjit_code *a, CONST struct btjit_code *b){
+	if(a->key < b->key)return -1;
+	if(a->key > b->key)return 1;
+	if(a->check < b->check)return -1;
+	if(a->check > b->check)return 1;
+	return 0;
+}
+
+static struct btjit_code *btjit_cache_find(uint64_t key, uint64_t check){
+	struct btjit_code test;
+	unsigned long pos;
+	if(g_btjit_cache == NULL)return NULL;
+	test.key = key;
+	test.check = check;
+	pos = gl_search(g_btjit_cache, &test, (CmpFunc)btjit_cmp);
+	if(pos == 0)return NULL;
+	return (struct btjit_code *)gl_fetch(g_btjit_cache, pos);
+}
+
+static void btjit_cache_add(struct btjit_code *c){
+	if(g_btjit_cache == NULL){
+		g_btjit_cache = gl_create(100L);
+	}
+	gl_insert_sorted(g_btjit_cache, c, (CmpFunc)btjit_cmp);
+}
+
+void BinTokenJITClearCache(void){
+	if(g_btjit_cache != NULL){
+		gl_iterate(g_btjit_cache, (void (*)(VOIDPTR))btjit_code_free);
+		gl_destroy(g_btjit_cache);
+		g_btjit_cache = NULL;
+	}
+	if(g_btjit_cachename != NULL){
+		ASC_FREE(g_btjit_cachename);
+		g_btjit_cachename = NULL;
+	}
+}
+
+/** Copy n bytes out of the buffer at *pos, if there are that many left. */
+static int btjit_take(void *dst, unsigned long n, CONST unsigned char *buf
+		, unsigned long size, unsigned long *pos
+){
+	if(n > size - *pos)return 1;
+	memcpy(dst, buf + *pos, n);
+	*pos += n;
+	return 0;
+}
+
+static struct btjit_code *btjit_read_record(CONST unsigned char *buf
+		, unsigned long size, unsigned long *pos
+){
+	struct btjit_code *c;
+	uint32_t hdr[3];
+	uint64_t kc[2];
+	if(btjit_take(kc, sizeof(kc), buf, size, pos)
+		|| btjit_take(hdr, sizeof(hdr), buf, size, pos)
+	){
+		return NULL;
+	}
+	if(hdr[0] == 0 || hdr[0] > (1U<<26) || hdr[1] >= hdr[0] || hdr[2] > 10000){
+		return NULL;
+	}
+	c = ASC_NEW(struct btjit_code);
+	c->key = kc[0];
+	c->check = kc[1];
+	c->len = hdr[0];
+	c->gradoff = hdr[1];
+	c->nfunc = hdr[2];
+	c->funcids = NULL;
+	if(c->nfunc){
+		c->funcids = ASC_NEW_ARRAY(uint32_t, c->nfunc);
+	}
+	c->bytes = ASC_NEW_ARRAY(unsigned char, c->len);
+	if((c->nfunc && btjit_take(c->funcids, sizeof(uint32_t)*c->nfunc, buf, size, pos))
+		|| btjit_take(c->bytes, c->len, buf, size, pos)
+	){
+		btjit_code_free(c);
+		return NULL;
+	}
+	return c;
+}
+
+/**
+	Read the whole of a cache file into memory and check its header.
+	@return the records, with their number in *nrec and length in *size,
+	or NULL if the file is missing, empty or invalid.
+*/
+static unsigned char *btjit_read_file(CONST char *cachename
+		, unsigned long *size, uint32_t *nrec
+){
+	FILE *fp;
+	long fsize;
+	unsigned char *buf;
+	char magic[sizeof(BTJIT_MAGIC)];
+	uint32_t vn[2];
+	uint64_t hc[2], h = FNV_OFFSET, check = 5381;
+
+	fp = fopen(cachename, "rb");
+	if(fp == NULL)return NULL;
+	if(fseek(fp, 0L, SEEK_END) != 0 || (fsize = ftell(fp)) <= 0){
+		fclose(fp); /* an empty file is a new cache */
+		return NULL;
+	}
+	rewind(fp);
+	if((unsigned long)fsize < BTJIT_HEADERSIZE
+		|| fread(magic, 1, sizeof(magic), fp) != sizeof(magic)
+		|| memcmp(magic, BTJIT_MAGIC, sizeof(magic)) != 0
+		|| fread(vn, sizeof(uint32_t), 2, fp) != 2
+		|| vn[0] != BTJIT_VERSION
+		|| fread(hc, sizeof(uint64_t), 2, fp) != 2
+	){
+		fclose(fp);
+		ERROR_REPORTER_HERE(ASC_PROG_WARNING,"Ignoring invalid JIT cache file '%s'",cachename);
+		return NULL;
+	}
+	*size = (unsigned long)fsize - BTJIT_HEADERSIZE;
+	*nrec = vn[1];
+	buf = ASC_NEW_ARRAY(unsigned char, *size + 1);
+	if(fread(buf, 1, *size, fp) != *size){
+		*size = 0;
+	}
+	fclose(fp);
+	btjit_hash(&h, &check, buf, *size);
+	if(*size == 0 || h != hc[0] || check != hc[1]){
+		ERROR_REPORTER_HERE(ASC_PROG_WARNING,"Ignoring corrupt JIT cache file '%s'",cachename);
+		ASC_FREE(buf);
+		return NULL;
+	}
+	return buf;
+}
+
+/** Read the disk cache into memory, once per cache file name. */
+static void btjit_cache_load(CONST char *cachename){
+	unsigned char *buf;
+	unsigned long size, pos = 0;
+	uint32_t nrec, n;
+	struct btjit_code *c;
+	struct gl_list_t *recs;
+
+	if(g_btjit_cachename != NULL && strcmp(g_btjit_cachename, cachename) == 0){
+		return; /* already loaded, and kept up to date as we add */
+	}
+	BinTokenJITClearCache();
+	g_btjit_cachename = ASC_STRDUP(cachename);
+	buf = btjit_read_file(cachename, &size, &nrec);
+	if(buf == NULL)return;
+
+	/* take all of the records or none of them */
+	recs = gl_create(nrec > 0 && nrec < 100000 ? nrec : 100L);
+	for(n = 0; n < nrec; ++n){
+		if((c = btjit_read_record(buf, size, &pos)) == NULL)break;
+		gl_append_ptr(recs, c);
+	}
+	ASC_FREE(buf);
+	if(n < nrec || pos != size){
+		ERROR_REPORTER_HERE(ASC_PROG_WARNING,"Ignoring corrupt JIT cache file '%s'",cachename);
+		gl_iterate(recs, (void (*)(VOIDPTR))btjit_code_free);
+		gl_destroy(recs);
+		return;
+	}
+	for(n = 1; n <= gl_length(recs); ++n){
+		c = (struct btjit_code *)gl_fetch(recs, n);
+		if(btjit_cache_find(c->key, c->check) == NULL){
+			btjit_cache_add(c);
+		}else{
+			btjit_code_free(c);
+		}
+	}
+	gl_destroy(recs);
+#ifdef BTJIT_DEBUG
+	CONSOLE_DEBUG("Loaded %lu relations from JIT cache '%s'", (unsigned long)nrec, cachename);
+#endif
+}
+
+/** Write the whole in-memory cache to disk, if anything is new. */
+static void btjit_cache_save(CONST char *cachename, struct gl_list_t *newcode){
+	FILE *fp;
+	struct btjit_code *c;
+	unsigned char *buf;
+	char *tmpname;
+	uint32_t hdr[3], vn[2];
+	uint64_t kc[2], hc[2];
+	unsigned long i, n, size = 0, pos = 0;
+	int fd, err;
+
+	if(gl_length(newcode) == 0 || g_btjit_cache == NULL)return;
+	n = gl_length(g_btjit_cache);
+	for(i = 1; i <= n; ++i){
+		c = (struct btjit_code *)gl_fetch(g_btjit_cache, i);
+		size += sizeof(kc) + sizeof(hdr) + sizeof(uint32_t)*c->nfunc + c->len;
+	}
+	buf = ASC_NEW_ARRAY(unsigned char, size);
+	for(i = 1; i <= n; ++i){
+		c = (struct btjit_code *)gl_fetch(g_btjit_cache, i);
+		kc[0] = c->key;
+		kc[1] = c->check;
+		hdr[0] = c->len;
+		hdr[1] = c->gradoff;
+		hdr[2] = c->nfunc;
+		memcpy(buf + pos, kc, sizeof(kc));
+		pos += sizeof(kc);
+		memcpy(buf + pos, hdr, sizeof(hdr));
+		pos += sizeof(hdr);
+		if(c->nfunc){
+			memcpy(buf + pos, c->funcids, sizeof(uint32_t)*c->nfunc);
+			pos += sizeof(uint32_t)*c->nfunc;
+		}
+		memcpy(buf + pos, c->bytes, c->len);
+		pos += c->len;
+	}
+	vn[0] = BTJIT_VERSION;
+	vn[1] = (uint32_t)n;
+	hc[0] = FNV_OFFSET;
+	hc[1] = 5381;
+	btjit_hash(&hc[0], &hc[1], buf, size);
+
+	tmpname = ASC_NEW_ARRAY(char, strlen(cachename) + 8);
+	sprintf(tmpname, "%s.XXXXXX", cachename);
+	fd = mkstemp(tmpname);
+	fp = (fd == -1) ? NULL : fdopen(fd, "wb");
+	if(fp == NULL){
+		if(fd != -1){
+			close(fd);
+			remove(tmpname);
+		}
+		ERROR_REPORTER_HERE(ASC_PROG_WARNING,"Unable to write JIT cache file '%s'",cachename);
+		ASC_FREE(tmpname);
+		ASC_FREE(buf);
+		return;
+	}
+	err = fwrite(BTJIT_MAGIC, 1, sizeof(BTJIT_MAGIC), fp) != sizeof(BTJIT_MAGIC)
+		|| fwrite(vn, sizeof(uint32_t), 2, fp) != 2
+		|| fwrite(hc, sizeof(uint64_t), 2, fp) != 2
+		|| fwrite(buf, 1, size, fp) != size;
+	err = (fclose(fp) != 0) || err;
+	if(err || rename(tmpname, cachename) != 0){
+		remove(tmpname);
+		ERROR_REPORTER_HERE(ASC_PROG_WARNING,"Unable to write JIT cache file '%s'",cachename);
+	}
+	ASC_FREE(tmpname);
+	ASC_FREE(buf);
+}
+
+/*------------------------------------------------------------------------------
+  LOADING
+*/
+
+/** fill ftab for code c. @return 0 on success, 1 if a function is unknown */
+static int btjit_fill_ftab(void **ftab, CONST struct btjit_code *c){
+	CONST struct Func *f;
+	uint32_t i;
+	double (*p_pow)(double, double) = pow;
+	double (*p_log)(double) = log;
+	double (*p_ipow)(double, int) = asc_ipow;
+	double (*p_d1ipow)(double, int) = asc_d1ipow;
+	/* function to data pointer conversion, as for Asc_DynamicFunction */
+	memcpy(&ftab[FT_POW], &p_pow, sizeof(void *));
+	memcpy(&ftab[FT_LOG], &p_log, sizeof(void *));
+	memcpy(&ftab[FT_IPOW], &p_ipow, sizeof(void *));
+	memcpy(&ftab[FT_D1IPOW], &p_d1ipow, sizeof(void *));
+	for(i = 0; i < c->nfunc; ++i){
+		f = LookupFuncById((enum Func_enum)c->funcids[i]);
+		if(f == NULL || f->value == NULL || f->deriv == NULL)return 1;
+		memcpy(&ftab[FT_FUNC0 + 2*i], &(f->value), sizeof(void *));
+		memcpy(&ftab[FT_FUNC0 + 2*i + 1], &(f->deriv), sizeof(void *));
+	}
+	return 0;
+}
+
+int BinTokenJITAvailable(void){
+	return 1;
+}
+
+struct BinTokenJITTable *BinTokenJITCreate(struct gl_list_t *rellist
+		, CONST char *cachename, unsigned long *nhit
+){
+	struct BinTokenJITTable *t;
+	struct btjit_code **code, *c;
+	struct gl_list_t *newcode;
+	CONST struct RelOpCodes *p;
+	struct relation *r;
+	uint64_t key, check;
+	unsigned long len, i, off, nftab, ncode = 0;
+	unsigned char *mem;
+	void **ftab;
+	void *fp;
+
+	*nhit = 0;
+	len = gl_length(rellist);
+	if(len == 0)return NULL;
+	if(cachename != NULL){
+		btjit_cache_load(cachename);
+	}
+	newcode = gl_create(len);
+	code = ASC_NEW_ARRAY_CLEAR(struct btjit_code *, len + 1);
+
+	/* find or generate code for each share */
+	off = 0;
+	nftab = 0;
+	for(i = 1; i <= len; ++i){
+		r = (struct relation *)GetInstanceRelationOnly(
+			(struct Instance *)gl_fetch(rellist, i)
+		);
+		btjit_share_key(r, &key, &check);
+		c = btjit_cache_find(key, check);
+		if(c != NULL){
+			(*nhit)++;
+		}else{
+			p = RelationOpCodes(r);
+			if(p == NULL)continue;
+			c = ASC_NEW(struct btjit_code);
+			if(btjit_emit(p, c)){
+				ASC_FREE(c);
+				continue;
+			}
+			c->key = key;
+			c->check = check;
+			btjit_cache_add(c);
+			gl_append_ptr(newcode, c);
+		}
+		code[i] = c;
+		off += (c->len + 15) & ~15UL;
+		nftab += FT_FUNC0 + 2*c->nfunc;
+		ncode++;
+	}
+	if(cachename != NULL){
+		btjit_cache_save(cachename, newcode);
+	}
+	gl_destroy(newcode);
+	if(ncode == 0){
+		ASC_FREE(code);
+		return NULL;
+	}
+
+	/* copy all of it into executable memory */
+	mem = (unsigned char *)mmap(NULL, off, PROT_READ | PROT_WRITE
+		, MAP_PRIVATE | MAP_ANON, -1, 0
+	);
+	if(mem == (unsigned char *)MAP_FAILED){
+		ERROR_REPORTER_HERE(ASC_PROG_ERR,"Unable to allocate memory for JIT code");
+		ASC_FREE(code);
+		return NULL;
+	}
+	t = ASC_NEW(struct BinTokenJITTable);
+	t->size = (int)len + 1;
+	t->entries = ASC_NEW_ARRAY_CLEAR(struct BinTokenJITEntry, len + 1);
+	t->ftabs = ASC_NEW_ARRAY_CLEAR(void *, nftab + 1);
+	t->mem = mem;
+	t->memsize = off;
+	off = 0;
+	ftab = t->ftabs;
+	for(i = 1; i <= len; ++i){
+		c = code[i];
+		if(c == NULL)continue;
+		if(btjit_fill_ftab(ftab, c) == 0){
+			memcpy(mem + off, c->bytes, c->len);
+			fp = mem + off;
+			memcpy(&(t->entries[i].F), &fp, sizeof(void *));
+			fp = mem + off + c->gradoff;
+			memcpy(&(t->entries[i].G), &fp, sizeof(void *));
+			t->entries[i].ftab = ftab;
+		}
+		ftab += FT_FUNC0 + 2*c->nfunc;
+		off += (c->len + 15) & ~15UL;
+	}
+	ASC_FREE(code);
+	if(mprotect(mem, t->memsize, PROT_READ | PROT_EXEC) != 0){
+		ERROR_REPORTER_HERE(ASC_PROG_ERR,"Unable to make JIT code executable");
+		BinTokenJITDestroy(t);
+		return NULL;
+	}
+	return t;
+}
+
+void BinTokenJITDestroy(struct BinTokenJITTable *t){
+	if(t == NULL)return;
+	if(t->mem != NULL)munmap(t->mem, t->memsize);
+	ASC_FREE(t->entries);
+	ASC_FREE(t->ftabs);
+	ASC_FREE(t);
+}
+
+#else /* BTJIT_X86_64 */
+
+int BinTokenJITAvailable(void){
+	return 0;
+}
+
+struct BinTokenJITTable *BinTokenJITCreate(struct gl_list_t *rellist
+		, CONST char *cachename, unsigned long *nhit
+){
+	(void)rellist;
+	(void)cachename;
+	*nhit = 0;
+	return NULL;
+}
+
+void BinTokenJITDestroy(struct BinTokenJITTable *t){
+	(void)t;
+}
+
+void BinTokenJITClearCache(void){
+}
+
+#endif /* BTJIT_X86_64 */
@@ -0,0 +1,93 @@
+/*	ASCEND modelling environment
+	Copyright (C) 2015 Carnegie Mellon University
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2, or (at your option)
+	any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*//** @file
+	In-process native code generation for binary tokens (BT_JIT).
+
+	Instead of writing C source, running a compiler and loading a shared
+	library, BT_JIT translates the register bytecode of each relation
+	share (rel_opcode.h) directly to machine code in executable memory.
+	Each share gets a residual function and a gradient function (forward
+	sweep then reverse sweep, all straight-line code).
+
+	Generated code is position independent: constants are addressed
+	relative to the code and all external calls (pow, log, the ASCEND
+	intrinsic functions) go through a small per-relation pointer table
+	passed in at call time. That allows the code to be kept in a disk
+	cache keyed by a hash of the relation share's tokens, so that
+	instantiating the same model again skips code generation.
+
+	Only x86-64 with the System V calling convention (Linux, BSD, Mac)
+	is implemented at present; elsewhere BinTokenJITAvailable() returns 0
+	and the relation manager simply uses the bytecode interpreter.
+
+	This is an internal interface of bintoken.c.
+*/
+
+#ifndef ASC_BINTOKEN_JIT_H
+#define ASC_BINTOKEN_JIT_H
+
+#include <ascend/general/platform.h>
+#include "relation_type.h"
+
+/**	@addtogroup compiler_bintok Compiler Binary Tokens
+	@{
+*/
+
+/** Residual entry point: F(x,residual,ftab). */
+typedef void (*BinTokenJITFPtr)(CONST double *, double *, void *CONST *);
+/** Gradient entry point: G(x,residual,gradient,ftab). */
+typedef void (*BinTokenJITGPtr)(CONST double *, double *, double *, void *CONST *);
+
+/** Callable code for one relation share. */
+struct BinTokenJITEntry {
+	BinTokenJITFPtr F;
+	BinTokenJITGPtr G;
+	void **ftab; /**< external functions called by F and G */
+};
+
+/** A loaded set of relations, indexed from 1 like the C tables. */
+struct BinTokenJITTable {
+	struct BinTokenJITEntry *entries; /**< entries[0] is unused */
+	int size;          /**< number of entries including [0] */
+	void *mem;         /**< executable memory holding all the code */
+	unsigned long memsize;
+	void **ftabs;      /**< storage for all the ftab arrays */
+};
+
+/** @return nonzero if native code generation is supported by this build. */
+extern int BinTokenJITAvailable(void);
+
+/**
+	Generate (or fetch from the cache) native code for each of the token
+	relation instances in rellist, and load it into executable memory.
+	Relations that cannot be compiled get NULL entries.
+
+	@param cachename file used as a persistent code cache, or NULL
+	@param nhit      output, number of relations found in the cache
+	@return the new table, or NULL if nothing could be compiled.
+*/
+extern struct BinTokenJITTable *BinTokenJITCreate(struct gl_list_t *rellist
+		, CONST char *cachename, unsigned long *nhit);
+
+/** Free a table created by BinTokenJITCreate, including its code. */
+extern void BinTokenJITDestroy(struct BinTokenJITTable *t);
+
+/** Forget the in-memory copy of the disk cache, if loaded. */
+extern void BinTokenJITClearCache(void);
+
+/* @} */
+
+#endif /* ASC_BINTOKEN_JIT_H */
@@ -150,6 +150,16 @@ ASC_DLLSPEC int g_use_copyanon;
  * headered for export in compiler.h.
  */
 
+ASC_DLLSPEC int g_pass2_threads;
+/**<
+ * Number of threads on which the relations of different models are
+ * made in pass 2 of instantiation; 0 means one per processor. 1, the
+ * default, makes them all on the calling thread. The result is the same
+ * in any case. Only has an effect if ASCEND was built with
+ * ASC_WITH_THREADS, by a compiler with thread-local storage
+ * (ASC_HAVE_THREAD_LOCAL). This variable is defined in instantiate.c.
+ */
+
 /* Simple types eligible to be ATOM children. */
 #define BASE_REAL_NAME          "real"
 #define BASE_INTEGER_NAME       "integer"
@@ -157,6 +157,9 @@ struct Instance *CopyReal(CONST struct Instance *i)
     result->parents = gl_create(AVG_PARENTS);
     result->alike_ptr = INST(result);
     result->relations = NULL;	/* initially the copy isn't in any relations */
+    result->value = RealAtomValue(i); /* which may be in a value store */
+    result->store = NULL;	/* and the copy is in none */
+    result->vid = 0;
     CopyTypeDesc(result->desc);
     RedoChildPointers(ChildListLen(GetChildList(result->desc)),
 		      INST(result),RA_CHILD(result,0),
@@ -174,6 +174,7 @@ struct Instance *CreateSimulationInstance(struct TypeDescription *type,
   result->name = name;
   result->extvars = NULL;
   result->slvreq_hooks = NULL;
+  result->valstore = NULL;
   return INST(result);
 }
 
@@ -331,6 +332,8 @@ struct Instance *CreateRealInstance(struct TypeDescription *type){
       result->dimen = GetRealDimens(type);
       result->relations = NULL;
       result->depth = UINT_MAX;
+      result->store = NULL;
+      result->vid = 0;
 
       if(AtomDefaulted(type)){
         result->value = GetRealDefault(type);
@@ -71,6 +71,7 @@
 #include "instance_types.h"
 #include "cmpfunc.h"
 #include "slvreq.h"
+#include "valstore.h"
 
 
 static void DeleteIPtr(struct Instance *i){
@@ -324,6 +325,7 @@ static void DestroyInstanceParts(struct Instance *i){
   AssertMemory(i);
   switch(i->t) {
   case SIM_INST:
+    ValueStoreDetach(i); /* before the atoms with slots go */
     child = InstanceChild(i,1); /* one child only */
     DestroyInstance(child,i);
     SIM_INST(i)->name = NULL;	/* main symbol table owns the string */
@@ -408,6 +410,7 @@ static void DestroyInstanceParts(struct Instance *i){
     return;
   case REAL_ATOM_INST:
     //CONSOLE_DEBUG("REMOVE PARTS OF VAR %p =========",i);
+    ValueStoreRelease(i);
     /* deallocate dynamic memory used by children */
     DestroyAtomChildren(RA_CHILD(i,0),ChildListLen(GetChildList(RA_INST(i)->desc)));
     /* continue delete the atom */
@@ -33,10 +33,13 @@
 #include <ascend/general/ascMalloc.h>
 #include <ascend/utilities/error.h>
 #include <ascend/general/list.h>
+#include <ascend/utilities/ascTask.h>
 
 #include <ascend/general/mathmacros.h>
 
 struct gl_list_t *g_dimen_list;
+static asc_mutex_t g_dimen_lock = NULL;
+/* relations may be made on several threads, all adding dimensions */
 dim_type *g_wild_dimen,*g_trig_dimen,*g_dimensionless;
 
 #define WILD(d) ((d)->wild & DIM_WILD)
@@ -63,6 +66,7 @@ void InitDimenList(void)
 
   g_dimen_list = gl_create(200L);
   AssertMemory(g_dimen_list);
+  g_dimen_lock = asc_mutex_create();
   g_wild_dimen = ASC_NEW(dim_type);
   AssertAllocatedMemory(g_wild_dimen,sizeof(dim_type));
   g_trig_dimen = ASC_NEW(dim_type);
@@ -86,6 +90,8 @@ void InitDimenList(void)
 void DestroyDimenList(void)
 {
   gl_free_and_destroy(g_dimen_list);
+  asc_mutex_destroy(g_dimen_lock);
+  g_dimen_lock = NULL;
   g_wild_dimen = g_dimensionless = NULL;
 }
 
@@ -306,6 +312,7 @@ CONST dim_type *FindOrAddDimen(CONST dim_type *d)
 {
   register unsigned long place;
   register dim_type *result;
+  asc_mutex_lock(g_dimen_lock);
   if ((place=gl_search(g_dimen_list,d,(CmpFunc)CmpDimen))!=0){
     result = gl_fetch(g_dimen_list,place);
   }
@@ -313,6 +320,7 @@ CONST dim_type *FindOrAddDimen(CONST dim_type *d)
     result = CopyDimen(d);
     gl_insert_sorted(g_dimen_list,result,(CmpFunc)CmpDimen);
   }
+  asc_mutex_unlock(g_dimen_lock);
   AssertAllocatedMemory(result,sizeof(dim_type));
   return result;
 }
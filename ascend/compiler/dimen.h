@@ -211,6 +211,7 @@ ASC_DLLSPEC CONST dim_type *FindOrAddDimen(CONST dim_type *d);
  *    p = FindOrAddDimen(&d);
  *    p will never point to d.  p != &d.
  *  </pre>
+ *  It may be called on several threads at once.
  */
 
 ASC_DLLSPEC void CopyDimensions(CONST dim_type *src, dim_type *dest);
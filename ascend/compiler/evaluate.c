@@ -45,7 +45,7 @@
 #include "find.h"
 #include "exprio.h"
 
-static struct gl_list_t *g_names_needed = NULL;
+static ASC_THREAD_LOCAL struct gl_list_t *g_names_needed = NULL;
 /* global var so we are not passing nlist everywhere
  * that we used to pass *EvaluateName.
  */
@@ -87,8 +87,9 @@ static void DeAllocStack(struct stack_t *stack)
 }
 
 #define RECYCLESTACKSIZE 20 /* largest stack we will attempt to recycle */
-static struct stack_t * g_recycle_expreval_stacks[RECYCLESTACKSIZE];
-/* ANSI ASSUMPTION: this array is initialize to NULL values */
+static ASC_THREAD_LOCAL struct stack_t * g_recycle_expreval_stacks[RECYCLESTACKSIZE];
+/* ANSI ASSUMPTION: this array is initialize to NULL values.
+ * One per thread: see ClearRecycleStack. */
 /* Assumption about client:
  * It will never try to free any element of the stack, nor
  * will it ever put the stack inside a struct value_t managed
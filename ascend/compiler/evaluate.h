@@ -157,6 +157,8 @@ extern void ClearRecycleStack(void);
  *  if so desired, but there is no need for it.
  *  There is an option inside evaluate.c that causes this function to
  *  report how many recycled stack elements it deallocates.
+ *  Each thread has its own recycler, which this clears; another thread
+ *  that evaluates expressions should call it before it exits.
  */
 
 /* @} */
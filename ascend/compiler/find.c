@@ -63,11 +63,11 @@
 #define NAMELISTSIZE 20L
 #define DEFTOLERANCE 1e-08
 
-CONST struct Instance *g_EvaluationContext=NULL;
-struct for_table_t *g_EvaluationForTable=NULL;
-int ListMode=0;           /* 0 = set or normal mode; 1 = list mode */
-int EvaluatingSets=0;     /* 1 = in process of set evaluation */
-int g_DeclarativeContext=0; /* 0 = declarative processing
+ASC_THREAD_LOCAL CONST struct Instance *g_EvaluationContext=NULL;
+ASC_THREAD_LOCAL struct for_table_t *g_EvaluationForTable=NULL;
+ASC_THREAD_LOCAL int ListMode=0;  /* 0 = set or normal mode; 1 = list mode */
+ASC_THREAD_LOCAL int EvaluatingSets=0;  /* 1 = in process of set evaluation */
+ASC_THREAD_LOCAL int g_DeclarativeContext=0; /* 0 = declarative processing
 			     * !0 = procedural processing.
                              */
 
@@ -434,7 +434,7 @@ struct value_t InstanceEvaluateSatisfiedName(CONST struct Name *nptr,
       gl_destroy(list);
       switch(InstanceKind(inst)){
       case REL_INST:
-        status = RelationCalcResidualPostfixSafe(inst,&res);
+        status = RelationCalcResidualPostfixSafe(inst,&res,NULL);
         if (status != safe_ok) {
         FPRINTF(ASCERR,
             "Something wrong while calculating a residual in Sat Expr\n");
@@ -47,21 +47,23 @@ enum find_errors {
   correct_instance      /**< Return value when everything went okay. */
 };
 
-/* mmm, nasty global variables... */
+/* mmm, nasty global variables... each thread has its own, so that
+ * relations may be made on several at once (see instantiate.c).
+ */
 
-extern int ListMode;
+extern ASC_THREAD_LOCAL int ListMode;
 /**<
 	Tells whether to evaluate a set strictly as a set i.e no order,
 	or as a list, i.e., with order important.
 */
 
-extern int EvaluatingSets;
+extern ASC_THREAD_LOCAL int EvaluatingSets;
 /**<
 	Tells whether the evaluation of a set is in place. Used for marking
 	atoms as mutable or not.
 */
 
-extern int g_DeclarativeContext;
+extern ASC_THREAD_LOCAL int g_DeclarativeContext;
 /**<
 	Tells whether declarative processing, the default = 0 , is in effect,
 	or procedural processing as when doing initializations.
@@ -86,7 +88,7 @@ extern void SetDeclarativeContextF(int value, char *file, int line);
   /**< set the declarative context (for debugging) */
 #endif
 
-extern CONST struct Instance *g_EvaluationContext;
+extern ASC_THREAD_LOCAL CONST struct Instance *g_EvaluationContext;
 /**<
  * Global variable used throughout semantic analysis to
  * indicate context of evaluation. Do Not reference this
@@ -94,7 +96,7 @@ extern CONST struct Instance *g_EvaluationContext;
  * SetEvaluationContext() instead.
  */
 
-extern struct for_table_t *g_EvaluationForTable;
+extern ASC_THREAD_LOCAL struct for_table_t *g_EvaluationForTable;
 /**<
  * Global variable used throughout semantic analysis to
  * indicate context of evaluation. Do Not reference this
@@ -40,8 +40,9 @@
 #define FVMALLOC ForVarMalloc()
 
 /* LIFO forvar list. contents of forvar recycle list are only the heads,
-we do not save the contents of the var when it is destroyed. */
-struct for_var_t *g_forvar_recycle_list = NULL;
+we do not save the contents of the var when it is destroyed. One per
+thread: see ClearForVarRecycle. */
+static ASC_THREAD_LOCAL struct for_var_t *g_forvar_recycle_list = NULL;
 
 static struct for_var_t *ForVarMalloc(void)
 {
@@ -220,6 +220,7 @@ extern int ClearForVarRecycle(void);
  *  if anyone cares.
  *  This function may be safely called at any time.
  *  There is no recycle initialization function.
+ *  Each thread has its own list, which this clears.
  */
 
 /* @} */
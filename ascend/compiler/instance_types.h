@@ -182,6 +182,8 @@ struct RealAtomInstance {
   struct gl_list_t *relations;  /**< relations where this real appears */
   unsigned int assigned;        /**< the number of times it has been assigned */
   unsigned int depth;           /**< the depth of the last assignment */
+  struct ValueStore *store;     /**< store holding the value, see valstore.h */
+  unsigned long vid;            /**< slot in store, if store is not NULL */
   /* An even number of child pointers are packed here, the last of which
    * may not be valid because the number of children may be odd.
    * This extra should be eliminated for LONG pointer machines.
@@ -641,6 +643,7 @@ struct SimulationInstance {
   unsigned int anon_flags;      /**< anonymous field to be manipulated */
   /* add other interesting stuff here */
   VOIDPTR slvreq_hooks;
+  struct ValueStore *valstore;  /**< see valstore.h. NULL unless attached */
 };
 
 /** dummy instance for unselected children of models
@@ -29,6 +29,7 @@
 #include "instantiate.h"
 
 #include <ascend/utilities/bit.h>
+#include <ascend/utilities/ascTask.h>
 
 #include "vlist.h"
 #include "initialize.h"
@@ -51,6 +52,7 @@
 #include "value_type.h"
 #include "statio.h"
 #include "pending.h"
+#include "temp.h"
 #include "find.h"
 #include "relation.h"
 #include "logical_relation.h"
@@ -165,6 +167,19 @@ int g_use_copyanon = 1;
 	copying. if 0, no copying by that method is done.
 */
 
+int g_pass2_threads = 1;
+/**
+	the user switch for the number of threads making relations
+	in pass 2 (see Pass2BatchRun). 0 means one per processor.
+*/
+
+static asc_mutex_t g_pass2_lock = NULL;
+/**
+	held while arrays of relations are made or extended on those
+	threads, as that adds to the array type descriptions and symbols
+	shared by the library. NULL when there is only one thread.
+*/
+
 #if TIMECOMPILER
 static
 int g_ExecuteREL_CreateTokenRelation_calls = 0;
@@ -4757,6 +4772,7 @@ struct Instance *MakeRelationInstance(struct Name *name,
     SetInstanceNameStrPtr(rec,childname);
     pos = ChildSearch(parent,&rec);
     if (pos>0) {
+      asc_mutex_lock(g_pass2_lock);
       if (InstanceChild(parent,pos)==NULL){
         /* must make array */
         child = MakeSparseArray(parent,name,stat,NULL,0,NULL,NULL,NULL);
@@ -4764,6 +4780,7 @@ struct Instance *MakeRelationInstance(struct Name *name,
       	/* must add array element */
         child = AddArrayChild(parent,name,stat,NULL,NULL,NULL);
       }
+      asc_mutex_unlock(g_pass2_lock);
       return child;
     }else{
       return NULL;
@@ -4842,7 +4859,7 @@ int ExecuteREL(struct Instance *inst, struct Statement *statement)
       return 1;
     }
 #if TIMECOMPILER
-    g_ExecuteREL_CreateTokenRelation_calls++;
+    ASC_ATOMIC_INC(g_ExecuteREL_CreateTokenRelation_calls);
 #endif
     reln = CreateTokenRelation(inst,child,RelationStatExpr(statement),
                                &err,&ferr);
@@ -11890,6 +11907,218 @@ void Pass3ProcessPendingInstances(void)
   /* done, or there were no pendings at all and while failed */
 }
 
+/*------------------------------------------------------------------------------
+  PASS 2 ON SEVERAL THREADS
+
+  The relations of different models can be made at the same time, as
+  making one only changes its own model (and the new relation), apart
+  from linking the relation into the relation lists of its variables,
+  which other models share. Pass2BatchRun makes the relations of a list
+  of models on several threads, holding back those links and any error
+  messages, and Pass2BatchFinish then deals with each model on the
+  calling thread, in the order in which pass 2 would have done it there,
+  so that the result is the same as that of doing it all on one thread.
+
+  The find and evaluation contexts, the term pool, the temporary
+  variables and the various recyclers used are per thread, the element
+  pools are locked for the duration (pool_threads_begin), as are the
+  dimension table (FindOrAddDimen) and the making of relation arrays
+  (g_pass2_lock).
+
+  Models with EXTERNAL or CONDITIONAL statements still to do are left
+  for Pass2BatchFinish to do on the calling thread: external relations
+  call out to code that need not be thread safe, and CONDITIONAL marks
+  the relations made in other models.
+*/
+
+struct Pass2Batch {
+  unsigned long n;
+  struct Instance **models;
+  int *done;			/* 1 if model made on the threads */
+  int *changed;			/* from Pass2ExecuteRelationStatements */
+  struct gl_list_t **links;	/* links held back, see DeferRelationLinks */
+  error_reporter_tree_t **errs; /* errors held back */
+  int *relinit;			/* for each worker, whether it has its own
+				 * relation instantiator */
+  int32 *task;			/* task -> model */
+};
+
+/**
+	Whether the relations still to do in model inst may be made on
+	another thread.
+*/
+static
+int Pass2ThreadSafe(struct Instance *inst)
+{
+  struct BitList *blist;
+  struct gl_list_t *statements;
+  struct Statement *stat;
+  unsigned long c;
+  blist = InstanceBitList(inst);
+  if (blist==NULL || BitListEmpty(blist)) {
+    return 0;
+  }
+  statements = GetList(GetStatementList(InstanceTypeDesc(inst)));
+  for(c=FirstNonZeroBit(blist);c<BLength(blist);c++){
+    if (ReadBit(blist,c)){
+      stat = (struct Statement *)gl_fetch(statements,c+1);
+      switch (StatementType(stat)) {
+      case EXT:
+      case COND:
+        return 0;
+      case FOR:
+        if (ForContainsExternal(stat) || ForContainsConditional(stat)) {
+          return 0;
+        }
+        break;
+      default:
+        break;
+      }
+    }
+  }
+  return 1;
+}
+
+static
+int Pass2BatchTask(void *data, int worker, int32 task)
+{
+  struct Pass2Batch *b = (struct Pass2Batch *)data;
+  struct Instance *inst;
+  int32 m;
+  m = b->task[task];
+  inst = b->models[m];
+  if (worker!=0 && !b->relinit[worker]) {
+    InitRelInstantiator();
+    b->relinit[worker] = 1;
+  }
+  b->links[m] = gl_create(100L);
+  DeferRelationLinks(b->links[m]);
+  error_reporter_tree_start();
+  Pass2ExecuteRelationStatements(InstanceBitList(inst),inst,&(b->changed[m]));
+  error_reporter_end_flush();
+  b->errs[m] = error_reporter_tree_take();
+  DeferRelationLinks(NULL);
+  b->done[m] = 1;
+  return 0;
+}
+
+static
+void Pass2BatchDone(void *data, int worker)
+{
+  struct Pass2Batch *b = (struct Pass2Batch *)data;
+  if (b->relinit[worker]) {
+    DestroyRelInstantiator();
+    b->relinit[worker] = 0;
+  }
+  if (worker!=0) {
+    DestroyTemporaryList();
+  }
+  ClearRecycleStack();
+  ClearForVarRecycle();
+  gl_emptyrecycler();
+}
+
+/**
+	Make the relations of those of the n models that may be, on
+	g_pass2_threads threads. Returns NULL if that is only one, or if the
+	compiler has no thread-local storage for the recyclers and temporary
+	variables, in which case nothing is done: call Pass2BatchFinish anyway.
+*/
+static
+struct Pass2Batch *Pass2BatchRun(struct Instance **models, unsigned long n)
+{
+  struct Pass2Batch *b;
+  int32 ntask, t, *npred, *succptr;
+  unsigned long m;
+  int nthread;
+
+  nthread = (g_pass2_threads > 0) ? g_pass2_threads : asc_task_num_cpus();
+#ifndef ASC_HAVE_THREAD_LOCAL
+  /* the gl_list, temporary variable and FOR variable recyclers and the
+   * find contexts would be shared by the threads */
+  nthread = 1;
+#endif
+  if (nthread < 2 || n < 2) {
+    return NULL;
+  }
+  b = ASC_NEW(struct Pass2Batch);
+  b->n = n;
+  b->models = models;
+  b->done = ASC_NEW_ARRAY_CLEAR(int,n);
+  b->changed = ASC_NEW_ARRAY_CLEAR(int,n);
+  b->links = ASC_NEW_ARRAY_CLEAR(struct gl_list_t *,n);
+  b->errs = ASC_NEW_ARRAY_CLEAR(error_reporter_tree_t *,n);
+  b->relinit = ASC_NEW_ARRAY_CLEAR(int,nthread);
+  b->task = ASC_NEW_ARRAY(int32,n);
+  for (ntask=0, m=0; m < n; m++) {
+    if (Pass2ThreadSafe(models[m])) {
+      b->task[ntask++] = (int32)m;
+    }
+  }
+  /* the first relation made adds the relation prototype, so make it here */
+  DestroyInstance(CreateRelationInstance(FindRelationType(),e_token),NULL);
+  npred = ASC_NEW_ARRAY(int32,ntask+1);
+  succptr = ASC_NEW_ARRAY(int32,ntask+1);
+  for (t=0; t <= ntask; t++) {
+    npred[t] = 0;
+    succptr[t] = 0;
+  }
+  g_pass2_lock = asc_mutex_create();
+  pool_threads_begin();
+  (void)asc_task_graph_run(ntask,npred,succptr,NULL,nthread,
+                           Pass2BatchTask,Pass2BatchDone,b);
+  pool_threads_end();
+  asc_mutex_destroy(g_pass2_lock);
+  g_pass2_lock = NULL;
+  ascfree(npred);
+  ascfree(succptr);
+  return b;
+}
+
+/**
+	Finish the relations of model m (models[m] of Pass2BatchRun):
+	report the errors and make the links held back if they were made on
+	the threads, else make them now. b may be NULL.
+*/
+static
+void Pass2BatchFinish(struct Pass2Batch *b, unsigned long m,
+                      struct Instance *inst, int *changed)
+{
+  if (b==NULL || !b->done[m]) {
+    Pass2ExecuteRelationStatements(InstanceBitList(inst),inst,changed);
+    return;
+  }
+  asc_assert(b->models[m]==inst);
+  error_reporter_tree_report(b->errs[m]);
+  b->errs[m] = NULL;
+  ApplyRelationLinks(b->links[m]);
+  if (b->changed[m]) {
+    *changed = 1;
+  }
+}
+
+static
+void Pass2BatchDestroy(struct Pass2Batch *b)
+{
+  unsigned long m;
+  if (b==NULL) {
+    return;
+  }
+  for (m=0; m < b->n; m++) {
+    if (b->links[m]!=NULL) {
+      gl_destroy(b->links[m]);
+    }
+    error_reporter_tree_report(b->errs[m]);
+  }
+  ascfree(b->done);
+  ascfree(b->changed);
+  ascfree(b->links);
+  ascfree(b->errs);
+  ascfree(b->relinit);
+  ascfree(b->task);
+  ascfree(b);
+}
+
 /**
 	This is the singlepass phase2 with anontype sharing of
 	relations implemented. If relations can depend on other
@@ -11904,9 +12133,11 @@ void Pass2ProcessPendingInstancesAnon(struct Instance *result)
   struct gl_list_t *atl;	/* anonymous types in result */
   struct gl_list_t *protovarindices; /* all vars in all rels in local MODEL */
   struct AnonType *at;
+  struct Instance **protos;	/* those with relations to make */
+  struct Pass2Batch *batch;
   int changed = 0;		/* will become 1 if any local relation made */
   int anychange = 0;		/* will become 1 if any change anywhere */
-  unsigned long c,n,alen,clen;
+  unsigned long c,n,alen,clen,nproto,p;
 #if TIMECOMPILER
   double start,classt;
 #endif
@@ -11926,8 +12157,20 @@ void Pass2ProcessPendingInstancesAnon(struct Instance *result)
     start = tm_cpu_time();
 #endif
     alen = gl_length(atl);
+    /* make the prototypes' relations, on several threads if allowed */
+    protos = ASC_NEW_ARRAY(struct Instance *,alen+1);
+    for (nproto=0, n=1; n <= alen; n++) {
+      proto = Asc_GetAnonPrototype(Asc_GetAnonType(atl,n));
+      if (InstanceKind(proto) == MODEL_INST && InstanceInList(proto)) {
+        blist = InstanceBitList(proto);
+        if ((blist!=NULL) && !BitListEmpty(blist)) {
+          protos[nproto++] = proto;
+        }
+      }
+    }
+    batch = Pass2BatchRun(protos,nproto);
     /* iterate over all anontypes, working on only models. */
-    for (n=1; n <= alen; n++) {
+    for (p=0, n=1; n <= alen; n++) {
       changed = 0;
       at = Asc_GetAnonType(atl,n);
       proto = Asc_GetAnonPrototype(at);
@@ -11939,8 +12182,9 @@ void Pass2ProcessPendingInstancesAnon(struct Instance *result)
         error_reporter_end_flush();
 #endif
         blist = InstanceBitList(proto);
-        if ((blist!=NULL) && !BitListEmpty(blist)) {
-          Pass2ExecuteRelationStatements(blist,proto,&changed);
+        /* blist may be empty already, if made on the threads */
+        if (p < nproto && protos[p]==proto) {
+          Pass2BatchFinish(batch,p++,proto,&changed);
           RemoveInstance(proto);
           anychange += changed;
         }
@@ -11957,6 +12201,8 @@ void Pass2ProcessPendingInstancesAnon(struct Instance *result)
         Pass2DestroyAnonProtoVars(protovarindices);
       }
     }
+    Pass2BatchDestroy(batch);
+    ascfree(protos);
     Asc_DestroyAnonList(atl);
     if (!anychange) {
       g_iteration++;		/* The global iteration counter */
@@ -11967,7 +12213,7 @@ void Pass2ProcessPendingInstancesAnon(struct Instance *result)
       CONSOLE_DEBUG("Making tokens: %0.6f s (for relations)",(classt-start));
       start = tm_cpu_time();
 #endif
-      BinTokensCreate(result,BT_C);
+      BinTokensCreate(result,BinTokenGetMethod());
 #if TIMECOMPILER
       classt = tm_cpu_time();
       CONSOLE_DEBUG("build/link: %0.6f s (for bintokens)",(classt-start));
@@ -11989,12 +12235,25 @@ void Pass2ProcessPendingInstances(void)
   struct pending_t *work;
   struct Instance *inst;
   struct BitList *blist;
+  struct Instance **models;	/* those with relations to make */
+  struct Pass2Batch *batch;
   int changed = 0,count=0;
-  unsigned long c;
+  unsigned long c,n,nmodel;
   /* pending will have at least one instance, or while will fail */
   while((count < PASS2MAXNUMBER) && NumberPending()>0){
     changed = 0;
     c = 0;
+    /* make their relations, on several threads if allowed, in the order
+       in which they will come to the top below */
+    models = ASC_NEW_ARRAY(struct Instance *,NumberPending());
+    for (nmodel=0, work=TopEntry(); work!=NULL; work=work->next) {
+      blist = InstanceBitList(PendingInstance(work));
+      if ((blist!=NULL)&&!BitListEmpty(blist)){
+        models[nmodel++] = PendingInstance(work);
+      }
+    }
+    batch = Pass2BatchRun(models,nmodel);
+    n = 0;
     while(c < NumberPending()){
       work = TopEntry();
       if (work!=NULL) {
@@ -12005,9 +12264,10 @@ void Pass2ProcessPendingInstances(void)
         blist = NULL; /* this shouldn't be necessary, but is */
         inst = NULL;
       }
-      if ((blist!=NULL)&&!BitListEmpty(blist)){
-        /* only models get here */
-        Pass2ExecuteRelationStatements(blist,inst,&changed);
+      if (n < nmodel && models[n]==inst){
+        /* only models get here. blist may be empty already, if the
+           relations were made on the threads. */
+        Pass2BatchFinish(batch,n++,inst,&changed);
         /* we do away with TryArrayExpansion because it doesn't do rels */
 
 #if (PASS2MAXNUMBER > 1)
@@ -12037,6 +12297,8 @@ void Pass2ProcessPendingInstances(void)
         /* We do not attempt to expand non-relation arrays in pass2. */
       }
     }
+    Pass2BatchDestroy(batch);
+    ascfree(models);
     if (!changed) {
       count++;
       g_iteration++;		/* The global iteration counter */
@@ -0,0 +1,1727 @@
+/*	ASCEND modelling environment
+	Copyright (C) 2015 Carnegie Mellon University
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2, or (at your option)
+	any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*//** @file
+	Instance tree snapshots. See instsnap.h for the file layout.
+
+	The writer numbers the nodes of the tree with their tmp_nums, as
+	CopyInstance does, so that every link in the file is a node id. The
+	reader makes three sweeps of the node table: one to check every record
+	against the library before anything is made (so that a stale or broken
+	snapshot can be refused without leaving half a tree behind), one to
+	make each node and one to link them.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <ascend/general/platform.h>
+#include <ascend/general/ascMalloc.h>
+#include <ascend/general/panic.h>
+#include <ascend/general/list.h>
+#include <ascend/general/pool.h>
+#include <ascend/utilities/error.h>
+#include <ascend/utilities/bit.h>
+
+#include "symtab.h"
+#include "functype.h"
+#include "func.h"
+#include "expr_types.h"
+#include "dimen.h"
+#include "childinfo.h"
+#include "child.h"
+#include "type_desc.h"
+#include "library.h"
+#include "module.h"
+#include "instance_types.h"
+#include "instmacro.h"
+#include "instquery.h"
+#include "parentchild.h"
+#include "visitinst.h"
+#include "tmpnum.h"
+#include "arrayinst.h"
+#include "createinst.h"
+#include "universal.h"
+#include "pending.h"
+#include "setinstval.h"
+#include "find.h"
+#include "rel_blackbox.h"
+#include "vlist.h"
+#include "relation_type.h"
+#include "relation.h"
+#include "relation_util.h"
+#include "mathinst.h"
+#include "atomvalue.h"
+#include "instantiate.h"
+#include "instsnap.h"
+
+#ifndef __WIN32__
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <fcntl.h>
+# include <unistd.h>
+#endif
+
+#define SNAP_VERSION 1
+#define SNAP_ORDER UINT64_C(0x0102030405060708)
+#define SNAP_NONE UINT64_MAX /* children of an array not yet expanded */
+
+enum SnapTableId {
+  SNAP_STR, SNAP_DIM, SNAP_FUNC, SNAP_TYPE, SNAP_SHARE, SNAP_NODE,
+  SNAP_NTABLE
+};
+
+enum SnapTypeKind {
+  SNAP_TYPE_NAMED, SNAP_TYPE_ARRAY, SNAP_TYPE_RELATION, SNAP_TYPE_DUMMY
+};
+
+struct SnapHeader {
+  char magic[8];
+  uint64_t order, version, size, root, name;
+  uint64_t count[SNAP_NTABLE];
+  uint64_t index[SNAP_NTABLE];
+};
+
+static uint64_t SnapDouble(double d)
+{
+  uint64_t u;
+  memcpy(&u,&d,sizeof(u));
+  return u;
+}
+
+static double SnapGetDouble(uint64_t u)
+{
+  double d;
+  memcpy(&d,&u,sizeof(d));
+  return d;
+}
+
+/*------------------------------------------------------------------------------
+  WRITING
+*/
+
+struct SnapBuf {
+  uint64_t *w;
+  unsigned long n, cap;
+};
+
+static void SnapPut(struct SnapBuf *b, uint64_t v)
+{
+  if (b->n == b->cap) {
+    b->cap = (b->cap > 0) ? 2*b->cap : 1024;
+    b->w = (uint64_t *)ascrealloc(b->w,b->cap*sizeof(uint64_t));
+  }
+  b->w[b->n++] = v;
+}
+
+/** the entries of a table, and the offset in words of each in data */
+struct SnapTable {
+  struct SnapBuf index;
+  struct SnapBuf data;
+};
+
+/** start a new entry in t, returning its id */
+static unsigned long SnapEntry(struct SnapTable *t)
+{
+  SnapPut(&(t->index),t->data.n);
+  return t->index.n;
+}
+
+/** open addressing map from pointers already written to their ids */
+struct SnapMap {
+  CONST void **key;
+  unsigned long *id;
+  unsigned long cap, n;
+};
+
+static unsigned long SnapHash(CONST void *p, unsigned long cap)
+{
+  return (unsigned long)((((uint64_t)(asc_intptr_t)p >> 3)
+                          * UINT64_C(0x9E3779B97F4A7C15)) >> 20) & (cap-1);
+}
+
+static unsigned long SnapMapFind(CONST struct SnapMap *m, CONST void *key)
+{
+  unsigned long h;
+  if (m->cap == 0) return 0;
+  for (h = SnapHash(key,m->cap); m->key[h] != NULL; h = (h+1) & (m->cap-1)) {
+    if (m->key[h] == key) return m->id[h];
+  }
+  return 0;
+}
+
+static void SnapMapAdd(struct SnapMap *m, CONST void *key, unsigned long id)
+{
+  CONST void **oldkey;
+  unsigned long *oldid, oldcap, c, h;
+  if (2*(m->n+1) > m->cap) {
+    oldkey = m->key;
+    oldid = m->id;
+    oldcap = m->cap;
+    m->cap = (oldcap > 0) ? 2*oldcap : 256;
+    m->key = ASC_NEW_ARRAY_CLEAR(CONST void *,m->cap);
+    m->id = ASC_NEW_ARRAY(unsigned long,m->cap);
+    for (c = 0; c < oldcap; c++) {
+      if (oldkey[c] == NULL) continue;
+      for (h = SnapHash(oldkey[c],m->cap); m->key[h] != NULL;
+           h = (h+1) & (m->cap-1));
+      m->key[h] = oldkey[c];
+      m->id[h] = oldid[c];
+    }
+    if (oldcap > 0) {
+      ascfree((VOIDPTR)oldkey);
+      ascfree(oldid);
+    }
+  }
+  for (h = SnapHash(key,m->cap); m->key[h] != NULL; h = (h+1) & (m->cap-1));
+  m->key[h] = key;
+  m->id[h] = id;
+  m->n++;
+}
+
+static void SnapMapDestroy(struct SnapMap *m)
+{
+  if (m->cap > 0) {
+    ascfree((VOIDPTR)m->key);
+    ascfree(m->id);
+  }
+}
+
+struct SnapWriter {
+  struct SnapTable tab[SNAP_NTABLE];
+  struct SnapMap str, dim, func, type, share;
+  unsigned long nbad;   /* links out of the tree, unknown terms */
+};
+
+static uint64_t SnapWriteStr(struct SnapWriter *w, symchar *s)
+{
+  struct SnapTable *t = &(w->tab[SNAP_STR]);
+  unsigned long id, len, c;
+  uint64_t word;
+  CONST char *p;
+  if (s == NULL) return 0;
+  if ((id = SnapMapFind(&(w->str),s)) != 0) return id;
+  p = SCP(s);
+  len = strlen(p);
+  id = SnapEntry(t);
+  SnapPut(&(t->data),len);
+  /* with the terminating 0, so it can be used in place */
+  for (c = 0; c <= len; c += 8) {
+    word = 0;
+    memcpy(&word,p+c,(len+1-c < 8) ? len+1-c : 8);
+    SnapPut(&(t->data),word);
+  }
+  SnapMapAdd(&(w->str),s,id);
+  return id;
+}
+
+static uint64_t SnapWriteDim(struct SnapWriter *w, CONST dim_type *d)
+{
+  struct SnapTable *t = &(w->tab[SNAP_DIM]);
+  unsigned long id;
+  int c;
+  if (d == NULL) return 0;
+  if ((id = SnapMapFind(&(w->dim),d)) != 0) return id;
+  id = SnapEntry(t);
+  SnapPut(&(t->data),d->wild);
+  for (c = 0; c < NUM_DIMENS; c++) {
+    SnapPut(&(t->data),(uint64_t)(int64_t)d->f[c].numerator);
+    SnapPut(&(t->data),(uint64_t)(int64_t)d->f[c].denominator);
+  }
+  SnapMapAdd(&(w->dim),d,id);
+  return id;
+}
+
+static uint64_t SnapWriteFunc(struct SnapWriter *w, CONST struct Func *f)
+{
+  struct SnapTable *t = &(w->tab[SNAP_FUNC]);
+  unsigned long id;
+  uint64_t name;
+  if ((id = SnapMapFind(&(w->func),f)) != 0) return id;
+  name = SnapWriteStr(w,AddSymbol(FuncName(f)));
+  id = SnapEntry(t);
+  SnapPut(&(t->data),name);
+  SnapMapAdd(&(w->func),f,id);
+  return id;
+}
+
+static uint64_t SnapWriteType(struct SnapWriter *w, struct TypeDescription *d)
+{
+  struct SnapTable *t = &(w->tab[SNAP_TYPE]);
+  struct gl_list_t *indices;
+  struct IndexType *ind;
+  unsigned long id, c, len;
+  uint64_t base, mod, name;
+  if (d == NULL) return 0;
+  if ((id = SnapMapFind(&(w->type),d)) != 0) return id;
+  if (d == FindRelationType()) {
+    id = SnapEntry(t);
+    SnapPut(&(t->data),SNAP_TYPE_RELATION);
+  } else if (d == FindDummyType()) {
+    id = SnapEntry(t);
+    SnapPut(&(t->data),SNAP_TYPE_DUMMY);
+  } else if (GetBaseType(d) == array_type) {
+    /* the base type's entry has to be done before this one is begun */
+    base = SnapWriteType(w,GetArrayBaseType(d));
+    mod = (GetModule(d) != NULL)
+      ? SnapWriteStr(w,AddSymbol(Asc_ModuleName(GetModule(d)))) : 0;
+    indices = GetArrayIndexList(d);
+    len = (indices != NULL) ? gl_length(indices) : 0;
+    id = SnapEntry(t);
+    SnapPut(&(t->data),SNAP_TYPE_ARRAY);
+    SnapPut(&(t->data),mod);
+    SnapPut(&(t->data),base);
+    SnapPut(&(t->data),GetArrayBaseIsInt(d));
+    SnapPut(&(t->data),GetArrayBaseIsRelation(d));
+    SnapPut(&(t->data),GetArrayBaseIsLogRel(d));
+    SnapPut(&(t->data),GetArrayBaseIsWhen(d));
+    SnapPut(&(t->data),len);
+    for (c = 1; c <= len; c++) {
+      ind = (struct IndexType *)gl_fetch(indices,c);
+      SnapPut(&(t->data),SnapWriteStr(w,GetIndexSetStr(ind)));
+      SnapPut(&(t->data),GetIndexType(ind));
+    }
+  } else {
+    name = SnapWriteStr(w,GetName(d));
+    id = SnapEntry(t);
+    SnapPut(&(t->data),SNAP_TYPE_NAMED);
+    SnapPut(&(t->data),name);
+  }
+  SnapMapAdd(&(w->type),d,id);
+  return id;
+}
+
+/* 4 words a term: type, then as below. Operands are positions in side. */
+static void SnapWriteSide(struct SnapWriter *w, struct SnapBuf *b,
+                          union RelationTermUnion *side, unsigned long len)
+{
+  struct relation_term *term;
+  unsigned long c;
+  uint64_t x, y, z;
+  for (c = 0; c < len; c++) {
+    term = A_TERM(&(side[c]));
+    x = y = z = 0;
+    switch (term->t) {
+    case e_zero:
+      break;
+    case e_var:
+      x = V_TERM(term)->flags;
+      y = V_TERM(term)->varnum;
+      break;
+    case e_int:
+      y = (uint64_t)(int64_t)I_TERM(term)->ivalue;
+      break;
+    case e_real:
+      x = SnapWriteDim(w,R_TERM(term)->dimensions);
+      z = SnapDouble(R_TERM(term)->value);
+      break;
+    case e_func:
+      x = SnapWriteFunc(w,F_TERM(term)->fptr);
+      y = UNION_TERM(F_TERM(term)->left) - side;
+      break;
+    case e_uminus:
+      x = U_TERM(term)->flags;
+      y = UNION_TERM(U_TERM(term)->left) - side;
+      break;
+    case e_plus: case e_minus: case e_times:
+    case e_divide: case e_power: case e_ipower:
+      x = B_TERM(term)->flags;
+      y = UNION_TERM(B_TERM(term)->left) - side;
+      z = UNION_TERM(B_TERM(term)->right) - side;
+      break;
+    default:
+      /* CopyRelationSide doesn't know any others either */
+      w->nbad++;
+      break;
+    }
+    SnapPut(b,term->t);
+    SnapPut(b,x);
+    SnapPut(b,y);
+    SnapPut(b,z);
+  }
+}
+
+static uint64_t SnapWriteShare(struct SnapWriter *w, union RelationUnion *share)
+{
+  struct SnapTable *t = &(w->tab[SNAP_SHARE]);
+  struct TokenRelation *tok = &(share->token);
+  unsigned long id;
+  if ((id = SnapMapFind(&(w->share),share)) != 0) return id;
+  id = SnapEntry(t);
+  SnapPut(&(t->data),tok->relop);
+  SnapPut(&(t->data),tok->lhs_len);
+  SnapPut(&(t->data),tok->rhs_len);
+  SnapPut(&(t->data),(tok->lhs != NULL) ? UNION_TERM(tok->lhs_term) - tok->lhs : 0);
+  SnapPut(&(t->data),(tok->rhs != NULL) ? UNION_TERM(tok->rhs_term) - tok->rhs : 0);
+  SnapWriteSide(w,&(t->data),tok->lhs,tok->lhs_len);
+  SnapWriteSide(w,&(t->data),tok->rhs,tok->rhs_len);
+  SnapMapAdd(&(w->share),share,id);
+  return id;
+}
+
+/** id of an instance the node being written links to */
+static uint64_t SnapNodeId(struct SnapWriter *w, struct Instance *i)
+{
+  unsigned long id;
+  if (i == NULL) return 0;
+  if ((id = GetTmpNum(i)) == 0) {
+    w->nbad++; /* not in the tree being written */
+  }
+  return id;
+}
+
+/** the next member of the clique of i that is in the tree, if not i */
+static uint64_t SnapCliqueNext(struct Instance *i)
+{
+  struct Instance *ptr;
+  if (i->t == DUMMY_INST || i->t == REL_INST) return 0;
+  for (ptr = NextCliqueMember(i); ptr != i; ptr = NextCliqueMember(ptr)) {
+    if (GetTmpNum(ptr) != 0) return GetTmpNum(ptr);
+  }
+  return 0;
+}
+
+static void SnapWriteSet(struct SnapWriter *w, struct SnapBuf *b,
+                         CONST struct set_t *s)
+{
+  unsigned long c, len;
+  if (s == NULL) {
+    SnapPut(b,0);
+    return;
+  }
+  len = Cardinality(s);
+  SnapPut(b,1 + SetKind(s));
+  SnapPut(b,len);
+  for (c = 1; c <= len; c++) {
+    if (SetKind(s) == integer_set) {
+      SnapPut(b,(uint64_t)(int64_t)FetchIntMember(s,c));
+    } else {
+      SnapPut(b,SnapWriteStr(w,FetchStrMember(s,c)));
+    }
+  }
+}
+
+/* the children of atoms and relations, always last in a node */
+static void SnapWriteFundamentals(struct SnapWriter *w, struct SnapBuf *b,
+                                  struct Instance *i)
+{
+  struct Instance *ch;
+  unsigned long c, len;
+  len = NumberChildren(i);
+  SnapPut(b,len);
+  for (c = 1; c <= len; c++) {
+    ch = InstanceChild(i,c);
+    SnapPut(b,ch->t);
+    switch (ch->t) {
+    case REAL_INST:
+      SnapPut(b,SnapDouble(R_INST(ch)->value));
+      SnapPut(b,SnapWriteDim(w,R_INST(ch)->dimen));
+      SnapPut(b,R_INST(ch)->assigned);
+      SnapPut(b,R_INST(ch)->depth);
+      break;
+    case INTEGER_INST:
+      SnapPut(b,(uint64_t)(int64_t)I_INST(ch)->value);
+      SnapPut(b,I_INST(ch)->assigned);
+      SnapPut(b,I_INST(ch)->depth);
+      break;
+    case BOOLEAN_INST:
+      SnapPut(b,B_INST(ch)->value);
+      SnapPut(b,B_INST(ch)->assigned);
+      SnapPut(b,B_INST(ch)->depth);
+      break;
+    case SET_INST:
+      SnapPut(b,S_INST(ch)->int_set);
+      SnapWriteSet(w,b,S_INST(ch)->list);
+      break;
+    case SYMBOL_INST:
+      SnapPut(b,SnapWriteStr(w,SYM_INST(ch)->value));
+      SnapPut(b,SYM_INST(ch)->assigned);
+      break;
+    default:
+      ASC_PANIC("Atom with a child that isn't fundamental");
+    }
+  }
+}
+
+static void SnapWriteNode(struct SnapWriter *w, struct Instance *i)
+{
+  struct SnapTable *t = &(w->tab[SNAP_NODE]);
+  struct SnapBuf *b = &(t->data);
+  struct BitList *bl;
+  struct ArrayChild *ac;
+  struct gl_list_t *list;
+  struct relation *rel;
+  enum Expr_enum reltype;
+  unsigned long c, len, k;
+  uint64_t type, word;
+
+  type = SnapWriteType(w,InstanceTypeDesc(i));
+  SnapEntry(t);
+  SnapPut(b,i->t);
+  SnapPut(b,type);
+  SnapPut(b,SnapCliqueNext(i));
+  switch (i->t) {
+  case MODEL_INST:
+    len = NumberChildren(i);
+    SnapPut(b,len);
+    for (c = 1; c <= len; c++) {
+      SnapPut(b,SnapNodeId(w,InstanceChild(i,c)));
+    }
+    bl = MOD_INST(i)->executed;
+    len = (bl != NULL) ? BLength(bl) : 0;
+    SnapPut(b,len);
+    for (c = 0; c < len; c += 64) {
+      word = 0;
+      for (k = 0; k < 64 && c+k < len; k++) {
+        if (ReadBit(bl,c+k)) word |= UINT64_C(1) << k;
+      }
+      SnapPut(b,word);
+    }
+    break;
+  case ARRAY_INT_INST:
+  case ARRAY_ENUM_INST:
+    SnapPut(b,ARY_INST(i)->indirected);
+    list = ARY_INST(i)->children;
+    if (list == NULL) {
+      SnapPut(b,SNAP_NONE);
+      break;
+    }
+    len = gl_length(list);
+    SnapPut(b,len);
+    for (c = 1; c <= len; c++) {
+      ac = (struct ArrayChild *)gl_fetch(list,c);
+      if (i->t == ARRAY_INT_INST) {
+        SnapPut(b,(uint64_t)(int64_t)ac->name.index);
+      } else {
+        SnapPut(b,SnapWriteStr(w,ac->name.str));
+      }
+      SnapPut(b,SnapNodeId(w,ac->inst));
+    }
+    break;
+  case REAL_ATOM_INST:
+    SnapPut(b,SnapDouble(RealAtomValue(i)));
+    SnapPut(b,SnapWriteDim(w,RA_INST(i)->dimen));
+    SnapPut(b,RA_INST(i)->assigned);
+    SnapPut(b,RA_INST(i)->depth);
+    list = RA_INST(i)->relations;
+    len = (list != NULL) ? gl_length(list) : 0;
+    SnapPut(b,len);
+    for (c = 1; c <= len; c++) {
+      SnapPut(b,SnapNodeId(w,(struct Instance *)gl_fetch(list,c)));
+    }
+    SnapWriteFundamentals(w,b,i);
+    break;
+  case INTEGER_ATOM_INST:
+    SnapPut(b,(uint64_t)(int64_t)IA_INST(i)->value);
+    SnapPut(b,IA_INST(i)->assigned);
+    SnapPut(b,IA_INST(i)->depth);
+    SnapWriteFundamentals(w,b,i);
+    break;
+  case BOOLEAN_ATOM_INST:
+    SnapPut(b,BA_INST(i)->value);
+    SnapPut(b,BA_INST(i)->assigned);
+    SnapPut(b,BA_INST(i)->depth);
+    SnapWriteFundamentals(w,b,i);
+    break;
+  case SET_ATOM_INST:
+    SnapPut(b,SA_INST(i)->int_set);
+    SnapWriteSet(w,b,SA_INST(i)->list);
+    SnapWriteFundamentals(w,b,i);
+    break;
+  case SYMBOL_ATOM_INST:
+    SnapPut(b,SnapWriteStr(w,SYMA_INST(i)->value));
+    SnapWriteFundamentals(w,b,i);
+    break;
+  case REAL_CONSTANT_INST:
+    SnapPut(b,RC_INST(i)->vflag);
+    SnapPut(b,SnapDouble(RC_INST(i)->value));
+    SnapPut(b,SnapWriteDim(w,RC_INST(i)->dimen));
+    break;
+  case INTEGER_CONSTANT_INST:
+    SnapPut(b,IC_INST(i)->vflag);
+    SnapPut(b,(uint64_t)(int64_t)IC_INST(i)->value);
+    break;
+  case BOOLEAN_CONSTANT_INST:
+    SnapPut(b,BC_INST(i)->vflag);
+    break;
+  case SYMBOL_CONSTANT_INST:
+    SnapPut(b,SYMC_INST(i)->vflag);
+    SnapPut(b,SnapWriteStr(w,SYMC_INST(i)->value));
+    break;
+  case REL_INST:
+    rel = (struct relation *)GetInstanceRelation(i,&reltype);
+    if (rel == NULL) {
+      SnapPut(b,0);
+    } else {
+      SnapPut(b,SnapWriteShare(w,rel->share));
+      SnapPut(b,SnapDouble(rel->residual));
+      SnapPut(b,SnapDouble(rel->multiplier));
+      SnapPut(b,SnapDouble(rel->nominal));
+      SnapPut(b,(uint64_t)(int64_t)rel->iscond);
+      SnapPut(b,SnapWriteDim(w,rel->d));
+      len = NumberVariables(rel);
+      SnapPut(b,len);
+      for (c = 1; c <= len; c++) {
+        SnapPut(b,SnapNodeId(w,RelationVariable(rel,c)));
+      }
+    }
+    SnapWriteFundamentals(w,b,i);
+    break;
+  case DUMMY_INST:
+    break;
+  default:
+    ASC_PANIC("Unexpected instance kind in snapshot");
+  }
+}
+
+struct SnapCollect {
+  struct gl_list_t *nodes;
+  unsigned long nlogic, next, npending;
+};
+
+/* number the nodes (bottom up, so the root is last) and look for any we can't save */
+static void SnapCollectNode(struct Instance *i, VOIDPTR ptr)
+{
+  struct SnapCollect *col = (struct SnapCollect *)ptr;
+  enum Expr_enum reltype;
+  switch (i->t) {
+  case REAL_INST:
+  case INTEGER_INST:
+  case BOOLEAN_INST:
+  case SET_INST:
+  case SYMBOL_INST:
+    return;
+  case LREL_INST:
+  case WHEN_INST:
+    col->nlogic++;
+    return;
+  case MODEL_INST:
+    if (InstanceInList(i)
+        || (MOD_INST(i)->link_table != NULL
+            && gl_length(MOD_INST(i)->link_table) > 0)) {
+      col->npending++;
+    }
+    break;
+  case ARRAY_INT_INST:
+  case ARRAY_ENUM_INST:
+    if (InstanceInList(i)) col->npending++;
+    break;
+  case REL_INST:
+    if (GetInstanceRelation(i,&reltype) != NULL && reltype != e_token) {
+      col->next++;
+    }
+    break;
+  default:
+    break;
+  }
+  gl_append_ptr(col->nodes,i);
+  SetTmpNum(i,gl_length(col->nodes));
+}
+
+static void SnapWriterDestroy(struct SnapWriter *w)
+{
+  int t;
+  for (t = 0; t < SNAP_NTABLE; t++) {
+    if (w->tab[t].index.w != NULL) ascfree(w->tab[t].index.w);
+    if (w->tab[t].data.w != NULL) ascfree(w->tab[t].data.w);
+  }
+  SnapMapDestroy(&(w->str));
+  SnapMapDestroy(&(w->dim));
+  SnapMapDestroy(&(w->func));
+  SnapMapDestroy(&(w->type));
+  SnapMapDestroy(&(w->share));
+}
+
+/* lay the tables out one after the other, each index before its entries */
+static int SnapWriteFile(struct SnapWriter *w, CONST char *filename,
+                         uint64_t root, uint64_t name)
+{
+  struct SnapHeader h;
+  struct SnapTable *t;
+  uint64_t off, base;
+  unsigned long c;
+  int i, err = 0;
+  FILE *fp;
+
+  memset(&h,0,sizeof(h));
+  memcpy(h.magic,"ASCSNAP",8);
+  h.order = SNAP_ORDER;
+  h.version = SNAP_VERSION;
+  h.root = root;
+  h.name = name;
+  off = sizeof(h);
+  for (i = 0; i < SNAP_NTABLE; i++) {
+    t = &(w->tab[i]);
+    h.count[i] = t->index.n;
+    h.index[i] = off;
+    base = off + (t->index.n + 1)*sizeof(uint64_t);
+    for (c = 0; c < t->index.n; c++) {
+      t->index.w[c] = base + t->index.w[c]*sizeof(uint64_t);
+    }
+    SnapPut(&(t->index),base + t->data.n*sizeof(uint64_t));
+    off = base + t->data.n*sizeof(uint64_t);
+  }
+  h.size = off;
+
+  fp = fopen(filename,"wb");
+  if (fp == NULL) {
+    ERROR_REPORTER_HERE(ASC_USER_ERROR,"Unable to create snapshot file '%s'",filename);
+    return 1;
+  }
+  if (fwrite(&h,sizeof(h),1,fp) != 1) err = 1;
+  for (i = 0; i < SNAP_NTABLE && !err; i++) {
+    t = &(w->tab[i]);
+    if (fwrite(t->index.w,sizeof(uint64_t),t->index.n,fp) != t->index.n
+        || (t->data.n > 0
+            && fwrite(t->data.w,sizeof(uint64_t),t->data.n,fp) != t->data.n)) {
+      err = 1;
+    }
+  }
+  if (fclose(fp) != 0) err = 1;
+  if (err) {
+    ERROR_REPORTER_HERE(ASC_USER_ERROR,"Error writing snapshot file '%s'",filename);
+  }
+  return err;
+}
+
+int WriteInstanceSnapshot(struct Instance *sim, CONST char *filename)
+{
+  struct SnapWriter w;
+  struct SnapCollect col;
+  struct Instance *root;
+  unsigned long c, len;
+  uint64_t rootid, name;
+  int result;
+
+  if (sim == NULL || InstanceKind(sim) != SIM_INST
+      || (root = GetSimulationRoot(sim)) == NULL) {
+    ERROR_REPORTER_HERE(ASC_PROG_ERR,"No simulation to write a snapshot of");
+    return 1;
+  }
+  memset(&col,0,sizeof(col));
+  col.nodes = gl_create(1000L);
+  VisitInstanceTreeTwo(root,SnapCollectNode,1,0,&col);
+  if (col.nlogic > 0 || col.next > 0 || col.npending > 0) {
+    ERROR_REPORTER_HERE(ASC_USER_ERROR,"Can't write a snapshot of '%s': it has"
+      " %lu WHENs or logical relations, %lu external relations and"
+      " %lu pending or LINKed instances"
+      ,SCP(GetSimulationName(sim)),col.nlogic,col.next,col.npending
+    );
+    ZeroTmpNums(root,1);
+    gl_destroy(col.nodes);
+    return 1;
+  }
+
+  memset(&w,0,sizeof(w));
+  len = gl_length(col.nodes);
+  for (c = 1; c <= len; c++) {
+    SnapWriteNode(&w,(struct Instance *)gl_fetch(col.nodes,c));
+  }
+  rootid = GetTmpNum(root);
+  name = SnapWriteStr(&w,GetSimulationName(sim));
+  /* leave the tmp_nums zero for the next user, as CopyInstance does */
+  ZeroTmpNums(root,1);
+  gl_destroy(col.nodes);
+
+  if (w.nbad > 0) {
+    ERROR_REPORTER_HERE(ASC_PROG_ERR,"Instance tree of '%s' has %lu links that"
+      " can't be saved",SCP(GetSimulationName(sim)),w.nbad
+    );
+    result = 1;
+  } else {
+    result = SnapWriteFile(&w,filename,rootid,name);
+  }
+  SnapWriterDestroy(&w);
+  return result;
+}
+
+/*------------------------------------------------------------------------------
+  READING
+*/
+
+enum SnapPass {
+  SNAP_CHECK,   /* check a node against the library, making nothing */
+  SNAP_CREATE,  /* make the node, with its values */
+  SNAP_LINK     /* link it to the nodes it refers to */
+};
+
+struct SnapReader {
+  CONST char *filename;
+  CONST unsigned char *base;
+  uint64_t size;
+  CONST struct SnapHeader *h;
+  CONST uint64_t *index[SNAP_NTABLE];
+  unsigned long count[SNAP_NTABLE];
+  /* converted on first use, by id */
+  symchar **str;
+  CONST dim_type **dim;
+  CONST struct Func **func;
+  struct TypeDescription **type;
+  union RelationUnion **share;
+  long *sharevars;         /* largest varnum in each share, -1 if unchecked */
+  struct Instance **inst;
+  char *shared;            /* node is a UNIVERSAL instance that existed already */
+  int bad;
+  VOIDPTR mem;
+};
+
+struct SnapCursor {
+  struct SnapReader *r;
+  CONST uint64_t *p, *end;
+};
+
+static void SnapOpenEntry(struct SnapCursor *c, struct SnapReader *r,
+                          int table, unsigned long id)
+{
+  c->r = r;
+  c->p = (CONST uint64_t *)(r->base + r->index[table][id-1]);
+  c->end = (CONST uint64_t *)(r->base + r->index[table][id]);
+}
+
+static uint64_t SnapGet(struct SnapCursor *c)
+{
+  if (c->p < c->end) return *(c->p++);
+  c->r->bad = 1;
+  return 0;
+}
+
+static unsigned long SnapGetId(struct SnapCursor *c, int table)
+{
+  uint64_t id = SnapGet(c);
+  if (id > c->r->count[table]) {
+    c->r->bad = 1;
+    return 0;
+  }
+  return (unsigned long)id;
+}
+
+/** a count of things of per words each still to come in the entry */
+static unsigned long SnapGetCount(struct SnapCursor *c, unsigned long per)
+{
+  uint64_t n = SnapGet(c);
+  if (n > (uint64_t)(c->end - c->p)/per) {
+    c->r->bad = 1;
+    return 0;
+  }
+  return (unsigned long)n;
+}
+
+static symchar *SnapStr(struct SnapReader *r, unsigned long id)
+{
+  struct SnapCursor c;
+  unsigned long len;
+  if (id == 0) return NULL;
+  if (r->str[id] == NULL) {
+    SnapOpenEntry(&c,r,SNAP_STR,id);
+    len = SnapGet(&c);
+    if (len >= (unsigned long)(c.end - c.p)*8
+        || ((CONST char *)c.p)[len] != '\0') {
+      r->bad = 1;
+      return NULL;
+    }
+    r->str[id] = AddSymbolL((CONST char *)c.p,(int)len);
+  }
+  return r->str[id];
+}
+
+static CONST dim_type *SnapDim(struct SnapReader *r, unsigned long id)
+{
+  struct SnapCursor c;
+  dim_type d;
+  int k;
+  if (id == 0) return NULL;
+  if (r->dim[id] == NULL) {
+    SnapOpenEntry(&c,r,SNAP_DIM,id);
+    ClearDimensions(&d);
+    d.wild = (unsigned)SnapGet(&c);
+    for (k = 0; k < NUM_DIMENS; k++) {
+      d.f[k].numerator = (FRACPART)(int64_t)SnapGet(&c);
+      d.f[k].denominator = (FRACPART)(int64_t)SnapGet(&c);
+      if (d.f[k].denominator == 0) r->bad = 1;
+    }
+    if (r->bad) return NULL;
+    r->dim[id] = FindOrAddDimen(&d);
+  }
+  return r->dim[id];
+}
+
+static CONST struct Func *SnapFunc(struct SnapReader *r, unsigned long id)
+{
+  struct SnapCursor c;
+  symchar *name;
+  if (r->func[id] == NULL) {
+    SnapOpenEntry(&c,r,SNAP_FUNC,id);
+    name = SnapStr(r,SnapGetId(&c,SNAP_STR));
+    if (name == NULL || (r->func[id] = LookupFunc(SCP(name))) == NULL) {
+      ERROR_REPORTER_HERE(ASC_USER_ERROR,"Function '%s' in snapshot '%s' is unknown"
+        ,(name != NULL) ? SCP(name) : "",r->filename
+      );
+      r->bad = 1;
+    }
+  }
+  return r->func[id];
+}
+
+static struct TypeDescription *SnapType(struct SnapReader *r, unsigned long id,
+                                        int depth)
+{
+  struct SnapCursor c;
+  struct TypeDescription *base;
+  CONST struct module_t *mod;
+  struct gl_list_t *indices;
+  symchar *name, *modname, *set;
+  unsigned long baseid, k, len;
+  int isint, isrel, islogrel, iswhen, intindex;
+
+  if (id == 0) return NULL;
+  if (r->type[id] != NULL) return r->type[id];
+  SnapOpenEntry(&c,r,SNAP_TYPE,id);
+  switch (SnapGet(&c)) {
+  case SNAP_TYPE_NAMED:
+    name = SnapStr(r,SnapGetId(&c,SNAP_STR));
+    if (name != NULL && (r->type[id] = FindType(name)) == NULL) {
+      ERROR_REPORTER_HERE(ASC_USER_ERROR,"Type '%s' in snapshot '%s' is not in the library"
+        ,SCP(name),r->filename
+      );
+    }
+    break;
+  case SNAP_TYPE_RELATION:
+    r->type[id] = FindRelationType();
+    break;
+  case SNAP_TYPE_DUMMY:
+    r->type[id] = FindDummyType();
+    break;
+  case SNAP_TYPE_ARRAY:
+    modname = SnapStr(r,SnapGetId(&c,SNAP_STR));
+    baseid = SnapGetId(&c,SNAP_TYPE);
+    isint = (int)SnapGet(&c);
+    isrel = (int)SnapGet(&c);
+    islogrel = (int)SnapGet(&c);
+    iswhen = (int)SnapGet(&c);
+    len = SnapGetCount(&c,2);
+    if (depth > 16 || r->bad) break;
+    base = SnapType(r,baseid,depth+1);
+    if (baseid != 0 && base == NULL) break;
+    mod = (modname != NULL) ? Asc_GetModuleByName(SCP(modname)) : NULL;
+    if (mod == NULL && base != NULL) mod = GetModule(base);
+    indices = gl_create(len);
+    for (k = 1; k <= len; k++) {
+      set = SnapStr(r,SnapGetId(&c,SNAP_STR));
+      intindex = (int)SnapGet(&c);
+      gl_append_ptr(indices,(set != NULL)
+        ? CreateIndexTypeFromStr((char *)SCP(set),intindex)
+        : CreateDummyIndexType(intindex)
+      );
+    }
+    /* this reference is given up when the snapshot is closed */
+    r->type[id] = CreateArrayTypeDesc((struct module_t *)mod,base
+      ,isint,isrel,islogrel,iswhen,indices
+    );
+    break;
+  default:
+    break;
+  }
+  if (r->type[id] == NULL) r->bad = 1;
+  return r->type[id];
+}
+
+/** check a share's terms, giving the largest varnum in it */
+static long SnapCheckShare(struct SnapReader *r, unsigned long id)
+{
+  struct SnapCursor c;
+  unsigned long len[2], rootpos[2], s, k;
+  uint64_t t, x, y, z;
+  long maxvar = 0;
+
+  if (r->sharevars[id] != -1) return r->sharevars[id];
+  SnapOpenEntry(&c,r,SNAP_SHARE,id);
+  (void)SnapGet(&c);
+  len[0] = SnapGet(&c);
+  len[1] = SnapGet(&c);
+  rootpos[0] = SnapGet(&c);
+  rootpos[1] = SnapGet(&c);
+  if (len[0] + len[1] > (unsigned long)(c.end - c.p)/4) r->bad = 1;
+  for (s = 0; s < 2 && !r->bad; s++) {
+    if (len[s] > 0 && rootpos[s] >= len[s]) r->bad = 1;
+    for (k = 0; k < len[s] && !r->bad; k++) {
+      t = SnapGet(&c);
+      x = SnapGet(&c);
+      y = SnapGet(&c);
+      z = SnapGet(&c);
+      /* operands come before their operators in postfix */
+      switch (t) {
+      case e_zero:
+      case e_int:
+        break;
+      case e_var:
+        if (y == 0) r->bad = 1;
+        if ((long)y > maxvar) maxvar = (long)y;
+        break;
+      case e_real:
+        if (x > r->count[SNAP_DIM]) r->bad = 1;
+        break;
+      case e_func:
+        if (x == 0 || x > r->count[SNAP_FUNC] || y >= k
+            || SnapFunc(r,(unsigned long)x) == NULL) {
+          r->bad = 1;
+        }
+        break;
+      case e_uminus:
+        if (y >= k) r->bad = 1;
+        break;
+      case e_plus: case e_minus: case e_times:
+      case e_divide: case e_power: case e_ipower:
+        if (y >= k || z >= k) r->bad = 1;
+        break;
+      default:
+        r->bad = 1;
+      }
+    }
+  }
+  r->sharevars[id] = r->bad ? -2 : maxvar;
+  return r->sharevars[id];
+}
+
+static union RelationTermUnion *SnapSide(struct SnapReader *r,
+                                         struct SnapCursor *c, unsigned long len)
+{
+  union RelationTermUnion *side;
+  struct relation_term *term;
+  unsigned long k;
+  uint64_t x, y, z;
+  if (len == 0) return NULL;
+  side = ASC_NEW_ARRAY_CLEAR(union RelationTermUnion,len);
+  for (k = 0; k < len; k++) {
+    term = A_TERM(&(side[k]));
+    term->t = (enum Expr_enum)SnapGet(c);
+    x = SnapGet(c);
+    y = SnapGet(c);
+    z = SnapGet(c);
+    switch (term->t) {
+    case e_var:
+      V_TERM(term)->flags = (unsigned int)x;
+      V_TERM(term)->varnum = (unsigned long)y;
+      break;
+    case e_int:
+      I_TERM(term)->ivalue = (long)(int64_t)y;
+      break;
+    case e_real:
+      R_TERM(term)->dimensions = SnapDim(r,(unsigned long)x);
+      R_TERM(term)->value = SnapGetDouble(z);
+      break;
+    case e_func:
+      F_TERM(term)->fptr = r->func[x];
+      F_TERM(term)->left = A_TERM(side + y);
+      break;
+    case e_uminus:
+      U_TERM(term)->flags = (unsigned int)x;
+      U_TERM(term)->left = A_TERM(side + y);
+      break;
+    case e_plus: case e_minus: case e_times:
+    case e_divide: case e_power: case e_ipower:
+      B_TERM(term)->flags = (unsigned int)x;
+      B_TERM(term)->left = A_TERM(side + y);
+      B_TERM(term)->right = A_TERM(side + z);
+      break;
+    default:
+      break;
+    }
+  }
+  return side;
+}
+
+/** make a share the first time a relation needs it (it has been checked) */
+static union RelationUnion *SnapShare(struct SnapReader *r, unsigned long id)
+{
+  struct SnapCursor c;
+  struct TokenRelation *tok;
+  unsigned long lhsroot, rhsroot;
+  if (r->share[id] == NULL) {
+    SnapOpenEntry(&c,r,SNAP_SHARE,id);
+    /* yes, the sizeof in the following is correct. TOKENDOMINANT. */
+    tok = (struct TokenRelation *)asccalloc(1,sizeof(union RelationUnion));
+    tok->relop = (enum Expr_enum)SnapGet(&c);
+    tok->lhs_len = SnapGet(&c);
+    tok->rhs_len = SnapGet(&c);
+    lhsroot = SnapGet(&c);
+    rhsroot = SnapGet(&c);
+    tok->lhs = SnapSide(r,&c,tok->lhs_len);
+    tok->rhs = SnapSide(r,&c,tok->rhs_len);
+    tok->lhs_term = (tok->lhs != NULL) ? A_TERM(tok->lhs + lhsroot) : NULL;
+    tok->rhs_term = (tok->rhs != NULL) ? A_TERM(tok->rhs + rhsroot) : NULL;
+    tok->ref_count = 0;
+    tok->btable = 0;
+    tok->bindex = 0;
+    tok->opcodes = NULL;
+    r->share[id] = (union RelationUnion *)tok;
+  }
+  return r->share[id];
+}
+
+static enum inst_t SnapNodeKind(struct SnapReader *r, unsigned long id)
+{
+  return (enum inst_t)*(CONST uint64_t *)(r->base + r->index[SNAP_NODE][id-1]);
+}
+
+static int SnapKindMatches(enum inst_t kind, CONST struct TypeDescription *d)
+{
+  switch (kind) {
+  case MODEL_INST:            return GetBaseType(d) == model_type;
+  case ARRAY_INT_INST:
+  case ARRAY_ENUM_INST:       return GetBaseType(d) == array_type;
+  case REAL_ATOM_INST:        return GetBaseType(d) == real_type;
+  case INTEGER_ATOM_INST:     return GetBaseType(d) == integer_type;
+  case BOOLEAN_ATOM_INST:     return GetBaseType(d) == boolean_type;
+  case SET_ATOM_INST:         return GetBaseType(d) == set_type;
+  case SYMBOL_ATOM_INST:      return GetBaseType(d) == symbol_type;
+  case REAL_CONSTANT_INST:    return GetBaseType(d) == real_constant_type;
+  case INTEGER_CONSTANT_INST: return GetBaseType(d) == integer_constant_type;
+  case BOOLEAN_CONSTANT_INST: return GetBaseType(d) == boolean_constant_type;
+  case SYMBOL_CONSTANT_INST:  return GetBaseType(d) == symbol_constant_type;
+  case REL_INST:              return GetBaseType(d) == relation_type;
+  case DUMMY_INST:            return GetBaseType(d) == dummy_type;
+  default:                    return 0;
+  }
+}
+
+static struct set_t *SnapReadSet(struct SnapReader *r, struct SnapCursor *c,
+                                 enum SnapPass pass)
+{
+  struct set_t *s = NULL;
+  unsigned long k, len;
+  uint64_t kind, v;
+  kind = SnapGet(c);
+  if (kind == 0) return NULL;
+  len = SnapGetCount(c,1);
+  if (kind != 1 + integer_set && kind != 1 + string_set
+      && (kind != 1 + empty_set || len > 0)) {
+    r->bad = 1;
+    return NULL;
+  }
+  if (pass == SNAP_CREATE) s = CreateEmptySet();
+  for (k = 0; k < len; k++) {
+    /* members come sorted, so each insert is at the end */
+    if (kind == 1 + integer_set) {
+      v = SnapGet(c);
+      if (s != NULL) InsertInteger(s,(asc_intptr_t)(int64_t)v);
+    } else {
+      v = SnapGetId(c,SNAP_STR);
+      if (s != NULL) InsertString(s,SnapStr(r,(unsigned long)v));
+    }
+  }
+  return s;
+}
+
+static enum inst_t SnapFundamentalKind(struct ChildDesc cd)
+{
+  switch (ChildDescType(cd)) {
+  case real_child:    return REAL_INST;
+  case integer_child: return INTEGER_INST;
+  case boolean_child: return BOOLEAN_INST;
+  case set_child:     return SET_INST;
+  case symbol_child:  return SYMBOL_INST;
+  default:            return ERROR_INST;
+  }
+}
+
+/* the children of atoms and relations: checked, or filled in on i */
+static void SnapFundamentals(struct SnapReader *r, struct SnapCursor *c,
+                             struct Instance *i, struct TypeDescription *type,
+                             enum SnapPass pass)
+{
+  struct Instance *ch = NULL;
+  struct set_t *s;
+  unsigned long k, len;
+  uint64_t kind, v;
+  unsigned long dim;
+  unsigned assigned, depth;
+
+  len = SnapGet(c);
+  if (pass == SNAP_CHECK && len != ChildListLen(GetChildList(type))) {
+    r->bad = 1;
+    return;
+  }
+  for (k = 1; k <= len && !r->bad; k++) {
+    kind = SnapGet(c);
+    if (pass == SNAP_CHECK
+        && kind != SnapFundamentalKind(GetChildArrayElement(GetChildDesc(type),k))) {
+      r->bad = 1;
+      return;
+    }
+    if (pass == SNAP_CREATE) ch = InstanceChild(i,k);
+    switch (kind) {
+    case REAL_INST:
+      v = SnapGet(c);
+      dim = SnapGetId(c,SNAP_DIM);
+      assigned = (unsigned)SnapGet(c);
+      depth = (unsigned)SnapGet(c);
+      if (ch != NULL) {
+        R_INST(ch)->value = SnapGetDouble(v);
+        R_INST(ch)->dimen = SnapDim(r,dim);
+        R_INST(ch)->assigned = assigned;
+        R_INST(ch)->depth = depth;
+      }
+      break;
+    case INTEGER_INST:
+      v = SnapGet(c);
+      assigned = (unsigned)SnapGet(c);
+      depth = (unsigned)SnapGet(c);
+      if (ch != NULL) {
+        I_INST(ch)->value = (long)(int64_t)v;
+        I_INST(ch)->assigned = assigned;
+        I_INST(ch)->depth = depth;
+      }
+      break;
+    case BOOLEAN_INST:
+      v = SnapGet(c);
+      assigned = (unsigned)SnapGet(c);
+      depth = (unsigned)SnapGet(c);
+      if (ch != NULL) {
+        B_INST(ch)->value = (unsigned)v;
+        B_INST(ch)->assigned = assigned;
+        B_INST(ch)->depth = depth;
+      }
+      break;
+    case SET_INST:
+      v = SnapGet(c);
+      s = SnapReadSet(r,c,pass);
+      if (ch != NULL) {
+        if (S_INST(ch)->list != NULL) DestroySet(S_INST(ch)->list);
+        S_INST(ch)->int_set = (unsigned)v;
+        S_INST(ch)->list = s;
+      }
+      break;
+    case SYMBOL_INST:
+      v = SnapGetId(c,SNAP_STR);
+      assigned = (unsigned)SnapGet(c);
+      if (ch != NULL) {
+        SYM_INST(ch)->value = SnapStr(r,(unsigned long)v);
+        SYM_INST(ch)->assigned = assigned;
+      }
+      break;
+    default:
+      r->bad = 1;
+    }
+  }
+}
+
+/* as CreateModelInstance, but never from a prototype: the children come later */
+static struct Instance *SnapCreateModel(struct TypeDescription *type,
+                                        struct BitList *executed)
+{
+  struct ModelInstance *result;
+  unsigned long num_children;
+  CopyTypeDesc(type);
+  num_children = ChildListLen(GetChildList(type));
+  result = MOD_INST(ascmalloc((unsigned)sizeof(struct ModelInstance)
+                    + (unsigned)num_children*(unsigned)sizeof(struct Instance *)));
+  result->t = MODEL_INST;
+  result->pending_entry = NULL;
+  result->interface_ptr = NULL;
+  result->parents = gl_create(AVG_PARENTS);
+  result->whens = NULL;
+  result->link_table = gl_create(AVG_LINKS);
+  result->desc = type;
+  result->alike_ptr = INST(result);
+  result->visited = 0;
+  result->tmp_num = 0;
+  result->anon_flags = 0x0;
+#if (LONGCHILDREN == 1)
+  result->padding = INT_MAX;
+#endif
+  result->executed = executed;
+  ZeroNewChildrenEntries(MOD_CHILD(result,0),num_children);
+  if (GetUniversalFlag(type)) {
+    AddUniversalInstance(GetUniversalTable(),type,INST(result));
+  }
+  return INST(result);
+}
+
+static void SnapLinkChild(struct Instance *parent, struct Instance *child)
+{
+  if (SearchForParent(child,parent) == 0) {
+    AddParent(child,parent);
+  }
+}
+
+static void SnapNode(struct SnapReader *r, unsigned long id, enum SnapPass pass)
+{
+  struct SnapCursor c;
+  struct TypeDescription *type;
+  struct Instance *i, *ch;
+  struct BitList *bl = NULL;
+  struct ArrayChild *ac;
+  struct gl_list_t *list = NULL;
+  struct relation *rel = NULL;
+  union RelationUnion *share;
+  enum inst_t kind;
+  unsigned long next, len, k, n, shareid, dim;
+  uint64_t v, word;
+  unsigned assigned, depth, vflag;
+  double residual, multiplier, nominal;
+  int iscond;
+
+  SnapOpenEntry(&c,r,SNAP_NODE,id);
+  kind = (enum inst_t)SnapGet(&c);
+  type = SnapType(r,SnapGetId(&c,SNAP_TYPE),0);
+  next = SnapGetId(&c,SNAP_NODE);
+  i = r->inst[id];
+
+  switch (pass) {
+  case SNAP_CHECK:
+    if (type == NULL || !SnapKindMatches(kind,type)) {
+      r->bad = 1;
+      return;
+    }
+    if (kind == MODEL_INST && GetUniversalFlag(type)
+        && LookupInstance(GetUniversalTable(),type) != NULL) {
+      ERROR_REPORTER_HERE(ASC_USER_ERROR,"Snapshot '%s' has its own instance of"
+        " the UNIVERSAL model '%s', which already exists",r->filename,SCP(GetName(type))
+      );
+      r->bad = 1;
+      return;
+    }
+    break;
+  case SNAP_CREATE:
+    /* UNIVERSAL instances already made are shared, as in Instantiate */
+    if ((kind == DUMMY_INST || GetUniversalFlag(type))
+        && (i = LookupInstance(GetUniversalTable(),type)) != NULL) {
+      r->inst[id] = i;
+      r->shared[id] = 1;
+      return;
+    }
+    break;
+  case SNAP_LINK:
+    if (r->shared[id]) return;
+    if (next != 0 && !r->shared[next]) {
+      SetNextCliqueMember(i,r->inst[next]);
+    }
+    break;
+  }
+
+  switch (kind) {
+  case MODEL_INST:
+    len = SnapGetCount(&c,1);
+    if (pass == SNAP_CHECK && len != ChildListLen(GetChildList(type))) {
+      r->bad = 1;
+      return;
+    }
+    for (k = 1; k <= len; k++) {
+      n = SnapGetId(&c,SNAP_NODE);
+      if (pass == SNAP_LINK && n != 0) {
+        SnapLinkChild(i,r->inst[n]);
+        StoreChildPtr(i,k,r->inst[n]);
+      }
+    }
+    if (pass == SNAP_LINK) return;
+    len = SnapGet(&c);
+    if (len > (uint64_t)(c.end - c.p)*64) {
+      r->bad = 1;
+      return;
+    }
+    if (pass == SNAP_CREATE) bl = CreateBList(len);
+    for (k = 0; k < len; k += 64) {
+      word = SnapGet(&c);
+      for (n = 0; n < 64 && k+n < len; n++) {
+        if (bl != NULL && (word & (UINT64_C(1) << n))) SetBit(bl,k+n);
+      }
+    }
+    if (pass == SNAP_CREATE) r->inst[id] = SnapCreateModel(type,bl);
+    break;
+  case ARRAY_INT_INST:
+  case ARRAY_ENUM_INST:
+    v = SnapGet(&c);
+    if (pass == SNAP_CHECK) {
+      list = GetArrayIndexList(type);
+      if (list == NULL || v >= gl_length(list)
+          || (kind == ARRAY_INT_INST)
+             != (GetIndexType((struct IndexType *)gl_fetch(list,v+1)) != 0)) {
+        r->bad = 1;
+        return;
+      }
+    }
+    if (pass == SNAP_CREATE) {
+      /* each array instance holds a reference to its type */
+      CopyTypeDesc(type);
+      r->inst[id] = CreateArrayInstance(type,(unsigned long)v+1);
+      return;
+    }
+    if (c.p < c.end && *c.p == SNAP_NONE) break;
+    len = SnapGetCount(&c,2);
+    if (pass == SNAP_LINK) {
+      list = gl_create((len > 0) ? len : AVG_ARY_CHILDREN);
+    }
+    for (k = 1; k <= len; k++) {
+      v = (kind == ARRAY_INT_INST) ? SnapGet(&c) : SnapGetId(&c,SNAP_STR);
+      n = SnapGetId(&c,SNAP_NODE);
+      if (pass == SNAP_LINK) {
+        ac = MALLOCPOOLAC;
+        if (kind == ARRAY_INT_INST) {
+          ac->name.index = (long)(int64_t)v;
+        } else {
+          ac->name.str = SnapStr(r,(unsigned long)v);
+        }
+        ac->inst = (n != 0) ? r->inst[n] : NULL;
+        if (ac->inst != NULL) SnapLinkChild(i,ac->inst);
+        gl_append_ptr(list,(VOIDPTR)ac);
+      }
+    }
+    if (pass == SNAP_LINK) {
+      gl_set_sorted(list,TRUE); /* because the originals were, by name */
+      ARY_INST(i)->children = list;
+    }
+    break;
+  case REAL_ATOM_INST:
+    v = SnapGet(&c);
+    dim = SnapGetId(&c,SNAP_DIM);
+    assigned = (unsigned)SnapGet(&c);
+    depth = (unsigned)SnapGet(&c);
+    if (pass == SNAP_CREATE) {
+      i = r->inst[id] = CreateRealInstance(type);
+      RA_INST(i)->value = SnapGetDouble(v);
+      RA_INST(i)->dimen = SnapDim(r,dim);
+      RA_INST(i)->assigned = assigned;
+      RA_INST(i)->depth = depth;
+    }
+    len = SnapGetCount(&c,1);
+    if (pass == SNAP_LINK && len > 0) list = gl_create(len);
+    for (k = 1; k <= len; k++) {
+      n = SnapGetId(&c,SNAP_NODE);
+      if (pass == SNAP_CHECK && (n == 0 || SnapNodeKind(r,n) != REL_INST)) {
+        r->bad = 1;
+        return;
+      }
+      if (pass == SNAP_LINK) gl_append_ptr(list,(VOIDPTR)r->inst[n]);
+    }
+    if (pass == SNAP_LINK) {
+      RA_INST(i)->relations = list;
+      return;
+    }
+    SnapFundamentals(r,&c,i,type,pass);
+    break;
+  case INTEGER_ATOM_INST:
+    v = SnapGet(&c);
+    assigned = (unsigned)SnapGet(&c);
+    depth = (unsigned)SnapGet(&c);
+    if (pass == SNAP_CREATE) {
+      i = r->inst[id] = CreateIntegerInstance(type);
+      IA_INST(i)->value = (long)(int64_t)v;
+      IA_INST(i)->assigned = assigned;
+      IA_INST(i)->depth = depth;
+    }
+    if (pass != SNAP_LINK) SnapFundamentals(r,&c,i,type,pass);
+    break;
+  case BOOLEAN_ATOM_INST:
+    v = SnapGet(&c);
+    assigned = (unsigned)SnapGet(&c);
+    depth = (unsigned)SnapGet(&c);
+    if (pass == SNAP_CREATE) {
+      i = r->inst[id] = CreateBooleanInstance(type);
+      BA_INST(i)->value = (unsigned)v;
+      BA_INST(i)->assigned = assigned;
+      BA_INST(i)->depth = depth;
+    }
+    if (pass != SNAP_LINK) SnapFundamentals(r,&c,i,type,pass);
+    break;
+  case SET_ATOM_INST:
+    if (pass == SNAP_LINK) break;
+    v = SnapGet(&c);
+    if (pass == SNAP_CREATE) {
+      i = r->inst[id] = CreateSetInstance(type,(int)v);
+      if (SA_INST(i)->list != NULL) DestroySet(SA_INST(i)->list);
+      SA_INST(i)->list = SnapReadSet(r,&c,pass);
+    } else {
+      (void)SnapReadSet(r,&c,pass);
+    }
+    SnapFundamentals(r,&c,i,type,pass);
+    break;
+  case SYMBOL_ATOM_INST:
+    v = SnapGetId(&c,SNAP_STR);
+    if (pass == SNAP_CREATE) {
+      i = r->inst[id] = CreateSymbolInstance(type);
+      SYMA_INST(i)->value = SnapStr(r,(unsigned long)v);
+    }
+    if (pass != SNAP_LINK) SnapFundamentals(r,&c,i,type,pass);
+    break;
+  case REAL_CONSTANT_INST:
+    vflag = (unsigned)SnapGet(&c);
+    v = SnapGet(&c);
+    dim = SnapGetId(&c,SNAP_DIM);
+    if (pass == SNAP_CREATE) {
+      i = r->inst[id] = CreateRealInstance(type);
+      RC_INST(i)->vflag = vflag;
+      RC_INST(i)->value = SnapGetDouble(v);
+      RC_INST(i)->dimen = SnapDim(r,dim);
+    }
+    break;
+  case INTEGER_CONSTANT_INST:
+    vflag = (unsigned)SnapGet(&c);
+    v = SnapGet(&c);
+    if (pass == SNAP_CREATE) {
+      i = r->inst[id] = CreateIntegerInstance(type);
+      IC_INST(i)->vflag = vflag;
+      IC_INST(i)->value = (long)(int64_t)v;
+    }
+    break;
+  case BOOLEAN_CONSTANT_INST:
+    vflag = (unsigned)SnapGet(&c);
+    if (pass == SNAP_CREATE) {
+      i = r->inst[id] = CreateBooleanInstance(type);
+      BC_INST(i)->vflag = vflag;
+    }
+    break;
+  case SYMBOL_CONSTANT_INST:
+    vflag = (unsigned)SnapGet(&c);
+    v = SnapGetId(&c,SNAP_STR);
+    if (pass == SNAP_CREATE) {
+      i = r->inst[id] = CreateSymbolInstance(type);
+      SYMC_INST(i)->vflag = vflag;
+      SYMC_INST(i)->value = SnapStr(r,(unsigned long)v);
+    }
+    break;
+  case REL_INST:
+    shareid = SnapGetId(&c,SNAP_SHARE);
+    if (shareid != 0) {
+      residual = SnapGetDouble(SnapGet(&c));
+      multiplier = SnapGetDouble(SnapGet(&c));
+      nominal = SnapGetDouble(SnapGet(&c));
+      iscond = (int)(int64_t)SnapGet(&c);
+      dim = SnapGetId(&c,SNAP_DIM);
+      len = SnapGetCount(&c,1);
+      if (pass == SNAP_CHECK && SnapCheckShare(r,shareid) > (long)len) {
+        r->bad = 1;
+      }
+      if (pass == SNAP_LINK) {
+        share = SnapShare(r,shareid);
+        rel = CreateRelationStructure(share->s.relop,crs_NOUNION);
+        if (rel == NULL) {
+          r->bad = 1;
+          return;
+        }
+        rel->share = share;
+        share->s.ref_count++;
+        rel->residual = residual;
+        rel->multiplier = multiplier;
+        rel->nominal = nominal;
+        rel->iscond = iscond;
+        rel->d = (dim_type *)SnapDim(r,dim);
+        rel->vars = gl_create((len > 0) ? len : 1L);
+      }
+      for (k = 1; k <= len; k++) {
+        n = SnapGetId(&c,SNAP_NODE);
+        if (pass == SNAP_CHECK && (n == 0 || SnapNodeKind(r,n) != REAL_ATOM_INST)) {
+          r->bad = 1;
+          return;
+        }
+        if (pass == SNAP_LINK && rel != NULL) {
+          ch = r->inst[n];
+          gl_append_ptr(rel->vars,(VOIDPTR)ch);
+          /* the list of a var made here comes with the var */
+          if (r->shared[n]) AddRelation(ch,i);
+        }
+      }
+      if (pass == SNAP_LINK) {
+        SetInstanceRelation(i,rel,e_token);
+        return;
+      }
+    }
+    if (pass == SNAP_CREATE) {
+      i = r->inst[id] = CreateRelationInstance(type,e_token);
+    }
+    if (pass != SNAP_LINK) SnapFundamentals(r,&c,i,type,pass);
+    break;
+  case DUMMY_INST:
+    if (pass == SNAP_CREATE) r->inst[id] = CreateDummyInstance(type);
+    break;
+  default:
+    r->bad = 1;
+  }
+}
+
+static void SnapCloseFile(struct SnapReader *r)
+{
+#ifndef __WIN32__
+  if (r->mem != NULL) munmap(r->mem,(size_t)r->size);
+#else
+  if (r->mem != NULL) ascfree(r->mem);
+#endif
+  r->mem = NULL;
+}
+
+/* map the file (or read it, where there's no mmap) and check its tables */
+static int SnapOpenFile(struct SnapReader *r, CONST char *filename)
+{
+  CONST struct SnapHeader *h;
+  CONST uint64_t *index;
+  unsigned long k;
+  uint64_t end;
+  int t;
+#ifndef __WIN32__
+  struct stat st;
+  int fd;
+#else
+  FILE *fp;
+  long len;
+#endif
+
+  r->filename = filename;
+#ifndef __WIN32__
+  fd = open(filename,O_RDONLY);
+  if (fd < 0) {
+    ERROR_REPORTER_HERE(ASC_USER_ERROR,"Unable to open snapshot file '%s'",filename);
+    return 1;
+  }
+  if (fstat(fd,&st) != 0 || st.st_size < (off_t)sizeof(struct SnapHeader)) {
+    close(fd);
+    ERROR_REPORTER_HERE(ASC_USER_ERROR,"'%s' is not a snapshot file",filename);
+    return 1;
+  }
+  r->size = (uint64_t)st.st_size;
+  r->mem = mmap(NULL,(size_t)r->size,PROT_READ,MAP_PRIVATE,fd,0);
+  close(fd);
+  if (r->mem == MAP_FAILED) {
+    r->mem = NULL;
+    ERROR_REPORTER_HERE(ASC_USER_ERROR,"Unable to map snapshot file '%s'",filename);
+    return 1;
+  }
+#else
+  fp = fopen(filename,"rb");
+  if (fp == NULL) {
+    ERROR_REPORTER_HERE(ASC_USER_ERROR,"Unable to open snapshot file '%s'",filename);
+    return 1;
+  }
+  fseek(fp,0,SEEK_END);
+  len = ftell(fp);
+  fseek(fp,0,SEEK_SET);
+  if (len < (long)sizeof(struct SnapHeader)) {
+    fclose(fp);
+    ERROR_REPORTER_HERE(ASC_USER_ERROR,"'%s' is not a snapshot file",filename);
+    return 1;
+  }
+  r->size = (uint64_t)len;
+  r->mem = ascmalloc((size_t)len);
+  if (fread(r->mem,1,(size_t)len,fp) != (size_t)len) {
+    fclose(fp);
+    SnapCloseFile(r);
+    ERROR_REPORTER_HERE(ASC_USER_ERROR,"Error reading snapshot file '%s'",filename);
+    return 1;
+  }
+  fclose(fp);
+#endif
+  r->base = (CONST unsigned char *)r->mem;
+  r->h = h = (CONST struct SnapHeader *)r->base;
+
+  if (memcmp(h->magic,"ASCSNAP",8) != 0) {
+    ERROR_REPORTER_HERE(ASC_USER_ERROR,"'%s' is not a snapshot file",filename);
+    return 1;
+  }
+  if (h->order != SNAP_ORDER || h->version != SNAP_VERSION) {
+    ERROR_REPORTER_HERE(ASC_USER_ERROR,"Snapshot '%s' was written by another"
+      " version of ASCEND or on a machine of the other byte order",filename
+    );
+    return 1;
+  }
+  if (h->size != r->size || h->root == 0 || h->root > h->count[SNAP_NODE]
+      || h->name > h->count[SNAP_STR]) {
+    ERROR_REPORTER_HERE(ASC_USER_ERROR,"Snapshot '%s' is truncated or corrupt",filename);
+    return 1;
+  }
+  for (t = 0; t < SNAP_NTABLE; t++) {
+    if (h->index[t] % 8 != 0 || h->count[t] >= r->size/8
+        || h->index[t] > r->size - (h->count[t]+1)*8) {
+      ERROR_REPORTER_HERE(ASC_USER_ERROR,"Snapshot '%s' is truncated or corrupt",filename);
+      return 1;
+    }
+    index = (CONST uint64_t *)(r->base + h->index[t]);
+    end = h->index[t] + (h->count[t]+1)*8;
+    for (k = 0; k <= h->count[t]; k++) {
+      if (index[k] % 8 != 0 || index[k] < end || index[k] > r->size
+          || (t == SNAP_NODE && k > 0 && index[k] - index[k-1] < 3*8)) {
+        ERROR_REPORTER_HERE(ASC_USER_ERROR,"Snapshot '%s' is truncated or corrupt",filename);
+        return 1;
+      }
+      end = index[k];
+    }
+    r->index[t] = index;
+    r->count[t] = (unsigned long)h->count[t];
+  }
+  return 0;
+}
+
+struct Instance *ReadInstanceSnapshot(CONST char *filename, symchar *name)
+{
+  struct SnapReader r;
+  struct Instance *sim = NULL, *root;
+  unsigned long id, n;
+
+  memset(&r,0,sizeof(r));
+  if (SnapOpenFile(&r,filename)) {
+    SnapCloseFile(&r);
+    return NULL;
+  }
+  n = r.count[SNAP_NODE];
+  r.str = ASC_NEW_ARRAY_CLEAR(symchar *,r.count[SNAP_STR]+1);
+  r.dim = ASC_NEW_ARRAY_CLEAR(CONST dim_type *,r.count[SNAP_DIM]+1);
+  r.func = ASC_NEW_ARRAY_CLEAR(CONST struct Func *,r.count[SNAP_FUNC]+1);
+  r.type = ASC_NEW_ARRAY_CLEAR(struct TypeDescription *,r.count[SNAP_TYPE]+1);
+  r.share = ASC_NEW_ARRAY_CLEAR(union RelationUnion *,r.count[SNAP_SHARE]+1);
+  r.sharevars = ASC_NEW_ARRAY(long,r.count[SNAP_SHARE]+1);
+  for (id = 0; id <= r.count[SNAP_SHARE]; id++) r.sharevars[id] = -1;
+  r.inst = ASC_NEW_ARRAY_CLEAR(struct Instance *,n+1);
+  r.shared = ASC_NEW_ARRAY_CLEAR(char,n+1);
+
+  for (id = 1; id <= n && !r.bad; id++) {
+    SnapNode(&r,id,SNAP_CHECK);
+  }
+  if (!r.bad && SnapNodeKind(&r,(unsigned long)r.h->root) != MODEL_INST) {
+    r.bad = 1;
+  }
+  if (name == NULL && !r.bad) {
+    name = SnapStr(&r,(unsigned long)r.h->name);
+  }
+  if (r.bad || name == NULL) {
+    ERROR_REPORTER_HERE(ASC_USER_ERROR,"Snapshot '%s' is corrupt or doesn't"
+      " match the types in the library",filename
+    );
+  } else {
+    for (id = 1; id <= n; id++) {
+      SnapNode(&r,id,SNAP_CREATE);
+    }
+    for (id = 1; id <= n; id++) {
+      SnapNode(&r,id,SNAP_LINK);
+    }
+    ++g_compiler_counter; /* as for any new instance tree */
+    root = r.inst[r.h->root];
+    sim = CreateSimulationInstance(InstanceTypeDesc(root),name);
+    LinkToParentByPos(sim,root,1);
+  }
+
+  for (id = 1; id <= r.count[SNAP_TYPE]; id++) {
+    if (r.type[id] != NULL && GetBaseType(r.type[id]) == array_type) {
+      DeleteTypeDesc(r.type[id]);
+    }
+  }
+  ascfree(r.str);
+  ascfree((VOIDPTR)r.dim);
+  ascfree((VOIDPTR)r.func);
+  ascfree(r.type);
+  ascfree(r.share);
+  ascfree(r.sharevars);
+  ascfree(r.inst);
+  ascfree(r.shared);
+  SnapCloseFile(&r);
+  return sim;
+}
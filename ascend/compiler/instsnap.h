@@ -0,0 +1,110 @@
+/*	ASCEND modelling environment
+	Copyright (C) 2015 Carnegie Mellon University
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2, or (at your option)
+	any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*//**
+	@file
+	Instance tree snapshots: a compiled simulation saved to a binary file
+	and restored without re-running the instantiator.
+
+	Instantiating a large model (pass 2 relations, default METHODS and all)
+	can take much longer than solving it, which dominates when the same
+	model is run many times with different inputs. A snapshot holds the
+	whole instance DAG as it stands: the values of all atoms and their
+	fundamental children, the parent/child links, ARE_ALIKE cliques, the
+	token arrays of relations (each shared token array once) and the var
+	lists of relations. Types are referred to by name, so the library that
+	defined them (though not the instances) must be loaded again before a
+	snapshot is read; array types are rebuilt from their index strings.
+
+	The file is a set of tables, each an index of file offsets followed by
+	the entries it indexes:
+	<pre>
+	header   "ASCSNAP" 0, u64 byte order mark, u64 version, u64 file size,
+	         u64 root node id, u64 simulation name string id, the u64
+	         number of entries in each of the 6 tables (strings, dims,
+	         funcs, types, shares, nodes), then the u64 file offset of
+	         each table
+	table    u64 file offset of each entry and then of the end of the
+	         last one, followed by the entries, which are:
+	strings  u64 length, the characters and a 0, padded to 8 bytes
+	dims     u64 wild flag, then numerator and denominator of each dimension
+	funcs    string id of the function name
+	types    u64 0, string id of the type name; or for an array type
+	         u64 1, module name string id, base type id, the 4 base flags
+	         (int set, relation, logrel, when), number of indices, then
+	         for each index the string id of its set and an int flag; or
+	         u64 2 for the relation type, u64 3 for the dummy type
+	shares   u64 relop, lhs length, rhs length, position of lhs and rhs infix
+	         roots, then 4 words for each term of lhs and then rhs
+	nodes    u64 kind (enum inst_t), type id, id of the next clique member
+	         in the snapshot, then a payload depending on kind
+	</pre>
+	All words are 8 bytes in the byte order of the machine that wrote the
+	file; the byte order mark lets the reader refuse a file from a machine
+	of the other kind. Ids are 1-based positions in their table, with 0 for
+	none, and every entry starts on an 8 byte boundary, so the file can be
+	memory-mapped and read in place. Nothing in it is an address.
+
+	ReadInstanceSnapshot maps the file and makes the instances in two
+	sweeps of the node table, as CopyInstance does: first each node,
+	then the links between them. Strings, dims and relation shares are
+	converted on first use only and remembered by id. The instances
+	themselves are ordinary heap instances, not pointers into the mapping,
+	so the result is a simulation like any other and the file is unmapped
+	again before returning.
+
+	Only what the instantiator makes of models without logic is covered:
+	WHENs, logical relations and external (black box or glass box)
+	relations are refused when writing, as are simulations with pending
+	instances or run-time LINKs.
+*/
+
+#ifndef ASC_INSTSNAP_H
+#define ASC_INSTSNAP_H
+
+/**	@addtogroup compiler_inst Compiler Instance Hierarchy
+	@{
+*/
+
+#include <ascend/general/platform.h>
+#include "instance_enum.h"
+#include "compiler.h"
+
+ASC_DLLSPEC int WriteInstanceSnapshot(struct Instance *sim, CONST char *filename);
+/**<
+	Write a snapshot of the simulation sim to filename, overwriting any
+	file of that name.
+
+	@return 0 on success, 1 if the simulation contains instances that
+	can't be saved (reported as errors) or the file couldn't be written.
+*/
+
+ASC_DLLSPEC struct Instance *ReadInstanceSnapshot(CONST char *filename, symchar *name);
+/**<
+	Read back a snapshot written by WriteInstanceSnapshot, as a new
+	simulation instance. The types named in the snapshot must all be in the
+	library, with the same children as when it was written. UNIVERSAL
+	atoms and constants that already exist are shared rather than made
+	again, as Instantiate would.
+
+	@param name  name of the new simulation, or NULL for the name it was
+	             saved with.
+	@return the simulation, to be destroyed with sim_destroy(), or NULL on
+	failure (reported as an error).
+*/
+
+/* @} */
+
+#endif /* ASC_INSTSNAP_H */
@@ -219,7 +219,7 @@ LogTermSatisfied(CONST struct logrelation *lrel,
 
   switch (InstanceKind(inst)) {
   case REL_INST:
-    status = RelationCalcResidualPostfixSafe(inst,&res);
+    status = RelationCalcResidualPostfixSafe(inst,&res,NULL);
     if (status != safe_ok) {
       FPRINTF(ASCERR,
         "Something wrong while calculating a residual in Sat Expr\n");
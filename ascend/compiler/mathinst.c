@@ -362,12 +362,41 @@ struct Instance *RelationsForAtom(CONST struct Instance *i,
   exit(2);/* NOT REACHED.  Needed to keep gcc from whining */
 }
 
+/*
+ * While relations are made on other threads, their links from the
+ * variables go here instead, as pairs (var,rel), to be made on the
+ * main thread once it is safe to change the variables.
+ */
+static ASC_THREAD_LOCAL struct gl_list_t *g_deferred_links = NULL;
+
+struct gl_list_t *DeferRelationLinks(struct gl_list_t *links){
+  struct gl_list_t *old = g_deferred_links;
+  g_deferred_links = links;
+  return old;
+}
+
+void ApplyRelationLinks(struct gl_list_t *links){
+  unsigned long c,len;
+  len = gl_length(links);
+  for (c=1; c < len; c+=2) {
+    AddRelation((struct Instance *)gl_fetch(links,c),
+                (struct Instance *)gl_fetch(links,c+1));
+  }
+  gl_reset(links);
+}
+
 void AddRelation(struct Instance *i, struct Instance *reln){
   //unsigned long len;
   assert(i);
   assert(reln);
   assert(reln->t==REL_INST);
   AssertMemory(i);
+  if (g_deferred_links!=NULL) {
+    /* repeats are dropped when the links are applied */
+    gl_append_ptr(g_deferred_links,(VOIDPTR)i);
+    gl_append_ptr(g_deferred_links,(VOIDPTR)reln);
+    return;
+  }
   switch(i->t){
   case REAL_ATOM_INST:
 	/* CONSOLE_DEBUG("ADD RelationInstance %p to RealAtomInstance %p",reln,i); */
@@ -389,6 +418,18 @@ void RemoveRelation(struct Instance *i, struct Instance *reln){
 	//CONSOLE_DEBUG("Var %p: remove reference to rel %p",i,reln);
 	assert(i&&reln&&(reln->t==REL_INST));
 	AssertMemory(i);
+	if(g_deferred_links!=NULL){
+		/* reln is the one being made, so its links are the last ones */
+		c = gl_length(g_deferred_links);
+		while(c>1 && gl_fetch(g_deferred_links,c)==(VOIDPTR)reln){
+			if(gl_fetch(g_deferred_links,c-1)==(VOIDPTR)i){
+				gl_delete(g_deferred_links,c,0);
+				gl_delete(g_deferred_links,c-1,0);
+			}
+			c -= 2;
+		}
+		return;
+	}
 	switch(i->t){
 	case REAL_ATOM_INST:
 		//CONSOLE_DEBUG("It is a real atom");
@@ -183,6 +183,22 @@ extern void RemoveRelation(struct Instance *i, struct Instance *reln);
 	found in i's relation list, execution continues with a warning message.
 */
 
+extern struct gl_list_t *DeferRelationLinks(struct gl_list_t *links);
+/**<
+	While links is not NULL, AddRelation and RemoveRelation on this thread
+	do not change the variables, but record the links to be made in links
+	instead, for ApplyRelationLinks to make later, on whichever thread may
+	change the variables. RemoveRelation may then only be used on the
+	relation made last, as when its construction fails. Pass NULL to stop.
+	@return the list previously in use.
+*/
+
+extern void ApplyRelationLinks(struct gl_list_t *links);
+/**<
+	Make the links recorded in links, as AddRelation would have made them
+	when they were recorded, and empty the list.
+*/
+
 ASC_DLLSPEC unsigned long LogRelationsCount(CONST struct Instance *i);
 /**< 
 	This will return the number of logical relations that instance "i"
@@ -72,6 +72,8 @@
 #include <ascend/general/pool.h>
 #include "tmpnum.h"
 #include "setinstval.h"
+#include "valstore.h"
+#include "instantiate.h"
 #include "mergeinst.h"
 
 //#define MERGE_DEBUG
@@ -572,6 +574,8 @@ struct Instance *MergeConstants(struct Instance *i1, struct Instance *i2)
 			   InstanceTypeDesc(i2),
 			   INST(i1),INST(i2))){
   case 1:			/* keep instance 1 */
+    ValueStoreFlush(i1); /* values in slots are looked at directly */
+    ValueStoreFlush(i2);
     if (MergeValues(i1,i2)) return NULL; /* check instance values */
     /* no interface pointers, no children */
     MergeParents(i1,i2);
@@ -587,6 +591,8 @@ struct Instance *MergeConstants(struct Instance *i1, struct Instance *i2)
     DestroyInstance(i2,NULL);
     return i1;
   case 2:			/* keep instance 2 */
+    ValueStoreFlush(i1); /* values in slots are looked at directly */
+    ValueStoreFlush(i2);
     if (MergeValues(i2,i1)) return NULL; /* check instance values */
     MergeParents(i2,i1);
     MergeCliques(i2,i1);
@@ -618,6 +624,8 @@ struct Instance *MergeAtoms(struct Instance *i1, struct Instance *i2)
 			   InstanceTypeDesc(i2),
 			   INST(i1),INST(i2))){
   case 1:			/* keep instance 1 */
+    ValueStoreFlush(i1); /* values in slots are looked at directly */
+    ValueStoreFlush(i2);
     if (MergeValues(i1,i2)) return NULL; /* check instance values */
     if (InterfacePtrATS!=NULL) {
       (*InterfacePtrATS)(i1,i2);
@@ -628,6 +636,7 @@ struct Instance *MergeAtoms(struct Instance *i1, struct Instance *i2)
     switch (i2->t) {
     case REAL_ATOM_INST:
       FixRelations(RA_INST(i2),RA_INST(i1));
+      ValueStoreMove(i2,i1);
       break;
     case BOOLEAN_ATOM_INST:
       FixLogRelations(i2,i1);
@@ -647,6 +656,8 @@ struct Instance *MergeAtoms(struct Instance *i1, struct Instance *i2)
     DestroyInstance(i2,NULL);
     return i1;
   case 2:			/* keep instance 2 */
+    ValueStoreFlush(i1); /* values in slots are looked at directly */
+    ValueStoreFlush(i2);
     if (MergeValues(i2,i1)) return NULL; /* check instance values */
     if (InterfacePtrATS!=NULL) {
       (*InterfacePtrATS)(i2,i1);
@@ -657,6 +668,7 @@ struct Instance *MergeAtoms(struct Instance *i1, struct Instance *i2)
     switch (i1->t) {
     case REAL_ATOM_INST:
       FixRelations(RA_INST(i1),RA_INST(i2));
+      ValueStoreMove(i1,i2);
       break;
     case BOOLEAN_ATOM_INST:
       FixLogRelations(i1,i2);
@@ -1172,6 +1184,7 @@ struct Instance *MergeInstances(struct Instance *i1, struct Instance *i2){
       }
     }
     if(MoreRefined(InstanceTypeDesc(i1),InstanceTypeDesc(i2))!=NULL) {
+      ++g_compiler_counter; /* instance tree will change */
       return RecursiveMergeInstance(i1,i2);
     }else{
       BadMerge(ASCERR,"Attempt to merge unconformable types.\n",
@@ -75,6 +75,7 @@
 #include "mergeinst.h"
 #include "parentchild.h"
 #include "instantiate.h"
+#include "valstore.h"
 #include "refineinst.h"
 
 /* checks children, and does some value copying in the process */
@@ -227,6 +228,8 @@ static struct Instance *RefineRealConstant(struct RealConstantInstance *i,
     }
     /* else don't need to change universal table, cause we didn't move */
     /* no move, so no parent update either */
+    DeleteTypeDesc(i->desc);
+    CopyTypeDesc(type);
     i->desc = type; /* finally somebody make the refinement */
   }
   return INST(i); /* always returns i */
@@ -269,6 +272,7 @@ static struct Instance *RefineRealAtom(struct RealAtomInstance *i,
  */  /* NOT REACHED */
 /*}
  */
+  ValueStoreFlush(INST(i)); /* the value may be in a slot */
   new = RA_INST(CreateRealInstance(type));
   /* check value */
   if (i->assigned > new->assigned){ /* old value is been assigned */
@@ -308,6 +312,7 @@ static struct Instance *RefineRealAtom(struct RealAtomInstance *i,
     CheckAtomValuesTwo(INST(i),INST(new));
   }
   ReDirectParents(INST(i),INST(new));
+  ValueStoreMove(INST(i),INST(new));
   /* fix universal stuff */
   if (GetUniversalFlag(i->desc)) {
     ChangeUniversalInstance(GetUniversalTable(),INST(i),INST(new));
@@ -347,6 +352,8 @@ RefineBooleanConstant(struct BooleanConstantInstance *i,
   }
   /* else don't need to change universal table, cause we didn't move */
   /* no move, so no parent update either */
+  DeleteTypeDesc(i->desc);
+  CopyTypeDesc(type);
   i->desc = type; /* finally somebody make the refinement */
   return INST(i);
 }
@@ -426,6 +433,8 @@ static struct Instance
   }
   /* else don't need to change universal table, cause we didn't move */
   /* no move, so no parent update either */
+  DeleteTypeDesc(i->desc);
+  CopyTypeDesc(type);
   i->desc = type; /* finally somebody make the refinement */
   return INST(i);
 }
@@ -541,6 +550,8 @@ static struct Instance *RefineSymbolConstant(struct SymbolConstantInstance *i,
     /* don't have to check universal table cause that was already up top */
     AddUniversalInstance(GetUniversalTable(),type,INST(i));
   }
+  DeleteTypeDesc(i->desc);
+  CopyTypeDesc(type);
   i->desc = type;
   return INST(i);
 }
@@ -761,6 +772,7 @@ struct Instance *RefineClique(struct Instance *i,
   if (arginst != NULL) {
     assert(MoreRefined(InstanceTypeDesc(arginst),type)==type);
   }
+  ++g_compiler_counter; /* instance tree will change */
   ptr = i = RefineInstance(i,type,arginst);
   while ( (ptr = NextCliqueMember(ptr))  !=  i){
     assert(ptr!=NULL);
@@ -0,0 +1,714 @@
+/*	ASCEND modelling environment
+	Copyright (C) 2015 Carnegie Mellon University
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2, or (at your option)
+	any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*//**
+	@file
+	Register bytecode compiler and evaluator for token relations.
+	@see rel_opcode.h
+*/
+
+#include <math.h>
+
+#include "rel_opcode.h"
+
+#include <ascend/general/ascMalloc.h>
+#include <ascend/general/panic.h>
+#include <ascend/general/mathmacros.h>
+
+#include "func.h"
+#include "instance_enum.h"
+#include "vlist.h"
+#include "find.h"
+#include "rel_blackbox.h"
+#include "relation.h"
+#include "relation_util.h"
+
+/* #define OPCODE_DEBUG */
+
+int g_relation_opcodes = 1;
+
+/**
+	Marker stored in a share whose token arrays could not be compiled,
+	so that we don't try again on every evaluation.
+*/
+static struct RelOpCodes g_opcodes_failed;
+#define OPCODES_FAILED (&g_opcodes_failed)
+
+/*------------------------------------------------------------------------------
+  COMPILER
+*/
+
+/* kinds of pending operands on the compile-time stack */
+enum ropnd_kind {
+	RK_REG,   /* value already in a register */
+	RK_VAR,   /* a variable, not yet loaded */
+	RK_CONST  /* a constant, not yet loaded */
+};
+
+struct ropnd {
+	enum ropnd_kind kind;
+	int idx;     /* register or (0-based) variable index */
+	double val;  /* value of constant */
+};
+
+struct ropbuild {
+	struct RelOpInstr *code;
+	int ninstr;
+	double *constants;
+	int nconst;
+	CONST struct Func **funcs;
+	int nfunc;
+	unsigned long nvars;
+	struct ropnd *stack;
+	long sp; /* top of stack, -1 when empty */
+};
+
+static int rop_emit(struct ropbuild *b, int op, int a, int bb){
+	b->code[b->ninstr].op = op;
+	b->code[b->ninstr].a = a;
+	b->code[b->ninstr].b = bb;
+	return b->ninstr++;
+}
+
+static int rop_addconst(struct ropbuild *b, double val){
+	b->constants[b->nconst] = val;
+	return b->nconst++;
+}
+
+static int rop_addfunc(struct ropbuild *b, CONST struct Func *f){
+	int i;
+	for(i = 0; i < b->nfunc; ++i){
+		if(b->funcs[i] == f)return i;
+	}
+	b->funcs[b->nfunc] = f;
+	return b->nfunc++;
+}
+
+/** make sure operand is in a register, emitting a load if need be */
+static int rop_reg(struct ropbuild *b, CONST struct ropnd *o){
+	switch(o->kind){
+	case RK_VAR:
+		return rop_emit(b, ROP_VAR, o->idx, 0);
+	case RK_CONST:
+		return rop_emit(b, ROP_CONST, rop_addconst(b, o->val), 0);
+	default:
+		return o->idx;
+	}
+}
+
+static void rop_push_reg(struct ropbuild *b, int reg){
+	b->sp++;
+	b->stack[b->sp].kind = RK_REG;
+	b->stack[b->sp].idx = reg;
+	b->stack[b->sp].val = 0.0;
+}
+
+static void rop_push_const(struct ropbuild *b, double val){
+	b->sp++;
+	b->stack[b->sp].kind = RK_CONST;
+	b->stack[b->sp].idx = -1;
+	b->stack[b->sp].val = val;
+}
+
+/**
+	Combine the top two stack operands with binary operator 'type',
+	choosing the instruction variant that absorbs a variable or constant
+	operand and folding constant subexpressions.
+*/
+static void rop_binary(struct ropbuild *b, enum Expr_enum type){
+	struct ropnd L, R;
+	int ra;
+	R = b->stack[b->sp--];
+	L = b->stack[b->sp--];
+
+	if(L.kind == RK_CONST && R.kind == RK_CONST){
+		double v;
+		switch(type){
+		case e_plus:   v = L.val + R.val; break;
+		case e_minus:  v = L.val - R.val; break;
+		case e_times:  v = L.val * R.val; break;
+		case e_divide: v = L.val / R.val; break;
+		case e_power:  v = pow(L.val, R.val); break;
+		default:       v = asc_ipow(L.val, (int)R.val); break;
+		}
+		rop_push_const(b, v);
+		return;
+	}
+
+	switch(type){
+	case e_plus:
+	case e_times:
+		/* commutative: put any unloaded operand on the right */
+		if(R.kind == RK_REG && L.kind != RK_REG){
+			struct ropnd t = L; L = R; R = t;
+		}
+		ra = rop_reg(b, &L);
+		if(R.kind == RK_VAR){
+			rop_push_reg(b, rop_emit(b, type==e_plus ? ROP_ADDV : ROP_MULV, ra, R.idx));
+		}else if(R.kind == RK_CONST){
+			rop_push_reg(b, rop_emit(b, type==e_plus ? ROP_ADDC : ROP_MULC, ra, rop_addconst(b, R.val)));
+		}else{
+			rop_push_reg(b, rop_emit(b, type==e_plus ? ROP_ADD : ROP_MUL, ra, R.idx));
+		}
+		return;
+	case e_minus:
+	case e_divide:
+		if(L.kind == RK_CONST && R.kind == RK_REG){
+			rop_push_reg(b, rop_emit(b, type==e_minus ? ROP_RSUBC : ROP_RDIVC, R.idx, rop_addconst(b, L.val)));
+			return;
+		}
+		ra = rop_reg(b, &L);
+		if(R.kind == RK_VAR){
+			rop_push_reg(b, rop_emit(b, type==e_minus ? ROP_SUBV : ROP_DIVV, ra, R.idx));
+		}else if(R.kind == RK_CONST){
+			rop_push_reg(b, rop_emit(b, type==e_minus ? ROP_SUBC : ROP_DIVC, ra, rop_addconst(b, R.val)));
+		}else{
+			rop_push_reg(b, rop_emit(b, type==e_minus ? ROP_SUB : ROP_DIV, ra, R.idx));
+		}
+		return;
+	case e_power:
+		ra = rop_reg(b, &L);
+		if(R.kind == RK_CONST){
+			rop_push_reg(b, rop_emit(b, ROP_POWC, ra, rop_addconst(b, R.val)));
+		}else{
+			rop_push_reg(b, rop_emit(b, ROP_POW, ra, rop_reg(b, &R)));
+		}
+		return;
+	default: /* e_ipower */
+		ra = rop_reg(b, &L);
+		if(R.kind == RK_CONST){
+			rop_push_reg(b, rop_emit(b, ROP_IPOWI, ra, (int)R.val));
+		}else{
+			rop_push_reg(b, rop_emit(b, ROP_IPOW, ra, rop_reg(b, &R)));
+		}
+		return;
+	}
+}
+
+/**
+	Compile one postfix side onto the compile stack.
+	@return 0 on success, 1 if an unknown term was found.
+*/
+static int rop_side(struct ropbuild *b, CONST union RelationTermUnion *side
+		, unsigned long len
+){
+	CONST struct relation_term *term;
+	unsigned long t, varnum;
+	struct ropnd *top;
+
+	for(t = 0; t < len; t++){
+		term = A_TERM(&(side[t]));
+		switch(RelationTermType(term)){
+		case e_zero:
+			rop_push_const(b, 0.0);
+			break;
+		case e_real:
+			rop_push_const(b, TermReal(term));
+			break;
+		case e_int:
+			rop_push_const(b, (double)TermInteger(term));
+			break;
+		case e_var:
+			varnum = TermVarNumber(term);
+			if(varnum > b->nvars)b->nvars = varnum;
+			b->sp++;
+			b->stack[b->sp].kind = RK_VAR;
+			b->stack[b->sp].idx = (int)varnum - 1;
+			b->stack[b->sp].val = 0.0;
+			break;
+		case e_plus:
+		case e_minus:
+		case e_times:
+		case e_divide:
+		case e_power:
+		case e_ipower:
+			if(b->sp < 1)return 1;
+			rop_binary(b, RelationTermType(term));
+			break;
+		case e_uminus:
+			if(b->sp < 0)return 1;
+			top = &(b->stack[b->sp]);
+			if(top->kind == RK_CONST){
+				top->val = -top->val;
+			}else{
+				b->stack[b->sp].idx = rop_emit(b, ROP_NEG, rop_reg(b, top), 0);
+				b->stack[b->sp].kind = RK_REG;
+			}
+			break;
+		case e_func:
+			if(b->sp < 0)return 1;
+			top = &(b->stack[b->sp]);
+			if(top->kind == RK_CONST){
+				top->val = FuncEval(TermFunc(term), top->val);
+			}else{
+				b->stack[b->sp].idx = rop_emit(b, ROP_FUNC, rop_reg(b, top)
+					, rop_addfunc(b, TermFunc(term))
+				);
+				b->stack[b->sp].kind = RK_REG;
+			}
+			break;
+		default:
+#ifdef OPCODE_DEBUG
+			CONSOLE_DEBUG("Unsupported term type %d",(int)RelationTermType(term));
+#endif
+			return 1;
+		}
+	}
+	return 0;
+}
+
+struct RelOpCodes *RelOpCodesCompile(CONST struct relation *r){
+	struct ropbuild b;
+	struct RelOpCodes *p;
+	unsigned long lhs_len, rhs_len, maxlen;
+	int nsides, err = 0;
+
+	if(r == NULL || r->share == NULL)return NULL;
+	lhs_len = RTOKEN(r).lhs_len;
+	rhs_len = RTOKEN(r).rhs_len;
+
+	/*
+		Each token emits at most two instructions (a load of its left
+		operand and the operation itself) plus one constant, and the final
+		lhs - rhs needs at most three more of each.
+	*/
+	maxlen = 2*(lhs_len + rhs_len) + 3;
+	b.code = ASC_NEW_ARRAY(struct RelOpInstr, maxlen);
+	b.constants = ASC_NEW_ARRAY(double, maxlen);
+	b.funcs = ASC_NEW_ARRAY(CONST struct Func *, lhs_len + rhs_len + 1);
+	b.stack = ASC_NEW_ARRAY(struct ropnd, lhs_len + rhs_len + 2);
+	b.ninstr = b.nconst = b.nfunc = 0;
+	b.nvars = 0;
+	b.sp = -1;
+
+	nsides = 0;
+	if(lhs_len > 0){
+		err = rop_side(&b, RTOKEN(r).lhs, lhs_len);
+		if(!err && b.sp != 0)err = 1;
+		nsides++;
+	}
+	if(!err && rhs_len > 0){
+		err = rop_side(&b, RTOKEN(r).rhs, rhs_len);
+		if(!err && b.sp != nsides)err = 1;
+		nsides++;
+	}
+
+	if(!err){
+		if(nsides == 2){
+			rop_binary(&b, e_minus);
+		}else if(nsides == 1 && rhs_len > 0){
+			/* rhs only: residual is -rhs */
+			if(b.stack[0].kind == RK_CONST){
+				b.stack[0].val = -b.stack[0].val;
+			}else{
+				rop_push_reg(&b, rop_emit(&b, ROP_NEG, rop_reg(&b, &(b.stack[b.sp--])), 0));
+			}
+		}else if(nsides == 0){
+			rop_push_const(&b, 0.0);
+		}
+		/* the residual must end up in the last register */
+		if(b.stack[0].kind != RK_REG || b.stack[0].idx != b.ninstr - 1){
+			b.stack[0].idx = rop_reg(&b, &(b.stack[0]));
+			b.stack[0].kind = RK_REG;
+		}
+		if(b.stack[0].idx != b.ninstr - 1){
+			/* only possible for an lhs-only relation that is one register;
+			   copy it forward as x + 0. */
+			rop_emit(&b, ROP_ADDC, b.stack[0].idx, rop_addconst(&b, 0.0));
+		}
+		asc_assert(b.ninstr <= (int)maxlen);
+	}
+
+	ASC_FREE(b.stack);
+	if(err){
+		ASC_FREE(b.code);
+		ASC_FREE(b.constants);
+		ASC_FREE(b.funcs);
+		return NULL;
+	}
+
+	p = ASC_NEW(struct RelOpCodes);
+	p->ninstr = b.ninstr;
+	p->nconst = b.nconst;
+	p->nfunc = b.nfunc;
+	p->nvars = b.nvars;
+	p->code = (struct RelOpInstr *)ascrealloc(b.code, b.ninstr*sizeof(struct RelOpInstr));
+	if(b.nconst){
+		p->constants = (double *)ascrealloc(b.constants, b.nconst*sizeof(double));
+	}else{
+		ASC_FREE(b.constants);
+		p->constants = NULL;
+	}
+	if(b.nfunc){
+		p->funcs = (CONST struct Func **)ascrealloc((void *)b.funcs, b.nfunc*sizeof(CONST struct Func *));
+	}else{
+		ASC_FREE(b.funcs);
+		p->funcs = NULL;
+	}
+#ifdef OPCODE_DEBUG
+	CONSOLE_DEBUG("Compiled %lu tokens to %d opcodes, %d constants"
+		,lhs_len + rhs_len, p->ninstr, p->nconst
+	);
+#endif
+	return p;
+}
+
+void RelOpCodesDestroy(struct RelOpCodes *p){
+	if(p == NULL || p == OPCODES_FAILED)return;
+	ASC_FREE(p->code);
+	if(p->constants != NULL)ASC_FREE(p->constants);
+	if(p->funcs != NULL)ASC_FREE((void *)p->funcs);
+	ASC_FREE(p);
+}
+
+CONST struct RelOpCodes *RelationOpCodes(CONST struct relation *r){
+	struct RelOpCodes *p;
+	asc_assert(r != NULL && r->share != NULL);
+	p = RTOKEN(r).opcodes;
+	if(p == NULL){
+		p = RelOpCodesCompile(r);
+		if(p == NULL){
+			p = OPCODES_FAILED;
+		}
+		RTOKEN(r).opcodes = p;
+	}
+	if(p == OPCODES_FAILED)return NULL;
+	return p;
+}
+
+void RelationClearOpCodes(struct relation *r){
+	if(r == NULL || r->share == NULL)return;
+	RelOpCodesDestroy(RTOKEN(r).opcodes);
+	RTOKEN(r).opcodes = NULL;
+}
+
+/*------------------------------------------------------------------------------
+  EVALUATOR
+*/
+
+/** forward sweep; fills the register file r */
+static void rop_forward(CONST struct RelOpCodes *p, CONST double *x, double *r){
+	CONST struct RelOpInstr *i = p->code;
+	CONST double *c = p->constants;
+	int k;
+	for(k = 0; k < p->ninstr; k++, i++){
+		switch(i->op){
+		case ROP_VAR:   r[k] = x[i->a]; break;
+		case ROP_CONST: r[k] = c[i->a]; break;
+		case ROP_ADD:   r[k] = r[i->a] + r[i->b]; break;
+		case ROP_SUB:   r[k] = r[i->a] - r[i->b]; break;
+		case ROP_MUL:   r[k] = r[i->a] * r[i->b]; break;
+		case ROP_DIV:   r[k] = r[i->a] / r[i->b]; break;
+		case ROP_ADDV:  r[k] = r[i->a] + x[i->b]; break;
+		case ROP_SUBV:  r[k] = r[i->a] - x[i->b]; break;
+		case ROP_MULV:  r[k] = r[i->a] * x[i->b]; break;
+		case ROP_DIVV:  r[k] = r[i->a] / x[i->b]; break;
+		case ROP_ADDC:  r[k] = r[i->a] + c[i->b]; break;
+		case ROP_SUBC:  r[k] = r[i->a] - c[i->b]; break;
+		case ROP_MULC:  r[k] = r[i->a] * c[i->b]; break;
+		case ROP_DIVC:  r[k] = r[i->a] / c[i->b]; break;
+		case ROP_RSUBC: r[k] = c[i->b] - r[i->a]; break;
+		case ROP_RDIVC: r[k] = c[i->b] / r[i->a]; break;
+		case ROP_POW:   r[k] = pow(r[i->a], r[i->b]); break;
+		case ROP_POWC:  r[k] = pow(r[i->a], c[i->b]); break;
+		case ROP_IPOW:  r[k] = asc_ipow(r[i->a], (int)r[i->b]); break;
+		case ROP_IPOWI: r[k] = asc_ipow(r[i->a], i->b); break;
+		case ROP_NEG:   r[k] = -r[i->a]; break;
+		case ROP_FUNC:  r[k] = FuncEval(p->funcs[i->b], r[i->a]); break;
+		default:
+			ASC_PANIC("Invalid opcode %d", i->op);
+		}
+	}
+}
+
+int RelOpCodesResidual(CONST struct RelOpCodes *p
+		, CONST double *x, double *r, double *res
+){
+	asc_assert(p != NULL && p != OPCODES_FAILED);
+	rop_forward(p, x, r);
+	*res = r[p->ninstr - 1];
+	return !asc_finite(*res);
+}
+
+int RelOpCodesResidGrad(CONST struct RelOpCodes *p
+		, CONST double *x, double *r
+		, double *res, double *grad, unsigned long nvars
+){
+	CONST struct RelOpInstr *i;
+	CONST double *c = p->constants;
+	double *adj, w;
+	unsigned long v;
+	int k;
+
+	asc_assert(p != NULL && p != OPCODES_FAILED);
+	asc_assert(nvars >= p->nvars);
+
+	rop_forward(p, x, r);
+	*res = r[p->ninstr - 1];
+
+	adj = r + p->ninstr;
+	for(k = 0; k < p->ninstr; k++)adj[k] = 0.0;
+	for(v = 0; v < nvars; v++)grad[v] = 0.0;
+	adj[p->ninstr - 1] = 1.0;
+
+	for(k = p->ninstr - 1; k >= 0; k--){
+		i = &(p->code[k]);
+		w = adj[k];
+		switch(i->op){
+		case ROP_VAR:   grad[i->a] += w; break;
+		case ROP_CONST: break;
+		case ROP_ADD:   adj[i->a] += w; adj[i->b] += w; break;
+		case ROP_SUB:   adj[i->a] += w; adj[i->b] -= w; break;
+		case ROP_MUL:
+			adj[i->a] += w * r[i->b];
+			adj[i->b] += w * r[i->a];
+			break;
+		case ROP_DIV:
+			/* d(u/v) = du/v - (u/v)*dv/v */
+			adj[i->a] += w / r[i->b];
+			adj[i->b] -= w * r[k] / r[i->b];
+			break;
+		case ROP_ADDV:  adj[i->a] += w; grad[i->b] += w; break;
+		case ROP_SUBV:  adj[i->a] += w; grad[i->b] -= w; break;
+		case ROP_MULV:
+			adj[i->a] += w * x[i->b];
+			grad[i->b] += w * r[i->a];
+			break;
+		case ROP_DIVV:
+			adj[i->a] += w / x[i->b];
+			grad[i->b] -= w * r[k] / x[i->b];
+			break;
+		case ROP_ADDC:
+		case ROP_SUBC:  adj[i->a] += w; break;
+		case ROP_MULC:  adj[i->a] += w * c[i->b]; break;
+		case ROP_DIVC:  adj[i->a] += w / c[i->b]; break;
+		case ROP_RSUBC: adj[i->a] -= w; break;
+		case ROP_RDIVC: adj[i->a] -= w * r[k] / r[i->a]; break;
+		case ROP_POW:
+			/* d(u^v) = v * u^(v-1) * du + ln(u) * u^v * dv */
+			adj[i->a] += w * r[i->b] * pow(r[i->a], r[i->b] - 1.0);
+			adj[i->b] += w * log(r[i->a]) * r[k];
+			break;
+		case ROP_POWC:
+			adj[i->a] += w * c[i->b] * pow(r[i->a], c[i->b] - 1.0);
+			break;
+		case ROP_IPOW:
+			adj[i->a] += w * asc_d1ipow(r[i->a], (int)r[i->b]);
+			adj[i->b] += w * log(r[i->a]) * r[k];
+			break;
+		case ROP_IPOWI:
+			adj[i->a] += w * asc_d1ipow(r[i->a], i->b);
+			break;
+		case ROP_NEG:   adj[i->a] -= w; break;
+		case ROP_FUNC:
+			adj[i->a] += w * FuncDeriv(p->funcs[i->b], r[i->a]);
+			break;
+		default:
+			ASC_PANIC("Invalid opcode %d", i->op);
+		}
+	}
+
+	if(!asc_finite(*res))return 1;
+	for(v = 0; v < nvars; v++){
+		if(!asc_finite(grad[v]))return 1;
+	}
+	return 0;
+}
+
+/*------------------------------------------------------------------------------
+  LANE EVALUATOR
+
+  The same program run over RELOP_LANES relations of one share at a time.
+  Every register holds one value per lane, and each instruction is decoded
+  once for all the lanes; the fixed-length inner loops are written so that
+  the compiler can turn them into vector instructions. Function terms and
+  pow are called lane by lane.
+*/
+
+#define L RELOP_LANES
+#define LANES for(l = 0; l < L; l++)
+
+static void rop_forward_n(CONST struct RelOpCodes *p, CONST double *x, double *r){
+	CONST struct RelOpInstr *i = p->code;
+	CONST double *c = p->constants;
+	double *rk, cv;
+	CONST double *ra, *rb, *xb;
+	int k, l;
+	for(k = 0; k < p->ninstr; k++, i++){
+		rk = r + k*L;
+		ra = r + i->a*L;
+		switch(i->op){
+		case ROP_VAR:   xb = x + i->a*L; LANES rk[l] = xb[l]; break;
+		case ROP_CONST: cv = c[i->a]; LANES rk[l] = cv; break;
+		case ROP_ADD:   rb = r + i->b*L; LANES rk[l] = ra[l] + rb[l]; break;
+		case ROP_SUB:   rb = r + i->b*L; LANES rk[l] = ra[l] - rb[l]; break;
+		case ROP_MUL:   rb = r + i->b*L; LANES rk[l] = ra[l] * rb[l]; break;
+		case ROP_DIV:   rb = r + i->b*L; LANES rk[l] = ra[l] / rb[l]; break;
+		case ROP_ADDV:  xb = x + i->b*L; LANES rk[l] = ra[l] + xb[l]; break;
+		case ROP_SUBV:  xb = x + i->b*L; LANES rk[l] = ra[l] - xb[l]; break;
+		case ROP_MULV:  xb = x + i->b*L; LANES rk[l] = ra[l] * xb[l]; break;
+		case ROP_DIVV:  xb = x + i->b*L; LANES rk[l] = ra[l] / xb[l]; break;
+		case ROP_ADDC:  cv = c[i->b]; LANES rk[l] = ra[l] + cv; break;
+		case ROP_SUBC:  cv = c[i->b]; LANES rk[l] = ra[l] - cv; break;
+		case ROP_MULC:  cv = c[i->b]; LANES rk[l] = ra[l] * cv; break;
+		case ROP_DIVC:  cv = c[i->b]; LANES rk[l] = ra[l] / cv; break;
+		case ROP_RSUBC: cv = c[i->b]; LANES rk[l] = cv - ra[l]; break;
+		case ROP_RDIVC: cv = c[i->b]; LANES rk[l] = cv / ra[l]; break;
+		case ROP_POW:   rb = r + i->b*L; LANES rk[l] = pow(ra[l], rb[l]); break;
+		case ROP_POWC:  cv = c[i->b]; LANES rk[l] = pow(ra[l], cv); break;
+		case ROP_IPOW:  rb = r + i->b*L; LANES rk[l] = asc_ipow(ra[l], (int)rb[l]); break;
+		case ROP_IPOWI: LANES rk[l] = asc_ipow(ra[l], i->b); break;
+		case ROP_NEG:   LANES rk[l] = -ra[l]; break;
+		case ROP_FUNC:  LANES rk[l] = FuncEval(p->funcs[i->b], ra[l]); break;
+		default:
+			ASC_PANIC("Invalid opcode %d", i->op);
+		}
+	}
+}
+
+int RelOpCodesResidualN(CONST struct RelOpCodes *p
+		, CONST double *x, double *r, double *res
+){
+	CONST double *rlast;
+	int l, bad = 0;
+	asc_assert(p != NULL && p != OPCODES_FAILED);
+	rop_forward_n(p, x, r);
+	rlast = r + (p->ninstr - 1)*L;
+	LANES{
+		res[l] = rlast[l];
+		if(!asc_finite(res[l]))bad |= (1 << l);
+	}
+	return bad;
+}
+
+int RelOpCodesResidGradN(CONST struct RelOpCodes *p
+		, CONST double *x, double *r
+		, double *res, double *grad, unsigned long nvars
+){
+	CONST struct RelOpInstr *i;
+	CONST double *c = p->constants;
+	double *adj, *wk, *aa, *ab, *ga;
+	CONST double *ra, *rb, *rk, *xb;
+	double cv;
+	unsigned long v;
+	int k, l, bad = 0;
+
+	asc_assert(p != NULL && p != OPCODES_FAILED);
+	asc_assert(nvars >= p->nvars);
+
+	rop_forward_n(p, x, r);
+	rk = r + (p->ninstr - 1)*L;
+	LANES res[l] = rk[l];
+
+	adj = r + p->ninstr*L;
+	for(k = 0; k < p->ninstr*L; k++)adj[k] = 0.0;
+	for(v = 0; v < nvars*L; v++)grad[v] = 0.0;
+	wk = adj + (p->ninstr - 1)*L;
+	LANES wk[l] = 1.0;
+
+	for(k = p->ninstr - 1; k >= 0; k--){
+		i = &(p->code[k]);
+		wk = adj + k*L;
+		rk = r + k*L;
+		ra = r + i->a*L;
+		aa = adj + i->a*L;
+		switch(i->op){
+		case ROP_VAR:
+			ga = grad + i->a*L;
+			LANES ga[l] += wk[l];
+			break;
+		case ROP_CONST: break;
+		case ROP_ADD:
+			ab = adj + i->b*L;
+			LANES{ aa[l] += wk[l]; ab[l] += wk[l]; }
+			break;
+		case ROP_SUB:
+			ab = adj + i->b*L;
+			LANES{ aa[l] += wk[l]; ab[l] -= wk[l]; }
+			break;
+		case ROP_MUL:
+			rb = r + i->b*L; ab = adj + i->b*L;
+			LANES{ aa[l] += wk[l] * rb[l]; ab[l] += wk[l] * ra[l]; }
+			break;
+		case ROP_DIV:
+			rb = r + i->b*L; ab = adj + i->b*L;
+			LANES{ aa[l] += wk[l] / rb[l]; ab[l] -= wk[l] * rk[l] / rb[l]; }
+			break;
+		case ROP_ADDV:
+			ga = grad + i->b*L;
+			LANES{ aa[l] += wk[l]; ga[l] += wk[l]; }
+			break;
+		case ROP_SUBV:
+			ga = grad + i->b*L;
+			LANES{ aa[l] += wk[l]; ga[l] -= wk[l]; }
+			break;
+		case ROP_MULV:
+			xb = x + i->b*L; ga = grad + i->b*L;
+			LANES{ aa[l] += wk[l] * xb[l]; ga[l] += wk[l] * ra[l]; }
+			break;
+		case ROP_DIVV:
+			xb = x + i->b*L; ga = grad + i->b*L;
+			LANES{ aa[l] += wk[l] / xb[l]; ga[l] -= wk[l] * rk[l] / xb[l]; }
+			break;
+		case ROP_ADDC:
+		case ROP_SUBC:  LANES aa[l] += wk[l]; break;
+		case ROP_MULC:  cv = c[i->b]; LANES aa[l] += wk[l] * cv; break;
+		case ROP_DIVC:  cv = c[i->b]; LANES aa[l] += wk[l] / cv; break;
+		case ROP_RSUBC: LANES aa[l] -= wk[l]; break;
+		case ROP_RDIVC: LANES aa[l] -= wk[l] * rk[l] / ra[l]; break;
+		case ROP_POW:
+			rb = r + i->b*L; ab = adj + i->b*L;
+			LANES{
+				aa[l] += wk[l] * rb[l] * pow(ra[l], rb[l] - 1.0);
+				ab[l] += wk[l] * log(ra[l]) * rk[l];
+			}
+			break;
+		case ROP_POWC:
+			cv = c[i->b];
+			LANES aa[l] += wk[l] * cv * pow(ra[l], cv - 1.0);
+			break;
+		case ROP_IPOW:
+			rb = r + i->b*L; ab = adj + i->b*L;
+			LANES{
+				aa[l] += wk[l] * asc_d1ipow(ra[l], (int)rb[l]);
+				ab[l] += wk[l] * log(ra[l]) * rk[l];
+			}
+			break;
+		case ROP_IPOWI:
+			LANES aa[l] += wk[l] * asc_d1ipow(ra[l], i->b);
+			break;
+		case ROP_NEG:   LANES aa[l] -= wk[l]; break;
+		case ROP_FUNC:
+			LANES aa[l] += wk[l] * FuncDeriv(p->funcs[i->b], ra[l]);
+			break;
+		default:
+			ASC_PANIC("Invalid opcode %d", i->op);
+		}
+	}
+
+	LANES{
+		if(!asc_finite(res[l]))bad |= (1 << l);
+	}
+	for(v = 0; v < nvars; v++){
+		ga = grad + v*L;
+		LANES{
+			if(!asc_finite(ga[l]))bad |= (1 << l);
+		}
+	}
+	return bad;
+}
+
+#undef LANES
+#undef L
@@ -0,0 +1,220 @@
+/*	ASCEND modelling environment
+	Copyright (C) 2015 Carnegie Mellon University
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2, or (at your option)
+	any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*//**
+	@file
+	Register bytecode ('opcodes') for token relations.
+
+	The postfix token arrays of a TokenRelation are convenient for the
+	compiler but slow to evaluate: every term costs a switch on the term
+	type, a walk of the union RelationTermUnion array and (for variables) a
+	gl_list fetch and an instance dereference.
+
+	This module lowers the token arrays of a relation share into a compact
+	register program plus a pool of real constants. The program is in SSA
+	form: instruction k writes register k, so that after a forward sweep
+	all intermediate values are available for a reverse (adjoint) sweep,
+	which gives the full gradient at a cost of a small multiple of the
+	residual.
+
+	Variable operands index a flat array of doubles 'x' holding the values
+	of the relation's variables in varlist order, from 0. Leaf loads are
+	folded into the operators that use them wherever possible, and
+	constant subexpressions are folded at compile time, so most relations
+	compile to fewer instructions than they have tokens.
+
+	The program is compiled lazily the first time it is requested for a
+	share (@see RelationOpCodes) and is kept with the share in the
+	TokenRelation, so it is compiled once per unique token string, in the
+	same spirit as the machine code of bintoken.c but without needing an
+	external C compiler.
+*/
+
+#ifndef ASC_REL_OPCODE_H
+#define ASC_REL_OPCODE_H
+
+/**	@addtogroup compiler_rel Compiler Relations
+	@{
+*/
+
+#include <ascend/general/platform.h>
+#include "functype.h"
+#include "relation_type.h"
+
+ASC_DLLSPEC int g_relation_opcodes;
+/**<
+	If nonzero (the default), the relation manager (relman_eval,
+	relman_diff2 and friends) evaluates token relations with the opcode
+	evaluator in this file, falling back to the postfix evaluators only
+	when the opcode result is not finite (so that the safe/unsafe error
+	reporting of the old evaluators is preserved). Set to 0 to use the
+	postfix evaluators exclusively, eg for benchmarking.
+*/
+
+/** Operations of the relation register machine. 'r' is the register file,
+	'x' the variable values, 'c' the constant pool. The destination of
+	instruction k is always r[k]. */
+enum RelOpCode_enum {
+	ROP_VAR,   /**< r = x[a] */
+	ROP_CONST, /**< r = c[a] */
+	ROP_ADD,   /**< r = r[a] + r[b] */
+	ROP_SUB,   /**< r = r[a] - r[b] */
+	ROP_MUL,   /**< r = r[a] * r[b] */
+	ROP_DIV,   /**< r = r[a] / r[b] */
+	ROP_ADDV,  /**< r = r[a] + x[b] */
+	ROP_SUBV,  /**< r = r[a] - x[b] */
+	ROP_MULV,  /**< r = r[a] * x[b] */
+	ROP_DIVV,  /**< r = r[a] / x[b] */
+	ROP_ADDC,  /**< r = r[a] + c[b] */
+	ROP_SUBC,  /**< r = r[a] - c[b] */
+	ROP_MULC,  /**< r = r[a] * c[b] */
+	ROP_DIVC,  /**< r = r[a] / c[b] */
+	ROP_RSUBC, /**< r = c[b] - r[a] */
+	ROP_RDIVC, /**< r = c[b] / r[a] */
+	ROP_POW,   /**< r = pow(r[a],r[b]) */
+	ROP_POWC,  /**< r = pow(r[a],c[b]) */
+	ROP_IPOW,  /**< r = asc_ipow(r[a],(int)r[b]) */
+	ROP_IPOWI, /**< r = asc_ipow(r[a],b), integer exponent b */
+	ROP_NEG,   /**< r = -r[a] */
+	ROP_FUNC   /**< r = f[b](r[a]) where f is the function table */
+};
+
+/** One instruction of the relation register machine. */
+struct RelOpInstr {
+	int op; /**< enum RelOpCode_enum */
+	int a;  /**< first operand (register or variable/constant index) */
+	int b;  /**< second operand (register, var, const, func or exponent) */
+};
+
+/** A compiled relation share. Residual is the last register written. */
+struct RelOpCodes {
+	int ninstr;                  /**< number of instructions (>= 1) */
+	int nconst;                  /**< size of the constant pool */
+	int nfunc;                   /**< size of the function table */
+	unsigned long nvars;         /**< 1 + largest variable index used */
+	struct RelOpInstr *code;     /**< the program */
+	double *constants;           /**< the constant pool */
+	CONST struct Func **funcs;   /**< functions referenced by ROP_FUNC */
+};
+
+/**
+	Compile the token arrays of relation 'r' into a register program.
+
+	@return the new program, or NULL if the relation is not a token
+	relation or contains a term that the opcode machine does not know.
+	The caller owns the result; @see RelOpCodesDestroy.
+*/
+extern struct RelOpCodes *RelOpCodesCompile(CONST struct relation *r);
+
+/**
+	Free a program created by RelOpCodesCompile. Handles NULL and the
+	'uncompilable' marker kept in relation shares.
+*/
+extern void RelOpCodesDestroy(struct RelOpCodes *p);
+
+/**
+	Return the (cached) program for token relation 'r', compiling it on
+	first request and storing it with the relation share. Returns NULL if
+	the share cannot be compiled; that outcome is also cached so the
+	compile is not retried.
+*/
+ASC_DLLSPEC CONST struct RelOpCodes *RelationOpCodes(CONST struct relation *r);
+
+/**
+	Release the program cached with the share of 'r', if any. Must be
+	called whenever the token arrays of a share are modified in place.
+*/
+extern void RelationClearOpCodes(struct relation *r);
+
+/**
+	Number of doubles of scratch space needed by RelOpCodesResidual
+	(ninstr) and RelOpCodesResidGrad (2*ninstr).
+*/
+#define RelOpCodesScratch(p,grad) ((unsigned long)((grad)?2:1)*(p)->ninstr)
+
+/**
+	Evaluate the residual (lhs - rhs) of a compiled relation.
+
+	@param p     compiled program
+	@param x     variable values, indexed from 0 in varlist order
+	@param r     scratch register file of at least RelOpCodesScratch(p,0)
+	@param res   output residual
+	@return 0 if the residual is finite, 1 otherwise (*res still set).
+*/
+ASC_DLLSPEC int RelOpCodesResidual(CONST struct RelOpCodes *p
+		, CONST double *x, double *r, double *res);
+
+/**
+	Evaluate residual and gradient of a compiled relation by one forward
+	and one reverse sweep over the program.
+
+	@param p     compiled program
+	@param x     variable values, indexed from 0 in varlist order
+	@param r     scratch of at least RelOpCodesScratch(p,1) doubles
+	@param res   output residual
+	@param grad  output gradient, d(res)/d(x[j]) for j = 0..nvars-1
+	@param nvars length of grad (normally NumberVariables of the relation)
+	@return 0 if residual and gradient are all finite, 1 otherwise.
+*/
+ASC_DLLSPEC int RelOpCodesResidGrad(CONST struct RelOpCodes *p
+		, CONST double *x, double *r
+		, double *res, double *grad, unsigned long nvars);
+
+/**
+	Number of relations evaluated together by the lane evaluator.
+	Enough for a 512-bit vector of doubles.
+*/
+#define RELOP_LANES 8
+
+/**
+	Doubles of scratch space needed by RelOpCodesResidualN (grad=0) and
+	RelOpCodesResidGradN (grad=1).
+*/
+#define RelOpCodesScratchN(p,grad) (RELOP_LANES*RelOpCodesScratch((p),(grad)))
+
+/**
+	Evaluate the residuals of RELOP_LANES relations sharing the program p,
+	ie relations with the same share but different variable lists.
+
+	Arrays are lane-packed: element [j*RELOP_LANES + l] belongs to lane l.
+	Unused lanes must still hold values (eg copies of lane 0).
+
+	@param x     variable values, lane-packed, nvars*RELOP_LANES
+	@param r     scratch of at least RelOpCodesScratchN(p,0) doubles
+	@param res   output, RELOP_LANES residuals
+	@return bitmask with bit l set if the residual of lane l is not finite.
+*/
+ASC_DLLSPEC int RelOpCodesResidualN(CONST struct RelOpCodes *p
+		, CONST double *x, double *r, double *res);
+
+/**
+	Residuals and gradients of RELOP_LANES relations sharing the program p.
+	The lane version of RelOpCodesResidGrad.
+
+	@param x     variable values, lane-packed, nvars*RELOP_LANES
+	@param r     scratch of at least RelOpCodesScratchN(p,1) doubles
+	@param res   output, RELOP_LANES residuals
+	@param grad  output, lane-packed gradients, nvars*RELOP_LANES
+	@param nvars number of variables
+	@return bitmask with bit l set if the residual or gradient of lane l
+		is not finite.
+*/
+ASC_DLLSPEC int RelOpCodesResidGradN(CONST struct RelOpCodes *p
+		, CONST double *x, double *r
+		, double *res, double *grad, unsigned long nvars);
+
+/* @} */
+
+#endif /* ASC_REL_OPCODE_H */
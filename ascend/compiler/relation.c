@@ -55,6 +55,7 @@
 #include "relation_util.h"
 #include "rel_common.h"
 #include "rel_blackbox.h"
+#include "rel_opcode.h"
 #include "temp.h"
 #include "atomvalue.h"
 #include "mathinst.h"
@@ -77,7 +78,7 @@
 /*
  * Some global and exported variables.
  */
-struct gl_list_t *g_relation_var_list = NULL;
+ASC_THREAD_LOCAL struct gl_list_t *g_relation_var_list = NULL;
 
 int g_simplify_relations = 1;
 
@@ -146,8 +147,8 @@ void FigureOutError(struct value_t value,
  * of a pool and promise to return them immediately.
  */
 
-static pool_store_t g_term_pool = NULL;
-/* A pool_store for 1 expression.
+static ASC_THREAD_LOCAL pool_store_t g_term_pool = NULL;
+/* A pool_store for 1 expression, one per thread making relations.
  * It is expected that objective functions will cause the
  * largest expressions.
  * Each time an expression is completed, it will be copied
@@ -175,7 +176,7 @@ static void TermUnionInit(struct relation_term *tu)
 }
 #endif
 
-static struct {
+static ASC_THREAD_LOCAL struct {
   long startcheck;
   size_t len;
   size_t cap;
@@ -2069,6 +2070,7 @@ struct relation *CreateRelationStructure(enum Expr_enum relop,int copyunion)
     RTOKEN(newrelation).rhs_len = 0;
     RTOKEN(newrelation).btable = 0;
     RTOKEN(newrelation).bindex = 0;
+    RTOKEN(newrelation).opcodes = NULL;
 #else
     memset((char *)(newrelation->share),0,sizeof(union RelationUnion));
 #endif
@@ -3423,6 +3425,7 @@ void DestroyRelation(struct relation *rel, struct Instance *relinst)
       if (RTOKEN(rel).btable > 0) {
         BinTokenDeleteReference(RTOKEN(rel).btable);
       }
+      RelationClearOpCodes(rel);
       break;
     case e_opcode:
       //CONSOLE_DEBUG("Destroy opcode rel");
@@ -3537,6 +3540,7 @@ void DeleteAndChange(struct relation *rel,
   if (pos1 < pos2) Swap(&pos1,&pos2);
   /* pos1 > pos2 now */
   gl_delete(rel->vars,pos1,0);
+  RelationClearOpCodes(rel);
   if (RTOKEN(rel).rhs) {
     ChangeTermSide(RTOKEN(rel).rhs,RTOKEN(rel).rhs_len,pos1,pos2);
   }
@@ -3579,6 +3583,10 @@ union RelationUnion *CopyRelationShareToken(union RelationUnion *ru)
   }
   result->relop = src->relop;
   result->ref_count = src->ref_count;
+  /* machine code and opcodes are not shared with the copy */
+  result->btable = 0;
+  result->bindex = 0;
+  result->opcodes = NULL;
 
   return (union RelationUnion *)result;
 }
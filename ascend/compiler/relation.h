@@ -208,6 +208,9 @@ extern void InitRelInstantiator(void);
  *  before any relations can be built, ideally at startup time.
  *  Do not call it again unless DestroyRelInstantiator is called first.
  *  If insufficient memory to compile anything at all, does exit(2).
+ *  The gizmos belong to the calling thread: any other thread that
+ *  builds relations must call this (and later DestroyRelInstantiator)
+ *  for itself.
  */
 
 extern void DestroyRelInstantiator(void);
@@ -183,6 +183,8 @@ struct SharedRelation {
  *  Also you should not dereference the pointers in a relation
  *  except by appropriate operators from the header.
  */
+struct RelOpCodes;
+
 struct TokenRelation {
   enum Expr_enum relop;     /**< type of relation */
   REFCOUNT_T ref_count;     /**< number of instances looking here */
@@ -190,9 +192,11 @@ struct TokenRelation {
   union RelationTermUnion *lhs, *rhs;   /**< postfix arrays */
   struct relation_term *lhs_term, *rhs_term;    /**< infix trees */
   unsigned btable, bindex;  /**< indices to table and entry of machine code */
+  struct RelOpCodes *opcodes; /**< register program, see rel_opcode.h */
 };
 
-/** Unimplemented OpCodes */
+/** Unimplemented OpCodes. Token relations are lowered to register
+    bytecode on demand instead; see rel_opcode.h. */
 struct OpCodeRelation {
   enum Expr_enum relop;   /**< type of constraint */
   REFCOUNT_T ref_count;   /**< number of instances looking here */
@@ -48,6 +48,7 @@
 #include "atomvalue.h"
 #include "instance_name.h"
 #include "rel_blackbox.h"
+#include "rel_opcode.h"
 #include "relation.h"
 #include "instance_io.h"
 #include "instquery.h"
@@ -69,19 +70,6 @@
 int g_check_dimensions_noisy = 1;
 #define GCDN g_check_dimensions_noisy
 
-/** global relation pointer to avoid passing a relation recursively */
-static struct relation *glob_rel;
-
-/**
-	The following global variables are used thoughout the
-	functions called by RelationFindroot.
-
-	These should probably be located at the top of this
-	file alonge with glob_rel. [OK, let it be so then. -- JP]
-*/
-static int glob_varnum;
-static int glob_done;
-
 /* some data structurs...*/
 
 struct dimnode {
@@ -97,6 +85,31 @@ struct ds_soln_list {
    double *soln;
 };
 
+/**
+	Everything evaluating a relation needs apart from the relation itself.
+	This used to be file-scope data (glob_rel, glob_varnum, glob_done and
+	the tmpalloc buffer), which made evaluation impossible to do on two
+	threads at once.
+*/
+struct RelEvalContext {
+  char *stack;               /**< evaluation stacks, see ctx_stack */
+  unsigned long stackcap;    /**< bytes */
+  double *work;              /**< @see RelEvalContextWork */
+  unsigned long workcap;
+  /* used by RelationFindRoots and the functions it calls: */
+  struct relation *rel;      /**< temporary copy of the relation inverted */
+  int varnum;                /**< index of the variable solved for */
+  int done;                  /**< varnum sightings, then inversion result */
+  struct ds_soln_list soln;  /**< the roots, returned to the caller */
+  struct relation *tmprel;   /**< recycled by RelationCreateTmp */
+  unsigned long lhscap, rhscap;
+};
+
+/** the context of each thread, for callers passing a NULL one */
+static ASC_THREAD_LOCAL struct RelEvalContext *g_thread_context = NULL;
+
+#define CTX(c) ((c) != NULL ? (c) : RelEvalContextThread())
+
 /*
 	Define the following if you want ASCEND to panic when it hits a
 	relation error in this file. This will help with debugging (GDB).
@@ -114,24 +127,26 @@ int ArgsForRealToken(enum Expr_enum type);
 static int IsZero(struct dimnode *node);
 
 /* bunch of support functions for RelationFindRoots */
-static double RootFind(struct relation *rel, double *lower_bound, double *upper_bound,
+static double RootFind(struct RelEvalContext *ctx, double *lower_bound, double *upper_bound,
 	double *nominal,double *tolerance,int varnum,int *status);
 static int CalcResidGivenValue(int *mode, int *m, int *varnum,double *val, double *u, double *f, double *g);
-int RelationInvertTokenTop(struct ds_soln_list *soln_list);
-int RelationInvertToken(struct relation_term **term,struct ds_soln_list *soln_list,enum safe_err *not_safe);
-static void SetUpInvertTokenTop(struct relation_term **invert_side,double *value);
-static int SetUpInvertToken(struct relation_term *term,struct relation_term **invert_side,double *value);
-static int SearchEval_Branch(struct relation_term *term);
+static int RelationInvertTokenTop(struct RelEvalContext *ctx);
+static int RelationInvertToken(struct RelEvalContext *ctx,struct relation_term **term,enum safe_err *not_safe);
+static void SetUpInvertTokenTop(struct RelEvalContext *ctx,struct relation_term **invert_side,double *value);
+static int SetUpInvertToken(struct RelEvalContext *ctx,struct relation_term *term,struct relation_term **invert_side,double *value);
+static int SearchEval_Branch(struct RelEvalContext *ctx,struct relation_term *term);
 static void InsertBranchResult(struct relation_term *term, double value);
 static void remove_soln( struct ds_soln_list *sl, int ndx);
 static void append_soln( struct ds_soln_list *sl, double soln);
-static struct relation *RelationTmpTokenCopy(CONST struct relation *src);
+static struct relation *RelationTmpTokenCopy(struct RelEvalContext *ctx,CONST struct relation *src);
 static int RelationTmpCopySide(union RelationTermUnion *old,unsigned long len,union RelationTermUnion *arr);
-static struct relation *RelationCreateTmp(unsigned long lhslen, unsigned long rhslen, enum Expr_enum relop);
+static struct relation *RelationCreateTmp(struct RelEvalContext *ctx,unsigned long lhslen, unsigned long rhslen, enum Expr_enum relop);
+static void RelationDestroyTmp(struct RelEvalContext *ctx);
 
 /* the following appear only to be used locally, so I've made them static  -- JP */
 
-static int RelationCalcDerivative(struct Instance *i, unsigned long vindex, double *grad);
+static int RelationCalcDerivative(struct Instance *i, unsigned long vindex, double *grad
+		, struct RelEvalContext *ctx);
 /**<
  *  This calculates the derivative of the relation df/dx (f = lhs-rhs)
  *  where x is the VINDEX-th entry in the relation's var list.
@@ -143,7 +158,8 @@ static int RelationCalcDerivative(struct Instance *i, unsigned long vindex, doub
  */
 
 static enum safe_err
-RelationCalcDerivativeSafe(struct Instance *i, unsigned long vindex, double *grad);
+RelationCalcDerivativeSafe(struct Instance *i, unsigned long vindex, double *grad
+		, struct RelEvalContext *ctx);
 /**<
  *  Calculates the derivative safely.
  *  Non-zero return value implies a problem.
@@ -592,24 +608,88 @@ int RelationCheckDimensions(struct Instance *relinst, dim_type *dimens)
   return( consistent && !wild );
 }
 
+/*------------------------------------------------------------------------------
+  EVALUATION CONTEXT
+*/
+
+struct RelEvalContext *RelEvalContextCreate(void){
+  return ASC_NEW_CLEAR(struct RelEvalContext);
+}
+
+void RelEvalContextDestroy(struct RelEvalContext *ctx){
+  if(ctx == NULL){
+    return;
+  }
+  if(ctx->stack != NULL){
+    ascfree(ctx->stack);
+  }
+  if(ctx->work != NULL){
+    ascfree(ctx->work);
+  }
+  if(ctx->soln.soln != NULL){
+    ascfree(ctx->soln.soln);
+  }
+  RelationDestroyTmp(ctx);
+  ascfree(ctx);
+}
+
+struct RelEvalContext *RelEvalContextThread(void){
+  if(g_thread_context == NULL){
+    g_thread_context = RelEvalContextCreate();
+  }
+  return g_thread_context;
+}
+
+void RelEvalContextThreadDestroy(void){
+  RelEvalContextDestroy(g_thread_context);
+  g_thread_context = NULL;
+}
+
+void *RelEvalContextStack(struct RelEvalContext *ctx, unsigned long nbytes){
+  ctx = CTX(ctx);
+  if(nbytes > ctx->stackcap){
+    if(ctx->stack != NULL){
+      ascfree(ctx->stack);
+    }
+    ctx->stack = ASC_NEW_ARRAY(char,nbytes);
+    ctx->stackcap = (ctx->stack != NULL) ? nbytes : 0;
+  }
+  return ctx->stack;
+}
+
+#define ctx_stack_array(ctx,nelts,type) \
+  ((type *)RelEvalContextStack((ctx),(nelts)*sizeof(type)))
+
+double *RelEvalContextWork(struct RelEvalContext *ctx, unsigned long n){
+  ctx = CTX(ctx);
+  if(n > ctx->workcap){
+    if(ctx->work != NULL){
+      ascfree(ctx->work);
+    }
+    ctx->work = ASC_NEW_ARRAY(double,n);
+    ctx->workcap = (ctx->work != NULL) ? n : 0;
+  }
+  return ctx->work;
+}
+
 /*------------------------------------------------------------------------------
   CALCULATION FUNCTIONS
 */
 
-/** @NOTE ANY function calling RelationBranchEvaluator should set
-   glob_rel to point at the relation being evaluated.  The calling
-   function should also set glob_rel = NULL when it is done.
+/**
+	Evaluate the infix tree of term, which belongs to relation rel.
 */
-static double RelationBranchEvaluator(struct relation_term *term)
-{
+static double RelationBranchEvaluator(CONST struct relation *rel
+		, struct relation_term *term
+){
   assert(term != NULL);
   switch(RelationTermType(term)) {
   case e_func:
 	 /* CONSOLE_DEBUG("Evaluating term using FuncEval..."); */
     return FuncEval(TermFunc(term),
-      RelationBranchEvaluator(TermFuncLeft(term)) );
+      RelationBranchEvaluator(rel,TermFuncLeft(term)) );
   case e_var:
-    return TermVariable(glob_rel , term);
+    return TermVariable(rel, term);
   case e_int:
     return (double)TermInteger(term);
   case e_real:
@@ -617,23 +697,23 @@ static double RelationBranchEvaluator(struct relation_term *term)
   case e_zero:
     return 0.0;
   case e_plus:
-    return (RelationBranchEvaluator(TermBinLeft(term)) +
-      RelationBranchEvaluator(TermBinRight(term)));
+    return (RelationBranchEvaluator(rel,TermBinLeft(term)) +
+      RelationBranchEvaluator(rel,TermBinRight(term)));
   case e_minus:
-    return (RelationBranchEvaluator(TermBinLeft(term)) -
-      RelationBranchEvaluator(TermBinRight(term)));
+    return (RelationBranchEvaluator(rel,TermBinLeft(term)) -
+      RelationBranchEvaluator(rel,TermBinRight(term)));
   case e_times:
-    return (RelationBranchEvaluator(TermBinLeft(term)) *
-      RelationBranchEvaluator(TermBinRight(term)));
+    return (RelationBranchEvaluator(rel,TermBinLeft(term)) *
+      RelationBranchEvaluator(rel,TermBinRight(term)));
   case e_divide:
-    return (RelationBranchEvaluator(TermBinLeft(term)) /
-      RelationBranchEvaluator(TermBinRight(term)));
+    return (RelationBranchEvaluator(rel,TermBinLeft(term)) /
+      RelationBranchEvaluator(rel,TermBinRight(term)));
   case e_power:
   case e_ipower:
-    return pow( RelationBranchEvaluator(TermBinLeft(term)) ,
-               RelationBranchEvaluator(TermBinRight(term)) );
+    return pow( RelationBranchEvaluator(rel,TermBinLeft(term)) ,
+               RelationBranchEvaluator(rel,TermBinRight(term)) );
   case e_uminus:
-    return - RelationBranchEvaluator(TermBinLeft(term));
+    return - RelationBranchEvaluator(rel,TermBinLeft(term));
   default:
     FPRINTF(ASCERR, "error in RelationBranchEvaluator routine\n");
     FPRINTF(ASCERR, "relation term type not recognized\n");
@@ -777,8 +857,9 @@ RelationEvaluatePostfixBranchSafe(CONST struct relation *r,
 	currently no way of knowing if this function failed.
 */
 static double
-RelationEvaluateResidualPostfix(CONST struct relation *r)
-{
+RelationEvaluateResidualPostfix(CONST struct relation *r
+		, struct RelEvalContext *ctx
+){
   unsigned long t;       /* the current term in the relation r */
   int lhs;               /* looking at left(=1) or right(=0) hand side */
   double *res_stack;     /* the stack we use for evaluating the residual */
@@ -793,7 +874,7 @@ RelationEvaluateResidualPostfix(CONST struct relation *r)
   if( (length_lhs+length_rhs) == 0 ) return 0.0;
 
   /* create the stacks */
-  res_stack = tmpalloc_array((1+MAX(length_lhs,length_rhs)),double);
+  res_stack = ctx_stack_array(ctx,(1+MAX(length_lhs,length_rhs)),double);
   if( res_stack == NULL ) return 0.0;
 
   lhs = 1;
@@ -878,13 +959,14 @@ RelationEvaluateResidualPostfix(CONST struct relation *r)
 	Computes the gradients by maintaining n stacks, where
 		n = (number-of-variables-in-r + 1)
 	The +1 is for the residual.  The stacks come from a single array which
-	this function gets by calling tmpalloc_array.  Two macros are defined
+	this function gets from the evaluation context.  Two macros are defined
 	to make referencing this array easier.
 */
 static int
 RelationEvaluateResidualGradient(CONST struct relation *r,
                                  double *residual,
-                                 double *gradient)
+                                 double *gradient,
+                                 struct RelEvalContext *ctx)
 {
   unsigned long t;       /* the current term in the relation r */
   unsigned long num_var; /* the number of variables in the relation r */
@@ -912,7 +994,7 @@ RelationEvaluateResidualGradient(CONST struct relation *r,
   }
 
   /* create the stacks */
-  stacks = tmpalloc_array(((num_var+1)*stack_height),double);
+  stacks = ctx_stack_array(ctx,((num_var+1)*stack_height),double);
   if( stacks == NULL ) return 1;
 
 #define res_stack(s)    stacks[(s)]
@@ -1082,7 +1164,8 @@ static int
 RelationEvaluateResidualGradientSafe(CONST struct relation *r,
                                      double *residual,
                                      double *gradient,
-                                     enum safe_err *serr)
+                                     enum safe_err *serr,
+                                     struct RelEvalContext *ctx)
 {
   unsigned long t;       /* the current term in the relation r */
   unsigned long num_var; /* the number of variables in the relation r */
@@ -1109,7 +1192,7 @@ RelationEvaluateResidualGradientSafe(CONST struct relation *r,
   }
 
   /* create the stacks */
-  stacks = tmpalloc_array(((num_var+1)*stack_height),double);
+  stacks = ctx_stack_array(ctx,((num_var+1)*stack_height),double);
   if( stacks == NULL ) return 1;
 
 #define res_stack(s)    stacks[(s)]
@@ -1283,14 +1366,15 @@ RelationEvaluateResidualGradientSafe(CONST struct relation *r,
 	This function assumes r exists and that pos is within the proper range.
 	The function computes the gradients by maintaining 2 stacks, one for
 	the residual and one for the derivative.  The stacks come from a
-	single array which this gets by calling tmpalloc_array.  Two macros
+	single array which this gets from the evaluation context.  Two macros
 	are defined to make referencing this array easier.  Of the malloc fails,
 	this function returns 0.0, so there is currently no way to know if
 	the function failed.
 */
 static double
 RelationEvaluateDerivative(CONST struct relation *r,
-                           unsigned long pos)
+                           unsigned long pos,
+                           struct RelEvalContext *ctx)
 {
   unsigned long t;       /* the current term in the relation r */
   int lhs;               /* looking at left(=1) or right(=0) hand side of r */
@@ -1311,7 +1395,7 @@ RelationEvaluateDerivative(CONST struct relation *r,
   }
 
   /* create the stacks */
-  stacks = tmpalloc_array((2*stack_height),double);
+  stacks = ctx_stack_array(ctx,(2*stack_height),double);
   if( stacks == NULL ) return 0.0;
 
 #define res_stack(s)  stacks[(s)]
@@ -1443,7 +1527,8 @@ RelationEvaluateDerivative(CONST struct relation *r,
 static double
 RelationEvaluateDerivativeSafe(CONST struct relation *r,
                                unsigned long pos,
-                               enum safe_err *serr)
+                               enum safe_err *serr,
+                               struct RelEvalContext *ctx)
 {
   unsigned long t;       /* the current term in the relation r */
   int lhs;               /* looking at left(=1) or right(=0) hand side of r */
@@ -1464,7 +1549,7 @@ RelationEvaluateDerivativeSafe(CONST struct relation *r,
   }
 
   /* create the stacks */
-  stacks = tmpalloc_array((2*stack_height),double);
+  stacks = ctx_stack_array(ctx,(2*stack_height),double);
   if( stacks == NULL ) return 0.0;
 
 #define res_stack(s)  stacks[(s)]
@@ -1944,7 +2029,9 @@ unsigned long RelationDepth(CONST struct relation *rel){
   "Documentation will be added at a later date" -- someone last century
 */
 
-static double FindMaxAdditiveTerm(struct relation_term *s){
+static double FindMaxAdditiveTerm(CONST struct relation *rel
+		, struct relation_term *s
+){
   enum safe_err serr;
   double lhs, rhs;
 
@@ -1952,20 +2039,20 @@ static double FindMaxAdditiveTerm(struct relation_term *s){
   case e_plus:
   case e_minus:
     /** note these used to be inlined with max, but a bug in gcc323 caused it to be split out. */
-    lhs = FindMaxAdditiveTerm(TermBinLeft(s));
-    rhs = FindMaxAdditiveTerm(TermBinRight(s));
+    lhs = FindMaxAdditiveTerm(rel,TermBinLeft(s));
+    rhs = FindMaxAdditiveTerm(rel,TermBinRight(s));
     return MAX(fabs(lhs), fabs(rhs));
   case e_uminus:
-    return (FindMaxAdditiveTerm(TermUniLeft(s)));
+    return (FindMaxAdditiveTerm(rel,TermUniLeft(s)));
   case e_times:
-    return (FindMaxAdditiveTerm(TermBinLeft(s))*
-      FindMaxAdditiveTerm(TermBinRight(s)));
+    return (FindMaxAdditiveTerm(rel,TermBinLeft(s))*
+      FindMaxAdditiveTerm(rel,TermBinRight(s)));
   case e_divide:
     /* bug patch / 0 */
-    return safe_div_D0(FindMaxAdditiveTerm(TermBinLeft(s)) ,
-      RelationBranchEvaluator(TermBinRight(s)),&serr);
+    return safe_div_D0(FindMaxAdditiveTerm(rel,TermBinLeft(s)) ,
+      RelationBranchEvaluator(rel,TermBinRight(s)),&serr);
   default:
-    return RelationBranchEvaluator(s);
+    return RelationBranchEvaluator(rel,s);
   }
 }
 
@@ -1976,8 +2063,8 @@ static double FindMaxFromTop(struct relation *s){
     return 0;
   }
   /** note these used to be inlined with max, but a bug in gcc323 caused it to be split out. */
-  lhs = FindMaxAdditiveTerm(Infix_LhsSide(s));
-  rhs = FindMaxAdditiveTerm(Infix_RhsSide(s));
+  lhs = FindMaxAdditiveTerm(s,Infix_LhsSide(s));
+  rhs = FindMaxAdditiveTerm(s,Infix_RhsSide(s));
   return MAX(fabs(lhs), fabs(rhs));
 }
 
@@ -1986,12 +2073,12 @@ double CalcRelationNominal(struct Instance *i){
   enum Expr_enum reltype;
   struct Instance *c , *p;
   symchar *nomname;
+  struct relation *rel;
 
   char *iname;
   iname = WriteInstanceNameString(i,NULL);
   ascfree(iname);
 
-  glob_rel = NULL;
   if (i == NULL){
     FPRINTF(ASCERR, "error in CalcRelationNominal routine\n");
     return (double)0;
@@ -2000,28 +2087,25 @@ double CalcRelationNominal(struct Instance *i){
     FPRINTF(ASCERR, "error in CalcRelationNominal routine\n");
     return (double)0;
   }
-  glob_rel = (struct relation *)GetInstanceRelation(i,&reltype);
-  if (glob_rel == NULL) {
+  rel = (struct relation *)GetInstanceRelation(i,&reltype);
+  if (rel == NULL) {
     FPRINTF(ASCERR, "error in CalcRelationNominal routine\n");
     return (double)0;
   }
 
   if (reltype == e_token) {
     double temp;
-    temp = FindMaxFromTop(glob_rel);
+    temp = FindMaxFromTop(rel);
     if (asc_isnan(temp) || !asc_finite(temp)) {
-      glob_rel = NULL;
       return (double)1;
     }
     if ( temp > 0) { /* this could return some really small numbers */
-      glob_rel = NULL;
       return temp;
     }
   }
   if (reltype == e_blackbox){
-    p = BlackBoxGetOutputVar(glob_rel);
+    p = BlackBoxGetOutputVar(rel);
     nomname = AddSymbol("nominal");
-    glob_rel = NULL;
     c = ChildByChar(p,nomname);
     if (c == NULL) {
       ERROR_REPORTER_HERE(ASC_PROG_ERR,"nominal missing from standard var definition (assuming 1.0) (%s)",__FUNCTION__);
@@ -2031,9 +2115,8 @@ double CalcRelationNominal(struct Instance *i){
     }
   }
   if (reltype == e_glassbox){
-    p = BlackBoxGetOutputVar(glob_rel);
+    p = BlackBoxGetOutputVar(rel);
     nomname = AddSymbol("nominal");
-    glob_rel = NULL;
     c = ChildByChar(p,nomname);
     if (c == NULL) {
       ERROR_REPORTER_HERE(ASC_PROG_ERR,"nominal missing from standard var definition (assuming 1.0) (%s)",__FUNCTION__);
@@ -2045,7 +2128,6 @@ double CalcRelationNominal(struct Instance *i){
   if (reltype == e_opcode){
     ERROR_REPORTER_HERE(ASC_PROG_ERR,"opcode not supported (%s)",__FUNCTION__);
   }
-  glob_rel = NULL;
   return (double)1;
 }
 
@@ -2083,7 +2165,9 @@ void RelationLoadDoubles(struct gl_list_t *varlist, double *vars){
 /**
 	only called on token relations.
 */
-int RelationCalcResidualBinary(CONST struct relation *r, double *res){
+int RelationCalcResidualBinary(CONST struct relation *r, double *res
+		, struct RelEvalContext *ctx
+){
   double *vars;
   double tres;
   int old_errno;
@@ -2091,7 +2175,7 @@ int RelationCalcResidualBinary(CONST struct relation *r, double *res){
   if (r == NULL || res == NULL) {
     return 1;
   }
-  vars = tmpalloc_array(gl_length(r->vars),double);
+  vars = ctx_stack_array(CTX(ctx),gl_length(r->vars),double);
   if (vars == NULL) {
     return 1;
   }
@@ -2117,8 +2201,114 @@ int RelationCalcResidualBinary(CONST struct relation *r, double *res){
   return 0;
 }
 
+/**
+	only called on token relations.
+*/
+int RelationCalcResidGradBinary(CONST struct relation *r
+		, double *res, double *grad, struct RelEvalContext *ctx
+){
+  double *vars;
+  unsigned long c, nv;
+  double tres;
+  int old_errno;
+
+  if (r == NULL || res == NULL || grad == NULL) {
+    return 1;
+  }
+  nv = gl_length(r->vars);
+  vars = ctx_stack_array(CTX(ctx),nv,double);
+  if (vars == NULL) {
+    return 1;
+  }
+  RelationLoadDoubles(r->vars,vars);
+  old_errno = errno; /* push C global errno */
+  errno = 0;
+  if (BinTokenCalcGradient(RTOKEN(r).btable,RTOKEN(r).bindex,vars,&tres,grad)
+      || !asc_finite(tres) || errno == EDOM || errno == ERANGE
+  ) {
+    if (errno == 0) { /* pop if unchanged */
+      errno = old_errno;
+    }
+    return 1;
+  }
+  if (errno == 0) { /* pop if unchanged */
+    errno = old_errno;
+  }
+  for (c = 0; c < nv; c++) {
+    if (!asc_finite(grad[c])) {
+      return 1;
+    }
+  }
+  *res = tres;
+  return 0;
+}
+
+/**
+	only called on token relations.
+*/
+int RelationCalcResidualOpCode(CONST struct relation *r, double *res
+		, struct RelEvalContext *ctx
+){
+  CONST struct RelOpCodes *p;
+  double *vars;
+  unsigned long nv;
+  double tres;
+  int old_errno, err;
+
+  if (r == NULL || res == NULL) {
+    return 1;
+  }
+  p = RelationOpCodes(r);
+  if (p == NULL) {
+    return 1;
+  }
+  nv = gl_length(r->vars);
+  vars = ctx_stack_array(CTX(ctx),nv + RelOpCodesScratch(p,0),double);
+  if (vars == NULL) {
+    return 1;
+  }
+  RelationLoadDoubles(r->vars,vars);
+  old_errno = errno; /* push C global errno */
+  err = RelOpCodesResidual(p,vars,vars+nv,&tres);
+  errno = old_errno;
+  if (err) {
+    return 1;
+  }
+  *res = tres;
+  return 0;
+}
+
+int RelationCalcResidGradOpCode(CONST struct relation *r
+		, double *res, double *grad, struct RelEvalContext *ctx
+){
+  CONST struct RelOpCodes *p;
+  double *vars;
+  unsigned long nv;
+  int old_errno, err;
+
+  if (r == NULL || res == NULL || grad == NULL) {
+    return 1;
+  }
+  p = RelationOpCodes(r);
+  if (p == NULL) {
+    return 1;
+  }
+  nv = gl_length(r->vars);
+  vars = ctx_stack_array(CTX(ctx),nv + RelOpCodesScratch(p,1),double);
+  if (vars == NULL) {
+    return 1;
+  }
+  RelationLoadDoubles(r->vars,vars);
+  old_errno = errno; /* push C global errno */
+  err = RelOpCodesResidGrad(p,vars,vars+nv,res,grad,nv);
+  errno = old_errno;
+  return err;
+}
+
 enum safe_err
-RelationCalcResidualPostfixSafe(struct Instance *i, double *res){
+RelationCalcResidualPostfixSafe(struct Instance *i, double *res
+		, struct RelEvalContext *ctx
+){
   struct relation *r;
   enum Expr_enum reltype;
   enum safe_err status = safe_ok;
@@ -2153,7 +2343,7 @@ RelationCalcResidualPostfixSafe(struct Instance *i, double *res){
       safe_error_to_stderr(&status);
       break;
     case e_blackbox:
-      if ( RelationCalcResidualPostfix(i,res) != 0) {
+      if ( RelationCalcResidualPostfix(i,res,ctx) != 0) {
         CONSOLE_DEBUG("Problem evaluating Blackbox residual");
         status = safe_problem;
         safe_error_to_stderr(&status);
@@ -2179,11 +2369,14 @@ RelationCalcResidualPostfixSafe(struct Instance *i, double *res){
 
 /* return 0 on success */
 int
-RelationCalcResidualPostfix(struct Instance *i, double *res){
+RelationCalcResidualPostfix(struct Instance *i, double *res
+		, struct RelEvalContext *ctx
+){
   struct relation *r;
   enum Expr_enum reltype;
   unsigned long length_lhs, length_rhs;
 
+  (void)ctx; /* the recursion needs no scratch */
   CHECK_INST_RES(i,res,1);
 
   r = (struct relation *)GetInstanceRelation(i, &reltype);
@@ -2232,26 +2425,28 @@ RelationCalcResidualPostfix(struct Instance *i, double *res){
   return 1;
 }
 
-int RelationCalcExceptionsInfix(struct Instance *i){
+int RelationCalcExceptionsInfix(struct Instance *i
+		, struct RelEvalContext *ctx
+){
   enum Expr_enum reltype;
+  struct relation *rel;
   double res;
   int result = 0;
   int old_errno;
 
-  glob_rel = NULL;
-
+  (void)ctx; /* the recursion needs no scratch */
   CHECK_INST_RES(i,&res,-1);
 
-  glob_rel = (struct relation *)GetInstanceRelation(i, &reltype);
-  if( glob_rel == NULL ) {
+  rel = (struct relation *)GetInstanceRelation(i, &reltype);
+  if( rel == NULL ) {
     ERROR_REPORTER_HERE(ASC_PROG_ERR,"NULL relation");
     return -1;
   }
   if( reltype == e_token ) {
-    if (Infix_LhsSide(glob_rel) != NULL) {
+    if (Infix_LhsSide(rel) != NULL) {
       old_errno = errno;
       errno = 0; /* save the last errno, because we don't know why */
-      res = RelationBranchEvaluator(Infix_LhsSide(glob_rel));
+      res = RelationBranchEvaluator(rel,Infix_LhsSide(rel));
       if (!asc_finite(res) || errno == EDOM || errno == ERANGE) {
         result |= RCE_ERR_LHS;
         if (asc_isnan(res)) {
@@ -2266,8 +2461,8 @@ int RelationCalcExceptionsInfix(struct Instance *i){
         errno = old_errno;
       } /* else something odd happened in evaluation */
     }
-    if(Infix_RhsSide(glob_rel) != NULL) {
-      res = RelationBranchEvaluator(Infix_RhsSide(glob_rel));
+    if(Infix_RhsSide(rel) != NULL) {
+      res = RelationBranchEvaluator(rel,Infix_RhsSide(rel));
       if (!asc_finite(res)) {
         result |= RCE_ERR_RHS;
         if (asc_isnan(res)) {
@@ -2279,11 +2474,9 @@ int RelationCalcExceptionsInfix(struct Instance *i){
         }
       }
     }
-    glob_rel = NULL;
     return result;
   }else if (reltype >= TOK_REL_TYPE_LOW && reltype <= TOK_REL_TYPE_HIGH) {
     ERROR_REPORTER_HERE(ASC_PROG_ERR,"relation type not implemented (%s)",__FUNCTION__);
-    glob_rel = NULL;
     return -1;
   }
 
@@ -2291,31 +2484,32 @@ int RelationCalcExceptionsInfix(struct Instance *i){
 }
 
 
-int RelationCalcResidualInfix(struct Instance *i, double *res){
+int RelationCalcResidualInfix(struct Instance *i, double *res
+		, struct RelEvalContext *ctx
+){
   enum Expr_enum reltype;
-  glob_rel = NULL;
+  struct relation *rel;
 
+  (void)ctx;
   CHECK_INST_RES(i,res,1);
 
-  glob_rel = (struct relation *)GetInstanceRelation(i, &reltype);
-  if( glob_rel == NULL ) {
+  rel = (struct relation *)GetInstanceRelation(i, &reltype);
+  if( rel == NULL ) {
     ERROR_REPORTER_HERE(ASC_PROG_ERR,"NULL relation\n");
     return 1;
   }
   if( reltype == e_token ) {
-    if(Infix_LhsSide(glob_rel) != NULL) {
-      *res = RelationBranchEvaluator(Infix_LhsSide(glob_rel));
+    if(Infix_LhsSide(rel) != NULL) {
+      *res = RelationBranchEvaluator(rel,Infix_LhsSide(rel));
     }else{
       *res = 0.0;
     }
-    if(Infix_RhsSide(glob_rel) != NULL) {
-      *res -= RelationBranchEvaluator(Infix_RhsSide(glob_rel));
+    if(Infix_RhsSide(rel) != NULL) {
+      *res -= RelationBranchEvaluator(rel,Infix_RhsSide(rel));
     }
-    glob_rel = NULL;
     return 0;
   }else if (reltype >= TOK_REL_TYPE_LOW && reltype <= TOK_REL_TYPE_HIGH) {
     ERROR_REPORTER_HERE(ASC_PROG_ERR,"reltype not implemented (%s)",__FUNCTION__);
-    glob_rel = NULL;
     return 1;
   }
 
@@ -2327,7 +2521,9 @@ int RelationCalcResidualInfix(struct Instance *i, double *res){
 	There used to be a stoopid comment here so I removed it.
 */
 int
-RelationCalcResidualPostfix2(struct Instance *i, double *res){
+RelationCalcResidualPostfix2(struct Instance *i, double *res
+		, struct RelEvalContext *ctx
+){
   struct relation *r;
   enum Expr_enum reltype;
 
@@ -2340,7 +2536,7 @@ RelationCalcResidualPostfix2(struct Instance *i, double *res){
   }
 
   if( reltype == e_token ){
-    *res = RelationEvaluateResidualPostfix(r);
+    *res = RelationEvaluateResidualPostfix(r,CTX(ctx));
     return 0;
   }else if (reltype >= TOK_REL_TYPE_LOW && reltype <= TOK_REL_TYPE_HIGH){
     ERROR_REPORTER_HERE(ASC_PROG_ERR,"reltype not implemented (%s)",__FUNCTION__);
@@ -2356,9 +2552,11 @@ RelationCalcResidualPostfix2(struct Instance *i, double *res){
 	then ignore the residual
 */
 int
-RelationCalcGradient(struct Instance *r, double *grad){
+RelationCalcGradient(struct Instance *r, double *grad
+		, struct RelEvalContext *ctx
+){
   double residual;
-  return RelationCalcResidGrad(r, &residual, grad);
+  return RelationCalcResidGrad(r, &residual, grad, ctx);
 }
 
 /*
@@ -2368,14 +2566,18 @@ RelationCalcGradient(struct Instance *r, double *grad){
 	return 0 on success (as 'safe_ok' enum)
 */
 enum safe_err
-RelationCalcGradientSafe(struct Instance *r, double *grad){
+RelationCalcGradientSafe(struct Instance *r, double *grad
+		, struct RelEvalContext *ctx
+){
   double residual;
   //CONSOLE_DEBUG("Gradient Evaluation Type: SAFE");
-  return RelationCalcResidGradSafe(r, &residual, grad);
+  return RelationCalcResidGradSafe(r, &residual, grad, ctx);
 }
 
 /* return 0 on success, 1 on error */
-int RelationCalcResidGrad(struct Instance *i, double *residual, double *gradient){
+int RelationCalcResidGrad(struct Instance *i, double *residual, double *gradient
+		, struct RelEvalContext *ctx
+){
   struct relation *r;
   enum Expr_enum reltype;
 
@@ -2389,7 +2591,7 @@ int RelationCalcResidGrad(struct Instance *i, double *residual, double *gradient
   }
 
   if(reltype == e_token ){
-    return RelationEvaluateResidualGradient(r, residual, gradient);
+    return RelationEvaluateResidualGradient(r, residual, gradient, CTX(ctx));
   }
 
   if(reltype == e_blackbox){
@@ -2402,7 +2604,7 @@ int RelationCalcResidGrad(struct Instance *i, double *residual, double *gradient
 }
 
 enum safe_err RelationCalcResidGradSafe(struct Instance *i
-		, double *residual, double *gradient
+		, double *residual, double *gradient, struct RelEvalContext *ctx
 ){
   struct relation *r;
   enum Expr_enum reltype;
@@ -2435,7 +2637,9 @@ enum safe_err RelationCalcResidGradSafe(struct Instance *i
 
 
   if( reltype == e_token ) {
-    RelationEvaluateResidualGradientSafe(r, residual, gradient, &not_safe);
+    RelationEvaluateResidualGradientSafe(r, residual, gradient, &not_safe
+      , CTX(ctx)
+    );
     //CONSOLE_DEBUG("Relation Type: e_token");
     return not_safe;
   }
@@ -2469,9 +2673,11 @@ enum safe_err RelationCalcResidGradSafe(struct Instance *i
 	simply call the version that calculates the gradient and the residual,
 	then ignore the residual
 */
-int	RelationCalcGradientRev(struct Instance *r, double *grad){
+int	RelationCalcGradientRev(struct Instance *r, double *grad
+		, struct RelEvalContext *ctx
+){
 	double residual;
-	return RelationCalcResidGradRev(r, &residual, grad);
+	return RelationCalcResidGradRev(r, &residual, grad, ctx);
 }
 
 /*
@@ -2480,15 +2686,19 @@ int	RelationCalcGradientRev(struct Instance *r, double *grad){
 
 		return 0 on success (as 'safe_ok' enum)
 */
-enum safe_err RelationCalcGradientRevSafe(struct Instance *r, double *grad){
+enum safe_err RelationCalcGradientRevSafe(struct Instance *r, double *grad
+		, struct RelEvalContext *ctx
+){
 	double residual;
 	//CONSOLE_DEBUG("Gradient Evaluation Type: SAFE");
-	return RelationCalcResidGradRevSafe(r, &residual, grad);
+	return RelationCalcResidGradRevSafe(r, &residual, grad, ctx);
 }
 
 
 /* return 0 on success, 1 on error */
-int RelationCalcResidGradRev(struct Instance *i, double *residual, double *gradient){
+int RelationCalcResidGradRev(struct Instance *i, double *residual, double *gradient
+		, struct RelEvalContext *ctx
+){
 	struct relation *r;
 	enum Expr_enum reltype;
 
@@ -2502,7 +2712,7 @@ int RelationCalcResidGradRev(struct Instance *i, double *residual, double *gradi
 	}
 
 	if(reltype == e_token ){
-		RelationEvaluateResidualGradientRev(r, residual, gradient,0);
+		RelationEvaluateResidualGradientRev(r, residual, gradient,0,CTX(ctx));
 		return 0;
 	}
 
@@ -2517,7 +2727,7 @@ int RelationCalcResidGradRev(struct Instance *i, double *residual, double *gradi
 }
 
 enum safe_err RelationCalcResidGradRevSafe(struct Instance *i
-		, double *residual, double *gradient)
+		, double *residual, double *gradient, struct RelEvalContext *ctx)
 {
 	struct relation *r;
 	enum Expr_enum reltype;
@@ -2550,7 +2760,9 @@ enum safe_err RelationCalcResidGradRevSafe(struct Instance *i
 
 
 	if( reltype == e_token ) {
-		RelationEvaluateResidualGradientRevSafe(r, residual, gradient,0, &not_safe);
+		RelationEvaluateResidualGradientRevSafe(r, residual, gradient,0, &not_safe
+			,CTX(ctx)
+		);
 		//CONSOLE_DEBUG("Relation Type: e_token");
 		return not_safe;
 	}
@@ -2582,7 +2794,9 @@ enum safe_err RelationCalcResidGradRevSafe(struct Instance *i
 /**----------------------------Second Derivative Calculations ------------------------------- */
 
 /* return 0 on success, 1 on error */
-int RelationCalcSecondDeriv(struct Instance *i, double *deriv2nd, unsigned long var_index){
+int RelationCalcSecondDeriv(struct Instance *i, double *deriv2nd, unsigned long var_index
+		, struct RelEvalContext *ctx
+){
 	struct relation *r;
 	enum Expr_enum reltype;
 
@@ -2594,7 +2808,7 @@ int RelationCalcSecondDeriv(struct Instance *i, double *deriv2nd, unsigned long
 	}
 
 	if(reltype == e_token ){
-		RelationEvaluateSecondDeriv(r,deriv2nd,var_index,0,NULL); //FIXME Check this
+		RelationEvaluateSecondDeriv(r,deriv2nd,var_index,0,NULL,CTX(ctx)); //FIXME Check this
   		return 0;
 	}
 
@@ -2608,7 +2822,8 @@ int RelationCalcSecondDeriv(struct Instance *i, double *deriv2nd, unsigned long
 	return 1;
 }
 
-enum safe_err RelationCalcSecondDerivSafe(struct Instance *i, double *deriv2nd,unsigned long var_index)
+enum safe_err RelationCalcSecondDerivSafe(struct Instance *i, double *deriv2nd,unsigned long var_index
+		, struct RelEvalContext *ctx)
 {
 	struct relation *r;
 	enum Expr_enum reltype;
@@ -2646,7 +2861,8 @@ enum safe_err RelationCalcSecondDerivSafe(struct Instance *i, double *deriv2nd,u
 		  								var_index,
 										0,
  										NULL,
- 										&not_safe);
+ 										&not_safe,
+										CTX(ctx));
 		return not_safe;
 	}
 	if (reltype == e_blackbox){
@@ -2678,7 +2894,9 @@ enum safe_err RelationCalcSecondDerivSafe(struct Instance *i, double *deriv2nd,u
 /**----------------------------Hessian Calculations Routines------------------------------- */
 
 /* return 0 on success, 1 on error */
-int RelationCalcHessianMtx(struct Instance *i, hessian_mtx *hess_mtx, unsigned long dimension){
+int RelationCalcHessianMtx(struct Instance *i, hessian_mtx *hess_mtx, unsigned long dimension
+		, struct RelEvalContext *ctx
+){
 	struct relation *r;
 	enum Expr_enum reltype;
 
@@ -2691,7 +2909,7 @@ int RelationCalcHessianMtx(struct Instance *i, hessian_mtx *hess_mtx, unsigned l
 	}
 
 	if(reltype == e_token ){
-		RelationEvaluateHessianMtx(r,hess_mtx,dimension);
+		RelationEvaluateHessianMtx(r,hess_mtx,dimension,CTX(ctx));
 		return 0;
 	}
 
@@ -2705,7 +2923,8 @@ int RelationCalcHessianMtx(struct Instance *i, hessian_mtx *hess_mtx, unsigned l
 	return 1;
 }
 
-enum safe_err RelationCalcHessianMtxSafe(struct Instance *i, hessian_mtx *hess_mtx,unsigned long dimension)
+enum safe_err RelationCalcHessianMtxSafe(struct Instance *i, hessian_mtx *hess_mtx,unsigned long dimension
+		, struct RelEvalContext *ctx)
 {
 	struct relation *r;
 	enum Expr_enum reltype;
@@ -2739,7 +2958,7 @@ enum safe_err RelationCalcHessianMtxSafe(struct Instance *i, hessian_mtx *hess_m
 
 
 	if( reltype == e_token ) {
-		RelationEvaluateHessianMtxSafe(r,hess_mtx,dimension,&not_safe);
+		RelationEvaluateHessianMtxSafe(r,hess_mtx,dimension,&not_safe,CTX(ctx));
 		return not_safe;
 	}
 	if (reltype == e_blackbox){
@@ -2780,7 +2999,8 @@ enum safe_err RelationCalcHessianMtxSafe(struct Instance *i, hessian_mtx *hess_m
 int
 RelationCalcDerivative(struct Instance *i,
                        unsigned long vindex,
-                       double *gradient)
+                       double *gradient,
+                       struct RelEvalContext *ctx)
 {
   struct relation *r;
   enum Expr_enum reltype;
@@ -2798,7 +3018,7 @@ RelationCalcDerivative(struct Instance *i,
   }
 
   if( reltype == e_token ) {
-    *gradient = RelationEvaluateDerivative(r, vindex);
+    *gradient = RelationEvaluateDerivative(r, vindex, CTX(ctx));
     return 0;
   }
   else if (reltype >= TOK_REL_TYPE_LOW && reltype <= TOK_REL_TYPE_HIGH) {
@@ -2811,7 +3031,8 @@ RelationCalcDerivative(struct Instance *i,
 enum safe_err
 RelationCalcDerivativeSafe(struct Instance *i,
                            unsigned long vindex,
-                           double *gradient)
+                           double *gradient,
+                           struct RelEvalContext *ctx)
 {
   struct relation *r;
   enum Expr_enum reltype;
@@ -2836,7 +3057,7 @@ RelationCalcDerivativeSafe(struct Instance *i,
   }
 
   if( reltype == e_token ) {
-    *gradient = RelationEvaluateDerivativeSafe(r, vindex, &not_safe);
+    *gradient = RelationEvaluateDerivativeSafe(r, vindex, &not_safe, CTX(ctx));
     return not_safe;
   }
   else if (reltype >= TOK_REL_TYPE_LOW && reltype <= TOK_REL_TYPE_HIGH) {
@@ -2864,7 +3085,7 @@ void PrintGradients(struct Instance *i){
 
     /*****  use the non safe versions  *****/
     for( v = 0; v < vars; v++ ) {
-      if( ! RelationCalcDerivative(i, v+1, &res) ) {
+      if( ! RelationCalcDerivative(i, v+1, &res,NULL) ) {
         PRINTF("derivative in%5ld =\t%g\n", v+1, res);
       }
       else {
@@ -2872,7 +3093,7 @@ void PrintGradients(struct Instance *i){
       }
     }
 
-    if( ! RelationCalcResidGrad(i,&res,grads) ) {
+    if( ! RelationCalcResidGrad(i,&res,grads,NULL) ) {
       for (v = 0; v < vars; v++) {
         PRINTF("gradient in %6ld =\t%g\n", v+1, grads[v]);
       }
@@ -2882,21 +3103,21 @@ void PrintGradients(struct Instance *i){
       PRINTF("**** RelationCalcResidGrad returned nonzero status\n");
     }
 
-    if( !RelationCalcResidualInfix(i,&res) ) {
+    if( !RelationCalcResidualInfix(i,&res,NULL) ) {
       PRINTF("    infix residual =\t%g\n", res);
     }
     else {
       PRINTF("**** RelationCalcResidualInfix returned nonzero status\n");
     }
 
-    if( !RelationCalcResidualPostfix(i,&res) ) {
+    if( !RelationCalcResidualPostfix(i,&res,NULL) ) {
       PRINTF("  postfix residual =\t%g\n", res);
     }
     else {
       PRINTF("**** RelationCalcResidualPostfix returned nonzero status\n");
     }
 
-    if( !RelationCalcResidualPostfix2(i,&res) ) {
+    if( !RelationCalcResidualPostfix2(i,&res,NULL) ) {
       PRINTF(" postfix2 residual =\t%g\n", res);
     }
     else {
@@ -2905,7 +3126,7 @@ void PrintGradients(struct Instance *i){
 
     /*****  use the safe versions  *****/
     for( v = 0; v < vars; v++ ) {
-      if(safe_ok == (safe = RelationCalcDerivativeSafe(i, v+1, &res)) ) {
+      if(safe_ok == (safe = RelationCalcDerivativeSafe(i, v+1, &res,NULL)) ) {
         PRINTF("safe deriv in%5ld =\t%g\n", v+1, res);
       }
       else {
@@ -2913,7 +3134,7 @@ void PrintGradients(struct Instance *i){
       }
     }
 
-    if(safe_ok == (safe = RelationCalcResidGradSafe(i,&res,grads)) ) {
+    if(safe_ok == (safe = RelationCalcResidGradSafe(i,&res,grads,NULL)) ) {
       for (v = 0; v < vars; v++) {
         PRINTF("safe grad in%6ld =\t%g\n", v+1, grads[v]);
       }
@@ -2923,7 +3144,7 @@ void PrintGradients(struct Instance *i){
       PRINTF("**** RelationCalcResidGradSafe returned nonzero: %d\n", safe);
     }
 
-	if(safe_ok==(safe=RelationCalcResidGradRevSafe(i,&res,grads))){
+	if(safe_ok==(safe=RelationCalcResidGradRevSafe(i,&res,grads,NULL))){
 		for (v = 0; v < vars; v++) {
 			PRINTF("reverse safe grad in%6ld =\t%g\n", v+1, grads[v]);
 		}
@@ -2933,7 +3154,7 @@ void PrintGradients(struct Instance *i){
 		PRINTF("**** RelationCalcResidGradRevSafe returned nonzero: %d\n", safe);
 	}
 
-	if( ! RelationCalcResidGradRev(i,&res,grads) ) {
+	if( ! RelationCalcResidGradRev(i,&res,grads,NULL) ) {
 		for (v = 0; v < vars; v++) {
 			PRINTF("reverse non-safe gradient in %6ld =\t%g\n", v+1, grads[v]);
 		}
@@ -2952,7 +3173,7 @@ void PrintGradients(struct Instance *i){
     }
   *****/
 
-    if(safe_ok == (safe = RelationCalcResidualPostfixSafe(i,&res)) ) {
+    if(safe_ok == (safe = RelationCalcResidualPostfixSafe(i,&res,NULL)) ) {
       PRINTF("safe postfix resid =\t%g\n", res);
     }
     else {
@@ -2994,22 +3215,22 @@ void TimeCalcResidual(struct gl_list_t *rlist,int method){
   switch (method) {
   case m_BIN:
     for (c=1,len=gl_length(rlist); c <= len; c++) {
-      RelationCalcResidualBinary(gl_fetch(rlist,c),&res);
+      RelationCalcResidualBinary(gl_fetch(rlist,c),&res,NULL);
     }
     break;
   case m_PFS:
     for (c=1,len=gl_length(rlist); c <= len; c++) {
-      RelationCalcResidualPostfixSafe(gl_fetch(rlist,c),&res);
+      RelationCalcResidualPostfixSafe(gl_fetch(rlist,c),&res,NULL);
     }
     break;
   case m_PF:
     for (c=1,len=gl_length(rlist); c <= len; c++) {
-      RelationCalcResidualPostfix(gl_fetch(rlist,c),&res);
+      RelationCalcResidualPostfix(gl_fetch(rlist,c),&res,NULL);
     }
     break;
   case m_IF:
     for (c=1,len=gl_length(rlist); c <= len; c++) {
-      RelationCalcResidualInfix(gl_fetch(rlist,c),&res);
+      RelationCalcResidualInfix(gl_fetch(rlist,c),&res,NULL);
     }
     break;
   default:
@@ -3033,16 +3254,16 @@ void PrintResidual(struct Instance *i){
   if (InstanceKind(i) == REL_INST) {
     rel = (struct relation *)GetInstanceRelation(i,&reltype);
     if (reltype == e_token) {
-      errb = RelationCalcResidualBinary(rel,&(binary));
+      errb = RelationCalcResidualBinary(rel,&(binary),NULL);
     }else{
       errb = 1;
     }
-    se = RelationCalcResidualPostfixSafe(i,&(postsafe));
+    se = RelationCalcResidualPostfixSafe(i,&(postsafe),NULL);
     if (errb || se != safe_ok) {
       FPRINTF(ASCERR,"Skipping Postfix,Infix\n");
     }else{
-      RelationCalcResidualPostfix(i,&(post));
-      RelationCalcResidualInfix(i,&(in));
+      RelationCalcResidualPostfix(i,&(post),NULL);
+      RelationCalcResidualInfix(i,&(in),NULL);
     }
     PRINTF("binary residual  = %.18g\n",binary);
     PRINTF("postfix safe res = %.18g\n",postsafe);
@@ -3075,145 +3296,125 @@ double *RelationFindRoots(struct Instance *i,
 		double tolerance,
 		int *varnum,
 		int *able,
-		int *nsolns
+		int *nsolns,
+		struct RelEvalContext *ctx
 ){
   struct relation *rel;
   double sideval;
   enum Expr_enum reltype;
-  static struct ds_soln_list soln_list = {0,0,NULL};
   CONST struct gl_list_t *list;
 
-  /* check for recycle shutdown */
-  if (i==NULL && varnum == NULL && able == NULL && nsolns == NULL) {
-    if (soln_list.soln != NULL) {
-      ascfree(soln_list.soln);
-      soln_list.soln = NULL;
-      soln_list.length = soln_list.capacity = 0;
-    }
-    RootFind(NULL,NULL,NULL,NULL,NULL,0L,NULL); /*clear brent recycle */
-    RelationCreateTmp(0,0,e_nop); /* clear tmprelation recycle */
-    return NULL;
-  }
+  ctx = CTX(ctx);
   /* check assertions */
 #ifndef NDEBUG
   if( i == NULL ) {
     FPRINTF(ASCERR, "error in RelationFindRoot: NULL instance\n");
-    glob_rel = NULL;
     return NULL;
   }
   if (able == NULL){
     FPRINTF(ASCERR,"error in RelationFindRoot: NULL able ptr\n");
-    glob_rel = NULL;
     return NULL;
   }
   if (varnum == NULL){
     FPRINTF(ASCERR,"error in RelationFindRoot: NULL varnum\n");
-    glob_rel = NULL;
     return NULL;
   }
   if( InstanceKind(i) != REL_INST ) {
     FPRINTF(ASCERR, "error in RelationFindRoot: not relation\n");
-    glob_rel = NULL;
     return NULL;
   }
 #endif
 
   *able = FALSE;
   *nsolns = -1;     /* nsolns will be -1 for a very unhappy root-finder */
-  glob_rel = NULL;
-  glob_done = 0;
-  soln_list.length = 0; /* reset len to 0. if NULL to start, append mallocs */
-  append_soln(&soln_list,0.0);
+  ctx->done = 0;
+  ctx->soln.length = 0; /* reset len to 0. if NULL to start, append mallocs */
+  append_soln(&(ctx->soln),0.0);
   rel = (struct relation *)GetInstanceRelation(i, &reltype);
   if( rel == NULL ) {
-    FPRINTF(ASCERR, "error in RelationFindRoot: NULL relation\n");
-    glob_rel = NULL; return NULL;
+    FPRINTF(ASCERR, "error in RelationFindRoot: NULL relation\n"); return NULL;
   }
   /* here we should switch and handle all types. at present we don't
    * handle anything except e_token
    */
   if( reltype != e_token ) {
     FPRINTF(ASCERR, "error in RelationFindRoot: non-token relation\n");
-    glob_rel = NULL;
     return NULL;
   }
 
   if (RelationRelop(rel) == e_equal){
-    glob_rel = RelationTmpTokenCopy(rel);
-    assert(glob_rel!=NULL);
-    glob_done = 0;
-    list = RelationVarList(glob_rel);
+    ctx->rel = RelationTmpTokenCopy(ctx,rel);
+    assert(ctx->rel!=NULL);
+    ctx->done = 0;
+    list = RelationVarList(ctx->rel);
     if( *varnum >= 1 && *varnum <= gl_length(list)){
-      glob_done = 1;
+      ctx->done = 1;
     }
-    if (!glob_done) {
+    if (!ctx->done) {
       FPRINTF(ASCERR, "error in FindRoot: var not found\n");
-      glob_rel = NULL;
       return NULL;
     }
 
-    glob_varnum = *varnum;
-    glob_done = 0;
-    assert(Infix_LhsSide(glob_rel) != NULL);
+    ctx->varnum = *varnum;
+    ctx->done = 0;
+    assert(Infix_LhsSide(ctx->rel) != NULL);
     /* In the following if statements we look for the target variable
      * to the left and right, evaluating all branches without the
      * target.
      */
-    if (SearchEval_Branch(Infix_LhsSide(glob_rel)) < 1) {
-      /* CONSOLE_DEBUG("SearchEval_Branch(Infix_LhsSide(glob_rel)) gave < 1..."); */
-      sideval = RelationBranchEvaluator(Infix_LhsSide(glob_rel));
+    if (SearchEval_Branch(ctx,Infix_LhsSide(ctx->rel)) < 1) {
+      /* CONSOLE_DEBUG("SearchEval_Branch(ctx,Infix_LhsSide(ctx->rel)) gave < 1..."); */
+      sideval = RelationBranchEvaluator(ctx->rel,Infix_LhsSide(ctx->rel));
       if (asc_finite(sideval)) {
         /* CONSOLE_DEBUG("LHS is finite"); */
-        InsertBranchResult(Infix_LhsSide(glob_rel),sideval);
+        InsertBranchResult(Infix_LhsSide(ctx->rel),sideval);
       }else{
         /* CONSOLE_DEBUG("LHS is INFINITE"); */
         FPRINTF(ASCERR,"Inequality in RelationFindRoots. Infinite RHS.\n");
-        glob_rel = NULL;
         return NULL;
       }
     }
-    assert(Infix_RhsSide(glob_rel) != NULL);
-    if (SearchEval_Branch(Infix_RhsSide(glob_rel)) < 1) {
-        /* CONSOLE_DEBUG("SearchEval_Branch(Infix_RhsSide(glob_rel)) gave < 1..."); */
-        sideval = RelationBranchEvaluator(Infix_RhsSide(glob_rel));
+    assert(Infix_RhsSide(ctx->rel) != NULL);
+    if (SearchEval_Branch(ctx,Infix_RhsSide(ctx->rel)) < 1) {
+        /* CONSOLE_DEBUG("SearchEval_Branch(ctx,Infix_RhsSide(ctx->rel)) gave < 1..."); */
+        sideval = RelationBranchEvaluator(ctx->rel,Infix_RhsSide(ctx->rel));
         if (asc_finite(sideval)) {
           /* CONSOLE_DEBUG("RHS is finite"); */
-          InsertBranchResult(Infix_RhsSide(glob_rel),sideval);
+          InsertBranchResult(Infix_RhsSide(ctx->rel),sideval);
         }else{
           /* CONSOLE_DEBUG("RHS is INFINITE"); */
           FPRINTF(ASCERR,"Inequality in RelationFindRoots. Infinite LHS.\n");
-          glob_rel = NULL;
           return NULL;
         }
     }
-    if (glob_done < 1) {
+    if (ctx->done < 1) {
       /* CONSOLE_DEBUG("RelationInvertToken never found variable"); */
       /* RelationInvertToken never found variable */
-      glob_done = 0;
+      ctx->done = 0;
       *able = FALSE;
-      return soln_list.soln;
+      return ctx->soln.soln;
     }
-    if (glob_done == 1) {
+    if (ctx->done == 1) {
       /* set to 0 so while loop in RelationInvertToken will work */
-      glob_done = 0;
+      ctx->done = 0;
       /* CONSOLE_DEBUG("Calling 'RelationInvertToken'..."); */
-      glob_done = RelationInvertTokenTop(&(soln_list));
+      ctx->done = RelationInvertTokenTop(ctx);
     }
-    if (glob_done == 1) { /* if still one, token inversions successful */
+    if (ctx->done == 1) { /* if still one, token inversions successful */
 		/* CONSOLE_DEBUG("INVERSION was successful"); */
-      glob_done = 0;
-      *nsolns= soln_list.length;
+      ctx->done = 0;
+      *nsolns= ctx->soln.length;
       *able = TRUE;
-      return soln_list.soln;
+      return ctx->soln.soln;
     }
     /* CALL ITERATIVE SOLVER */
     //CONSOLE_DEBUG("Solving iteratively...");
-    *soln_list.soln = RootFind(glob_rel,&(lower_bound),
+    ctx->soln.soln[0] = RootFind(ctx,&(lower_bound),
         		       &(upper_bound),&(nominal),
         		       &(tolerance),
-        		       glob_varnum,able);
+        		       ctx->varnum,able);
 
-    glob_done = 0;
+    ctx->done = 0;
     if(*able == 0) { /* Root-Find returns 0 for success*/
       *nsolns = 1;
       *able = TRUE;
@@ -3221,12 +3422,12 @@ double *RelationFindRoots(struct Instance *i,
       CONSOLE_DEBUG("Single-equation iterative solver was unable to find a solution.");
       *able = FALSE;
     }
-    return soln_list.soln;
+    return ctx->soln.soln;
 
   }
   ERROR_REPORTER_HERE(ASC_PROG_ERR,"Inequality: can't find roots.");
   *able = FALSE;
-  return soln_list.soln;
+  return ctx->soln.soln;
 }
 
 /*------------------------------------------------------------------------------
@@ -3246,55 +3447,56 @@ double *RelationFindRoots(struct Instance *i,
 
 	User is responsible for setting RTOKEN(return).*_len.
 
-	Basically, all this does is manage memory nicely.
-
-	IF called with all 0/NULL, frees internal recycles.
+	Basically, all this does is manage memory nicely: the relation
+	is kept in ctx and reused by the next call.
 */
-static struct relation *RelationCreateTmp(
+static struct relation *RelationCreateTmp(struct RelEvalContext *ctx,
 		unsigned long lhslen, unsigned long rhslen,
 		enum Expr_enum relop
 ){
-  static struct relation *rel=NULL;
-  static unsigned long lhscap=0, rhscap=0;
-
-  /* check for recycle clear and free things if needed. */
-  if (lhslen==0 && rhslen == 0 && relop == e_nop) {
-    if (rel != NULL) {
-      if (rel->share != NULL) {
-        if (RTOKEN(rel).lhs!=NULL) {
-          ascfree(RTOKEN(rel).lhs);
-        }
-        if (RTOKEN(rel).rhs!=NULL)  {
-          ascfree(RTOKEN(rel).rhs);
-        }
-        ascfree(rel->share);
-      }
-      ascfree(rel);
-      rel = NULL;
-    }
-    lhscap = rhscap = 0;
-    return NULL;
-  }
-  if (rel == NULL) {
-    rel = CreateRelationStructure(relop,crs_NEWUNION);
+  struct relation *rel;
+  if (ctx->tmprel == NULL) {
+    ctx->tmprel = CreateRelationStructure(relop,crs_NEWUNION);
   }
-  if (lhscap < lhslen) {
-    lhscap = lhslen;
+  rel = ctx->tmprel;
+  if (ctx->lhscap < lhslen) {
+    ctx->lhscap = lhslen;
     if ( RTOKEN(rel).lhs != NULL) {
       ascfree(RTOKEN(rel).lhs);
     }
-    RTOKEN(rel).lhs = ASC_NEW_ARRAY(union RelationTermUnion,lhscap);
+    RTOKEN(rel).lhs = ASC_NEW_ARRAY(union RelationTermUnion,ctx->lhscap);
   }
-  if (rhscap < rhslen) {
-    rhscap = rhslen;
+  if (ctx->rhscap < rhslen) {
+    ctx->rhscap = rhslen;
     if ( RTOKEN(rel).rhs != NULL) {
       ascfree(RTOKEN(rel).rhs);
     }
-    RTOKEN(rel).rhs = ASC_NEW_ARRAY(union RelationTermUnion,rhscap);
+    RTOKEN(rel).rhs = ASC_NEW_ARRAY(union RelationTermUnion,ctx->rhscap);
   }
   return rel;
 }
 
+/**
+	Free the relation kept by RelationCreateTmp.
+*/
+static void RelationDestroyTmp(struct RelEvalContext *ctx){
+  struct relation *rel = ctx->tmprel;
+  if (rel != NULL) {
+    if (rel->share != NULL) {
+      if (RTOKEN(rel).lhs!=NULL) {
+        ascfree(RTOKEN(rel).lhs);
+      }
+      if (RTOKEN(rel).rhs!=NULL)  {
+        ascfree(RTOKEN(rel).rhs);
+      }
+      ascfree(rel->share);
+    }
+    ascfree(rel);
+    ctx->tmprel = NULL;
+  }
+  ctx->lhscap = ctx->rhscap = 0;
+}
+
 /**
 	@see RelationFindRoots
 
@@ -3391,12 +3593,14 @@ static int RelationTmpCopySide(union RelationTermUnion *old,
 	@NOTE RelationTmpCopySide and RelationTmpCopyToken are reimplimentations
 	of functions from the v. old 'exprman' file.
 */
-static struct relation *RelationTmpTokenCopy(CONST struct relation *src){
+static struct relation *RelationTmpTokenCopy(struct RelEvalContext *ctx
+		, CONST struct relation *src
+){
   struct relation *result;
   long int delta;
   assert(src!=NULL);
 
-  result = RelationCreateTmp(RTOKEN(src).lhs_len,RTOKEN(src).rhs_len,
+  result = RelationCreateTmp(ctx,RTOKEN(src).lhs_len,RTOKEN(src).rhs_len,
                              RelationRelop(src));
 
   if(RelationTmpCopySide(RTOKEN(src).lhs,RTOKEN(src).lhs_len,
@@ -3486,26 +3690,28 @@ static void InsertBranchResult(struct relation_term *term, double value){
 /**
 	@see RelationFindRoots
 
-	Simplify branches of a relation (the relation pointed to by glob_rel).
+	Simplify branches of a relation (the relation ctx->rel).
 
 	Only terms of type e_real, e_int, e_zero, and e_var are left
 	hanging off the operators on the path to the
-	variable (with varnum = glob_varnum) being direct
+	variable (with varnum = ctx->varnum) being direct
 	solved for.
 
 	@TODO This may need to be changed to only leave e_reals
 	so that the inversion routine can make faster decisions???
 	Probably not.
 
-	@return >= 1 if glob_varnum spotted, else 0 (or at least <1).
+	@return >= 1 if ctx->varnum spotted, else 0 (or at least <1).
 */
-static int SearchEval_Branch(struct relation_term *term){
+static int SearchEval_Branch(struct RelEvalContext *ctx
+		, struct relation_term *term
+){
   int result = 0;
   assert(term != NULL);
   switch(RelationTermType(term)) {
   case e_var:
-    if(TermVarNumber(term) == glob_varnum) {
-        ++glob_done;
+    if(TermVarNumber(term) == ctx->varnum) {
+        ++ctx->done;
         return 1;
     }else{
         return 0;
@@ -3520,13 +3726,13 @@ static int SearchEval_Branch(struct relation_term *term){
        * constant, however complicated it may be.
        * We need to call the appropriate evaluator here
        * and return the value. We don't care if we see
-       * glob_varnum inside the hold func.
+       * ctx->varnum inside the hold func.
        */
-      InsertBranchResult(term,RelationBranchEvaluator(term));
+      InsertBranchResult(term,RelationBranchEvaluator(ctx->rel,term));
       return 0;
     }
-    if(SearchEval_Branch(TermFuncLeft(term)) < 1) {
-      InsertBranchResult(term,RelationBranchEvaluator(term));
+    if(SearchEval_Branch(ctx,TermFuncLeft(term)) < 1) {
+      InsertBranchResult(term,RelationBranchEvaluator(ctx->rel,term));
       return 0;
     }
     return 1;
@@ -3545,26 +3751,26 @@ static int SearchEval_Branch(struct relation_term *term){
   case e_divide:
   case e_power:
   case e_ipower:
-    if(SearchEval_Branch(TermBinLeft(term)) < 1) {
+    if(SearchEval_Branch(ctx,TermBinLeft(term)) < 1) {
       InsertBranchResult(TermBinLeft(term),
-                         RelationBranchEvaluator(TermBinLeft(term)));
+                         RelationBranchEvaluator(ctx->rel,TermBinLeft(term)));
     }else{
         ++result;
     }
-    if(SearchEval_Branch(TermBinRight(term)) < 1) {
+    if(SearchEval_Branch(ctx,TermBinRight(term)) < 1) {
       InsertBranchResult(TermBinRight(term),
-                         RelationBranchEvaluator(TermBinRight(term)));
+                         RelationBranchEvaluator(ctx->rel,TermBinRight(term)));
     }else{
         ++result;
     }
     if(result == 0){
-        InsertBranchResult(term,RelationBranchEvaluator(term));
+        InsertBranchResult(term,RelationBranchEvaluator(ctx->rel,term));
     }
     return result;
 
  case e_uminus:
-    if(SearchEval_Branch(TermBinLeft(term)) < 1) {
-      InsertBranchResult(term,RelationBranchEvaluator(term));
+    if(SearchEval_Branch(ctx,TermBinLeft(term)) < 1) {
+      InsertBranchResult(term,RelationBranchEvaluator(ctx->rel,term));
         return 0;
     }
     return 1;
@@ -3584,7 +3790,8 @@ static int SearchEval_Branch(struct relation_term *term){
 	@NOTE This function assumes SearchEval_Branch has been called
 	previously.
 */
-static int SetUpInvertToken(struct relation_term *term,
+static int SetUpInvertToken(struct RelEvalContext *ctx,
+		struct relation_term *term,
 		struct relation_term **invert_side,
 		double *value
 ){
@@ -3596,20 +3803,20 @@ static int SetUpInvertToken(struct relation_term *term,
       *invert_side = TermFuncLeft(term);
       return 0;
   case e_var:
-      assert(TermVarNumber(term)==glob_varnum);
+      assert(TermVarNumber(term)==ctx->varnum);
       *invert_side = term;
-      return 0; /*could set glob_done here??*/
+      return 0; /*could set ctx->done here??*/
   default:
       switch(RelationTermType(TermBinRight(term))) {
       case e_real:/*Note: only e_real should be found here:no ints or zeros*/
       case e_int:
       case e_zero:
-          *value = RelationBranchEvaluator(TermBinRight(term));
+          *value = RelationBranchEvaluator(ctx->rel,TermBinRight(term));
           *invert_side = TermBinLeft(term);
           return 0;
       case e_var:
-          if (TermVarNumber(TermBinRight(term)) != glob_varnum) {
-              *value = RelationBranchEvaluator(TermBinRight(term));
+          if (TermVarNumber(TermBinRight(term)) != ctx->varnum) {
+              *value = RelationBranchEvaluator(ctx->rel,TermBinRight(term));
               *invert_side = TermBinLeft(term);
               return 0;
           }
@@ -3617,7 +3824,7 @@ static int SetUpInvertToken(struct relation_term *term,
       default:
           break;
       }
-      *value = RelationBranchEvaluator(TermBinLeft(term));
+      *value = RelationBranchEvaluator(ctx->rel,TermBinLeft(term));
       *invert_side = TermBinRight(term);
       return 1;
   }
@@ -3626,29 +3833,29 @@ static int SetUpInvertToken(struct relation_term *term,
 /**
 	@see RelationFindRoots
 */
-static void SetUpInvertTokenTop(
+static void SetUpInvertTokenTop(struct RelEvalContext *ctx,
 		struct relation_term **invert_side,
 		double *value
 ){
-  switch(RelationTermType(Infix_RhsSide(glob_rel))) {
+  switch(RelationTermType(Infix_RhsSide(ctx->rel))) {
   case e_real:
   case e_int:
   case e_zero:
-      *value = RelationBranchEvaluator(Infix_RhsSide(glob_rel));
-      *invert_side = Infix_LhsSide(glob_rel);
+      *value = RelationBranchEvaluator(ctx->rel,Infix_RhsSide(ctx->rel));
+      *invert_side = Infix_LhsSide(ctx->rel);
       return;
   case e_var:
-      if (TermVarNumber(Infix_RhsSide(glob_rel)) != glob_varnum) {
-          *value = RelationBranchEvaluator(Infix_RhsSide(glob_rel));
-          *invert_side = Infix_LhsSide(glob_rel);
+      if (TermVarNumber(Infix_RhsSide(ctx->rel)) != ctx->varnum) {
+          *value = RelationBranchEvaluator(ctx->rel,Infix_RhsSide(ctx->rel));
+          *invert_side = Infix_LhsSide(ctx->rel);
           return;
       }
       break;
   default:
       break;
   }
-  *value = RelationBranchEvaluator(Infix_LhsSide(glob_rel));
-  *invert_side = Infix_RhsSide(glob_rel);
+  *value = RelationBranchEvaluator(ctx->rel,Infix_LhsSide(ctx->rel));
+  *invert_side = Infix_RhsSide(ctx->rel);
   return;
 }
 
@@ -3661,7 +3868,7 @@ static void SetUpInvertTokenTop(
 	variable only resides at ONE leaf of the relation tree.
 	It is the calling function's responsibility to make sure
 	this is the case and call another solver if needed.
-	If the variable (with varnum = glob_varnum) is found,
+	If the variable (with varnum = ctx->varnum) is found,
 	the solution list will contain all solutions to the
 	equations.  It is the calling function's responsibility
 	to select the root that suits his needs.
@@ -3670,15 +3877,16 @@ static void SetUpInvertTokenTop(
 	@NOTE Note that there appears to be some redundant checking here and
 	we could probably be more efficient
 */
-int RelationInvertToken(struct relation_term **term,
-        		struct ds_soln_list *soln_list,
+static int RelationInvertToken(struct RelEvalContext *ctx,
+        		struct relation_term **term,
         		enum safe_err *not_safe
 ){
+  struct ds_soln_list *soln_list = &(ctx->soln);
   int side,ndx;
   double value = 0.0;
   struct relation_term *invert_side;
   assert(term!=NULL);
-  side = SetUpInvertToken(*term,&(invert_side),&value);
+  side = SetUpInvertToken(ctx,*term,&(invert_side),&value);
   for( ndx = soln_list->length ; --ndx >= 0 ; ) {
     switch(RelationTermType(*term)) {
     case e_plus:
@@ -3961,7 +4169,7 @@ int RelationInvertToken(struct relation_term **term,
       ASC_PANIC("Unexpected error with real/zero/int type");
       break;
     case e_var:
-      ++glob_done;
+      ++ctx->done;
       return(TRUE);  /*solution found*/
 
       /* don't know how to deal with the following relation operators.
@@ -3988,19 +4196,20 @@ int RelationInvertToken(struct relation_term **term,
 	calls RelationInvertToken.  See RelationInvertToken for
 	information on what this function does.
 */
-int RelationInvertTokenTop(struct ds_soln_list *soln_list){
+static int RelationInvertTokenTop(struct RelEvalContext *ctx){
+  struct ds_soln_list *soln_list = &(ctx->soln);
   int result;
   struct relation_term *invert_side;
   enum safe_err not_safe = safe_ok;
 
-  assert(glob_rel!=NULL);
-  assert(Infix_LhsSide(glob_rel)!=NULL && Infix_RhsSide(glob_rel)!=NULL);
+  assert(ctx->rel!=NULL);
+  assert(Infix_LhsSide(ctx->rel)!=NULL && Infix_RhsSide(ctx->rel)!=NULL);
 
 
-  SetUpInvertTokenTop(&(invert_side),&(soln_list->soln[0]));
+  SetUpInvertTokenTop(ctx,&(invert_side),&(soln_list->soln[0]));
   result = 1;
-  while(glob_done < 1 && result != 0) {
-    result = RelationInvertToken(&(invert_side),soln_list,&not_safe);
+  while(ctx->done < 1 && result != 0) {
+    result = RelationInvertToken(ctx,&(invert_side),&not_safe);
   }
   return result;
 }
@@ -4014,33 +4223,33 @@ int RelationInvertTokenTop(struct ds_soln_list *soln_list){
 	Set the value of the variable being solved
 	for (given the varnum) and calculate the residual.
 
-	@NOTE glob_rel is ASSUMED to be of type e_token. ---
+	@NOTE ctx->rel is ASSUMED to be of type e_token. ---
 
-	@NOTE uses the glob_rel which should have been set in
+	@NOTE uses the ctx->rel which should have been set in
 	RelationFindRoots (and reduced by SearchEval_Branch).  This
 	functions takes an excessive number of arguments so it will
-	look like an ExtEvalFunc to our root-finder.
+	look like an ExtEvalFunc to our root-finder. The context
+	comes in disguised as u, which is otherwise unused.
 */
 static
 int CalcResidGivenValue(int *mode, int *m, int *varnum,
 		double *val, double *u, double *f, double *g
 ){
+  struct RelEvalContext *ctx = (struct RelEvalContext *)u;
   double res;
-  /*  glob_rel = rel;*/
   /*
-   *  glob_rel is ASSUMED to be of type e_token.
+   *  ctx->rel is ASSUMED to be of type e_token.
    */
 
   UNUSED_PARAMETER(mode);
-  UNUSED_PARAMETER(u);
   UNUSED_PARAMETER(g);
 
   SetRealAtomValue(
-      ((struct Instance *)gl_fetch(RelationVarList(glob_rel),*varnum)),
+      ((struct Instance *)gl_fetch(RelationVarList(ctx->rel),*varnum)),
       val[*varnum],
       0
   );
-  if (RelationRelop(glob_rel) != e_equal) {
+  if (RelationRelop(ctx->rel) != e_equal) {
     FPRINTF(ASCERR,"CalcResidGivenValue called with non-equality");
     return 1;
   }
@@ -4048,13 +4257,13 @@ int CalcResidGivenValue(int *mode, int *m, int *varnum,
   * may need to set inst ptr.
   */
 
-  if(Infix_LhsSide(glob_rel) != NULL) {
-    res = RelationBranchEvaluator(Infix_LhsSide(glob_rel));
+  if(Infix_LhsSide(ctx->rel) != NULL) {
+    res = RelationBranchEvaluator(ctx->rel,Infix_LhsSide(ctx->rel));
   }else{
     res = 0.0;
   }
-  if(Infix_RhsSide(glob_rel) != NULL) {
-    res -= RelationBranchEvaluator(Infix_RhsSide(glob_rel));
+  if(Infix_RhsSide(ctx->rel) != NULL) {
+    res -= RelationBranchEvaluator(ctx->rel,Infix_RhsSide(ctx->rel));
   }
   f[*m] = res;
   return 0;
@@ -4062,43 +4271,35 @@ int CalcResidGivenValue(int *mode, int *m, int *varnum,
 
 /**
 	RootFind is a distributor to a root-finding method zbrent.
-	at present, the root-find can only handle token relations.
-	if varnum is 0 and status is NULL, frees the internal
-	memory recycle and returns. Currently this is slaved
-	to RelationFindRoots internal reset.
-	This function is not threadsafe.
+	at present, the root-find can only handle token relations,
+	and only ctx->rel as set up by RelationFindRoots.
 */
 static
-double RootFind(struct relation *rel,
+double RootFind(struct RelEvalContext *ctx,
 		double *lower_bound, double *upper_bound,
 		double *nominal,
 		double *tolerance,
 		int varnum,
 		int *status
 ){
-  double *f = NULL;	/* vector of residuals, borrowed from tmpalloc */
+  double *f = NULL;	/* vector of residuals, from the ctx stack */
   ExtEvalFunc *func;
   int mode;             /* to pass to the eval func */
   int m = 0;            /* the relation index */ /*a dummy var*/
   int n;                /* the variable index */
   double *x;            /* the x vector -- needed by eval func */
-  double *u = NULL;     /* the u vector -- needed by eval func, in which
-                         * case it is in trouble,eh?
-                         */
+  double *u;            /* the u vector: carries ctx to the eval func */
   double *g;            /* vector of gradients. part of f malloc */
   int j,fcap;
   struct Instance *var;
   CONST struct gl_list_t *vlist;
 
   (void)nominal;        /* stop gcc whine about unused parameter */
-  if (status==NULL && varnum == 0) {
-    return 0.0;
-  }
 
-  vlist = RelationVarList(glob_rel);
+  vlist = RelationVarList(ctx->rel);
   n = (int)gl_length(vlist);
   fcap = 2 * n + 1;
-  f = tmpalloc_array(fcap,double);
+  f = ctx_stack_array(ctx,fcap,double);
   for (j=0;j < fcap; j++) {
     f[j] = 0.0;
   }
@@ -4116,7 +4317,7 @@ double RootFind(struct relation *rel,
    * Get the evaluation function.
    */
   func = (ExtEvalFunc *)CalcResidGivenValue;
-  glob_rel = rel;
+  u = (double *)ctx;
 
   return zbrent(
 	func,lower_bound,upper_bound,&(mode),
@@ -4230,7 +4431,7 @@ void PrintDirectResult(struct Instance *i){
                status = -1;
                varnum = num;
                soln_list = RelationFindRoots(i,-100,100,1,tolerance,&(varnum),
-        				     &(status),&(nsoln));
+        				     &(status),&(nsoln),NULL);
                for(n = nsoln;n > 0;--n) {
         	   FPRINTF(stderr,"SOLUTION = %g\n",soln_list[n-1]);
                }
@@ -4242,7 +4443,7 @@ void PrintDirectResult(struct Instance *i){
 void PrintDirectSolveSolutions(struct Instance *i){
   VisitInstanceTree(i,PrintDirectResult, 0, 0);
   /* reset internal memory recycle */
-  RelationFindRoots(NULL,0,0,0,0,NULL,NULL,NULL);
+  RelEvalContextThreadDestroy();
 }
 
 struct ctrwubs {
@@ -440,6 +440,7 @@ extern char *tmpalloc(int nbytes);
 	not be freed, but the next call to this function will reuse the
 	previous allocation. Memory returned will NOT be zeroed.
 	Calling with nbytes==0 will free any memory allocated.
+	Not thread safe; relation evaluation uses RelEvalContextStack instead.
 */
 
 #define tmpalloc_array(nelts,type)  ((type *)tmpalloc((nelts)*sizeof(type)))
@@ -447,6 +448,64 @@ extern char *tmpalloc(int nbytes);
 	Creates an array of "nelts" objects, each with type "type".
 */
 
+/*------------------------------------------------------------------------------
+	EVALUATION CONTEXT
+
+	The evaluation routines below keep their scratch space (stacks for
+	postfix and reverse AD sweeps, the copy of a relation being inverted,
+	the roots found) in a struct RelEvalContext rather than in static
+	data, so that different threads may evaluate relations at the same
+	time as long as each uses its own context. Each routine takes the
+	context as its last argument; passing NULL there means the context
+	of the calling thread, created on first use.
+
+	Blackbox and glassbox relations call out to user code, which is
+	not made thread safe by this.
+*/
+
+struct RelEvalContext;
+
+ASC_DLLSPEC struct RelEvalContext *RelEvalContextCreate(void);
+/**<
+	Create an empty evaluation context. Buffers are allocated as
+	evaluations need them.
+*/
+
+ASC_DLLSPEC void RelEvalContextDestroy(struct RelEvalContext *ctx);
+/**<
+	Free ctx and everything in it, including the roots last returned
+	by RelationFindRoots with ctx. ctx may be NULL.
+*/
+
+ASC_DLLSPEC struct RelEvalContext *RelEvalContextThread(void);
+/**<
+	@return the calling thread's own context, which is what a NULL
+	context argument stands for.
+*/
+
+ASC_DLLSPEC void RelEvalContextThreadDestroy(void);
+/**<
+	Free the calling thread's context, if it has one. Threads that
+	evaluate relations should call this (directly or through
+	relman_free_reused_mem) before they exit.
+*/
+
+ASC_DLLSPEC void *RelEvalContextStack(struct RelEvalContext *ctx
+		, unsigned long nbytes);
+/**<
+	@return at least nbytes of scratch memory owned by ctx. The memory
+	is reused by the next call, and by every evaluation routine given
+	ctx, so it is only good until then. It is not zeroed.
+*/
+
+ASC_DLLSPEC double *RelEvalContextWork(struct RelEvalContext *ctx
+		, unsigned long n);
+/**<
+	@return room for n doubles owned by ctx, reused by the next call.
+	The evaluation routines never touch this buffer, so a caller may
+	keep for example a gradient in it while evaluating with ctx.
+*/
+
 /*------------------------------------------------------------------------------
 	RELATION EVALUATION STUFF
 
@@ -456,7 +515,8 @@ extern char *tmpalloc(int nbytes);
  *   very ugly. -- BAA 5/96
  */
 
-int RelationCalcResidualBinary(CONST struct relation *rel, double *res);
+int RelationCalcResidualBinary(CONST struct relation *rel, double *res
+		, struct RelEvalContext *ctx);
 /**<
  * Returns 0 if it calculates a valid residual, 1 if
  * for any reason it cannot. Reasons include:
@@ -468,8 +528,45 @@ int RelationCalcResidualBinary(CONST struct relation *rel, double *res);
  * This function may raise SIGFPE it calls external code.
  */
 
+int RelationCalcResidGradBinary(CONST struct relation *rel
+		, double *res, double *grad, struct RelEvalContext *ctx);
+/**<
+	Gradient counterpart of RelationCalcResidualBinary, for binary token
+	tables that provide gradient code (BT_JIT). grad must have room for
+	NumberVariables(rel) doubles.
+
+	@return 0 if residual and gradient were calculated and are finite,
+	1 otherwise, in which case *res is unchanged and grad is undefined.
+*/
+
+int RelationCalcResidualOpCode(CONST struct relation *rel, double *res
+		, struct RelEvalContext *ctx);
+/**<
+	Evaluate the residual of a token relation using the register
+	bytecode of its share (compiled on first use, @see rel_opcode.h).
+
+	@return 0 if it calculates a finite residual, 1 if for any reason it
+	cannot (not compilable, NaN/infinity result, out of memory). If the
+	return is 1, *res will not have been changed. No floating point
+	trapping is done; callers wanting error reporting should fall back
+	to RelationCalcResidualPostfixSafe or similar on failure.
+*/
+
+int RelationCalcResidGradOpCode(CONST struct relation *rel
+		, double *res, double *grad, struct RelEvalContext *ctx);
+/**<
+	Evaluate residual and gradient of a token relation with one forward
+	and one reverse sweep over the register bytecode of its share.
+	grad must have room for NumberVariables(rel) doubles and is
+	indexed from 0 in varlist order.
+
+	@return 0 if residual and gradient are all finite, 1 otherwise, in
+	which case *res and grad contents are undefined.
+*/
+
 enum safe_err
-RelationCalcResidualPostfixSafe(struct Instance *i, double *res);
+RelationCalcResidualPostfixSafe(struct Instance *i, double *res
+		, struct RelEvalContext *ctx);
 /**<
 	Sets *res to the value (leftside - rightside) of the relation.
 	This function is slower than RelationCalcResidual() because it does
@@ -478,7 +575,8 @@ RelationCalcResidualPostfixSafe(struct Instance *i, double *res);
 	@return 0 on success, non-zero in there was a problem.
 */
 
-int RelationCalcResidualPostfix(struct Instance *i, double *res);
+int RelationCalcResidualPostfix(struct Instance *i, double *res
+		, struct RelEvalContext *ctx);
 /**<
  *  Sets *res to the value (leftside - rightside) of the relation.
  *  Uses postfix evaluation.
@@ -504,7 +602,8 @@ int RelationCalcResidualPostfix(struct Instance *i, double *res);
 #define RCE_ERR_LHSNAN  0x40  /**< left side returns NaN */
 #define RCE_ERR_RHSNAN  0x80  /**< right side returns NaN */
 
-ASC_DLLSPEC int RelationCalcExceptionsInfix(struct Instance *i);
+ASC_DLLSPEC int RelationCalcExceptionsInfix(struct Instance *i
+		, struct RelEvalContext *ctx);
 /**<
  *  Uses infix evaluation to check gradient and residual
  *  floating point exceptions.
@@ -523,7 +622,8 @@ ASC_DLLSPEC int RelationCalcExceptionsInfix(struct Instance *i);
  *      required is messy. We need to rearrange CalcResidGrad().
  */
 
-int RelationCalcResidualInfix(struct Instance *i, double *res);
+int RelationCalcResidualInfix(struct Instance *i, double *res
+		, struct RelEvalContext *ctx);
 /**<
  *  Sets *res to the value (leftside - rightside) of the relation.
  *  Uses infix evaluation.
@@ -532,10 +632,11 @@ int RelationCalcResidualInfix(struct Instance *i, double *res);
  *         exceptions and should not be used during compilation.
  */
 
-#define RelationCalcResidual(i,r) RelationCalcResidualPostfix(i,r)
-#define RelationCalcResidualSafe(i,r) RelationCalcResidualPostfixSafe(i,r)
+#define RelationCalcResidual(i,r,c) RelationCalcResidualPostfix(i,r,c)
+#define RelationCalcResidualSafe(i,r,c) RelationCalcResidualPostfixSafe(i,r,c)
 
-int RelationCalcGradient(struct Instance *i, double *grad);
+int RelationCalcGradient(struct Instance *i, double *grad
+		, struct RelEvalContext *ctx);
 /**<
 	This calculates the gradient of the relation df/dx (f = lhs-rhs)
 	where x is ALL entries in the relation's var list.
@@ -551,7 +652,8 @@ int RelationCalcGradient(struct Instance *i, double *grad);
     exceptions and should not be used during compilation.
 */
 
-enum safe_err RelationCalcGradientSafe(struct Instance *i, double *grad);
+enum safe_err RelationCalcGradientSafe(struct Instance *i, double *grad
+		, struct RelEvalContext *ctx);
 /**<
 	This calculates the gradient of the relation df/dx (f = lhs-rhs)
 	where x is ALL entries in the relation's var list.
@@ -561,7 +663,8 @@ enum safe_err RelationCalcGradientSafe(struct Instance *i, double *grad);
 	@return 0 on success; non-zero on error
 */
 
-ASC_DLLSPEC int RelationCalcResidGrad(struct Instance *i, double *res, double *grad);
+ASC_DLLSPEC int RelationCalcResidGrad(struct Instance *i, double *res, double *grad
+		, struct RelEvalContext *ctx);
 /**<
 	This function combines the Residual and Gradient calls, since these
 	may be done together at basically the cost of just one.
@@ -573,14 +676,16 @@ ASC_DLLSPEC int RelationCalcResidGrad(struct Instance *i, double *res, double *g
 
 
 ASC_DLLSPEC enum safe_err
-RelationCalcResidGradSafe(struct Instance *i, double *res, double *grad);
+RelationCalcResidGradSafe(struct Instance *i, double *res, double *grad
+		, struct RelEvalContext *ctx);
 /**<
 	This is the combined Safe version.
 	@return 0 on success; non-zero on error
 */
 
 /**----------------- Reverse Automatic Differentiation Routines ------------*/
-int	RelationCalcGradientRev(struct Instance *r, double *grad);
+int	RelationCalcGradientRev(struct Instance *r, double *grad
+		, struct RelEvalContext *ctx);
 /**<
 	This calculates the gradient of the relation df/dx (f = lhs-rhs)
 	where x is ALL entries in the relation's var list.
@@ -599,7 +704,8 @@ int	RelationCalcGradientRev(struct Instance *r, double *grad);
 
  */
 		
-enum safe_err RelationCalcGradientRevSafe(struct Instance *r, double *grad);
+enum safe_err RelationCalcGradientRevSafe(struct Instance *r, double *grad
+		, struct RelEvalContext *ctx);
 /**<
 	This calculates the gradient of the relation df/dx (f = lhs-rhs)
 	where x is ALL entries in the relation's var list.
@@ -611,7 +717,8 @@ enum safe_err RelationCalcGradientRevSafe(struct Instance *r, double *grad);
 	Reverse Automatic Differentiation Version
  */
 
-ASC_DLLSPEC int RelationCalcResidGradRev(struct Instance *i, double *residual, double *gradient);
+ASC_DLLSPEC int RelationCalcResidGradRev(struct Instance *i, double *residual, double *gradient
+		, struct RelEvalContext *ctx);
 /**<
 	This function combines the Residual and Gradient calls, since these
 	may be done together at basically the cost of just one.
@@ -626,7 +733,8 @@ ASC_DLLSPEC int RelationCalcResidGradRev(struct Instance *i, double *residual, d
  */
 
 ASC_DLLSPEC enum safe_err 
-		RelationCalcResidGradRevSafe(struct Instance *i,double *residual,double *gradient);
+		RelationCalcResidGradRevSafe(struct Instance *i,double *residual,double *gradient
+		, struct RelEvalContext *ctx);
 /**<
 	This is the combined Safe version.
 	@return 0 on success; non-zero on error
@@ -636,7 +744,8 @@ ASC_DLLSPEC enum safe_err
 
 /**-------------------Second Derivative Routines-----------------------------------------*/
 
-ASC_DLLSPEC int RelationCalcSecondDeriv(struct Instance *i, double *deriv2nd, unsigned long var_index);
+ASC_DLLSPEC int RelationCalcSecondDeriv(struct Instance *i, double *deriv2nd, unsigned long var_index
+		, struct RelEvalContext *ctx);
 /**<
 	This function calculates the second derivatives wrt variable var_index (the var_index row of a hessian)
 	@param i is the relation instance whose second derivative is to be calculated
@@ -645,7 +754,8 @@ ASC_DLLSPEC int RelationCalcSecondDeriv(struct Instance *i, double *deriv2nd, un
 	@return not significant yet
 */
 
-ASC_DLLSPEC enum safe_err RelationCalcSecondDerivSafe(struct Instance *i, double *deriv2nd,unsigned long var_index);
+ASC_DLLSPEC enum safe_err RelationCalcSecondDerivSafe(struct Instance *i, double *deriv2nd,unsigned long var_index
+		, struct RelEvalContext *ctx);
 /**<
 	This function calculates the second derivatives wrt variable var_index (the var_index row of a hessian)
 	@param i is the relation instance whose second derivative is to be calculated
@@ -657,7 +767,8 @@ ASC_DLLSPEC enum safe_err RelationCalcSecondDerivSafe(struct Instance *i, double
  */
 
 /** -----------------Hessian Calculation Routines----------------------------------------*/
-ASC_DLLSPEC int RelationCalcHessianMtx(struct Instance *i, hessian_mtx *hess_mtx, unsigned long dimension);
+ASC_DLLSPEC int RelationCalcHessianMtx(struct Instance *i, hessian_mtx *hess_mtx, unsigned long dimension
+		, struct RelEvalContext *ctx);
 /**<
 	This function calculates the full, dense hessian matrix of the relation pointed to by instance pointer i
 	@param i is the relation whose Hessian matrix is calculated
@@ -666,7 +777,8 @@ ASC_DLLSPEC int RelationCalcHessianMtx(struct Instance *i, hessian_mtx *hess_mtx
 	@return not significant yet
  */
 
-ASC_DLLSPEC enum safe_err RelationCalcHessianMtxSafe(struct Instance *i, hessian_mtx *hess_mtx,unsigned long dimension);
+ASC_DLLSPEC enum safe_err RelationCalcHessianMtxSafe(struct Instance *i, hessian_mtx *hess_mtx,unsigned long dimension
+		, struct RelEvalContext *ctx);
 /**<
 	This function calculates the full, dense hessian matrix of the relation pointed to by instance pointer i
 	@param i is the relation whose Hessian matrix is calculated
@@ -686,7 +798,8 @@ double *RelationFindRoots(struct Instance *i,
         double nominal, double tolerance,
         int *varnum,
         int *able,
-        int *nsolns);
+        int *nsolns,
+        struct RelEvalContext *ctx);
 /**<
 	RelationFindRoot WILL find a root if there is one. It is in charge of
 	trying every trick in the book. The user must pass in a pointer to a
@@ -706,16 +819,8 @@ double *RelationFindRoots(struct Instance *i,
 
 	@TODO (we really should make a system wide convention for return values)
 
-	@NOTE The calling function should NOT free the soln_list.
-
-	@NOTE we should recycle the memory used for glob_rel
-
-	@NOTE This function is NOT thread safe because it uses an internal memory
-	recycle.
-
-	@NOTE Before shutting down the system, or as desired, call this as:
-	(void) RelationFindRoots(NULL,0,0,0,0,NULL,NULL,NULL);
-	in order to free this memory.
+	@NOTE The calling function should NOT free the soln_list. It belongs
+	to ctx and is good until the next call with the same context.
 
 	@TODO I think that this function might not really be used, or might only
 	be used by old solvers. Is that the case? -- JP
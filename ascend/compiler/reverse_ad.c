@@ -101,7 +101,8 @@ static int TapeFree(Element* head);
 ASC_DLLSPEC Element* RelationEvaluateResidualGradientRev(CONST struct relation *r
 		,double *residual
 		,double *gradient
-		,int second_deriv)
+		,int second_deriv
+		,struct RelEvalContext *ctx)
 {
 	unsigned long t;       /* the current term in the relation r */
 	unsigned long num_var; /* the number of variables in the relation r */
@@ -151,7 +152,7 @@ ASC_DLLSPEC Element* RelationEvaluateResidualGradientRev(CONST struct relation *
 
 
 	/* create the stacks */
-	stacks = ASC_NEW_ARRAY(Redouble,stack_height);  
+	stacks = (Redouble *)RelEvalContextStack(ctx,stack_height*sizeof(Redouble));
 	if( stacks == NULL ) return NULL; //FIXME What to do on error?
 
 	lhs = 1;
@@ -333,8 +334,7 @@ ASC_DLLSPEC Element* RelationEvaluateResidualGradientRev(CONST struct relation *
 
 	ReturnSweep(TapeList_get_active_tape(&tapes),length_lhs && length_rhs);
 
-	if(stacks)
-		ASC_FREE(stacks);	
+	/* stacks belong to ctx */
 	
 	if(!second_deriv && gradient!=NULL){
 		AccumulateAdjoints(TapeList_get_active_tape(&tapes),gradient);
@@ -360,7 +360,8 @@ ASC_DLLSPEC Element* RelationEvaluateResidualGradientRevSafe(CONST struct relati
 		double *residual,
 		double *gradient,
   		int second_deriv,
-		enum safe_err *serr)
+		enum safe_err *serr,
+		struct RelEvalContext *ctx)
 {
 	unsigned long t;       /* the current term in the relation r */
 	unsigned long num_var; /* the number of variables in the relation r */
@@ -410,7 +411,7 @@ ASC_DLLSPEC Element* RelationEvaluateResidualGradientRevSafe(CONST struct relati
 
 
 	/* create the stacks */
-	stacks = ASC_NEW_ARRAY(Redouble,stack_height); 
+	stacks = (Redouble *)RelEvalContextStack(ctx,stack_height*sizeof(Redouble));
 	if( stacks == NULL ) return NULL;	//FIXME What to do on error?
 
 	lhs = 1;
@@ -592,8 +593,7 @@ ASC_DLLSPEC Element* RelationEvaluateResidualGradientRevSafe(CONST struct relati
 
 	ReturnSweepSafe(TapeList_get_active_tape(&tapes),length_lhs && length_rhs,serr);
 
-	if(stacks)
-		ASC_FREE(stacks);
+	/* stacks belong to ctx */
 	
 	if(!second_deriv && gradient!=NULL){	
 		AccumulateAdjointsSafe(TapeList_get_active_tape(&tapes),gradient,serr);
@@ -977,7 +977,8 @@ int RelationEvaluateSecondDeriv(CONST struct relation *r,
 								double *deriv2nd,
 								unsigned long var_index,
   								int hessian_calc,
-  								Element* tape)
+  								Element* tape,
+								struct RelEvalContext *ctx)
 {
 	unsigned long num_var; /* the number of variables in the relation r */
 	unsigned long i;
@@ -991,7 +992,8 @@ int RelationEvaluateSecondDeriv(CONST struct relation *r,
 		grad_tape = RelationEvaluateResidualGradientRev(r
 														,&residual
 														,NULL
-														,1);
+														,1
+														,ctx);
 		
 //		CONSOLE_DEBUG("Printing the Contents of the Tape after evaluation of Gradients, Row Index : %lu",var_index);
 	
@@ -1112,7 +1114,8 @@ int RelationEvaluateSecondDerivSafe(CONST struct relation *r,
 									unsigned long var_index,
   									int hessian_calc,
   									Element* tape,
-								    enum safe_err *serr)
+								    enum safe_err *serr,
+									struct RelEvalContext *ctx)
 {
 	unsigned long num_var; /* the number of variables in the relation r */
 	unsigned long i;
@@ -1127,7 +1130,8 @@ int RelationEvaluateSecondDerivSafe(CONST struct relation *r,
 															,&residual
 															,NULL
 															,1
-														   	,serr);
+														   	,serr
+															,ctx);
 		safe_error_to_stderr(serr);
 	
 //		CONSOLE_DEBUG("Printing the Contents of the Tape after evaluation of Gradients, Row Index : %lu",var_index);
@@ -1581,7 +1585,8 @@ static int AccumulateDeriv2ndSafe(Element *trace,double *deriv2nd,unsigned long
 
 int RelationEvaluateHessianMtx(CONST struct relation *r,
 							   	hessian_mtx *hess_mtx,
-		  						unsigned long dimension)
+		  						unsigned long dimension,
+								struct RelEvalContext *ctx)
 {
 	Element* hess_tape;
 //	Element* temp_tape;
@@ -1595,7 +1600,7 @@ int RelationEvaluateHessianMtx(CONST struct relation *r,
 		ERROR_REPORTER_HERE(ASC_PROG_FATAL,"Relation instance is NULL");
 	}
 	
-	hess_tape = RelationEvaluateResidualGradientRev(r,&residual,NULL,1);
+	hess_tape = RelationEvaluateResidualGradientRev(r,&residual,NULL,1,ctx);
 	
 	for(i=0;i<dimension;i++){
 		/** TODO When the Matrix is full or Upper triagnfular,
@@ -1604,7 +1609,7 @@ int RelationEvaluateHessianMtx(CONST struct relation *r,
 			AccumulateDeriv2nd	
 		*/
 		row_pointer = Hessian_Mtx_get_row_pointer(hess_mtx,i);
-		RelationEvaluateSecondDeriv(r,row_pointer,i,1,hess_tape); //FIXME works currently only for LT. Refer TODO above
+		RelationEvaluateSecondDeriv(r,row_pointer,i,1,hess_tape,ctx); //FIXME works currently only for LT. Refer TODO above
 	}
 	
 // 	while(hess_tape!=NULL){
@@ -1621,7 +1626,8 @@ int RelationEvaluateHessianMtx(CONST struct relation *r,
 int RelationEvaluateHessianMtxSafe(CONST struct relation *r,
 								   	hessian_mtx *hess_mtx,
 		   							unsigned long dimension,
-	 								enum safe_err *serr)
+	 								enum safe_err *serr,
+									struct RelEvalContext *ctx)
 {
 	Element* hess_tape;
 //	Element* temp_tape;
@@ -1635,7 +1641,7 @@ int RelationEvaluateHessianMtxSafe(CONST struct relation *r,
 		ERROR_REPORTER_HERE(ASC_PROG_FATAL,"Relation instance is NULL");
 	}
 	
-	hess_tape = RelationEvaluateResidualGradientRevSafe(r,&residual,NULL,1,serr);
+	hess_tape = RelationEvaluateResidualGradientRevSafe(r,&residual,NULL,1,serr,ctx);
 	
 	
 
@@ -1646,7 +1652,7 @@ int RelationEvaluateHessianMtxSafe(CONST struct relation *r,
 			AccumulateDeriv2nd	
 		*/
 		row_pointer = Hessian_Mtx_get_row_pointer(hess_mtx,i);
-		RelationEvaluateSecondDerivSafe(r,row_pointer,i,1,hess_tape,serr); //FIXME works currently only for LT. Refer TODO above
+		RelationEvaluateSecondDerivSafe(r,row_pointer,i,1,hess_tape,serr,ctx); //FIXME works currently only for LT. Refer TODO above
 	}
 	
 // 	while(hess_tape!=NULL){
@@ -48,6 +48,8 @@
 
 #define MAX_TAPE_COUNT 1
 
+struct RelEvalContext; /* see relation_util.h */
+
 
 /* ---- Temporarily Needed Structure ---*/
 
@@ -123,12 +125,16 @@ typedef struct TapeList_struct{
 	@NOTE This function is a possible source of floating point exceptions
 	and should not be used during compilation.
 
+	The evaluation stacks are taken from ctx, which may be NULL for the
+	calling thread's context; likewise for the routines below.
+
 	@return FIXME
 */
 ASC_DLLSPEC Element* RelationEvaluateResidualGradientRev(CONST struct relation *r,
 		double *residual,
 		double *gradient,
-  		int second_deriv
+  		int second_deriv,
+		struct RelEvalContext *ctx
 );
 
 /** 
@@ -141,7 +147,8 @@ ASC_DLLSPEC Element* RelationEvaluateResidualGradientRevSafe(CONST struct relati
 		double *residual,
 		double *gradient,
   		int second_deriv,
-		enum safe_err *serr);
+		enum safe_err *serr,
+		struct RelEvalContext *ctx);
 		
 /**------------- Second Derivative Calculations-------------*/
 
@@ -162,7 +169,8 @@ ASC_DLLSPEC int RelationEvaluateSecondDeriv(CONST struct relation *r,
 											double *deriv2nd,
 		   									unsigned long var_index,
 		   									int hessian_calc,
-											Element* tape);
+											Element* tape,
+											struct RelEvalContext *ctx);
 
 
 /**<
@@ -182,7 +190,8 @@ ASC_DLLSPEC int RelationEvaluateSecondDerivSafe(CONST struct relation *r,
 												unsigned long var_index,
 												int hessian_calc,
 												Element* tape,
-  												enum safe_err *serr);
+  												enum safe_err *serr,
+												struct RelEvalContext *ctx);
   												
 
 /**---------------Hessians Evaluations --------------------*/
@@ -195,7 +204,8 @@ ASC_DLLSPEC int RelationEvaluateSecondDerivSafe(CONST struct relation *r,
 */
 ASC_DLLSPEC int RelationEvaluateHessianMtx(CONST struct relation *r,
 											hessian_mtx *hess_mtx,
-		   									unsigned long dimension);
+		   									unsigned long dimension,
+											struct RelEvalContext *ctx);
   											
   											
 /**<
@@ -210,7 +220,8 @@ ASC_DLLSPEC int RelationEvaluateHessianMtx(CONST struct relation *r,
 ASC_DLLSPEC int RelationEvaluateHessianMtxSafe(CONST struct relation *r,
 												hessian_mtx *hess_mtx,
 												unsigned long dimension,
-												enum safe_err *serr);
+												enum safe_err *serr,
+												struct RelEvalContext *ctx);
 												
 /**------------------------------------------------------ */
 /* @} */
@@ -102,16 +102,24 @@ static double rec_1_p_sqr_Dn(double x,int n, enum safe_err *safe)
    return(prev[1]);
 }
 
+#define POLY_SMALL 8
+
 static double *alloc_poly(int order)
 /**
  ***  Allocates a polynominal of given order and returns it.  The
  ***  polynominal need not be freed, but this function should not be
- ***  called again until the old polynominal is not needed anymore.
+ ***  called again (on the same thread) until the old polynominal is not
+ ***  needed anymore. Orders are derivative orders, so nearly always
+ ***  small enough for the fixed buffer, which a thread leaves nothing of.
  **/
 {
-   static double *poly = NULL;
-   static int poly_cap = 0;
+   static ASC_THREAD_LOCAL double poly_small[POLY_SMALL];
+   static ASC_THREAD_LOCAL double *poly = NULL;
+   static ASC_THREAD_LOCAL int poly_cap = 0;
 
+   if( order < POLY_SMALL ) {
+      return poly_small;
+   }
    if( order + 1 > poly_cap ) {
       poly_cap = order+1;
       if( poly != NULL ) {
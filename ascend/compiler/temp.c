@@ -38,8 +38,8 @@
 #include "value_type.h"
 #include "temp.h"
 
-struct gl_list_t *g_temporary_var_list = NULL;
-/* a list of active vars */
+static ASC_THREAD_LOCAL struct gl_list_t *g_temporary_var_list = NULL;
+/* a list of active vars, one per thread evaluating expressions */
 #define GTVL g_temporary_var_list
 /* name is too damn long */
 
@@ -58,7 +58,7 @@ struct temp_var_t {
 
 /* LIFO tempvar list.
  */
-struct temp_var_t *g_temporary_var_recycle = NULL;
+static ASC_THREAD_LOCAL struct temp_var_t *g_temporary_var_recycle = NULL;
 
 static struct temp_var_t *TempVarMalloc(void)
 {
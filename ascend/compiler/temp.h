@@ -76,7 +76,8 @@ extern struct value_t TempValue(symchar *name);
 
 extern void DestroyTemporaryList(void);
 /**< 
- *  Free the memory for the temporary variable list.
+ *  Free the memory for the temporary variable list. The list is kept
+ *  per thread, so this frees only the calling thread's.
  */
 
 /* @} */
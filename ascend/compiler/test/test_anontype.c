@@ -0,0 +1,172 @@
+/*	ASCEND modelling environment
+	Copyright (C) 2015 Carnegie Mellon University
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2, or (at your option)
+	any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*//**
+	@file
+	Classify the anonymous types of the z-anontype test model and check
+	that instances alike in value, subscripts and merges share a type and
+	the others don't.
+*/
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <ascend/general/platform.h>
+#include <ascend/general/ascMalloc.h>
+#include <ascend/general/list.h>
+#include <ascend/utilities/ascEnvVar.h>
+#include <ascend/utilities/error.h>
+
+#include <ascend/compiler/ascCompiler.h>
+#include <ascend/compiler/module.h>
+#include <ascend/compiler/parser.h>
+#include <ascend/compiler/library.h>
+#include <ascend/compiler/symtab.h>
+#include <ascend/compiler/simlist.h>
+#include <ascend/compiler/instquery.h>
+#include <ascend/compiler/parentchild.h>
+#include <ascend/compiler/anontype.h>
+
+#include <test/common.h>
+
+/* the instance at a dotted path of plain names below root */
+static struct Instance *find(struct Instance *root, const char *path){
+	char buf[80], *s, *dot;
+	struct Instance *i = root;
+	strcpy(buf, path);
+	for(s = buf; i != NULL && s != NULL; s = dot){
+		dot = strchr(s, '.');
+		if(dot != NULL)*dot++ = '\0';
+		i = ChildByChar(i, AddSymbol(s));
+	}
+	return i;
+}
+
+/* the anonymous type that instance i was put in, or NULL */
+static struct AnonType *type_of(struct gl_list_t *atl, struct Instance *i){
+	unsigned long n, c;
+	struct AnonType *at;
+	for(n = 1; n <= gl_length(atl); n++){
+		at = Asc_GetAnonType(atl, n);
+		for(c = 1; c <= Asc_GetAnonCount(atl, n); c++){
+			if(Asc_GetAnonTypeInstance(at, c) == i)return at;
+		}
+	}
+	return NULL;
+}
+
+static int same(struct gl_list_t *atl, struct Instance *root,
+		const char *p1, const char *p2
+){
+	struct Instance *i1 = find(root, p1), *i2 = find(root, p2);
+	struct AnonType *at1, *at2;
+	if(i1 == NULL || i2 == NULL){
+		CONSOLE_DEBUG("no instance %s", i1 == NULL ? p1 : p2);
+		return -1;
+	}
+	at1 = type_of(atl, i1);
+	at2 = type_of(atl, i2);
+	if(at1 == NULL || at2 == NULL)return -1;
+	return at1 == at2;
+}
+
+static void test_classify(void){
+	int status;
+	struct Instance *sim, *root;
+	struct gl_list_t *atl;
+	unsigned long n, c, total = 0;
+
+	Asc_CompilerInit(1);
+	Asc_PutEnv(ASC_ENV_LIBRARY "=models");
+
+	Asc_OpenModule("test/z-anontype.a4c", &status);
+	CU_ASSERT(status == 0);
+	CU_ASSERT(0 == zz_parse());
+
+	/* the model has deliberate compile errors, so don't check those */
+	sim = SimsCreateInstance(AddSymbol("test_all_anon"), AddSymbol("sim1"), e_normal, NULL);
+	CU_ASSERT_FATAL(sim != NULL);
+	root = GetSimulationRoot(sim);
+
+	atl = Asc_DeriveAnonList(root);
+	CU_ASSERT_FATAL(atl != NULL);
+
+	/* every instance in exactly one type, so in the right number of them */
+	for(n = 1; n <= gl_length(atl); n++){
+		CU_ASSERT(Asc_GetAnonCount(atl, n) > 0);
+		total += Asc_GetAnonCount(atl, n);
+	}
+	for(n = 1; n <= gl_length(atl); n++){
+		struct AnonType *at = Asc_GetAnonType(atl, n);
+		for(c = 1; c <= Asc_GetAnonCount(atl, n); c++){
+			CU_ASSERT(type_of(atl, Asc_GetAnonTypeInstance(at, c)) == at);
+		}
+	}
+	CU_ASSERT(type_of(atl, root) != NULL);
+
+	/* constants by value */
+	CU_ASSERT(1 == same(atl, root, "tsc.a", "tsc.c"));
+	CU_ASSERT(1 == same(atl, root, "tsc.a", "tsc.A"));
+	CU_ASSERT(0 == same(atl, root, "tsc.a", "tsc.b"));
+	CU_ASSERT(1 == same(atl, root, "trc.a", "trc.f"));
+	CU_ASSERT(1 == same(atl, root, "trc.d", "trc.G"));
+	CU_ASSERT(0 == same(atl, root, "trc.a", "trc.b"));
+	CU_ASSERT(0 == same(atl, root, "trc.b", "trc.d"));
+	CU_ASSERT(1 == same(atl, root, "tic.a", "tic.C"));
+	CU_ASSERT(0 == same(atl, root, "tic.a", "tic.d"));
+	CU_ASSERT(1 == same(atl, root, "tset.a", "tset.F"));
+	CU_ASSERT(0 == same(atl, root, "tset.a", "tset.J"));
+	CU_ASSERT(1 == same(atl, root, "tset.e", "tset.zB"));
+
+	/* models by their parts */
+	CU_ASSERT(1 == same(atl, root, "tc.s2", "tc.s3"));
+	CU_ASSERT(0 == same(atl, root, "tc.s3", "tc.s4"));
+	CU_ASSERT(0 == same(atl, root, "tc.s", "tc.s2"));
+	CU_ASSERT(1 == same(atl, root, "tc.s", "tsc"));
+
+	/* arrays by their subscripts */
+	CU_ASSERT(1 == same(atl, root, "tmg.e1", "tmg.e3"));
+	CU_ASSERT(1 == same(atl, root, "tmg.e1.x", "tmg.e3.x"));
+	CU_ASSERT(0 == same(atl, root, "tmg.e1.x", "tmg.e2.x"));
+	CU_ASSERT(0 == same(atl, root, "tmg.e1", "tmg.e2"));
+
+	/* and by their merges */
+	CU_ASSERT(1 == same(atl, root, "tmg.a", "tai1"));
+	CU_ASSERT(1 == same(atl, root, "tmg.c", "tmg.d"));
+	CU_ASSERT(0 == same(atl, root, "tmg.a", "tmg.c"));
+	CU_ASSERT(1 == same(atl, root, "tmg.c.a", "tmg.d.a"));
+	CU_ASSERT(0 == same(atl, root, "tmg.a.a", "tmg.c.a"));
+	CU_ASSERT(1 == same(atl, root, "tmg.a.c", "tmg.c.c"));
+
+	/* the same again from scratch */
+	n = gl_length(atl);
+	Asc_DestroyAnonList(atl);
+	atl = Asc_DeriveAnonList(root);
+	CU_ASSERT_FATAL(atl != NULL);
+	CU_ASSERT(gl_length(atl) == n);
+	CU_ASSERT(0 == same(atl, root, "tmg.e1.x", "tmg.e2.x"));
+	Asc_DestroyAnonList(atl);
+
+	sim_destroy(sim);
+	Asc_CompilerDestroy();
+}
+
+/*===========================================================================*/
+/* Registration information */
+
+#define TESTS(T) \
+	T(classify)
+
+REGISTER_TESTS_SIMPLE(compiler_anontype, TESTS)
@@ -454,8 +454,8 @@ static void AutomateDiffTest(struct Instance *inst, VOIDPTR ptr){
 	ASC_FREE(infix_rel);
 
 	/* we need to sigfpe trap this code or use the safe versions. */
-	RelationCalcResidGradRev(inst,&residual_rev,gradients_rev);
-	RelationCalcResidGrad(inst,&residual_fwd,gradients_fwd);
+	RelationCalcResidGradRev(inst,&residual_rev,gradients_rev,NULL);
+	RelationCalcResidGrad(inst,&residual_fwd,gradients_fwd,NULL);
 
 	LOG(data,"</br> <b> Table of Values for Residuals </b> </br>\n");
 	LOG(data,"\n<table BORDER>\n");
@@ -535,7 +535,7 @@ static void AutomateDiffTest(struct Instance *inst, VOIDPTR ptr){
 	LOG(data,"\n<table BORDER>\n");
 	LOG(data,"<tr><td>Row</td><td>Column</td><td>ASCEND (NON-SAFE)</td><td>Yacas</td><td>Percentage Mismatch</td></tr>\n");
 	for(i=0; i<num_var; i++){
-		RelationCalcSecondDeriv(inst,deriv_2nd,i);
+		RelationCalcSecondDeriv(inst,deriv_2nd,i,NULL);
 		if(data->use_yacas && data->SecondDer.nonsafeder!=NULL){
 			/** @todo log calculated values and indiceshere.*/ /*FIXME*/
 			for(j=0; j<num_var; j++){
@@ -571,10 +571,10 @@ static void AutomateDiffTest(struct Instance *inst, VOIDPTR ptr){
 
 	/** Testing safe routines */
 
-	status = (int32) RelationCalcResidGradRevSafe(inst,&residual_rev,gradients_rev);
+	status = (int32) RelationCalcResidGradRevSafe(inst,&residual_rev,gradients_rev,NULL);
 	safe_error_to_stderr( (enum safe_err *)&status );
 
-	status = RelationCalcResidGradSafe(inst,&residual_fwd,gradients_fwd);
+	status = RelationCalcResidGradSafe(inst,&residual_fwd,gradients_fwd,NULL);
 	safe_error_to_stderr( (enum safe_err *)&status );
 
 
@@ -628,7 +628,7 @@ static void AutomateDiffTest(struct Instance *inst, VOIDPTR ptr){
 		fprintf(data->SecondDer.safeder,"@ Relation: %s Follows\n",rname);
 	}
 	for(i=0; i<num_var; i++){
-		status = (int32) RelationCalcSecondDerivSafe(inst,deriv_2nd,i);
+		status = (int32) RelationCalcSecondDerivSafe(inst,deriv_2nd,i,NULL);
 		safe_error_to_stderr( (enum safe_err *)&status );
 
 		if(data->use_yacas && data->SecondDer.safeder!=NULL){
@@ -1,6 +1,10 @@
+#include <math.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#ifndef __WIN32__
+# include <unistd.h>
+#endif
 
 #include <ascend/general/env.h>
 #include <ascend/general/ospath.h>
@@ -148,13 +152,151 @@ static void test_test1(){
 	Asc_CompilerDestroy();
 }
 
+/*
+	Compare binary token residuals and gradients with the postfix ones
+*/
+struct BinTokTestData {
+	int nbin;   /* relations with working binary tokens */
+	int nerr;   /* mismatches */
+};
+
+static void CompareBinTok(struct Instance *inst, VOIDPTR ptr){
+	struct BinTokTestData *data = (struct BinTokTestData *)ptr;
+	struct relation *r;
+	enum Expr_enum reltype;
+	double res_bin, res_post, grad_bin[20], grad_post[20];
+	unsigned long i, nv;
+
+	if(inst == NULL || InstanceKind(inst) != REL_INST)return;
+	r = (struct relation *)GetInstanceRelation(inst, &reltype);
+	if(r == NULL || reltype != e_token)return;
+	nv = NumberVariables(r);
+	CU_ASSERT_FATAL(nv <= 20);
+	if(RelationCalcResidualBinary(r, &res_bin,NULL))return;
+	data->nbin++;
+	CU_ASSERT(0 == RelationCalcResidualPostfix(inst, &res_post,NULL));
+	if(fabs(res_bin - res_post) > 1e-12 * (1 + fabs(res_post)))data->nerr++;
+	CU_ASSERT(0 == RelationCalcResidGradBinary(r, &res_bin, grad_bin,NULL));
+	CU_ASSERT(0 == RelationCalcResidGrad(inst, &res_post, grad_post,NULL));
+	for(i = 0; i < nv; ++i){
+		if(fabs(grad_bin[i] - grad_post[i]) > 1e-12 * (1 + fabs(grad_post[i]))){
+			CONSOLE_DEBUG("gradient mismatch %g vs %g", grad_bin[i], grad_post[i]);
+			data->nerr++;
+		}
+	}
+}
+
+/* damage the last byte of a file, as a crash or a bad disk might */
+static void corrupt_file(CONST char *filename){
+	FILE *fp;
+	int c;
+	fp = fopen(filename,"r+b");
+	CU_ASSERT_FATAL(fp != NULL);
+	CU_ASSERT(0 == fseek(fp, -1L, SEEK_END));
+	c = fgetc(fp);
+	CU_ASSERT(0 == fseek(fp, -1L, SEEK_END));
+	fputc(c ^ 0x5a, fp);
+	fclose(fp);
+}
+
+/*
+	Test solving the same model with in-process generated code (BT_JIT),
+	then instantiating it again to pick the code up from the disk cache,
+	then again after damaging the cache, which must be ignored.
+*/
+static void test_jit(){
+	struct Instance *siminst;
+	struct BinTokTestData data;
+	int status, pass;
+	FILE *fp;
+#ifdef __WIN32__
+	char cachename[L_tmpnam];
+	CU_ASSERT_FATAL(tmpnam(cachename) != NULL);
+#else
+	char cachename[] = "/tmp/btjit_testXXXXXX";
+	int fd = mkstemp(cachename); /* left empty, which is a new cache */
+	CU_ASSERT_FATAL(fd != -1);
+	close(fd);
+#endif
+
+	Asc_CompilerInit(1);
+	Asc_PutEnv(ASC_ENV_LIBRARY "=models");
+	Asc_PutEnv(ASC_ENV_SOLVERS "=solvers/qrslv");
+
+	Asc_OpenModule("test/bintok/test1.a4c",&status);
+	CU_ASSERT(status == 0);
+	CU_ASSERT(0 == zz_parse());
+	CU_ASSERT(FindType(AddSymbol("test1"))!=NULL);
+
+	if(BinTokenSetJITOptions(cachename, 1000)){
+		CONSOLE_DEBUG("BT_JIT not available, skipping test");
+		remove(cachename);
+		Asc_CompilerDestroy();
+		return;
+	}
+	CU_ASSERT(BinTokenGetMethod() == BT_JIT);
+
+	for(pass = 0; pass < 3; ++pass){
+		if(pass > 0){
+			if(pass == 2)corrupt_file(cachename);
+			/* forget the copy in memory so that the file is read again */
+			CU_ASSERT(0 == BinTokenSetJITOptions(cachename, 1000));
+		}
+		siminst = SimsCreateInstance(AddSymbol("test1"), AddSymbol("sim1"), e_normal, NULL);
+		CU_ASSERT_FATAL(siminst!=NULL);
+
+		/* every instantiation must leave the cache written */
+		fp = fopen(cachename,"rb");
+		CU_ASSERT(fp != NULL);
+		if(fp != NULL)fclose(fp);
+
+		/* and only the second found its code there */
+		if(pass == 1){
+			CU_ASSERT(BinTokenJITCacheHits() > 0);
+		}else{
+			CU_ASSERT(BinTokenJITCacheHits() == 0);
+		}
+
+		struct Name *name = CreateIdName(AddSymbol("on_load"));
+		enum Proc_enum pe = Initialize(GetSimulationRoot(siminst),name,"on_load", ASCERR, WP_STOPONERR, NULL, NULL);
+		CU_ASSERT(pe==Proc_all_ok);
+		DestroyName(name);
+
+		slv_system_t sys = system_build(GetSimulationRoot(siminst));
+		CU_ASSERT_FATAL(sys != NULL);
+		CU_ASSERT_FATAL(slv_select_solver(sys,slv_lookup_client("QRSlv")));
+		CU_ASSERT_FATAL(0 == slv_presolve(sys));
+		slv_solve(sys);
+		slv_status_t st;
+		slv_get_status(sys, &st);
+		CU_ASSERT(st.ok);
+		system_destroy(sys);
+		system_free_reused_mem();
+
+		data.nbin = data.nerr = 0;
+		VisitInstanceTreeTwo(GetSimulationRoot(siminst), CompareBinTok, 0, 0, &data);
+		CU_ASSERT(data.nbin == 8);
+		CU_ASSERT(data.nerr == 0);
+		if(pass == 1){
+			CU_ASSERT(BinTokenJITCacheHits() <= data.nbin);
+		}
+
+		sim_destroy(siminst);
+	}
+
+	remove(cachename);
+	solver_destroy_engines();
+	Asc_CompilerDestroy();
+}
+
 /*===========================================================================*/
 /* Registration information */
 
 /* the list of tests */
 
 #define TESTS(T) \
-	T(test1)
+	T(test1) \
+	T(jit)
 
 REGISTER_TESTS_SIMPLE(compiler_bintok, TESTS)
 
@@ -0,0 +1,189 @@
+/*	ASCEND modelling environment
+	Copyright (C) 2015 Carnegie Mellon University
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2, or (at your option)
+	any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*//**
+	@file
+	Evaluate the relations of the reverse AD test model with explicit
+	RelEvalContexts, on several threads at once, and check the results
+	match those got on one thread with the default context.
+*/
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <ascend/general/platform.h>
+#include <ascend/general/ascMalloc.h>
+#include <ascend/general/list.h>
+#include <ascend/utilities/ascEnvVar.h>
+#include <ascend/utilities/ascTask.h>
+#include <ascend/utilities/error.h>
+
+#include <ascend/compiler/ascCompiler.h>
+#include <ascend/compiler/module.h>
+#include <ascend/compiler/parser.h>
+#include <ascend/compiler/library.h>
+#include <ascend/compiler/symtab.h>
+#include <ascend/compiler/simlist.h>
+#include <ascend/compiler/instquery.h>
+#include <ascend/compiler/mathinst.h>
+#include <ascend/compiler/relation_util.h>
+#include <ascend/compiler/visitinst.h>
+#include <ascend/compiler/initialize.h>
+#include <ascend/compiler/name.h>
+
+#include <test/common.h>
+
+#define NTASK 8
+
+struct EvalCtxTestData{
+	struct gl_list_t *rels;  /* token relation instances */
+	double *res;             /* serial results... */
+	double *grad, *gradrev;  /* ...nmax per relation, forward and reverse */
+	unsigned long nmax;
+	int nerr[NTASK];
+};
+
+static void CollectTokenRels(struct Instance *inst, VOIDPTR ptr){
+	struct EvalCtxTestData *data = (struct EvalCtxTestData *)ptr;
+	enum Expr_enum reltype;
+	struct relation *r;
+	if(inst == NULL || InstanceKind(inst) != REL_INST)return;
+	r = (struct relation *)GetInstanceRelation(inst, &reltype);
+	if(r == NULL || reltype != e_token)return;
+	gl_append_ptr(data->rels, inst);
+	if(NumberVariables(r) > data->nmax){
+		data->nmax = NumberVariables(r);
+	}
+}
+
+static int evalctx_differ(double a, double b){
+	if(a != a || b != b)return (a == a) != (b == b);
+	return fabs(a - b) > 1e-10 * (1.0 + fabs(a) + fabs(b));
+}
+
+/* each task does every NTASK-th relation, gradients forward and reverse */
+static int evalctx_task(void *ptr, int worker, int32 task){
+	struct EvalCtxTestData *data = (struct EvalCtxTestData *)ptr;
+	struct RelEvalContext *ctx = RelEvalContextCreate();
+	unsigned long c, j, n = gl_length(data->rels);
+	double res, *grad;
+	struct Instance *inst;
+	(void)worker;
+
+	grad = RelEvalContextWork(ctx, data->nmax + 1);
+	for(c = task + 1; c <= n; c += NTASK){
+		inst = (struct Instance *)gl_fetch(data->rels, c);
+		if(RelationCalcResidualPostfix(inst, &res, ctx)
+			|| evalctx_differ(res, data->res[c-1])
+		){
+			data->nerr[task]++;
+		}
+		if(RelationCalcResidGrad(inst, &res, grad, ctx))continue;
+		for(j = 0; j < NumberVariables(GetInstanceRelationOnly(inst)); j++){
+			if(evalctx_differ(grad[j], data->grad[(c-1)*data->nmax + j])){
+				data->nerr[task]++;
+			}
+		}
+		if(RelationCalcResidGradRev(inst, &res, grad, ctx))continue;
+		for(j = 0; j < NumberVariables(GetInstanceRelationOnly(inst)); j++){
+			if(evalctx_differ(grad[j], data->gradrev[(c-1)*data->nmax + j])){
+				data->nerr[task]++;
+			}
+		}
+	}
+	RelEvalContextDestroy(ctx);
+	return 0;
+}
+
+static void evalctx_done(void *ptr, int worker){
+	(void)ptr;
+	(void)worker;
+	RelEvalContextThreadDestroy();
+}
+
+static void test_threads(void){
+	int status, t;
+	struct Instance *sim, *root, *inst;
+	struct EvalCtxTestData data;
+	int32 npred[NTASK], succptr[NTASK + 1];
+	unsigned long c, n;
+	unsigned long prior_meminuse;
+	double res;
+
+	Asc_CompilerInit(1);
+	Asc_PutEnv(ASC_ENV_LIBRARY "=models");
+
+	Asc_OpenModule("test/reverse_ad/allmodels.a4c", &status);
+	CU_ASSERT(status == 0);
+	CU_ASSERT(0 == zz_parse());
+	CU_ASSERT(FindType(AddSymbol("allmodels")) != NULL);
+
+	sim = SimsCreateInstance(AddSymbol("allmodels"), AddSymbol("sim1"), e_normal, NULL);
+	CU_ASSERT_FATAL(sim != NULL);
+	root = GetSimulationRoot(sim);
+	Initialize(root, CreateIdName(AddSymbol("on_load")), "sim1", ASCERR, 0, NULL, NULL);
+
+	memset(&data, 0, sizeof(data));
+	data.rels = gl_create(100L);
+	VisitInstanceTreeTwo(root, CollectTokenRels, 0, 0, &data);
+	n = gl_length(data.rels);
+	CU_ASSERT(n > 0);
+
+	/* reference results, serially with this thread's context */
+	data.res = ASC_NEW_ARRAY_CLEAR(double, n + 1);
+	data.grad = ASC_NEW_ARRAY_CLEAR(double, n * data.nmax + 1);
+	data.gradrev = ASC_NEW_ARRAY_CLEAR(double, n * data.nmax + 1);
+	for(c = 1; c <= n; c++){
+		inst = (struct Instance *)gl_fetch(data.rels, c);
+		CU_ASSERT(0 == RelationCalcResidualPostfix(inst, &(data.res[c-1]), NULL));
+		(void)RelationCalcResidGrad(inst, &res
+			, &(data.grad[(c-1)*data.nmax]), NULL
+		);
+		(void)RelationCalcResidGradRev(inst, &res
+			, &(data.gradrev[(c-1)*data.nmax]), NULL
+		);
+	}
+	RelEvalContextThreadDestroy();
+
+	prior_meminuse = ascmeminuse();
+	for(t = 0; t < NTASK; t++){
+		npred[t] = 0;
+		succptr[t] = 0;
+	}
+	succptr[NTASK] = 0;
+	CU_ASSERT(0 == asc_task_graph_run(NTASK, npred, succptr, NULL, 4
+		, &evalctx_task, &evalctx_done, &data
+	));
+	for(t = 0; t < NTASK; t++){
+		CU_ASSERT(data.nerr[t] == 0);
+	}
+	CU_ASSERT(prior_meminuse == ascmeminuse());
+
+	ASC_FREE(data.res);
+	ASC_FREE(data.grad);
+	ASC_FREE(data.gradrev);
+	gl_destroy(data.rels);
+	sim_destroy(sim);
+	Asc_CompilerDestroy();
+}
+
+/*===========================================================================*/
+/* Registration information */
+
+#define TESTS(T) \
+	T(threads)
+
+REGISTER_TESTS_SIMPLE(compiler_evalctx, TESTS)
@@ -0,0 +1,201 @@
+/*	ASCEND modelling environment
+	Copyright (C) 2015 Carnegie Mellon University
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2, or (at your option)
+	any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*//**
+	@file
+	Compare the register bytecode evaluator (rel_opcode.c) with the
+	postfix evaluators in relation_util.c, for residuals and gradients,
+	over all the relations of the reverse AD test model.
+*/
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <ascend/general/platform.h>
+#include <ascend/general/ascMalloc.h>
+#include <ascend/utilities/ascEnvVar.h>
+#include <ascend/utilities/error.h>
+
+#include <ascend/compiler/ascCompiler.h>
+#include <ascend/compiler/module.h>
+#include <ascend/compiler/parser.h>
+#include <ascend/compiler/library.h>
+#include <ascend/compiler/symtab.h>
+#include <ascend/compiler/simlist.h>
+#include <ascend/compiler/instquery.h>
+#include <ascend/compiler/atomvalue.h>
+#include <ascend/compiler/mathinst.h>
+#include <ascend/compiler/relation_util.h>
+#include <ascend/compiler/rel_opcode.h>
+#include <ascend/compiler/visitinst.h>
+#include <ascend/compiler/initialize.h>
+#include <ascend/compiler/name.h>
+
+#include <test/common.h>
+
+#define OPCODE_TOL 1e-10
+
+struct OpCodeTestData {
+	int nrels;     /* token relations compared */
+	int ncompiled; /* ...of which compiled to opcodes */
+	int d0errors;  /* residual mismatches */
+	int d1errors;  /* gradient mismatches */
+	int lerrors;   /* lane evaluator mismatches */
+};
+
+static int opcode_differ(double a, double b){
+	return fabs(a - b) > OPCODE_TOL * (1.0 + fabs(a) + fabs(b));
+}
+
+/*
+	Evaluate the relation in every lane of the lane evaluator, with the
+	variable values scaled differently in each lane, and compare each lane
+	with the scalar evaluator given the same values.
+*/
+static int CompareOpCodeLanes(CONST struct relation *r
+		, CONST struct RelOpCodes *p, unsigned long nv
+){
+	double *x, *xl, *regs, *grad, *gradl, res, resl[RELOP_LANES];
+	unsigned long j;
+	int l, nerr = 0, bad, badg;
+
+	x = ASC_NEW_ARRAY(double, nv + 1);
+	xl = ASC_NEW_ARRAY(double, nv*RELOP_LANES + 1);
+	grad = ASC_NEW_ARRAY(double, nv + 1);
+	gradl = ASC_NEW_ARRAY(double, nv*RELOP_LANES + 1);
+	regs = ASC_NEW_ARRAY(double, RelOpCodesScratchN(p,1) + 1);
+
+	for(j = 0; j < nv; j++){
+		for(l = 0; l < RELOP_LANES; l++){
+			xl[j*RELOP_LANES + l] = RealAtomValue(RelationVariable(r, j + 1))
+				* (1.0 + 0.01*l);
+		}
+	}
+	bad = RelOpCodesResidualN(p, xl, regs, resl);
+	badg = RelOpCodesResidGradN(p, xl, regs, resl, gradl, nv);
+	for(l = 0; l < RELOP_LANES; l++){
+		for(j = 0; j < nv; j++){
+			x[j] = xl[j*RELOP_LANES + l];
+		}
+		if(RelOpCodesResidual(p, x, regs, &res) != ((bad >> l) & 1)){
+			nerr++;
+			continue;
+		}
+		if(RelOpCodesResidGrad(p, x, regs, &res, grad, nv) != ((badg >> l) & 1)){
+			nerr++;
+			continue;
+		}
+		if((badg >> l) & 1)continue;
+		if(opcode_differ(res, resl[l]))nerr++;
+		for(j = 0; j < nv; j++){
+			if(opcode_differ(grad[j], gradl[j*RELOP_LANES + l]))nerr++;
+		}
+	}
+	ASC_FREE(x);
+	ASC_FREE(xl);
+	ASC_FREE(grad);
+	ASC_FREE(gradl);
+	ASC_FREE(regs);
+	return nerr;
+}
+
+static void CompareOpCodes(struct Instance *inst, VOIDPTR ptr){
+	struct OpCodeTestData *data = (struct OpCodeTestData *)ptr;
+	struct relation *r;
+	enum Expr_enum reltype;
+	double res_post, res_op, res_op2;
+	double *grad_post, *grad_op;
+	unsigned long nv, i;
+
+	if(inst == NULL || InstanceKind(inst) != REL_INST)return;
+	r = (struct relation *)GetInstanceRelation(inst, &reltype);
+	if(r == NULL || reltype != e_token)return;
+	data->nrels++;
+
+	if(RelationOpCodes(r) == NULL)return;
+	data->ncompiled++;
+
+	if(RelationCalcResidualPostfix(inst, &res_post,NULL))return;
+	if(RelationCalcResidualOpCode(r, &res_op,NULL))return;
+	if(opcode_differ(res_post, res_op)){
+		CONSOLE_DEBUG("residual mismatch: postfix %g, opcode %g", res_post, res_op);
+		data->d0errors++;
+	}
+
+	nv = NumberVariables(r);
+	grad_post = ASC_NEW_ARRAY_CLEAR(double, nv + 1);
+	grad_op = ASC_NEW_ARRAY_CLEAR(double, nv + 1);
+	if(0 == RelationCalcResidGrad(inst, &res_post, grad_post,NULL)
+		&& 0 == RelationCalcResidGradOpCode(r, &res_op2, grad_op,NULL)
+	){
+		if(opcode_differ(res_op, res_op2)){
+			data->d0errors++;
+		}
+		for(i = 0; i < nv; i++){
+			if(opcode_differ(grad_post[i], grad_op[i])){
+				CONSOLE_DEBUG("gradient mismatch in var %lu: postfix %g, opcode %g"
+					, i + 1, grad_post[i], grad_op[i]
+				);
+				data->d1errors++;
+			}
+		}
+	}
+	ASC_FREE(grad_post);
+	ASC_FREE(grad_op);
+
+	data->lerrors += CompareOpCodeLanes(r, RelationOpCodes(r), nv);
+}
+
+static void test_allmodels(void){
+	int status;
+	struct Instance *sim, *root;
+	struct OpCodeTestData data = {0, 0, 0, 0, 0};
+
+	Asc_CompilerInit(1);
+	Asc_PutEnv(ASC_ENV_LIBRARY "=models");
+
+	Asc_OpenModule("test/reverse_ad/allmodels.a4c", &status);
+	CU_ASSERT(status == 0);
+	CU_ASSERT(0 == zz_parse());
+	CU_ASSERT(FindType(AddSymbol("allmodels")) != NULL);
+
+	sim = SimsCreateInstance(AddSymbol("allmodels"), AddSymbol("sim1"), e_normal, NULL);
+	CU_ASSERT_FATAL(sim != NULL);
+	root = GetSimulationRoot(sim);
+
+	/* on_load sets values for the variables */
+	Initialize(root, CreateIdName(AddSymbol("on_load")), "sim1", ASCERR, 0, NULL, NULL);
+
+	VisitInstanceTreeTwo(root, CompareOpCodes, 0, 0, &data);
+	CONSOLE_DEBUG("%d token relations, %d compiled to opcodes", data.nrels, data.ncompiled);
+
+	CU_ASSERT(data.nrels > 0);
+	CU_ASSERT(data.ncompiled == data.nrels);
+	CU_ASSERT(data.d0errors == 0);
+	CU_ASSERT(data.d1errors == 0);
+	CU_ASSERT(data.lerrors == 0);
+
+	sim_destroy(sim);
+	Asc_CompilerDestroy();
+}
+
+/*===========================================================================*/
+/* Registration information */
+
+#define TESTS(T) \
+	T(allmodels)
+
+REGISTER_TESTS_SIMPLE(compiler_opcode, TESTS)
@@ -0,0 +1,155 @@
+/*	ASCEND modelling environment
+	Copyright (C) 2015 Carnegie Mellon University
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2, or (at your option)
+	any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*//**
+	@file
+	Instantiate the reverse AD test models, which are many models with
+	relations of their own, with the relations of pass 2 made on one thread
+	and on four, and check that the two trees have the same relations with
+	the same residuals, and that their variables are in the same relations.
+*/
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <ascend/general/platform.h>
+#include <ascend/general/ascMalloc.h>
+#include <ascend/general/list.h>
+#include <ascend/utilities/ascEnvVar.h>
+#include <ascend/utilities/error.h>
+
+#include <ascend/compiler/ascCompiler.h>
+#include <ascend/compiler/compiler.h>
+#include <ascend/compiler/module.h>
+#include <ascend/compiler/parser.h>
+#include <ascend/compiler/library.h>
+#include <ascend/compiler/symtab.h>
+#include <ascend/compiler/simlist.h>
+#include <ascend/compiler/instquery.h>
+#include <ascend/compiler/parentchild.h>
+#include <ascend/compiler/atomvalue.h>
+#include <ascend/compiler/mathinst.h>
+#include <ascend/compiler/relation_util.h>
+#include <ascend/compiler/visitinst.h>
+#include <ascend/compiler/initialize.h>
+#include <ascend/compiler/name.h>
+
+#include <test/common.h>
+
+static void CollectAll(struct Instance *inst, VOIDPTR ptr){
+	gl_append_ptr((struct gl_list_t *)ptr, inst);
+}
+
+static int pass2_differ(double a, double b){
+	if(a != a || b != b)return (a == a) != (b == b);
+	return a != b;
+}
+
+static struct Instance *make_sim(const char *name, int nthread){
+	struct Instance *sim;
+	int save = g_pass2_threads;
+	g_pass2_threads = nthread;
+	sim = SimsCreateInstance(AddSymbol("allmodels"), AddSymbol(name), e_normal, NULL);
+	g_pass2_threads = save;
+	CU_ASSERT_FATAL(sim != NULL);
+	Initialize(GetSimulationRoot(sim), CreateIdName(AddSymbol("on_load"))
+		, (char *)name, ASCERR, 0, NULL, NULL
+	);
+	return sim;
+}
+
+/* with anonymous type relation copying on or off */
+static void compare_threads(int copyanon){
+	struct Instance *sim1, *sim4, *i1, *i2;
+	struct gl_list_t *l1, *l2;
+	unsigned long c, n, nrel = 0, nerr = 0;
+	double r1, r2;
+	int save = g_use_copyanon;
+
+	g_use_copyanon = copyanon;
+	sim1 = make_sim("sim1", 1);
+	sim4 = make_sim("sim4", 4);
+	g_use_copyanon = save;
+
+	l1 = gl_create(1000L);
+	l2 = gl_create(1000L);
+	VisitInstanceTreeTwo(GetSimulationRoot(sim1), CollectAll, 0, 0, l1);
+	VisitInstanceTreeTwo(GetSimulationRoot(sim4), CollectAll, 0, 0, l2);
+	n = gl_length(l1);
+	CU_ASSERT_FATAL(n == gl_length(l2));
+	for(c = 1; c <= n; c++){
+		i1 = (struct Instance *)gl_fetch(l1, c);
+		i2 = (struct Instance *)gl_fetch(l2, c);
+		if(InstanceKind(i1) != InstanceKind(i2)
+			|| NumberChildren(i1) != NumberChildren(i2)
+		){
+			nerr++;
+			continue;
+		}
+		switch(InstanceKind(i1)){
+		case REAL_ATOM_INST:
+			if(RelationsCount(i1) != RelationsCount(i2)){
+				nerr++;
+			}
+			break;
+		case REL_INST:
+			nrel++;
+			if(NumberVariables(GetInstanceRelationOnly(i1))
+					!= NumberVariables(GetInstanceRelationOnly(i2))
+				|| RelationCalcResidualPostfix(i1, &r1, NULL)
+				|| RelationCalcResidualPostfix(i2, &r2, NULL)
+				|| pass2_differ(r1, r2)
+			){
+				nerr++;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+	CU_ASSERT(nrel > 16);
+	CU_ASSERT(nerr == 0);
+	gl_destroy(l1);
+	gl_destroy(l2);
+
+	sim_destroy(sim4);
+	sim_destroy(sim1);
+}
+
+static void test_threads(void){
+	int status;
+
+	Asc_CompilerInit(1);
+	Asc_PutEnv(ASC_ENV_LIBRARY "=models");
+
+	Asc_OpenModule("test/reverse_ad/allmodels.a4c", &status);
+	CU_ASSERT(status == 0);
+	CU_ASSERT(0 == zz_parse());
+	CU_ASSERT_FATAL(FindType(AddSymbol("allmodels")) != NULL);
+
+	compare_threads(1);
+	compare_threads(0);
+
+	Asc_CompilerDestroy();
+}
+
+/*===========================================================================*/
+/* Registration information */
+
+#define TESTS(T) \
+	T(threads)
+
+REGISTER_TESTS_SIMPLE(compiler_pass2, TESTS)
@@ -25,7 +25,13 @@
 	T(bintok) \
 	T(fixfree) \
 	T(blackbox) \
-	T(fixassign)
+	T(fixassign) \
+	T(opcode) \
+	T(evalctx) \
+	T(snapshot) \
+	T(valstore) \
+	T(anontype) \
+	T(pass2)
 
 
 #define PROTO_TEST(NAME) PROTO(compiler,NAME)
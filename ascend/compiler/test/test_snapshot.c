@@ -0,0 +1,166 @@
+/*	ASCEND modelling environment
+	Copyright (C) 2015 Carnegie Mellon University
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2, or (at your option)
+	any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*//**
+	@file
+	Write a snapshot of the reverse AD test model, read it back as a second
+	simulation and check the two trees have the same instances, values and
+	relation residuals. Also check a file that isn't a snapshot is refused.
+*/
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <ascend/general/platform.h>
+#include <ascend/general/ascMalloc.h>
+#include <ascend/general/list.h>
+#include <ascend/utilities/ascEnvVar.h>
+#include <ascend/utilities/error.h>
+
+#include <ascend/compiler/ascCompiler.h>
+#include <ascend/compiler/module.h>
+#include <ascend/compiler/parser.h>
+#include <ascend/compiler/library.h>
+#include <ascend/compiler/symtab.h>
+#include <ascend/compiler/simlist.h>
+#include <ascend/compiler/instquery.h>
+#include <ascend/compiler/parentchild.h>
+#include <ascend/compiler/atomvalue.h>
+#include <ascend/compiler/mathinst.h>
+#include <ascend/compiler/relation_util.h>
+#include <ascend/compiler/visitinst.h>
+#include <ascend/compiler/initialize.h>
+#include <ascend/compiler/name.h>
+#include <ascend/compiler/instsnap.h>
+
+#include <test/common.h>
+
+#define T_SNAPSHOT "snapshottest.tmp"
+
+static void CollectAll(struct Instance *inst, VOIDPTR ptr){
+	gl_append_ptr((struct gl_list_t *)ptr, inst);
+}
+
+static int snapshot_differ(double a, double b){
+	if(a != a || b != b)return (a == a) != (b == b);
+	return a != b;
+}
+
+static void test_roundtrip(void){
+	int status;
+	struct Instance *sim, *sim2, *root, *root2, *i1, *i2;
+	struct gl_list_t *l1, *l2;
+	unsigned long c, n, nrel = 0, nerr = 0;
+	double r1, r2;
+	unsigned long prior_meminuse;
+	FILE *fp;
+
+	Asc_CompilerInit(1);
+	Asc_PutEnv(ASC_ENV_LIBRARY "=models");
+
+	Asc_OpenModule("test/reverse_ad/allmodels.a4c", &status);
+	CU_ASSERT(status == 0);
+	CU_ASSERT(0 == zz_parse());
+	CU_ASSERT(FindType(AddSymbol("allmodels")) != NULL);
+
+	sim = SimsCreateInstance(AddSymbol("allmodels"), AddSymbol("sim1"), e_normal, NULL);
+	CU_ASSERT_FATAL(sim != NULL);
+	root = GetSimulationRoot(sim);
+	Initialize(root, CreateIdName(AddSymbol("on_load")), "sim1", ASCERR, 0, NULL, NULL);
+
+	CU_ASSERT_FATAL(0 == WriteInstanceSnapshot(sim, T_SNAPSHOT));
+
+	prior_meminuse = ascmeminuse();
+	sim2 = ReadInstanceSnapshot(T_SNAPSHOT, AddSymbol("sim2"));
+	CU_ASSERT_FATAL(sim2 != NULL);
+	CU_ASSERT(GetSimulationName(sim2) == AddSymbol("sim2"));
+	root2 = GetSimulationRoot(sim2);
+	CU_ASSERT_FATAL(root2 != NULL && root2 != root);
+
+	/* the same tree, visited in the same order */
+	l1 = gl_create(1000L);
+	l2 = gl_create(1000L);
+	VisitInstanceTreeTwo(root, CollectAll, 0, 0, l1);
+	VisitInstanceTreeTwo(root2, CollectAll, 0, 0, l2);
+	n = gl_length(l1);
+	CU_ASSERT(n > 0);
+	CU_ASSERT_FATAL(n == gl_length(l2));
+	for(c = 1; c <= n; c++){
+		i1 = (struct Instance *)gl_fetch(l1, c);
+		i2 = (struct Instance *)gl_fetch(l2, c);
+		if(InstanceKind(i1) != InstanceKind(i2)
+			|| NumberChildren(i1) != NumberChildren(i2)
+			|| NumberParents(i1) != NumberParents(i2)
+			|| GetName(InstanceTypeDesc(i1)) != GetName(InstanceTypeDesc(i2))
+		){
+			nerr++;
+			continue;
+		}
+		switch(InstanceKind(i1)){
+		case REAL_INST:
+		case REAL_ATOM_INST:
+		case REAL_CONSTANT_INST:
+			if(snapshot_differ(RealAtomValue(i1), RealAtomValue(i2))
+				|| RealAtomDims(i1) != RealAtomDims(i2)
+			){
+				nerr++;
+			}
+			if(InstanceKind(i1) == REAL_ATOM_INST
+				&& RelationsCount(i1) != RelationsCount(i2)
+			){
+				nerr++;
+			}
+			break;
+		case REL_INST:
+			nrel++;
+			if(RelationCalcResidualPostfix(i1, &r1, NULL)
+				|| RelationCalcResidualPostfix(i2, &r2, NULL)
+				|| snapshot_differ(r1, r2)
+			){
+				nerr++;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+	CU_ASSERT(nrel > 0);
+	CU_ASSERT(nerr == 0);
+	gl_destroy(l1);
+	gl_destroy(l2);
+
+	sim_destroy(sim2);
+	CU_ASSERT(prior_meminuse == ascmeminuse());
+
+	/* anything else is refused */
+	fp = fopen(T_SNAPSHOT, "wb");
+	CU_ASSERT_FATAL(fp != NULL);
+	fprintf(fp, "this is not a snapshot, though it is long enough to have a header\n");
+	fclose(fp);
+	CU_ASSERT(ReadInstanceSnapshot(T_SNAPSHOT, NULL) == NULL);
+	remove(T_SNAPSHOT);
+
+	sim_destroy(sim);
+	Asc_CompilerDestroy();
+}
+
+/*===========================================================================*/
+/* Registration information */
+
+#define TESTS(T) \
+	T(roundtrip)
+
+REGISTER_TESTS_SIMPLE(compiler_snapshot, TESTS)
@@ -0,0 +1,305 @@
+/*	ASCEND modelling environment
+	Copyright (C) 2015 Carnegie Mellon University
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2, or (at your option)
+	any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*//**
+	@file
+	Attach a value store to the reverse AD test models and check that the
+	atoms read and write their values through it, that the bound and fixed
+	copies follow their children, that detaching puts the values back, that
+	merging and refining atoms keeps their slots, and that building a system
+	sets the included and active flags.
+*/
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <ascend/general/platform.h>
+#include <ascend/general/ascMalloc.h>
+#include <ascend/general/list.h>
+#include <ascend/utilities/ascEnvVar.h>
+#include <ascend/utilities/error.h>
+
+#include <ascend/compiler/ascCompiler.h>
+#include <ascend/compiler/module.h>
+#include <ascend/compiler/parser.h>
+#include <ascend/compiler/library.h>
+#include <ascend/compiler/symtab.h>
+#include <ascend/compiler/simlist.h>
+#include <ascend/compiler/instquery.h>
+#include <ascend/compiler/parentchild.h>
+#include <ascend/compiler/atomvalue.h>
+#include <ascend/compiler/visitinst.h>
+#include <ascend/compiler/initialize.h>
+#include <ascend/compiler/name.h>
+#include <ascend/compiler/valstore.h>
+#include <ascend/compiler/mergeinst.h>
+#include <ascend/compiler/refineinst.h>
+#include <ascend/compiler/type_desc.h>
+
+#include <ascend/system/system.h>
+#include <ascend/system/slv_client.h>
+#include <ascend/system/var.h>
+
+#include <test/common.h>
+
+static void CollectRealAtoms(struct Instance *inst, VOIDPTR ptr){
+	if(InstanceKind(inst) == REAL_ATOM_INST){
+		gl_append_ptr((struct gl_list_t *)ptr, inst);
+	}
+}
+
+static void test_attach(void){
+	int status;
+	struct Instance *sim, *root, *i, *var = NULL, *lower = NULL, *fixed = NULL;
+	struct ValueStore *vs;
+	struct gl_list_t *l;
+	unsigned long c, n, nerr = 0;
+	long id;
+
+	Asc_CompilerInit(1);
+	Asc_PutEnv(ASC_ENV_LIBRARY "=models");
+
+	Asc_OpenModule("test/reverse_ad/allmodels.a4c", &status);
+	CU_ASSERT(status == 0);
+	CU_ASSERT(0 == zz_parse());
+	CU_ASSERT(FindType(AddSymbol("allmodels")) != NULL);
+
+	sim = SimsCreateInstance(AddSymbol("allmodels"), AddSymbol("sim1"), e_normal, NULL);
+	CU_ASSERT_FATAL(sim != NULL);
+	root = GetSimulationRoot(sim);
+	Initialize(root, CreateIdName(AddSymbol("on_load")), "sim1", ASCERR, 0, NULL, NULL);
+
+	l = gl_create(1000L);
+	VisitInstanceTreeTwo(root, CollectRealAtoms, 0, 0, l);
+	n = gl_length(l);
+	CU_ASSERT_FATAL(n > 0);
+	CU_ASSERT(GetValueStore(sim) == NULL);
+	CU_ASSERT(ValueStoreId(gl_fetch(l, 1)) == -1);
+
+	vs = ValueStoreAttach(sim);
+	CU_ASSERT_FATAL(vs != NULL && vs == GetValueStore(sim));
+	CU_ASSERT(vs->n == n);
+
+	/* every atom has its own slot, holding its value */
+	for(c = 1; c <= n; c++){
+		i = (struct Instance *)gl_fetch(l, c);
+		id = ValueStoreId(i);
+		if(id < 0 || (unsigned long)id >= vs->n || vs->atom[id] != i
+			|| vs->value[id] != RealAtomValue(i)
+		){
+			nerr++;
+			continue;
+		}
+		if(var == NULL
+			&& (lower = ChildByChar(i, AddSymbol("lower_bound"))) != NULL
+			&& (fixed = ChildByChar(i, AddSymbol("fixed"))) != NULL
+		){
+			var = i;
+			CU_ASSERT(vs->lower[id] == RealAtomValue(lower));
+		}
+	}
+	CU_ASSERT(nerr == 0);
+	CU_ASSERT_FATAL(var != NULL);
+
+	/* attaching again adds nothing */
+	CU_ASSERT(ValueStoreAttach(sim) == vs && vs->n == n);
+
+	/* the slot is the value, both ways */
+	id = ValueStoreId(var);
+	vs->value[id] = 1234.5;
+	CU_ASSERT(RealAtomValue(var) == 1234.5);
+	SetRealAtomValue(var, 42.0, 0);
+	CU_ASSERT(vs->value[id] == 42.0);
+
+	/* the copies follow the children */
+	SetRealAtomValue(lower, -7.0, 0);
+	CU_ASSERT(vs->lower[id] == -7.0);
+	SetBooleanAtomValue(fixed, 1, 0);
+	CU_ASSERT(vs->flags[id] & VS_FIXED);
+	SetBooleanAtomValue(fixed, 0, 0);
+	CU_ASSERT(!(vs->flags[id] & VS_FIXED));
+	ValueStoreSetFlag(var, VS_ACTIVE, 1);
+	CU_ASSERT(vs->flags[id] & VS_ACTIVE);
+	ValueStoreSetFlag(var, VS_ACTIVE, 0);
+	CU_ASSERT(!(vs->flags[id] & VS_ACTIVE));
+
+	/* detaching leaves the values in the atoms */
+	vs->value[id] = 99.0;
+	ValueStoreDetach(sim);
+	CU_ASSERT(GetValueStore(sim) == NULL);
+	CU_ASSERT(ValueStoreId(var) == -1);
+	CU_ASSERT(RealAtomValue(var) == 99.0);
+	gl_destroy(l);
+
+	/* and a simulation destroyed with its store attached cleans up */
+	ValueStoreAttach(sim);
+	sim_destroy(sim);
+	Asc_CompilerDestroy();
+}
+
+/* compile model 'type' of allmodels.a4c as simulation 'sim1' */
+static struct Instance *valstore_sim(const char *type){
+	int status;
+	struct Instance *sim;
+
+	Asc_CompilerInit(1);
+	Asc_PutEnv(ASC_ENV_LIBRARY "=models");
+
+	Asc_OpenModule("test/reverse_ad/allmodels.a4c", &status);
+	CU_ASSERT(status == 0);
+	CU_ASSERT(0 == zz_parse());
+
+	sim = SimsCreateInstance(AddSymbol(type), AddSymbol("sim1"), e_normal, NULL);
+	if(sim != NULL){
+		Initialize(GetSimulationRoot(sim), CreateIdName(AddSymbol("on_load")), "sim1", ASCERR, 0, NULL, NULL);
+	}
+	return sim;
+}
+
+static void test_merge(void){
+	struct Instance *sim, *root, *x1, *x2, *keep;
+	struct ValueStore *vs;
+	long id1, id2, id, gone;
+
+	sim = valstore_sim("dummy");
+	CU_ASSERT_FATAL(sim != NULL);
+	root = GetSimulationRoot(sim);
+	x1 = ChildByChar(root, AddSymbol("x1"));
+	x2 = ChildByChar(root, AddSymbol("x2"));
+	CU_ASSERT_FATAL(x1 != NULL && x2 != NULL);
+
+	vs = ValueStoreAttach(sim);
+	CU_ASSERT_FATAL(vs != NULL);
+	id1 = ValueStoreId(x1);
+	id2 = ValueStoreId(x2);
+	CU_ASSERT_FATAL(id1 >= 0 && id2 >= 0 && id1 != id2);
+
+	/* the values are in the slots only, so the merge must flush them */
+	vs->value[id1] = 3.5;
+	vs->value[id2] = 3.5;
+	keep = MergeInstances(x1, x2);
+	CU_ASSERT_FATAL(keep == x1 || keep == x2);
+	gone = (keep == x1) ? id2 : id1;
+
+	/* the survivor keeps its slot, refilled from it; the other is emptied */
+	id = ValueStoreId(keep);
+	CU_ASSERT(id == ((keep == x1) ? id1 : id2));
+	CU_ASSERT(vs->atom[id] == keep);
+	CU_ASSERT(vs->value[id] == 3.5);
+	CU_ASSERT(RealAtomValue(keep) == 3.5);
+	CU_ASSERT(vs->atom[gone] == NULL);
+	CU_ASSERT(ChildByChar(root, AddSymbol("x1")) == keep);
+	CU_ASSERT(ChildByChar(root, AddSymbol("x2")) == keep);
+
+	sim_destroy(sim);
+	Asc_CompilerDestroy();
+}
+
+static void test_refine(void){
+	struct Instance *sim, *root, *x1, *x;
+	struct TypeDescription *type;
+	struct ValueStore *vs;
+	long id;
+
+	sim = valstore_sim("dummy");
+	CU_ASSERT_FATAL(sim != NULL);
+	root = GetSimulationRoot(sim);
+	x1 = ChildByChar(root, AddSymbol("x1"));
+	CU_ASSERT_FATAL(x1 != NULL);
+	type = FindType(AddSymbol("positive_factor"));
+	CU_ASSERT_FATAL(type != NULL);
+
+	vs = ValueStoreAttach(sim);
+	CU_ASSERT_FATAL(vs != NULL);
+	id = ValueStoreId(x1);
+	CU_ASSERT_FATAL(id >= 0);
+	vs->value[id] = 2.25;
+
+	/* the refined atom, which may be a new instance, takes over the slot */
+	x = RefineClique(x1, type, NULL);
+	CU_ASSERT_FATAL(x != NULL);
+	CU_ASSERT(InstanceTypeDesc(x) == type);
+	CU_ASSERT(ChildByChar(root, AddSymbol("x1")) == x);
+	CU_ASSERT(ValueStoreId(x) == id);
+	CU_ASSERT(vs->atom[id] == x);
+	CU_ASSERT(vs->value[id] == 2.25);
+	CU_ASSERT(RealAtomValue(x) == 2.25);
+
+	sim_destroy(sim);
+	Asc_CompilerDestroy();
+}
+
+static void test_flags(void){
+	struct Instance *sim, *atom;
+	struct ValueStore *vs;
+	slv_system_t sys;
+	struct var_variable **vlist;
+	int i, nvars, nerr = 0, nboth = 0;
+	unsigned f;
+	long id;
+
+	sim = valstore_sim("allmodels");
+	CU_ASSERT_FATAL(sim != NULL);
+	vs = ValueStoreAttach(sim);
+	CU_ASSERT_FATAL(vs != NULL);
+
+	/* analyze.c copies VAR_INCIDENT and VAR_ACTIVE into the store */
+	sys = system_build(GetSimulationRoot(sim));
+	CU_ASSERT_FATAL(sys != NULL);
+	nvars = slv_get_num_solvers_vars(sys);
+	vlist = slv_get_solvers_var_list(sys);
+	CU_ASSERT(nvars > 0);
+	for(i = 0; i < nvars; i++){
+		atom = var_instance(vlist[i]);
+		id = ValueStoreId(atom);
+		if(id < 0 || vs->atom[id] != atom){
+			nerr++;
+			continue;
+		}
+		f = vs->flags[id];
+		if(!(f & VS_INCLUDED) != !var_incident(vlist[i])
+			|| !(f & VS_ACTIVE) != !var_active(vlist[i])
+		){
+			nerr++;
+		}
+		if((f & VS_INCLUDED) && (f & VS_ACTIVE))nboth++;
+	}
+	CU_ASSERT(nerr == 0);
+	CU_ASSERT(nboth > 0);
+
+	/* and var_set_flagbit keeps them */
+	atom = var_instance(vlist[0]);
+	id = ValueStoreId(atom);
+	var_set_active(vlist[0], 0);
+	CU_ASSERT(!(vs->flags[id] & VS_ACTIVE));
+	var_set_active(vlist[0], 1);
+	CU_ASSERT(vs->flags[id] & VS_ACTIVE);
+
+	system_destroy(sys);
+	sim_destroy(sim);
+	Asc_CompilerDestroy();
+}
+
+/*===========================================================================*/
+/* Registration information */
+
+#define TESTS(T) \
+	T(attach) \
+	T(merge) \
+	T(refine) \
+	T(flags)
+
+REGISTER_TESTS_SIMPLE(compiler_valstore, TESTS)
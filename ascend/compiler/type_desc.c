@@ -1239,7 +1239,7 @@ void CopyTypeDescF(struct TypeDescription *d)
   AssertAllocatedMemory(d,sizeof(struct TypeDescription));
   assert((d->t&ERROR_KIND)==0);
   assert(d->ref_count > 0);
-  d->ref_count++;
+  ASC_ATOMIC_INC(d->ref_count);
 }
 
 void DeleteNewTypeDesc(struct TypeDescription *d){
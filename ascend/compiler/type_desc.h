@@ -413,12 +413,13 @@ ASC_DLLSPEC struct InitProcedure *FindMethod(const struct TypeDescription *d, co
 */
 
 #ifdef NDEBUG
-#define CopyTypeDesc(d) ((d)->ref_count++)
+#define CopyTypeDesc(d) ASC_ATOMIC_INC((d)->ref_count)
 #else
 #define CopyTypeDesc(d) CopyTypeDescF(d)
 #endif
 /**<
-	Increment the reference count.
+	Increment the reference count. This may be done on more than one
+	thread at a time; the other changes to the count may not.
 	@param d CONST struct TypeDescription*, the type description to query.
 	@return No return value.
 	@see CopyTypeDescF()
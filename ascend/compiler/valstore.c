@@ -0,0 +1,223 @@
+/*	ASCEND modelling environment
+	Copyright (C) 2015 Carnegie Mellon University
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2, or (at your option)
+	any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*//** @file
+	Value store of a simulation. See valstore.h.
+*/
+
+#include <float.h>
+
+#include <ascend/general/platform.h>
+#include <ascend/general/ascMalloc.h>
+#include <ascend/general/panic.h>
+#include <ascend/general/list.h>
+
+#include "symtab.h"
+#include "functype.h"
+#include "expr_types.h"
+#include "instance_types.h"
+#include "instmacro.h"
+#include "instquery.h"
+#include "parentchild.h"
+#include "visitinst.h"
+#include "atomvalue.h"
+#include "valstore.h"
+
+/* names of the children mirrored, looked up again by each attach */
+static symchar *g_vs_lower = NULL;
+static symchar *g_vs_upper = NULL;
+static symchar *g_vs_nominal = NULL;
+static symchar *g_vs_fixed = NULL;
+
+/* fill slot id from atom i */
+static void LoadSlot(struct ValueStore *vs, unsigned long id, struct Instance *i)
+{
+  struct Instance *c;
+  vs->value[id] = RA_INST(i)->value;
+  c = ChildByChar(i,g_vs_lower);
+  vs->lower[id] = (c != NULL && c->t == REAL_INST) ? RealAtomValue(c) : -DBL_MAX;
+  c = ChildByChar(i,g_vs_upper);
+  vs->upper[id] = (c != NULL && c->t == REAL_INST) ? RealAtomValue(c) : DBL_MAX;
+  c = ChildByChar(i,g_vs_nominal);
+  vs->nominal[id] = (c != NULL && c->t == REAL_INST) ? RealAtomValue(c) : 1.0;
+  c = ChildByChar(i,g_vs_fixed);
+  if (c != NULL && c->t == BOOLEAN_INST && GetBooleanAtomValue(c)) {
+    vs->flags[id] |= VS_FIXED;
+  } else {
+    vs->flags[id] &= ~VS_FIXED;
+  }
+}
+
+static void GrowStore(struct ValueStore *vs)
+{
+  unsigned long cap = (vs->cap > 0) ? 2*vs->cap : 1024;
+  vs->value = (double *)ascrealloc(vs->value,cap*sizeof(double));
+  vs->lower = (double *)ascrealloc(vs->lower,cap*sizeof(double));
+  vs->upper = (double *)ascrealloc(vs->upper,cap*sizeof(double));
+  vs->nominal = (double *)ascrealloc(vs->nominal,cap*sizeof(double));
+  vs->flags = (unsigned char *)ascrealloc(vs->flags,cap);
+  vs->atom = (struct Instance **)ascrealloc(vs->atom,cap*sizeof(struct Instance *));
+  vs->cap = cap;
+}
+
+static void AttachAtom(struct Instance *i, VOIDPTR ptr)
+{
+  struct ValueStore *vs = (struct ValueStore *)ptr;
+  if (i->t != REAL_ATOM_INST || RA_INST(i)->store != NULL) return;
+  if (vs->n == vs->cap) GrowStore(vs);
+  vs->atom[vs->n] = i;
+  vs->flags[vs->n] = 0;
+  LoadSlot(vs,vs->n,i);
+  RA_INST(i)->store = vs;
+  RA_INST(i)->vid = vs->n;
+  vs->n++;
+}
+
+struct ValueStore *ValueStoreAttach(struct Instance *sim)
+{
+  struct ValueStore *vs;
+  struct Instance *root;
+  assert(sim!=NULL && InstanceKind(sim)==SIM_INST);
+  g_vs_lower = AddSymbol("lower_bound");
+  g_vs_upper = AddSymbol("upper_bound");
+  g_vs_nominal = AddSymbol("nominal");
+  g_vs_fixed = AddSymbol("fixed");
+  vs = SIM_INST(sim)->valstore;
+  if (vs == NULL) {
+    vs = ASC_NEW_CLEAR(struct ValueStore);
+    vs->sim = sim;
+    SIM_INST(sim)->valstore = vs;
+  }
+  root = GetSimulationRoot(sim);
+  if (root != NULL) {
+    SilentVisitInstanceTreeTwo(root,AttachAtom,1,0,(VOIDPTR)vs);
+  }
+  return vs;
+}
+
+void ValueStoreDetach(struct Instance *sim)
+{
+  struct ValueStore *vs;
+  struct Instance *i;
+  unsigned long id;
+  assert(sim!=NULL && InstanceKind(sim)==SIM_INST);
+  vs = SIM_INST(sim)->valstore;
+  if (vs == NULL) return;
+  for (id = 0; id < vs->n; id++) {
+    if ((i = vs->atom[id]) == NULL) continue;
+    RA_INST(i)->value = vs->value[id];
+    RA_INST(i)->store = NULL;
+    RA_INST(i)->vid = 0;
+  }
+  if (vs->cap > 0) {
+    ascfree(vs->value);
+    ascfree(vs->lower);
+    ascfree(vs->upper);
+    ascfree(vs->nominal);
+    ascfree(vs->flags);
+    ascfree(vs->atom);
+  }
+  ascfree(vs);
+  SIM_INST(sim)->valstore = NULL;
+}
+
+struct ValueStore *GetValueStore(CONST struct Instance *sim)
+{
+  assert(sim!=NULL && InstanceKind(sim)==SIM_INST);
+  return SIM_INST(sim)->valstore;
+}
+
+long ValueStoreId(CONST struct Instance *i)
+{
+  assert(i!=NULL);
+  if (i->t != REAL_ATOM_INST || RA_INST(i)->store == NULL) return -1;
+  return (long)RA_INST(i)->vid;
+}
+
+void ValueStoreSetFlag(struct Instance *i, unsigned flag, int on)
+{
+  struct ValueStore *vs;
+  assert(i!=NULL && (flag & ~(VS_INCLUDED|VS_ACTIVE))==0);
+  if (i->t != REAL_ATOM_INST || (vs = RA_INST(i)->store) == NULL) return;
+  if (on) {
+    vs->flags[RA_INST(i)->vid] |= flag;
+  } else {
+    vs->flags[RA_INST(i)->vid] &= ~flag;
+  }
+}
+
+void ValueStoreNoteChild(struct Instance *atom, struct Instance *child)
+{
+  struct ValueStore *vs = RA_INST(atom)->store;
+  unsigned long id = RA_INST(atom)->vid;
+  assert(vs!=NULL);
+  if (child->t == BOOLEAN_INST) {
+    if (child == ChildByChar(atom,g_vs_fixed)) {
+      if (GetBooleanAtomValue(child)) {
+        vs->flags[id] |= VS_FIXED;
+      } else {
+        vs->flags[id] &= ~VS_FIXED;
+      }
+    }
+  } else if (child == ChildByChar(atom,g_vs_lower)) {
+    vs->lower[id] = RealAtomValue(child);
+  } else if (child == ChildByChar(atom,g_vs_upper)) {
+    vs->upper[id] = RealAtomValue(child);
+  } else if (child == ChildByChar(atom,g_vs_nominal)) {
+    vs->nominal[id] = RealAtomValue(child);
+  }
+}
+
+void ValueStoreFlush(struct Instance *atom)
+{
+  if (atom->t == REAL_ATOM_INST && RA_INST(atom)->store != NULL) {
+    RA_INST(atom)->value = RA_INST(atom)->store->value[RA_INST(atom)->vid];
+  }
+}
+
+void ValueStoreMove(struct Instance *from, struct Instance *to)
+{
+  struct ValueStore *vs;
+  unsigned long id;
+  if (from->t != REAL_ATOM_INST || to->t != REAL_ATOM_INST) return;
+  if ((vs = RA_INST(from)->store) != NULL) {
+    if (RA_INST(to)->store == NULL) {
+      id = RA_INST(from)->vid;
+      vs->atom[id] = to;
+      RA_INST(to)->store = vs;
+      RA_INST(to)->vid = id;
+      RA_INST(from)->store = NULL;
+      RA_INST(from)->vid = 0;
+    } else {
+      ValueStoreRelease(from);
+    }
+  }
+  if ((vs = RA_INST(to)->store) != NULL) {
+    LoadSlot(vs,RA_INST(to)->vid,to);
+  }
+}
+
+void ValueStoreRelease(struct Instance *atom)
+{
+  struct ValueStore *vs = RA_INST(atom)->store;
+  unsigned long id;
+  if (vs == NULL) return;
+  id = RA_INST(atom)->vid;
+  RA_INST(atom)->value = vs->value[id];
+  vs->atom[id] = NULL;
+  vs->flags[id] = 0;
+  RA_INST(atom)->store = NULL;
+  RA_INST(atom)->vid = 0;
+}
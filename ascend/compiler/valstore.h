@@ -0,0 +1,139 @@
+/*	ASCEND modelling environment
+	Copyright (C) 2015 Carnegie Mellon University
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2, or (at your option)
+	any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*//**
+	@file
+	Value store: the values of the real atoms of a simulation, kept in
+	arrays rather than in the atoms.
+
+	A solver or integrator that works through var_value() and RealAtomValue()
+	follows a pointer to each atom, and another to each of its bound and
+	nominal children, at every iteration. Once a store is attached to a
+	simulation, each REAL_ATOM_INST in it has a slot, by a var id that
+	doesn't change while the store exists, and whole state vectors can be
+	read and written with plain loops over the arrays here.
+
+	While an atom has a slot, value[id] IS its value: RealAtomValue() and
+	SetRealAtomValue() use the slot, and a client may write value[] directly
+	(without the assignment count and depth that SetRealAtomValue keeps).
+	lower[], upper[], nominal[] and the VS_FIXED flag are copies of the
+	lower_bound, upper_bound, nominal and fixed children of the atom, kept
+	up to date by SetRealAtomValue() and SetBooleanAtomValue() on those
+	children, so they are to be read only: set them through the children
+	(var_set_lower_bound() etc). VS_INCLUDED and VS_ACTIVE are copies of the
+	VAR_INCIDENT and VAR_ACTIVE flags of the var over the atom in the last
+	slv_system built, kept by analyze.c and var_set_flagbit(). A solver
+	finds the slot of a var by ValueStoreId(var_instance(var)).
+
+	Atoms made after the store is attached have no slot until
+	ValueStoreAttach() is called again, which adds them at the end. The
+	slot of an atom that is destroyed is left empty (atom[id] is NULL);
+	ids are not reused. Refining or merging atoms keeps the slot.
+*/
+
+#ifndef ASC_VALSTORE_H
+#define ASC_VALSTORE_H
+
+/**	@addtogroup compiler_inst Compiler Instance Hierarchy
+	@{
+*/
+
+#include <ascend/general/platform.h>
+#include "instance_enum.h"
+
+/* flag bits */
+#define VS_FIXED    0x1 /**< the fixed child of the atom is TRUE */
+#define VS_INCLUDED 0x2 /**< incident on a relation of the system (VAR_INCIDENT) */
+#define VS_ACTIVE   0x4 /**< active in the system (VAR_ACTIVE) */
+
+struct ValueStore {
+  unsigned long n;          /**< number of slots, ids 0..n-1 */
+  unsigned long cap;        /**< space allocated in each array */
+  double *value;            /**< values of the atoms */
+  double *lower;            /**< lower_bound children (-DBL_MAX if none) */
+  double *upper;            /**< upper_bound children (DBL_MAX if none) */
+  double *nominal;          /**< nominal children (1.0 if none) */
+  unsigned char *flags;     /**< VS_ bits */
+  struct Instance **atom;   /**< the atom of each slot, NULL if destroyed */
+  struct Instance *sim;     /**< the simulation attached to */
+};
+
+ASC_DLLSPEC struct ValueStore *ValueStoreAttach(struct Instance *sim);
+/**<
+	Give each REAL_ATOM_INST in the simulation sim a slot in its value store,
+	making the store if it has none. Atoms with slots already keep them, so
+	this may be called again to add atoms made since. Atoms shared with
+	another simulation that has a store (UNIVERSAL ones) stay in that one.
+
+	@return the store, whose arrays may have moved if slots were added.
+*/
+
+ASC_DLLSPEC void ValueStoreDetach(struct Instance *sim);
+/**<
+	Put the values held in the store of simulation sim back in the atoms and
+	destroy the store. Nothing happens if sim has no store. This is done by
+	DestroyInstance of the simulation.
+*/
+
+ASC_DLLSPEC struct ValueStore *GetValueStore(CONST struct Instance *sim);
+/**<
+	@return the value store of simulation sim, or NULL if it has none.
+*/
+
+ASC_DLLSPEC long ValueStoreId(CONST struct Instance *i);
+/**<
+	@return the var id of real atom i in its value store, or -1 if it has no
+	slot.
+*/
+
+ASC_DLLSPEC void ValueStoreSetFlag(struct Instance *i, unsigned flag, int on);
+/**<
+	Set (on != 0) or clear the VS_INCLUDED or VS_ACTIVE flag of real atom i,
+	if it has a slot.
+*/
+
+/*
+	The following keep the slots straight as the compiler changes atoms.
+	They do nothing to atoms without slots.
+*/
+
+extern void ValueStoreNoteChild(struct Instance *atom, struct Instance *child);
+/**<
+	Copy the value of child into the store, if it is one of the children
+	of real atom atom that are mirrored there. Called when child is
+	assigned, and only if atom has a slot.
+*/
+
+extern void ValueStoreFlush(struct Instance *atom);
+/**<
+	Copy the value in the slot of real atom atom into the atom itself, for
+	code that reads the field directly.
+*/
+
+extern void ValueStoreMove(struct Instance *from, struct Instance *to);
+/**<
+	Give the slot of from (if any) to to, which replaces it in the tree (by
+	refinement or merging), and refill the slot from to. If both have slots,
+	the slot of from is emptied and that of to refilled. Flush from first.
+*/
+
+extern void ValueStoreRelease(struct Instance *atom);
+/**<
+	Empty the slot of real atom atom, which is being destroyed.
+*/
+
+/* @} */
+
+#endif /* ASC_VALSTORE_H */
@@ -76,6 +76,8 @@ static const unsigned long MIN_INCREMENT = 8;
  * If LISTRECYCLERDEBUG,
  *    HighWaterMark[i] is the most of capacity i ever recycled.
  *    ListsDestroyed[i] is likewise lists not recycled because full.
+ *
+ * Each thread has its own recycler (but they share AllowedContents).
  */
 #define LISTRECYCLERDEBUG 0
 #define MAXRECYCLESIZE 500	/* the maximum list size to be recycled */
@@ -85,8 +87,8 @@ static const unsigned long MIN_INCREMENT = 8;
 /* search performance. 0 and 2 are best values, 2 slightly better. alphaosf2 */
 #define LARGEITEM 21		 /* smallest large item */
 /* note: baa, 3/8/96 LARGEITEM and MAXRECYCLELARGEITEMS not in use yet */
-static struct gl_list_t *RecycledList[MAXRECYCLESIZE+1];
-static int RecycledContents[MAXRECYCLESIZE+1];
+static ASC_THREAD_LOCAL struct gl_list_t *RecycledList[MAXRECYCLESIZE+1];
+static ASC_THREAD_LOCAL int RecycledContents[MAXRECYCLESIZE+1];
 static int AllowedContents[MAXRECYCLESIZE+1];
 /*
  * It is assumed that these arrays are initialized to zero according to the
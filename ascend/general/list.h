@@ -814,6 +814,8 @@ ASC_DLLSPEC void gl_emptyrecycler(void);
  *  to time.  The most appropriate time for this is before shutdown and
  *  perhaps after an instantiation.  If LISTRECYCLERDEBUG is defined, a
  *  summary of the recycler status is also reported on stdout.
+ *  Each thread has its own recycler, which this empties; a thread that
+ *  has used lists should call it before it exits.
  */
 
 extern void gl_reportrecycler(FILE *fp);
@@ -161,6 +161,51 @@
 # define NORETURN /* nothing */
 #endif
 
+/**
+	Define 'ASC_THREAD_LOCAL' to the compiler-specific storage class for
+	static data that each thread must have its own copy of, and define
+	ASC_HAVE_THREAD_LOCAL if there is one. Where there is no such thing,
+	ASC_THREAD_LOCAL is empty and such data is shared as before, so
+	utilities/ascTask.c then runs everything on the calling thread.
+
+	Apple's gcc 4.x has no __thread; clang has it where the target
+	supports TLS, which it tells us through __has_feature(tls).
+*/
+#if defined(__APPLE__)
+# if defined(__clang__) && defined(__has_feature)
+#  if __has_feature(tls)
+#   define ASC_THREAD_LOCAL __thread
+#  endif
+# endif
+#elif defined(__GNUC__)
+# define ASC_THREAD_LOCAL __thread
+#elif defined(_MSC_VER)
+# define ASC_THREAD_LOCAL __declspec(thread)
+#endif
+#if !defined(ASC_THREAD_LOCAL) && defined(__STDC_VERSION__) \
+	&& __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_THREADS__)
+# define ASC_THREAD_LOCAL _Thread_local
+#endif
+#ifdef ASC_THREAD_LOCAL
+# define ASC_HAVE_THREAD_LOCAL
+#else
+# define ASC_THREAD_LOCAL /* nothing */
+#endif
+
+/**
+	Add one to an integer that other threads may be adding to at the same
+	time. Where there is no atomic builtin, this is a plain increment, and
+	as where ASC_THREAD_LOCAL is empty, the code using it must then not be
+	run on more than one thread.
+*/
+#if defined(__GNUC__)
+# define ASC_ATOMIC_INC(x) ((void)__sync_fetch_and_add(&(x),1))
+#elif defined(_MSC_VER)
+# define ASC_ATOMIC_INC(x) ((void)_InterlockedIncrement((long volatile *)&(x)))
+#else
+# define ASC_ATOMIC_INC(x) ((void)((x)++))
+#endif
+
 /*
  *  Make certain we have proper limits defined
  */
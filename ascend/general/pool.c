@@ -30,6 +30,7 @@
 #include "platform.h"
 #include "ascMalloc.h"
 #include "pool.h"
+#include <ascend/utilities/ascTask.h>
 
 #ifndef FALSE
 #define FALSE 0
@@ -112,6 +113,7 @@ struct pool_store_header {
   int highwater;     /* fresh elements turned loose from store */
   int inuse;         /* current elts user has outstanding */
 #endif
+  asc_mutex_t lock;  /* taken between pool_threads_begin and _end */
 };
 /* notes on header:
  * list is, as currently coded, null terminated by accident.
@@ -128,6 +130,23 @@ struct pool_store_header {
 #define PMEM_MINPOOLGROW 256
 #endif
 
+/*
+ * Nonzero while stores may be used by several threads at once
+ * (pool_threads_begin), when getting and freeing elements is locked.
+ * Otherwise the locks are left alone, as they cost more than the rest.
+ */
+static int g_pool_threads = 0;
+
+void pool_threads_begin(void)
+{
+  g_pool_threads++;
+}
+
+void pool_threads_end(void)
+{
+  g_pool_threads--;
+}
+
 /*
 Returns 2 if really bad, 1 if something fishy, 0 otherwise.
 */
@@ -186,7 +205,7 @@ static int check_pool_store(const pool_store_t ps)
 */
 static int expand_store(pool_store_t ps, int incr)
 {
-  static int oldsize, newsize,punt,i;
+  int oldsize, newsize,punt,i;
   char **newpool = NULL;
   if (check_pool_store(ps) >1) {
     ERROR_REPORTER_HERE(ASC_PROG_ERR,"expand_store received bad pool_store_t. Expansion failed.");
@@ -385,6 +404,7 @@ pool_store_t pool_create_store(int length, int width,
 #endif
   newps->growpool = PMX(PMEM_MINPOOLGROW,deltapool);
   newps->eltsize_req = uelt;
+  newps->lock = asc_mutex_create();
 
   /* get pool */
   newps->pool = (char **)PMEM_calloc(length,sizeof(char *));
@@ -419,16 +439,12 @@ pool_store_t pool_create_store(int length, int width,
   return newps;
 }
 
-void *pool_get_element(pool_store_t ps)
+static void *get_element(pool_store_t ps)
 {
   /* no automatic variables please */
   register struct pool_element *elt;
   /* in a test on the alpha, though, making elt static global slowed it */
 
-  if (ISNULL(ps)) {
-    ERROR_REPORTER_HERE(ASC_PROG_ERR,"Called with NULL store.");
-    return NULL;
-  }
   /* recycling */
   if (ps->onlist) {
     elt = ps->list; /* get last element put into list */
@@ -469,6 +485,22 @@ void *pool_get_element(pool_store_t ps)
   return (void *)elt;
 }
 
+void *pool_get_element(pool_store_t ps)
+{
+  void *elt;
+  if (ISNULL(ps)) {
+    ERROR_REPORTER_HERE(ASC_PROG_ERR,"Called with NULL store.");
+    return NULL;
+  }
+  if (!g_pool_threads) {
+    return get_element(ps);
+  }
+  asc_mutex_lock(ps->lock);
+  elt = get_element(ps);
+  asc_mutex_unlock(ps->lock);
+  return elt;
+}
+
 void pool_get_element_list(pool_store_t ps, int nelts, void **ary)
 {
   ERROR_REPORTER_HERE(ASC_PROG_ERR,"NOT implemented");
@@ -510,6 +542,9 @@ void pool_free_elementF(pool_store_t ps, void *ptr
 #endif
 
   /* recycle him */
+  if (g_pool_threads) {
+    asc_mutex_lock(ps->lock);
+  }
   elt->nextelt = ps->list; /* push onto list */
   /* first one in will pick up the null list starts as */
   ps->list = elt;
@@ -526,6 +561,9 @@ void pool_free_elementF(pool_store_t ps, void *ptr
 #endif
   }
 #endif
+  if (g_pool_threads) {
+    asc_mutex_unlock(ps->lock);
+  }
   return;
 }
 
@@ -592,6 +630,7 @@ void pool_destroy_store(pool_store_t ps)
     PMEM_free(ps->pool[i]);
   }
   PMEM_free(ps->pool);
+  asc_mutex_destroy(ps->lock);
   ps->integrity = DESTROYED;
   PMEM_free(ps);
   return;
@@ -314,6 +314,21 @@ ASC_DLLSPEC void pool_free_elementF(pool_store_t ps, void * eltpointer
  *  Do not call this function directly - use pool_free_element() instead.
  */
 
+ASC_DLLSPEC void pool_threads_begin(void);
+/**<
+ *  From now until the matching pool_threads_end, any store may be used
+ *  by several threads at once: pool_get_element() and
+ *  pool_free_element() lock the store. Calls may nest. Call these on the
+ *  one thread, when no other thread is using any store. Stores must
+ *  still not be created, cleared or destroyed while another thread uses
+ *  them.
+ */
+
+ASC_DLLSPEC void pool_threads_end(void);
+/**<
+ *  Ends the sharing begun by pool_threads_begin().
+ */
+
 #if pool_DEBUG
 #define pool_clear_store(ps) pool_clear_storeF((ps),__FILE__)
 #else
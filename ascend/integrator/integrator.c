@@ -146,6 +146,8 @@ IntegratorSystem *integrator_new(slv_system_t slvsys, struct Instance *inst){
 	sys->ydot = NULL;
 	sys->obs = NULL;
 	sys->n_y = 0;
+	sys->vs = NULL;
+	sys->y_vs = NULL; sys->ydot_vs = NULL; sys->obs_vs = NULL;
 	return sys;
 }
 
@@ -176,6 +178,9 @@ void integrator_free(IntegratorSystem *sys){
 	if(sys->y != NULL)ASC_FREE(sys->y);
 	if(sys->ydot != NULL)ASC_FREE(sys->ydot);
 	if(sys->obs != NULL)ASC_FREE(sys->obs);
+	if(sys->y_vs != NULL)ASC_FREE(sys->y_vs);
+	if(sys->ydot_vs != NULL)ASC_FREE(sys->ydot_vs);
+	if(sys->obs_vs != NULL)ASC_FREE(sys->obs_vs);
 
 	slv_destroy_parms(&(sys->params));
 
@@ -490,6 +495,55 @@ int integrator_find_indep_var(IntegratorSystem *sys){
 	return result;
 }
 
+/**
+	Find the slots of the vars in a[0..n-1] in store vs, or -1 for those
+	without one (NULL entries, or atoms kept in another simulation's store).
+*/
+static long *integrator_store_slots(struct ValueStore *vs
+		, struct var_variable **a, long n
+){
+	long i, id, *slot;
+	struct Instance *inst;
+
+	slot = ASC_NEW_ARRAY(long, n+1);
+	for(i=0; i<n; i++){
+		slot[i] = -1;
+		if(a[i]==NULL)continue;
+		inst = var_instance(a[i]);
+		id = ValueStoreId(inst);
+		if(id >= 0 && (unsigned long)id < vs->n && vs->atom[id]==inst){
+			slot[i] = id;
+		}
+	}
+	return slot;
+}
+
+/**
+	Attach a value store to the simulation holding sys->instance, and find
+	the slots of y, ydot and obs in it, so that integrator_get_y and friends
+	can move whole state vectors without going through the atoms. If the
+	instance is not part of a simulation, the vars are used as before.
+*/
+static void integrator_attach_store(IntegratorSystem *sys){
+	struct Instance *sim = sys->instance;
+
+	if(sys->y_vs != NULL)ASC_FREE(sys->y_vs);
+	if(sys->ydot_vs != NULL)ASC_FREE(sys->ydot_vs);
+	if(sys->obs_vs != NULL)ASC_FREE(sys->obs_vs);
+	sys->y_vs = sys->ydot_vs = sys->obs_vs = NULL;
+	sys->vs = NULL;
+
+	while(sim != NULL && InstanceKind(sim) != SIM_INST){
+		sim = NumberParents(sim) ? InstanceParent(sim,1) : NULL;
+	}
+	if(sim == NULL)return;
+
+	sys->vs = ValueStoreAttach(sim);
+	if(sys->y != NULL)sys->y_vs = integrator_store_slots(sys->vs, sys->y, sys->n_y);
+	if(sys->ydot != NULL)sys->ydot_vs = integrator_store_slots(sys->vs, sys->ydot, sys->n_y);
+	if(sys->obs != NULL)sys->obs_vs = integrator_store_slots(sys->vs, sys->obs, sys->n_obs);
+}
+
 /**
 	Perform whatever additional problem is required so that the system can be
 	integrated as a dynamical system with the IntegrationEngine chosen.
@@ -526,6 +580,9 @@ int integrator_analyse(IntegratorSystem *sys){
 	}
 
 	res = (sys->internals->analysefn)(sys);
+	if(!res){
+		integrator_attach_store(sys);
+	}
 #ifdef ANALYSE_DEBUG
 	CONSOLE_DEBUG("integrator_analyse returning %d",res);
 #endif
@@ -1195,7 +1252,8 @@ double *integrator_get_y(IntegratorSystem *sys, double *y) {
 
   for (i=0; i< sys->n_y; i++) {
 	asc_assert(sys->y[i]!=NULL);
-    y[i] = var_value(sys->y[i]);
+    y[i] = (sys->y_vs && sys->y_vs[i] >= 0) ? sys->vs->value[sys->y_vs[i]]
+      : var_value(sys->y[i]);
     /* CONSOLE_DEBUG("ASCEND --> y[%ld] = %g", i+1, y[i]); */
   }
   return y;
@@ -1214,7 +1272,11 @@ void integrator_set_y(IntegratorSystem *sys, double *y) {
 
   for (i=0; i < sys->n_y; i++) {
 	asc_assert(sys->y[i]!=NULL);
-    var_set_value(sys->y[i],y[i]);
+    if (sys->y_vs && sys->y_vs[i] >= 0) {
+      sys->vs->value[sys->y_vs[i]] = y[i];
+    } else {
+      var_set_value(sys->y[i],y[i]);
+    }
 #ifdef SOLVE_DEBUG
 	varname = var_make_name(sys->system, sys->y[i]);
 	CONSOLE_DEBUG("y[%ld] = %g --> '%s'", i+1, y[i], varname);
@@ -1240,7 +1302,8 @@ double *integrator_get_ydot(IntegratorSystem *sys, double *dydx) {
 
   for (i=0; i < sys->n_y; i++) {
     if(sys->ydot[i]!=NULL){
-		dydx[i] = var_value(sys->ydot[i]);
+		dydx[i] = (sys->ydot_vs && sys->ydot_vs[i] >= 0)
+			? sys->vs->value[sys->ydot_vs[i]] : var_value(sys->ydot[i]);
 	}
     /* CONSOLE_DEBUG("ASCEND --> ydot[%ld] = %g", i+1, dydx[i]); */
   }
@@ -1254,7 +1317,11 @@ void integrator_set_ydot(IntegratorSystem *sys, double *dydx) {
 #endif
 	for (i=0; i < sys->n_y; i++) {
 		if(sys->ydot[i]!=NULL){
-    		var_set_value(sys->ydot[i],dydx[i]);
+			if(sys->ydot_vs && sys->ydot_vs[i] >= 0){
+				sys->vs->value[sys->ydot_vs[i]] = dydx[i];
+			}else{
+				var_set_value(sys->ydot[i],dydx[i]);
+			}
 #ifdef SOLVE_DEBUG
 			varname = var_make_name(sys->system, sys->ydot[i]);
 			CONSOLE_DEBUG("ydot[%ld] = \"%s\" = %g --> ASCEND", i+1, varname, dydx[i]);
@@ -1314,7 +1381,8 @@ double *integrator_get_observations(IntegratorSystem *sys, double *obsi) {
   /* C obsi[0]  <==> ascend d.obs[1] */
 
   for (i=0; i < sys->n_obs; i++) {
-    obsi[i] = var_value(sys->obs[i]);
+    obsi[i] = (sys->obs_vs && sys->obs_vs[i] >= 0) ? sys->vs->value[sys->obs_vs[i]]
+      : var_value(sys->obs[i]);
     /* CONSOLE_DEBUG("*get_d_obs[%ld] = %g\n", i+1, obsi[i]); */
   }
   return obsi;
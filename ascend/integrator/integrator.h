@@ -60,6 +60,7 @@
 #include <ascend/compiler/parentchild.h>
 #include <ascend/compiler/instquery.h>
 #include <ascend/compiler/atomvalue.h>
+#include <ascend/compiler/valstore.h>
 
 #include <ascend/linear/mtx.h>
 
@@ -265,6 +266,10 @@ struct IntegratorSystemStruct{
   struct var_variable **obs;  /**< array form of observed variables */
   int *y_id;                  /**< array form of y/ydot user indices, for DAEs we use negatives here for derivative vars */
   int *obs_id;                /**< array form of obs user indices */
+  struct ValueStore *vs;      /**< value store of the simulation (see valstore.h), NULL if none */
+  long *y_vs;                 /**< slots of y in vs, -1 where a var has none */
+  long *ydot_vs;              /**< slots of ydot in vs, -1 where a var has none */
+  long *obs_vs;               /**< slots of obs in vs, -1 where a var has none */
   int n_y;
   int n_ydot;
   int n_obs;
@@ -0,0 +1,729 @@
+/*	ASCEND modelling environment
+	Copyright (C) 2015 Carnegie Mellon University
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2, or (at your option)
+	any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*//**
+	@file
+	Observation files; see obsfile.h for the layout.
+
+	File offsets are 64 bits even where a long is 32 (as on Windows), so
+	files may grow past 2 GB.
+*/
+
+#ifndef _FILE_OFFSET_BITS
+# define _FILE_OFFSET_BITS 64 /* for fseeko and ftello on 32-bit systems */
+#endif
+
+#include "obsfile.h"
+
+#include <string.h>
+#include <stdint.h>
+
+#include <ascend/general/ascMalloc.h>
+#include <ascend/general/panic.h>
+#include <ascend/general/mathmacros.h>
+#include <ascend/utilities/error.h>
+#include <ascend/system/var.h>
+
+typedef int64_t obsfile_off_t;
+
+#ifdef __WIN32__
+# define OBSFILE_SEEK(FP,OFF) _fseeki64((FP),(OFF),SEEK_SET)
+# define OBSFILE_SEEK_END(FP) _fseeki64((FP),0,SEEK_END)
+# define OBSFILE_TELL(FP) ((obsfile_off_t)_ftelli64(FP))
+#else
+# include <sys/types.h>
+# define OBSFILE_SEEK(FP,OFF) fseeko((FP),(off_t)(OFF),SEEK_SET)
+# define OBSFILE_SEEK_END(FP) fseeko((FP),0,SEEK_END)
+# define OBSFILE_TELL(FP) ((obsfile_off_t)ftello(FP))
+#endif
+
+/* #define OBSFILE_DEBUG */
+
+#define OBSFILE_MAGIC "ASCOBS\0\1"
+#define OBSFILE_CHUNK_MAGIC "CHNK"
+#define OBSFILE_INDEX_MAGIC "ASCOBSIX"
+#define OBSFILE_TRAILER_MAGIC "ASCOBSTR"
+
+#define OBSFILE_MAX_CHUNK 65536L
+#define OBSFILE_TRAILER_BYTES 24
+#define OBSFILE_INDEX_ENTRY_BYTES 20
+
+/* worst case for a compressed double: the count byte and all 8 */
+#define OBSFILE_MAX_VALUE_BYTES 9
+
+struct ObsFileChunk{
+	obsfile_off_t offset;  /* of the "CHNK" */
+	long first;   /* row number of its first row */
+	long nrows;
+};
+
+struct ObsFileStruct{
+	FILE *fp;
+	int writing;
+	int flags;
+	int ncols;
+	long chunk;
+	char **names;
+	long nrows;
+
+	struct ObsFileChunk *index;
+	long nchunks, capchunks;
+
+	double *buf;          /* writing: the rows of this chunk, by col */
+	long nbuf;
+	unsigned char *block; /* encoded col block, read or written */
+	double *vals;         /* reading: a decoded col block */
+};
+
+/*------------------------------------------------------------------------------
+  ENCODING
+*/
+
+static void obsfile_put_u32(unsigned char *p, uint32_t v){
+	int i;
+	for(i = 0; i < 4; ++i){
+		p[i] = (unsigned char)(v >> (8 * i));
+	}
+}
+
+static void obsfile_put_u64(unsigned char *p, uint64_t v){
+	int i;
+	for(i = 0; i < 8; ++i){
+		p[i] = (unsigned char)(v >> (8 * i));
+	}
+}
+
+static uint32_t obsfile_get_u32(const unsigned char *p){
+	uint32_t v = 0;
+	int i;
+	for(i = 3; i >= 0; --i){
+		v = (v << 8) | p[i];
+	}
+	return v;
+}
+
+static uint64_t obsfile_get_u64(const unsigned char *p){
+	uint64_t v = 0;
+	int i;
+	for(i = 7; i >= 0; --i){
+		v = (v << 8) | p[i];
+	}
+	return v;
+}
+
+static uint64_t obsfile_bits(double x){
+	uint64_t u;
+	memcpy(&u, &x, sizeof(u));
+	return u;
+}
+
+static double obsfile_double(uint64_t u){
+	double x;
+	memcpy(&x, &u, sizeof(x));
+	return x;
+}
+
+/**
+	Encode n values into p, which must have room for n*9 bytes.
+	@return the number of bytes used
+*/
+static long obsfile_encode(const double *x, long n, int flags, unsigned char *p){
+	uint64_t prev = 0, u, v;
+	long i, k = 0;
+	int lz, tz, b;
+
+	if(!(flags & OBSFILE_COMPRESS)){
+		for(i = 0; i < n; ++i){
+			obsfile_put_u64(p + 8 * i, obsfile_bits(x[i]));
+		}
+		return 8 * n;
+	}
+	for(i = 0; i < n; ++i){
+		u = obsfile_bits(x[i]);
+		v = u ^ prev;
+		prev = u;
+		if(v == 0){
+			p[k++] = 0x80;
+			continue;
+		}
+		for(lz = 0; ((v >> (8 * (7 - lz))) & 0xff) == 0; ++lz);
+		for(tz = 0; ((v >> (8 * tz)) & 0xff) == 0; ++tz);
+		p[k++] = (unsigned char)((lz << 4) | tz);
+		for(b = 7 - lz; b >= tz; --b){
+			p[k++] = (unsigned char)(v >> (8 * b));
+		}
+	}
+	return k;
+}
+
+/**
+	Decode n values from the len bytes at p.
+	@return 0 on success, 1 if the block is corrupt
+*/
+static int obsfile_decode(const unsigned char *p, long len, int flags
+	, long n, double *x
+){
+	uint64_t prev = 0, v;
+	long i, k = 0;
+	int lz, tz, b;
+
+	if(!(flags & OBSFILE_COMPRESS)){
+		if(len != 8 * n)return 1;
+		for(i = 0; i < n; ++i){
+			x[i] = obsfile_double(obsfile_get_u64(p + 8 * i));
+		}
+		return 0;
+	}
+	for(i = 0; i < n; ++i){
+		if(k >= len)return 1;
+		lz = p[k] >> 4;
+		tz = p[k] & 0x0f;
+		k++;
+		if(lz + tz > 8 || k + 8 - lz - tz > len)return 1;
+		v = 0;
+		for(b = 7 - lz; b >= tz; --b){
+			v |= (uint64_t)p[k++] << (8 * b);
+		}
+		prev ^= v;
+		x[i] = obsfile_double(prev);
+	}
+	return k != len;
+}
+
+/*------------------------------------------------------------------------------
+  COMMON
+*/
+
+static void obsfile_free(ObsFile *f){
+	int c;
+	if(f->fp != NULL)fclose(f->fp);
+	if(f->names != NULL){
+		for(c = 0; c < f->ncols; ++c){
+			if(f->names[c] != NULL)ASC_FREE(f->names[c]);
+		}
+		ASC_FREE(f->names);
+	}
+	if(f->index != NULL)ASC_FREE(f->index);
+	if(f->buf != NULL)ASC_FREE(f->buf);
+	if(f->block != NULL)ASC_FREE(f->block);
+	if(f->vals != NULL)ASC_FREE(f->vals);
+	ASC_FREE(f);
+}
+
+static int obsfile_add_chunk(ObsFile *f, obsfile_off_t offset, long first
+	, long nrows
+){
+	struct ObsFileChunk *index;
+	if(f->nchunks == f->capchunks){
+		f->capchunks = MAX(16, 2 * f->capchunks);
+		index = (struct ObsFileChunk *)ascrealloc(f->index
+			, f->capchunks * sizeof(struct ObsFileChunk)
+		);
+		if(index == NULL)return 1;
+		f->index = index;
+	}
+	f->index[f->nchunks].offset = offset;
+	f->index[f->nchunks].first = first;
+	f->index[f->nchunks].nrows = nrows;
+	f->nchunks++;
+	return 0;
+}
+
+int obsfile_ncols(const ObsFile *f){
+	asc_assert(f != NULL);
+	return f->ncols;
+}
+
+long obsfile_nrows(const ObsFile *f){
+	asc_assert(f != NULL);
+	return f->nrows;
+}
+
+const char *obsfile_name(const ObsFile *f, int col){
+	asc_assert(f != NULL);
+	if(col < 0 || col >= f->ncols)return NULL;
+	return f->names[col];
+}
+
+int obsfile_find(const ObsFile *f, const char *name){
+	int c;
+	asc_assert(f != NULL && name != NULL);
+	for(c = 0; c < f->ncols; ++c){
+		if(strcmp(f->names[c], name) == 0)return c;
+	}
+	return -1;
+}
+
+/*------------------------------------------------------------------------------
+  WRITING
+*/
+
+ObsFile *obsfile_create(const char *filename, int ncols
+	, const char **names, long chunk, int flags
+){
+	ObsFile *f;
+	unsigned char head[20];
+	size_t len;
+	int c;
+
+	asc_assert(filename != NULL && ncols > 0);
+	if(chunk <= 0){
+		chunk = OBSFILE_BUFFER_BYTES / ((long)sizeof(double) * ncols);
+	}
+	chunk = MAX(1, MIN(chunk, OBSFILE_MAX_CHUNK));
+
+	f = ASC_NEW_CLEAR(ObsFile);
+	if(f == NULL)return NULL;
+	f->writing = 1;
+	f->flags = flags & OBSFILE_COMPRESS;
+	f->ncols = ncols;
+	f->chunk = chunk;
+	f->names = ASC_NEW_ARRAY_CLEAR(char *, ncols);
+	f->buf = ASC_NEW_ARRAY(double, ncols * chunk);
+	f->block = ASC_NEW_ARRAY(unsigned char, OBSFILE_MAX_VALUE_BYTES * chunk);
+	if(f->names == NULL || f->buf == NULL || f->block == NULL){
+		obsfile_free(f);
+		return NULL;
+	}
+	for(c = 0; c < ncols; ++c){
+		f->names[c] = ASC_STRDUP((names != NULL && names[c] != NULL) ? names[c] : "");
+		if(f->names[c] == NULL){
+			obsfile_free(f);
+			return NULL;
+		}
+	}
+
+	f->fp = fopen(filename, "wb");
+	if(f->fp == NULL){
+		ERROR_REPORTER_HERE(ASC_USER_ERROR,"Unable to create observation file '%s'",filename);
+		obsfile_free(f);
+		return NULL;
+	}
+	memcpy(head, OBSFILE_MAGIC, 8);
+	obsfile_put_u32(head + 8, (uint32_t)f->flags);
+	obsfile_put_u32(head + 12, (uint32_t)ncols);
+	obsfile_put_u32(head + 16, (uint32_t)chunk);
+	if(fwrite(head, 20, 1, f->fp) != 1){
+		obsfile_free(f);
+		return NULL;
+	}
+	for(c = 0; c < ncols; ++c){
+		len = strlen(f->names[c]);
+		obsfile_put_u32(head, (uint32_t)len);
+		if(fwrite(head, 4, 1, f->fp) != 1
+			|| (len > 0 && fwrite(f->names[c], len, 1, f->fp) != 1)
+		){
+			obsfile_free(f);
+			return NULL;
+		}
+	}
+#ifdef OBSFILE_DEBUG
+	CONSOLE_DEBUG("'%s': %d cols, %ld rows per chunk",filename,ncols,chunk);
+#endif
+	return f;
+}
+
+int obsfile_flush(ObsFile *f){
+	unsigned char head[8];
+	obsfile_off_t offset, tablepos, end;
+	long len;
+	int c;
+
+	asc_assert(f != NULL && f->writing);
+	if(f->nbuf == 0)return 0;
+
+	/* the table of block lengths is filled in once they are known */
+	offset = OBSFILE_TELL(f->fp);
+	memcpy(head, OBSFILE_CHUNK_MAGIC, 4);
+	obsfile_put_u32(head + 4, (uint32_t)f->nbuf);
+	if(offset < 0 || fwrite(head, 8, 1, f->fp) != 1)return 1;
+	tablepos = offset + 8;
+	memset(f->block, 0, 8);
+	for(c = 0; c < f->ncols; ++c){
+		if(fwrite(f->block, 8, 1, f->fp) != 1)return 1;
+	}
+	for(c = 0; c < f->ncols; ++c){
+		len = obsfile_encode(f->buf + c * f->chunk, f->nbuf, f->flags, f->block);
+		if(fwrite(f->block, len, 1, f->fp) != 1)return 1;
+		end = OBSFILE_TELL(f->fp);
+		obsfile_put_u64(head, (uint64_t)len);
+		if(end < 0 || OBSFILE_SEEK(f->fp, tablepos + 8 * c)
+			|| fwrite(head, 8, 1, f->fp) != 1
+			|| OBSFILE_SEEK(f->fp, end)
+		){
+			return 1;
+		}
+	}
+	if(obsfile_add_chunk(f, offset, f->nrows - f->nbuf, f->nbuf))return 1;
+	f->nbuf = 0;
+	return fflush(f->fp) != 0;
+}
+
+int obsfile_append(ObsFile *f, const double *row){
+	int c;
+	asc_assert(f != NULL && f->writing && row != NULL);
+	for(c = 0; c < f->ncols; ++c){
+		f->buf[c * f->chunk + f->nbuf] = row[c];
+	}
+	f->nbuf++;
+	f->nrows++;
+	if(f->nbuf == f->chunk){
+		return obsfile_flush(f);
+	}
+	return 0;
+}
+
+static int obsfile_finish(ObsFile *f){
+	unsigned char entry[OBSFILE_TRAILER_BYTES];
+	obsfile_off_t offset;
+	long i;
+
+	if(obsfile_flush(f))return 1;
+	offset = OBSFILE_TELL(f->fp);
+	memcpy(entry, OBSFILE_INDEX_MAGIC, 8);
+	obsfile_put_u64(entry + 8, (uint64_t)f->nchunks);
+	if(offset < 0 || fwrite(entry, 16, 1, f->fp) != 1)return 1;
+	for(i = 0; i < f->nchunks; ++i){
+		obsfile_put_u64(entry, (uint64_t)f->index[i].offset);
+		obsfile_put_u64(entry + 8, (uint64_t)f->index[i].first);
+		obsfile_put_u32(entry + 16, (uint32_t)f->index[i].nrows);
+		if(fwrite(entry, OBSFILE_INDEX_ENTRY_BYTES, 1, f->fp) != 1)return 1;
+	}
+	obsfile_put_u64(entry, (uint64_t)offset);
+	obsfile_put_u64(entry + 8, (uint64_t)f->nrows);
+	memcpy(entry + 16, OBSFILE_TRAILER_MAGIC, 8);
+	if(fwrite(entry, OBSFILE_TRAILER_BYTES, 1, f->fp) != 1)return 1;
+	return 0;
+}
+
+int obsfile_close(ObsFile *f){
+	int res = 0;
+	asc_assert(f != NULL);
+	if(f->writing){
+		res = obsfile_finish(f);
+		if(fclose(f->fp))res = 1;
+		f->fp = NULL;
+		if(res){
+			ERROR_REPORTER_HERE(ASC_USER_ERROR,"Error writing observation file");
+		}
+	}
+	obsfile_free(f);
+	return res;
+}
+
+/*------------------------------------------------------------------------------
+  READING
+*/
+
+/* read the index from the end of a closed file */
+static int obsfile_read_index(ObsFile *f, obsfile_off_t datapos){
+	unsigned char entry[OBSFILE_TRAILER_BYTES];
+	obsfile_off_t end, offset;
+	long n, i;
+
+	if(OBSFILE_SEEK_END(f->fp))return 1;
+	end = OBSFILE_TELL(f->fp);
+	if(end < datapos + 16 + OBSFILE_TRAILER_BYTES)return 1;
+	if(OBSFILE_SEEK(f->fp, end - OBSFILE_TRAILER_BYTES)
+		|| fread(entry, OBSFILE_TRAILER_BYTES, 1, f->fp) != 1
+		|| memcmp(entry + 16, OBSFILE_TRAILER_MAGIC, 8) != 0
+	){
+		return 1;
+	}
+	offset = (obsfile_off_t)obsfile_get_u64(entry);
+	f->nrows = (long)obsfile_get_u64(entry + 8);
+	if(offset < datapos || offset > end - OBSFILE_TRAILER_BYTES - 16
+		|| OBSFILE_SEEK(f->fp, offset)
+		|| fread(entry, 16, 1, f->fp) != 1
+		|| memcmp(entry, OBSFILE_INDEX_MAGIC, 8) != 0
+	){
+		return 1;
+	}
+	n = (long)obsfile_get_u64(entry + 8);
+	if(offset + 16 + (obsfile_off_t)n * OBSFILE_INDEX_ENTRY_BYTES
+		+ OBSFILE_TRAILER_BYTES != end
+	){
+		return 1;
+	}
+	for(i = 0; i < n; ++i){
+		if(fread(entry, OBSFILE_INDEX_ENTRY_BYTES, 1, f->fp) != 1
+			|| obsfile_get_u32(entry + 16) > (uint32_t)f->chunk
+			|| obsfile_add_chunk(f, (obsfile_off_t)obsfile_get_u64(entry)
+				, (long)obsfile_get_u64(entry + 8), (long)obsfile_get_u32(entry + 16)
+			)
+		){
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* find the chunks of a file that was never closed, by walking them */
+static int obsfile_scan(ObsFile *f, obsfile_off_t datapos){
+	unsigned char head[8];
+	obsfile_off_t offset = datapos, len;
+	long nrows;
+	int c;
+
+	f->nchunks = 0;
+	f->nrows = 0;
+	while(OBSFILE_SEEK(f->fp, offset) == 0
+		&& fread(head, 8, 1, f->fp) == 1
+		&& memcmp(head, OBSFILE_CHUNK_MAGIC, 4) == 0
+	){
+		nrows = (long)obsfile_get_u32(head + 4);
+		if(nrows <= 0 || nrows > f->chunk)break;
+		len = 8 + 8 * (obsfile_off_t)f->ncols;
+		for(c = 0; c < f->ncols; ++c){
+			if(fread(head, 8, 1, f->fp) != 1)return 0;
+			len += (obsfile_off_t)obsfile_get_u64(head);
+		}
+		/* a chunk cut short by the crash is left out */
+		if(OBSFILE_SEEK(f->fp, offset + len - 1)
+			|| fread(head, 1, 1, f->fp) != 1
+		){
+			break;
+		}
+		if(obsfile_add_chunk(f, offset, f->nrows, nrows))return 1;
+		f->nrows += nrows;
+		offset += len;
+	}
+	return 0;
+}
+
+ObsFile *obsfile_open(const char *filename){
+	ObsFile *f;
+	unsigned char head[20];
+	uint32_t len;
+	long maxlen;
+	obsfile_off_t datapos;
+	int c;
+
+	asc_assert(filename != NULL);
+	f = ASC_NEW_CLEAR(ObsFile);
+	if(f == NULL)return NULL;
+	f->fp = fopen(filename, "rb");
+	if(f->fp == NULL){
+		ERROR_REPORTER_HERE(ASC_USER_ERROR,"Unable to open observation file '%s'",filename);
+		obsfile_free(f);
+		return NULL;
+	}
+	if(fread(head, 20, 1, f->fp) != 1 || memcmp(head, OBSFILE_MAGIC, 8) != 0){
+		ERROR_REPORTER_HERE(ASC_USER_ERROR,"'%s' is not an observation file",filename);
+		obsfile_free(f);
+		return NULL;
+	}
+	f->flags = (int)obsfile_get_u32(head + 8);
+	f->ncols = (int)obsfile_get_u32(head + 12);
+	f->chunk = (long)obsfile_get_u32(head + 16);
+	if(f->ncols <= 0 || f->chunk <= 0 || f->chunk > OBSFILE_MAX_CHUNK
+		|| (f->flags & ~OBSFILE_COMPRESS)
+	){
+		ERROR_REPORTER_HERE(ASC_USER_ERROR,"Invalid header in observation file '%s'",filename);
+		f->ncols = 0;
+		obsfile_free(f);
+		return NULL;
+	}
+
+	f->names = ASC_NEW_ARRAY_CLEAR(char *, f->ncols);
+	maxlen = OBSFILE_MAX_VALUE_BYTES * f->chunk;
+	f->block = ASC_NEW_ARRAY(unsigned char, maxlen);
+	f->vals = ASC_NEW_ARRAY(double, f->chunk);
+	if(f->names == NULL || f->block == NULL || f->vals == NULL){
+		obsfile_free(f);
+		return NULL;
+	}
+	for(c = 0; c < f->ncols; ++c){
+		if(fread(head, 4, 1, f->fp) != 1)break;
+		len = obsfile_get_u32(head);
+		f->names[c] = ASC_NEW_ARRAY(char, len + 1);
+		if(f->names[c] == NULL
+			|| (len > 0 && fread(f->names[c], len, 1, f->fp) != 1)
+		){
+			break;
+		}
+		f->names[c][len] = '\0';
+	}
+	if(c < f->ncols){
+		ERROR_REPORTER_HERE(ASC_USER_ERROR,"Invalid header in observation file '%s'",filename);
+		obsfile_free(f);
+		return NULL;
+	}
+
+	datapos = OBSFILE_TELL(f->fp);
+	if(datapos < 0 || obsfile_read_index(f, datapos)){
+		f->nchunks = 0;
+		if(obsfile_scan(f, datapos)){
+			obsfile_free(f);
+			return NULL;
+		}
+		ERROR_REPORTER_HERE(ASC_USER_WARNING,"Observation file '%s' was not"
+			" closed; %ld rows recovered",filename,f->nrows
+		);
+	}
+#ifdef OBSFILE_DEBUG
+	CONSOLE_DEBUG("'%s': %d cols, %ld rows in %ld chunks"
+		,filename,f->ncols,f->nrows,f->nchunks
+	);
+#endif
+	return f;
+}
+
+/* decode col of chunk k into f->vals */
+static int obsfile_read_block(ObsFile *f, long k, int col){
+	unsigned char head[8];
+	obsfile_off_t pos;
+	long len = 0;
+	int c;
+
+	pos = f->index[k].offset + 8;
+	if(OBSFILE_SEEK(f->fp, pos))return 1;
+	for(c = 0; c <= col; ++c){
+		if(fread(head, 8, 1, f->fp) != 1)return 1;
+		if(c < col){
+			pos += (obsfile_off_t)obsfile_get_u64(head);
+		}else{
+			len = (long)obsfile_get_u64(head);
+		}
+	}
+	pos += 8 * (obsfile_off_t)f->ncols;
+	if(len < 0 || len > OBSFILE_MAX_VALUE_BYTES * f->chunk
+		|| OBSFILE_SEEK(f->fp, pos)
+		|| (len > 0 && fread(f->block, len, 1, f->fp) != 1)
+	){
+		return 1;
+	}
+	return obsfile_decode(f->block, len, f->flags, f->index[k].nrows, f->vals);
+}
+
+long obsfile_read_col(ObsFile *f, int col
+	, long start, long count, double *values
+){
+	long lo, hi, mid, k, from, to, n = 0;
+
+	asc_assert(f != NULL && !f->writing && values != NULL);
+	if(col < 0 || col >= f->ncols || start < 0 || count < 0)return -1;
+	if(start >= f->nrows || count == 0)return 0;
+	count = MIN(count, f->nrows - start);
+
+	/* the chunk holding row 'start' */
+	lo = 0;
+	hi = f->nchunks - 1;
+	while(lo < hi){
+		mid = (lo + hi + 1) / 2;
+		if(f->index[mid].first <= start){
+			lo = mid;
+		}else{
+			hi = mid - 1;
+		}
+	}
+	for(k = lo; k < f->nchunks && n < count; ++k){
+		if(obsfile_read_block(f, k, col)){
+			ERROR_REPORTER_HERE(ASC_USER_ERROR,"Corrupt observation file");
+			return -1;
+		}
+		from = start + n - f->index[k].first;
+		to = MIN(f->index[k].nrows, from + count - n);
+		memcpy(values + n, f->vals + from, (to - from) * sizeof(double));
+		n += to - from;
+	}
+	return n;
+}
+
+/*------------------------------------------------------------------------------
+  INTEGRATOR REPORTER
+*/
+
+static int obsfile_reporter_init(IntegratorSystem *sys){
+	ObsFileReporter *r = (ObsFileReporter *)sys->reporter;
+	char **names;
+	int c, ncols = sys->n_obs + 1;
+
+	if(r->file != NULL){
+		obsfile_close(r->file);
+	}
+	names = ASC_NEW_ARRAY_CLEAR(char *, ncols);
+	if(r->row != NULL)ASC_FREE(r->row);
+	r->row = ASC_NEW_ARRAY(double, ncols);
+	if(names == NULL || r->row == NULL){
+		if(names != NULL)ASC_FREE(names);
+		return 0;
+	}
+	if(sys->x != NULL){
+		names[0] = var_make_name(sys->system, sys->x);
+	}
+	for(c = 1; c < ncols; ++c){
+		names[c] = var_make_name(sys->system, integrator_get_observed_var(sys, c - 1));
+	}
+	r->file = obsfile_create(r->filename, ncols, (const char **)names
+		, r->chunk, r->flags
+	);
+	for(c = 0; c < ncols; ++c){
+		if(names[c] != NULL)ascfree(names[c]);
+	}
+	ASC_FREE(names);
+	return r->file != NULL;
+}
+
+static int obsfile_reporter_write(IntegratorSystem *sys){
+	UNUSED_PARAMETER(sys);
+	return 1; /* no interrupt */
+}
+
+static int obsfile_reporter_write_obs(IntegratorSystem *sys){
+	ObsFileReporter *r = (ObsFileReporter *)sys->reporter;
+	if(r->file == NULL)return 0;
+	r->row[0] = integrator_get_t(sys);
+	integrator_get_observations(sys, r->row + 1);
+	return obsfile_append(r->file, r->row) == 0;
+}
+
+static int obsfile_reporter_close(IntegratorSystem *sys){
+	ObsFileReporter *r = (ObsFileReporter *)sys->reporter;
+	int res;
+	if(r->file == NULL)return 1;
+	res = obsfile_close(r->file);
+	r->file = NULL;
+	return res == 0;
+}
+
+ObsFileReporter *obsfile_reporter_create(const char *filename
+	, long chunk, int flags
+){
+	ObsFileReporter *r;
+	asc_assert(filename != NULL);
+	r = ASC_NEW_CLEAR(ObsFileReporter);
+	if(r == NULL)return NULL;
+	r->reporter.init = &obsfile_reporter_init;
+	r->reporter.write = &obsfile_reporter_write;
+	r->reporter.write_obs = &obsfile_reporter_write_obs;
+	r->reporter.close = &obsfile_reporter_close;
+	r->filename = ASC_STRDUP(filename);
+	r->chunk = chunk;
+	r->flags = flags;
+	if(r->filename == NULL){
+		ASC_FREE(r);
+		return NULL;
+	}
+	return r;
+}
+
+void obsfile_reporter_destroy(ObsFileReporter *r){
+	if(r == NULL)return;
+	if(r->file != NULL)obsfile_close(r->file);
+	if(r->row != NULL)ASC_FREE(r->row);
+	ASC_FREE(r->filename);
+	ASC_FREE(r);
+}
@@ -0,0 +1,174 @@
+/*	ASCEND modelling environment
+	Copyright (C) 2015 Carnegie Mellon University
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2, or (at your option)
+	any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*//**
+	@file
+	Observation files: integrator observations streamed to disk by column.
+
+	A long dynamic run with many observed variables can produce more data
+	than will fit in memory. An ObsFile holds at most one chunk of rows in
+	memory; when it is full, each column of the chunk is written out as a
+	block of its own, so that the time series of one variable can later be
+	read back without touching the others.
+
+	The file is self-describing:
+	<pre>
+	header   "ASCOBS" 0 1, u32 flags, u32 ncols, u32 chunk,
+	         then for each col: u32 length, name (no terminator)
+	chunks   "CHNK", u32 nrows, u64 length of each col block, col blocks
+	index    "ASCOBSIX", u64 nchunks,
+	         then for each chunk: u64 file offset, u64 first row, u32 nrows
+	trailer  u64 offset of the index, u64 total rows, "ASCOBSTR"
+	</pre>
+	Integers are little-endian whatever the machine. Each col block is
+	nrows IEEE doubles, little-endian, or if OBSFILE_COMPRESS is set, the
+	same doubles each XORed with the one before (from zero at the start of
+	the chunk) and stored without their leading and trailing zero bytes,
+	after a byte giving their number. Slowly-changing and constant series
+	come down to a few bytes per sample; nothing is lost.
+
+	The index and trailer are written by obsfile_close. A file that was
+	never closed (the run crashed, say) can still be read: the chunks are
+	found by walking them from the header instead.
+
+	Col 0 is by convention the independent variable; obsfile_reporter
+	writes it so.
+*/
+
+#ifndef ASC_OBSFILE_H
+#define ASC_OBSFILE_H
+
+/**	@addtogroup integrator_obsfile Integrator Observation Files
+	@{
+*/
+
+#include <stdio.h>
+#include <ascend/general/platform.h>
+#include "integrator.h"
+
+/** compress col blocks (see the file description) */
+#define OBSFILE_COMPRESS 0x1
+
+/** the most memory an ObsFile will buffer, if not told the chunk size */
+#define OBSFILE_BUFFER_BYTES (4L << 20)
+
+typedef struct ObsFileStruct ObsFile;
+
+/*------------------------------------------------------------------------------
+  WRITING
+*/
+
+ASC_DLLSPEC ObsFile *obsfile_create(const char *filename, int ncols
+	, const char **names, long chunk, int flags
+);
+/**<
+	Create a new observation file, overwriting any of the same name.
+
+	@param names  ncols column names, copied into the header. NULL entries
+	              are written as empty names.
+	@param chunk  rows buffered in memory before being written, or 0 to
+	              fit OBSFILE_BUFFER_BYTES.
+	@param flags  OBSFILE_COMPRESS, or 0.
+	@return the file, or NULL if it could not be created.
+*/
+
+ASC_DLLSPEC int obsfile_append(ObsFile *f, const double *row);
+/**<
+	Add a row of ncols values. Writes out the chunk when it is full.
+	@return 0 on success, 1 on a write error (after which the file
+	should be closed).
+*/
+
+ASC_DLLSPEC int obsfile_flush(ObsFile *f);
+/**<
+	Write out any buffered rows as a (short) chunk of their own, so that
+	a reader opening the file now sees them.
+	@return 0 on success
+*/
+
+ASC_DLLSPEC int obsfile_close(ObsFile *f);
+/**<
+	Finish a file being written (flush, then write the index and trailer),
+	or release one being read. Either way f is freed.
+	@return 0 on success
+*/
+
+/*------------------------------------------------------------------------------
+  READING
+*/
+
+ASC_DLLSPEC ObsFile *obsfile_open(const char *filename);
+/**<
+	Open an observation file for reading. Only the header and the chunk
+	index are read.
+	@return the file, or NULL if it is missing or not an observation file.
+*/
+
+ASC_DLLSPEC int obsfile_ncols(const ObsFile *f);
+ASC_DLLSPEC long obsfile_nrows(const ObsFile *f);
+/**< number of rows, in a file being read or written so far */
+
+ASC_DLLSPEC const char *obsfile_name(const ObsFile *f, int col);
+/**< name of col, or NULL if col is out of range */
+
+ASC_DLLSPEC int obsfile_find(const ObsFile *f, const char *name);
+/**< @return the first col with the given name, or -1 */
+
+ASC_DLLSPEC long obsfile_read_col(ObsFile *f, int col
+	, long start, long count, double *values
+);
+/**<
+	Read values[0..count-1] = col at rows start..start+count-1, touching
+	only the blocks of that col in the chunks that hold those rows.
+	@return the number of rows read: count, or fewer at the end of the
+	file; -1 on error.
+*/
+
+/*------------------------------------------------------------------------------
+  INTEGRATOR REPORTER
+*/
+
+/**
+	An IntegratorReporter that writes the independent variable and the
+	observed variables to an observation file. The reporter comes first,
+	so that an ObsFileReporter may be given to integrator_set_reporter as
+	it is. Like IntegratorReporterFile in ascxx, each of its functions
+	returns 1 if all is well and 0 if the file could not be written (or,
+	for write_obs, is not open).
+*/
+typedef struct ObsFileReporterStruct{
+	IntegratorReporter reporter;
+	char *filename;
+	long chunk;
+	int flags;
+	ObsFile *file;    /**< open from output_init to output_close */
+	double *row;
+} ObsFileReporter;
+
+ASC_DLLSPEC ObsFileReporter *obsfile_reporter_create(const char *filename
+	, long chunk, int flags
+);
+/**<
+	Create a reporter writing to filename (see obsfile_create for chunk
+	and flags). The file is created when the integration starts; the
+	names of the cols are those of the independent and observed vars.
+*/
+
+ASC_DLLSPEC void obsfile_reporter_destroy(ObsFileReporter *r);
+/**< Close the file, if still open, and free r. */
+
+/* @} */
+
+#endif
@@ -1,3 +1,4 @@
+#include <math.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -77,9 +78,11 @@ IntegratorReporter test_ida_reporter = { test_ida_reporter_init,
 		test_ida_reporter_close };
 
 /*
-	Test using simple harmonic motion model.
+	Integrate the simple harmonic motion model from 0 to pi with IDA, using
+	the linear solver linsolver (or the default, if NULL), and return the
+	final x and v.
 */
-static void test_shm(){
+static void solve_shm(const char *linsolver, double *xfinal, double *vfinal){
 
 	Asc_CompilerInit(1);
 
@@ -127,7 +130,15 @@ static void test_shm(){
 
 	slv_parameters_t p;
 	CU_ASSERT(0 == integrator_params_get(integ,&p));
-	/* TODO set some parameters? */
+	if(linsolver != NULL){
+		int i, index = -1;
+		for(i=0;i<p.num_parms;++i){
+			if(strcmp(p.parms[i].name,"linsolver")==0)index = i;
+		}
+		CU_ASSERT_FATAL(index != -1);
+		slv_set_char_parameter(&(SLV_PARAM_CHAR(&p,index)),linsolver);
+		CU_ASSERT(0 == integrator_params_set(integ,&p));
+	}
 
 	/* perform problem analysis */
 	CU_ASSERT_FATAL(0 == integrator_analyse(integ));
@@ -168,14 +179,13 @@ static void test_shm(){
 	CU_TEST(simroot != NULL);
 	struct Instance *ix = ChildByChar(simroot,AddSymbol("x"));
 	struct Instance *iv = ChildByChar(simroot,AddSymbol("v"));
-	CU_TEST(ix != NULL);
-	CU_TEST(iv != NULL);
+	CU_ASSERT_FATAL(ix != NULL);
+	CU_ASSERT_FATAL(iv != NULL);
 
-	CONSOLE_DEBUG("Final x = %e",RealAtomValue(ix));
-	CONSOLE_DEBUG("Final v = %e",RealAtomValue(iv));
-
-	CU_TEST(fabs(RealAtomValue(ix) - 10 < 2e-3));
-	CU_TEST(fabs(RealAtomValue(iv) - 0 < 4e-4));
+	*xfinal = RealAtomValue(ix);
+	*vfinal = RealAtomValue(iv);
+	CONSOLE_DEBUG("Final x = %e",*xfinal);
+	CONSOLE_DEBUG("Final v = %e",*vfinal);
 
 	/* destroy all that stuff */
 	CU_ASSERT(siminst != NULL);
@@ -186,6 +196,29 @@ static void test_shm(){
 	Asc_CompilerDestroy();
 }
 
+/*
+	Test using simple harmonic motion model.
+*/
+static void test_shm(){
+	double x, v;
+	solve_shm(NULL, &x, &v);
+	CU_TEST(fabs(x - 10 < 2e-3));
+	CU_TEST(fabs(v - 0 < 4e-4));
+}
+
+/*
+	The same with the ASCEND sparse direct linear solver, which goes through
+	the CSR assembly and linsolqr; the answer should match the dense one.
+*/
+static void test_shmsparse(){
+	double x, v, xd, vd;
+	solve_shm("DENSE", &xd, &vd);
+	solve_shm("ASCEND", &x, &v);
+	CU_TEST(fabs(x - xd) < 1e-5 * fabs(xd));
+	CU_TEST(fabs(v - vd) < 1e-5 * fabs(xd));
+	CU_TEST(fabs(x + 10) < 1e-2);
+}
+
 /*
 	Test solving a simple IPOPT model
 */
@@ -399,6 +432,7 @@ static void test_integ1(){
 
 #define TESTS(T) \
 	T(shm) \
+	T(shmsparse) \
 	T(boundary) \
 	T(integ1)
 
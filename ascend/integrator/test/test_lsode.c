@@ -137,6 +137,11 @@ static void test_bounds(){
 	/* perform problem analysis */
 	CU_ASSERT_FATAL(0 == integrator_analyse(integ));
 
+	/* the states are read and written through the simulation's value store */
+	CU_ASSERT_FATAL(integ->vs != NULL && integ->vs == GetValueStore(siminst));
+	CU_ASSERT(integ->n_y > 0 && integ->y_vs[0] >= 0);
+	CU_ASSERT(integ->vs->atom[integ->y_vs[0]] == var_instance(integ->y[0]));
+
 	CONSOLE_DEBUG("Assigning reporter and step sizes...");
 	integrator_set_reporter(integ, &test_lsode_reporter);
 	integrator_set_minstep(integ,0);
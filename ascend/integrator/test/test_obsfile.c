@@ -0,0 +1,179 @@
+/*	ASCEND modelling environment
+	Copyright (C) 2015 Carnegie Mellon University
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2, or (at your option)
+	any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*//**
+	@file
+	Write observation files with and without compression, read columns back
+	from arbitrary rows, and recover a file that was never closed.
+*/
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <ascend/general/platform.h>
+#include <ascend/general/ascMalloc.h>
+#include <ascend/general/mathmacros.h>
+#include <ascend/integrator/obsfile.h>
+
+#include <test/common.h>
+
+#define NCOLS 4
+#define NROWS 1000
+#define CHUNK 64
+
+static const char *obsfile_test_names[NCOLS] = {"t", "x", "constant", NULL};
+
+/* t, a smooth series, a constant, and some awkward values */
+static double obsfile_test_value(long i, int c){
+	switch(c){
+		case 0: return 0.01 * i;
+		case 1: return sin(0.01 * i) * exp(-0.001 * i);
+		case 2: return 273.15;
+		default: return (i % 3 == 0) ? -0.0 : ((i % 3 == 1) ? 1e-300 * i : -1e300);
+	}
+}
+
+static int obsfile_test_write(const char *filename, int flags){
+	ObsFile *f;
+	double row[NCOLS];
+	long i;
+	int c;
+
+	f = obsfile_create(filename, NCOLS, obsfile_test_names, CHUNK, flags);
+	if(f == NULL)return 1;
+	for(i = 0; i < NROWS; ++i){
+		for(c = 0; c < NCOLS; ++c){
+			row[c] = obsfile_test_value(i, c);
+		}
+		if(obsfile_append(f, row))return 1;
+	}
+	return obsfile_close(f);
+}
+
+/* count mismatches in col c over rows start..start+count-1 (bitwise) */
+static int obsfile_test_check(ObsFile *f, int c, long start, long count){
+	double values[NROWS];
+	double x;
+	long i, n;
+	int nerr = 0;
+
+	n = obsfile_read_col(f, c, start, count, values);
+	if(n != MIN(count, NROWS - start))return 1;
+	for(i = 0; i < n; ++i){
+		x = obsfile_test_value(start + i, c);
+		if(memcmp(&x, &values[i], sizeof(double)) != 0)nerr++;
+	}
+	return nerr;
+}
+
+/* @return the size of the file written */
+static long obsfile_test_file(int flags){
+	const char *filename = "test_obsfile.tmp";
+	ObsFile *f;
+	long sizes[2];
+	FILE *fp;
+
+	CU_TEST(0 == obsfile_test_write(filename, flags));
+	f = obsfile_open(filename);
+	CU_TEST(f != NULL);
+	if(f == NULL)return 0;
+	CU_TEST(obsfile_ncols(f) == NCOLS);
+	CU_TEST(obsfile_nrows(f) == NROWS);
+	CU_TEST(0 == strcmp(obsfile_name(f, 2), "constant"));
+	CU_TEST(0 == strcmp(obsfile_name(f, 3), ""));
+	CU_TEST(obsfile_find(f, "x") == 1);
+	CU_TEST(obsfile_find(f, "y") == -1);
+
+	/* whole cols, a piece within one chunk, one across several, the end */
+	CU_TEST(0 == obsfile_test_check(f, 0, 0, NROWS));
+	CU_TEST(0 == obsfile_test_check(f, 1, 0, NROWS));
+	CU_TEST(0 == obsfile_test_check(f, 2, 0, NROWS));
+	CU_TEST(0 == obsfile_test_check(f, 3, 0, NROWS));
+	CU_TEST(0 == obsfile_test_check(f, 1, 10, 20));
+	CU_TEST(0 == obsfile_test_check(f, 1, CHUNK - 1, 3 * CHUNK + 2));
+	CU_TEST(0 == obsfile_test_check(f, 3, NROWS - 5, 100));
+	CU_TEST(0 == obsfile_read_col(f, 1, NROWS, 10, (double *)sizes));
+	CU_TEST(-1 == obsfile_read_col(f, NCOLS, 0, 10, (double *)sizes));
+	CU_TEST(0 == obsfile_close(f));
+
+	fp = fopen(filename, "rb");
+	if(fp == NULL)return 0;
+	fseek(fp, 0, SEEK_END);
+	sizes[0] = ftell(fp);
+	fclose(fp);
+	remove(filename);
+	return sizes[0];
+}
+
+static void test_plain(void){
+	unsigned long prior_meminuse = ascmeminuse();
+	CU_TEST(obsfile_test_file(0) > (long)(NCOLS * NROWS * sizeof(double)));
+	CU_TEST(prior_meminuse == ascmeminuse());
+}
+
+static void test_compress(void){
+	long size;
+	unsigned long prior_meminuse = ascmeminuse();
+	size = obsfile_test_file(OBSFILE_COMPRESS);
+	CU_TEST(size > 0);
+	/* the constant col, at least, is down to a byte a row */
+	CU_TEST(size < obsfile_test_file(0) - NROWS * 6);
+	CU_TEST(prior_meminuse == ascmeminuse());
+}
+
+static void test_unclosed(void){
+	const char *filename = "test_obsfile.tmp";
+	ObsFile *f, *r;
+	double row[NCOLS];
+	long i;
+	int c;
+	unsigned long prior_meminuse = ascmeminuse();
+
+	/* the flushed chunks can be read while the file is still open */
+	f = obsfile_create(filename, NCOLS, obsfile_test_names, CHUNK, OBSFILE_COMPRESS);
+	CU_ASSERT_FATAL(f != NULL);
+	for(i = 0; i < 3 * CHUNK + 10; ++i){
+		for(c = 0; c < NCOLS; ++c){
+			row[c] = obsfile_test_value(i, c);
+		}
+		CU_TEST(0 == obsfile_append(f, row));
+	}
+	r = obsfile_open(filename);
+	CU_ASSERT_FATAL(r != NULL);
+	CU_TEST(obsfile_nrows(r) == 3 * CHUNK);
+	CU_TEST(0 == obsfile_test_check(r, 1, 0, 3 * CHUNK));
+	CU_TEST(0 == obsfile_close(r));
+
+	CU_TEST(0 == obsfile_flush(f));
+	r = obsfile_open(filename);
+	CU_ASSERT_FATAL(r != NULL);
+	CU_TEST(obsfile_nrows(r) == 3 * CHUNK + 10);
+	CU_TEST(0 == obsfile_test_check(r, 3, 2 * CHUNK, CHUNK + 10));
+	CU_TEST(0 == obsfile_close(r));
+
+	CU_TEST(0 == obsfile_close(f));
+	remove(filename);
+	CU_TEST(prior_meminuse == ascmeminuse());
+}
+
+/*===========================================================================*/
+/* Registration information */
+
+#define TESTS(T) \
+	T(plain) \
+	T(compress) \
+	T(unclosed)
+
+REGISTER_TESTS_SIMPLE(integrator_obsfile, TESTS)
@@ -20,7 +20,8 @@
 
 #define TESTS(T) \
 	T(ida) \
-	T(lsode)
+	T(lsode) \
+	T(obsfile)
 
 #define PROTO_INTEG(NAME) PROTO(integrator,NAME)
 TESTS(PROTO_INTEG)
@@ -70,6 +70,8 @@
 #include "ranki2.h"
 #include "rankiba2.h"
 #include "plainqr.h"
+#include "ranki_refactor.h"
+#include "supernodal.h"
 
 #include "linsolqr_impl.h"
 
@@ -117,7 +119,7 @@ char *linsolqr_rmethods() {
 
 char *linsolqr_fmethods() {
   static char names[] =
-    "SPK1/RANKI,SPK1/RANKI+ROW,Fast-SPK1/RANKI,Fast-SPK1/RANKI+ROW,Fastest-SPK1/MR-RANKI,CondQR,CPQR";
+    "SPK1/RANKI,SPK1/RANKI+ROW,Fast-SPK1/RANKI,Fast-SPK1/RANKI+ROW,Fastest-SPK1/MR-RANKI,SPK1/SUPERNODAL-LU,CondQR,CPQR";
   return names;
 }
 
@@ -136,6 +138,7 @@ enum factor_method linsolqr_fmethod_to_enum(char *name) {
   if (strcmp(name,"Fast-SPK1/RANKI")==0) return ranki_kw2;
   if (strcmp(name,"Fast-SPK1/RANKI+ROW")==0) return ranki_jz2;
   if (strcmp(name,"Fastest-SPK1/MR-RANKI")==0) return ranki_ba2;
+  if (strcmp(name,"SPK1/SUPERNODAL-LU")==0) return supernodal_lu;
   if (strcmp(name,"CondQR")==0) return cond_qr;
   if (strcmp(name,"CPQR")==0) return plain_qr;
   return unknown_f;
@@ -151,6 +154,7 @@ enum factor_class linsolqr_fmethod_to_fclass(enum factor_method fm)
     case ranki_kw2:
     case ranki_jz2:
     case ranki_ka:
+    case supernodal_lu:
       return ranki;
     /* implemented qr things */
     case plain_qr:
@@ -185,6 +189,7 @@ char *linsolqr_enum_to_fmethod(enum factor_method meth) {
 		case ranki_kw2: return "Fast-SPK1/RANKI";
 		case ranki_jz2: return "Fast-SPK1/RANKI+ROW";
 		case ranki_ka: return "KIRK-STUFF";
+		case supernodal_lu: return "SPK1/SUPERNODAL-LU";
 		case cond_qr: return "CondQR";
 		case plain_qr: return "CPQR";
 		default: return "<unknown factorization method>";
@@ -208,6 +213,7 @@ const char *linsolqr_fmethod_description(const enum factor_method meth) {
 		case ranki_jz: return "SPK1/RANKI LU with pseudo-complete pivoting (JZ)";
 		case ranki_jz2: return "SPK1/RANKI LU with pseudo-complete pivoting (JZ2)";
 		case ranki_ka: return "KIRK-STUFF/RANKI LU with pseudo-complete pivoting";
+		case supernodal_lu: return "SPK1 reordering with supernodal LU and column pivoting";
 		case cond_qr: return "Sparse QR with condition controlled pivoting";
 		case plain_qr: return "Sparse QR with column pivoting";
 		default: return "<unknown factorization method>";
@@ -347,6 +353,8 @@ linsolqr_system_t linsolqr_create(){
 	sys->smallest_pivot = MAXDOUBLE;
 	sys->qrdata = NULL;
 	sys->ludata = NULL;
+	sys->refactor = NULL;
+	sys->sndata = NULL;
 	return(sys);
 }
 
@@ -366,6 +374,8 @@ void linsolqr_destroy(linsolqr_system_t sys){
    if( NOTNULL(sys->coef) ) {
      CONSOLE_DEBUG("linsolqr contains coef mtx which will NOT be destroyed");
    }
+   ranki_refactor_destroy(sys);
+   supernodal_destroy(sys);
    if( NOTNULL(sys->inverse) )
       mtx_destroy(sys->inverse);
    if( NOTNULL(sys->factors) )
@@ -2355,7 +2365,7 @@ static void qr_apply_householder(linsolqr_system_t sys,
  *
  */
 {
-  static int32 *hhrowlist=NULL, listlen=0;
+  static ASC_THREAD_LOCAL int32 *hhrowlist=NULL, listlen=0;
   real64 *hhcol, *hhrow, tauc, value,xdothhcol;
   int32 col,row,collim,rowlim;
   mtx_matrix_t mtx;
@@ -2956,6 +2966,7 @@ int linsolqr_factor(linsolqr_system_t sys, enum factor_method fmeth){
   }
   if (sys->factored)
     return facstatus;
+  ranki_refactor_destroy(sys);
   switch (sys->fmethod) {
   case ranki_kw:
   case ranki_jz:
@@ -2966,6 +2977,9 @@ int linsolqr_factor(linsolqr_system_t sys, enum factor_method fmeth){
   case ranki_jz2:
     facstatus = ranki2_entry(sys,&(sys->reg));
     break;
+  case supernodal_lu:
+    facstatus = supernodal_entry(sys,&(sys->reg));
+    break;
 #ifdef BUILD_KIRK_CODE
   case ranki_ka:
     facstatus = kirk1_factor(sys,&(sys->reg),2);
@@ -2988,6 +3002,27 @@ int linsolqr_factor(linsolqr_system_t sys, enum factor_method fmeth){
   return facstatus;
 }
 
+/**
+	Replays the recorded factorization when it can, else factors in full
+	and records the result for next time.
+*/
+int linsolqr_refactor(linsolqr_system_t sys, enum factor_method fmeth){
+  int facstatus;
+
+  CHECK_SYSTEM(sys);
+  if (sys->factored && fmeth == sys->fmethod)
+    return 0;
+  if (fmeth == sys->fmethod && sys->fclass == ranki
+      && !ranki_refactor_entry(sys)) {
+    return 0;
+  }
+  facstatus = linsolqr_factor(sys,fmeth);
+  if (!facstatus && sys->fclass == ranki) {
+    ranki_refactor_record(sys);
+  }
+  return facstatus;
+}
+
 int linsolqr_get_pivot_sets(linsolqr_system_t sys
 		,unsigned *org_rowpivots
 		,unsigned *org_colpivots
@@ -3172,6 +3207,9 @@ void linsolqr_calc_row_dependencies(linsolqr_system_t sys){
   case ranki_jz2:
     calc_dependent_rows_ranki2(sys);
     break;
+  case supernodal_lu:
+    calc_dependent_rows_supernodal(sys);
+    break;
   default:
     ERROR_REPORTER_HERE(ASC_PROG_ERR,
       "Don't know how to calculate for method %s."
@@ -3195,6 +3233,9 @@ void linsolqr_calc_col_dependencies(linsolqr_system_t sys){
   case ranki_jz2:
     calc_dependent_cols_ranki2(sys);
     break;
+  case supernodal_lu:
+    calc_dependent_cols_supernodal(sys);
+    break;
   default:
     ERROR_REPORTER_HERE(ASC_PROG_ERR,"Don't know how to calculate for method %s.",
             linsolqr_enum_to_fmethod(sys->fmethod));
@@ -3428,6 +3469,9 @@ int linsolqr_solve(linsolqr_system_t sys,real64 *rhs){
       case ranki_jz2:
          solstatus = ranki2_solve(sys,rl);
          break;
+      case supernodal_lu:
+         solstatus = supernodal_solve(sys,rl);
+         break;
       case cond_qr:
          solstatus = condqr_solve(sys,rl);
          break;
@@ -3736,6 +3780,7 @@ size_t linsolqr_size(linsolqr_system_t sys)
   switch (sys->fclass) {
     case ranki:
       if (NOTNULL(sys->factors)) s += mtx_size(sys->factors);
+      s += supernodal_size(sys);
       /* this works because sys->inverse is either NULL or a slave for
          the current ranki family: kw jz kw2 jz2 */
     break;
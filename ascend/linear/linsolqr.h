@@ -125,6 +125,17 @@
  *    elimination which removes the last significant quadratic effect from
  *    the ranki factorization.
  *
+ *  supernodal_lu:
+ *    Reordering method: SPK1, as for the ranki methods.
+ *    Left-looking LU with threshold partial pivoting down the column,
+ *    taking the SPK1 diagonal whenever it is within ptol of the largest
+ *    candidate. Columns of L with the same structure are grouped into
+ *    dense supernodes and updates are applied a panel of columns at a
+ *    time with dense kernels. That may pay off on large blocks which SPK1
+ *    leaves with many spikes; otherwise the ranki_*2 methods recommended
+ *    above are as good. Dependency information is not calculated
+ *    automatically. The drop tolerance is ignored.
+ *
  *  plain_qr:
  *    Reordering method: Transpose SPK1 (tspk1), LORA
  *      The region used may be rectangular, but will be modified
@@ -257,7 +268,8 @@ enum factor_method {
   opt_qr = 8,       /**< coming soon */
   ls_qr = 9,        /**< anticipated */
   gauss_ba2 = 10,   /**< anticipated */
-  symmetric_lu = 11 /**< anticipated */
+  symmetric_lu = 11, /**< anticipated */
+  supernodal_lu = 13 /**< left-looking LU on dense supernodes (12 is ranki_ka) */
 };
 
 ASC_DLLSPEC int g_linsolqr_timing;
@@ -494,6 +506,7 @@ extern real64 linsolqr_drop_tolerance(linsolqr_system_t sys);
  *  ranki_kw2:
  *  ranki_jz2: as ranki_kw/ranki_jz except that matrix entries below
  *             dtol in magnitude are dropped.
+ *  supernodal_lu: pivot_tolerance applies to col. dtol ignored.
  *  plain_qr: pivot_tolerance applies to cols. condition_tolerance used
  *            with a condition heuristic rather than actual condition.
  *
@@ -628,6 +641,22 @@ ASC_DLLSPEC int linsolqr_factor(linsolqr_system_t sys,
  *  Return 0 if ok, 1 if not.
  */
 
+ASC_DLLSPEC int linsolqr_refactor(linsolqr_system_t sys,
+                             enum factor_method fmethod);
+/**<
+ *  As linsolqr_factor, but for a matrix whose incidence and reordering
+ *  are unchanged since the last call and whose values are new.
+ *  For the ranki methods the pivot sequence and fill pattern of the
+ *  previous factorization are replayed on the new values, which skips
+ *  the pivot search and all allocation. If the incidence has changed,
+ *  the previous factorization was rank deficient, or a replayed pivot
+ *  falls below pivot_zero or fails the ptol test against its row, a full
+ *  linsolqr_factor is done instead and its pivot sequence is recorded
+ *  for the next call. Other methods always factor in full.
+ *
+ *  Return 0 if ok, 1 if not.
+ */
+
 ASC_DLLSPEC int linsolqr_get_pivot_sets(linsolqr_system_t sys,
                                    unsigned *org_rowpivots,
                                    unsigned *org_colpivots);
@@ -859,12 +888,14 @@ extern size_t linsolqr_size(linsolqr_system_t sys);
  *  must do accounting for those.
  */
 
-extern void linsolqr_free_reused_mem(void);
+ASC_DLLSPEC void linsolqr_free_reused_mem(void);
 /**<
  *  Deallocates any memory that linsolqr may be squirrelling away for
  *  internal reuse. Calling this while any slv_system_t using linsolqr exists
  *  is likely to be fatal: handle with care.
  *  There isn't a way to query how many bytes this is.
+ *  The memory is per thread: a worker thread that has factored anything
+ *  should call this, and mtx_free_reused_mem, when it is finished.
  */
 
 /*-----------------------------------------------------------------------------
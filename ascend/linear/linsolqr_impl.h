@@ -134,6 +134,8 @@ struct linsolqr_header {
    real64 smallest_pivot;        /* Smallest pivot accepted */
    struct qr_auxdata *qrdata;    /* Data vectors for qr methods */
    struct lu_auxdata *ludata;    /* Data vectors for lu methods */
+   struct ranki_refactor *refactor; /* Recorded pivot sequence (ranki) */
+   struct supernodal_factors *sndata; /* L and U (supernodal_lu) */
 };
 /* linsol main structure */
 
@@ -217,6 +217,7 @@ static mtx_matrix_t alloc_header(void){
    mtx_matrix_t mtx;
    mtx = (mtx_matrix_t)ascmalloc( sizeof(struct mtx_header) );
    mtx->integrity = OK;
+   mtx->stamp = 0;
    return(mtx);
 }
 
@@ -274,8 +275,9 @@ Excuses for this kluge:
 3) it is faster than passing the mtx
 up and down through the functions listed above, and we do a LOT of
 these operations.
+4) it is per thread, so separate matrices may be used on separate threads.
 */
-static mtx_matrix_t last_value_matrix = NULL;
+static ASC_THREAD_LOCAL mtx_matrix_t last_value_matrix = NULL;
 
 /**
 	Indicates that one of the row or column (it doesn't matter) in which
@@ -290,6 +292,7 @@ static void disclaim_element(struct element_t *element){
     mem_free_element(last_value_matrix->ms,(void *)element);
   } else {
     element->row = element->col = mtx_NONE;
+    last_value_matrix->stamp++;
   }
 }
 
@@ -337,12 +340,14 @@ static void nuke_fishnet(mtx_matrix_t mtx){
   }
   if (mtx->capacity<1) return;
   mtx->last_value = NULL;
+  mtx->stamp++;
   mem_clear_store(mtx->ms);
   zero(mtx->hdr.row,mtx->capacity,struct element_t *);
   zero(mtx->hdr.col,mtx->capacity,struct element_t *);
   for (i = 0; i < mtx->nslaves; i++) {
     zero(mtx->slaves[i]->hdr.row,mtx->capacity,struct element_t *);
     zero(mtx->slaves[i]->hdr.col,mtx->capacity,struct element_t *);
+    mtx->slaves[i]->stamp++;
   }
 }
 
@@ -460,7 +465,8 @@ void mtx_debug_redirect_freeze(){
 static void mtx_redirectErrors(FILE *f){
   if (!g_mtx_debug_redirect) {
     assert(f != NULL);
-    g_mtxerr = f;
+    /* matrices are made on several threads at once: only write if needed */
+    if (g_mtxerr != f) g_mtxerr = f;
   }
 }
 
@@ -2408,7 +2414,7 @@ struct add_series_data {
   int32 t_org;       /* org row/col which is expanded */
 };
 
-static struct add_series_data
+static ASC_THREAD_LOCAL struct add_series_data
   rsdata={NULL,NULL,NULL,mtx_NONE},
   csdata={NULL,NULL,NULL,mtx_NONE};
 
@@ -2796,6 +2802,8 @@ void mtx_free_reused_mem(void){
   (void)mtx_null_vector((int32)0);
   (void)mtx_null_row_vector((int32)0);
   (void)mtx_null_col_vector((int32)0);
+  (void)mtx_null_sum((int32)0);
+  (void)mtx_null_index((int32)0);
 }
 
 
@@ -1181,7 +1181,7 @@ extern size_t mtx_chattel_size(mtx_matrix_t mtx);
  ***  that is not shared with the master. Returns 0 from a slave.
  **/
 
-extern void mtx_free_reused_mem(void);
+ASC_DLLSPEC void mtx_free_reused_mem(void);
 /**<
  ***  Deallocates any memory that mtx may be squirrelling away for
  ***  internal reuse. Calling this while any slv_system_t exists
@@ -0,0 +1,265 @@
+/*	ASCEND modelling environment
+	Copyright (C) 2015 Carnegie Mellon University
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2, or (at your option)
+	any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*//** @file
+	Compressed snapshots of mtx regions, see mtx_csr.h.
+*/
+#include <ascend/general/platform.h>
+#include <ascend/general/ascMalloc.h>
+#include <ascend/general/mem.h>
+#include <ascend/general/mathmacros.h>
+#include "mtx.h"
+
+/* grab our private parts */
+#define __MTX_C_SEEN__
+#include "mtx_use_only.h"
+
+#include "mtx_csr.h"
+
+#include <ascend/utilities/error.h>
+
+struct mtx_csr_header {
+	mtx_matrix_t mtx;         /**< matrix of origin */
+	int32 stamp;              /**< mtx->stamp when the snapshot was taken */
+	int32 order;              /**< mtx->order when the snapshot was taken */
+	mtx_region_t reg;         /**< region, current coordinates */
+	int32 *rows;              /**< org rows of reg.row, current order */
+	int32 *cols;              /**< org cols of reg.col, current order */
+	int32 nnz;
+	int32 *rowptr;            /**< order+1 */
+	int32 *colidx;            /**< nnz, org col of each slot */
+	int32 *colptr;            /**< order+1 */
+	int32 *colslot;           /**< nnz, slots col by col */
+	real64 *value;            /**< nnz */
+	struct element_t **elt;   /**< nnz, matrix element of each slot */
+};
+
+mtx_csr_t mtx_csr_create(mtx_matrix_t mtx, mtx_region_t *region){
+	mtx_csr_t csr;
+	struct element_t *elt;
+	int32 *colcur, *toorg;
+	int32 i, n, r, c, s, t, org;
+
+	if(mtx == NULL || !mtx_check_matrix(mtx)){
+		ERROR_REPORTER_HERE(ASC_PROG_ERR,"Invalid matrix");
+		return NULL;
+	}
+
+	csr = ASC_NEW_CLEAR(struct mtx_csr_header);
+	if(csr == NULL)return NULL;
+	csr->mtx = mtx;
+	csr->stamp = mtx->stamp;
+	csr->order = mtx->order;
+	if(region == mtx_ENTIRE_MATRIX){
+		mtx_region(&(csr->reg),0,mtx->order - 1,0,mtx->order - 1);
+	}else{
+		csr->reg = *region;
+	}
+	colcur = mtx->perm.col.org_to_cur;
+
+	n = csr->reg.row.high - csr->reg.row.low + 1;
+	csr->rows = ASC_NEW_ARRAY(int32,MAX(n,1));
+	toorg = mtx->perm.row.cur_to_org;
+	for(i = 0; i < n; i++){
+		csr->rows[i] = toorg[csr->reg.row.low + i];
+	}
+	n = csr->reg.col.high - csr->reg.col.low + 1;
+	csr->cols = ASC_NEW_ARRAY(int32,MAX(n,1));
+	toorg = mtx->perm.col.cur_to_org;
+	for(i = 0; i < n; i++){
+		csr->cols[i] = toorg[csr->reg.col.low + i];
+	}
+
+	/* count */
+	csr->rowptr = ASC_NEW_ARRAY_CLEAR(int32,mtx->order + 1);
+	csr->colptr = ASC_NEW_ARRAY_CLEAR(int32,mtx->order + 1);
+	for(r = csr->reg.row.low; r <= csr->reg.row.high; r++){
+		org = mtx->perm.row.cur_to_org[r];
+		for(elt = mtx->hdr.row[org]; elt != NULL; elt = elt->next.col){
+			if(in_range(&(csr->reg.col),colcur[elt->col])){
+				csr->rowptr[org + 1]++;
+				csr->colptr[elt->col + 1]++;
+			}
+		}
+	}
+	for(i = 0; i < mtx->order; i++){
+		csr->rowptr[i + 1] += csr->rowptr[i];
+		csr->colptr[i + 1] += csr->colptr[i];
+	}
+	csr->nnz = csr->rowptr[mtx->order];
+
+	n = MAX(csr->nnz,1);
+	csr->colidx = ASC_NEW_ARRAY(int32,n);
+	csr->colslot = ASC_NEW_ARRAY(int32,n);
+	csr->value = ASC_NEW_ARRAY(real64,n);
+	csr->elt = ASC_NEW_ARRAY(struct element_t *,n);
+	if(csr->rows == NULL || csr->cols == NULL || csr->rowptr == NULL
+		|| csr->colptr == NULL || csr->colidx == NULL || csr->colslot == NULL
+		|| csr->value == NULL || csr->elt == NULL
+	){
+		ERROR_REPORTER_HERE(ASC_PROG_ERR,"Insufficient memory");
+		mtx_csr_destroy(csr);
+		return NULL;
+	}
+
+	/* fill rows in org order, each sorted by org col */
+	for(org = 0; org < mtx->order; org++){
+		if(csr->rowptr[org] == csr->rowptr[org + 1])continue;
+		s = csr->rowptr[org];
+		for(elt = mtx->hdr.row[org]; elt != NULL; elt = elt->next.col){
+			if(!in_range(&(csr->reg.col),colcur[elt->col]))continue;
+			/* insertion sort, rows are short */
+			for(t = s; t > csr->rowptr[org] && csr->colidx[t - 1] > elt->col; t--){
+				csr->colidx[t] = csr->colidx[t - 1];
+				csr->elt[t] = csr->elt[t - 1];
+			}
+			csr->colidx[t] = elt->col;
+			csr->elt[t] = elt;
+			s++;
+		}
+		for(s = csr->rowptr[org]; s < csr->rowptr[org + 1]; s++){
+			csr->value[s] = csr->elt[s]->value;
+		}
+	}
+
+	/* column index: slots come out in increasing org row order */
+	for(s = 0, org = 0; org < mtx->order; org++){
+		for(; s < csr->rowptr[org + 1]; s++){
+			c = csr->colidx[s];
+			csr->colslot[csr->colptr[c]++] = s;
+		}
+	}
+	for(c = mtx->order; c > 0; c--){
+		csr->colptr[c] = csr->colptr[c - 1];
+	}
+	csr->colptr[0] = 0;
+	return csr;
+}
+
+void mtx_csr_destroy(mtx_csr_t csr){
+	if(csr == NULL)return;
+	ascfree(csr->rows);
+	ascfree(csr->cols);
+	ascfree(csr->rowptr);
+	ascfree(csr->colidx);
+	ascfree(csr->colptr);
+	ascfree(csr->colslot);
+	ascfree(csr->value);
+	ascfree(csr->elt);
+	ascfree(csr);
+}
+
+int mtx_csr_valid(mtx_csr_t csr, mtx_region_t *region){
+	mtx_matrix_t mtx;
+	int32 i, n, *toorg;
+
+	if(csr == NULL)return 0;
+	mtx = csr->mtx;
+	if(mtx->stamp != csr->stamp || mtx->order != csr->order)return 0;
+	if(region == NULL)return 1;
+
+	if(region == mtx_ENTIRE_MATRIX){
+		if(csr->reg.row.low != 0 || csr->reg.col.low != 0
+			|| csr->reg.row.high != mtx->order - 1
+			|| csr->reg.col.high != mtx->order - 1
+		)return 0;
+	}else if(csr->reg.row.low != region->row.low
+		|| csr->reg.row.high != region->row.high
+		|| csr->reg.col.low != region->col.low
+		|| csr->reg.col.high != region->col.high
+	){
+		return 0;
+	}
+	n = csr->reg.row.high - csr->reg.row.low + 1;
+	toorg = mtx->perm.row.cur_to_org + csr->reg.row.low;
+	for(i = 0; i < n; i++){
+		if(toorg[i] != csr->rows[i])return 0;
+	}
+	n = csr->reg.col.high - csr->reg.col.low + 1;
+	toorg = mtx->perm.col.cur_to_org + csr->reg.col.low;
+	for(i = 0; i < n; i++){
+		if(toorg[i] != csr->cols[i])return 0;
+	}
+	return 1;
+}
+
+mtx_matrix_t mtx_csr_matrix(mtx_csr_t csr){
+	return csr->mtx;
+}
+
+int32 mtx_csr_nonzeros(mtx_csr_t csr){
+	return csr->nnz;
+}
+
+CONST int32 *mtx_csr_rowptr(mtx_csr_t csr){
+	return csr->rowptr;
+}
+
+CONST int32 *mtx_csr_colidx(mtx_csr_t csr){
+	return csr->colidx;
+}
+
+CONST int32 *mtx_csr_colptr(mtx_csr_t csr){
+	return csr->colptr;
+}
+
+CONST int32 *mtx_csr_colslot(mtx_csr_t csr){
+	return csr->colslot;
+}
+
+real64 *mtx_csr_values(mtx_csr_t csr){
+	return csr->value;
+}
+
+int32 mtx_csr_find(mtx_csr_t csr, int32 orgrow, int32 orgcol){
+	int32 lo, hi, mid;
+
+	if(orgrow < 0 || orgrow >= csr->order)return -1;
+	lo = csr->rowptr[orgrow];
+	hi = csr->rowptr[orgrow + 1] - 1;
+	while(lo <= hi){
+		mid = (lo + hi)/2;
+		if(csr->colidx[mid] < orgcol){
+			lo = mid + 1;
+		}else if(csr->colidx[mid] > orgcol){
+			hi = mid - 1;
+		}else{
+			return mid;
+		}
+	}
+	return -1;
+}
+
+void mtx_csr_zero(mtx_csr_t csr){
+	mtx_zero_real64(csr->value,csr->nnz);
+}
+
+int mtx_csr_get(mtx_csr_t csr){
+	int32 s;
+	if(!mtx_csr_valid(csr,NULL))return 1;
+	for(s = 0; s < csr->nnz; s++){
+		csr->value[s] = csr->elt[s]->value;
+	}
+	return 0;
+}
+
+int mtx_csr_put(mtx_csr_t csr){
+	int32 s;
+	if(!mtx_csr_valid(csr,NULL))return 1;
+	for(s = 0; s < csr->nnz; s++){
+		csr->elt[s]->value = csr->value[s];
+	}
+	return 0;
+}
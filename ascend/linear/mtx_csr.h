@@ -0,0 +1,119 @@
+/*	ASCEND modelling environment
+	Copyright (C) 2015 Carnegie Mellon University
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2, or (at your option)
+	any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*//** @file
+	Compressed row/column (CSR/CSC) value storage for an mtx region whose
+	sparsity pattern is fixed.
+
+	Once the incidence of a region of a matrix is known (for example the
+	Jacobian of a block after its first evaluation), mtx_csr_create takes
+	a snapshot of the pattern in compressed arrays. The values can then be
+	refilled in the compressed array (cheap, contiguous writes) and copied
+	into the matrix with mtx_csr_put, which writes straight into the
+	existing elements without searching or allocating.
+
+	The pattern is stored in ORG coordinates, so it is not affected by row
+	and column permutations of the matrix, and the matrix itself remains
+	the master copy: all mtx_* query, permutation and factorization
+	functions work on it as usual.
+
+	The snapshot becomes stale if elements are removed from the matrix
+	(mtx_clear_region, mtx_del_zr_in_row, mtx_transpose etc.) or if the
+	region now covers different org rows or cols. Check with
+	mtx_csr_valid before reusing one. Elements added to the matrix later
+	are simply not part of the snapshot.
+
+	Slot arrays, following the usual conventions:
+	  - org row r has slots rowptr[r] .. rowptr[r+1]-1, with org cols
+	    colidx[slot] in increasing order;
+	  - org col c has slots colslot[colptr[c]] .. colslot[colptr[c+1]-1],
+	    in increasing org row order;
+	  - value[slot] is the value of the element in that slot.
+	Rows and cols outside the region are empty. The arrays are indexed
+	0..mtx_order-1 (rowptr, colptr have one more entry).
+*/
+#ifndef ASC_MTX_CSR_H
+#define ASC_MTX_CSR_H
+
+#include "mtx.h"
+
+/**	@addtogroup linear Linear
+	@{
+*/
+
+typedef struct mtx_csr_header *mtx_csr_t;
+/**< Handle to a compressed snapshot of an mtx region */
+
+ASC_DLLSPEC mtx_csr_t mtx_csr_create(mtx_matrix_t mtx, mtx_region_t *region);
+/**<
+	Take a snapshot of the incidence and values of the given region
+	(current coordinates, or mtx_ENTIRE_MATRIX) of mtx.
+	The matrix must not be destroyed while the snapshot is in use.
+	@return the snapshot, or NULL if mtx is invalid or memory runs out.
+*/
+
+ASC_DLLSPEC void mtx_csr_destroy(mtx_csr_t csr);
+/**< Free a snapshot. The matrix is not affected. NULL is ignored. */
+
+ASC_DLLSPEC int mtx_csr_valid(mtx_csr_t csr, mtx_region_t *region);
+/**<
+	@param region if not NULL, also require that the snapshot was taken
+	              of this region, with the same org rows and cols in it.
+	@return 1 if the elements of the snapshot are all still in the matrix,
+	        0 otherwise.
+*/
+
+ASC_DLLSPEC mtx_matrix_t mtx_csr_matrix(mtx_csr_t csr);
+/**< @return the matrix the snapshot was taken of. */
+
+ASC_DLLSPEC int32 mtx_csr_nonzeros(mtx_csr_t csr);
+/**< @return the number of slots in the snapshot. */
+
+ASC_DLLSPEC CONST int32 *mtx_csr_rowptr(mtx_csr_t csr);
+ASC_DLLSPEC CONST int32 *mtx_csr_colidx(mtx_csr_t csr);
+ASC_DLLSPEC CONST int32 *mtx_csr_colptr(mtx_csr_t csr);
+ASC_DLLSPEC CONST int32 *mtx_csr_colslot(mtx_csr_t csr);
+/**< Index arrays of the snapshot, see the file description. */
+
+ASC_DLLSPEC real64 *mtx_csr_values(mtx_csr_t csr);
+/**<
+	@return the value array of the snapshot. Changes made to it only
+	reach the matrix with mtx_csr_put.
+*/
+
+ASC_DLLSPEC int32 mtx_csr_find(mtx_csr_t csr, int32 orgrow, int32 orgcol);
+/**<
+	@return the slot of (orgrow,orgcol), or -1 if it is not in the
+	snapshot. This is a binary search in the row.
+*/
+
+ASC_DLLSPEC void mtx_csr_zero(mtx_csr_t csr);
+/**< Set all the values of the snapshot (not of the matrix) to zero. */
+
+ASC_DLLSPEC int mtx_csr_get(mtx_csr_t csr);
+/**<
+	Copy values from the matrix into the snapshot.
+	@return 0 on success, 1 if the snapshot is stale (nothing is copied).
+*/
+
+ASC_DLLSPEC int mtx_csr_put(mtx_csr_t csr);
+/**<
+	Copy the values of the snapshot into the matrix elements.
+	@return 0 on success, 1 if the snapshot is stale (nothing is copied).
+*/
+
+/* @} */
+
+#endif /* ASC_MTX_CSR_H */
@@ -1059,6 +1059,7 @@ void transpose_mesh(mtx_matrix_t mtx)
     return;
   }
   nrows = mtx->order;
+  mtx->stamp++; /* elements change org coordinates */
   for( ndx = ZERO ; ndx < nrows ; ndx++) {
     next = mtx->hdr.row[ndx];
     /* traverse the row, turning it into a column behind us as we go. */
@@ -41,7 +41,7 @@
 
 real64 mtx_next_in_row( mtx_matrix_t mtx, mtx_coord_t *coord, mtx_range_t *rng)
 {
-   static struct element_t *elt = NULL;
+   static ASC_THREAD_LOCAL struct element_t *elt = NULL;
    struct element_t Rewind;
 
 #if MTX_DEBUG
@@ -61,7 +61,7 @@ real64 mtx_next_in_row( mtx_matrix_t mtx, mtx_coord_t *coord, mtx_range_t *rng)
 
 real64 mtx_next_in_col( mtx_matrix_t mtx, mtx_coord_t *coord, mtx_range_t *rng)
 {
-   static struct element_t *elt = NULL;
+   static ASC_THREAD_LOCAL struct element_t *elt = NULL;
    struct element_t Rewind;
 
 #if MTX_DEBUG
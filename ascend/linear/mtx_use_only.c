@@ -171,7 +171,7 @@ void mtx_free_perm(int32 *perm)
 
 /* some local scope globals to keep memory so we aren't constantly
    reallocating */
-struct reusable_data_vector
+ASC_THREAD_LOCAL struct reusable_data_vector
   g_mtx_null_index_data = {NULL,0,sizeof(int32),0},
   g_mtx_null_sum_data = {NULL,0,sizeof(real64),0},
   g_mtx_null_mark_data = {NULL,0,sizeof(char),0},
@@ -218,6 +218,7 @@ struct mtx_header {
   struct structural_data_t *data; /**< Pointer to structural information */
   mtx_matrix_t master;            /**< the master of this mtx, if slave */
   mtx_matrix_t *slaves;           /**< array of slave matrices */
+  int32 stamp;                    /**< changed whenever elements are freed */
 };
 
 /**<
@@ -389,6 +390,9 @@ extern void mtx_free_perm(int32 *perm);
   that a floating point exception could cause premature return of an mtx
   client. This way we have a safe place to store pointers to the memory
   even if the user's algorithm loses them.
+  Each thread has its own set of these, so separate matrices may be
+  worked on by separate threads. A thread other than the main one must
+  call mtx_free_reused_mem before it exits or the memory is lost.
 \* ************************************************************************ */
 
 struct reusable_data_vector {
@@ -399,7 +403,7 @@ struct reusable_data_vector {
                          should be 0 if the array is not in use. */
 };
 
-extern struct reusable_data_vector
+extern ASC_THREAD_LOCAL struct reusable_data_vector
   g_mtx_null_index_data,      /**< bunch of int32 */
   g_mtx_null_sum_data,        /**< bunch of mtx_value_t */
   g_mtx_null_mark_data,       /**< bunch of char */
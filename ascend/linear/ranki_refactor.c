@@ -0,0 +1,332 @@
+/*	ASCEND modelling environment
+	Copyright (C) 2015 Carnegie Mellon University
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2, or (at your option)
+	any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*//** @file
+	Replay of ranki factorizations, see ranki_refactor.h.
+*/
+#include <math.h>
+
+#include <ascend/general/platform.h>
+#include <ascend/general/ascMalloc.h>
+#include <ascend/general/tm_time.h>
+#include <ascend/general/mathmacros.h>
+#include <ascend/utilities/error.h>
+
+#include "linsolqr_impl.h"
+#include "mtx_csr.h"
+#include "ranki_refactor.h"
+
+/*
+	Everything below is indexed by k, the current row (col) of the factors
+	relative to sys->rng.low. Row k of P.A.Q, of L (strictly lower part)
+	and of U (strictly upper part) are given by the usual ptr/pos/slot
+	triples, where pos is the column k and slot indexes the value array
+	of the matching snapshot.
+*/
+struct ranki_refactor {
+	enum factor_method fmethod;
+	mtx_region_t reg;       /* region factored, rng x rng */
+	int32 n;                /* order of the region, = rank */
+	mtx_csr_t coef;         /* snapshot of the coefficient region */
+	mtx_csr_t lower;        /* snapshot of sys->factors */
+	mtx_csr_t upper;        /* snapshot of sys->inverse, or NULL */
+	int32 *aptr, *apos, *aslot;
+	int32 *lptr, *lpos, *lslot;
+	int32 *uptr, *upos, *uslot; /* by decreasing column in each row */
+	int32 *dslot;           /* pivot in factors (ranki_kw/jz), or -1 */
+	int32 *mark;            /* work: k if column is in row k's pattern */
+	real64 *w;              /* work: row being eliminated */
+};
+
+void ranki_refactor_destroy(linsolqr_system_t sys){
+	struct ranki_refactor *rf = sys->refactor;
+	if(rf == NULL)return;
+	mtx_csr_destroy(rf->coef);
+	mtx_csr_destroy(rf->lower);
+	mtx_csr_destroy(rf->upper);
+	ascfree(rf->aptr); ascfree(rf->apos); ascfree(rf->aslot);
+	ascfree(rf->lptr); ascfree(rf->lpos); ascfree(rf->lslot);
+	ascfree(rf->uptr); ascfree(rf->upos); ascfree(rf->uslot);
+	ascfree(rf->dslot);
+	ascfree(rf->mark);
+	ascfree(rf->w);
+	ascfree(rf);
+	sys->refactor = NULL;
+}
+
+/**
+	Sort the U entries of a row by decreasing column, the order in which
+	they are eliminated. Rows are short.
+*/
+static void sort_upper_row(int32 *pos, int32 *slot, int32 len){
+	int32 i, j, p, s;
+	for(i = 1; i < len; i++){
+		p = pos[i];
+		s = slot[i];
+		for(j = i; j > 0 && pos[j - 1] < p; j--){
+			pos[j] = pos[j - 1];
+			slot[j] = slot[j - 1];
+		}
+		pos[j] = p;
+		slot[j] = s;
+	}
+}
+
+void ranki_refactor_record(linsolqr_system_t sys){
+	struct ranki_refactor *rf;
+	mtx_matrix_t F;
+	CONST int32 *rowptr, *colidx;
+	int32 n, k, low, org, s, pos, na, nl, nu;
+	int pass;
+
+	ranki_refactor_destroy(sys);
+	switch(sys->fmethod){
+	case ranki_kw:
+	case ranki_jz:
+	case ranki_kw2:
+	case ranki_jz2:
+	case ranki_ba2:
+		break;
+	default:
+		return;
+	}
+	F = sys->factors;
+	if(F == NULL || sys->ludata == NULL || !sys->factored)return;
+	low = sys->rng.low;
+	n = sys->rng.high - low + 1;
+	if(n < 1 || sys->rank != n
+		|| sys->reg.row.low != low || sys->reg.row.high != sys->rng.high
+		|| sys->reg.col.low != low || sys->reg.col.high != sys->rng.high
+	){
+		return; /* only square, nonsingular problems are replayed */
+	}
+
+	rf = ASC_NEW_CLEAR(struct ranki_refactor);
+	sys->refactor = rf;
+	rf->fmethod = sys->fmethod;
+	rf->reg = sys->reg;
+	rf->n = n;
+	rf->coef = mtx_csr_create(sys->coef,&(sys->reg));
+	rf->lower = mtx_csr_create(F,&(sys->reg));
+	if(sys->fmethod != ranki_kw && sys->fmethod != ranki_jz){
+		if(sys->inverse == NULL){
+			ranki_refactor_destroy(sys);
+			return;
+		}
+		rf->upper = mtx_csr_create(sys->inverse,&(sys->reg));
+		if(rf->upper == NULL){
+			ranki_refactor_destroy(sys);
+			return;
+		}
+	}
+	if(rf->coef == NULL || rf->lower == NULL){
+		ranki_refactor_destroy(sys);
+		return;
+	}
+
+	rf->aptr = ASC_NEW_ARRAY_CLEAR(int32,n + 1);
+	rf->lptr = ASC_NEW_ARRAY_CLEAR(int32,n + 1);
+	rf->uptr = ASC_NEW_ARRAY_CLEAR(int32,n + 1);
+	rf->dslot = ASC_NEW_ARRAY(int32,n);
+	rf->mark = ASC_NEW_ARRAY(int32,n);
+	rf->w = ASC_NEW_ARRAY(real64,n);
+	rf->apos = ASC_NEW_ARRAY(int32,mtx_csr_nonzeros(rf->coef) + 1);
+	rf->aslot = ASC_NEW_ARRAY(int32,mtx_csr_nonzeros(rf->coef) + 1);
+
+	/* pass 0 counts L and U entries, pass 1 fills them in */
+	for(pass = 0; pass < 2; pass++){
+		na = nl = nu = 0;
+		for(k = 0; k < n; k++){
+			org = mtx_row_to_org(F,low + k);
+			rf->dslot[k] = -1;
+
+			rowptr = mtx_csr_rowptr(rf->coef);
+			colidx = mtx_csr_colidx(rf->coef);
+			for(s = rowptr[org]; s < rowptr[org + 1]; s++){
+				if(pass){
+					rf->apos[na] = mtx_org_to_col(F,colidx[s]) - low;
+					rf->aslot[na] = s;
+				}
+				na++;
+			}
+
+			rowptr = mtx_csr_rowptr(rf->lower);
+			colidx = mtx_csr_colidx(rf->lower);
+			for(s = rowptr[org]; s < rowptr[org + 1]; s++){
+				pos = mtx_org_to_col(F,colidx[s]) - low;
+				if(pos < k){
+					if(pass){
+						rf->lpos[nl] = pos;
+						rf->lslot[nl] = s;
+					}
+					nl++;
+				}else if(pos == k){
+					/* the ranki2 methods may leave a zero here; leave it be */
+					if(rf->upper == NULL){
+						rf->dslot[k] = s;
+					}
+				}else if(rf->upper == NULL){
+					if(pass){
+						rf->upos[nu] = pos;
+						rf->uslot[nu] = s;
+					}
+					nu++;
+				}else{
+					ranki_refactor_destroy(sys); /* not the layout we know */
+					return;
+				}
+			}
+
+			if(rf->upper != NULL){
+				rowptr = mtx_csr_rowptr(rf->upper);
+				colidx = mtx_csr_colidx(rf->upper);
+				for(s = rowptr[org]; s < rowptr[org + 1]; s++){
+					pos = mtx_org_to_col(F,colidx[s]) - low;
+					if(pos <= k){
+						ranki_refactor_destroy(sys);
+						return;
+					}
+					if(pass){
+						rf->upos[nu] = pos;
+						rf->uslot[nu] = s;
+					}
+					nu++;
+				}
+			}
+			if(pass){
+				sort_upper_row(rf->upos + rf->uptr[k],rf->uslot + rf->uptr[k]
+					,nu - rf->uptr[k]
+				);
+			}else{
+				rf->aptr[k + 1] = na;
+				rf->lptr[k + 1] = nl;
+				rf->uptr[k + 1] = nu;
+			}
+		}
+		if(!pass){
+			rf->lpos = ASC_NEW_ARRAY(int32,nl + 1);
+			rf->lslot = ASC_NEW_ARRAY(int32,nl + 1);
+			rf->upos = ASC_NEW_ARRAY(int32,nu + 1);
+			rf->uslot = ASC_NEW_ARRAY(int32,nu + 1);
+		}
+	}
+}
+
+int ranki_refactor_entry(linsolqr_system_t sys){
+	struct ranki_refactor *rf = sys->refactor;
+	struct rhs_list *rl;
+	real64 *a, *l, *u, *w, *piv;
+	real64 p, mult, rowmax, smallest;
+	int32 *mark;
+	int32 n, k, i, t, m, j;
+	double comptime;
+
+	if(rf == NULL || sys->fmethod != rf->fmethod || sys->ludata == NULL
+		|| mtx_csr_matrix(rf->coef) != sys->coef
+		|| mtx_csr_matrix(rf->lower) != sys->factors
+	){
+		return 1;
+	}
+	if(sys->reg.row.low != rf->reg.row.low || sys->reg.row.high != rf->reg.row.high
+		|| sys->reg.col.low != rf->reg.col.low || sys->reg.col.high != rf->reg.col.high
+	){
+		return 1;
+	}
+	if(!mtx_csr_valid(rf->coef,&(rf->reg)) || !mtx_csr_valid(rf->lower,NULL)
+		|| (rf->upper != NULL && !mtx_csr_valid(rf->upper,NULL))
+	){
+		return 1;
+	}
+	comptime = tm_cpu_time();
+	mtx_csr_get(rf->coef);
+
+	n = rf->n;
+	a = mtx_csr_values(rf->coef);
+	l = mtx_csr_values(rf->lower);
+	u = (rf->upper != NULL) ? mtx_csr_values(rf->upper) : l;
+	piv = sys->ludata->pivlist + rf->reg.row.low;
+	w = rf->w;
+	mark = rf->mark;
+	for(k = 0; k < n; k++){
+		mark[k] = -1;
+	}
+	smallest = MAXDOUBLE;
+
+	/* UL elimination from the bottom row up: row k of A is
+	   L(k,:) + sum over m > k of U(k,m).L(m,:) */
+	for(k = n - 1; k >= 0; k--){
+		mark[k] = k;
+		w[k] = D_ZERO;
+		for(i = rf->lptr[k]; i < rf->lptr[k + 1]; i++){
+			mark[rf->lpos[i]] = k;
+			w[rf->lpos[i]] = D_ZERO;
+		}
+		for(i = rf->uptr[k]; i < rf->uptr[k + 1]; i++){
+			mark[rf->upos[i]] = k;
+			w[rf->upos[i]] = D_ZERO;
+		}
+		for(i = rf->aptr[k]; i < rf->aptr[k + 1]; i++){
+			j = rf->apos[i];
+			if(mark[j] != k){
+				if(a[rf->aslot[i]] != D_ZERO)return 1; /* new incidence */
+				continue;
+			}
+			w[j] += a[rf->aslot[i]];
+		}
+		for(i = rf->uptr[k]; i < rf->uptr[k + 1]; i++){
+			m = rf->upos[i];
+			mult = w[m] / piv[m];
+			u[rf->uslot[i]] = mult;
+			if(mult == D_ZERO)continue;
+			for(t = rf->lptr[m]; t < rf->lptr[m + 1]; t++){
+				j = rf->lpos[t];
+				if(mark[j] != k){
+					if(l[rf->lslot[t]] != D_ZERO)return 1; /* fill we don't have */
+					continue;
+				}
+				w[j] -= mult * l[rf->lslot[t]];
+			}
+		}
+		p = w[k];
+		rowmax = fabs(p);
+		for(i = rf->lptr[k]; i < rf->lptr[k + 1]; i++){
+			l[rf->lslot[i]] = w[rf->lpos[i]];
+			rowmax = MAX(rowmax,fabs(w[rf->lpos[i]]));
+		}
+		if(fabs(p) <= sys->pivot_zero || fabs(p) < sys->ptol * rowmax){
+			return 1; /* this pivot is no longer acceptable */
+		}
+		piv[k] = p;
+		if(rf->dslot[k] >= 0){
+			l[rf->dslot[k]] = p;
+		}
+		smallest = MIN(smallest,fabs(p));
+	}
+
+	if(mtx_csr_put(rf->lower) || (rf->upper != NULL && mtx_csr_put(rf->upper))){
+		return 1;
+	}
+	sys->smallest_pivot = smallest;
+	sys->rank = n;
+	for(rl = sys->rl; rl != NULL; rl = rl->next){
+		rl->solved = FALSE;
+	}
+	sys->factored = TRUE;
+
+	if(g_linsolqr_timing){
+		CONSOLE_DEBUG("Refactor time: %f (%d rows)",tm_cpu_time() - comptime,n);
+	}
+	return 0;
+}
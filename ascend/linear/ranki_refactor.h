@@ -0,0 +1,54 @@
+/*	ASCEND modelling environment
+	Copyright (C) 2015 Carnegie Mellon University
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2, or (at your option)
+	any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*//** @file
+	Numeric refactorization for the ranki methods, reusing the pivot
+	sequence and fill pattern of the previous factorization.
+
+	All the ranki methods leave the factored region as P.A.Q = U.L, with U
+	unit upper triangular and L lower triangular with its diagonal in
+	ludata->pivlist. For ranki_kw/jz both U and L are in sys->factors;
+	for the ranki2 methods L is in sys->factors and U in sys->inverse.
+	Once the permutations P, Q and the incidence of U and L are known,
+	new values of A give new U and L by a plain row by row UL elimination
+	in the same storage, with no pivot search and no allocation.
+*/
+#ifndef ASC_RANKI_REFACTOR_H
+#define ASC_RANKI_REFACTOR_H
+
+#include "linsolqr.h"
+
+struct ranki_refactor;
+
+void ranki_refactor_record(linsolqr_system_t sys);
+/**<
+	Remember the pivot sequence and fill of a full factorization just done.
+	Nothing is recorded unless the factored region is square and of full
+	rank.
+*/
+
+int ranki_refactor_entry(linsolqr_system_t sys);
+/**<
+	Factor the current values of the coefficient matrix by replaying the
+	recorded factorization.
+	@return 0 on success; 1 if there is nothing to replay, the incidence
+	has changed, or a pivot fails the pivot_zero or ptol tests. In that
+	case the factors are garbage and a full factorization must be done.
+*/
+
+void ranki_refactor_destroy(linsolqr_system_t sys);
+/**< Forget any recorded factorization. */
+
+#endif
@@ -134,7 +134,7 @@ struct PivListEntry {
 
 #define EDSC 1234567890
 #define EDEC 987654321
-static
+static ASC_THREAD_LOCAL
 struct elimination_data {
   long startcheck;
   struct PivListEntry *pivdata;	/* org col indexed */
@@ -0,0 +1,993 @@
+/*	ASCEND modelling environment
+	Copyright (C) 2015 Carnegie Mellon University
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2, or (at your option)
+	any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*//** @file
+	Supernodal sparse LU, see supernodal.h.
+
+	Each panel of SN_PANEL columns is factored in three phases:
+	  1. scatter the columns and find, by depth first search through the
+	     row structures, the completed supernodes that update them;
+	  2. apply each of those supernodes to all the panel columns it
+	     updates at once (dense trsm then gemm on its block);
+	  3. for each column in turn, apply the supernodes formed or grown
+	     within the panel, choose the pivot and store the column, either
+	     as one more column of the last supernode or as a new one.
+	The dense kernels are written out here since libascend does not link
+	a BLAS; they follow the dtrsm/dgemm argument conventions so that a
+	vendor library can be substituted.
+*/
+#include "supernodal.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <ascend/general/platform.h>
+#include <ascend/general/ascMalloc.h>
+#include <ascend/general/mathmacros.h>
+#include <ascend/general/tm_time.h>
+#include <ascend/utilities/error.h>
+
+#include "mtx_csr.h"
+
+#define SN_PANEL 8    /* columns per panel, at most bits in an unsigned */
+#define SN_MAXCOL 64  /* widest supernode */
+#define SN_RELAX 4    /* explicit zeros allowed when a column joins one */
+
+struct supernodal_factors {
+	int32 order;     /* order of the matrix factored */
+	int32 n;         /* size of the pivot range */
+	int32 rank;
+	int32 *prow;     /* [n] org row pivoted at step k; unpivoted rows follow */
+	int32 *pcol;     /* [n] org col pivoted at step k; unpivoted cols follow */
+	int32 *rstep;    /* [order] step at which an org row was pivoted, or -1 */
+	int32 *sup;      /* [n] supernode of step k */
+	int32 nsuper;
+	int32 *sfirst;   /* [n+1] first step of supernode s, sfirst[nsuper]==rank */
+	int32 *rptr;     /* [n+1] rows of supernode s are rind[rptr[s]..rptr[s+1]-1] */
+	int32 *rind;     /* org rows, the pivot rows of the supernode first */
+	int32 rcap;
+	size_t *vptr;    /* [n+1] block of supernode s starts at lval[vptr[s]] */
+	real64 *lval;    /* blocks, column major, leading dimension = rows */
+	size_t lcap;
+	int32 *uptr;     /* [n+1] entries of U outside the diagonal blocks, by step */
+	int32 *uind;     /* step (row of U) of each entry */
+	real64 *uval;
+	int32 ucap;
+	real64 y[SN_MAXCOL]; /* solve scratch */
+};
+
+#define SN_NCOL(sn,s) ((sn)->sfirst[(s)+1] - (sn)->sfirst[(s)])
+#define SN_NROW(sn,s) ((sn)->rptr[(s)+1] - (sn)->rptr[(s)])
+#define SN_ROWS(sn,s) ((sn)->rind + (sn)->rptr[(s)])
+#define SN_BLOCK(sn,s) ((sn)->lval + (sn)->vptr[(s)])
+
+/* factoring scratch, one x/rmark/nzr/vis per panel column */
+struct sn_work {
+	real64 *x[SN_PANEL];    /* [order] column, by org row */
+	int32 *rmark[SN_PANEL]; /* [order] tag if row seen in column */
+	int32 *nzr[SN_PANEL];   /* [order] rows seen, not in completed supernodes */
+	int32 nnzr[SN_PANEL];
+	int32 *vis[SN_PANEL];   /* [n] completed supernodes updating the column */
+	int32 nvis[SN_PANEL];
+	unsigned *mask;         /* [n] panel columns a supernode updates */
+	int32 *post;            /* [n] postorder of completed supernodes, panel */
+	int32 npost;
+	int32 *post3;           /* [n] postorder of panel supernodes, column */
+	int32 npost3;
+	int32 *sstamp;          /* [n] visit stamp, per column search */
+	int32 *ustamp;          /* [n] visit stamp, per panel */
+	int32 stamp;
+	int32 *stack;           /* [n] search stack of supernodes */
+	int32 *spos;            /* [n] next row of each supernode on the stack */
+	int32 *rpos;            /* [order] position in the last supernode, or -1 */
+	int32 *rowof;           /* [nnz] org row of each csr slot */
+	int32 *deps;            /* [n] dependent columns */
+	int32 ndeps;
+	real64 *Y;              /* [SN_MAXCOL*SN_PANEL] */
+	real64 *Z;              /* [n*SN_PANEL] */
+};
+
+/*------------------------------------------------------------------------------
+  DENSE KERNELS
+*/
+
+/**
+	Y := inv(L) Y, with L the unit lower triangle of the k x k block
+	at B (leading dimension ldb) and Y k x m (leading dimension k).
+	As dtrsm("L","L","N","U").
+*/
+static void sn_trsm(int32 k, int32 m, CONST real64 *B, int32 ldb, real64 *Y){
+	int32 i, j, r;
+	real64 yi, *y;
+	CONST real64 *b;
+	for(j = 0; j < m; j++){
+		y = Y + (size_t)j * k;
+		for(i = 0; i < k - 1; i++){
+			yi = y[i];
+			if(yi == D_ZERO)continue;
+			b = B + (size_t)i * ldb;
+			for(r = i + 1; r < k; r++){
+				y[r] -= b[r] * yi;
+			}
+		}
+	}
+}
+
+/**
+	Z := B.Y, with B r x k (leading dimension ldb), Y k x m (leading
+	dimension k) and Z r x m (leading dimension r). As dgemm("N","N").
+	Column i of B is used against all m columns of Y while it is in cache.
+*/
+static void sn_gemm(int32 r, int32 k, int32 m
+		, CONST real64 *B, int32 ldb, CONST real64 *Y, real64 *Z
+){
+	int32 i, j, t;
+	real64 yi, *z;
+	CONST real64 *b;
+	for(t = 0; t < r * m; t++){
+		Z[t] = D_ZERO;
+	}
+	for(i = 0; i < k; i++){
+		b = B + (size_t)i * ldb;
+		for(j = 0; j < m; j++){
+			yi = Y[i + (size_t)j * k];
+			if(yi == D_ZERO)continue;
+			z = Z + (size_t)j * r;
+			for(t = 0; t < r; t++){
+				z[t] += b[t] * yi;
+			}
+		}
+	}
+}
+
+/*------------------------------------------------------------------------------
+  STORAGE
+*/
+
+void supernodal_destroy(linsolqr_system_t sys){
+	struct supernodal_factors *sn = sys->sndata;
+	if(sn == NULL)return;
+	ascfree(sn->prow);
+	ascfree(sn->pcol);
+	ascfree(sn->rstep);
+	ascfree(sn->sup);
+	ascfree(sn->sfirst);
+	ascfree(sn->rptr);
+	ascfree(sn->rind);
+	ascfree(sn->vptr);
+	ascfree(sn->lval);
+	ascfree(sn->uptr);
+	ascfree(sn->uind);
+	ascfree(sn->uval);
+	ascfree(sn);
+	sys->sndata = NULL;
+}
+
+size_t supernodal_size(linsolqr_system_t sys){
+	struct supernodal_factors *sn = sys->sndata;
+	if(sn == NULL)return 0;
+	return sizeof(struct supernodal_factors)
+		+ sizeof(int32) * (6 * (size_t)sn->n + (size_t)sn->order + 3)
+		+ sizeof(size_t) * ((size_t)sn->n + 1)
+		+ sizeof(int32) * ((size_t)sn->rcap + (size_t)sn->ucap)
+		+ sizeof(real64) * (sn->lcap + (size_t)sn->ucap);
+}
+
+/** Make room for need more rows in rind. @return 0 if ok */
+static int sn_grow_rows(struct supernodal_factors *sn, int32 len, int32 need){
+	int32 cap;
+	int32 *p;
+	if(len + need <= sn->rcap)return 0;
+	cap = MAX(2 * sn->rcap,len + need);
+	p = (int32 *)ascrealloc(sn->rind,sizeof(int32) * cap);
+	if(p == NULL)return 1;
+	sn->rind = p;
+	sn->rcap = cap;
+	return 0;
+}
+
+/** Make room for need more values in lval. @return 0 if ok */
+static int sn_grow_values(struct supernodal_factors *sn, size_t len, size_t need){
+	size_t cap;
+	real64 *p;
+	if(len + need <= sn->lcap)return 0;
+	cap = MAX(2 * sn->lcap,len + need);
+	p = (real64 *)ascrealloc(sn->lval,sizeof(real64) * cap);
+	if(p == NULL)return 1;
+	sn->lval = p;
+	sn->lcap = cap;
+	return 0;
+}
+
+/** Make room for need more entries of U. @return 0 if ok */
+static int sn_grow_upper(struct supernodal_factors *sn, int32 len, int32 need){
+	int32 cap;
+	int32 *pi;
+	real64 *pv;
+	if(len + need <= sn->ucap)return 0;
+	cap = MAX(2 * sn->ucap,len + need);
+	pi = (int32 *)ascrealloc(sn->uind,sizeof(int32) * cap);
+	if(pi == NULL)return 1;
+	sn->uind = pi;
+	pv = (real64 *)ascrealloc(sn->uval,sizeof(real64) * cap);
+	if(pv == NULL)return 1;
+	sn->uval = pv;
+	sn->ucap = cap;
+	return 0;
+}
+
+/*------------------------------------------------------------------------------
+  SYMBOLIC
+*/
+
+/**
+	Depth first search from supernode s0 for column c of the panel,
+	through completed supernodes (steps < cfirst) only. Rows met that are
+	not pivoted in a completed supernode go on the column's nzr list.
+	Completed supernodes are appended in postorder to the panel list the
+	first time any column of the panel reaches them.
+*/
+static void sn_search_completed(struct supernodal_factors *sn, struct sn_work *w
+		, int c, int32 s0, int32 tag, int32 cfirst, int32 panelstamp
+){
+	int32 top, s, t, r, k, end;
+	int32 *rmark = w->rmark[c];
+	boolean descend;
+
+	w->sstamp[s0] = w->stamp;
+	w->mask[s0] |= 1u << c;
+	w->vis[c][w->nvis[c]++] = s0;
+	top = 0;
+	w->stack[0] = s0;
+	w->spos[0] = sn->rptr[s0] + SN_NCOL(sn,s0);
+	while(top >= 0){
+		s = w->stack[top];
+		end = sn->rptr[s + 1];
+		descend = FALSE;
+		while(w->spos[top] < end){
+			r = sn->rind[w->spos[top]++];
+			if(rmark[r] == tag)continue;
+			rmark[r] = tag;
+			k = sn->rstep[r];
+			if(k >= 0 && k < cfirst){
+				t = sn->sup[k];
+				if(w->sstamp[t] != w->stamp){
+					w->sstamp[t] = w->stamp;
+					w->mask[t] |= 1u << c;
+					w->vis[c][w->nvis[c]++] = t;
+					w->stack[++top] = t;
+					w->spos[top] = sn->rptr[t] + SN_NCOL(sn,t);
+					descend = TRUE;
+					break;
+				}
+			}else{
+				w->nzr[c][w->nnzr[c]++] = r;
+			}
+		}
+		if(descend)continue;
+		if(w->ustamp[s] != panelstamp){
+			w->ustamp[s] = panelstamp;
+			w->post[w->npost++] = s;
+		}
+		top--;
+	}
+}
+
+/**
+	Depth first search from supernode s0 for column c, through the
+	supernodes formed or grown within the panel. New rows go on the
+	column's nzr list; supernodes are appended to post3 in postorder.
+*/
+static void sn_search_panel(struct supernodal_factors *sn, struct sn_work *w
+		, int c, int32 s0, int32 tag
+){
+	int32 top, s, t, r, k, end;
+	int32 *rmark = w->rmark[c];
+	boolean descend;
+
+	w->sstamp[s0] = w->stamp;
+	top = 0;
+	w->stack[0] = s0;
+	w->spos[0] = sn->rptr[s0] + SN_NCOL(sn,s0);
+	while(top >= 0){
+		s = w->stack[top];
+		end = sn->rptr[s + 1];
+		descend = FALSE;
+		while(w->spos[top] < end){
+			r = sn->rind[w->spos[top]++];
+			if(rmark[r] != tag){
+				rmark[r] = tag;
+				w->nzr[c][w->nnzr[c]++] = r;
+			}
+			k = sn->rstep[r];
+			if(k >= 0){
+				t = sn->sup[k];
+				if(w->sstamp[t] != w->stamp){
+					w->sstamp[t] = w->stamp;
+					w->stack[++top] = t;
+					w->spos[top] = sn->rptr[t] + SN_NCOL(sn,t);
+					descend = TRUE;
+					break;
+				}
+			}
+		}
+		if(descend)continue;
+		w->post3[w->npost3++] = s;
+		top--;
+	}
+}
+
+/*------------------------------------------------------------------------------
+  NUMERIC
+*/
+
+/**
+	Apply supernode s to the panel columns in bits: solve with its unit
+	lower diagonal block for their U entries, then subtract the product
+	of its off-diagonal rows with those entries.
+*/
+static void sn_update(struct supernodal_factors *sn, struct sn_work *w
+		, int32 s, unsigned bits
+){
+	int32 ncol = SN_NCOL(sn,s), nrow = SN_NROW(sn,s), noff = nrow - ncol;
+	int32 *rows = SN_ROWS(sn,s);
+	CONST real64 *B = SN_BLOCK(sn,s);
+	int32 i, m, cols[SN_PANEL];
+	real64 *x, *Y, *Z;
+	int c;
+
+	for(m = 0, c = 0; c < SN_PANEL; c++){
+		if(bits & (1u << c))cols[m++] = c;
+	}
+	Y = w->Y;
+	for(c = 0; c < m; c++){
+		x = w->x[cols[c]];
+		for(i = 0; i < ncol; i++){
+			Y[i + c * ncol] = x[rows[i]];
+		}
+	}
+	sn_trsm(ncol,m,B,nrow,Y);
+	for(c = 0; c < m; c++){
+		x = w->x[cols[c]];
+		for(i = 0; i < ncol; i++){
+			x[rows[i]] = Y[i + c * ncol];
+		}
+	}
+	if(noff <= 0)return;
+	Z = w->Z;
+	sn_gemm(noff,ncol,m,B + ncol,nrow,Y,Z);
+	for(c = 0; c < m; c++){
+		x = w->x[cols[c]];
+		for(i = 0; i < noff; i++){
+			x[rows[ncol + i]] -= Z[i + (size_t)c * noff];
+		}
+	}
+}
+
+/**
+	Choose the pivot of panel column c (current column p of the pivot
+	range, org col col) and store the column.
+	@return 0 if ok, 1 if out of memory. A dependent column is recorded
+	in w->deps and not stored.
+*/
+static int sn_store_column(linsolqr_system_t sys, struct supernodal_factors *sn
+		, struct sn_work *w, int c, int32 p, int32 col, int32 tag, int32 cfirst
+){
+	real64 *x = w->x[c];
+	int32 *nzr = w->nzr[c];
+	int32 nnzr = w->nnzr[c];
+	int32 i, j, r, s, o, k, pr, drow, pos, wo, nrow, nl, nu, len;
+	real64 amax, v, pv, *B, tmp;
+	size_t vl;
+	boolean join;
+
+	/* pivot: the SPK1 diagonal if acceptable, else the largest */
+	amax = D_ZERO;
+	pr = -1;
+	for(i = 0; i < nnzr; i++){
+		r = nzr[i];
+		if(sn->rstep[r] != -1)continue;
+		v = fabs(x[r]);
+		if(v > amax){
+			amax = v;
+			pr = r;
+		}
+	}
+	if(amax <= sys->pivot_zero){
+		w->deps[w->ndeps++] = col;
+		return 0;
+	}
+	drow = mtx_row_to_org(sys->coef,sys->rng.low + p);
+	if(w->rmark[c][drow] == tag && sn->rstep[drow] == -1
+		&& fabs(x[drow]) >= sys->ptol * amax
+	){
+		pr = drow;
+	}
+	pv = x[pr];
+	k = sn->rank;
+
+	/* does the column fit the last supernode? */
+	o = sn->nsuper - 1;
+	join = FALSE;
+	if(o >= 0 && sn->sfirst[o] >= cfirst && SN_NCOL(sn,o) < SN_MAXCOL){
+		wo = SN_NCOL(sn,o);
+		if(w->rpos[pr] >= wo){
+			join = TRUE;
+			for(nl = 0, i = 0; i < nnzr; i++){
+				r = nzr[i];
+				if(sn->rstep[r] != -1 || r == pr)continue;
+				if(w->rpos[r] < wo){
+					join = FALSE;
+					break;
+				}
+				nl++;
+			}
+			if(join && SN_NROW(sn,o) - wo - 1 - nl > SN_RELAX){
+				join = FALSE;
+			}
+		}
+	}
+
+	/* U entries from the other supernodes */
+	nu = sn->uptr[k];
+	for(j = 0; j < w->nvis[c] + w->npost3; j++){
+		s = (j < w->nvis[c]) ? w->vis[c][j] : w->post3[j - w->nvis[c]];
+		if(join && s == o)continue;
+		if(sn_grow_upper(sn,nu,SN_NCOL(sn,s)))return 1;
+		for(i = 0; i < SN_NCOL(sn,s); i++){
+			v = x[SN_ROWS(sn,s)[i]];
+			if(v != D_ZERO){
+				sn->uind[nu] = sn->sfirst[s] + i;
+				sn->uval[nu] = v;
+				nu++;
+			}
+		}
+	}
+	sn->uptr[k + 1] = nu;
+
+	if(join){
+		/* bring the pivot row up to the diagonal of the block */
+		wo = SN_NCOL(sn,o);
+		nrow = SN_NROW(sn,o);
+		pos = w->rpos[pr];
+		if(pos != wo){
+			int32 *rows = SN_ROWS(sn,o);
+			B = SN_BLOCK(sn,o);
+			rows[pos] = rows[wo];
+			rows[wo] = pr;
+			w->rpos[rows[pos]] = pos;
+			w->rpos[pr] = wo;
+			for(j = 0; j < wo; j++){
+				tmp = B[pos + (size_t)j * nrow];
+				B[pos + (size_t)j * nrow] = B[wo + (size_t)j * nrow];
+				B[wo + (size_t)j * nrow] = tmp;
+			}
+		}
+		vl = sn->vptr[sn->nsuper];
+		if(sn_grow_values(sn,vl,nrow))return 1;
+		B = sn->lval + vl;
+		for(i = 0; i < nrow; i++){
+			r = SN_ROWS(sn,o)[i];
+			B[i] = (i < wo) ? x[r] : (i == wo ? pv : x[r] / pv);
+		}
+		sn->vptr[sn->nsuper] = vl + nrow;
+		s = o;
+	}else{
+		/* new supernode: the pivot row, then the rest of the column */
+		if(o >= 0){
+			for(i = 0; i < SN_NROW(sn,o); i++){
+				w->rpos[SN_ROWS(sn,o)[i]] = -1;
+			}
+		}
+		s = sn->nsuper;
+		len = sn->rptr[s];
+		if(sn_grow_rows(sn,len,nnzr + 1))return 1;
+		sn->rind[len] = pr;
+		w->rpos[pr] = 0;
+		nrow = 1;
+		for(i = 0; i < nnzr; i++){
+			r = nzr[i];
+			if(sn->rstep[r] != -1 || r == pr)continue;
+			sn->rind[len + nrow] = r;
+			w->rpos[r] = nrow;
+			nrow++;
+		}
+		sn->rptr[s + 1] = len + nrow;
+		vl = sn->vptr[s];
+		if(sn_grow_values(sn,vl,nrow))return 1;
+		B = sn->lval + vl;
+		B[0] = pv;
+		for(i = 1; i < nrow; i++){
+			B[i] = x[sn->rind[len + i]] / pv;
+		}
+		sn->vptr[s + 1] = vl + nrow;
+		sn->sfirst[s] = k;
+		sn->nsuper++;
+	}
+	sn->sfirst[sn->nsuper] = k + 1;
+	sn->rstep[pr] = k;
+	sn->prow[k] = pr;
+	sn->pcol[k] = col;
+	sn->sup[k] = s;
+	sn->rank = k + 1;
+	if(fabs(pv) < sys->smallest_pivot){
+		sys->smallest_pivot = fabs(pv);
+	}
+	return 0;
+}
+
+/** Zero what column c of the panel touched in x. */
+static void sn_clear_column(struct supernodal_factors *sn, struct sn_work *w, int c){
+	real64 *x = w->x[c];
+	int32 i, j, s;
+	for(i = 0; i < w->nnzr[c]; i++){
+		x[w->nzr[c][i]] = D_ZERO;
+	}
+	for(j = 0; j < w->nvis[c] + w->npost3; j++){
+		s = (j < w->nvis[c]) ? w->vis[c][j] : w->post3[j - w->nvis[c]];
+		for(i = 0; i < SN_NROW(sn,s); i++){
+			x[SN_ROWS(sn,s)[i]] = D_ZERO;
+		}
+	}
+}
+
+static void sn_free_work(struct sn_work *w){
+	int c;
+	for(c = 0; c < SN_PANEL; c++){
+		ascfree(w->x[c]);
+		ascfree(w->rmark[c]);
+		ascfree(w->nzr[c]);
+		ascfree(w->vis[c]);
+	}
+	ascfree(w->mask);
+	ascfree(w->post);
+	ascfree(w->post3);
+	ascfree(w->sstamp);
+	ascfree(w->ustamp);
+	ascfree(w->stack);
+	ascfree(w->spos);
+	ascfree(w->rpos);
+	ascfree(w->rowof);
+	ascfree(w->deps);
+	ascfree(w->Y);
+	ascfree(w->Z);
+}
+
+/**
+	Factor the pivot range of sys->coef into sys->sndata.
+	@return 0 if ok, 1 if out of memory.
+*/
+static int sn_factor(linsolqr_system_t sys){
+	struct supernodal_factors *sn;
+	struct sn_work w;
+	mtx_region_t rr;
+	mtx_csr_t A = NULL;
+	CONST int32 *rowptr, *colptr, *colslot;
+	real64 *aval;
+	int32 n, order, p0, pw, p, col, r, s, k, i, e, tag, cfirst, panelstamp, nunp;
+	int c, status = 1;
+
+	order = mtx_order(sys->coef);
+	n = sys->rng.high - sys->rng.low + 1;
+	if(n < 0)n = 0;
+
+	sn = ASC_NEW_CLEAR(struct supernodal_factors);
+	if(sn == NULL)return 1;
+	sys->sndata = sn;
+	sn->order = order;
+	sn->n = n;
+	sn->prow = ASC_NEW_ARRAY(int32,n + 1);
+	sn->pcol = ASC_NEW_ARRAY(int32,n + 1);
+	sn->rstep = ASC_NEW_ARRAY(int32,order + 1);
+	sn->sup = ASC_NEW_ARRAY(int32,n + 1);
+	sn->sfirst = ASC_NEW_ARRAY_CLEAR(int32,n + 2);
+	sn->rptr = ASC_NEW_ARRAY_CLEAR(int32,n + 2);
+	sn->vptr = ASC_NEW_ARRAY_CLEAR(size_t,n + 2);
+	sn->uptr = ASC_NEW_ARRAY_CLEAR(int32,n + 2);
+	if(sn->prow == NULL || sn->pcol == NULL || sn->rstep == NULL
+		|| sn->sup == NULL || sn->sfirst == NULL || sn->rptr == NULL
+		|| sn->vptr == NULL || sn->uptr == NULL
+	){
+		return 1;
+	}
+	for(r = 0; r < order; r++){
+		sn->rstep[r] = -1;
+	}
+	if(n == 0)return 0;
+
+	memset(&w,0,sizeof(struct sn_work));
+	mtx_region(&rr,sys->rng.low,sys->rng.high,sys->rng.low,sys->rng.high);
+	A = mtx_csr_create(sys->coef,&rr);
+	if(A == NULL)goto done;
+	rowptr = mtx_csr_rowptr(A);
+	colptr = mtx_csr_colptr(A);
+	colslot = mtx_csr_colslot(A);
+	aval = mtx_csr_values(A);
+
+	for(c = 0; c < SN_PANEL; c++){
+		w.x[c] = ASC_NEW_ARRAY_CLEAR(real64,order);
+		w.rmark[c] = ASC_NEW_ARRAY_CLEAR(int32,order);
+		w.nzr[c] = ASC_NEW_ARRAY(int32,order);
+		w.vis[c] = ASC_NEW_ARRAY(int32,n);
+		if(w.x[c] == NULL || w.rmark[c] == NULL || w.nzr[c] == NULL
+			|| w.vis[c] == NULL
+		){
+			goto done;
+		}
+	}
+	w.mask = ASC_NEW_ARRAY_CLEAR(unsigned,n);
+	w.post = ASC_NEW_ARRAY(int32,n);
+	w.post3 = ASC_NEW_ARRAY(int32,n);
+	w.sstamp = ASC_NEW_ARRAY_CLEAR(int32,n);
+	w.ustamp = ASC_NEW_ARRAY_CLEAR(int32,n);
+	w.stack = ASC_NEW_ARRAY(int32,n);
+	w.spos = ASC_NEW_ARRAY(int32,n);
+	w.rpos = ASC_NEW_ARRAY(int32,order);
+	w.rowof = ASC_NEW_ARRAY(int32,mtx_csr_nonzeros(A) + 1);
+	w.deps = ASC_NEW_ARRAY(int32,n);
+	w.Y = ASC_NEW_ARRAY(real64,SN_MAXCOL * SN_PANEL);
+	w.Z = ASC_NEW_ARRAY(real64,(size_t)n * SN_PANEL);
+	if(w.mask == NULL || w.post == NULL || w.post3 == NULL || w.sstamp == NULL
+		|| w.ustamp == NULL || w.stack == NULL || w.spos == NULL
+		|| w.rpos == NULL || w.rowof == NULL || w.deps == NULL
+		|| w.Y == NULL || w.Z == NULL
+	){
+		goto done;
+	}
+	for(r = 0; r < order; r++){
+		w.rpos[r] = -1;
+		for(e = rowptr[r]; e < rowptr[r + 1]; e++){
+			w.rowof[e] = r;
+		}
+	}
+
+	panelstamp = 0;
+	for(p0 = 0; p0 < n; p0 += SN_PANEL){
+		pw = MIN(SN_PANEL,n - p0);
+		/* supernodes before the last one, or all if it is full, are done */
+		s = sn->nsuper - 1;
+		cfirst = (s >= 0 && SN_NCOL(sn,s) < SN_MAXCOL) ? sn->sfirst[s] : sn->rank;
+		panelstamp++;
+		w.npost = 0;
+
+		/* 1. scatter and search completed supernodes */
+		for(c = 0; c < pw; c++){
+			p = p0 + c;
+			col = mtx_col_to_org(sys->coef,sys->rng.low + p);
+			tag = p + 1;
+			w.nnzr[c] = 0;
+			w.nvis[c] = 0;
+			w.stamp++;
+			for(e = colptr[col]; e < colptr[col + 1]; e++){
+				r = w.rowof[colslot[e]];
+				w.x[c][r] = aval[colslot[e]];
+				if(w.rmark[c][r] == tag)continue;
+				w.rmark[c][r] = tag;
+				k = sn->rstep[r];
+				if(k >= 0 && k < cfirst){
+					if(w.sstamp[sn->sup[k]] != w.stamp){
+						sn_search_completed(sn,&w,c,sn->sup[k],tag,cfirst,panelstamp);
+					}
+				}else{
+					w.nzr[c][w.nnzr[c]++] = r;
+				}
+			}
+		}
+
+		/* 2. dense updates from completed supernodes, in topological order */
+		for(i = w.npost - 1; i >= 0; i--){
+			s = w.post[i];
+			sn_update(sn,&w,s,w.mask[s]);
+			w.mask[s] = 0;
+		}
+
+		/* 3. finish the columns one at a time */
+		for(c = 0; c < pw; c++){
+			p = p0 + c;
+			col = mtx_col_to_org(sys->coef,sys->rng.low + p);
+			tag = p + 1;
+			w.stamp++;
+			w.npost3 = 0;
+			for(i = 0; i < w.nnzr[c]; i++){
+				k = sn->rstep[w.nzr[c][i]];
+				if(k >= 0 && w.sstamp[sn->sup[k]] != w.stamp){
+					sn_search_panel(sn,&w,c,sn->sup[k],tag);
+				}
+			}
+			for(i = w.npost3 - 1; i >= 0; i--){
+				sn_update(sn,&w,w.post3[i],1u << c);
+			}
+			if(sn_store_column(sys,sn,&w,c,p,col,tag,cfirst))goto done;
+			sn_clear_column(sn,&w,c);
+		}
+	}
+
+	/* unpivoted rows and columns go after the pivots */
+	nunp = sn->rank;
+	for(p = 0; p < n; p++){
+		r = mtx_row_to_org(sys->coef,sys->rng.low + p);
+		if(sn->rstep[r] == -1){
+			sn->prow[nunp++] = r;
+		}
+	}
+	for(i = 0; i < w.ndeps; i++){
+		sn->pcol[sn->rank + i] = w.deps[i];
+	}
+	status = 0;
+
+done:
+	sn_free_work(&w);
+	mtx_csr_destroy(A);
+	return status;
+}
+
+/*------------------------------------------------------------------------------
+  SOLVES
+*/
+
+/**
+	A(prow,pcol) x = b: forward with L then backward with U.
+	arr is indexed by org row on entry; on exit arr[prow[k]] is the value
+	of the variable in org col pcol[k].
+*/
+static void sn_solve_plain(struct supernodal_factors *sn, real64 *arr){
+	int32 s, ncol, nrow, i, j, k, e, f, *rows;
+	real64 *y = sn->y, yj;
+	CONST real64 *B;
+
+	for(s = 0; s < sn->nsuper; s++){
+		ncol = SN_NCOL(sn,s);
+		nrow = SN_NROW(sn,s);
+		rows = SN_ROWS(sn,s);
+		B = SN_BLOCK(sn,s);
+		for(i = 0; i < ncol; i++){
+			y[i] = arr[rows[i]];
+		}
+		sn_trsm(ncol,1,B,nrow,y);
+		for(j = 0; j < ncol; j++){
+			arr[rows[j]] = yj = y[j];
+			if(yj == D_ZERO)continue;
+			for(i = ncol; i < nrow; i++){
+				arr[rows[i]] -= B[i + (size_t)j * nrow] * yj;
+			}
+		}
+	}
+	for(s = sn->nsuper - 1; s >= 0; s--){
+		ncol = SN_NCOL(sn,s);
+		nrow = SN_NROW(sn,s);
+		f = sn->sfirst[s];
+		B = SN_BLOCK(sn,s);
+		for(i = 0; i < ncol; i++){
+			y[i] = arr[sn->prow[f + i]];
+		}
+		for(j = ncol - 1; j >= 0; j--){
+			y[j] /= B[j + (size_t)j * nrow];
+			yj = y[j];
+			for(i = 0; i < j; i++){
+				y[i] -= B[i + (size_t)j * nrow] * yj;
+			}
+		}
+		for(j = 0; j < ncol; j++){
+			k = f + j;
+			arr[sn->prow[k]] = yj = y[j];
+			if(yj == D_ZERO)continue;
+			for(e = sn->uptr[k]; e < sn->uptr[k + 1]; e++){
+				arr[sn->prow[sn->uind[e]]] -= sn->uval[e] * yj;
+			}
+		}
+	}
+}
+
+/**
+	A(prow,pcol)^T x = b: forward with U^T then backward with L^T.
+	arr is indexed by org col on entry; on exit arr[pcol[k]] is the value
+	for org row prow[k].
+*/
+static void sn_solve_transpose(struct supernodal_factors *sn, real64 *arr){
+	int32 s, ncol, nrow, i, j, k, e, f, *rows;
+	real64 *y = sn->y, sum;
+	CONST real64 *B;
+
+	for(s = 0; s < sn->nsuper; s++){
+		ncol = SN_NCOL(sn,s);
+		nrow = SN_NROW(sn,s);
+		f = sn->sfirst[s];
+		B = SN_BLOCK(sn,s);
+		for(j = 0; j < ncol; j++){
+			k = f + j;
+			sum = arr[sn->pcol[k]];
+			for(e = sn->uptr[k]; e < sn->uptr[k + 1]; e++){
+				sum -= sn->uval[e] * arr[sn->pcol[sn->uind[e]]];
+			}
+			for(i = 0; i < j; i++){
+				sum -= B[i + (size_t)j * nrow] * y[i];
+			}
+			y[j] = sum / B[j + (size_t)j * nrow];
+			arr[sn->pcol[k]] = y[j];
+		}
+	}
+	for(s = sn->nsuper - 1; s >= 0; s--){
+		ncol = SN_NCOL(sn,s);
+		nrow = SN_NROW(sn,s);
+		rows = SN_ROWS(sn,s);
+		f = sn->sfirst[s];
+		B = SN_BLOCK(sn,s);
+		for(j = 0; j < ncol; j++){
+			sum = arr[sn->pcol[f + j]];
+			for(i = ncol; i < nrow; i++){
+				k = sn->rstep[rows[i]];
+				if(k >= 0){
+					sum -= B[i + (size_t)j * nrow] * arr[sn->pcol[k]];
+				}
+			}
+			y[j] = sum;
+		}
+		for(j = ncol - 1; j >= 0; j--){
+			for(i = j + 1; i < ncol; i++){
+				y[j] -= B[i + (size_t)j * nrow] * y[i];
+			}
+			arr[sn->pcol[f + j]] = y[j];
+		}
+	}
+}
+
+int supernodal_solve(linsolqr_system_t sys, struct rhs_list *rl){
+	if(sys->sndata == NULL)return 1;
+	zero_unpivoted_vars(sys,rl->varvalue,rl->transpose);
+	if(rl->transpose){
+		sn_solve_transpose(sys->sndata,rl->varvalue);
+	}else{
+		sn_solve_plain(sys->sndata,rl->varvalue);
+	}
+	zero_unpivoted_vars(sys,rl->varvalue,rl->transpose);
+	return 0;
+}
+
+/*------------------------------------------------------------------------------
+  DEPENDENCIES, stored in sys->factors as for ranki2.
+*/
+
+void calc_dependent_rows_supernodal(linsolqr_system_t sys){
+	mtx_coord_t nz;
+	real64 value;
+	mtx_range_t colrange;
+	real64 *lc;
+	mtx_matrix_t mtx;
+
+	sys->rowdeps = TRUE;
+	if(sys->sndata == NULL || sys->rank == 0)return;
+	if(sys->reg.row.low == sys->rng.low
+		&& sys->reg.row.high == sys->rng.low + sys->rank - 1
+	)return;
+	lc = sys->ludata->tmp;
+	colrange.low = sys->rng.low;
+	colrange.high = colrange.low + sys->rank - 1;
+	mtx = sys->factors;
+
+	for(nz.row = sys->reg.row.low; nz.row <= sys->reg.row.high; nz.row++){
+		if(nz.row == colrange.low){
+			nz.row = colrange.high;
+			continue;
+		}
+		mtx_zero_real64(lc,sys->capacity);
+		mtx_org_row_vec(mtx,nz.row,lc,&colrange);
+		sn_solve_transpose(sys->sndata,lc);
+		mtx_clear_row(mtx,nz.row,&colrange);
+		for(nz.col = colrange.low; nz.col <= colrange.high; nz.col++){
+			value = lc[mtx_col_to_org(mtx,nz.col)];
+			if(value != D_ZERO)mtx_fill_value(mtx,&nz,value);
+		}
+	}
+}
+
+void calc_dependent_cols_supernodal(linsolqr_system_t sys){
+	mtx_coord_t nz;
+	real64 value;
+	mtx_range_t rowrange;
+	real64 *lc;
+	mtx_matrix_t mtx;
+
+	sys->coldeps = TRUE;
+	if(sys->sndata == NULL || sys->rank == 0)return;
+	if(sys->reg.col.low == sys->rng.low
+		&& sys->reg.col.high == sys->rng.low + sys->rank - 1
+	)return;
+	lc = sys->ludata->tmp;
+	rowrange.low = sys->rng.low;
+	rowrange.high = rowrange.low + sys->rank - 1;
+	mtx = sys->factors;
+
+	for(nz.col = sys->reg.col.low; nz.col <= sys->reg.col.high; nz.col++){
+		if(nz.col == rowrange.low){
+			nz.col = rowrange.high;
+			continue;
+		}
+		mtx_zero_real64(lc,sys->capacity);
+		mtx_org_col_vec(mtx,nz.col,lc,&rowrange);
+		sn_solve_plain(sys->sndata,lc);
+		mtx_clear_col(mtx,nz.col,&rowrange);
+		for(nz.row = rowrange.low; nz.row <= rowrange.high; nz.row++){
+			value = lc[mtx_row_to_org(mtx,nz.row)];
+			if(value != D_ZERO)mtx_fill_value(mtx,&nz,value);
+		}
+	}
+}
+
+/*------------------------------------------------------------------------------
+  ENTRY
+*/
+
+int supernodal_entry(linsolqr_system_t sys, mtx_region_t *region){
+	struct supernodal_factors *sn;
+	struct rhs_list *rl;
+	double comptime;
+	int32 k, cur;
+
+	CHECK_SYSTEM(sys);
+	if(sys->factored)return 0;
+	if(sys->fmethod != supernodal_lu || ISNULL(sys->ludata))return 1;
+
+	supernodal_destroy(sys);
+	if(NOTNULL(sys->inverse))mtx_destroy(sys->inverse);
+	sys->inverse = NULL;
+	if(NOTNULL(sys->factors))mtx_destroy(sys->factors);
+	if(region == mtx_ENTIRE_MATRIX)determine_pivot_range(sys);
+	else square_region(sys,region);
+
+	sys->factors = mtx_copy_region(sys->coef,region);
+	sys->rank = -1;
+	sys->smallest_pivot = MAXDOUBLE;
+	for(rl = sys->rl; NOTNULL(rl); rl = rl->next){
+		rl->solved = FALSE;
+	}
+	ensure_capacity(sys);
+	ensure_lu_capacity(sys);
+
+	comptime = tm_cpu_time();
+	if(sn_factor(sys)){
+		ERROR_REPORTER_HERE(ASC_PROG_ERR,"Insufficient memory");
+		supernodal_destroy(sys);
+		return 1;
+	}
+	sn = sys->sndata;
+
+	/* put the pivots on the diagonal of sys->factors */
+	for(k = 0; k < sn->n; k++){
+		cur = mtx_org_to_row(sys->factors,sn->prow[k]);
+		if(cur != sys->rng.low + k){
+			mtx_swap_rows(sys->factors,cur,sys->rng.low + k);
+		}
+		cur = mtx_org_to_col(sys->factors,sn->pcol[k]);
+		if(cur != sys->rng.low + k){
+			mtx_swap_cols(sys->factors,cur,sys->rng.low + k);
+		}
+		sys->ludata->pivlist[sys->rng.low + k] = (k < sn->rank)
+			? SN_BLOCK(sn,sn->sup[k])[(k - sn->sfirst[sn->sup[k]])
+				* (size_t)(SN_NROW(sn,sn->sup[k]) + 1)]
+			: D_ZERO;
+	}
+	sys->rank = sn->rank;
+	sys->factored = TRUE;
+
+	if(g_linsolqr_timing){
+		int32 anz = mtx_nonzeros_in_region(sys->coef,region);
+		size_t fnz = sn->vptr[sn->nsuper] + (size_t)sn->uptr[sn->rank];
+		CONSOLE_DEBUG("A-NNZ: %d Factor time: %f Fill %g Supernodes %d"
+			,anz,tm_cpu_time() - comptime
+			,(anz > 0 ? (double)fnz / (double)anz : 0),sn->nsuper
+		);
+	}
+	return 0;
+}
@@ -0,0 +1,64 @@
+/*	ASCEND modelling environment
+	Copyright (C) 2015 Carnegie Mellon University
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2, or (at your option)
+	any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*//** @file
+	Supernodal sparse LU (factor method supernodal_lu).
+
+	A left-looking LU with threshold partial pivoting over the square
+	pivot range of the (usually SPK1 reordered) region:
+
+	    A(prow,pcol) = L.U,  L unit lower, U upper
+
+	Columns are taken in their current order. The pivot of a column is
+	its diagonal row if that is within ptol of the largest candidate,
+	so the SPK1 ordering is kept wherever it is numerically safe. A
+	column with no candidate larger than pivot_zero is dependent and is
+	left unpivoted, so the rank is found as with the ranki methods.
+
+	Consecutive columns of L with the same row structure are stored
+	together as a supernode: a dense column-major block whose top square
+	holds the diagonal block of U and L. Updates from completed
+	supernodes are applied to a panel of columns at a time as a dense
+	triangular solve and matrix product on those blocks, so most of the
+	flops of a large, poorly decomposed block run in dense kernels
+	rather than in linked list traversal.
+
+	sys->factors is a copy of the region permuted to pivot order, as
+	for the ranki methods, so the pivot and dependency queries of
+	linsolqr work unchanged. The numbers themselves are kept here.
+*/
+#ifndef ASC_SUPERNODAL_H
+#define ASC_SUPERNODAL_H
+
+#include "linsolqr_impl.h"
+
+struct supernodal_factors;
+
+int supernodal_entry(linsolqr_system_t sys, mtx_region_t *region);
+/**< Factor the region. @return 0 if ok. */
+
+int supernodal_solve(linsolqr_system_t sys, struct rhs_list *rl);
+/**< Solve for rl->varvalue in place, with the usual ranki conventions. */
+
+void calc_dependent_rows_supernodal(linsolqr_system_t sys);
+void calc_dependent_cols_supernodal(linsolqr_system_t sys);
+
+void supernodal_destroy(linsolqr_system_t sys);
+/**< Free the factors, if any. */
+
+size_t supernodal_size(linsolqr_system_t sys);
+/**< @return memory used by the factors, in bytes. */
+
+#endif
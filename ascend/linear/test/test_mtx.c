@@ -21,6 +21,7 @@
 
 #include <ascend/general/platform.h>
 #include <ascend/linear/mtx_csparse.h>
+#include <ascend/linear/mtx_csr.h>
 
 #include <test/common.h>
 #include <test/assertimpl.h>
@@ -77,11 +78,81 @@ static void test_csparse(void){
 #endif
 }
 
+/*
+	Compressed snapshot of the same matrix, permuted, refilled in place.
+*/
+static void test_csr(void){
+	mtx_matrix_t M;
+	mtx_coord_t C;
+	mtx_region_t G;
+	mtx_csr_t S;
+	real64 *val;
+	CONST int32 *rowptr, *colidx, *colptr, *colslot;
+	int32 s;
+
+	M = mtx_create();
+	mtx_set_order(M,3);
+	mtx_set_value(M,mtx_coord(&C,0,0), 1.0);
+	mtx_set_value(M,mtx_coord(&C,1,1), 3.0);
+	mtx_set_value(M,mtx_coord(&C,2,2), 7.0);
+	mtx_set_value(M,mtx_coord(&C,0,2), 2.0);
+	mtx_set_value(M,mtx_coord(&C,1,0), 2.0);
+	mtx_set_value(M,mtx_coord(&C,1,2), 4.0);
+	mtx_set_value(M,mtx_coord(&C,2,1), 6.0);
+
+	/* the pattern is kept in org coordinates */
+	mtx_swap_rows(M,0,2);
+	mtx_swap_cols(M,0,1);
+
+	S = mtx_csr_create(M,mtx_ENTIRE_MATRIX);
+	CU_ASSERT_FATAL(S != NULL);
+	CU_ASSERT(mtx_csr_nonzeros(S) == 7);
+	CU_ASSERT(mtx_csr_valid(S,mtx_ENTIRE_MATRIX));
+
+	rowptr = mtx_csr_rowptr(S);
+	colidx = mtx_csr_colidx(S);
+	colptr = mtx_csr_colptr(S);
+	colslot = mtx_csr_colslot(S);
+	val = mtx_csr_values(S);
+	CU_ASSERT(rowptr[0] == 0 && rowptr[1] == 2 && rowptr[2] == 5 && rowptr[3] == 7);
+	CU_ASSERT(colidx[0] == 0 && colidx[1] == 2);
+	CU_ASSERT(colptr[0] == 0 && colptr[1] == 2 && colptr[2] == 4 && colptr[3] == 7);
+	CU_ASSERT(colidx[colslot[2]] == 1 && colidx[colslot[3]] == 1);
+	CU_ASSERT(mtx_csr_find(S,1,2) == 4);
+	CU_ASSERT(val[mtx_csr_find(S,1,2)] == 4.0);
+	CU_ASSERT(mtx_csr_find(S,2,0) == -1);
+
+	/* refill: values reach the matrix, in any coordinates */
+	for(s = 0; s < mtx_csr_nonzeros(S); s++){
+		val[s] = 10.0 * val[s];
+	}
+	CU_ASSERT(0 == mtx_csr_put(S));
+	CU_ASSERT(mtx_value(M,mtx_coord(&C,mtx_org_to_row(M,1),mtx_org_to_col(M,2))) == 40.0);
+	CU_ASSERT(mtx_nonzeros_in_region(M,mtx_ENTIRE_MATRIX) == 7);
+
+	mtx_set_value(M,mtx_coord(&C,mtx_org_to_row(M,2),mtx_org_to_col(M,2)), 5.0);
+	CU_ASSERT(0 == mtx_csr_get(S));
+	CU_ASSERT(val[mtx_csr_find(S,2,2)] == 5.0);
+
+	/* a different region is not this snapshot */
+	mtx_region(&G,0,1,0,2);
+	CU_ASSERT(!mtx_csr_valid(S,&G));
+
+	/* removing elements makes the snapshot stale */
+	mtx_clear_region(M,&G);
+	CU_ASSERT(!mtx_csr_valid(S,NULL));
+	CU_ASSERT(1 == mtx_csr_put(S));
+
+	mtx_csr_destroy(S);
+	mtx_destroy(M);
+}
+
 /*===========================================================================*/
 /* Registration information */
 
 #define TESTS(T) \
-	T(csparse)
+	T(csparse) \
+	T(csr)
 
 REGISTER_TESTS_SIMPLE(linear_mtx, TESTS)
 
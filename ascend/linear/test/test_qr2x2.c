@@ -18,8 +18,10 @@
 	Unit test functions for linear/linsolqr.c
 */
 #include <string.h>
+#include <math.h>
 
 #include <ascend/general/platform.h>
+#include <ascend/general/mathmacros.h>
 #include <ascend/linear/linsolqr.h>
 
 #include <test/common.h>
@@ -153,13 +155,236 @@ static void test_qr3x3(void){
 	CU_ASSERT(r==3);
 }
 
+/*
+	Refactor with each ranki method: first a full factorization, then a
+	replay of its pivot sequence on new values, then values for which the
+	old pivots fail the ptol test, so that a full factorization with new
+	pivots must be done instead. Whichever way the factors were got, the
+	solution must be right.
+*/
+#define RF_N 4
+static real64 rf_residual(mtx_matrix_t M, linsolqr_system_t L, real64 *rhs, real64 *b){
+	mtx_coord_t C;
+	real64 r, err = 0.0;
+	int32 i, j;
+	for(i = 0; i < RF_N; i++){
+		r = -b[i];
+		for(j = 0; j < RF_N; j++){
+			r += mtx_value(M,mtx_coord(&C,mtx_org_to_row(M,i),mtx_org_to_col(M,j)))
+				* linsolqr_var_value(L,rhs,j);
+		}
+		err = MAX(err,fabs(r));
+	}
+	return err;
+}
+
+/*
+	Store the pivot sequence of L in piv (the original row and column of
+	each pivot in turn).
+	@return 1 if it differs from the sequence already in piv, else 0
+*/
+static int rf_pivots(linsolqr_system_t L, int32 piv[2 * RF_N]){
+	mtx_matrix_t F = linsolqr_get_factors(L);
+	int32 k, r, c;
+	int changed = 0;
+	for(k = 0; k < RF_N; k++){
+		r = mtx_row_to_org(F,k);
+		c = mtx_col_to_org(F,k);
+		if(piv[2 * k] != r || piv[2 * k + 1] != c)changed = 1;
+		piv[2 * k] = r;
+		piv[2 * k + 1] = c;
+	}
+	return changed;
+}
+
+static void rf_fill(mtx_matrix_t M, real64 diag, real64 off, real64 scale, real64 *rhs, real64 *b){
+	static const real64 A[RF_N][RF_N] = {
+		{4, 1, 0, 1}
+		,{1, 3, 1, 0}
+		,{0, 1, 5, 2}
+		,{1, 0, 2, 6}
+	};
+	mtx_coord_t C;
+	real64 a;
+	int32 i, j;
+	for(i = 0; i < RF_N; i++){
+		b[i] = 0.0;
+		for(j = 0; j < RF_N; j++){
+			if(A[i][j] == 0)continue;
+			a = (i == j ? diag : off) * A[i][j] * (1.0 + scale * (i + 2 * j));
+			mtx_set_value(M,mtx_coord(&C,mtx_org_to_row(M,i),mtx_org_to_col(M,j)),a);
+			b[i] += a * (j + 1);
+		}
+		rhs[i] = b[i];
+	}
+}
+
+static void test_refactor(void){
+	enum factor_method fm[] = {ranki_kw, ranki_jz, ranki_kw2, ranki_jz2, ranki_ba2};
+	linsolqr_system_t L;
+	mtx_matrix_t M;
+	mtx_region_t G;
+	real64 rhs[RF_N], b[RF_N];
+	int32 piv[2 * RF_N];
+	unsigned k;
+
+	for(k = 0; k < sizeof(fm)/sizeof(fm[0]); k++){
+		M = mtx_create();
+		mtx_set_order(M,RF_N);
+		rf_fill(M,1.0,1.0,0.0,rhs,b);
+		mtx_region(&G,0,RF_N - 1,0,RF_N - 1);
+
+		L = linsolqr_create_default();
+		linsolqr_set_matrix(L,M);
+		linsolqr_set_region(L,G);
+		linsolqr_prep(L,linsolqr_fmethod_to_fclass(fm[k]));
+		linsolqr_add_rhs(L,rhs,FALSE);
+		linsolqr_reorder(L,&G,spk1);
+
+		CU_ASSERT(0 == linsolqr_refactor(L,fm[k]));
+		CU_ASSERT(linsolqr_rank(L) == RF_N);
+		(void)rf_pivots(L,piv);
+		linsolqr_solve(L,rhs);
+		CU_ASSERT(rf_residual(M,L,rhs,b) < 1e-12);
+
+		/* same incidence, new values */
+		rf_fill(M,1.0,1.0,0.1,rhs,b);
+		linsolqr_matrix_was_changed(L);
+		linsolqr_rhs_was_changed(L,rhs);
+		CU_ASSERT(0 == linsolqr_refactor(L,fm[k]));
+		CU_ASSERT(0 == rf_pivots(L,piv));
+		linsolqr_solve(L,rhs);
+		CU_ASSERT(rf_residual(M,L,rhs,b) < 1e-12);
+
+		/* small off-diagonals: the pivots that the first factorization
+		took off the diagonal fail the ptol test, so the replay must give
+		up and fall back on a full factorization, which picks new ones */
+		rf_fill(M,1.0,1e-9,0.1,rhs,b);
+		linsolqr_matrix_was_changed(L);
+		linsolqr_rhs_was_changed(L,rhs);
+		CU_ASSERT(0 == linsolqr_refactor(L,fm[k]));
+		CU_ASSERT(linsolqr_rank(L) == RF_N);
+		CU_ASSERT(1 == rf_pivots(L,piv));
+		linsolqr_solve(L,rhs);
+		CU_ASSERT(rf_residual(M,L,rhs,b) < 1e-12);
+
+		/* and the other way about: a tiny diagonal */
+		rf_fill(M,1e-9,1.0,0.1,rhs,b);
+		linsolqr_matrix_was_changed(L);
+		linsolqr_rhs_was_changed(L,rhs);
+		CU_ASSERT(0 == linsolqr_refactor(L,fm[k]));
+		CU_ASSERT(linsolqr_rank(L) == RF_N);
+		CU_ASSERT(1 == rf_pivots(L,piv));
+		linsolqr_solve(L,rhs);
+		CU_ASSERT(rf_residual(M,L,rhs,b) < 1e-12);
+
+		linsolqr_set_matrix(L,NULL);
+		linsolqr_destroy(L);
+		mtx_destroy(M);
+	}
+}
+
+/*
+	Supernodal LU against ranki_ba2 on a banded matrix with a few long
+	couplings and one row that is twice another. Both right hand sides
+	are consistent, so every equation must be satisfied, including the
+	dependent one.
+*/
+#define SN_N 40
+static void sn_fill(mtx_matrix_t M){
+	mtx_coord_t C;
+	int32 i, j;
+	for(i = 0; i < SN_N - 1; i++){
+		mtx_set_value(M,mtx_coord(&C,i,i),4.0);
+		if(i > 0)mtx_set_value(M,mtx_coord(&C,i,i - 1),-1.0);
+		mtx_set_value(M,mtx_coord(&C,i,i + 1),-1.0);
+		j = (7 * i + 3) % SN_N;
+		if(j != i)mtx_set_value(M,mtx_coord(&C,i,j),0.5);
+	}
+	for(j = 0; j < SN_N; j++){
+		real64 a = mtx_value(M,mtx_coord(&C,3,j));
+		if(a != 0.0)mtx_set_value(M,mtx_coord(&C,SN_N - 1,j),2.0 * a);
+	}
+}
+
+static real64 sn_residual(mtx_matrix_t M, linsolqr_system_t L
+		, real64 *rhs, real64 *b, boolean transpose
+){
+	mtx_coord_t C;
+	real64 r, a, err = 0.0;
+	int32 i, j;
+	for(i = 0; i < SN_N; i++){
+		r = -b[i];
+		for(j = 0; j < SN_N; j++){
+			if(transpose){
+				a = mtx_value(M,mtx_coord(&C,mtx_org_to_row(M,j),mtx_org_to_col(M,i)));
+			}else{
+				a = mtx_value(M,mtx_coord(&C,mtx_org_to_row(M,i),mtx_org_to_col(M,j)));
+			}
+			if(a != 0.0)r += a * linsolqr_var_value(L,rhs,j);
+		}
+		err = MAX(err,fabs(r));
+	}
+	return err;
+}
+
+static void test_supernodal(void){
+	enum factor_method fm[] = {ranki_ba2, supernodal_lu};
+	int32 rank[2];
+	linsolqr_system_t L;
+	mtx_matrix_t M;
+	mtx_region_t G;
+	mtx_coord_t C;
+	real64 rhs[SN_N], rhst[SN_N], b[SN_N], bt[SN_N];
+	int32 i, j;
+	unsigned k;
+
+	for(k = 0; k < sizeof(fm)/sizeof(fm[0]); k++){
+		M = mtx_create();
+		mtx_set_order(M,SN_N);
+		sn_fill(M);
+		for(i = 0; i < SN_N; i++){
+			b[i] = bt[i] = 0.0;
+			for(j = 0; j < SN_N; j++){
+				b[i] += mtx_value(M,mtx_coord(&C,i,j)) * (j + 1);
+				bt[i] += mtx_value(M,mtx_coord(&C,j,i)) * (SN_N - j);
+			}
+			rhs[i] = b[i];
+			rhst[i] = bt[i];
+		}
+		mtx_region(&G,0,SN_N - 1,0,SN_N - 1);
+
+		L = linsolqr_create_default();
+		linsolqr_set_matrix(L,M);
+		linsolqr_set_region(L,G);
+		linsolqr_prep(L,linsolqr_fmethod_to_fclass(fm[k]));
+		linsolqr_add_rhs(L,rhs,FALSE);
+		linsolqr_add_rhs(L,rhst,TRUE);
+		linsolqr_reorder(L,&G,spk1);
+		CU_ASSERT(0 == linsolqr_factor(L,fm[k]));
+		rank[k] = linsolqr_rank(L);
+		linsolqr_solve(L,rhs);
+		CU_ASSERT(sn_residual(M,L,rhs,b,FALSE) < 1e-8);
+		linsolqr_solve(L,rhst);
+		CU_ASSERT(sn_residual(M,L,rhst,bt,TRUE) < 1e-8);
+
+		linsolqr_set_matrix(L,NULL);
+		linsolqr_destroy(L);
+		mtx_destroy(M);
+	}
+	CU_ASSERT(rank[0] == SN_N - 1);
+	CU_ASSERT(rank[1] == rank[0]);
+}
+
 /*===========================================================================*/
 /* Registration information */
 
 #define TESTS(T)\
 	T(qr1x1) \
 	T(qr2x2) \
-	T(qr3x3)
+	T(qr3x3) \
+	T(refactor) \
+	T(supernodal)
 
 REGISTER_TESTS_SIMPLE(linear_qrrank, TESTS)
 
@@ -818,11 +818,19 @@ static boolean do_command(int command)
 
 void Solve(struct Instance *i)
 {
-   if( sys != NULL )
+   if( sys != NULL ) {
       if( inst != i || !USER_SAYS_KEEP ) {
 	 system_destroy(sys);
          sys = NULL;
+      } else {
+         /* METHODs may have been run on it since: bring it up to date */
+         sys = system_rebuild(sys);
+         if( sys != NULL ) {
+            PRINTF("Presolving . . .\n");
+            do_command(C_PRESOLVE);
+         }
       }
+   }
 
    if( sys == NULL ) {
       sys = system_build(i);
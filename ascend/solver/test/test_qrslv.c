@@ -1,3 +1,4 @@
+#include <math.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -200,6 +201,91 @@ static void test_fixedbug564(void){
 	load_solve_test_qrslv("models","test/qrslv/akash_eos.a4c","akash_eos",1);
 }
 
+/**
+	Set the QRSlv parameter 'threads', then run on_load and solve the system
+	from there.
+*/
+static void solve_with_threads(slv_system_t sys, struct Instance *root, int nthreads){
+	slv_parameters_t p;
+	slv_status_t status;
+	int i, index = -1;
+
+	slv_get_parameters(sys, &p);
+	for(i=0;i<p.num_parms;++i){
+		if(strcmp(p.parms[i].name,"threads")==0)index = i;
+	}
+	CU_ASSERT_FATAL(index != -1);
+	SLV_PARAM_INT(&p,index) = nthreads;
+	slv_set_parameters(sys, &p);
+
+	CU_ASSERT(Proc_all_ok == Initialize(root, CreateIdName(AddSymbol("on_load"))
+		, "sim1", ASCERR, WP_STOPONERR, NULL, NULL)
+	);
+	CU_ASSERT_FATAL(0 == slv_presolve(sys));
+	slv_get_status(sys, &status);
+	CU_ASSERT_FATAL(status.ready_to_solve);
+	slv_solve(sys);
+	slv_get_status(sys, &status);
+	CU_ASSERT(status.ok);
+	CU_ASSERT(status.converged);
+}
+
+/**
+	Solve a model of many independent blocks on two threads and check that
+	the answer is the one found solving the blocks one after another.
+*/
+static void test_threads(void){
+	int status, qrslv_index;
+	struct Instance *siminst, *root;
+	slv_system_t sys;
+	struct var_variable **vl;
+	double *serial;
+	unsigned long j, n;
+
+	Asc_CompilerInit(1);
+	CU_TEST(0 == Asc_PutEnv(ASC_ENV_LIBRARY "=models"));
+	CU_TEST(0 == Asc_PutEnv(ASC_ENV_SOLVERS "=solvers/qrslv"));
+	package_load("qrslv",NULL);
+	qrslv_index = slv_lookup_client("QRSlv");
+	CU_ASSERT_FATAL(qrslv_index != -1);
+
+	Asc_OpenModule("test/qrslv/blocks.a4c",&status);
+	CU_ASSERT_FATAL(status == 0);
+	CU_ASSERT(0 == zz_parse());
+	siminst = SimsCreateInstance(AddSymbol("blocks"), AddSymbol("sim1"), e_normal, NULL);
+	CU_ASSERT_FATAL(siminst!=NULL);
+	root = GetSimulationRoot(siminst);
+
+	sys = system_build(root);
+	CU_ASSERT_FATAL(sys != NULL);
+	CU_ASSERT_FATAL(slv_select_solver(sys,qrslv_index));
+
+	solve_with_threads(sys, root, 1);
+	vl = slv_get_master_var_list(sys);
+	n = slv_get_num_master_vars(sys);
+	CU_ASSERT_FATAL(n > 0);
+	serial = ASC_NEW_ARRAY(double,n);
+	for(j=0;j<n;++j){
+		serial[j] = var_value(vl[j]);
+	}
+
+	solve_with_threads(sys, root, 2);
+	for(j=0;j<n;++j){
+		CU_ASSERT(fabs(var_value(vl[j]) - serial[j]) <= 1e-10 * (1 + fabs(serial[j])));
+	}
+	ASC_FREE(serial);
+
+	CU_ASSERT(Proc_all_ok == Initialize(root, CreateIdName(AddSymbol("self_test"))
+		, "sim1", ASCERR, WP_STOPONERR, NULL, NULL)
+	);
+
+	system_destroy(sys);
+	system_free_reused_mem();
+	solver_destroy_engines();
+	sim_destroy(siminst);
+	Asc_CompilerDestroy();
+}
+
 /*===========================================================================*/
 /* Registration information */
 
@@ -207,7 +293,8 @@ static void test_fixedbug564(void){
 	T(fixedbug513_no_simplify) \
 	X T(fixedbug513_simplify) \
 	X T(fixedbug567) \
-	X T(fixedbug564)
+	X T(fixedbug564) \
+	X T(threads)
 
 #define X
 #define TESTS(T) TESTS1(T,X)
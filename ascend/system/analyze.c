@@ -94,6 +94,7 @@
 #include <ascend/compiler/case.h>
 #include <ascend/compiler/when_util.h>
 #include <ascend/compiler/link.h>
+#include <ascend/compiler/valstore.h>
 
 #include "slv_server.h"
 #include "cond_config.h"
@@ -1690,6 +1691,13 @@ void GetTolerance(struct bnd_boundary *bnd){
 
 /*----------------------------------------------------------------------------*/
 
+/* copy the var flags the value store keeps, if the atom has a slot there */
+static
+void StoreVarFlags(struct Instance *i, uint32 flags){
+  ValueStoreSetFlag(i,VS_INCLUDED,(flags & VAR_INCIDENT) != 0);
+  ValueStoreSetFlag(i,VS_ACTIVE,(flags & VAR_ACTIVE) != 0);
+}
+
 /**
 	Here we roll the master lists and bridge data into relation/var/
 	logrelation/conditional/when etc. lists for the consumer.
@@ -1992,6 +2000,7 @@ int analyze_make_solvers_lists(struct problem_t *p_data){
     if(vip->u.v.deriv > 1) flags |= VAR_DERIV; /* so that we can do relman_diffs with just the ydot vars */
 
     var_set_flags(var,flags);
+    StoreVarFlags(vip->i,flags);
     p_data->mastervl[v] = var;
     p_data->solvervl[v] = var;
   }
@@ -2016,6 +2025,7 @@ int analyze_make_solvers_lists(struct problem_t *p_data){
     if(vip->u.v.fixed)     flags |= VAR_FIXED;
     if(vip->u.v.solvervar) flags |= VAR_SVAR; /* shouldn't this be here? */
     var_set_flags(var,flags);
+    StoreVarFlags(vip->i,flags);
     p_data->masterpl[v] = var;
     p_data->solverpl[v] = var;
   }
@@ -2041,6 +2051,7 @@ int analyze_make_solvers_lists(struct problem_t *p_data){
 	/* CONSOLE_DEBUG("VAR AT %p IS UNASSIGNED",var); */
     /* others may be appropriate (PVAR) */
     var_set_flags(var,flags);
+    StoreVarFlags(vip->i,flags);
     p_data->masterul[v] = var;
     p_data->solverul[v] = var;
   }
@@ -2751,6 +2762,112 @@ int analyze_make_problem(slv_system_t sys, struct Instance *inst){
   return 0;
 }
 
+/*----------------------------------------------------------------------------*/
+/*
+	Incremental re-analysis. Of what classify_instance reads from the tree,
+	only the 'fixed', 'basis' and 'included' children can be changed by
+	METHODs without changing the tree itself, and the values controlling
+	WHENs only decide which rels and vars are active. So for a system whose
+	instance tree is unchanged, we revisit just those flags, leaving the
+	lists, indices and incidence as they were built.
+*/
+
+static
+int UpdateVarFlags(struct var_variable **vl, int nonbasic){
+  struct var_variable *var;
+  struct Instance *i;
+  int fixed, changed = 0;
+  for( ; vl != NULL && *vl != NULL; vl++) {
+    var = *vl;
+    if(!(var_flags(var) & VAR_SVAR)) continue; /* pars stay fixed */
+    i = (struct Instance *)var_instance(var);
+    fixed = BooleanChildValue(i,FIXED_A) ? 1 : 0;
+    if(fixed != ((var_flags(var) & VAR_FIXED) != 0)) {
+      var_set_flagbit(var,VAR_FIXED,fixed);
+      changed++;
+    }
+    if(nonbasic) {
+      /* not a change in the degrees of freedom, so not counted */
+      var_set_flagbit(var,VAR_NONBASIC,!BooleanChildValue(i,BASIS_A));
+    }
+  }
+  return changed;
+}
+
+static
+int UpdateRelFlags(struct rel_relation **rl, uint32 bits){
+  int included, changed = 0;
+  for( ; rl != NULL && *rl != NULL; rl++) {
+    included = BooleanChildValue((struct Instance *)rel_instance(*rl),INCLUDED_A) ? 1 : 0;
+    if(included != ((rel_flags(*rl) & REL_INCLUDED) != 0)) {
+      rel_set_flagbit(*rl,bits,included);
+      changed++;
+    }
+  }
+  return changed;
+}
+
+static
+int UpdateLogRelFlags(struct logrel_relation **ll, uint32 bits){
+  int included, changed = 0;
+  for( ; ll != NULL && *ll != NULL; ll++) {
+    included = BooleanChildValue((struct Instance *)logrel_instance(*ll),INCLUDED_A) ? 1 : 0;
+    if(included != ((logrel_flags(*ll) & LOGREL_INCLUDED) != 0)) {
+      logrel_set_flagbit(*ll,bits,included);
+      changed++;
+    }
+  }
+  return changed;
+}
+
+static
+int UpdateDisFlags(struct dis_discrete **dl){
+  int fixed, changed = 0;
+  for( ; dl != NULL && *dl != NULL; dl++) {
+    if(!(dis_flags(*dl) & DIS_BVAR)) continue;
+    fixed = BooleanChildValue((struct Instance *)dis_instance(*dl),FIXED_A) ? 1 : 0;
+    if(fixed != ((dis_flags(*dl) & DIS_FIXED) != 0)) {
+      dis_set_flagbit(*dl,DIS_FIXED,fixed);
+      changed++;
+    }
+  }
+  return changed;
+}
+
+int analyze_update_problem(slv_system_t sys){
+  struct rel_relation **rl;
+  int changed = 0;
+
+  INCLUDED_A = AddSymbol("included");
+  FIXED_A = AddSymbol("fixed");
+  BASIS_A = AddSymbol("basis");
+
+  changed += UpdateVarFlags(slv_get_master_var_list(sys),1);
+  changed += UpdateVarFlags(slv_get_master_unattached_list(sys),0);
+  changed += UpdateDisFlags(slv_get_master_dvar_list(sys));
+  changed += UpdateRelFlags(slv_get_master_rel_list(sys),REL_INCLUDED|REL_INBLOCK);
+  changed += UpdateRelFlags(slv_get_master_condrel_list(sys),REL_INCLUDED|REL_INBLOCK|REL_ACTIVE);
+  changed += UpdateLogRelFlags(slv_get_master_logrel_list(sys),LOGREL_INCLUDED);
+  changed += UpdateLogRelFlags(slv_get_master_condlogrel_list(sys),LOGREL_INCLUDED|LOGREL_ACTIVE);
+
+  /* objectives: the first included one is the objective, as when built */
+  rl = slv_get_master_obj_list(sys);
+  changed += UpdateRelFlags(rl,REL_INCLUDED|REL_INBLOCK|REL_ACTIVE);
+  slv_set_obj_relation(sys,NULL);
+  for( ; rl != NULL && *rl != NULL; rl++) {
+    if(rel_flags(*rl) & REL_INCLUDED) {
+      slv_set_obj_relation(sys,*rl);
+      break;
+    }
+  }
+
+  if(slv_get_num_master_whens(sys) > 0) {
+    /* picks up the WHEN variable values and resets the ACTIVE flags */
+    reanalyze_solver_lists(sys);
+  }
+  return changed;
+}
+
 extern void analyze_free_reused_mem(void){
   resize_ipbuf((size_t)0,0);
 }
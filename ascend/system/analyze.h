@@ -78,6 +78,18 @@ extern int analyze_make_problem(slv_system_t sys, struct Instance *inst);
 		back end.
 */
 
+extern int analyze_update_problem(slv_system_t sys);
+/**<
+	Refresh the flags of a system made by analyze_make_problem from its
+	instance tree, which must not have changed since: fixed and basis of
+	variables, included of relations and logical relations, the objective
+	relation, and (if there are WHENs) the ACTIVE flags. Called by
+	system_rebuild.
+
+	@return the number of variables and relations whose fixed or included
+		flag changed.
+*/
+
 extern void analyze_free_reused_mem(void);
 /**< 
 	Resets all internal memory recycles.
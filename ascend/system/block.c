@@ -958,6 +958,114 @@ int slv_tear_drop_reorder_block(slv_system_t sys, int32 bnum,
   return 0;
 }
 
+/*------------------------------------------------------------------------------
+  BLOCK DEPENDENCIES
+*/
+
+slv_block_graph_t *slv_block_graph_create(slv_system_t sys){
+	const mtx_block_t *b;
+	struct rel_relation **rp;
+	struct var_variable **vp;
+	const struct var_variable **incid;
+	slv_block_graph_t *g;
+	int32 *colblock, *mark, *epred, *esucc, *fill;
+	int32 vlen, i, j, k, c, r, ninc, nedge = 0, cap;
+
+	if(sys==NULL) return NULL;
+	b = slv_get_solvers_blocks(sys);
+	if(b==NULL || b->nblocks < 1 || b->block==NULL) return NULL;
+	rp = slv_get_solvers_rel_list(sys);
+	vp = slv_get_solvers_var_list(sys);
+	vlen = slv_get_num_solvers_vars(sys);
+
+	colblock = ASC_NEW_ARRAY(int32,vlen);
+	mark = ASC_NEW_ARRAY(int32,b->nblocks);
+	cap = b->nblocks + 1;
+	epred = ASC_NEW_ARRAY(int32,cap);
+	esucc = ASC_NEW_ARRAY(int32,cap);
+	g = ASC_NEW(slv_block_graph_t);
+	if(colblock==NULL || mark==NULL || epred==NULL || esucc==NULL || g==NULL){
+		goto fail;
+	}
+	for(c=0; c<vlen; c++) colblock[c] = -1;
+	for(j=0; j<b->nblocks; j++){
+		mark[j] = -1;
+		for(c=b->block[j].col.low; c<=b->block[j].col.high; c++){
+			colblock[c] = j;
+		}
+	}
+
+	/* list the edges i->j, once each */
+	for(j=0; j<b->nblocks; j++){
+		for(r=b->block[j].row.low; r<=b->block[j].row.high; r++){
+			incid = rel_incidence_list(rp[r]);
+			ninc = rel_n_incidences(rp[r]);
+			for(k=0; k<ninc; k++){
+				c = var_sindex(incid[k]);
+				if(c<0 || c>=vlen || vp[c]!=incid[k]) continue;
+				i = colblock[c];
+				if(i<0 || i==j || mark[i]==j) continue;
+				mark[i] = j;
+				if(nedge==cap){
+					cap *= 2;
+					epred = (int32 *)ascrealloc(epred,cap*sizeof(int32));
+					esucc = (int32 *)ascrealloc(esucc,cap*sizeof(int32));
+					if(epred==NULL || esucc==NULL) goto fail;
+				}
+				epred[nedge] = i;
+				esucc[nedge] = j;
+				nedge++;
+			}
+		}
+	}
+
+	g->nblocks = b->nblocks;
+	g->npred = ASC_NEW_ARRAY_CLEAR(int32,b->nblocks);
+	g->succptr = ASC_NEW_ARRAY_CLEAR(int32,b->nblocks+1);
+	g->succ = ASC_NEW_ARRAY(int32,nedge+1);
+	if(g->npred==NULL || g->succptr==NULL || g->succ==NULL){
+		slv_block_graph_destroy(g);
+		g = NULL;
+		goto fail;
+	}
+	for(k=0; k<nedge; k++){
+		g->npred[esucc[k]]++;
+		g->succptr[epred[k]+1]++;
+	}
+	for(i=0; i<b->nblocks; i++){
+		g->succptr[i+1] += g->succptr[i];
+	}
+	fill = mark; /* reuse as the next free slot of each block */
+	for(i=0; i<b->nblocks; i++){
+		fill[i] = g->succptr[i];
+	}
+	for(k=0; k<nedge; k++){
+		g->succ[fill[epred[k]]++] = esucc[k];
+	}
+
+	ascfree(colblock);
+	ascfree(mark);
+	ascfree(epred);
+	ascfree(esucc);
+	return g;
+
+fail:
+	if(colblock!=NULL) ascfree(colblock);
+	if(mark!=NULL) ascfree(mark);
+	if(epred!=NULL) ascfree(epred);
+	if(esucc!=NULL) ascfree(esucc);
+	if(g!=NULL) ascfree(g);
+	return NULL;
+}
+
+void slv_block_graph_destroy(slv_block_graph_t *g){
+	if(g==NULL) return;
+	if(g->npred!=NULL) ascfree(g->npred);
+	if(g->succptr!=NULL) ascfree(g->succptr);
+	if(g->succ!=NULL) ascfree(g->succ);
+	ascfree(g);
+}
+
 /*------------------------------------------------------------------------------
   DEBUG OUTPUT for BLOCK STRUCTURE
 
@@ -158,6 +158,33 @@ ASC_DLLSPEC int system_block_debug(slv_system_t sys, FILE *fp);
 	Create debug output detailing the current block structure of the system.
 */
 
+/*------------------------------------------------------------------------------
+  BLOCK DEPENDENCIES
+*/
+
+/**
+	Which blocks must be solved before which. Block j depends on block i
+	if a relation of block j is incident on a variable of block i. Blocks
+	with no path between them in this graph may be solved in either order,
+	or at the same time.
+*/
+typedef struct slv_block_graph_structure{
+	int32 nblocks;
+	int32 *npred;   /**< number of blocks each block depends on */
+	int32 *succptr; /**< blocks depending on block i are... */
+	int32 *succ;    /**< ...succ[succptr[i]] to succ[succptr[i+1]-1] */
+} slv_block_graph_t;
+
+ASC_DLLSPEC slv_block_graph_t *slv_block_graph_create(slv_system_t sys);
+/**<
+	Find the dependencies between the blocks of a system that has been
+	through slv_block_partition. Variables outside all the blocks (fixed,
+	or left over) are taken to be constants and give no dependency.
+	@return the graph, or NULL if there are no blocks or out of memory.
+*/
+
+ASC_DLLSPEC void slv_block_graph_destroy(slv_block_graph_t *g);
+
 /*------------------------------------------------------------------------------
   PARTITIONING FOR DAE SYSTEMS
 */
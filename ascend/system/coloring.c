@@ -0,0 +1,222 @@
+/*	ASCEND modelling environment
+	Copyright (C) 2015 Carnegie Mellon University
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2, or (at your option)
+	any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "coloring.h"
+#include <math.h>
+#include <ascend/general/ascMalloc.h>
+#include <ascend/general/panic.h>
+#include <ascend/general/mathmacros.h>
+#include <ascend/compiler/instance_enum.h>
+#include <ascend/compiler/extfunc.h>
+#include <ascend/compiler/mathinst.h>
+#include <ascend/compiler/relation_util.h>
+
+/* #define COLORING_DEBUG */
+
+#define IPTR(i) ((struct Instance *)(i))
+
+/* same size of perturbation as blackbox_peturbation */
+#define COLORING_STEP 1.0e-05
+
+void system_coloring_destroy(SystemColoring *col){
+	if(col == NULL)return;
+	if(col->color != NULL)ASC_FREE(col->color);
+	if(col->groupptr != NULL)ASC_FREE(col->groupptr);
+	if(col->group != NULL)ASC_FREE(col->group);
+	if(col->colptr != NULL)ASC_FREE(col->colptr);
+	if(col->row != NULL)ASC_FREE(col->row);
+	if(col->slot != NULL)ASC_FREE(col->slot);
+	if(col->dir != NULL)ASC_FREE(col->dir);
+	if(col->jv != NULL)ASC_FREE(col->jv);
+	ASC_FREE(col);
+}
+
+SystemColoring *system_coloring_create(int32 nrows, int32 ncols
+	, CONST int32 *rowptr, CONST int32 *colidx
+){
+	SystemColoring *col;
+	int32 *order, *mark, *next;
+	int32 i, j, k, kk, jj, c, nnz, maxcount;
+
+	asc_assert(nrows >= 0 && ncols >= 0);
+	nnz = rowptr[nrows];
+	col = ASC_NEW_CLEAR(SystemColoring);
+	if(col == NULL)return NULL;
+	col->nrows = nrows;
+	col->ncols = ncols;
+	col->nnz = nnz;
+	col->color = ASC_NEW_ARRAY(int32, ncols + 1);
+	col->groupptr = ASC_NEW_ARRAY_CLEAR(int32, ncols + 2);
+	col->group = ASC_NEW_ARRAY(int32, ncols + 1);
+	col->colptr = ASC_NEW_ARRAY_CLEAR(int32, ncols + 2);
+	col->row = ASC_NEW_ARRAY(int32, nnz + 1);
+	col->slot = ASC_NEW_ARRAY(int32, nnz + 1);
+	col->dir = ASC_NEW_ARRAY_CLEAR(real64, ncols + 1);
+	col->jv = ASC_NEW_ARRAY(real64, nrows + 1);
+	order = ASC_NEW_ARRAY(int32, ncols + 1);
+	mark = ASC_NEW_ARRAY(int32, ncols + 1);
+	next = ASC_NEW_ARRAY_CLEAR(int32, nnz + ncols + 2);
+	if(col->color == NULL || col->groupptr == NULL || col->group == NULL
+		|| col->colptr == NULL || col->row == NULL || col->slot == NULL
+		|| col->dir == NULL || col->jv == NULL
+		|| order == NULL || mark == NULL || next == NULL
+	){
+		if(order != NULL)ASC_FREE(order);
+		if(mark != NULL)ASC_FREE(mark);
+		if(next != NULL)ASC_FREE(next);
+		system_coloring_destroy(col);
+		return NULL;
+	}
+
+	/* the rows of each col, in increasing order */
+	for(k = 0; k < nnz; ++k){
+		asc_assert(colidx[k] >= 0 && colidx[k] < ncols);
+		col->colptr[colidx[k] + 1]++;
+	}
+	maxcount = 0;
+	for(j = 0; j < ncols; ++j){
+		maxcount = MAX(maxcount, col->colptr[j + 1]);
+		col->colptr[j + 1] += col->colptr[j];
+		mark[j] = col->colptr[j];
+	}
+	for(i = 0; i < nrows; ++i){
+		for(k = rowptr[i]; k < rowptr[i + 1]; ++k){
+			kk = mark[colidx[k]]++;
+			col->row[kk] = i;
+			col->slot[kk] = k;
+		}
+	}
+
+	/*
+		largest first: bucket the cols by their number of rows, using next
+		as the bucket heads (nnz+1 of them, offset by ncols) and links.
+	*/
+	for(c = 0; c <= maxcount; ++c){
+		next[ncols + c] = -1;
+	}
+	for(j = 0; j < ncols; ++j){
+		c = col->colptr[j + 1] - col->colptr[j];
+		next[j] = next[ncols + c];
+		next[ncols + c] = j;
+	}
+	k = 0;
+	for(c = maxcount; c >= 0; --c){
+		for(j = next[ncols + c]; j >= 0; j = next[j]){
+			order[k++] = j;
+		}
+	}
+	asc_assert(k == ncols);
+
+	/*
+		greedy: mark[c] == j means color c is taken by some col sharing a
+		row with col j.
+	*/
+	for(j = 0; j < ncols; ++j){
+		col->color[j] = -1;
+		mark[j] = -1;
+	}
+	col->ncolor = 0;
+	for(kk = 0; kk < ncols; ++kk){
+		j = order[kk];
+		if(col->colptr[j] == col->colptr[j + 1])continue;
+		for(k = col->colptr[j]; k < col->colptr[j + 1]; ++k){
+			i = col->row[k];
+			for(jj = rowptr[i]; jj < rowptr[i + 1]; ++jj){
+				c = col->color[colidx[jj]];
+				if(c >= 0)mark[c] = j;
+			}
+		}
+		for(c = 0; mark[c] == j; ++c);
+		col->color[j] = c;
+		if(c >= col->ncolor)col->ncolor = c + 1;
+	}
+
+	/* the cols of each color */
+	for(j = 0; j < ncols; ++j){
+		if(col->color[j] >= 0)col->groupptr[col->color[j] + 1]++;
+	}
+	for(c = 0; c < col->ncolor; ++c){
+		col->groupptr[c + 1] += col->groupptr[c];
+		mark[c] = col->groupptr[c];
+	}
+	for(j = 0; j < ncols; ++j){
+		if(col->color[j] >= 0)col->group[mark[col->color[j]]++] = j;
+	}
+
+#ifdef COLORING_DEBUG
+	CONSOLE_DEBUG("%d cols, %d rows, %d nonzeros: %d colors"
+		, ncols, nrows, nnz, col->ncolor
+	);
+#endif
+	ASC_FREE(order);
+	ASC_FREE(mark);
+	ASC_FREE(next);
+	return col;
+}
+
+SystemColoring *system_coloring_create_csr(mtx_csr_t csr){
+	int32 order;
+	asc_assert(csr != NULL);
+	order = mtx_order(mtx_csr_matrix(csr));
+	return system_coloring_create(order, order
+		, mtx_csr_rowptr(csr), mtx_csr_colidx(csr)
+	);
+}
+
+int system_coloring_eval(SystemColoring *col, CONST real64 *step
+	, SystemColoringSweepFn *fn, void *data, real64 *value
+){
+	int32 c, g, j, k;
+	real64 h;
+	int err;
+
+	asc_assert(col != NULL && fn != NULL && value != NULL);
+	for(c = 0; c < col->ncolor; ++c){
+		for(g = col->groupptr[c]; g < col->groupptr[c + 1]; ++g){
+			j = col->group[g];
+			col->dir[j] = (step == NULL) ? 1.0 : step[j];
+		}
+		err = (*fn)(data, col->dir, col->jv);
+		for(g = col->groupptr[c]; g < col->groupptr[c + 1]; ++g){
+			col->dir[col->group[g]] = 0.0;
+		}
+		if(err){
+			return err;
+		}
+		/* each row has at most one col of this color */
+		for(g = col->groupptr[c]; g < col->groupptr[c + 1]; ++g){
+			j = col->group[g];
+			h = (step == NULL) ? 1.0 : step[j];
+			for(k = col->colptr[j]; k < col->colptr[j + 1]; ++k){
+				value[col->slot[k]] = col->jv[col->row[k]] / h;
+			}
+		}
+	}
+	return 0;
+}
+
+real64 system_coloring_step(real64 x){
+	return COLORING_STEP * MAX(1.0, fabs(x));
+}
+
+int system_coloring_rel_fdiff(struct rel_relation *rel){
+	CONST struct relation *r;
+	if(!rel_blackbox(rel)){
+		return 0;
+	}
+	r = GetInstanceRelationOnly(IPTR(rel_instance(rel)));
+	return (r != NULL && GetDerivFunc(RelationBlackBoxExtFunc(r)) == NULL);
+}
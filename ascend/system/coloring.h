@@ -0,0 +1,140 @@
+/*	ASCEND modelling environment
+	Copyright (C) 2015 Carnegie Mellon University
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2, or (at your option)
+	any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*//** @defgroup system_coloring System Jacobian Coloring
+	Column coloring of a sparse Jacobian, for evaluating it by compressed
+	directional derivatives.
+
+	Two columns that have no row in common may be perturbed together: the
+	change in each row can then only have come from one of them. The
+	columns are given colors so that columns sharing a row always differ
+	(a distance-2 coloring of the bipartite row/column graph), and the
+	whole Jacobian is recovered from one directional derivative per
+	color. For the banded or block-structured systems that come out of
+	most models the number of colors is about the largest number of
+	incidences in a row, however many columns there are.
+
+	The directional derivatives may be exact (forward mode) or finite
+	differences; the caller supplies them through a SystemColoringSweepFn.
+	Finite differences by coloring are used for blackbox relations that
+	have no derivative function of their own, which otherwise perturb
+	each of their inputs in turn.
+
+	A typical use, given the incidence of the rows in compressed row
+	form (for instance from an mtx filled by slv_make_incidence_mtx):
+	<pre>
+	   col = system_coloring_create_csr(csr);
+	   ...
+	   for(j = 0; j < n; ++j)h[j] = system_coloring_step(x[j]);
+	   err = system_coloring_eval(col, h, &my_sweep, &my_data
+	                              , mtx_csr_values(csr));
+	</pre>
+*/
+#ifndef ASC_SYS_COLORING_H
+#define ASC_SYS_COLORING_H
+
+#include "rel.h"
+
+#include <ascend/linear/mtx_csr.h>
+
+/**	@addtogroup system_coloring
+	@{
+*/
+
+/**
+	A coloring of the columns of a sparse pattern, with the column-wise
+	index needed to scatter the result of each sweep.
+*/
+typedef struct SystemColoringStruct{
+	int32 nrows, ncols, nnz;
+	int32 ncolor;
+	int32 *color;    /**< color of each col, or -1 for a col with no rows */
+	int32 *groupptr; /**< cols of color c are group[groupptr[c]..groupptr[c+1]-1] */
+	int32 *group;
+	int32 *colptr;   /**< rows of col j are row[colptr[j]..colptr[j+1]-1]... */
+	int32 *row;
+	int32 *slot;     /**< ...and the slots of the pattern they are in */
+	real64 *dir;     /**< scratch: the direction of a sweep, ncols long */
+	real64 *jv;      /**< scratch: the result of a sweep, nrows long */
+} SystemColoring;
+
+ASC_DLLSPEC SystemColoring *system_coloring_create(int32 nrows, int32 ncols
+	, CONST int32 *rowptr, CONST int32 *colidx
+);
+/**<
+	Color the columns of a pattern in compressed row form: the cols of
+	row i are colidx[rowptr[i]..rowptr[i+1]-1], and the slot of each
+	entry is its position in colidx. If a col appears twice in a row,
+	each of its slots is given the whole derivative.
+
+	The columns are taken greedily, those with the most rows first, and
+	each is given the lowest color not used by any column it shares a
+	row with.
+
+	@return the coloring, or NULL if memory runs out.
+*/
+
+ASC_DLLSPEC SystemColoring *system_coloring_create_csr(mtx_csr_t csr);
+/**<
+	Color the org columns of an mtx snapshot, with its slots. The result
+	of system_coloring_eval may then go straight into mtx_csr_values.
+*/
+
+ASC_DLLSPEC void system_coloring_destroy(SystemColoring *col);
+/**< Free a coloring. NULL is ignored. */
+
+typedef int SystemColoringSweepFn(void *data, CONST real64 *dir, real64 *jv);
+/**<
+	Compute one directional derivative, jv = J dir (or for finite
+	differences, F(x+dir) - F(x), which system_coloring_eval then divides
+	by the steps). dir has one entry for each column, jv one for each row.
+	@return 0 on success; anything else stops system_coloring_eval.
+*/
+
+ASC_DLLSPEC int system_coloring_eval(SystemColoring *col, CONST real64 *step
+	, SystemColoringSweepFn *fn, void *data, real64 *value
+);
+/**<
+	Evaluate the Jacobian of a pattern with one call to fn per color.
+	Entries of value not in any colored column are left untouched; the
+	others are overwritten.
+
+	@param step  perturbation of each column, or NULL for a unit direction
+	             (exact directional derivatives). Entries for columns with
+	             no rows are ignored; the others must be nonzero.
+	@param value output, by slot of the pattern.
+	@return 0 on success, else the value returned by fn.
+
+	The scratch space of col is used, so a coloring may be evaluated by
+	only one thread at a time.
+*/
+
+ASC_DLLSPEC real64 system_coloring_step(real64 x);
+/**<
+	@return the finite-difference step for a variable with value x: 1e-5,
+	as for blackbox gradients, but relative to x where |x| > 1.
+*/
+
+ASC_DLLSPEC int system_coloring_rel_fdiff(struct rel_relation *rel);
+/**<
+	@return 1 if the gradient of rel can only be had by perturbing its
+	variables (a blackbox without a derivative function), else 0.
+	Such relations are better evaluated together by system_coloring_eval
+	than one at a time by relman_diff2.
+*/
+
+/* @} */
+
+#endif
@@ -20,20 +20,253 @@
 #include <ascend/general/ascMalloc.h>
 #include <ascend/general/panic.h>
 #include <ascend/general/mathmacros.h>
+#include <ascend/utilities/ascTask.h>
+#include <ascend/compiler/mathinst.h>
+#include <ascend/compiler/rel_opcode.h>
 
 /* #define JACOBIAN_DEBUG */
 
+#define IPTR(i) ((struct Instance *)(i))
+
+/* fewest rows a task is given; fewer are not worth the scheduling */
+#define JACOBIAN_CHUNK 32
+
+/*------------------------------------------------------------------------------
+  ASSEMBLY ON SEVERAL THREADS
+*/
+
+struct jacobian_work{
+	struct rel_relation **rels;
+	int32 nrels;
+	int32 chunk;
+	const var_filter_t *vfilter;
+	int safe;
+	struct SystemJacobianEntries *ent; /* or... */
+	mtx_csr_t csr;                     /* ...this */
+	int *err;                          /* per worker, for csr */
+};
+
+/** relations we can evaluate off the calling thread */
+#define JACOBIAN_THREADSAFE(rel) ((rel)->type == e_rel_token)
+
+/**
+	Add the gradient of rels[i] to buffer b.
+*/
+static void jacobian_eval_row(struct jacobian_work *w
+	, struct SystemJacobianBuffer *b, int32 i
+){
+	int32 len, n, k;
+	len = rel_n_incidences(w->rels[i]);
+	if(b->n + len > b->cap){
+		b->cap = MAX(2 * b->cap, b->n + len);
+		b->rel = (int32 *)ASC_REALLOC(b->rel, b->cap * sizeof(int32));
+		b->var = (int32 *)ASC_REALLOC(b->var, b->cap * sizeof(int32));
+		b->value = (real64 *)ASC_REALLOC(b->value, b->cap * sizeof(real64));
+	}
+	w->ent->status[i] = relman_diff2(w->rels[i], w->vfilter
+		, b->value + b->n, b->var + b->n, &n, w->safe
+	);
+	for(k = 0; k < n; ++k){
+		b->rel[b->n + k] = i;
+	}
+	b->n += n;
+}
+
+static int jacobian_eval_task(void *data, int worker, int32 task){
+	struct jacobian_work *w = (struct jacobian_work *)data;
+	int32 i, high = MIN(w->nrels, (task + 1) * w->chunk);
+	real64 resid;
+
+	for(i = task * w->chunk; i < high; ++i){
+		if(!JACOBIAN_THREADSAFE(w->rels[i])){
+			continue;
+		}
+		if(w->csr == NULL){
+			jacobian_eval_row(w, &(w->ent->buf[worker]), i);
+			continue;
+		}
+		switch(relman_diffs_csr(w->rels[i], w->vfilter, w->csr, &resid, w->safe)){
+			case 0: break;
+			case 2: return 2;
+			default: w->err[worker] = 1;
+		}
+	}
+	return 0;
+}
+
+static void jacobian_eval_done(void *data, int worker){
+	(void)data;
+	(void)worker;
+	relman_free_reused_mem();
+}
+
+/**
+	Share the rows out among the threads, then do the ones that must be
+	done on this thread.
+	@return as asc_task_graph_run, or 2 from relman_diffs_csr.
+*/
+static int jacobian_eval_run(struct jacobian_work *w, int nthread){
+	int32 ntask, t, *npred, *succptr;
+	int32 i;
+	real64 resid;
+	int err;
+
+	if(nthread < 1){
+		nthread = 1;
+	}
+	w->chunk = MAX(JACOBIAN_CHUNK, (w->nrels + 4*nthread - 1) / (4*nthread));
+	ntask = (w->nrels + w->chunk - 1) / w->chunk;
+
+	npred = ASC_NEW_ARRAY(int32, ntask + 1);
+	succptr = ASC_NEW_ARRAY(int32, ntask + 1);
+	for(t = 0; t <= ntask; ++t){
+		npred[t] = 0;
+		succptr[t] = 0;
+	}
+	err = asc_task_graph_run(ntask, npred, succptr, NULL, nthread
+		, &jacobian_eval_task, &jacobian_eval_done, w
+	);
+	ASC_FREE(npred);
+	ASC_FREE(succptr);
+	if(err){
+		return err;
+	}
+
+	for(i = 0; i < w->nrels; ++i){
+		if(JACOBIAN_THREADSAFE(w->rels[i])){
+			continue;
+		}
+		if(w->csr == NULL){
+			jacobian_eval_row(w, &(w->ent->buf[0]), i);
+			continue;
+		}
+		switch(relman_diffs_csr(w->rels[i], w->vfilter, w->csr, &resid, w->safe)){
+			case 0: break;
+			case 2: return 2;
+			default: w->err[0] = 1;
+		}
+	}
+	return 0;
+}
+
+int system_jacobian_eval(struct rel_relation **rels, int32 nrels
+	, const var_filter_t *vfilter, const int safe, int nthread
+	, struct SystemJacobianEntries *ent
+){
+	struct jacobian_work w;
+	int32 i, nnz = 0;
+	int b;
+
+	if(nthread < 1){
+		nthread = 1;
+	}
+	/*
+		opcodes are compiled the first time a relation is evaluated, which
+		threads sharing the relation could do at once: compile them now.
+	*/
+	for(i = 0; i < nrels; ++i){
+		nnz += rel_n_incidences(rels[i]);
+		if(g_relation_opcodes && JACOBIAN_THREADSAFE(rels[i])){
+			(void)RelationOpCodes(
+				GetInstanceRelationOnly(IPTR(rel_instance(rels[i])))
+			);
+		}
+	}
+
+	ent->nbuf = nthread;
+	ent->buf = ASC_NEW_ARRAY_CLEAR(struct SystemJacobianBuffer, nthread);
+	ent->status = ASC_NEW_ARRAY_CLEAR(int32, nrels + 1);
+	for(b = 0; b < nthread; ++b){
+		/* most threads get about their share; the rest grow as needed */
+		ent->buf[b].cap = nnz / nthread + 1;
+		ent->buf[b].rel = ASC_NEW_ARRAY(int32, ent->buf[b].cap);
+		ent->buf[b].var = ASC_NEW_ARRAY(int32, ent->buf[b].cap);
+		ent->buf[b].value = ASC_NEW_ARRAY(real64, ent->buf[b].cap);
+	}
+
+	w.rels = rels;
+	w.nrels = nrels;
+	w.vfilter = vfilter;
+	w.safe = safe;
+	w.ent = ent;
+	w.csr = NULL;
+	w.err = NULL;
+	if(jacobian_eval_run(&w, nthread)){
+		return 1;
+	}
+	for(i = 0; i < nrels; ++i){
+		if(ent->status[i]){
+			return 1;
+		}
+	}
+	return 0;
+}
+
+void system_jacobian_entries_destroy(struct SystemJacobianEntries *ent){
+	int b;
+	if(ent->buf != NULL){
+		for(b = 0; b < ent->nbuf; ++b){
+			ASC_FREE(ent->buf[b].rel);
+			ASC_FREE(ent->buf[b].var);
+			ASC_FREE(ent->buf[b].value);
+		}
+		ASC_FREE(ent->buf);
+	}
+	if(ent->status != NULL){
+		ASC_FREE(ent->status);
+	}
+	ent->buf = NULL;
+	ent->status = NULL;
+	ent->nbuf = 0;
+}
+
+int system_jacobian_eval_csr(struct rel_relation **rels
+	, int32 nrels, const var_filter_t *vfilter, const int safe, int nthread
+	, mtx_csr_t csr
+){
+	struct jacobian_work w;
+	int b, res;
+
+	if(nthread < 1){
+		nthread = 1;
+	}
+	w.rels = rels;
+	w.nrels = nrels;
+	w.vfilter = vfilter;
+	w.safe = safe;
+	w.ent = NULL;
+	w.csr = csr;
+	w.err = ASC_NEW_ARRAY_CLEAR(int, nthread);
+	res = jacobian_eval_run(&w, nthread);
+	if(res == 0){
+		for(b = 0; b < nthread; ++b){
+			if(w.err[b]){
+				res = 1;
+			}
+		}
+	}else if(res != 2){
+		res = 1;
+	}
+	ASC_FREE(w.err);
+	return res;
+}
+
+/*------------------------------------------------------------------------------
+  SYSTEM JACOBIAN
+*/
+
 int system_jacobian(slv_system_t sys
 	, const rel_filter_t *rfilter, const var_filter_t *vfilter, const int safe
 	, struct SystemJacobianStruct *sysjac
 ){
-	int i,j,n,nsr,nsv,nr,nv;
+	int i,n,nsr,nsv,nr,nv,b;
+	int32 k;
 	struct var_variable **svars;
 	struct rel_relation **srels;
 	int *vartocol;
-	int res, err=0;
-	double *derivvals;
-	int *derivvars;
+	int err=0;
+	struct SystemJacobianEntries ent;
+	struct SystemJacobianBuffer *buf;
 	mtx_coord_t coord;
 	char *relname;
 #ifdef JACOBIAN_DEBUG
@@ -78,43 +311,43 @@ int system_jacobian(slv_system_t sys
 	CONSOLE_DEBUG("nr = %d",nr);
 	CONSOLE_DEBUG("nv = %d",nv);
 
-	derivvals = ASC_NEW_ARRAY(double,nv);
-	derivvars = ASC_NEW_ARRAY(int,nv);
+	/* calculate all the gradients... */
+	(void)system_jacobian_eval(sysjac->rels, nr, vfilter, safe
+		, asc_task_num_cpus(), &ent
+	);
 
-	/* now create a matrix */
+	/* ...then put them into a new matrix; each (row,col) comes only once */
 	sysjac->M = mtx_create();
 	mtx_set_order(sysjac->M, MAX(nv,nr));
 
-	for(i=0;i<nr;++i){
-#ifdef JACOBIAN_DEBUG
-		relname = rel_make_name(sys,sysjac->rels[i]);
-		CONSOLE_DEBUG("rel '%s'",relname);
-		ASC_FREE(relname);
-#endif
-
-		res = relman_diff2(sysjac->rels[i], vfilter, derivvals, derivvars, &n, safe);
-		for(j=0;j<n;++j){
+	for(b=0;b<ent.nbuf;++b){
+		buf = &(ent.buf[b]);
+		for(k=0;k<buf->n;++k){
 #ifdef JACOBIAN_DEBUG
-			asc_assert(var_apply_filter(svars[derivvars[j]],vfilter));
-			varname = var_make_name(sys,svars[derivvars[j]]);
-			CONSOLE_DEBUG("var '%s' (var_deriv = %d)",varname,var_deriv(svars[derivvars[j]]));
+			asc_assert(var_apply_filter(svars[buf->var[k]],vfilter));
+			varname = var_make_name(sys,svars[buf->var[k]]);
+			CONSOLE_DEBUG("var '%s' (var_deriv = %d)",varname,var_deriv(svars[buf->var[k]]));
 			ASC_FREE(varname);
 #endif
-			mtx_set_value(sysjac->M,mtx_coord(&coord,i,vartocol[derivvars[j]]),derivvals[j]);
+			mtx_fill_value(sysjac->M
+				,mtx_coord(&coord,buf->rel[k],vartocol[buf->var[k]]),buf->value[k]
+			);
 		}
-		if(res){
+	}
+
+	for(i=0;i<nr;++i){
+		if(ent.status[i]){
 			relname = rel_make_name(sys,sysjac->rels[i]);
 			ERROR_REPORTER_HERE(ASC_PROG_ERR,"Error calculating derivatives for relation '%s'",relname);
 			ASC_FREE(relname);
 			err = 1;
 		}
 	}
+	system_jacobian_entries_destroy(&ent);
 
 	sysjac->n_rels = nr;
 	sysjac->n_vars = nv;
 
-	ASC_FREE(derivvals);
-	ASC_FREE(derivvars);
 	ASC_FREE(vartocol);
 
 	return err;
@@ -24,6 +24,7 @@
 #include "rel.h"
 
 #include <ascend/linear/mtx.h>
+#include <ascend/linear/mtx_csr.h>
 
 /**	@addtogroup system_jacobian
 	@{
@@ -62,11 +63,72 @@ struct SystemJacobianStruct{
 	This routine uses relman_diff2 to calculate derivatives and
 	mtx_set_value to insert them into the matrix.
 
-	It's not in any way optimised for fast evaluation / mtx updates etc.
+	The gradients are evaluated by system_jacobian_eval on as many threads
+	as there are processors; they are then put into the new matrix with
+	mtx_fill_value, one thread after another.
 */
 ASC_DLLSPEC int system_jacobian(slv_system_t sys
 	, const rel_filter_t *rfilter, const var_filter_t *vfilter, const int safe
 	, struct SystemJacobianStruct *sysjac
 );
 
+/*------------------------------------------------------------------------------
+  ASSEMBLY ON SEVERAL THREADS
+*/
+
+/**
+	Gradient entries of one thread: entry k is d(rels[rel[k]])/d(var) for
+	the var with var_sindex var[k].
+*/
+struct SystemJacobianBuffer{
+	int32 n, cap;
+	int32 *rel;
+	int32 *var;
+	real64 *value;
+};
+
+/**
+	The output of system_jacobian_eval. There is a buffer for each thread,
+	so that the threads never write to the same memory; the caller then
+	scatters the entries into whatever matrix it likes.
+*/
+struct SystemJacobianEntries{
+	int nbuf;
+	struct SystemJacobianBuffer *buf;
+	int32 *status; /**< for each rel, the value returned by relman_diff2 */
+};
+
+ASC_DLLSPEC int system_jacobian_eval(struct rel_relation **rels, int32 nrels
+	, const var_filter_t *vfilter, const int safe, int nthread
+	, struct SystemJacobianEntries *ent
+);
+/**<
+	Evaluate the gradients of rels[0..nrels-1] with relman_diff2, the rows
+	being shared out among up to nthread threads. Blackbox and glassbox
+	relations, whose evaluation is not thread-safe, are done afterwards on
+	the calling thread.
+
+	Clean up with system_jacobian_entries_destroy, whatever the result.
+
+	@return 0 if all the gradients were calculated, else 1 (see status).
+*/
+
+ASC_DLLSPEC void system_jacobian_entries_destroy(struct SystemJacobianEntries *ent);
+
+ASC_DLLSPEC int system_jacobian_eval_csr(struct rel_relation **rels
+	, int32 nrels, const var_filter_t *vfilter, const int safe, int nthread
+	, mtx_csr_t csr
+);
+/**<
+	As system_jacobian_eval, but for a matrix whose sparsity pattern is
+	already known: each thread writes its rows with relman_diffs_csr
+	straight into the value array of csr. Rows are never shared, so there
+	is no need for buffers nor for a scatter afterwards, and nothing is
+	allocated. Call mtx_csr_put once this returns 0 or 1.
+
+	@return 0 on success, 1 if some gradient could not be calculated, 2 if
+	some incidence has no slot in csr (it must then be rebuilt, and the
+	values left in it are incomplete).
+*/
+
 #endif
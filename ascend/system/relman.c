@@ -26,6 +26,7 @@
 #include "relman.h"
 
 #include <math.h>
+#include <errno.h>
 #include <ascend/general/platform.h>
 #include <ascend/general/ascMalloc.h>
 #include <ascend/general/panic.h>
@@ -45,6 +46,8 @@
 #include <ascend/compiler/vlist.h>
 #include <ascend/compiler/relation.h>
 #include <ascend/compiler/relation_util.h>
+#include <ascend/compiler/rel_opcode.h>
+#include <ascend/compiler/bintoken.h>
 #include <ascend/compiler/relation_io.h>
 #include <ascend/compiler/exprsym.h>
 
@@ -62,40 +65,6 @@
 #define REIMPLEMENT 0 /* code that needs to be reimplemented */
 
 
-/**
-	Temporarily allocates a given number of bytes.  The memory need
-	not be freed, but the next call to this function will reuse the
-	previous allocation. Memory returned will NOT be zeroed.
-	Calling with nbytes==0 will free any memory allocated.
-*/
-static
-void *rel_tmpalloc(int nbytes){
-	static char *ptr = NULL;
-	static int cap = 0;
-
-	if(nbytes){
-		if(nbytes > cap){
-			if(ptr != NULL){
-				ASC_FREE(ptr);
-			}
-			ptr = ASC_NEW_ARRAY(char,nbytes);
-			cap = nbytes;
-		}
-	}else{
-		if(ptr){
-			ASC_FREE(ptr);
-		}
-		ptr=NULL;
-		cap=0;
-	}
-	if(cap > 0){
-		return(ptr);
-	} else  {
-		return NULL;
-	}
-}
-
-
 #define rel_tmpalloc_array(nelts,type)  \
    ((nelts) > 0 ? (type *)tmpalloc((nelts)*sizeof(type)) : NULL)
 /**<
@@ -103,9 +72,22 @@ void *rel_tmpalloc(int nbytes){
 */
 
 
+/*
+	Scratch memory (the gradient buffers below, and everything the compiler's
+	evaluation routines need) lives in the calling thread's RelEvalContext,
+	so these functions may be used from several threads at once.
+*/
 void relman_free_reused_mem(void){
-  rel_tmpalloc(0); /* restoring this call, to avoid minor memory leaks; not sure why it was commented out ages ago -- JP*/
-  RelationFindRoots(NULL,0,0,0,0,NULL,NULL,NULL);
+  RelEvalContextThreadDestroy();
+}
+
+int relman_thread_safe(struct rel_relation *rel){
+  if(rel->type != e_rel_token)return 0;
+  if(g_relation_opcodes){
+    /* compile now rather than from several threads at once */
+    (void)RelationOpCodes(GetInstanceRelationOnly(IPTR(rel->instance)));
+  }
+  return 1;
 }
 
 
@@ -381,20 +363,28 @@ real64 relman_eval(struct rel_relation *rel, int32 *calc_ok, int safe){
 		//CONSOLE_DEBUG("token relation");
 		if(!RelationCalcResidualBinary(
 			GetInstanceRelationOnly(IPTR(rel->instance)
-		),&res)){
+		),&res,NULL)){
 			/* yes, it actually worked ok */
 			*calc_ok = 1;
 			rel_set_residual(rel,res);
 			return res;
+		}
+		if(g_relation_opcodes && !RelationCalcResidualOpCode(
+			GetInstanceRelationOnly(IPTR(rel->instance)
+		),&res,NULL)){
+			*calc_ok = 1;
+			rel_set_residual(rel,res);
+			return res;
 		}/* else {
 			we don't care -- go on to the old handling which
-			is reasonably correct, if slow.
+			is reasonably correct, if slow, and which reports
+			the floating point errors properly.
 		} */
 	}
 
 	if(safe){
 		//CONSOLE_DEBUG("safe relation");
-		*calc_ok = RelationCalcResidualSafe(rel_instance(rel),&res); /* returns zero on success */
+		*calc_ok = RelationCalcResidualSafe(rel_instance(rel),&res,NULL); /* returns zero on success */
 		if(*calc_ok){
 			/* ie *NOT* OK, there was an error */
 #ifdef EVAL_DEBUG
@@ -411,7 +401,7 @@ real64 relman_eval(struct rel_relation *rel, int32 *calc_ok, int safe){
 	}
 
 	//CONSOLE_DEBUG("regular relation");
-	*calc_ok = RelationCalcResidual(rel_instance(rel),&res);
+	*calc_ok = RelationCalcResidual(rel_instance(rel),&res,NULL);
 	if(*calc_ok){
 		/* an error occured */
 		res = 1.0e8;
@@ -424,6 +414,364 @@ real64 relman_eval(struct rel_relation *rel, int32 *calc_ok, int safe){
 	return res;
 }
 
+/*------------------------------------------------------------------------------
+  BATCHED RESIDUAL EVALUATION
+*/
+
+/** A run of relations in a batch having the same share (NULL for relations
+	that are not token relations). */
+struct relman_batch_group {
+	union RelationUnion *share;
+	int32 first;
+	int32 n;
+};
+
+struct relman_batch {
+	int32 nrels;
+	struct rel_relation **rels;       /**< relations, sorted by share */
+	int32 ngroups;
+	struct relman_batch_group *groups;
+	double *scratch;                  /**< variable values and registers */
+	unsigned long scratchsize;
+};
+
+struct relman_batch_sort {
+	union RelationUnion *share;
+	struct rel_relation *rel;
+};
+
+static union RelationUnion *relman_batch_share(struct rel_relation *rel){
+	CONST struct relation *r;
+	if(rel->type != e_rel_token)return NULL;
+	r = GetInstanceRelationOnly(IPTR(rel->instance));
+	return (r == NULL) ? NULL : r->share;
+}
+
+static int relman_batch_cmp(CONST void *a, CONST void *b){
+	CONST struct relman_batch_sort *sa = (CONST struct relman_batch_sort *)a;
+	CONST struct relman_batch_sort *sb = (CONST struct relman_batch_sort *)b;
+	/* NULL shares last, then by share, then in sindex order */
+	if(sa->share != sb->share){
+		if(sa->share == NULL)return 1;
+		if(sb->share == NULL)return -1;
+		return ((char *)sa->share < (char *)sb->share) ? -1 : 1;
+	}
+	return rel_sindex(sa->rel) - rel_sindex(sb->rel);
+}
+
+struct relman_batch *relman_batch_create(struct rel_relation **rlist
+		, int32 nrels
+){
+	struct relman_batch *b;
+	struct relman_batch_sort *s;
+	int32 c, g;
+
+	b = ASC_NEW_CLEAR(struct relman_batch);
+	if(b == NULL)return NULL;
+	if(nrels <= 0)return b;
+
+	s = ASC_NEW_ARRAY(struct relman_batch_sort,nrels);
+	b->rels = ASC_NEW_ARRAY(struct rel_relation *,nrels);
+	b->groups = ASC_NEW_ARRAY(struct relman_batch_group,nrels);
+	if(s == NULL || b->rels == NULL || b->groups == NULL){
+		if(s != NULL)ASC_FREE(s);
+		relman_batch_destroy(b);
+		return NULL;
+	}
+	for(c = 0; c < nrels; c++){
+		s[c].rel = rlist[c];
+		s[c].share = relman_batch_share(rlist[c]);
+	}
+	qsort(s,(size_t)nrels,sizeof(struct relman_batch_sort),relman_batch_cmp);
+
+	g = -1;
+	for(c = 0; c < nrels; c++){
+		b->rels[c] = s[c].rel;
+		if(g < 0 || s[c].share == NULL || s[c].share != b->groups[g].share){
+			g++;
+			b->groups[g].share = s[c].share;
+			b->groups[g].first = c;
+			b->groups[g].n = 0;
+		}
+		b->groups[g].n++;
+	}
+	b->ngroups = g + 1;
+	b->nrels = nrels;
+	ASC_FREE(s);
+	return b;
+}
+
+void relman_batch_destroy(struct relman_batch *b){
+	if(b == NULL)return;
+	if(b->rels != NULL)ASC_FREE(b->rels);
+	if(b->groups != NULL)ASC_FREE(b->groups);
+	if(b->scratch != NULL)ASC_FREE(b->scratch);
+	ASC_FREE(b);
+}
+
+/* make sure the batch has at least n doubles of scratch space */
+static double *relman_batch_scratch(struct relman_batch *b, unsigned long n){
+	if(n > b->scratchsize){
+		if(b->scratch != NULL)ASC_FREE(b->scratch);
+		b->scratch = ASC_NEW_ARRAY(double,n);
+		b->scratchsize = (b->scratch == NULL) ? 0 : n;
+	}
+	return b->scratch;
+}
+
+#define BATCH_VALUE(V,X) \
+	(((X) != NULL && var_flagbit((V),VAR_SVAR)) ? (X)[var_sindex(V)] : var_value(V))
+
+/* evaluate one relation of a batch the old way, which reports errors properly */
+static real64 relman_batch_fallback(struct rel_relation *rel, CONST real64 *x
+		, int safe, int32 *nfail
+){
+	struct var_variable **vlist = rel->incidence;
+	int32 j, calc_ok;
+	real64 res;
+	if(x != NULL){
+		for(j = 0; j < rel_n_incidences(rel); j++){
+			if(var_flagbit(vlist[j],VAR_SVAR)){
+				var_set_value(vlist[j],x[var_sindex(vlist[j])]);
+			}
+		}
+	}
+	res = relman_eval(rel,&calc_ok,safe);
+	if(!calc_ok)(*nfail)++;
+	return res;
+}
+
+/*
+	evaluate the relations of a group RELOP_LANES at a time: the values of
+	the variables of each relation are gathered into lane-packed arrays.
+*/
+static void relman_batch_eval_lanes(struct relman_batch *b
+		, struct relman_batch_group *grp, CONST struct RelOpCodes *p
+		, CONST real64 *x, real64 *resid, CONST rel_filter_t *rfilter
+		, int safe, int32 *nfail
+){
+	struct rel_relation *lanerel[RELOP_LANES];
+	struct rel_relation *rel;
+	double *vals, *regs, *lres, res;
+	int32 c, end, j, nv;
+	int l, m, bad;
+
+	nv = rel_n_incidences(b->rels[grp->first]);
+	vals = relman_batch_scratch(b,(unsigned long)(nv + 1)*RELOP_LANES
+		+ RelOpCodesScratchN(p,0)
+	);
+	if(vals == NULL){
+		for(c = grp->first; c < grp->first + grp->n; c++){
+			rel = b->rels[c];
+			if(rfilter != NULL && !rel_apply_filter(rel,rfilter))continue;
+			resid[rel_sindex(rel)] = relman_batch_fallback(rel,x,safe,nfail);
+		}
+		return;
+	}
+	lres = vals + nv*RELOP_LANES;
+	regs = lres + RELOP_LANES;
+
+	c = grp->first;
+	end = grp->first + grp->n;
+	while(c < end){
+		for(m = 0; c < end && m < RELOP_LANES; c++){
+			rel = b->rels[c];
+			if(rfilter != NULL && !rel_apply_filter(rel,rfilter))continue;
+			lanerel[m++] = rel;
+		}
+		if(m == 0)break;
+		for(l = m; l < RELOP_LANES; l++){
+			lanerel[l] = lanerel[0]; /* padding */
+		}
+		for(j = 0; j < nv; j++){
+			for(l = 0; l < RELOP_LANES; l++){
+				vals[j*RELOP_LANES + l] = BATCH_VALUE(lanerel[l]->incidence[j],x);
+			}
+		}
+		bad = RelOpCodesResidualN(p,vals,regs,lres);
+		for(l = 0; l < m; l++){
+			rel = lanerel[l];
+			if(bad & (1 << l)){
+				res = relman_batch_fallback(rel,x,safe,nfail);
+			}else{
+				res = lres[l];
+				rel_set_residual(rel,res);
+			}
+			resid[rel_sindex(rel)] = res;
+		}
+	}
+}
+
+int32 relman_batch_eval(struct relman_batch *b, CONST real64 *x
+		, real64 *resid, CONST rel_filter_t *rfilter, int safe
+){
+	struct relman_batch_group *grp;
+	struct rel_relation *rel;
+	CONST struct relation *r;
+	CONST struct RelOpCodes *p;
+	double *vals, res;
+	int32 g, c, j, nv, nfail = 0;
+	int btable, bindex, old_errno, ok;
+
+	asc_assert(b!=NULL);
+	asc_assert(resid!=NULL);
+	old_errno = errno; /* push C global errno */
+
+	for(g = 0; g < b->ngroups; g++){
+		grp = &(b->groups[g]);
+		p = NULL;
+		btable = bindex = 0;
+		nv = rel_n_incidences(b->rels[grp->first]);
+		vals = NULL;
+		if(grp->share != NULL){
+			r = GetInstanceRelationOnly(IPTR(rel_instance(b->rels[grp->first])));
+			btable = RTOKEN(r).btable;
+			bindex = RTOKEN(r).bindex;
+			if(g_relation_opcodes){
+				p = RelationOpCodes(r);
+			}
+			if(p != NULL && btable <= 0 && grp->n > 1){
+				relman_batch_eval_lanes(b,grp,p,x,resid,rfilter,safe,&nfail);
+				continue;
+			}
+			vals = relman_batch_scratch(b,(unsigned long)nv
+				+ (p != NULL ? RelOpCodesScratch(p,0) : 0));
+		}
+
+		for(c = grp->first; c < grp->first + grp->n; c++){
+			rel = b->rels[c];
+			if(rfilter != NULL && !rel_apply_filter(rel,rfilter))continue;
+			ok = 0;
+			if(vals != NULL && (btable > 0 || p != NULL)){
+				for(j = 0; j < nv; j++){
+					vals[j] = BATCH_VALUE(rel->incidence[j],x);
+				}
+				if(btable > 0 && !BinTokenCalcResidual(btable,bindex,vals,&res)
+					&& asc_finite(res)
+				){
+					ok = 1;
+				}else if(p != NULL && !RelOpCodesResidual(p,vals,vals+nv,&res)){
+					ok = 1;
+				}
+			}
+			if(!ok){
+				res = relman_batch_fallback(rel,x,safe,&nfail);
+			}else{
+				rel_set_residual(rel,res);
+			}
+			resid[rel_sindex(rel)] = res;
+		}
+	}
+	errno = old_errno;
+	return nfail;
+}
+
+/*
+	differentiate the relations of a group RELOP_LANES at a time into the
+	value array of csr, gathering their variables as relman_batch_eval_lanes
+	does. Lanes whose gradient is not finite are redone by relman_diffs_csr.
+*/
+static int relman_batch_diffs_lanes(struct relman_batch *b
+		, struct relman_batch_group *grp, CONST struct RelOpCodes *p
+		, CONST var_filter_t *filter, mtx_csr_t csr, int safe
+){
+	struct rel_relation *lanerel[RELOP_LANES];
+	struct rel_relation *rel;
+	struct var_variable *v;
+	double *vals, *grad, *lres, *regs, *value;
+	real64 resid;
+	int32 c, end, j, nv, row, slot;
+	int l, m, bad, err, status = 0;
+
+	nv = rel_n_incidences(b->rels[grp->first]);
+	vals = relman_batch_scratch(b,(unsigned long)(2*nv + 1)*RELOP_LANES
+		+ RelOpCodesScratchN(p,1)
+	);
+	if(vals == NULL){
+		for(c = grp->first; c < grp->first + grp->n; c++){
+			err = relman_diffs_csr(b->rels[c],filter,csr,&resid,safe);
+			if(err == 2)return 2;
+			if(err)status = 1;
+		}
+		return status;
+	}
+	grad = vals + nv*RELOP_LANES;
+	lres = grad + nv*RELOP_LANES;
+	regs = lres + RELOP_LANES;
+	value = mtx_csr_values(csr);
+
+	c = grp->first;
+	end = grp->first + grp->n;
+	while(c < end){
+		for(m = 0; c < end && m < RELOP_LANES; c++){
+			lanerel[m++] = b->rels[c];
+		}
+		for(l = m; l < RELOP_LANES; l++){
+			lanerel[l] = lanerel[0]; /* padding */
+		}
+		for(j = 0; j < nv; j++){
+			for(l = 0; l < RELOP_LANES; l++){
+				vals[j*RELOP_LANES + l] = var_value(lanerel[l]->incidence[j]);
+			}
+		}
+		bad = RelOpCodesResidGradN(p,vals,regs,lres,grad,(unsigned long)nv);
+		for(l = 0; l < m; l++){
+			rel = lanerel[l];
+			if(bad & (1 << l)){
+				err = relman_diffs_csr(rel,filter,csr,&resid,safe);
+				if(err == 2)return 2;
+				if(err)status = 1;
+				continue;
+			}
+			row = rel_sindex(rel);
+			for(j = 0; j < nv; j++){
+				v = rel->incidence[j];
+				if(!var_apply_filter(v,filter))continue;
+				slot = mtx_csr_find(csr,row,var_sindex(v));
+				if(slot < 0)return 2;
+				value[slot] = grad[j*RELOP_LANES + l];
+			}
+		}
+	}
+	return status;
+}
+
+int relman_batch_diffs_csr(struct relman_batch *b
+		, CONST var_filter_t *filter, mtx_csr_t csr, int safe
+){
+	struct relman_batch_group *grp;
+	CONST struct relation *r;
+	CONST struct RelOpCodes *p;
+	real64 resid;
+	int32 g, c;
+	int old_errno, err, status = 0;
+
+	asc_assert(b!=NULL && filter!=NULL && csr!=NULL);
+	old_errno = errno; /* push C global errno */
+
+	for(g = 0; g < b->ngroups; g++){
+		grp = &(b->groups[g]);
+		p = NULL;
+		if(grp->share != NULL && grp->n > 1 && g_relation_opcodes){
+			r = GetInstanceRelationOnly(IPTR(rel_instance(b->rels[grp->first])));
+			if(RTOKEN(r).btable <= 0){
+				p = RelationOpCodes(r);
+			}
+		}
+		if(p != NULL){
+			err = relman_batch_diffs_lanes(b,grp,p,filter,csr,safe);
+			if(err > status)status = err;
+		}else{
+			for(c = grp->first; c < grp->first + grp->n && status != 2; c++){
+				err = relman_diffs_csr(b->rels[c],filter,csr,&resid,safe);
+				if(err > status)status = err;
+			}
+		}
+		if(status == 2)break; /* the snapshot must be rebuilt */
+	}
+	errno = old_errno;
+	return status;
+}
 
 int32 relman_obj_direction(struct rel_relation *rel){
   assert(rel!=NULL);
@@ -470,6 +818,35 @@ real64 relman_diff(struct rel_relation *rel, struct var_variable *var,
 #endif
 
 
+/**
+	Try the compiled evaluators (binary tokens, then opcodes) for the
+	gradient (and residual, if resid is not NULL) of a token relation.
+	Returns 0 if one worked, in which case there were no floating point
+	problems for the slower evaluators to report; otherwise the caller
+	should go on with those.
+*/
+static int relman_compiled_diff(struct rel_relation *rel
+		,real64 *resid, real64 *gradient, struct RelEvalContext *ctx
+){
+  CONST struct relation *r;
+  real64 res;
+  if(rel->type != e_rel_token){
+    return 1;
+  }
+  r = GetInstanceRelationOnly(IPTR(rel->instance));
+  if(resid == NULL){
+    resid = &res;
+  }
+  if(!RelationCalcResidGradBinary(r,resid,gradient,ctx)){
+    return 0;
+  }
+  if(!g_relation_opcodes){
+    return 1;
+  }
+  return RelationCalcResidGradOpCode(r,resid,gradient,ctx);
+}
+
+
 /* return 0 on success (derivatives, variables and count are output vars too) */
 int relman_diff2(struct rel_relation *rel, const var_filter_t *filter
 		,real64 *derivatives, int32 *variables
@@ -477,19 +854,22 @@ int relman_diff2(struct rel_relation *rel, const var_filter_t *filter
 ){
   const struct var_variable **vlist=NULL;
   real64 *gradient;
+  struct RelEvalContext *ctx = RelEvalContextThread();
   int32 len,c;
   int status;
   //CONSOLE_DEBUG("In Function: relman_diff2");
   assert(rel!=NULL && filter!=NULL);
   len = rel_n_incidences(rel);
   vlist = rel_incidence_list(rel);
-  gradient = (real64 *)rel_tmpalloc(len*sizeof(real64));
+  gradient = RelEvalContextWork(ctx,len);
   assert(gradient !=NULL);
   *count = 0;
   if(safe){
     //CONSOLE_DEBUG("Derivative Type: Safe");
-    status =(int32)RelationCalcGradientSafe(rel_instance(rel),gradient);
-    safe_error_to_stderr( (enum safe_err *)&status );
+    if((status = relman_compiled_diff(rel,NULL,gradient,ctx)) != 0){
+      status =(int32)RelationCalcGradientSafe(rel_instance(rel),gradient,ctx);
+      safe_error_to_stderr( (enum safe_err *)&status );
+    }
     /* always map when using safe functions */
     for (c=0; c < len; c++) {
       if (var_apply_filter(vlist[c],filter)) {
@@ -505,7 +885,9 @@ int relman_diff2(struct rel_relation *rel, const var_filter_t *filter
 	return status;
   }else{
     //CONSOLE_DEBUG("Derivative Type: Not SAFE");
-    if((status=RelationCalcGradient(rel_instance(rel),gradient)) == 0) {
+    if((status = relman_compiled_diff(rel,NULL,gradient,ctx)) == 0
+      || (status=RelationCalcGradient(rel_instance(rel),gradient,ctx)) == 0
+    ){
       /* successful */
       for (c=0; c < len; c++) {
         if (var_apply_filter(vlist[c],filter)) {
@@ -528,6 +910,7 @@ int relman_diff2_rev(struct rel_relation *rel, const var_filter_t *filter
 {
 	const struct var_variable **vlist=NULL;
 	real64 *gradient;
+	struct RelEvalContext *ctx = RelEvalContextThread();
 	int32 len,c;
 	int status;
 	assert(rel!=NULL && filter!=NULL);
@@ -535,13 +918,13 @@ int relman_diff2_rev(struct rel_relation *rel, const var_filter_t *filter
 //	CONSOLE_DEBUG("In Function relman_diff2_rev");
 	vlist = rel_incidence_list(rel);
 
-	gradient = (real64 *)rel_tmpalloc(len*sizeof(real64));
+	gradient = RelEvalContextWork(ctx,len);
 	assert(gradient !=NULL);
 	*count = 0;
 	if(safe){
 		//CONSOLE_DEBUG("Derivative Type: Safe");
 		//PrintGradients(rel_instance(rel));
-		status =(int32)RelationCalcGradientRevSafe(rel_instance(rel),gradient);
+		status =(int32)RelationCalcGradientRevSafe(rel_instance(rel),gradient,ctx);
 		safe_error_to_stderr( (enum safe_err *)&status );
 		/* always map when using safe functions */
 		for (c=0; c < len; c++) {
@@ -558,7 +941,7 @@ int relman_diff2_rev(struct rel_relation *rel, const var_filter_t *filter
 	}else{
 		//CONSOLE_DEBUG("Derivative Type: Not SAFE");
 		if(
-			(status = (int32)RelationCalcGradientRev(rel_instance(rel),gradient))
+			(status = (int32)RelationCalcGradientRev(rel_instance(rel),gradient,ctx))
 			== 0
 		){
 			/* successful */
@@ -608,7 +991,7 @@ int relman_hess(struct rel_relation *rel, const var_filter_t *filter
 
 
 	if(safe){
-		status =(int32)RelationCalcHessianMtxSafe(rel_instance(rel),matrix,len);
+		status =(int32)RelationCalcHessianMtxSafe(rel_instance(rel),matrix,len,NULL);
 		safe_error_to_stderr( (enum safe_err *)&status );
 		/* always map when using safe functions */
 		for(i=0;i<len;i++){
@@ -623,7 +1006,7 @@ int relman_hess(struct rel_relation *rel, const var_filter_t *filter
 		}
 //		CONSOLE_DEBUG("RETURNING (SAFE) calc_ok=%d",status);
 	}else{
-		if((status =(int32)RelationCalcHessianMtx(rel_instance(rel),matrix,len)) == 0) {
+		if((status =(int32)RelationCalcHessianMtx(rel_instance(rel),matrix,len,NULL)) == 0) {
 
 			/* successful */
 			for(i=0;i<len;i++){
@@ -652,6 +1035,7 @@ int relman_diff3(struct rel_relation *rel
 ){
   struct var_variable **vlist=NULL;
   real64 *gradient;
+  struct RelEvalContext *ctx = RelEvalContextThread();
   int32 len,c;
   int status;
 
@@ -659,15 +1043,17 @@ int relman_diff3(struct rel_relation *rel
   len = rel_n_incidences(rel);
   vlist = (struct var_variable**)rel_incidence_list(rel);
 
-  gradient = (real64 *)rel_tmpalloc(len*sizeof(real64));
+  gradient = RelEvalContextWork(ctx,len);
   assert(gradient !=NULL);
   *count = 0;
   if(safe){
 #ifdef DIFF_DEBUG
 	CONSOLE_DEBUG("SAFE EVALUATION");
 #endif
-    status =(int32)RelationCalcGradientSafe(rel_instance(rel),gradient);
-    safe_error_to_stderr( (enum safe_err *)&status );
+    if((status = relman_compiled_diff(rel,NULL,gradient,ctx)) != 0){
+      status =(int32)RelationCalcGradientSafe(rel_instance(rel),gradient,ctx);
+      safe_error_to_stderr( (enum safe_err *)&status );
+    }
     /* always map when using safe functions */
     for (c=0; c < len; c++) {
       if (var_apply_filter(vlist[c],filter)) {
@@ -683,7 +1069,9 @@ int relman_diff3(struct rel_relation *rel
 #ifdef DIFF_DEBUG
 	CONSOLE_DEBUG("UNSAFE EVALUATION");
 #endif
-    if((status=RelationCalcGradient(rel_instance(rel),gradient)) == 0) {
+    if((status = relman_compiled_diff(rel,NULL,gradient,ctx)) == 0
+      || (status=RelationCalcGradient(rel_instance(rel),gradient,ctx)) == 0
+    ){
       /* successful */
       for (c=0; c < len; c++) {
         if (var_apply_filter(vlist[c],filter)) {
@@ -707,6 +1095,7 @@ int relman_diff_grad(struct rel_relation *rel
 ){
   const struct var_variable **vlist=NULL;
   real64 *gradient;
+  struct RelEvalContext *ctx = RelEvalContextThread();
   int32 len,c;
   int status;
 
@@ -714,14 +1103,16 @@ int relman_diff_grad(struct rel_relation *rel
   len = rel_n_incidences(rel);
   vlist = rel_incidence_list(rel);
 
-  gradient = (real64 *)rel_tmpalloc(len*sizeof(real64));
+  gradient = RelEvalContextWork(ctx,len);
   assert(gradient !=NULL);
   *count = 0;
   if( safe ) {
 	/* CONSOLE_DEBUG("..."); */
-    status =(int32)RelationCalcResidGradSafe(rel_instance(rel),
-					     resid,gradient);
-    safe_error_to_stderr( (enum safe_err *)&status );
+    if((status = relman_compiled_diff(rel,resid,gradient,ctx)) != 0){
+      status =(int32)RelationCalcResidGradSafe(rel_instance(rel),
+					       resid,gradient,ctx);
+      safe_error_to_stderr( (enum safe_err *)&status );
+    }
     /* always map when using safe functions */
     for (c=0; c < len; c++) {
       if (var_apply_filter(vlist[c],filter)) {
@@ -733,7 +1124,9 @@ int relman_diff_grad(struct rel_relation *rel
     }
   }
   else {
-    if((status=RelationCalcResidGrad(rel_instance(rel),resid,gradient))== 0) {
+    if((status = relman_compiled_diff(rel,resid,gradient,ctx)) == 0
+      || (status=RelationCalcResidGrad(rel_instance(rel),resid,gradient,ctx))== 0
+    ){
       /* successful */
       for (c=0; c < len; c++) {
         if (var_apply_filter(vlist[c],filter)) {
@@ -759,6 +1152,7 @@ int32 relman_diff_harwell(struct rel_relation **rlist
   struct rel_relation *rel;
   real64 residual, *resid;
   real64 *gradient;
+  struct RelEvalContext *ctx = RelEvalContextThread();
   mtx_coord_t coord;
   int32 len,c,r,k;
   int32 errcnt;
@@ -778,12 +1172,12 @@ int32 relman_diff_harwell(struct rel_relation **rlist
       rel = rlist[r];
       len = rel_n_incidences(rel);
       vlist = rel_incidence_list(rel);
-      gradient = (real64 *)rel_tmpalloc(len*sizeof(real64));
+      gradient = RelEvalContextWork(ctx,len);
       if (gradient == NULL) {
         return 1;
       }
 	  /* CONSOLE_DEBUG("..."); */
-      status = RelationCalcResidGradSafe(rel_instance(rel),resid,gradient);
+      status = RelationCalcResidGradSafe(rel_instance(rel),resid,gradient,ctx);
       safe_error_to_stderr(&status);
       if (status) {
         errcnt--;
@@ -800,12 +1194,12 @@ int32 relman_diff_harwell(struct rel_relation **rlist
       rel = rlist[r];
       len = rel_n_incidences(rel);
       vlist = rel_incidence_list(rel);
-      gradient = (real64 *)rel_tmpalloc(len*sizeof(real64));
+      gradient = RelEvalContextWork(ctx,len);
       if (gradient == NULL) {
         return 1;
       }
 	  /* CONSOLE_DEBUG("..."); */
-      status = RelationCalcResidGradSafe(rel_instance(rel),resid,gradient);
+      status = RelationCalcResidGradSafe(rel_instance(rel),resid,gradient,ctx);
       safe_error_to_stderr(&status);
       if (status) {
         errcnt--;
@@ -890,6 +1284,7 @@ int relman_diffs(struct rel_relation *rel
 ){
   const struct var_variable **vlist=NULL;
   real64 *gradient;
+  struct RelEvalContext *ctx = RelEvalContextThread();
   int32 len,c;
   mtx_coord_t coord;
   int status;
@@ -900,10 +1295,10 @@ int relman_diffs(struct rel_relation *rel
   coord.row = rel_sindex(rel);
   assert(coord.row>=0 && coord.row < mtx_order(mtx));
 
-  gradient = (real64 *)rel_tmpalloc(len*sizeof(real64));
+  gradient = RelEvalContextWork(ctx,len);
   assert(gradient !=NULL);
   if( safe ) {
-    status =(int32)RelationCalcResidGradSafe(rel_instance(rel),resid,gradient);
+    status =(int32)RelationCalcResidGradSafe(rel_instance(rel),resid,gradient,ctx);
     safe_error_to_stderr( (enum safe_err *)&status );
     /* always map when using safe functions */
     for (c=0; c < len; c++) {
@@ -915,7 +1310,7 @@ int relman_diffs(struct rel_relation *rel
     }
   }
   else {
-    if((status=RelationCalcResidGrad(rel_instance(rel),resid,gradient)) == 0) {
+    if((status=RelationCalcResidGrad(rel_instance(rel),resid,gradient,ctx)) == 0) {
       /* successful */
       for (c=0; c < len; c++) {
         if (var_apply_filter(vlist[c],filter)) {
@@ -931,6 +1326,43 @@ int relman_diffs(struct rel_relation *rel
 }
 
 
+int relman_diffs_csr(struct rel_relation *rel
+		, const var_filter_t *filter
+		, mtx_csr_t csr, real64 *resid, int safe
+){
+  const struct var_variable **vlist=NULL;
+  real64 *gradient, *value;
+  struct RelEvalContext *ctx = RelEvalContextThread();
+  int32 len,c,row,slot;
+  int status;
+
+  assert(rel!=NULL && filter!=NULL && csr != NULL);
+  len = rel_n_incidences(rel);
+  vlist = rel_incidence_list(rel);
+  row = rel_sindex(rel);
+  value = mtx_csr_values(csr);
+
+  gradient = RelEvalContextWork(ctx,len);
+  assert(gradient !=NULL);
+  if( safe ) {
+    status =(int32)RelationCalcResidGradSafe(rel_instance(rel),resid,gradient,ctx);
+    safe_error_to_stderr( (enum safe_err *)&status );
+  }else{
+    status = RelationCalcResidGrad(rel_instance(rel),resid,gradient,ctx);
+    if(status)return 1;
+  }
+  /* always map when using safe functions */
+  for (c=0; c < len; c++) {
+    if (var_apply_filter(vlist[c],filter)) {
+      slot = mtx_csr_find(csr,row,var_sindex(vlist[c]));
+      if(slot < 0)return 2;
+      value[slot] = gradient[c];
+    }
+  }
+  return status ? 1 : 0;
+}
+
+
 #if REIMPLEMENT /* this needs to be reimplemented in the compiler */
 real64 relman_diffs_orig( struct rel_relation *rel, var_filter_t *filter
 		,mtx_matrix_t mtx
@@ -1047,7 +1479,7 @@ real64 *relman_directly_solve_new( struct rel_relation *rel,
 							, var_lower_bound(solvefor)
 							, var_upper_bound(solvefor)
 							, var_nominal(solvefor)
-							, tolerance, &(vindex), able, nsolns
+							, tolerance, &(vindex), able, nsolns, NULL
 					);
 					return value;
 				}
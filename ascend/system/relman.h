@@ -35,6 +35,7 @@
 #include <ascend/general/platform.h>
 
 #include <ascend/linear/mtx.h>
+#include <ascend/linear/mtx_csr.h>
 #include <ascend/general/ltmatrix.h>
 
 #include "var.h"
@@ -119,6 +120,67 @@ ASC_DLLSPEC real64 relman_eval(struct rel_relation *rel, int32 *calc_okp, int sa
 	the push/pop should be _outside_ the loop.
 */
 
+struct relman_batch;
+/**<
+	A set of relations prepared for repeated residual evaluation as a
+	group. Token relations are grouped by relation share, so that all the
+	relations using the same compiled program (or binary token function)
+	are evaluated one after the other; other relations are evaluated with
+	relman_eval.
+*/
+
+ASC_DLLSPEC struct relman_batch *relman_batch_create(
+		struct rel_relation **rlist, int32 nrels);
+/**<
+	Prepare the nrels relations in rlist for batched evaluation. The
+	list itself is not kept and may be freed or reordered afterwards, but
+	the relations must outlive the batch.
+
+	@return the new batch, or NULL on allocation failure.
+*/
+
+ASC_DLLSPEC void relman_batch_destroy(struct relman_batch *b);
+/**<
+	Free a batch created by relman_batch_create. NULL is ignored.
+*/
+
+ASC_DLLSPEC int32 relman_batch_eval(struct relman_batch *b
+		, CONST real64 *x, real64 *resid
+		, CONST rel_filter_t *rfilter, int safe);
+/**<
+	Evaluate the residuals of the relations of a batch, equivalent to
+	calling relman_eval on each of them, and update their residual fields.
+
+	@param x      values of the solver variables (those with VAR_SVAR set)
+		indexed by var_sindex, or NULL to use the values currently stored in
+		the instance tree. Other incident reals (parameters) are always
+		read from the instance tree. Where a relation has to be evaluated by
+		relman_eval, its incident solver variables are first set from x.
+	@param resid  output, residual of each relation stored at rel_sindex(rel)
+	@param rfilter if not NULL, relations not passing the filter are skipped
+		and their resid entries left untouched
+	@param safe   as for relman_eval
+	@return number of relations for which the calculation failed.
+
+	The same SIGFPE handling as for relman_eval applies.
+*/
+
+ASC_DLLSPEC int relman_batch_diffs_csr(struct relman_batch *b
+		, CONST var_filter_t *filter, mtx_csr_t csr, int safe);
+/**<
+	Refill the rows of all the relations of a batch in a compressed
+	snapshot of the matrix, equivalent to calling relman_diffs_csr on each
+	of them. Relations sharing a compiled program are differentiated
+	RELOP_LANES at a time with RelOpCodesResidGradN, reading their
+	variables from the instance tree.
+
+	NB as for relman_diffs_csr, and unlike relman_diffs, 0 means success.
+
+	@return as for relman_diffs_csr, taken over all the relations: 2 if a
+	slot was missing (the other rows may then be only partly refilled), else
+	1 if any calculation failed, else 0.
+*/
+
 ASC_DLLSPEC int32 relman_obj_direction(struct rel_relation *rel);
 /**<
  *  Returns:
@@ -249,8 +311,8 @@ ASC_DLLSPEC int relman_diffs(struct rel_relation *rel,
 	rel.  The filter determines which variables actually contribute to the
 	jacobian.  The residual of the relation is also computed and returned.
 	If an error is encountered in the calculation, the status returned is
-	1 and the residual is set to some number we managed to calculate,
-	while the gradient is discarded. status = 0 is OK.
+	0 and the residual is set to some number we managed to calculate,
+	while the gradient is discarded. status = 1 is OK.
 
 	@param rel  relation for which jacobian entries are required
 	@param filter  filter for which variables should actually contribute to the jacobian
@@ -262,7 +324,9 @@ ASC_DLLSPEC int relman_diffs(struct rel_relation *rel,
 	fill the org row determined by rel_sindex and the org cols
 	determined by var_sindex.
 
-	@return 0 on success, 1 on calculation error (residual will be returned, grad discarded)
+	@return 1 on success, 0 on calculation error (residual will be returned,
+	grad discarded). NB this is the reverse of relman_diffs_csr and
+	relman_batch_diffs_csr, which return 0 on success.
 
 	@NOTE The row of the mtx corresponding to rel should be cleared
 	before calling this function, since this FILLS with the gradient.<br><br>
@@ -274,6 +338,23 @@ ASC_DLLSPEC int relman_diffs(struct rel_relation *rel,
 	harwellian matrices, glassbox rels and blackbox.
 */
 
+ASC_DLLSPEC int relman_diffs_csr(struct rel_relation *rel,
+		const var_filter_t *filter, mtx_csr_t csr,
+		real64 *resid, int safe);
+/**<
+	As relman_diffs, but the gradient is written into the value array of a
+	compressed snapshot of the matrix (see mtx_csr.h) whose pattern already
+	holds the row of rel. Nothing is allocated in the matrix: call
+	mtx_csr_put once all the rows have been refilled.
+
+	NB the return value is NOT that of relman_diffs, which is 1 on success:
+	test it against 0, not as a boolean.
+
+	@return 0 on success, 1 on calculation error (the row is left as it
+	was in the snapshot), 2 if an incidence of rel passing the filter has no
+	slot in the snapshot (the snapshot must then be rebuilt).
+*/
+
 extern int32 relman_diff_harwell(struct rel_relation **rlist,
 		var_filter_t *vfilter, rel_filter_t *rfilter,
 		int32 rlen, int32 bias, int32 mors,
@@ -435,8 +516,21 @@ extern char *dummyrelstring(slv_system_t sys,
                             int style);
 /**<  Temporary no-op function to placehold unimplemented io functions. */
 
+ASC_DLLSPEC int relman_thread_safe(struct rel_relation *rel);
+/**<
+	@return nonzero if rel may be evaluated and differentiated on another
+	thread while other relations are, ie if it is a token relation. Its
+	compiled program, if any, is made now, since compiling it on first use
+	from two threads would race; so call this from one thread at a time,
+	before handing rel to the others.
+*/
+
 extern void relman_free_reused_mem(void);
-/**< Call when desired to free memory cached internally. */
+/**<
+	Call when desired to free memory cached internally. The cache is per
+	thread, so threads that evaluate relations should call this before
+	they exit.
+*/
 
 /* @} */
 
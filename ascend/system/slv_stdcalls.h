@@ -39,7 +39,7 @@
   MATRIX GENERATION AND REORDERING
 */
 
-extern int slv_make_incidence_mtx(slv_system_t sys,
+ASC_DLLSPEC int slv_make_incidence_mtx(slv_system_t sys,
 		mtx_matrix_t mtx, var_filter_t *vf, rel_filter_t *rf);
 /**<
 	Populates a matrix according to the sys solvers_vars, solvers_rels
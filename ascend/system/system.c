@@ -30,10 +30,12 @@
 
 #include <ascend/compiler/instance_enum.h>
 #include <ascend/compiler/check.h>
+#include <ascend/compiler/instantiate.h>
 
 #include <ascend/linear/mtx.h>
 
 #include "slv_client.h"
+#include "system_impl.h"
 #include "diffvars.h"
 
 #include "relman.h"
@@ -85,6 +87,7 @@ slv_system_t system_build(SlvBackendToken inst){
   }
 
   slv_set_instance(sys,inst);
+  sys->compiler_counter = g_compiler_counter;
 
 #if DOTIME
   comptime = tm_cpu_time() - comptime;
@@ -97,6 +100,25 @@ slv_system_t system_build(SlvBackendToken inst){
   return(sys);
 }
 
+slv_system_t system_rebuild(slv_system_t sys){
+  SlvBackendToken inst;
+  int solver;
+  asc_assert(sys!=NULL);
+  if(sys->compiler_counter == g_compiler_counter){
+    analyze_update_problem(sys);
+    return sys;
+  }
+  /* the tree may have changed under us: start again */
+  inst = slv_instance(sys);
+  solver = slv_get_selected_solver(sys);
+  system_destroy(sys);
+  sys = system_build(inst);
+  if(sys != NULL && solver >= 0){
+    slv_select_solver(sys,solver);
+  }
+  return sys;
+}
+
 void system_destroy(slv_system_t sys){
 	struct gl_list_t *symbollist;
 	void *l;
@@ -116,6 +138,9 @@ void system_destroy(slv_system_t sys){
 
 	system_diffvars_destroy(sys);
 
+	relman_batch_destroy(sys->residbatch);
+	sys->residbatch = NULL;
+
 	symbollist=slv_get_symbol_list(sys);
 	if(symbollist != NULL)DestroySymbolValuesList(symbollist);
 
@@ -124,6 +149,31 @@ void system_destroy(slv_system_t sys){
 	slv_destroy(sys); /* frees buf data */
 }
 
+int32 system_eval_residuals(slv_system_t sys, const double *x, double *r
+		, int flags
+){
+	rel_filter_t rfilter;
+
+	asc_assert(sys!=NULL);
+	if(sys->residbatch == NULL){
+		/* the master list doesn't change, unlike the solver list whose
+		order and length may be changed by sorting and by WHENs. */
+		sys->residbatch = relman_batch_create(sys->rels.master,sys->rels.mnum);
+		if(sys->residbatch == NULL){
+			ERROR_REPORTER_HERE(ASC_PROG_ERR,"Unable to create residual evaluator");
+			return -1;
+		}
+	}
+	rfilter.matchbits = REL_INCLUDED | REL_ACTIVE;
+	if(flags & SYS_EVAL_EQUALITY){
+		rfilter.matchbits |= REL_EQUALITY;
+	}
+	rfilter.matchvalue = rfilter.matchbits;
+	return relman_batch_eval(sys->residbatch, x, r, &rfilter
+		, (flags & SYS_EVAL_SAFE) != 0
+	);
+}
+
 void system_free_reused_mem(){
   mtx_free_reused_mem();
   linsolqr_free_reused_mem();
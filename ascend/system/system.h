@@ -63,6 +63,25 @@ ASC_DLLSPEC void system_destroy(slv_system_t sys);
 	Destroys the latest model formulation.
 */
 
+ASC_DLLSPEC slv_system_t system_rebuild(slv_system_t sys);
+/**<
+	Bring a system up to date with its instance tree after METHODs have
+	been run on it, more cheaply than destroying it and building it again.
+
+	If the compiler hasn't changed any instance tree since sys was built
+	(g_compiler_counter is unchanged), only the flags that METHODs can
+	change are refreshed: fixed and basis of variables, included of
+	relations and logical relations, the objective, and the ACTIVE flags
+	set by WHENs. Otherwise sys is destroyed and a new system built from
+	the same instance, with the same solver selected.
+
+	Either way the solver must be presolved again before it is used, which
+	redoes the block structure from the new flags.
+
+	@return sys, or the system that replaces it (NULL if that couldn't be
+		built).
+*/
+
 ASC_DLLSPEC void system_free_reused_mem(void);
 /**<
 	Deallocates any memory that solvers may be squirrelling away for
@@ -70,6 +89,30 @@ ASC_DLLSPEC void system_free_reused_mem(void);
 	is likely to be fatal: handle with care.
 */
 
+ASC_DLLSPEC int32 system_eval_residuals(slv_system_t sys
+		, const double *x, double *r, int flags);
+/**<
+	Evaluate the residuals of all the included, active relations of the
+	system in one pass. Relations are grouped by relation share so that
+	each compiled relation is evaluated for all of its instances together;
+	see relman_batch_eval. This replaces a loop calling relman_eval on each
+	relation in the solver's list.
+
+	@param x     values of the solver variables indexed by var_sindex, or
+		NULL to use the values stored in the instance tree.
+	@param r     output, residuals indexed by rel_sindex (length at least
+		slv_get_num_solvers_rels). Entries for relations not evaluated are
+		left untouched.
+	@param flags bitwise-or of SYS_EVAL_* values
+	@return number of relations that could not be calculated, or -1 if
+		the evaluator could not be set up.
+
+	The same SIGFPE handling as for relman_eval applies.
+*/
+
+#define SYS_EVAL_SAFE     0x1 /**< use 'safe' arithmetic, see relman_eval */
+#define SYS_EVAL_EQUALITY 0x2 /**< only evaluate equality relations */
+
 /* @} */
 
 #endif  /* ASC_SYSTEM_H */
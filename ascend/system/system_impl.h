@@ -222,8 +222,11 @@ struct system_structure {
 #endif
 	} data;
 
+	struct relman_batch *residbatch; /**< used by system_eval_residuals, built on first use */
+
 	int32 nmodels;
 	int32 need_consistency; /**< consistency analysis required for conditional model ? */
+	long compiler_counter; /**< g_compiler_counter when built, see system_rebuild */
 	real64 objvargrad; /**< maximize -1 minimize 1 noobjvar 0 */
 };
 
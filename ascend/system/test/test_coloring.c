@@ -0,0 +1,187 @@
+/*	ASCEND modelling environment
+	Copyright (C) 2015 John Pye
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2, or (at your option)
+	any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*//**
+	@file
+	Column coloring of sparse patterns (system_coloring_create), and
+	Jacobians recovered from it by exact directional derivatives and by
+	finite differences.
+*/
+#include <math.h>
+#include <stdlib.h>
+
+#include <ascend/general/platform.h>
+#include <ascend/general/ascMalloc.h>
+
+#include <ascend/system/coloring.h>
+
+#include <test/common.h>
+
+#define N 40
+
+/* pattern and values of a test matrix in compressed row form */
+struct coloring_test{
+	int32 rowptr[N + 1];
+	int32 colidx[N * N];
+	real64 a[N * N];
+	real64 x[N];
+};
+
+/* tridiagonal, plus a full last row and a full first col (an arrow) */
+static void coloring_test_fill(struct coloring_test *t, int arrow){
+	int32 i, j, k = 0;
+	for(i = 0; i < N; ++i){
+		t->rowptr[i] = k;
+		for(j = 0; j < N; ++j){
+			if(abs(i - j) <= 1 || (arrow && (i == N - 1 || j == 0))){
+				t->colidx[k] = j;
+				t->a[k] = 1.0 + 0.1 * i - 0.03 * j;
+				k++;
+			}
+		}
+		t->x[i] = 0.5 + 0.01 * i;
+	}
+	t->rowptr[N] = k;
+}
+
+/* no two cols of the same color have a row in common */
+static int coloring_test_valid(SystemColoring *col, struct coloring_test *t){
+	int32 i, k, kk;
+	for(i = 0; i < N; ++i){
+		for(k = t->rowptr[i]; k < t->rowptr[i + 1]; ++k){
+			if(col->color[t->colidx[k]] < 0)return 0;
+			for(kk = k + 1; kk < t->rowptr[i + 1]; ++kk){
+				if(col->color[t->colidx[k]] == col->color[t->colidx[kk]]){
+					return 0;
+				}
+			}
+		}
+	}
+	return 1;
+}
+
+/* jv = A dir */
+static int coloring_test_linear(void *data, CONST real64 *dir, real64 *jv){
+	struct coloring_test *t = (struct coloring_test *)data;
+	int32 i, k;
+	for(i = 0; i < N; ++i){
+		jv[i] = 0;
+		for(k = t->rowptr[i]; k < t->rowptr[i + 1]; ++k){
+			jv[i] += t->a[k] * dir[t->colidx[k]];
+		}
+	}
+	return 0;
+}
+
+/* F_i(x) = sum_k a_ik exp(x_k), differenced: jv = F(x + dir) - F(x) */
+static int coloring_test_exp(void *data, CONST real64 *dir, real64 *jv){
+	struct coloring_test *t = (struct coloring_test *)data;
+	int32 i, k, j;
+	for(i = 0; i < N; ++i){
+		jv[i] = 0;
+		for(k = t->rowptr[i]; k < t->rowptr[i + 1]; ++k){
+			j = t->colidx[k];
+			jv[i] += t->a[k] * (exp(t->x[j] + dir[j]) - exp(t->x[j]));
+		}
+	}
+	return 0;
+}
+
+static int coloring_test_fail(void *data, CONST real64 *dir, real64 *jv){
+	(void)data;
+	(void)dir;
+	(void)jv;
+	return 3;
+}
+
+static void test_tridiagonal(void){
+	struct coloring_test t;
+	SystemColoring *col;
+	real64 value[N * N];
+	int32 k, nerr;
+	unsigned long prior_meminuse = ascmeminuse();
+
+	coloring_test_fill(&t, 0);
+	col = system_coloring_create(N, N, t.rowptr, t.colidx);
+	CU_ASSERT_FATAL(col != NULL);
+	CU_TEST(col->ncolor == 3);
+	CU_TEST(coloring_test_valid(col, &t));
+	CU_TEST(col->groupptr[col->ncolor] == N);
+
+	/* exact: three sweeps give the matrix back */
+	nerr = 0;
+	CU_TEST(0 == system_coloring_eval(col, NULL, &coloring_test_linear, &t, value));
+	for(k = 0; k < t.rowptr[N]; ++k){
+		if(fabs(value[k] - t.a[k]) > 1e-14)nerr++;
+	}
+	CU_TEST(nerr == 0);
+
+	/* the error of the sweep function is passed back */
+	CU_TEST(3 == system_coloring_eval(col, NULL, &coloring_test_fail, &t, value));
+
+	system_coloring_destroy(col);
+	CU_TEST(prior_meminuse == ascmeminuse());
+}
+
+static void test_arrow(void){
+	struct coloring_test t;
+	SystemColoring *col;
+	real64 value[N * N], step[N];
+	int32 j, k, nerr;
+	unsigned long prior_meminuse = ascmeminuse();
+
+	/* the full last row forces every col to its own color */
+	coloring_test_fill(&t, 1);
+	col = system_coloring_create(N, N, t.rowptr, t.colidx);
+	CU_ASSERT_FATAL(col != NULL);
+	CU_TEST(coloring_test_valid(col, &t));
+	CU_TEST(col->ncolor == N);
+	system_coloring_destroy(col);
+
+	/* without it, the full first col only needs one more color */
+	t.rowptr[N] = t.rowptr[N - 1] + 2;
+	t.colidx[t.rowptr[N - 1]] = N - 2;
+	t.colidx[t.rowptr[N - 1] + 1] = N - 1;
+	col = system_coloring_create(N, N, t.rowptr, t.colidx);
+	CU_ASSERT_FATAL(col != NULL);
+	CU_TEST(coloring_test_valid(col, &t));
+	CU_TEST(col->ncolor <= 4);
+
+	/* finite differences of exp(x), against the exact derivative */
+	for(j = 0; j < N; ++j){
+		step[j] = system_coloring_step(t.x[j]);
+	}
+	CU_TEST(0 == system_coloring_eval(col, step, &coloring_test_exp, &t, value));
+	nerr = 0;
+	for(k = 0; k < t.rowptr[N]; ++k){
+		j = t.colidx[k];
+		if(fabs(value[k] - t.a[k] * exp(t.x[j])) > 1e-4 * fabs(t.a[k] * exp(t.x[j]))){
+			nerr++;
+		}
+	}
+	CU_TEST(nerr == 0);
+
+	system_coloring_destroy(col);
+	CU_TEST(prior_meminuse == ascmeminuse());
+}
+
+/*===========================================================================*/
+/* Registration information */
+
+#define TESTS(T) \
+	T(tridiagonal) \
+	T(arrow)
+
+REGISTER_TESTS_SIMPLE(system_coloring, TESTS)
@@ -0,0 +1,129 @@
+/*	ASCEND modelling environment
+	Copyright (C) 2015 John Pye
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2, or (at your option)
+	any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*//**
+	@file
+	Compare batched residual evaluation (system_eval_residuals) with
+	relation-by-relation evaluation using relman_eval.
+*/
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <ascend/general/platform.h>
+#include <ascend/general/ascMalloc.h>
+#include <ascend/utilities/ascEnvVar.h>
+#include <ascend/utilities/error.h>
+
+#include <ascend/compiler/ascCompiler.h>
+#include <ascend/compiler/module.h>
+#include <ascend/compiler/parser.h>
+#include <ascend/compiler/library.h>
+#include <ascend/compiler/symtab.h>
+#include <ascend/compiler/simlist.h>
+#include <ascend/compiler/instquery.h>
+#include <ascend/compiler/initialize.h>
+#include <ascend/compiler/name.h>
+
+#include <ascend/system/system.h>
+#include <ascend/system/slv_client.h>
+#include <ascend/system/relman.h>
+
+#include <test/common.h>
+
+#define EVAL_TOL 1e-12
+
+static int eval_differ(double a, double b){
+	return fabs(a - b) > EVAL_TOL * (1.0 + fabs(a) + fabs(b));
+}
+
+static void test_allmodels(void){
+	int status, i, nvars, nrels, calc_ok, nerr;
+	struct Instance *sim;
+	slv_system_t sys;
+	struct var_variable **vlist;
+	struct rel_relation **rlist;
+	double *x, *r, *rx, res;
+
+	Asc_CompilerInit(1);
+	Asc_PutEnv(ASC_ENV_LIBRARY "=models");
+
+	Asc_OpenModule("test/reverse_ad/allmodels.a4c", &status);
+	CU_ASSERT(status == 0);
+	CU_ASSERT(0 == zz_parse());
+
+	sim = SimsCreateInstance(AddSymbol("allmodels"), AddSymbol("sim1"), e_normal, NULL);
+	CU_ASSERT_FATAL(sim != NULL);
+	Initialize(GetSimulationRoot(sim), CreateIdName(AddSymbol("on_load")), "sim1", ASCERR, 0, NULL, NULL);
+
+	sys = system_build(GetSimulationRoot(sim));
+	CU_ASSERT_FATAL(sys != NULL);
+
+	nvars = slv_get_num_solvers_vars(sys);
+	nrels = slv_get_num_solvers_rels(sys);
+	vlist = slv_get_solvers_var_list(sys);
+	rlist = slv_get_solvers_rel_list(sys);
+	CU_ASSERT(nrels > 0);
+
+	x = ASC_NEW_ARRAY(double, nvars);
+	r = ASC_NEW_ARRAY_CLEAR(double, nrels);
+	rx = ASC_NEW_ARRAY_CLEAR(double, nrels);
+
+	/* values from the instance tree */
+	CU_ASSERT(0 == system_eval_residuals(sys, NULL, r, 0));
+
+	/* values from a perturbed flat vector; must match the instance tree
+	once the same values have been stored there */
+	for(i = 0; i < nvars; i++){
+		x[i] = 1.01 * var_value(vlist[i]) + 0.001;
+	}
+	CU_ASSERT(0 == system_eval_residuals(sys, x, rx, SYS_EVAL_SAFE));
+	for(i = 0; i < nvars; i++){
+		var_set_value(vlist[i], x[i]);
+	}
+
+	nerr = 0;
+	for(i = 0; i < nrels; i++){
+		res = relman_eval(rlist[i], &calc_ok, 1);
+		CU_ASSERT(calc_ok);
+		if(eval_differ(res, rx[rel_sindex(rlist[i])]))nerr++;
+	}
+	CU_ASSERT(nerr == 0);
+
+	/* and the evaluator is reused on a second call */
+	CU_ASSERT(0 == system_eval_residuals(sys, NULL, r, 0));
+	nerr = 0;
+	for(i = 0; i < nrels; i++){
+		if(eval_differ(r[i], rx[i]))nerr++;
+	}
+	CU_ASSERT(nerr == 0);
+
+	ASC_FREE(x);
+	ASC_FREE(r);
+	ASC_FREE(rx);
+	system_destroy(sys);
+	system_free_reused_mem();
+	sim_destroy(sim);
+	Asc_CompilerDestroy();
+}
+
+/*===========================================================================*/
+/* Registration information */
+
+#define TESTS(T) \
+	T(allmodels)
+
+REGISTER_TESTS_SIMPLE(system_eval, TESTS)
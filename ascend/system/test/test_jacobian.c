@@ -0,0 +1,267 @@
+/*	ASCEND modelling environment
+	Copyright (C) 2015 John Pye
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2, or (at your option)
+	any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*//**
+	@file
+	Compare gradients assembled on several threads (system_jacobian_eval,
+	system_jacobian_eval_csr) or for a batch of relations
+	(relman_batch_diffs_csr) with those got one relation at a time.
+*/
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <ascend/general/platform.h>
+#include <ascend/general/ascMalloc.h>
+#include <ascend/utilities/ascEnvVar.h>
+#include <ascend/utilities/error.h>
+
+#include <ascend/compiler/ascCompiler.h>
+#include <ascend/compiler/module.h>
+#include <ascend/compiler/parser.h>
+#include <ascend/compiler/library.h>
+#include <ascend/compiler/symtab.h>
+#include <ascend/compiler/simlist.h>
+#include <ascend/compiler/instquery.h>
+#include <ascend/compiler/initialize.h>
+#include <ascend/compiler/name.h>
+
+#include <ascend/system/system.h>
+#include <ascend/system/slv_client.h>
+#include <ascend/system/relman.h>
+#include <ascend/system/jacobian.h>
+
+#include <test/common.h>
+
+#define JAC_TOL 1e-12
+#define JAC_THREADS 4
+
+static const var_filter_t jac_vfilter = {VAR_SVAR, VAR_SVAR};
+
+static int jac_differ(double a, double b){
+	if(a != a || b != b)return (a == a) != (b == b);
+	return fabs(a - b) > JAC_TOL * (1.0 + fabs(a) + fabs(b));
+}
+
+/*
+	refill the pattern of the relations by relman_batch_diffs_csr and
+	count the values that differ from refilling one row at a time.
+*/
+static int batch_errors(struct rel_relation **rlist, int nrels, int nvars){
+	struct relman_batch *batch;
+	mtx_matrix_t M;
+	mtx_region_t reg;
+	mtx_csr_t csr, csr1;
+	double res;
+	int i, order, nerr = 0;
+
+	order = MAX(nrels, nvars);
+	M = mtx_create();
+	mtx_set_order(M, order);
+	for(i = 0; i < nrels; i++){
+		CU_ASSERT(relman_diffs(rlist[i], &jac_vfilter, M, &res, 0));
+	}
+	mtx_region(&reg, 0, order - 1, 0, order - 1);
+	csr = mtx_csr_create(M, &reg);
+	csr1 = mtx_csr_create(M, &reg);
+	CU_ASSERT_FATAL(csr != NULL && csr1 != NULL);
+	mtx_csr_zero(csr1);
+	for(i = 0; i < nrels; i++){
+		CU_ASSERT(0 == relman_diffs_csr(rlist[i], &jac_vfilter, csr1, &res, 0));
+	}
+	batch = relman_batch_create(rlist, nrels);
+	CU_ASSERT_FATAL(batch != NULL);
+	mtx_csr_zero(csr);
+	CU_ASSERT(0 == relman_batch_diffs_csr(batch, &jac_vfilter, csr, 0));
+	for(i = 0; i < mtx_csr_nonzeros(csr); i++){
+		if(jac_differ(mtx_csr_values(csr)[i], mtx_csr_values(csr1)[i]))nerr++;
+	}
+	relman_batch_destroy(batch);
+	mtx_csr_destroy(csr);
+	mtx_csr_destroy(csr1);
+	mtx_destroy(M);
+	return nerr;
+}
+
+static void test_allmodels(void){
+	int status, i, j, b, n, nvars, nrels, order, nerr, count;
+	struct Instance *sim;
+	slv_system_t sys;
+	struct rel_relation **rlist;
+	struct SystemJacobianEntries ent;
+	struct SystemJacobianBuffer *buf;
+	double *ref, *got, *vals, res;
+	int *vars;
+	mtx_matrix_t M;
+	mtx_region_t reg;
+	mtx_csr_t csr, csr1;
+	unsigned long prior_meminuse;
+
+	Asc_CompilerInit(1);
+	Asc_PutEnv(ASC_ENV_LIBRARY "=models");
+
+	Asc_OpenModule("test/reverse_ad/allmodels.a4c", &status);
+	CU_ASSERT(status == 0);
+	CU_ASSERT(0 == zz_parse());
+
+	sim = SimsCreateInstance(AddSymbol("allmodels"), AddSymbol("sim1"), e_normal, NULL);
+	CU_ASSERT_FATAL(sim != NULL);
+	Initialize(GetSimulationRoot(sim), CreateIdName(AddSymbol("on_load")), "sim1", ASCERR, 0, NULL, NULL);
+
+	sys = system_build(GetSimulationRoot(sim));
+	CU_ASSERT_FATAL(sys != NULL);
+
+	nvars = slv_get_num_solvers_vars(sys);
+	nrels = slv_get_num_solvers_rels(sys);
+	rlist = slv_get_solvers_rel_list(sys);
+	CU_ASSERT(nrels > 0);
+
+	/* dense references, one relation at a time */
+	ref = ASC_NEW_ARRAY_CLEAR(double, nrels * nvars);
+	got = ASC_NEW_ARRAY_CLEAR(double, nrels * nvars);
+	vals = ASC_NEW_ARRAY(double, nvars);
+	vars = ASC_NEW_ARRAY(int, nvars);
+	count = 0;
+	for(i = 0; i < nrels; i++){
+		CU_ASSERT(0 == relman_diff2(rlist[i], &jac_vfilter, vals, vars, &n, 0));
+		for(j = 0; j < n; j++){
+			ref[i * nvars + vars[j]] = vals[j];
+		}
+		count += n;
+	}
+	CU_ASSERT(count > 0);
+	relman_free_reused_mem();
+
+	prior_meminuse = ascmeminuse();
+	CU_ASSERT(0 == system_jacobian_eval(rlist, nrels, &jac_vfilter, 0
+		, JAC_THREADS, &ent
+	));
+	CU_ASSERT(ent.nbuf == JAC_THREADS);
+	n = 0;
+	for(b = 0; b < ent.nbuf; b++){
+		buf = &(ent.buf[b]);
+		for(j = 0; j < buf->n; j++){
+			got[buf->rel[j] * nvars + buf->var[j]] = buf->value[j];
+		}
+		n += buf->n;
+	}
+	CU_ASSERT(n == count);
+	nerr = 0;
+	for(i = 0; i < nrels * nvars; i++){
+		if(jac_differ(ref[i], got[i]))nerr++;
+	}
+	CU_ASSERT(nerr == 0);
+	system_jacobian_entries_destroy(&ent);
+	CU_ASSERT(prior_meminuse == ascmeminuse());
+
+	/* the pattern refilled in place must match refilling one row at a time */
+	order = MAX(nrels, nvars);
+	M = mtx_create();
+	mtx_set_order(M, order);
+	for(i = 0; i < nrels; i++){
+		CU_ASSERT(relman_diffs(rlist[i], &jac_vfilter, M, &res, 0));
+	}
+	mtx_region(&reg, 0, order - 1, 0, order - 1);
+	csr = mtx_csr_create(M, &reg);
+	csr1 = mtx_csr_create(M, &reg);
+	CU_ASSERT_FATAL(csr != NULL && csr1 != NULL);
+	mtx_csr_zero(csr1);
+	for(i = 0; i < nrels; i++){
+		CU_ASSERT(0 == relman_diffs_csr(rlist[i], &jac_vfilter, csr1, &res, 0));
+	}
+	mtx_csr_zero(csr);
+	CU_ASSERT(0 == system_jacobian_eval_csr(rlist, nrels, &jac_vfilter, 0
+		, JAC_THREADS, csr
+	));
+	nerr = 0;
+	for(i = 0; i < count; i++){
+		if(jac_differ(mtx_csr_values(csr)[i], mtx_csr_values(csr1)[i]))nerr++;
+	}
+	CU_ASSERT(nerr == 0);
+	mtx_csr_destroy(csr);
+	mtx_csr_destroy(csr1);
+	mtx_destroy(M);
+	CU_ASSERT(0 == batch_errors(rlist, nrels, nvars));
+
+	ASC_FREE(ref);
+	ASC_FREE(got);
+	ASC_FREE(vals);
+	ASC_FREE(vars);
+	system_destroy(sys);
+	relman_free_reused_mem();
+	sim_destroy(sim);
+	Asc_CompilerDestroy();
+}
+
+/*
+	eleven copies of a model part, so relations sharing a program: eight of
+	them fill the lanes once and the other three only some of them.
+*/
+static void test_lanes(void){
+	const char *model = "\
+		MODEL lanepart;\n\
+			x, y, z IS_A factor;\n\
+			x*exp(y/10) - z^2 = sin(x*y);\n\
+			x/(1 + y^2) + ln(z) = 3;\n\
+		END lanepart;\n\
+		MODEL lanes;\n\
+			p[1..11] IS_A lanepart;\n\
+		END lanes;\n";
+	int status, i, nvars, nrels;
+	struct Instance *sim;
+	slv_system_t sys;
+	struct var_variable **vlist;
+
+	Asc_CompilerInit(1);
+	Asc_PutEnv(ASC_ENV_LIBRARY "=models");
+
+	Asc_OpenModule("atoms.a4l", &status);
+	CU_ASSERT(status == 0);
+	CU_ASSERT(0 == zz_parse());
+	Asc_OpenStringModule(model, &status, "");
+	CU_ASSERT(status == 0);
+	CU_ASSERT(0 == zz_parse());
+
+	sim = SimsCreateInstance(AddSymbol("lanes"), AddSymbol("sim1"), e_normal, NULL);
+	CU_ASSERT_FATAL(sim != NULL);
+
+	sys = system_build(GetSimulationRoot(sim));
+	CU_ASSERT_FATAL(sys != NULL);
+	nvars = slv_get_num_solvers_vars(sys);
+	nrels = slv_get_num_solvers_rels(sys);
+	vlist = slv_get_solvers_var_list(sys);
+	CU_ASSERT(nrels == 22);
+
+	/* different values in every lane */
+	for(i = 0; i < nvars; i++){
+		var_set_value(vlist[i], 1.0 + 0.1 * i);
+	}
+	CU_ASSERT(0 == batch_errors(slv_get_solvers_rel_list(sys), nrels, nvars));
+
+	system_destroy(sys);
+	relman_free_reused_mem();
+	sim_destroy(sim);
+	Asc_CompilerDestroy();
+}
+
+/*===========================================================================*/
+/* Registration information */
+
+#define TESTS(T) \
+	T(allmodels) \
+	T(lanes)
+
+REGISTER_TESTS_SIMPLE(system_jacobian, TESTS)
@@ -0,0 +1,148 @@
+/*	ASCEND modelling environment
+	Copyright (C) 2015 John Pye
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2, or (at your option)
+	any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*//**
+	@file
+	Check that system_rebuild picks up FIX/FREE, 'included' and WHEN changes
+	in place, and builds a new system once the compiler has been run again.
+*/
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <ascend/general/platform.h>
+#include <ascend/general/ascMalloc.h>
+#include <ascend/utilities/ascEnvVar.h>
+#include <ascend/utilities/error.h>
+
+#include <ascend/compiler/ascCompiler.h>
+#include <ascend/compiler/module.h>
+#include <ascend/compiler/parser.h>
+#include <ascend/compiler/library.h>
+#include <ascend/compiler/symtab.h>
+#include <ascend/compiler/simlist.h>
+#include <ascend/compiler/instquery.h>
+#include <ascend/compiler/parentchild.h>
+#include <ascend/compiler/atomvalue.h>
+#include <ascend/compiler/initialize.h>
+#include <ascend/compiler/name.h>
+
+#include <ascend/system/system.h>
+#include <ascend/system/slv_client.h>
+
+#include <test/common.h>
+
+static struct Instance *child(struct Instance *i, const char *name){
+	return ChildByChar(i, AddSymbol(name));
+}
+
+static struct var_variable *find_var(slv_system_t sys, struct Instance *i){
+	struct var_variable **vl = slv_get_master_var_list(sys);
+	for(; *vl != NULL; vl++){
+		if(var_instance(*vl) == (SlvBackendToken)i)return *vl;
+	}
+	return NULL;
+}
+
+static struct rel_relation *find_rel(slv_system_t sys, struct Instance *i){
+	struct rel_relation **rl = slv_get_master_rel_list(sys);
+	for(; *rl != NULL; rl++){
+		if(rel_instance(*rl) == (SlvBackendToken)i)return *rl;
+	}
+	return NULL;
+}
+
+static void test_boundaries(void){
+	int status;
+	struct Instance *sim, *sim2, *root, *t1;
+	slv_system_t sys, sys2;
+	struct var_variable *var;
+	struct rel_relation *before, *during;
+
+	Asc_CompilerInit(1);
+	Asc_PutEnv(ASC_ENV_LIBRARY "=models");
+
+	Asc_OpenModule("test/ida/boundaries.a4c", &status);
+	CU_ASSERT(status == 0);
+	CU_ASSERT(0 == zz_parse());
+
+	sim = SimsCreateInstance(AddSymbol("boundaries"), AddSymbol("sim1"), e_normal, NULL);
+	CU_ASSERT_FATAL(sim != NULL);
+	root = GetSimulationRoot(sim);
+	Initialize(root, CreateIdName(AddSymbol("on_load")), "sim1", ASCERR, 0, NULL, NULL);
+
+	sys = system_build(root);
+	CU_ASSERT_FATAL(sys != NULL);
+
+	t1 = child(root, "t1");
+	var = find_var(sys, t1);
+	before = find_rel(sys, child(root, "ubefore"));
+	during = find_rel(sys, child(root, "uduring"));
+	CU_ASSERT_FATAL(var != NULL && before != NULL && during != NULL);
+
+	/* as built: t1 fixed, uisbefore TRUE */
+	CU_ASSERT(var_flags(var) & VAR_FIXED);
+	CU_ASSERT(rel_flags(before) & REL_INCLUDED);
+	CU_ASSERT(rel_flags(before) & REL_ACTIVE);
+	CU_ASSERT(!(rel_flags(during) & REL_ACTIVE));
+
+	/* FREE t1, exclude ubefore and switch the WHEN to 'during' */
+	SetBooleanAtomValue(child(t1, "fixed"), 0, 0);
+	SetBooleanAtomValue(child(child(root, "ubefore"), "included"), 0, 0);
+	SetBooleanAtomValue(child(root, "uisbefore"), 0, 0);
+	CU_ASSERT(var_flags(var) & VAR_FIXED); /* not seen yet */
+
+	CU_ASSERT(sys == system_rebuild(sys));
+	CU_ASSERT(!(var_flags(var) & VAR_FIXED));
+	CU_ASSERT(!(rel_flags(before) & REL_INCLUDED));
+	CU_ASSERT(!(rel_flags(before) & REL_ACTIVE));
+	CU_ASSERT(rel_flags(during) & REL_ACTIVE);
+
+	/* and back again */
+	SetBooleanAtomValue(child(t1, "fixed"), 1, 0);
+	SetBooleanAtomValue(child(root, "uisbefore"), 1, 0);
+	CU_ASSERT(sys == system_rebuild(sys));
+	CU_ASSERT(var_flags(var) & VAR_FIXED);
+	CU_ASSERT(rel_flags(before) & REL_ACTIVE);
+	CU_ASSERT(!(rel_flags(during) & REL_ACTIVE));
+
+	/* running the compiler again means a new system */
+	sim2 = SimsCreateInstance(AddSymbol("boundaries"), AddSymbol("sim2"), e_normal, NULL);
+	CU_ASSERT_FATAL(sim2 != NULL);
+	sys2 = system_rebuild(sys);
+	CU_ASSERT_FATAL(sys2 != NULL);
+	var = find_var(sys2, t1);
+	CU_ASSERT(var != NULL && (var_flags(var) & VAR_FIXED));
+	before = find_rel(sys2, child(root, "ubefore"));
+	CU_ASSERT(before != NULL && !(rel_flags(before) & REL_INCLUDED));
+
+	/* nothing has changed since, so this one is kept */
+	CU_ASSERT(sys2 == system_rebuild(sys2));
+
+	system_destroy(sys2);
+	system_free_reused_mem();
+	sim_destroy(sim2);
+	sim_destroy(sim);
+	Asc_CompilerDestroy();
+}
+
+/*===========================================================================*/
+/* Registration information */
+
+#define TESTS(T) \
+	T(boundaries)
+
+REGISTER_TESTS_SIMPLE(system_rebuild, TESTS)
@@ -19,7 +19,11 @@
 #include <ascend/general/platform.h>
 
 #define TESTS(T) \
-	T(link)
+	T(link) \
+	T(eval) \
+	T(jacobian) \
+	T(coloring) \
+	T(rebuild)
 
 #define PROTO_TEST(NAME) PROTO(system,NAME)
 TESTS(PROTO_TEST)
@@ -47,6 +47,7 @@
 #include <ascend/compiler/parentchild.h>
 #include <ascend/compiler/instquery.h>
 #include <ascend/compiler/instance_io.h>
+#include <ascend/compiler/valstore.h>
 
 #include <ascend/linear/mtx.h>
 
@@ -406,6 +407,12 @@ void var_set_flagbit(struct var_variable *var, uint32 field,uint32 one)
   } else {
     var->flags &= ~field;
   }
+  if (field & VAR_INCIDENT) {
+    ValueStoreSetFlag(IPTR(var->ratom),VS_INCLUDED,one != 0);
+  }
+  if (field & VAR_ACTIVE) {
+    ValueStoreSetFlag(IPTR(var->ratom),VS_ACTIVE,one != 0);
+  }
 }
 
 int32 var_apply_filter(const struct var_variable *var,
@@ -321,6 +321,36 @@ ASC_DLLSPEC SigHandlerFn *Asc_SignalStackTop(int signum);
 
 #endif /* ASC_SIGNAL_TRAPS */
 
+/*------------------------------------------------------------------------------
+  FLOATING POINT EXCEPTION FLAGS
+
+	An alternative to trapping SIGFPE for code that may run on several
+	threads at once, where a single g_fpe_env can't be shared: clear the
+	exception flags, do the calculation, then test them. The flags are
+	per thread. Without C99 <fenv.h> nothing is detected, and callers
+	must rely on checking their results with asc_finite.
+
+	<pre>
+	   Asc_FPEClear();
+	   y = f(x);
+	   if(Asc_FPETest()){
+	       ... error ...
+	   }
+	</pre>
+*/
+
+#ifdef HAVE_C99FPE
+# include <fenv.h>
+/** the exceptions that mean a result can't be trusted */
+# define ASC_FPE_ERRORS (FE_DIVBYZERO|FE_INVALID|FE_OVERFLOW)
+# define Asc_FPEClear() ((void)feclearexcept(ASC_FPE_ERRORS))
+# define Asc_FPETest() fetestexcept(ASC_FPE_ERRORS)
+#else
+# define ASC_FPE_ERRORS 0
+# define Asc_FPEClear() ((void)0)
+# define Asc_FPETest() 0
+#endif
+
 /* @} */
 
 #endif  /* ASC_ASCSIGNAL_H */
@@ -0,0 +1,364 @@
+/*	ASCEND modelling environment
+	Copyright (C) 2015 Carnegie Mellon University
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2, or (at your option)
+	any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*//** @file
+	Running a graph of dependent tasks on several threads.
+
+	The tasks are expected to be coarse (a block factorization, say), so
+	the deques are all guarded by the one scheduler lock rather than being
+	lock-free. What matters is which task a worker picks, not how quickly.
+*/
+
+#include <ascend/utilities/config.h>
+#include <ascend/general/ascMalloc.h>
+#include <ascend/general/panic.h>
+#include "ascTask.h"
+
+/*
+	Debug allocation keeps tables that are not safe to share, and without
+	thread-local storage the ASC_THREAD_LOCAL scratch statics of the mtx,
+	linsolqr and compiler recyclers would be shared by the workers.
+*/
+#if defined(ASC_WITH_THREADS) && !defined(MALLOC_DEBUG) \
+	&& defined(ASC_HAVE_THREAD_LOCAL)
+# define ASC_TASK_THREADS
+#endif
+
+#ifdef ASC_TASK_THREADS
+# include <pthread.h>
+# include <unistd.h>
+#endif
+
+/*------------------------------------------------------------------------------
+  SERIAL CASE
+*/
+
+/**
+	Kahn's algorithm with a FIFO of ready tasks, on the calling thread.
+*/
+static int task_graph_run_serial(int32 ntask, CONST int32 *npred
+		, CONST int32 *succptr, CONST int32 *succ
+		, AscTaskFn *fn, void *data
+){
+	int32 *count, *queue;
+	int32 head = 0, tail = 0, i, k;
+	int err = 0;
+
+	count = ASC_NEW_ARRAY(int32,ntask);
+	queue = ASC_NEW_ARRAY(int32,ntask);
+	for(i = 0; i < ntask; i++){
+		count[i] = npred[i];
+		if(count[i] == 0){
+			queue[tail++] = i;
+		}
+	}
+	while(head < tail){
+		i = queue[head++];
+		err = (*fn)(data,0,i);
+		if(err){
+			break;
+		}
+		for(k = succptr[i]; k < succptr[i+1]; k++){
+			if(--count[succ[k]] == 0){
+				queue[tail++] = succ[k];
+			}
+		}
+	}
+	if(!err && tail < ntask){
+		err = -1;
+	}
+	ASC_FREE(count);
+	ASC_FREE(queue);
+	return err;
+}
+
+#ifdef ASC_TASK_THREADS
+
+/*------------------------------------------------------------------------------
+  THREADED CASE
+*/
+
+struct task_deque{
+	int32 *task;  /**< capacity ntask: each task is pushed once, somewhere */
+	int32 top;    /**< oldest entry, stolen by others */
+	int32 bottom; /**< one past the newest entry, taken by the owner */
+};
+
+struct task_graph{
+	int32 ntask;
+	CONST int32 *succptr;
+	CONST int32 *succ;
+	AscTaskFn *fn;
+	AscTaskWorkerFn *done;
+	void *data;
+	int nworker;
+
+	pthread_mutex_t lock; /**< guards everything below */
+	pthread_cond_t wake;
+	int32 *count;         /**< unfinished predecessors of each task */
+	struct task_deque *dq;
+	int32 remaining;      /**< tasks not yet finished */
+	int running;          /**< tasks being run right now */
+	int err;
+};
+
+struct task_worker{
+	struct task_graph *g;
+	int worker;
+};
+
+/**
+	Take a ready task for worker w: its own newest, else the oldest of
+	the next worker round that has one. Lock held.
+	@return the task, or -1 if none is ready.
+*/
+static int32 task_graph_take(struct task_graph *g, int w){
+	struct task_deque *d = &(g->dq[w]);
+	int k;
+	if(d->bottom > d->top){
+		return d->task[--(d->bottom)];
+	}
+	for(k = 1; k < g->nworker; k++){
+		d = &(g->dq[(w + k) % g->nworker]);
+		if(d->bottom > d->top){
+			return d->task[(d->top)++];
+		}
+	}
+	return -1;
+}
+
+static void task_graph_work(struct task_graph *g, int w){
+	int32 t, k;
+	int r, woke;
+	struct task_deque *d = &(g->dq[w]);
+
+	pthread_mutex_lock(&g->lock);
+	for(;;){
+		if(g->err || g->remaining == 0){
+			break;
+		}
+		t = task_graph_take(g,w);
+		if(t < 0){
+			if(g->running == 0){
+				/* nothing ready and nothing that could make it so */
+				g->err = -1;
+				pthread_cond_broadcast(&g->wake);
+				break;
+			}
+			pthread_cond_wait(&g->wake,&g->lock);
+			continue;
+		}
+		g->running++;
+		pthread_mutex_unlock(&g->lock);
+
+		r = (*(g->fn))(g->data,w,t);
+
+		pthread_mutex_lock(&g->lock);
+		g->running--;
+		if(r){
+			if(!g->err){
+				g->err = r;
+			}
+			pthread_cond_broadcast(&g->wake);
+			continue;
+		}
+		g->remaining--;
+		woke = 0;
+		for(k = g->succptr[t]; k < g->succptr[t+1]; k++){
+			if(--(g->count[g->succ[k]]) == 0){
+				d->task[(d->bottom)++] = g->succ[k];
+				woke++;
+			}
+		}
+		if(woke || g->remaining == 0){
+			pthread_cond_broadcast(&g->wake);
+		}
+	}
+	pthread_mutex_unlock(&g->lock);
+}
+
+static void *task_graph_thread(void *arg){
+	struct task_worker *tw = (struct task_worker *)arg;
+	task_graph_work(tw->g,tw->worker);
+	if(tw->g->done != NULL){
+		(*(tw->g->done))(tw->g->data,tw->worker);
+	}
+	return NULL;
+}
+
+static int task_graph_run_threads(int32 ntask, CONST int32 *npred
+		, CONST int32 *succptr, CONST int32 *succ
+		, int nworker, AscTaskFn *fn, AscTaskWorkerFn *done, void *data
+){
+	struct task_graph g;
+	struct task_worker *tw;
+	pthread_t *thread;
+	int32 i;
+	int w, nstarted;
+
+	g.ntask = ntask;
+	g.succptr = succptr;
+	g.succ = succ;
+	g.fn = fn;
+	g.done = done;
+	g.data = data;
+	g.nworker = nworker;
+	g.remaining = ntask;
+	g.running = 0;
+	g.err = 0;
+	g.count = ASC_NEW_ARRAY(int32,ntask);
+	g.dq = ASC_NEW_ARRAY(struct task_deque,nworker);
+	for(w = 0; w < nworker; w++){
+		g.dq[w].task = ASC_NEW_ARRAY(int32,ntask);
+		g.dq[w].top = g.dq[w].bottom = 0;
+	}
+	/* deal out the initial tasks so each worker starts on its lowest */
+	w = 0;
+	for(i = 0; i < ntask; i++){
+		g.count[i] = npred[i];
+		if(npred[i] == 0){
+			g.dq[w].task[(g.dq[w].bottom)++] = i;
+			w = (w + 1) % nworker;
+		}
+	}
+	for(w = 0; w < nworker; w++){
+		struct task_deque *d = &(g.dq[w]);
+		int32 lo = d->top, hi = d->bottom - 1, tmp;
+		while(lo < hi){
+			tmp = d->task[lo]; d->task[lo] = d->task[hi]; d->task[hi] = tmp;
+			lo++; hi--;
+		}
+	}
+	pthread_mutex_init(&g.lock,NULL);
+	pthread_cond_init(&g.wake,NULL);
+
+	tw = ASC_NEW_ARRAY(struct task_worker,nworker);
+	thread = ASC_NEW_ARRAY(pthread_t,nworker);
+	nstarted = 1;
+	for(w = 1; w < nworker; w++){
+		tw[w].g = &g;
+		tw[w].worker = w;
+		if(pthread_create(&thread[w],NULL,&task_graph_thread,&tw[w])){
+			/* the ones we have will steal the rest */
+			break;
+		}
+		nstarted++;
+	}
+	task_graph_work(&g,0);
+	for(w = 1; w < nstarted; w++){
+		pthread_join(thread[w],NULL);
+	}
+
+	pthread_cond_destroy(&g.wake);
+	pthread_mutex_destroy(&g.lock);
+	for(w = 0; w < nworker; w++){
+		ASC_FREE(g.dq[w].task);
+	}
+	ASC_FREE(g.dq);
+	ASC_FREE(g.count);
+	ASC_FREE(tw);
+	ASC_FREE(thread);
+	return g.err;
+}
+
+#endif /* ASC_TASK_THREADS */
+
+/*------------------------------------------------------------------------------
+  PUBLIC ROUTINES
+*/
+
+int asc_task_graph_run(int32 ntask, CONST int32 *npred
+		, CONST int32 *succptr, CONST int32 *succ
+		, int nworker, AscTaskFn *fn, AscTaskWorkerFn *done, void *data
+){
+	asc_assert(fn != NULL);
+	if(ntask <= 0){
+		return 0;
+	}
+	if(nworker > ntask){
+		nworker = (int)ntask;
+	}
+#ifdef ASC_TASK_THREADS
+	if(nworker > 1){
+		return task_graph_run_threads(ntask,npred,succptr,succ
+			,nworker,fn,done,data
+		);
+	}
+#else
+	(void)done;
+#endif
+	return task_graph_run_serial(ntask,npred,succptr,succ,fn,data);
+}
+
+int asc_task_num_cpus(void){
+#if defined(ASC_TASK_THREADS) && defined(_SC_NPROCESSORS_ONLN)
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	if(n > 1){
+		return (int)n;
+	}
+#endif
+	return 1;
+}
+
+#ifdef ASC_TASK_THREADS
+
+struct asc_mutex_struct{
+	pthread_mutex_t m;
+};
+
+asc_mutex_t asc_mutex_create(void){
+	asc_mutex_t m = ASC_NEW(struct asc_mutex_struct);
+	pthread_mutex_init(&(m->m),NULL);
+	return m;
+}
+
+void asc_mutex_destroy(asc_mutex_t m){
+	if(m != NULL){
+		pthread_mutex_destroy(&(m->m));
+		ASC_FREE(m);
+	}
+}
+
+void asc_mutex_lock(asc_mutex_t m){
+	if(m != NULL){
+		pthread_mutex_lock(&(m->m));
+	}
+}
+
+void asc_mutex_unlock(asc_mutex_t m){
+	if(m != NULL){
+		pthread_mutex_unlock(&(m->m));
+	}
+}
+
+#else
+
+asc_mutex_t asc_mutex_create(void){
+	return NULL;
+}
+
+void asc_mutex_destroy(asc_mutex_t m){
+	(void)m;
+}
+
+void asc_mutex_lock(asc_mutex_t m){
+	(void)m;
+}
+
+void asc_mutex_unlock(asc_mutex_t m){
+	(void)m;
+}
+
+#endif /* ASC_TASK_THREADS */
@@ -0,0 +1,108 @@
+/*	ASCEND modelling environment
+	Copyright (C) 2015 Carnegie Mellon University
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2, or (at your option)
+	any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*//**
+	@file
+	Running a graph of dependent tasks on several threads.
+
+	The tasks are numbered 0..ntask-1. Task j may not start until all of
+	its npred[j] predecessors are finished; the successors of task i are
+	succ[succptr[i]..succptr[i+1]-1]. Each worker thread keeps its own
+	deque of ready tasks. A worker takes the task it made ready most
+	recently from its own deque, and when that is empty steals the oldest
+	task from another worker's deque, so chains of dependent tasks tend
+	to stay on one thread while independent branches spread out.
+
+	The calling thread is worker 0 and takes part in the work. If ASCEND
+	was built without thread support (ASC_WITH_THREADS) or by a compiler
+	without thread-local storage (ASC_HAVE_THREAD_LOCAL), or nworker is 1,
+	all tasks are run in order of readiness on the calling thread.
+
+	The task function is called without any lock held. Whatever it shares
+	with other tasks it must protect itself, for example with an
+	asc_mutex_t. Code that keeps scratch memory in static data can be run
+	this way only if that data is ASC_THREAD_LOCAL.
+
+	A minimal use might be:
+	<pre>
+	   static int run_one(void *data, int worker, int32 task){
+	     struct mywork *w = (struct mywork *)data;
+	     return do_block(w->block[task], w->scratch[worker]);
+	   }
+	   ...
+	   err = asc_task_graph_run(n, npred, succptr, succ,
+	                            asc_task_num_cpus(), run_one, NULL, &w);
+	</pre>
+*/
+
+#ifndef ASC_ASCTASK_H
+#define ASC_ASCTASK_H
+
+#include <ascend/general/platform.h>
+
+/**	@addtogroup utilities_task Utilities Task Scheduling
+	@{
+*/
+
+typedef int AscTaskFn(void *data, int worker, int32 task);
+/**<
+	Run one task. worker is in 0..nworker-1 and identifies the thread,
+	so it may be used to index per-thread scratch space.
+	@return 0 if ok. Any other value stops the scheduler from starting
+	further tasks and is returned by asc_task_graph_run.
+*/
+
+typedef void AscTaskWorkerFn(void *data, int worker);
+/**<
+	Called on each worker thread other than the calling one just before
+	it exits, so that thread-local memory can be released.
+*/
+
+ASC_DLLSPEC int asc_task_graph_run(int32 ntask, CONST int32 *npred
+		, CONST int32 *succptr, CONST int32 *succ
+		, int nworker, AscTaskFn *fn, AscTaskWorkerFn *done, void *data);
+/**<
+	Run all the tasks of a graph, respecting its dependencies, on up to
+	nworker threads (never more than ntask). Returns when every task that
+	was started is finished.
+
+	@param npred  number of predecessors of each task, not modified.
+	@param done   may be NULL.
+	@return 0 if all the tasks were run, else the first nonzero value
+	returned by fn, or -1 if some tasks could never start because the
+	graph has a cycle.
+*/
+
+ASC_DLLSPEC int asc_task_num_cpus(void);
+/**<
+	@return the number of processors available, or 1 if that is unknown
+	or ASCEND was built without thread support.
+*/
+
+typedef struct asc_mutex_struct *asc_mutex_t;
+
+ASC_DLLSPEC asc_mutex_t asc_mutex_create(void);
+/**<
+	Create a mutex for use by tasks. Without thread support this returns
+	NULL, which asc_mutex_lock and asc_mutex_unlock accept and ignore.
+*/
+
+ASC_DLLSPEC void asc_mutex_destroy(asc_mutex_t m);
+ASC_DLLSPEC void asc_mutex_lock(asc_mutex_t m);
+ASC_DLLSPEC void asc_mutex_unlock(asc_mutex_t m);
+
+/* @} */
+
+#endif  /* ASC_ASCTASK_H */
@@ -17,9 +17,9 @@ static error_reporter_callback_t g_error_reporter_callback;
 
 /**
 	Global variable which holds cached error info for
-	later output
+	later output. Each thread caches its own, as for the tree below.
 */
-static error_reporter_meta_t g_error_reporter_cache;
+static ASC_THREAD_LOCAL error_reporter_meta_t g_error_reporter_cache;
 
 #ifdef ERROR_REPORTER_TREE_ACTIVE
 static error_reporter_meta_t *error_reporter_meta_new(){
@@ -86,8 +86,10 @@ int error_reporter_default_callback(ERROR_REPORTER_CALLBACK_ARGS){
 
 #ifdef ERROR_REPORTER_TREE_ACTIVE
 
-static error_reporter_tree_t *g_error_reporter_tree = NULL;
-static error_reporter_tree_t *g_error_reporter_tree_current = NULL;
+/* per thread, so that work done on other threads can collect its errors
+for the thread it is done for to report (error_reporter_tree_take) */
+static ASC_THREAD_LOCAL error_reporter_tree_t *g_error_reporter_tree = NULL;
+static ASC_THREAD_LOCAL error_reporter_tree_t *g_error_reporter_tree_current = NULL;
 
 # define TREECURRENT g_error_reporter_tree_current
 # define TREE g_error_reporter_tree
@@ -225,8 +227,6 @@ int error_reporter_tree_has_error(){
 static int error_reporter_tree_write(error_reporter_tree_t *t){
 	int res = 0;
 
-	asc_assert(TREE==NULL); /* else recursive calls will occur */
-
 	if(t->err){
 		res += error_reporter(t->err->sev, t->err->filename, t->err->line, t->err->func, t->err->msg);
 	}else{
@@ -242,6 +242,41 @@ static int error_reporter_tree_write(error_reporter_tree_t *t){
 	return res;
 }
 
+error_reporter_tree_t *error_reporter_tree_take(){
+	error_reporter_tree_t *t = TREECURRENT, *p;
+	if(!t){
+		ERROR_REPORTER_HERE(ASC_PROG_ERR,"'take' without TREECURRENT set");
+		return NULL;
+	}
+	p = t->parent;
+	TREECURRENT = p;
+	if(p == NULL){
+		TREE = NULL;
+		return t;
+	}
+	/* t is the last in its parent's list, as nothing has been added to the
+	parent since t was started */
+	asc_assert(p->tail == t);
+	if(p->head == t){
+		p->head = p->tail = NULL;
+	}else{
+		for(p->tail = p->head; p->tail->next != t; p->tail = p->tail->next);
+		p->tail->next = NULL;
+	}
+	t->parent = NULL;
+	return t;
+}
+
+void error_reporter_tree_report(error_reporter_tree_t *t){
+	if(t == NULL){
+		return;
+	}
+	/* as va_error_reporter does when it flushes TREE, but the messages go
+	into this thread's tree if one is open */
+	error_reporter_tree_write(t);
+	error_reporter_tree_free(t);
+}
+
 #else /* ERROR_REPORTER_TREE_ACTIVE */
 int error_reporter_tree_start(){
 	ERROR_REPORTER_HERE(ASC_PROG_WARNING,"Error reporter 'tree' turned off at compile time");
@@ -249,6 +284,8 @@ int error_reporter_tree_start(){
 }
 int error_reporter_tree_end(){return 0;}
 void error_reporter_tree_clear(){}
+error_reporter_tree_t *error_reporter_tree_take(){return NULL;}
+void error_reporter_tree_report(error_reporter_tree_t *t){(void)t;}
 int error_reporter_tree_has_error(){
 	ERROR_REPORTER_HERE(ASC_PROG_WARNING,"Attempt to check 'tree_has_error' when 'tree' turned off at compile time");
 	return 0;
@@ -295,6 +332,7 @@ va_error_reporter(
 			/* CONSOLE_DEBUG("WRITING OUT TREE CONTENTS"); */
 			t = TREE;
 			TREE = NULL;
+			/* with TREE NULL, the writes below don't get here again */
 			error_reporter_tree_write(t);
 			//CONSOLE_DEBUG("DONE WRITING TREE");
 			TREECURRENT = t;
@@ -215,6 +215,27 @@ ASC_DLLSPEC int error_reporter_tree_end();
 ASC_DLLSPEC void error_reporter_tree_clear();
 ASC_DLLSPEC int error_reporter_tree_has_error();
 
+/**
+	The tree, like the cache used by error_reporter_start, belongs to the
+	thread. Work done on another thread on behalf of this one can collect its
+	errors after an error_reporter_tree_start there, and then hand them over
+	with error_reporter_tree_take, for error_reporter_tree_report to report
+	here, in whatever order the work would have been done in on one thread.
+*/
+ASC_DLLSPEC error_reporter_tree_t *error_reporter_tree_take();
+/**<
+	End the tree begun by the last error_reporter_tree_start on this thread,
+	as error_reporter_tree_end would, but detach it, so that its errors are
+	not reported. @return the tree, or NULL if none was started.
+*/
+
+ASC_DLLSPEC void error_reporter_tree_report(error_reporter_tree_t *t);
+/**<
+	Report the errors in a tree from error_reporter_tree_take (from any
+	thread) as though they had been reported on this one, and free it.
+	NULL is ignored.
+*/
+
 /**
 	This is the drop-in replacement for Asc_FPrintf. Anythin you attempt
 	to print to stderr will be captured and passed to the error_reporter_callback
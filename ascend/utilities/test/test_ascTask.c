@@ -0,0 +1,196 @@
+/*
+ *  Unit test functions for ASCEND: utilities/ascTask.c
+ *
+ *  Copyright (C) 2015 Carnegie Mellon University
+ *
+ *  This file is part of the Ascend Environment.
+ *
+ *  The Ascend Environment is free software; you can redistribute it
+ *  and/or modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of the
+ *  License, or (at your option) any later version.
+ *
+ *  The Ascend Environment is distributed in hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ascend/general/platform.h>
+#include <ascend/general/ascMalloc.h>
+#include <ascend/utilities/ascTask.h>
+
+#include <test/common.h>
+
+/*
+	A layered graph: NLAYER layers of WIDTH tasks, each task depending
+	on two tasks of the layer before. Tasks record the order they finish
+	in, so we can check nothing ran before its predecessors.
+*/
+#define WIDTH 7
+#define NLAYER 6
+#define NTASK (WIDTH*NLAYER)
+
+struct task_test{
+	asc_mutex_t m;
+	int32 nrun;
+	int32 order[NTASK];  /* finish position of each task, or -1 */
+	int32 fail_at;       /* task that returns an error, or -1 */
+	int ndone;
+};
+
+static int task_test_fn(void *data, int worker, int32 task){
+	struct task_test *t = (struct task_test *)data;
+	volatile double x = 0;
+	int i;
+	(void)worker;
+	for(i = 0; i < 1000 * (task % 5 + 1); i++){
+		x += i;
+	}
+	if(task == t->fail_at){
+		return 7;
+	}
+	asc_mutex_lock(t->m);
+	t->order[task] = t->nrun++;
+	asc_mutex_unlock(t->m);
+	return 0;
+}
+
+static void task_test_done(void *data, int worker){
+	struct task_test *t = (struct task_test *)data;
+	CU_TEST(worker > 0);
+	asc_mutex_lock(t->m);
+	t->ndone++;
+	asc_mutex_unlock(t->m);
+}
+
+static void task_test_graph(int32 *npred, int32 *succptr, int32 *succ){
+	int32 i, l, k = 0;
+	for(i = 0; i < NTASK; i++){
+		npred[i] = (i < WIDTH) ? 0 : 2;
+	}
+	for(i = 0; i < NTASK; i++){
+		succptr[i] = k;
+		l = i / WIDTH;
+		if(l < NLAYER - 1){
+			/* successors (l+1, i) and (l+1, i+1) */
+			succ[k++] = (l + 1) * WIDTH + i % WIDTH;
+			succ[k++] = (l + 1) * WIDTH + (i + 1) % WIDTH;
+		}
+	}
+	succptr[NTASK] = k;
+}
+
+static void task_test_run(int nworker){
+	struct task_test t;
+	int32 npred[NTASK], succptr[NTASK + 1], succ[2 * NTASK];
+	int32 i, k;
+	int err;
+
+	task_test_graph(npred,succptr,succ);
+	t.m = asc_mutex_create();
+	t.nrun = 0;
+	t.fail_at = -1;
+	t.ndone = 0;
+	for(i = 0; i < NTASK; i++){
+		t.order[i] = -1;
+	}
+	err = asc_task_graph_run(NTASK,npred,succptr,succ,nworker
+		,&task_test_fn,&task_test_done,&t
+	);
+	CU_TEST(err == 0);
+	CU_TEST(t.nrun == NTASK);
+	for(i = 0; i < NTASK; i++){
+		CU_TEST(t.order[i] >= 0);
+		for(k = succptr[i]; k < succptr[i+1]; k++){
+			CU_TEST(t.order[i] < t.order[succ[k]]);
+		}
+	}
+	/* done is only for threads the scheduler started itself */
+	CU_TEST(t.ndone <= nworker - 1);
+	asc_mutex_destroy(t.m);
+}
+
+static void test_graph(void){
+	unsigned long prior_meminuse = ascmeminuse();
+	task_test_run(1);
+	task_test_run(3);
+	task_test_run(asc_task_num_cpus());
+	CU_TEST(prior_meminuse == ascmeminuse());
+}
+
+static void test_error(void){
+	struct task_test t;
+	int32 npred[NTASK], succptr[NTASK + 1], succ[2 * NTASK];
+	int32 i, nw;
+	int err;
+	unsigned long prior_meminuse = ascmeminuse();
+
+	task_test_graph(npred,succptr,succ);
+	for(nw = 1; nw <= 4; nw += 3){
+		t.m = asc_mutex_create();
+		t.nrun = 0;
+		t.fail_at = 2 * WIDTH + 3;
+		t.ndone = 0;
+		for(i = 0; i < NTASK; i++){
+			t.order[i] = -1;
+		}
+		err = asc_task_graph_run(NTASK,npred,succptr,succ,nw
+			,&task_test_fn,NULL,&t
+		);
+		CU_TEST(err == 7);
+		/* the failed task's successors never start */
+		CU_TEST(t.order[t.fail_at] == -1);
+		CU_TEST(t.order[succ[succptr[t.fail_at]]] == -1);
+		CU_TEST(t.nrun < NTASK);
+		asc_mutex_destroy(t.m);
+	}
+
+	/* a cycle between the first two tasks of the second layer */
+	task_test_graph(npred,succptr,succ);
+	npred[WIDTH] = 3;
+	npred[WIDTH + 1] = 3;
+	{
+		int32 cptr[NTASK + 1], csucc[2 * NTASK + 2], k = 0;
+		for(i = 0; i < NTASK; i++){
+			cptr[i] = k;
+			if(i == WIDTH){
+				csucc[k++] = WIDTH + 1;
+			}else if(i == WIDTH + 1){
+				csucc[k++] = WIDTH;
+			}
+			for(nw = succptr[i]; nw < succptr[i+1]; nw++){
+				csucc[k++] = succ[nw];
+			}
+		}
+		cptr[NTASK] = k;
+		for(nw = 1; nw <= 4; nw += 3){
+			t.m = asc_mutex_create();
+			t.nrun = 0;
+			t.fail_at = -1;
+			for(i = 0; i < NTASK; i++){
+				t.order[i] = -1;
+			}
+			err = asc_task_graph_run(NTASK,npred,cptr,csucc,nw
+				,&task_test_fn,NULL,&t
+			);
+			CU_TEST(err == -1);
+			CU_TEST(t.order[0] >= 0);
+			CU_TEST(t.order[WIDTH] == -1);
+			asc_mutex_destroy(t.m);
+		}
+	}
+	CU_TEST(prior_meminuse == ascmeminuse());
+}
+
+/*===========================================================================*/
+/* Registration information */
+
+#define TESTS(T) \
+	T(graph) \
+	T(error)
+
+REGISTER_TESTS_SIMPLE(utilities_ascTask, TESTS)
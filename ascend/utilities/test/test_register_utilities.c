@@ -29,6 +29,7 @@
 #define TESTS(T) \
 	T(ascDynaLoad) \
 	T(ascEnvVar) \
+	T(ascTask) \
 	/*T(ascPanic)*/ \
 	T(ascPrint) \
 	T(ascSignal) \
@@ -19,12 +19,14 @@ Compiler::Compiler(){
 	/* set some default for bintoken compilation */
 	use_bintoken = false;
 	bintoken_options_sent = false;
+	bt_jit = false;
 	bt_targetstem = "/tmp/asc_bintoken";
 	bt_srcname = bt_targetstem + ".c";
 	bt_objname = bt_targetstem + ".o";
 	bt_libname = bt_targetstem + ".so";
 	bt_cmd = "make -f ascend/bintokens/Makefile ASCBT_TARGET=" + bt_libname + " ASCBT_SRC=" + bt_srcname;
 	bt_rm = "/bin/rm";
+	bt_jitcache = bt_targetstem + ".jit";
 }
 
 Compiler::~Compiler(){
@@ -66,19 +68,38 @@ Compiler::setBinaryCompilation(const bool &use_bintoken){
 #endif
 }
 
+/**
+	Generate the code for binary tokens in-process (BT_JIT) rather than with
+	an external C compiler (BT_C). Only has an effect if binary compilation
+	is turned on with setBinaryCompilation.
+*/
+void
+Compiler::setBinaryCompilationJIT(const bool &use_jit){
+	if(use_jit != bt_jit){
+		bintoken_options_sent = false;
+	}
+	this->bt_jit = use_jit;
+}
+
 void
 Compiler::sendBinaryCompilationOptions(){
 	if(use_bintoken && !bintoken_options_sent){
 #ifdef BINTOKEN_DEBUG
 		CONSOLE_DEBUG("SETUP BINTOKENS...");
 #endif
-		BinTokenSetOptions(bt_srcname.c_str(), bt_objname.c_str(), bt_libname.c_str()
-			, bt_cmd.c_str(), bt_rm.c_str(), 1000/*maxrels*/, 1/*verbose*/, 0/*housekeep*/
-		);
+		if(bt_jit){
+			if(BinTokenSetJITOptions(bt_jitcache.c_str(), 1000/*maxrels*/)){
+				ERROR_REPORTER_HERE(ASC_USER_WARNING,"JIT binary compilation is not available on this platform");
+			}
+		}else{
+			BinTokenSetOptions(bt_srcname.c_str(), bt_objname.c_str(), bt_libname.c_str()
+				, bt_cmd.c_str(), bt_rm.c_str(), 1000/*maxrels*/, 1/*verbose*/, 0/*housekeep*/
+			);
+		}
 
 #ifdef BINTOKEN_DEBUG
-		CONSOLE_DEBUG("srcname = %s, objname = %s, libname = %s, cmd = %s, rm = %s",
-			bt_srcname.c_str(), bt_objname.c_str(), bt_libname.c_str(), bt_cmd.c_str(), bt_rm.c_str()
+		CONSOLE_DEBUG("jit = %d, srcname = %s, objname = %s, libname = %s, cmd = %s, rm = %s",
+			int(bt_jit), bt_srcname.c_str(), bt_objname.c_str(), bt_libname.c_str(), bt_cmd.c_str(), bt_rm.c_str()
 		);
 #endif
 
@@ -29,6 +29,8 @@ private:
 	/* options for bintoken compilation */
 	bool use_bintoken;
 	bool bintoken_options_sent;
+	bool bt_jit;
+	std::string bt_jitcache;
 	std::string bt_targetstem;
 	std::string bt_srcname;
 	std::string bt_objname;
@@ -46,6 +48,7 @@ public:
 	void setUseRelationSharing(const bool&);
 
 	void setBinaryCompilation(const bool&);
+	void setBinaryCompilationJIT(const bool&);
 };
 
 /** Compiler access function for use with Python */
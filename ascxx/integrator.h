@@ -45,6 +45,7 @@ const int IDA = INTEG_IDA;
 class Integrator{
 	friend class IntegratorReporterCxx;
 	friend class IntegratorReporterConsole;
+	friend class IntegratorReporterFile;
 
 public:
 	Integrator(Simulation &);
@@ -91,6 +91,77 @@ int IntegratorReporterConsole::recordObservedValues(){
 	return 1;
 }
 
+//------------------------------------------------------------------------------
+// OBSERVATION FILE INTEGRATOR REPORTER
+
+IntegratorReporterFile::IntegratorReporterFile(Integrator *integrator
+		, const string &filename, const long &chunk, const bool &compress
+) : IntegratorReporterCxx(integrator), filename(filename), chunk(chunk){
+	flags = compress ? OBSFILE_COMPRESS : 0;
+	file = NULL;
+}
+
+IntegratorReporterFile::~IntegratorReporterFile(){
+	if(file!=NULL){
+		obsfile_close(file);
+	}
+}
+
+int
+IntegratorReporterFile::initOutput(){
+	long nobs = integrator->getNumObservedVars();
+	vector<string> names;
+	vector<const char *> cnames;
+
+	names.push_back(integrator->getIndependentVariable().getName());
+	for(long i=0; i<nobs; ++i){
+		names.push_back(integrator->getObservedVariable(i).getName());
+	}
+	for(vector<string>::iterator i=names.begin(); i<names.end(); ++i){
+		cnames.push_back(i->c_str());
+	}
+	if(file!=NULL){
+		obsfile_close(file);
+	}
+	file = obsfile_create(filename.c_str(),nobs+1,&cnames[0],chunk,flags);
+	if(file==NULL){
+		throw runtime_error("Unable to create observation file");
+	}
+	row.resize(nobs+1);
+	return 1;
+}
+
+int IntegratorReporterFile::closeOutput(){
+	if(file==NULL){
+		return 1;
+	}
+	int res = obsfile_close(file);
+	file = NULL;
+	if(res){
+		throw runtime_error("Error writing observation file");
+	}
+	return 1;
+}
+
+int IntegratorReporterFile::updateStatus(){
+	return 1;
+}
+
+int IntegratorReporterFile::recordObservedValues(){
+	if(file==NULL){
+		return 0;
+	}
+	IntegratorSystem *sys = integrator->getInternalType();
+	row[0] = integrator_get_t(sys);
+	if(row.size() > 1){
+		integrator_get_observations(sys,&row[1]);
+	}
+	if(obsfile_append(file,&row[0])){
+		return 0;
+	}
+	return 1;
+}
+
 //----------------------------------------------------
 // DEFAULT INTEGRATOR REPORTER (reporter start and end, outputs time at each step)
 
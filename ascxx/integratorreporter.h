@@ -25,9 +25,12 @@
 extern "C"{
 #include <ascend/general/platform.h>
 #include <ascend/integrator/integrator.h>
+#include <ascend/integrator/obsfile.h>
 }
 
 #include <ostream>
+#include <string>
+#include <vector>
 
 class Integrator;
 
@@ -95,6 +98,33 @@ public:
 	virtual int recordObservedValues();
 };
 
+/**
+	Integrator reporter that streams the observed variables to an
+	observation file (see ascend/integrator/obsfile.h), holding no more than
+	a chunk of samples in memory. Read the results with ObservationFile.
+*/
+class IntegratorReporterFile : public IntegratorReporterCxx{
+private:
+	std::string filename;
+	long chunk;
+	int flags;
+	ObsFile *file;
+	std::vector<double> row;
+public:
+	/**
+		@param chunk samples to buffer before writing, or 0 for up to
+		OBSFILE_BUFFER_BYTES.
+	*/
+	IntegratorReporterFile(Integrator *, const std::string &filename
+		, const long &chunk=0, const bool &compress=true
+	);
+	virtual ~IntegratorReporterFile();
+
+	virtual int initOutput();
+	virtual int closeOutput();
+	virtual int updateStatus();
+	virtual int recordObservedValues();
+};
 
 int ascxx_integratorreporter_init(IntegratorSystem *blsys);
 int ascxx_integratorreporter_write(IntegratorSystem *blsys);
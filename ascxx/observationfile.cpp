@@ -0,0 +1,76 @@
+#include "observationfile.h"
+
+#include <stdexcept>
+#include <sstream>
+using namespace std;
+
+ObservationFile::ObservationFile(const string &filename){
+	f = obsfile_open(filename.c_str());
+	if(f==NULL){
+		stringstream ss;
+		ss << "Unable to open observation file '" << filename << "'";
+		throw runtime_error(ss.str());
+	}
+}
+
+ObservationFile::~ObservationFile(){
+	obsfile_close(f);
+}
+
+int
+ObservationFile::getNumVariables() const{
+	return obsfile_ncols(f);
+}
+
+long
+ObservationFile::getNumSamples() const{
+	return obsfile_nrows(f);
+}
+
+string
+ObservationFile::getName(const int &i) const{
+	const char *name = obsfile_name(f,i);
+	if(name==NULL){
+		throw range_error("Invalid variable index");
+	}
+	return string(name);
+}
+
+int
+ObservationFile::getIndex(const string &name) const{
+	int i = obsfile_find(f,name.c_str());
+	if(i < 0){
+		stringstream ss;
+		ss << "No variable '" << name << "' in observation file";
+		throw range_error(ss.str());
+	}
+	return i;
+}
+
+vector<double>
+ObservationFile::getTimeSeries(const int &i, const long &start, const long &count){
+	if(i < 0 || i >= getNumVariables()){
+		throw range_error("Invalid variable index");
+	}
+	if(start < 0){
+		throw range_error("Invalid start sample");
+	}
+	long n = getNumSamples() - start;
+	if(n < 0)n = 0;
+	if(count >= 0 && count < n)n = count;
+	vector<double> v(n);
+	if(n > 0 && obsfile_read_col(f,i,start,n,&v[0]) != n){
+		throw runtime_error("Unable to read from observation file");
+	}
+	return v;
+}
+
+vector<double>
+ObservationFile::getTimeSeries(const string &name, const long &start, const long &count){
+	return getTimeSeries(getIndex(name),start,count);
+}
+
+vector<double>
+ObservationFile::getTimes(const long &start, const long &count){
+	return getTimeSeries(0,start,count);
+}
@@ -0,0 +1,64 @@
+/*	ASCEND modelling environment
+	Copyright (C) 2015 Carnegie Mellon University
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2, or (at your option)
+	any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*//** @file
+	C++ reader for observation files, as written by IntegratorReporterFile
+	(see ascend/integrator/obsfile.h). Only the header and index are read
+	when the file is opened; each time series is read from disk when it is
+	asked for, so files much larger than memory can be browsed.
+*/
+#ifndef ASCXX_OBSERVATIONFILE_H
+#define ASCXX_OBSERVATIONFILE_H
+
+#include <string>
+#include <vector>
+
+extern "C"{
+#include <ascend/general/platform.h>
+#include <ascend/integrator/obsfile.h>
+}
+
+class ObservationFile{
+public:
+	ObservationFile(const std::string &filename);
+	~ObservationFile();
+
+	/** number of variables, including the independent variable (number 0) */
+	int getNumVariables() const;
+	/** number of samples of each variable */
+	long getNumSamples() const;
+
+	std::string getName(const int &i) const;
+	/** @return the number of the named variable; throws if there is none */
+	int getIndex(const std::string &name) const;
+
+	/**
+		Values of variable i at samples start..start+count-1 (to the end if
+		count is negative).
+	*/
+	std::vector<double> getTimeSeries(const int &i, const long &start=0, const long &count=-1);
+	std::vector<double> getTimeSeries(const std::string &name, const long &start=0, const long &count=-1);
+
+	/** the values of the independent variable */
+	std::vector<double> getTimes(const long &start=0, const long &count=-1);
+
+private:
+	ObservationFile(const ObservationFile &);
+	ObservationFile &operator=(const ObservationFile &);
+
+	ObsFile *f;
+};
+
+#endif
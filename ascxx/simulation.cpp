@@ -257,6 +257,17 @@ Simulation::run(const Method &method, Instanc &model){
 	importhandler_setsharedpointer("sim",NULL);
 	//CONSOLE_DEBUG("Cleared shared pointer 'sim'");
 
+	// bring the system, if it's been built, up to date with what the method
+	// did: system_rebuild only refreshes the flags, unless the instance tree
+	// has been changed by the compiler in the meantime.
+	if(sys){
+		sys = system_rebuild(sys);
+		if(!sys){
+			ERROR_REPORTER_HERE(ASC_PROG_ERR,"Failed to rebuild system");
+			throw runtime_error("Unable to rebuild system after running method");
+		}
+	}
+
 	if(pe == Proc_all_ok){
 		if(haserror){
 			ERROR_REPORTER_NOLINE(ASC_PROG_ERR,"Method '%s' had error(s).",method.getName());
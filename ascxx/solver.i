@@ -11,6 +11,7 @@
 #include "config.h"
 #include "integrator.h"
 #include "integratorreporter.h"
+#include "observationfile.h"
 #include "solver.h"
 #include "incidencematrix.h"
 #include "solverparameter.h"
@@ -312,6 +313,8 @@ public:
 %ignore ascxx_integratorreporter_close;
 %include "integratorreporter.h"
 
+%include "observationfile.h"
+
 %feature("director") SolverHooks;
 %ignore ascxx_slvreq_set_solver;
 %ignore ascxx_slvreq_set_option;
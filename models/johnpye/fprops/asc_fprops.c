@@ -45,6 +45,7 @@
 #include "solve_ph.h"
 #include "thcond.h"
 #include "visc.h"
+#include "table.h"
 
 /* for the moment, species data are defined in C code, we'll implement something
 better later on, hopefully. */
@@ -84,10 +85,11 @@ ExtBBoxFunc fprops_Tvsx_ph_calc;
 */
 
 /* place to store symbols needed for accessing ASCEND's instance tree */
-static symchar *fprops_symbols[3];
+static symchar *fprops_symbols[4];
 #define COMPONENT_SYM fprops_symbols[0]
 #define TYPE_SYM fprops_symbols[1]
 #define SOURCE_SYM fprops_symbols[2]
+#define TABLE_SYM fprops_symbols[3]
 
 static const char *fprops_p_help = "Calculate pressure from temperature and density, using FPROPS";
 static const char *fprops_u_help = "Calculate specific internal energy from temperature and density, using FPROPS";
@@ -169,17 +171,23 @@ ASC_EXPORT int fprops_register(){
 /**
    'fprops_prepare' just gets the data member and checks that it's
 	valid, and stores it in the blackbox data field.
+
+	If the DATA has a symbol_constant 'table', the fluid is given a property
+	table (see table.h) for faster evaluation of the states it covers. The
+	value of 'table' is the file the table is read from, or built and saved
+	to if that can't be done; '' builds the table without saving it.
 */
 int asc_fprops_prepare(struct BBoxInterp *bbox,
 	   struct Instance *data,
 	   struct gl_list_t *arglist
 ){
-	struct Instance *compinst, *typeinst, *srcinst;
-	const char *comp, *type = NULL, *src = NULL;
+	struct Instance *compinst, *typeinst, *srcinst, *tableinst;
+	const char *comp, *type = NULL, *src = NULL, *table = NULL;
 
 	fprops_symbols[0] = AddSymbol("component");
 	fprops_symbols[1] = AddSymbol("type");
 	fprops_symbols[2] = AddSymbol("source");
+	fprops_symbols[3] = AddSymbol("table");
 
 	/* get the component name */
 	compinst = ChildByChar(data,COMPONENT_SYM);
@@ -223,12 +231,35 @@ int asc_fprops_prepare(struct BBoxInterp *bbox,
 		if(src && strlen(src)==0)src = NULL;
 	}
 
+	/* get the property table file, if a table is wanted */
+	tableinst = ChildByChar(data,TABLE_SYM);
+	if(tableinst){
+		if(InstanceKind(tableinst)!=SYMBOL_CONSTANT_INST){
+			ERROR_REPORTER_HERE(ASC_USER_ERROR,"DATA member 'table' must be a symbol_constant");
+			return 1;
+		}
+		table = SCP(SYMC_INST(tableinst)->value);
+		if(table && strlen(table)==0)table = NULL;
+	}
+
 	bbox->user_data = (void *)fprops_fluid(comp,type,src);
 	if(bbox->user_data == NULL){
 		ERROR_REPORTER_HERE(ASC_USER_ERROR,"Component name/type was not recognised. Check the source-code for for the supported species.");
 		return 1;
 	}
 
+	if(tableinst){
+		FpropsError err = FPROPS_NO_ERROR;
+		/* fprops_fluid made this copy of the fluid for us */
+		fprops_table_use((PureFluid *)bbox->user_data, NULL, table, &err);
+		if(err){
+			ERROR_REPORTER_HERE(ASC_USER_WARNING,"Unable to set up a property table for '%s' (%s),"
+				" so it will be evaluated from the equation of state throughout."
+				,comp,fprops_error(err)
+			);
+		}
+	}
+
 #ifdef ASC_FPROPS_DEBUG
 	ERROR_REPORTER_HERE(ASC_PROG_NOTE,"Prepared component '%s'%s%s%s OK.\n"
 		,comp
@@ -280,7 +311,8 @@ int fprops_p_calc(struct BBoxInterp *bbox,
 		outputs[0] = fprops_p(S, &err);
 	}else{
 		//ERROR_REPORTER_HERE(ASC_USER_NOTE,"JACOBIAN CALCULATION FOR P!\n");
-		FluidState S = fprops_set_Trho(inputs[0],inputs[1], FLUID, &err);
+		FluidStateCache C;
+		FluidState S = fprops_set_Trho_cached(inputs[0],inputs[1], FLUID, &C, &err);
 		jacobian[0*1+0] = fprops_dpdT_rho(S, &err);
 		jacobian[0*1+1] = fprops_dpdrho_T(S, &err);
 	}
@@ -301,12 +333,15 @@ int fprops_u_calc(struct BBoxInterp *bbox,
 		double *jacobian
 ){
 	CALCPREPARE(2,1);
-	FluidState S = fprops_set_Trho(inputs[0], inputs[1], FLUID, &err);
+	FluidStateCache C;
+	FluidState S;
 
 	/* first input is temperature, second is density */
 	if(bbox->task == bb_func_eval){
+		S = fprops_set_Trho(inputs[0], inputs[1], FLUID, &err);
 		outputs[0] = fprops_u(S, &err);
 	}else{
+		S = fprops_set_Trho_cached(inputs[0], inputs[1], FLUID, &C, &err);
 		jacobian[0*1+0] = fprops_dudT_rho(S, &err);
 		jacobian[0*1+1] = fprops_dudrho_T(S, &err);
 	}
@@ -348,12 +383,15 @@ int fprops_h_calc(struct BBoxInterp *bbox,
 		double *jacobian
 ){
 	CALCPREPARE(2,1);
-	FluidState S = fprops_set_Trho(inputs[0], inputs[1], FLUID, &err);
+	FluidStateCache C;
+	FluidState S;
 
 	/* first input is temperature, second is density */
 	if(bbox->task == bb_func_eval){
+		S = fprops_set_Trho(inputs[0], inputs[1], FLUID, &err);
 		outputs[0] = fprops_h(S, &err);
 	}else{
+		S = fprops_set_Trho_cached(inputs[0], inputs[1], FLUID, &C, &err);
 		//ERROR_REPORTER_HERE(ASC_USER_NOTE,"JACOBIAN CALCULATION FOR P!\n");
 		jacobian[0*1+0] = fprops_dhdT_rho(S, &err);
 		jacobian[0*1+1] = fprops_dhdrho_T(S, &err);
@@ -532,10 +570,11 @@ int fprops_phsx_vT_calc(struct BBoxInterp *bbox,
 			double vf = 1./rho_f;
 			double vg = 1./rho_g;
 			double x = (inputs[0] - vf)  /(vg - vf);
-			FluidState Sf = fprops_set_Trho(T, rho_f, FLUID, &err);
+			FluidStateCache Cf, Cg;
+			FluidState Sf = fprops_set_Trho_cached(T, rho_f, FLUID, &Cf, &err);
 			double sf = fprops_s(Sf, &err);
 			double hf = fprops_h(Sf, &err);
-			FluidState Sg = fprops_set_Trho(T, rho_g, FLUID, &err);
+			FluidState Sg = fprops_set_Trho_cached(T, rho_g, FLUID, &Cg, &err);
 			double sg = fprops_s(Sg, &err);
 			double hg = fprops_h(Sg, &err);
 			outputs[0] = p_sat;
@@ -548,7 +587,8 @@ int fprops_phsx_vT_calc(struct BBoxInterp *bbox,
 	}
 
 	/* non-saturated */
-	FluidState S = fprops_set_Trho(T, rho, FLUID, &err);
+	FluidStateCache C;
+	FluidState S = fprops_set_Trho_cached(T, rho, FLUID, &C, &err);
 	outputs[0] = fprops_p(S, &err);
 	outputs[1] = fprops_h(S, &err);
 	outputs[2] = fprops_s(S, &err);
@@ -625,8 +665,9 @@ int fprops_Tvsx_ph_calc(struct BBoxInterp *bbox,
 			return 8;
 		}
 		
-		FluidState Sf = fprops_set_Trho(T_sat,rho_f,FLUID,&err);
-		FluidState Sg = fprops_set_Trho(T_sat,rho_g,FLUID,&err);
+		FluidStateCache Cf, Cg;
+		FluidState Sf = fprops_set_Trho_cached(T_sat,rho_f,FLUID,&Cf,&err);
+		FluidState Sg = fprops_set_Trho_cached(T_sat,rho_g,FLUID,&Cg,&err);
 		double hf = fprops_h(Sf, &err);
 		double hg = fprops_h(Sg, &err);
 
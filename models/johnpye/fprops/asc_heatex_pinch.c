@@ -226,24 +226,43 @@ int heatex_calc(struct BBoxInterp *bbox,
 	//CONSOLE_DEBUG("hot: p = %f bar, h = %f kJ/kg, mdot = %f kg/s",hot.p/1e5, hot.h/1e3, hot.mdot);
 	//CONSOLE_DEBUG("cold: p = %f bar, h = %f kJ/kg, mdot = %f kg/s",cold.p/1e5, cold.h/1e3, cold.mdot);
 
-	double Th,Tc,rhoh,rhoc;
-	/* loop from i=0 (cold inlet) to i=n (cold outlet) */
+	/* points from i=0 (cold inlet) to i=n (cold outlet), solved together for
+	each side with fprops_solve_ph_batch, which shares the saturation state
+	and evaluates the EOS for all the points at once */
+	double *ph = ASC_NEW_ARRAY(double, 6*(n+1));
+	double *pc = ph + (n+1), *hh = ph + 2*(n+1), *hc = ph + 3*(n+1);
+	double *Th = ph + 4*(n+1), *Tc = ph + 5*(n+1);
+	double *rho = ASC_NEW_ARRAY(double, n+1);
+	FpropsError *errh = ASC_NEW_ARRAY(FpropsError, 2*(n+1));
+	FpropsError *errc = errh + (n+1);
+	if(ph == NULL || rho == NULL || errh == NULL){
+		if(ph)ASC_FREE(ph);
+		if(rho)ASC_FREE(rho);
+		if(errh)ASC_FREE(errh);
+		return -6;
+	}
+	for(i=0;i<=n;++i){
+		ph[i] = hot.p;
+		pc[i] = cold.p;
+		hh[i] = hot.h - Q/hot.mdot*(n-i)/n;
+		hc[i] = cold.h + Q/cold.mdot*i/n;
+	}
+	/* FIXME make use of guess values? */
+	fprops_solve_ph_batch(n+1, ph, hh, Th, rho, 0, heatex_data->comp[1], errh);
+	fprops_solve_ph_batch(n+1, pc, hc, Tc, rho, 0, heatex_data->comp[0], errc);
 	for(i=0;i<=n;++i){
-		double hh = hot.h - Q/hot.mdot*(n-i)/n;
-		double hc = cold.h + Q/cold.mdot*i/n;
-		FpropsError err = FPROPS_NO_ERROR;
-		/* FIXME make use of guess values? */
-		fprops_solve_ph(hot.p, hh, &Th, &rhoh, 0, heatex_data->comp[1], &err);
-		if(err){
+		if(errh[i]){
 			/* error solving (p,h) hotside */
 		}
-		fprops_solve_ph(cold.p, hc, &Tc, &rhoc, 0, heatex_data->comp[0], &err);
-		if(err){
+		if(errc[i]){
 			/* error solving (p,h) coldside */
 		}
-		double DT = Th - Tc;
+		double DT = Th[i] - Tc[i];
 		if(DT<DT_min)DT_min = DT;
 	}
+	ASC_FREE(ph);
+	ASC_FREE(rho);
+	ASC_FREE(errh);
 
 	//CONSOLE_DEBUG("DT = %f K",DT_min);
 
@@ -350,3 +350,49 @@ double ideal_phi_tautau(double tau, const Phi0RunData *data){
 #endif
 	return -sum/SQ(tau);
 }
+
+/**
+	All of the above at once: each pow and exp is evaluated once and shared by
+	phi0 and its two tau derivatives.
+*/
+void ideal_phi_all(double tau, double delta, const Phi0RunData *data
+	, double *phi, double *phi_tau, double *phi_tautau
+){
+	const Phi0RunPowTerm *pt;
+	const Phi0RunExpTerm *et;
+	unsigned i;
+
+	double sum = log(delta) + data->c + data->m * tau;
+	double sum_t = data->m;
+	double sum_tt = 0;
+	double term;
+
+	/* power terms */
+	pt = &(data->pt[0]);
+	for(i = 0; i<data->np; ++i, ++pt){
+		if(pt->p == 0){
+			sum += pt->a * log(tau);
+			sum_t += pt->a / tau;
+			sum_tt -= pt->a / SQ(tau);
+		}else{
+			term = pt->a * pow(tau, pt->p);
+			sum += term;
+			sum_t += pt->p * term / tau;
+			sum_tt += pt->p * (pt->p - 1) * term / SQ(tau);
+		}
+	}
+
+	/* Planck-Einstein terms */
+	et = &(data->et[0]);
+	for(i=0; i<data->ne; ++i, ++et){
+		double e = exp(-et->gamma * tau);
+		sum += et->n * log(1 - e);
+		term = et->n * et->gamma * e / (1 - e);
+		sum_t += term;
+		sum_tt -= term * et->gamma / (1 - e);
+	}
+
+	*phi = sum;
+	*phi_tau = sum_t;
+	*phi_tautau = sum_tt;
+}
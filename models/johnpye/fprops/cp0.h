@@ -54,5 +54,12 @@ double ideal_phi_tau(double tau, double delta, const Phi0RunData *data);
 */
 double ideal_phi_tautau(double tau, const Phi0RunData *data);
 
+/**
+	ideal_phi, ideal_phi_tau and ideal_phi_tautau together, in one pass over
+	the terms.
+*/
+void ideal_phi_all(double tau, double delta, const Phi0RunData *data
+	, double *phi, double *phi_tau, double *phi_tautau);
+
 #endif
 
@@ -3,6 +3,8 @@
 #include "fprops.h"
 #include "helmholtz.h"
 #include "pengrob.h"
+#include "table.h"
+#include "satcurve.h"
 
 #include <string.h>
 #include <stdio.h>
@@ -88,6 +90,9 @@ const PureFluid *fprops_get_fluid(int i){
 
 void fprops_fluid_destroy(PureFluid *P){
 	MSG("Freeing data for lfuid '%s'",P->name);
+	fprops_table_release(P);
+	fprops_satcurve_destroy(P->satcurve);
+	P->satcurve = NULL;
 	switch(P->type){
 	case FPROPS_HELMHOLTZ:
 		helmholtz_destroy(P);
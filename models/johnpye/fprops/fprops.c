@@ -35,6 +35,8 @@
 #include "pengrob.h"
 #include "visc.h"
 #include "thcond.h"
+#include "table.h"
+#include "satcurve.h"
 //#include "mbwr.h"
 
 //#define FPR_DEBUG
@@ -115,6 +117,9 @@ PureFluid *fprops_prepare(const EosData *E,const char *corrtype){
 	}
 	/* next: add preparation of viscosity, thermal conductivity, surface tension, ... */
 
+	MSG("Fitting the saturation curve...");
+	P->satcurve = fprops_satcurve_build(P);
+
 	MSG("Preparing viscosity data...");
 	P->visc = visc_prepare(E,P,&err);
 	if(err){
@@ -136,11 +141,103 @@ PureFluid *fprops_prepare(const EosData *E,const char *corrtype){
 	return P;
 }
 
+/*
+	Everything that fprops_set_Trho_cached does but the Helmholtz derivatives,
+	which are left to the caller (one state at a time, or a batch at a time).
+	@return non-zero if C->derivs should be filled in for (T,rho).
+*/
+static int fprops_set_Trho_nonderivs(double T, double rho, const PureFluid *fluid, FluidStateCache *C){
+	int twophase = 0;
+
+	C->T = T;
+	C->rho = rho;
+	C->sat_err = FPROPS_NO_ERROR;
+	C->have_derivs = 0;
+	C->have_table = 0;
+	/* a saturation error is kept until a property is asked for, as before */
+	if(T >= fluid->data->T_t && T < fluid->data->T_c){
+		fprops_sat_T(T, &(C->psat), &(C->rhof), &(C->rhog), fluid, &(C->sat_err));
+		twophase = (C->rhog < rho && rho < C->rhof);
+	}
+	if(fluid->table && !C->sat_err
+		&& !fprops_table_Trho(fluid->table, T, rho, &(C->p), &(C->h), &(C->s))
+	){
+		C->u = C->h - C->p / rho;
+		C->have_table = 1;
+		return 0;
+	}
+	return fluid->type == FPROPS_HELMHOLTZ && !C->sat_err && !twophase;
+}
+
 FluidState fprops_set_Trho(double T, double rho, const PureFluid *fluid, FpropsError *err){
 	FluidState state = {T,rho,fluid};
 	return state;
 }
 
+FluidState fprops_set_Trho_cached(double T, double rho, const PureFluid *fluid, FluidStateCache *C, FpropsError *err){
+	FluidState state = {T,rho,fluid,C};
+
+	if(fprops_set_Trho_nonderivs(T, rho, fluid, C)){
+		helmholtz_derivs(T, rho, fluid->data, &(C->derivs));
+		C->have_derivs = 1;
+	}
+	return state;
+}
+
+/* number of states for which fprops_set_Trho_batch evaluates the derivatives together */
+#define SET_TRHO_BATCH 64
+
+void fprops_set_Trho_batch(unsigned n, const double *T, const double *rho, const PureFluid *fluid, FluidState *S, FluidStateCache *C, FpropsError *err){
+	double Tb[SET_TRHO_BATCH], rhob[SET_TRHO_BATCH];
+	HelmholtzDerivs D[SET_TRHO_BATCH];
+	unsigned idx[SET_TRHO_BATCH];
+	unsigned i, j, m = 0;
+
+	for(i=0; i<n; ++i){
+		FluidState s0 = {T[i],rho[i],fluid,C + i};
+		S[i] = s0;
+		if(fprops_set_Trho_nonderivs(T[i], rho[i], fluid, C + i)){
+			idx[m] = i;
+			Tb[m] = T[i];
+			rhob[m] = rho[i];
+			m++;
+		}
+		if(m == SET_TRHO_BATCH || (i == n - 1 && m)){
+			helmholtz_derivs_batch(m, Tb, rhob, fluid->data, D);
+			for(j=0; j<m; ++j){
+				C[idx[j]].derivs = D[j];
+				C[idx[j]].have_derivs = 1;
+			}
+			m = 0;
+		}
+	}
+}
+
+/* is the cache of S for S's current T and rho? */
+#define CACHED(S) ((S).cache && (S).cache->T == (S).T && (S).cache->rho == (S).rho)
+#define HAVE_DERIVS(S) (CACHED(S) && (S).cache->have_derivs)
+#define HAVE_TABLE(S) (CACHED(S) && (S).cache->have_table)
+
+/**
+	Saturation state at the temperature of S, from the cache if possible.
+	@return 1 if T_t <= T < T_c, in which case p, rho_f, rho_g are set (or
+	else *err is), 0 otherwise.
+*/
+static int fprops_state_sat(const FluidState *S, double *p, double *rho_f, double *rho_g, FpropsError *err){
+	if(S->T >= S->fluid->data->T_t && S->T < S->fluid->data->T_c){
+		if(CACHED(*S)){
+			*p = S->cache->psat;
+			*rho_f = S->cache->rhof;
+			*rho_g = S->cache->rhog;
+			if(S->cache->sat_err)*err = S->cache->sat_err;
+		}else{
+			fprops_sat_T(S->T, p, rho_f, rho_g, S->fluid, err);
+		}
+		return 1;
+	}
+	return 0;
+}
+
 // FIXME XXX not all properties are mass-weighted in the saturation region...
 
 /*
@@ -151,11 +248,12 @@ FluidState fprops_set_Trho(double T, double rho, const PureFluid *fluid, FpropsE
 	Also sublimation curve needs to be added.
 */
 
-#define EVALFN(VAR) \
+/* PRE is a statement that may return the value early */
+#define EVALFN_PRE(VAR,PRE) \
 	double fprops_##VAR(FluidState state, FpropsError *err){\
 		double p, rho_f, rho_g;\
-		if(state.T >= state.fluid->data->T_t && state.T < state.fluid->data->T_c){\
-			fprops_sat_T(state.T, &p, &rho_f, &rho_g, state.fluid, err);\
+		PRE\
+		if(fprops_state_sat(&state, &p, &rho_f, &rho_g, err)){\
 			if(*err){\
 				MSG("Got error %d from saturation calc in %s\n",*err,__func__);\
 				/*return state.fluid->VAR##_fn(state.fluid->data->T_c,state.fluid->data->rho_c,state.fluid->data,err);*/\
@@ -168,14 +266,28 @@ FluidState fprops_set_Trho(double T, double rho, const PureFluid *fluid, FpropsE
 				return x*Qg + (1-x)*Qf;\
 			}\
 		}\
+		if(HAVE_DERIVS(state)){\
+			return helmholtz_##VAR##_derivs(&(state.cache->derivs),state.fluid->data,err);\
+		}\
 		return state.fluid->VAR##_fn(state.T,state.rho,state.fluid->data,err);\
 	}
 
+#define EVALFN(VAR) EVALFN_PRE(VAR,)
+
+/* properties that the property table provides */
+#define EVALFN_TABLE(VAR) EVALFN_PRE(VAR,\
+	if(HAVE_TABLE(state))return state.cache->VAR;\
+	if(state.fluid->table && !CACHED(state)){\
+		/* the table is looked up with the rest of the cache */\
+		FluidStateCache C;\
+		return fprops_##VAR(fprops_set_Trho_cached(state.T,state.rho,state.fluid,&C,err),err);\
+	}\
+)
+
 #define EVALFN_SATUNDEFINED(VAR) \
 	double fprops_##VAR(FluidState state, FpropsError *err){\
 		double p, rho_f, rho_g;\
-		if(state.T >= state.fluid->data->T_t && state.T < state.fluid->data->T_c){\
-			fprops_sat_T(state.T, &p, &rho_f, &rho_g, state.fluid, err);\
+		if(fprops_state_sat(&state, &p, &rho_f, &rho_g, err)){\
 			if(*err){\
 				MSG("Got error %d from sat calc in %s\n",*err,__func__);\
 				return state.fluid->data->rho_c;\
@@ -184,15 +296,53 @@ FluidState fprops_set_Trho(double T, double rho, const PureFluid *fluid, FpropsE
 				*err = FPROPS_VALUE_UNDEFINED;\
 			}\
 		}\
+		if(HAVE_DERIVS(state)){\
+			return helmholtz_##VAR##_derivs(&(state.cache->derivs),state.fluid->data,err);\
+		}\
 		return state.fluid->VAR##_fn(state.T,state.rho,state.fluid->data,err);\
 	}
 
-EVALFN(p); EVALFN(u); EVALFN(h); EVALFN(s); EVALFN(a); EVALFN(g);
+/*
+	Partial derivatives, so far only available for single-phase states of
+	Helmholtz fluids, from the derivatives cached by fprops_set_Trho_cached,
+	which is called here for states that don't have a cache yet.
+*/
+#define EVALFN_DERIVS(VAR) \
+	double fprops_##VAR(FluidState state, FpropsError *err){\
+		FluidStateCache C;\
+		if(!CACHED(state)){\
+			state = fprops_set_Trho_cached(state.T,state.rho,state.fluid,&C,err);\
+		}\
+		if(HAVE_DERIVS(state)){\
+			return helmholtz_##VAR##_derivs(&(state.cache->derivs),state.fluid->data,err);\
+		}\
+		*err = FPROPS_NOT_IMPLEMENTED;\
+		return 0;\
+	}
+
+EVALFN_TABLE(p); EVALFN_TABLE(u); EVALFN_TABLE(h); EVALFN_TABLE(s);
+EVALFN(a); EVALFN(g);
 EVALFN_SATUNDEFINED(cp); EVALFN_SATUNDEFINED(cv);
 EVALFN_SATUNDEFINED(w);
 EVALFN(dpdrho_T);
 
 EVALFN(alphap); EVALFN(betap);
+EVALFN_DERIVS(dpdT_rho);
+EVALFN_DERIVS(dhdT_rho); EVALFN_DERIVS(dhdrho_T);
+EVALFN_DERIVS(dudT_rho); EVALFN_DERIVS(dudrho_T);
+#define EVALFN_BATCH(VAR) \
+	void fprops_##VAR##_batch(unsigned n, const FluidState *S, double *VAR, FpropsError *err){\
+		unsigned i;\
+		for(i=0; i<n; ++i){\
+			err[i] = FPROPS_NO_ERROR;\
+			VAR[i] = fprops_##VAR(S[i], err + i);\
+		}\
+	}
+
+EVALFN_BATCH(p); EVALFN_BATCH(u); EVALFN_BATCH(h); EVALFN_BATCH(s);
+EVALFN_BATCH(a); EVALFN_BATCH(g);
+EVALFN_BATCH(cp); EVALFN_BATCH(cv); EVALFN_BATCH(w);
+
 // EVALFN(dpdT_rho);
 //EVALFN(dpdrho_T); EVALFN(d2pdrho2_T); EVALFN(dhdT_rho); EVALFN(dhdrho_T);
 //EVALFN(dudT_rho); EVALFN(dudrho)T);
@@ -243,8 +393,7 @@ double fprops_cp0(FluidState state, FpropsError *err){
 
 double fprops_x(FluidState state, FpropsError *err){
 	double p, rho_f, rho_g;
-	if(state.T >= state.fluid->data->T_t && state.T < state.fluid->data->T_c){
-		fprops_sat_T(state.T, &p, &rho_f, &rho_g, state.fluid, err);
+	if(fprops_state_sat(&state, &p, &rho_f, &rho_g, err)){
 		if(*err)return 0;
 		if(state.rho > rho_f)return 0;
 		if(state.rho < rho_g)return 1;
@@ -255,34 +404,12 @@ double fprops_x(FluidState state, FpropsError *err){
 	return 0;
 }
 
-double fprops_dpdT_rho(FluidState state, FpropsError *err){
-	*err = FPROPS_NOT_IMPLEMENTED;
-	return 0;
-}
 
 double fprops_d2pdrho2_T(FluidState state, FpropsError *err){
 	*err = FPROPS_NOT_IMPLEMENTED;
 	return 0;
 }
 
-double fprops_dhdT_rho(FluidState state, FpropsError *err){
-	*err = FPROPS_NOT_IMPLEMENTED;
-	return 0;
-}
-
-double fprops_dhdrho_T(FluidState state, FpropsError *err){
-	*err = FPROPS_NOT_IMPLEMENTED;
-	return 0;
-}
-
-double fprops_dudT_rho(FluidState state, FpropsError *err){
-	*err = FPROPS_NOT_IMPLEMENTED;
-	return 0;
-}
-double fprops_dudrho_T(FluidState state, FpropsError *err){
-	*err = FPROPS_NOT_IMPLEMENTED;
-	return 0;
-}
 
 char *fprops_error(FpropsError err){
 	switch (err) {
@@ -23,14 +23,37 @@
 
 #include "rundata.h"
 
+/**
+	Work done once by fprops_set_Trho_cached so that each property then
+	evaluated for the same state doesn't repeat it: the saturation state at T, which every
+	property needs in order to tell whether the state is two-phase, and for a
+	single-phase state of a Helmholtz fluid, the derivatives of the reduced
+	Helmholtz energy, from which all its properties follow. If the fluid has
+	a property table (see table.h) covering the state, p, u, h and s are
+	taken from that instead, and the other properties from the EOS.
+
+	The cache records the T and rho it was filled for. If those of the state
+	are changed afterwards, the cache is ignored and properties are calculated
+	in full as before. Note that it is not updated if the fluid's reference
+	state is changed.
+*/
+typedef struct FluidStateCache_struct{
+	double T, rho;        ///< state for which the cache was filled (T = 0 if empty)
+	FpropsError sat_err;  ///< error from the saturation calculation, if any
+	double psat, rhof, rhog; ///< saturation state, if T_t <= T < T_c
+	int have_derivs;      ///< non-zero if 'derivs' has been filled in
+	HelmholtzDerivs derivs;
+	int have_table;       ///< non-zero if p, u, h, s are from the property table
+	double p, u, h, s;
+} FluidStateCache;
+
 /**
 	State object for FPROPS. This struct allows user-friendly API in a similar
 	way to in freesteam, but supports different fluid types and correlations,
 	and might be extensible to support fluid mixtures.
 
-	TODO if we've got a saturated state then we almost certainly have calculated
-	rhof, rhog, p. They're expensive, so we should save them in this state
-	struct, too, or else find some other way to cache them.
+	Create states with fprops_set_Trho, or with fprops_set_Trho_cached if
+	several properties or partial derivatives of the same state are wanted.
 
 	TODO perhaps eventually we can different different correlations using
 	different independent variables, in which case this state could be modified/
@@ -40,10 +63,28 @@ typedef struct FluidState_struct{
 	double T; ///< temperature / K
 	double rho; ///< density / kg/m3
 	const PureFluid *fluid; ///< pointer to fluid description and associated functions
+	const FluidStateCache *cache; ///< NULL, or see fprops_set_Trho_cached
 } FluidState;
 
 FluidState fprops_set_Trho(double T, double rho, const PureFluid *fluid, FpropsError *err);
 
+/**
+	As fprops_set_Trho, but also fills in *C (see FluidStateCache) and points
+	the state at it, so that *C must outlast the state. Filling the cache costs
+	about as much as two or three properties, so this only pays off if more
+	than one property or partial derivative of the state is needed.
+*/
+FluidState fprops_set_Trho_cached(double T, double rho, const PureFluid *fluid, FluidStateCache *C, FpropsError *err);
+
+/**
+	fprops_set_Trho_cached for n states at once: S[i] is set to (T[i],rho[i])
+	with the cache C[i]. The Helmholtz derivatives of the single-phase states
+	are evaluated together, with the loops over the correlation terms outside
+	the loops over the states (see helmholtz_derivs_batch), which is quicker
+	than one state at a time when there are more than a few of them.
+*/
+void fprops_set_Trho_batch(unsigned n, const double *T, const double *rho, const PureFluid *fluid, FluidState *S, FluidStateCache *C, FpropsError *err);
+
 /* TODO we need to add a way to specify what fluid correlation is desired
 and also what reference state, as another option. */
 
@@ -87,6 +128,21 @@ double fprops_dudrho_T(const FluidState state, FpropsError *err);
 #endif
 
 
+/*
+	Properties of n states, VAR[i] = fprops_VAR(S[i], &err[i]), where err[i]
+	is cleared first. With states from fprops_set_Trho_batch, these only
+	combine the cached derivatives.
+*/
+void fprops_p_batch(unsigned n, const FluidState *S, double *p, FpropsError *err);
+void fprops_u_batch(unsigned n, const FluidState *S, double *u, FpropsError *err);
+void fprops_h_batch(unsigned n, const FluidState *S, double *h, FpropsError *err);
+void fprops_s_batch(unsigned n, const FluidState *S, double *s, FpropsError *err);
+void fprops_a_batch(unsigned n, const FluidState *S, double *a, FpropsError *err);
+void fprops_g_batch(unsigned n, const FluidState *S, double *g, FpropsError *err);
+void fprops_cp_batch(unsigned n, const FluidState *S, double *cp, FpropsError *err);
+void fprops_cv_batch(unsigned n, const FluidState *S, double *cv, FpropsError *err);
+void fprops_w_batch(unsigned n, const FluidState *S, double *w, FpropsError *err);
+
 double fprops_mu(FluidState state, FpropsError *err); ///< Dynamic viscosity / [Pa*s]
 double fprops_lam(FluidState state, FpropsError *err); ///< Thermal conductivity / [W/m/K]
 
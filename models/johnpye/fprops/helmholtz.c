@@ -94,6 +94,9 @@ double helmholtz_dudrho_T(double T, double rho, const FluidData *data, FpropsErr
 
 #define SQ(X) ((X)*(X))
 
+/* number of states that the batch functions work on at a time */
+#define HELM_BATCH 64
+
 #include "helmholtz_impl.h"
 
 /* shortcut take us straight into the correct data structure for Helmholtz correlation calculations */
@@ -125,6 +128,8 @@ PureFluid *helmholtz_prepare(const EosData *E, const ReferenceState *ref){
 	P->name = E->name;
 	P->source = E->source;
 	P->type = E->type;
+	P->table = NULL;
+	P->satcurve = NULL;
 	MSG("name = %s",P->name);
 
 	/* common data across all correlation types */
@@ -207,6 +212,174 @@ void helmholtz_destroy(PureFluid *P){
 	FPROPS_FREE(P);
 }
 
+/*----------------------------------------------------------------------------
+  PROPERTIES FROM THE DERIVATIVES
+*/
+
+/**
+	Evaluate phi0 and phir, with all their first and second derivatives, at
+	temperature T and mass density rho. This is the expensive part of any
+	property calculation, and it is the same for all of them: to get several
+	properties of the one state, call this once and then the
+	helmholtz_*_derivs functions below. (The helmholtz_p etc. functions
+	further down sum only the derivatives that their one property needs,
+	and are still the quicker way to get a single property.)
+*/
+void helmholtz_derivs(double T, double rho, const FluidData *data, HelmholtzDerivs *D){
+	DEFINE_TD;
+
+	assert(HD->rho_star!=0);
+	assert(T!=0);
+	assert(!isnan(T));
+	assert(!isnan(rho));
+
+	D->T = T;
+	D->rho = rho;
+	D->tau = tau;
+	D->delta = delta;
+	ideal_phi_all(tau,delta,HD_CP0,&D->phi0,&D->phi0_tau,&D->phi0_tautau);
+	helm_resid_all(tau,delta,HD,D);
+}
+
+/**
+	helmholtz_derivs for n states at once: D[i] is evaluated at (T[i],rho[i]).
+	The residual part is done by helm_resid_all_batch.
+*/
+void helmholtz_derivs_batch(unsigned n, const double *T, const double *rho, const FluidData *data, HelmholtzDerivs *D){
+	double tau[HELM_BATCH], delta[HELM_BATCH];
+	unsigned j0, j, m;
+
+	assert(HD->rho_star!=0);
+
+	for(j0 = 0; j0 < n; j0 += m){
+		m = (n - j0 < HELM_BATCH) ? n - j0 : HELM_BATCH;
+		for(j=0; j<m; ++j){
+			HelmholtzDerivs *Dj = D + j0 + j;
+			assert(T[j0 + j]!=0);
+			tau[j] = HD->T_star / T[j0 + j];
+			delta[j] = rho[j0 + j] / HD->rho_star;
+			Dj->T = T[j0 + j];
+			Dj->rho = rho[j0 + j];
+			Dj->tau = tau[j];
+			Dj->delta = delta[j];
+			ideal_phi_all(tau[j],delta[j],HD_CP0,&Dj->phi0,&Dj->phi0_tau,&Dj->phi0_tautau);
+		}
+		helm_resid_all_batch(m, tau, delta, HD, D + j0);
+	}
+}
+
+/* shortcuts for the members of D */
+#define DT D->T
+#define DRHO D->rho
+#define DTAU D->tau
+#define DDEL D->delta
+
+/** pressure / Pa */
+double helmholtz_p_derivs(const HelmholtzDerivs *D, const FluidData *data, FpropsError *err){
+	double p = HD_R * DT * DRHO * (1 + DDEL * D->phir_del);
+	if(isnan(p))*err = FPROPS_NUMERIC_ERROR;
+	return p;
+}
+
+/** internal energy / J/kg */
+double helmholtz_u_derivs(const HelmholtzDerivs *D, const FluidData *data, FpropsError *err){
+	return HD_R * HD->T_star * (D->phi0_tau + D->phir_tau);
+}
+
+/** enthalpy / J/kg */
+double helmholtz_h_derivs(const HelmholtzDerivs *D, const FluidData *data, FpropsError *err){
+	return HD_R * DT * (1 + DTAU * (D->phi0_tau + D->phir_tau) + DDEL * D->phir_del);
+}
+
+/** entropy / J/kg/K */
+double helmholtz_s_derivs(const HelmholtzDerivs *D, const FluidData *data, FpropsError *err){
+	return HD_R * (DTAU * (D->phi0_tau + D->phir_tau) - (D->phi0 + D->phir));
+}
+
+/** Helmholtz energy / J/kg */
+double helmholtz_a_derivs(const HelmholtzDerivs *D, const FluidData *data, FpropsError *err){
+	return HD_R * DT * (D->phi0 + D->phir);
+}
+
+/** Gibbs energy / J/kg */
+double helmholtz_g_derivs(const HelmholtzDerivs *D, const FluidData *data, FpropsError *err){
+	return HD_R * DT * (D->phi0 + D->phir + 1. + DDEL * D->phir_del);
+}
+
+/** isochoric heat capacity / J/kg/K */
+double helmholtz_cv_derivs(const HelmholtzDerivs *D, const FluidData *data, FpropsError *err){
+	return - HD_R * SQ(DTAU) * (D->phi0_tautau + D->phir_tautau);
+}
+
+/*
+	Common parts of cp and w:
+	temp1 = (dp/drho)_T / (R T)
+	temp2 = (dp/dT)_rho / (R rho)
+	temp3 = cv / R
+*/
+#define DEFINE_TEMP123 \
+	double temp1 = 1. + 2.*DDEL*D->phir_del + SQ(DDEL)*D->phir_deldel; \
+	double temp2 = 1. + DDEL*D->phir_del - DDEL*DTAU*D->phir_deltau; \
+	double temp3 = -SQ(DTAU)*(D->phi0_tautau + D->phir_tautau)
+
+/** isobaric heat capacity / J/kg/K */
+double helmholtz_cp_derivs(const HelmholtzDerivs *D, const FluidData *data, FpropsError *err){
+	DEFINE_TEMP123;
+	return HD_R * (temp3 + SQ(temp2)/temp1);
+}
+
+/** speed of sound / m/s */
+double helmholtz_w_derivs(const HelmholtzDerivs *D, const FluidData *data, FpropsError *err){
+	DEFINE_TEMP123;
+	return sqrt(HD_R * DT * (temp1 + SQ(temp2)/temp3));
+}
+
+/** alpha_p, IAPWS Advisory Note 3 */
+double helmholtz_alphap_derivs(const HelmholtzDerivs *D, const FluidData *data, FpropsError *err){
+	return 1./DT * (1. - DDEL*DTAU*D->phir_deltau/(1 + DDEL*D->phir_del));
+}
+
+/** beta_p, IAPWS Advisory Note 3 */
+double helmholtz_betap_derivs(const HelmholtzDerivs *D, const FluidData *data, FpropsError *err){
+	return DRHO*(1. + (DDEL*D->phir_del + SQ(DDEL)*D->phir_deldel)/(1 + DDEL*D->phir_del));
+}
+
+/** (dp/dT)_rho */
+double helmholtz_dpdT_rho_derivs(const HelmholtzDerivs *D, const FluidData *data, FpropsError *err){
+	return HD_R * DRHO * (1 + DDEL*D->phir_del - DDEL*DTAU*D->phir_deltau);
+}
+
+/** (dp/drho)_T */
+double helmholtz_dpdrho_T_derivs(const HelmholtzDerivs *D, const FluidData *data, FpropsError *err){
+	return HD_R * DT * (1 + 2*DDEL*D->phir_del + SQ(DDEL)*D->phir_deldel);
+}
+
+/** (dh/dT)_rho */
+double helmholtz_dhdT_rho_derivs(const HelmholtzDerivs *D, const FluidData *data, FpropsError *err){
+	return HD_R * (1. + DDEL*D->phir_del - SQ(DTAU)*(D->phi0_tautau + D->phir_tautau) - DDEL*DTAU*D->phir_deltau);
+}
+
+/** (dh/drho)_T */
+double helmholtz_dhdrho_T_derivs(const HelmholtzDerivs *D, const FluidData *data, FpropsError *err){
+	return HD_R * DT / DRHO * (DTAU*DDEL*D->phir_deltau + DDEL*D->phir_del + SQ(DDEL)*D->phir_deldel);
+}
+
+/** (du/dT)_rho */
+double helmholtz_dudT_rho_derivs(const HelmholtzDerivs *D, const FluidData *data, FpropsError *err){
+	return -HD_R * SQ(DTAU) * (D->phi0_tautau + D->phir_tautau);
+}
+
+/** (du/drho)_T */
+double helmholtz_dudrho_T_derivs(const HelmholtzDerivs *D, const FluidData *data, FpropsError *err){
+	return HD_R * DT / DRHO * (DTAU * DDEL * D->phir_deltau);
+}
+
+#undef DEFINE_TEMP123
+#undef DT
+#undef DRHO
+#undef DTAU
+#undef DDEL
+
 /**
 	Function to calculate pressure from Helmholtz free energy EOS, given temperature
 	and mass density.
@@ -572,6 +745,73 @@ double helmholtz_dudrho_T(double T, double rho, const FluidData *data, FpropsErr
 }
 
 
+/*
+	Newton iterations on the saturation condition at T for rhof and rhog, from
+	the values passed in, taking 'gamma' times each step.
+	@return 1 if converged, in which case *psat is set
+*/
+static int helmholtz_sat_iterate(double T, double *rhof_io, double *rhog_io, double gamma, int maxit
+		, double *psat, const FluidData *data, FpropsError *err
+){
+	double rhof = *rhof_io, rhog = *rhog_io;
+	double R = data->R;
+	double pc = data->p_c;
+	int i = 0;
+	while(i++ < maxit){
+		assert(!isnan(rhog));
+		assert(!isnan(rhof));
+#ifdef SAT_DEBUG
+		MSG("iter %d: T = %f, rhof = %f, rhog = %f",i,T, rhof, rhog);
+#endif
+
+		/* one pass over the terms for each phase gives all we need */
+		HelmholtzDerivs Df, Dg;
+		helmholtz_derivs(T,rhof,data,&Df);
+		helmholtz_derivs(T,rhog,data,&Dg);
+		double pf = helmholtz_p_derivs(&Df,data,err);
+		double pg = helmholtz_p_derivs(&Dg,data,err);
+		double gf = helmholtz_a_derivs(&Df,data,err) + pf/rhof;
+		double gg = helmholtz_a_derivs(&Dg,data,err) + pg/rhog;
+		double dpdrf = helmholtz_dpdrho_T_derivs(&Df,data,err);
+		double dpdrg = helmholtz_dpdrho_T_derivs(&Dg,data,err);
+
+		// jacobian for [F;G](rhof, rhog) --- derivatives wrt rhof and rhog
+		double F = (pf - pg)/pc;
+		double G = (gf - gg)/R/T;
+
+		if(fabs(F) + fabs(G) < 1e-12){
+			//fprintf(stderr,"%s: CONVERGED\n",__func__);
+			*rhof_io = rhof;
+			*rhog_io = rhog;
+			*psat = pg;
+			return 1;
+		}
+
+		double Ff = dpdrf/pc;
+		double Fg = -dpdrg/pc;
+		//MSG("Ff = %e, Fg = %e",Ff,Fg);
+
+		double Gf = dpdrf/rhof/R/T;
+		double Gg = -dpdrg/rhog/R/T;
+		//MSG("Gf = %e, Gg = %e",Gf,Gg);
+
+		double DET = Ff*Gg - Fg*Gf;
+		//MSG("DET = %f",DET);
+
+		rhof += gamma/DET * (Fg*G - Gg*F);
+		rhog += gamma/DET * ( Gf*F - Ff*G);
+
+		assert(!isnan(rhof));
+		assert(!isnan(rhog));
+
+		if(rhog < 0)rhog = -0.5*rhog;
+		if(rhof < 0)rhof = -0.5*rhof;
+	}
+	*rhof_io = rhof;
+	*rhog_io = rhog;
+	return 0;
+}
+
 /**
 	Solve saturation condition for a specified temperature using approach of
 	Akasaka, but adapted for general use to non-helmholtz property correlations.
@@ -609,64 +849,20 @@ double helmholtz_sat(double T, double *rhof_out, double * rhog_out, const FluidD
 	// initial guesses for liquid and vapour density
 	double rhof = 1.1 * fprops_rhof_T_rackett(T,data);
 	double rhog= 0.9 * fprops_rhog_T_chouaieb(T,data);
-	double R = data->R;
-	double pc = data->p_c;
+	double psat;
 
 #ifdef SAT_DEBUG
 	MSG("initial guess rho_f = %f, rho_g = %f",rhof,rhog);
 	MSG("calculating at T = %.12e",T);
 #endif
 
-	int i = 0;
-	while(i++ < 200){
-		assert(!isnan(rhog));
-		assert(!isnan(rhof));
-#ifdef SAT_DEBUG
-		MSG("iter %d: T = %f, rhof = %f, rhog = %f",i,T, rhof, rhog);
-#endif
-
-		double pf = helmholtz_p(T,rhof,data,err);
-		double pg = helmholtz_p(T,rhog,data,err);
-		double gf = helmholtz_a(T,rhof,data,err) + pf/rhof;
-		double gg = helmholtz_a(T,rhog,data,err) + pg/rhog;
-		double dpdrf = helmholtz_dpdrho_T(T,rhof,data,err);
-		double dpdrg = helmholtz_dpdrho_T(T,rhog,data,err);
-
-		// jacobian for [F;G](rhof, rhog) --- derivatives wrt rhof and rhog
-		double F = (pf - pg)/pc;
-		double G = (gf - gg)/R/T;
-
-		if(fabs(F) + fabs(G) < 1e-12){
-			//fprintf(stderr,"%s: CONVERGED\n",__func__);
-			*rhof_out = rhof;
-			*rhog_out = rhog;
-			return helmholtz_p(T, *rhog_out, data, err);
-			/* SUCCESS */
-		}
-
-		double Ff = dpdrf/pc;
-		double Fg = -dpdrg/pc;
-		//MSG("Ff = %e, Fg = %e",Ff,Fg);
-
-		double Gf = dpdrf/rhof/R/T;
-		double Gg = -dpdrg/rhog/R/T;
-		//MSG("Gf = %e, Gg = %e",Gf,Gg);
-
-		double DET = Ff*Gg - Fg*Gf;
-		//MSG("DET = %f",DET);
-
-		// 'gamma' needs to be increased to 0.5 for water to solve correctly (see 'test/sat.c')
-		// 'gamma' needs to be not more than 0.4 for ethanol to solve correctly (see 'test/sat.c')
-#define gamma 0.40
-		rhof += gamma/DET * (Fg*G - Gg*F);
-		rhog += gamma/DET * ( Gf*F - Ff*G);
-#undef gamma
-
-		assert(!isnan(rhof));
-		assert(!isnan(rhog));
-
-		if(rhog < 0)rhog = -0.5*rhog;
-		if(rhof < 0)rhof = -0.5*rhof;
+	// 'gamma' needs to be increased to 0.5 for water to solve correctly (see 'test/sat.c')
+	// 'gamma' needs to be not more than 0.4 for ethanol to solve correctly (see 'test/sat.c')
+	if(helmholtz_sat_iterate(T, &rhof, &rhog, 0.40, 200, &psat, data, err)){
+		*rhof_out = rhof;
+		*rhog_out = rhog;
+		return psat;
+		/* SUCCESS */
 	}
 	*rhof_out = rhof;
 	*rhog_out = rhog;
@@ -675,6 +871,22 @@ double helmholtz_sat(double T, double *rhof_out, double * rhog_out, const FluidD
 	return helmholtz_p(T, rhog, data, err);
 }
 
+/**
+	Solve the saturation condition at T as helmholtz_sat does, but with full
+	Newton steps from *rhof and *rhog, which have to be close to the solution
+	already (as from the saturation curve, see satcurve.h). Quietly sets *err
+	to FPROPS_SAT_CVGC_ERROR if that doesn't converge in a few iterations, or
+	converges to rhof == rhog, so that the caller can fall back to
+	helmholtz_sat.
+	@return psat
+*/
+double helmholtz_sat_newton(double T, double *rhof, double *rhog, const FluidData *data, FpropsError *err){
+	double psat = 0;
+	if(!helmholtz_sat_iterate(T, rhof, rhog, 1.0, 12, &psat, data, err) || !(*rhog < *rhof)){
+		*err = FPROPS_SAT_CVGC_ERROR;
+	}
+	return psat;
+}
 
 
 
@@ -705,6 +917,34 @@ static double ipow(double x, int n){
 	return t;
 }
 
+/*
+	x^n, x^(n-1) and x^(n-2) from a single pow where that's safe; at x == 0 the
+	negative powers are left to pow (or ipow) to sort out as before.
+*/
+static void pow_n012(double x, double n, double *xn, double *xn1, double *xn2){
+	if(x != 0){
+		*xn2 = pow(x, n - 2);
+		*xn1 = *xn2 * x;
+		*xn = *xn1 * x;
+	}else{
+		*xn = pow(x, n);
+		*xn1 = pow(x, n - 1);
+		*xn2 = pow(x, n - 2);
+	}
+}
+
+static void ipow_n012(double x, int n, double *xn, double *xn1, double *xn2){
+	if(x != 0){
+		*xn2 = ipow(x, n - 2);
+		*xn1 = *xn2 * x;
+		*xn = *xn1 * x;
+	}else{
+		*xn = ipow(x, n);
+		*xn1 = ipow(x, n - 1);
+		*xn2 = ipow(x, n - 2);
+	}
+}
+
 /* maxima expressions:
 	Psi(delta) := exp(-C*(delta-1)^2 -D*(tau-1)^2);
 	theta(delta) := (1-tau) + A*((delta-1)^2)^(1/(2*beta));
@@ -1145,6 +1385,7 @@ double helm_resid_deltau(double tau,double delta,const HelmholtzRunData *HD){
 		DEFINE_DPSIDDELTA;
 		DEFINE_DDELBDTAU;
 		DEFINE_DDELDDELTA;
+		DEFINE_DDELBDDELTA;
 
 		double d2DELbddeldtau = -ct->A * ct->b * 2./ct->beta * (DELB/DELTA)*d1*pow(d12,0.5/ct->beta-1) \
 			- 2. * theta * ct->b * (ct->b - 1) * (DELB/SQ(DELTA)) * dDELddelta;
@@ -1154,7 +1395,7 @@ double helm_resid_deltau(double tau,double delta,const HelmholtzRunData *HD){
 		DEFINE_DPSIDTAU;
 
 		sum = ct->n * (DELB * (dPSIdtau + delta * d2PSIddeldtau) \
-			+ delta *dDELbdtau*dPSIdtau \
+			+ delta * dDELbddelta * dPSIdtau \
 			+ dDELbdtau*(PSI+delta*dPSIddelta) \
 			+ d2DELbddeldtau*delta*PSI
 		);
@@ -1372,6 +1613,227 @@ double helm_resid_tautau(double tau, double delta, const HelmholtzRunData *HD){
 	return res;
 }
 
+/*=================== ALL AT ONCE =======================*/
+
+/*
+	Critical terms with all their first and second derivatives, added to the
+	phir members of D. Shared by helm_resid_all and helm_resid_all_batch.
+*/
+static void helm_resid_crit_all(double tau, double delta, const HelmholtzRunData *HD, HelmholtzDerivs *D){
+	double phir = 0, phir_d = 0, phir_t = 0, phir_dd = 0, phir_dt = 0, phir_tt = 0;
+	unsigned n, i;
+	const HelmholtzCritTerm *ct;
+
+	n = HD->nc;
+	ct = &(HD->ct[0]);
+	for(i=0; i<n; ++i, ++ct){
+		DEFINE_DELTA;
+		DEFINE_DELB;
+		DEFINE_DPSIDDELTA;
+		DEFINE_DDELDDELTA;
+		DEFINE_DDELBDDELTA;
+		DEFINE_DDELBDTAU;
+		DEFINE_DPSIDTAU;
+		DEFINE_D2DELDDELTA2;
+		DEFINE_D2DELBDDELTA2;
+		DEFINE_D2PSIDDELTA2;
+
+		double d2DELbddeldtau = -ct->A * ct->b * 2./ct->beta * (DELB/DELTA)*d1*pow(d12,0.5/ct->beta-1) \
+			- 2. * theta * ct->b * (ct->b - 1) * (DELB/SQ(DELTA)) * dDELddelta;
+		double d2PSIddeldtau = 4. * ct->C*ct->D*d1*t1*PSI;
+		double d2DELbdtau2 = 2. * ct->b * (DELB/DELTA) + 4. * SQ(theta) * ct->b * (ct->b - 1) * (DELB/SQ(DELTA));
+		double d2PSIdtau2 = 2. * ct->D * PSI * (2. * ct->D * SQ(t1) -1.);
+
+		phir += ct->n * DELB * delta * PSI;
+		phir_d += ct->n * (DELB * (PSI + delta * dPSIddelta) + dDELbddelta * delta * PSI);
+		phir_t += ct->n * delta * (dDELbdtau * PSI + DELB * dPSIdtau);
+		phir_dd += ct->n * (DELB*(2.*dPSIddelta + delta*d2PSIddelta2) + 2.*dDELbddelta*(PSI+delta*dPSIddelta) + d2DELbddelta2*delta*PSI);
+		phir_dt += ct->n * (DELB * (dPSIdtau + delta * d2PSIddeldtau) \
+			+ delta * dDELbddelta * dPSIdtau \
+			+ dDELbdtau*(PSI+delta*dPSIddelta) \
+			+ d2DELbddeldtau*delta*PSI
+		);
+		phir_tt += ct->n * delta * (d2DELbdtau2 * PSI + 2 * dDELbdtau*dPSIdtau + DELB * d2PSIdtau2);
+	}
+
+	D->phir += phir;
+	D->phir_del += phir_d;
+	D->phir_tau += phir_t;
+	D->phir_deldel += phir_dd;
+	D->phir_deltau += phir_dt;
+	D->phir_tautau += phir_tt;
+}
+
+/**
+	Residual part of helmholtz function with all its first and second
+	derivatives, in one pass over the terms: the same values as helm_resid,
+	helm_resid_del, helm_resid_tau, helm_resid_deldel, helm_resid_deltau and
+	helm_resid_tautau, but each pow and exp is evaluated once per term rather
+	than once per term per derivative.
+
+	Fills in the phir members of D; the rest of D is left alone.
+*/
+void helm_resid_all(double tau, double delta, const HelmholtzRunData *HD, HelmholtzDerivs *D){
+	double phir = 0, phir_d = 0, phir_t = 0, phir_dd = 0, phir_dt = 0, phir_tt = 0;
+	double tn, tn1, tn2, dn, dn1, dn2;
+	double dell, ldell = 0, expdell = 1;
+	unsigned n, i, l = 0;
+	const HelmholtzPowTerm *pt;
+	const HelmholtzGausTerm *gt;
+
+	/* power terms: exp(-delta^l) is shared by each run of terms with equal l */
+	n = HD->np;
+	pt = &(HD->pt[0]);
+	for(i=0; i<n; ++i, ++pt){
+		if(i == 0 || pt->l != l){
+			l = pt->l;
+			if(l == 0){
+				ldell = 0;
+				expdell = 1;
+			}else{
+				dell = (delta==0 ? 0 : ipow(delta,l));
+				ldell = l * dell;
+				expdell = exp(-dell);
+			}
+		}
+		pow_n012(tau, pt->t, &tn, &tn1, &tn2);
+		ipow_n012(delta, pt->d, &dn, &dn1, &dn2);
+		double a = pt->a * expdell;
+		double fd = pt->d - ldell;
+		double fdd = pt->d*(pt->d - 1) + (l ? SQ(ldell) + ldell*(1. - 2*pt->d - l) : 0);
+		phir += a * tn * dn;
+		phir_d += a * tn * dn1 * fd;
+		phir_t += a * pt->t * tn1 * dn;
+		phir_dd += a * tn * dn2 * fdd;
+		phir_dt += a * pt->t * tn1 * dn1 * fd;
+		phir_tt += a * pt->t * (pt->t - 1) * tn2 * dn;
+	}
+
+	/* gaussian terms */
+	n = HD->ng;
+	gt = &(HD->gt[0]);
+	for(i=0; i<n; ++i, ++gt){
+		double d1 = delta - gt->epsilon;
+		double t1 = tau - gt->gamma;
+		double a = gt->n * exp(-gt->alpha*SQ(d1) - gt->beta*SQ(t1));
+		double fd = gt->d - 2.*gt->alpha*delta*d1;
+		double ft = gt->t - 2.*gt->beta*tau*t1;
+		double fdd = gt->d*(gt->d - 1)
+			+ 2.*gt->alpha*delta * (delta * (2.*gt->alpha*SQ(d1) - 1) - 2.*gt->d*d1);
+		double ftt = gt->t*(gt->t - 1) + 4.*gt->beta*tau * (tau * (gt->beta*SQ(t1) - 0.5) - t1*gt->t);
+		pow_n012(tau, gt->t, &tn, &tn1, &tn2);
+		pow_n012(delta, gt->d, &dn, &dn1, &dn2);
+		phir += a * tn * dn;
+		phir_d += a * tn * dn1 * fd;
+		phir_t += a * tn1 * dn * ft;
+		phir_dd += a * tn * dn2 * fdd;
+		phir_dt += a * tn1 * dn1 * ft * fd;
+		phir_tt += a * tn2 * dn * ftt;
+	}
+
+	D->phir = phir;
+	D->phir_del = phir_d;
+	D->phir_tau = phir_t;
+	D->phir_deldel = phir_dd;
+	D->phir_deltau = phir_dt;
+	D->phir_tautau = phir_tt;
+
+	if(HD->nc)helm_resid_crit_all(tau,delta,HD,D);
+}
+
+/**
+	helm_resid_all for n states at once. The loops run over the terms outside
+	and the states inside, on contiguous arrays, so that the inner loops have
+	no branches and no dependencies between states and can be vectorised.
+	Each power or gaussian term takes a single exp per state, writing
+	tau^t delta^d as exp(t ln(tau) + d ln(delta)) and accumulating
+	delta^i tau^j times each derivative, which are divided out at the end.
+
+	States with delta == 0 are done one at a time by helm_resid_all.
+*/
+void helm_resid_all_batch(unsigned n, const double *tau, const double *delta, const HelmholtzRunData *HD, HelmholtzDerivs *D){
+	double lt[HELM_BATCH], ld[HELM_BATCH], el[HELM_BATCH], ldl[HELM_BATCH];
+	double s[HELM_BATCH], sd[HELM_BATCH], st[HELM_BATCH], sdd[HELM_BATCH], sdt[HELM_BATCH], stt[HELM_BATCH];
+	unsigned j0, m, i, j, l = 0;
+	const HelmholtzPowTerm *pt;
+	const HelmholtzGausTerm *gt;
+
+	for(j0 = 0; j0 < n; j0 += m){
+		const double *ta = tau + j0, *de = delta + j0;
+		m = (n - j0 < HELM_BATCH) ? n - j0 : HELM_BATCH;
+
+		for(j=0; j<m; ++j){
+			lt[j] = log(ta[j]);
+			ld[j] = log(de[j]);
+			s[j] = sd[j] = st[j] = sdd[j] = sdt[j] = stt[j] = 0;
+		}
+
+		/* power terms: exp(-delta^l) is shared by each run of terms with equal l */
+		pt = &(HD->pt[0]);
+		for(i=0; i<HD->np; ++i, ++pt){
+			double a = pt->a, t = pt->t, d = pt->d;
+			double cdd = d*(d - 1), c1 = 1. - 2*d - pt->l;
+			if(i == 0 || pt->l != l){
+				l = pt->l;
+				for(j=0; j<m; ++j){
+					double dell = l ? exp(l * ld[j]) : 0;
+					ldl[j] = l * dell;
+					el[j] = exp(-dell);
+				}
+			}
+			for(j=0; j<m; ++j){
+				double x = a * el[j] * exp(t*lt[j] + d*ld[j]);
+				double fd = d - ldl[j];
+				s[j] += x;
+				sd[j] += x * fd;
+				st[j] += x * t;
+				sdd[j] += x * (cdd + ldl[j]*(ldl[j] + c1));
+				sdt[j] += x * t * fd;
+				stt[j] += x * t * (t - 1);
+			}
+		}
+
+		/* gaussian terms */
+		gt = &(HD->gt[0]);
+		for(i=0; i<HD->ng; ++i, ++gt){
+			double t = gt->t, d = gt->d, al = gt->alpha, be = gt->beta;
+			for(j=0; j<m; ++j){
+				double d1 = de[j] - gt->epsilon;
+				double t1 = ta[j] - gt->gamma;
+				double x = gt->n * exp(t*lt[j] + d*ld[j] - al*SQ(d1) - be*SQ(t1));
+				double fd = d - 2.*al*de[j]*d1;
+				double ft = t - 2.*be*ta[j]*t1;
+				s[j] += x;
+				sd[j] += x * fd;
+				st[j] += x * ft;
+				sdd[j] += x * (d*(d - 1) + 2.*al*de[j] * (de[j] * (2.*al*SQ(d1) - 1) - 2.*d*d1));
+				sdt[j] += x * ft * fd;
+				stt[j] += x * (t*(t - 1) + 4.*be*ta[j] * (ta[j] * (be*SQ(t1) - 0.5) - t1*t));
+			}
+		}
+
+		for(j=0; j<m; ++j){
+			HelmholtzDerivs *Dj = D + j0 + j;
+			double it = 1. / ta[j], id = 1. / de[j];
+			Dj->phir = s[j];
+			Dj->phir_del = sd[j] * id;
+			Dj->phir_tau = st[j] * it;
+			Dj->phir_deldel = sdd[j] * id * id;
+			Dj->phir_deltau = sdt[j] * id * it;
+			Dj->phir_tautau = stt[j] * it * it;
+		}
+
+		/* critical terms, and states at zero density, one state at a time */
+		for(j=0; j<m; ++j){
+			if(de[j] == 0){
+				helm_resid_all(ta[j], de[j], HD, D + j0 + j);
+			}else if(HD->nc){
+				helm_resid_crit_all(ta[j], de[j], HD, D + j0 + j);
+			}
+		}
+	}
+}
+
 /* === THIRD DERIVATIVES (this is getting boring now) === */
 
 #ifdef INCLUDE_THIRD_DERIV_CODE
@@ -32,5 +32,42 @@ PureFluid *helmholtz_prepare(const EosData *data, const ReferenceState *ref);
 
 void helmholtz_destroy(PureFluid *data);
 
+/**
+	Evaluate the reduced Helmholtz energy with all its first and second
+	derivatives at (T,rho), in one pass over the correlation terms.
+*/
+void helmholtz_derivs(double T, double rho, const FluidData *data, HelmholtzDerivs *D);
+
+/** helmholtz_derivs for n states at once, D[i] at (T[i],rho[i]) */
+void helmholtz_derivs_batch(unsigned n, const double *T, const double *rho, const FluidData *data, HelmholtzDerivs *D);
+
+/**
+	Saturation state at T by full Newton steps from guesses *rhof, *rhog close
+	to the solution; sets *err to FPROPS_SAT_CVGC_ERROR if that fails.
+	@return psat
+*/
+double helmholtz_sat_newton(double T, double *rhof, double *rhog, const FluidData *data, FpropsError *err);
+
+/** A property of the state at which D was evaluated, calculated from D alone */
+typedef double HelmDerivsEvalFn(const HelmholtzDerivs *D, const FluidData *data, FpropsError *err);
+
+HelmDerivsEvalFn helmholtz_p_derivs;
+HelmDerivsEvalFn helmholtz_u_derivs;
+HelmDerivsEvalFn helmholtz_h_derivs;
+HelmDerivsEvalFn helmholtz_s_derivs;
+HelmDerivsEvalFn helmholtz_a_derivs;
+HelmDerivsEvalFn helmholtz_g_derivs;
+HelmDerivsEvalFn helmholtz_cp_derivs;
+HelmDerivsEvalFn helmholtz_cv_derivs;
+HelmDerivsEvalFn helmholtz_w_derivs;
+HelmDerivsEvalFn helmholtz_alphap_derivs;
+HelmDerivsEvalFn helmholtz_betap_derivs;
+HelmDerivsEvalFn helmholtz_dpdT_rho_derivs;
+HelmDerivsEvalFn helmholtz_dpdrho_T_derivs;
+HelmDerivsEvalFn helmholtz_dhdT_rho_derivs;
+HelmDerivsEvalFn helmholtz_dhdrho_T_derivs;
+HelmDerivsEvalFn helmholtz_dudT_rho_derivs;
+HelmDerivsEvalFn helmholtz_dudrho_T_derivs;
+
 #endif
 
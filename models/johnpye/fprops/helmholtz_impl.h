@@ -35,6 +35,9 @@ double helm_resid_deltau(double tau, double delta, const HelmholtzRunData *data)
 double helm_resid_deldel(double tau, double delta, const HelmholtzRunData *data);
 double helm_resid_tautau(double tau, double delta, const HelmholtzRunData *data);
 
+void helm_resid_all(double tau, double delta, const HelmholtzRunData *data, HelmholtzDerivs *D);
+void helm_resid_all_batch(unsigned n, const double *tau, const double *delta, const HelmholtzRunData *data, HelmholtzDerivs *D);
+
 #ifdef INCLUDE_THIRD_DERIV_CODE
 double helm_resid_deldeldel(double tau, double delta, const HelmholtzRunData *data);
 #endif
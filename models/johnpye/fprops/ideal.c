@@ -68,6 +68,8 @@ PureFluid *ideal_prepare(const EosData *E, const ReferenceState *ref){
 	P->name = E->name;
 	P->source = E->source;
 	P->type = FPROPS_IDEAL;
+	P->table = NULL;
+	P->satcurve = NULL;
 
 	switch(E->type){
 	case FPROPS_CUBIC:
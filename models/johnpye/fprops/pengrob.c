@@ -81,6 +81,8 @@ PureFluid *pengrob_prepare(const EosData *E, const ReferenceState *ref){
 	P->name = E->name;
 	P->source = E->source;
 	P->type = FPROPS_PENGROB;
+	P->table = NULL;
+	P->satcurve = NULL;
 
 #define D P->data
 	/* common data across all correlation types */
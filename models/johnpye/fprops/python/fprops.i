@@ -16,6 +16,7 @@
 #include "../refstate.h"
 #include "../filedata.h"
 #include "../derivs.h"
+#include "../table.h"
 
 /*----------------- REFERENCE STATES -------------------*/
 
@@ -123,6 +124,17 @@ typedef struct{} PureFluid;
 		if(res)*err = FPROPS_NUMERIC_ERROR;
 	}
 
+	// attach a property table (see table.h), read from cachefile if possible,
+	// else built with the default spec and saved there (cachefile may be None)
+	void use_table(const char *cachefile, FpropsError *err){
+		fprops_table_use($self, NULL, cachefile, err);
+	}
+
+	// go back to evaluating the equation of state throughout
+	void release_table(){
+		fprops_table_release($self);
+	}
+
 	FluidState set_Trho(double T, double rho, FpropsError *err){
 		FluidState state;
 		state = fprops_set_Trho(T,rho,$self,err);
@@ -130,10 +142,9 @@ typedef struct{} PureFluid;
 	}
 
 	FluidState set_ph(double p, double h, FpropsError *err){
-		FluidState state;
-		fprops_solve_ph(p, h, &(state.T), &(state.rho), 0, $self, err);
-		state.fluid = $self;
-		return state;
+		double T, rho;
+		fprops_solve_ph(p, h, &T, &rho, 0, $self, err);
+		return fprops_set_Trho(T, rho, $self, err);
 	}
 
 	int region_ph(double p, double h, FpropsError *err){
@@ -141,11 +152,9 @@ typedef struct{} PureFluid;
 	}
 
 	FluidState set_Tx(double T, double x, FpropsError *err){
-		FluidState state;
-		fprops_solve_Tx(T, x, &(state.rho), $self, err);
-		state.T = T;
-		state.fluid = $self;
-		return state;
+		double rho;
+		fprops_solve_Tx(T, x, &rho, $self, err);
+		return fprops_set_Trho(T, rho, $self, err);
 	}
 
 	int region_Tx(double T, double x, FpropsError *err){
@@ -153,10 +162,9 @@ typedef struct{} PureFluid;
 	}
 
 	FluidState set_px(double p, double x, FpropsError *err){
-		FluidState state;
-		fprops_solve_px(p, x, &(state.T), &(state.rho), $self, err);
-		state.fluid = $self;
-		return state;
+		double T, rho;
+		fprops_solve_px(p, x, &T, &rho, $self, err);
+		return fprops_set_Trho(T, rho, $self, err);
 	}
 
 	int region_px(double p, double x, FpropsError *err){
@@ -122,8 +122,8 @@ int fprops_set_reference_state(PureFluid *P, const ReferenceState *ref){
 		h2 = 0; s2 = 0;
 		P->data->cp0->c = -(s2 - s1)/P->data->R;
 		P->data->cp0->m = (h2 - h1)/P->data->R/P->data->T_c;
-		MSG("h at T,rhof = %f",fprops_h(S1,&res));
-		MSG("s at T,rhof = %f",fprops_s(S1,&res));
+		MSG("h at T,rhof = %f",fprops_h(fprops_set_Trho(T,rho_f,P,&res),&res));
+		MSG("s at T,rhof = %f",fprops_s(fprops_set_Trho(T,rho_f,P,&res),&res));
 		return 0;
 
 	case FPROPS_REF_TRHS:
@@ -72,6 +72,20 @@ typedef struct HelmholtzRunData_struct{
 	const HelmholtzCritTerm *ct; /**< critical terms of the second kind */
 } HelmholtzRunData;
 
+/**
+	Reduced Helmholtz energy phi = a/(R T), ideal part phi0 and residual part
+	phir, with all their first and second partial derivatives in tau and delta,
+	at one state. Every property of a Helmholtz fluid at that state follows
+	from these without going back to the correlation terms; see
+	helmholtz_derivs. (The cross derivative of phi0 is identically zero.)
+*/
+typedef struct HelmholtzDerivs_struct{
+	double T, rho;     /**< state at which these were evaluated */
+	double tau, delta;
+	double phi0, phi0_tau, phi0_tautau;
+	double phir, phir_del, phir_tau, phir_deldel, phir_deltau, phir_tautau;
+} HelmholtzDerivs;
+
 typedef struct PengrobRunData_struct{
 	double aTc;   /**< value of 'a' when evaluated at T =  T_c */
 	double b;     /**< coeficient 'b' in PR EOS */
@@ -128,6 +142,12 @@ typedef double PropEvalFn(double T,double rho,const FluidData *data, FpropsError
 /** @return psat */
 typedef double SatEvalFn(double T,double *rhof, double *rhog, const FluidData *data, FpropsError *err);
 
+/** Tabulated properties of a fluid, see table.h */
+typedef struct PropTable_struct PropTable;
+
+/** Fit of the saturation curve of a fluid, see satcurve.h */
+typedef struct SatCurve_struct SatCurve;
+
 /**
 	Structure containing all the necessary data and metadata for run-time
 	calculation of fluid properties.
@@ -154,6 +174,8 @@ typedef struct PureFluid_struct{
 
 	const ViscosityData *visc; // TODO should it be here? or inside FluidData?? probably yes, but needs review.
 	const ThermalConductivityData *thcond; // TODO should it be here? probably yes, but needs review.
+	PropTable *table; // optional tabulated properties, NULL unless fprops_table_use has been called
+	SatCurve *satcurve; // saturation curve fit made by fprops_prepare, or NULL
 } PureFluid;
 
 #endif
@@ -27,6 +27,8 @@
 #include "sat.h"
 #include "fprops.h"
 #include "zeroin.h"
+#include "table.h"
+#include "satcurve.h"
 
 // report lots of stuff
 //#define SAT_DEBUG
@@ -229,6 +231,8 @@ double fprops_rhog_T_chouaieb(double T, const FluidData *data){
 }
 
 void fprops_sat_T(double T, double *psat, double *rhof, double *rhog, const PureFluid *d, FpropsError *err){
+	if(d->table && !fprops_table_sat_T(d->table, T, psat, rhof, rhog))return;
+	if(d->satcurve && !fprops_satcurve_solve_T(d, T, psat, rhof, rhog))return;
 	*psat = d->sat_fn(T,rhof,rhog,d->data,err);
 }
 
@@ -293,7 +297,9 @@ static double sat_p_resid(double rT, void *user_data){
 
 	Currently this is just a Brent solver. We've tried to improve it slightly
 	by solving for the residual of log(p)-log(p1) as a function of 1/T, which
-	should make the function a bit more linear.
+	should make the function a bit more linear. If the fluid has a saturation
+	curve fit (see satcurve.h), Newton's method from the fit's guess is tried
+	first, and usually converges in two or three steps.
 
 	TODO Shouldn't(?) be hard at all to improve this to use a Newton solver via
 	the Clapeyron equation?
@@ -327,6 +333,8 @@ void fprops_sat_p(double p, double *T_sat, double *rho_f, double *rho_g, const P
 		*rho_g = P->data->rho_c;
 		return;
 	}
+	if(P->table && !fprops_table_sat_p(P->table, p, T_sat, rho_f, rho_g))return;
+	if(P->satcurve && !fprops_satcurve_solve_p(P, p, T_sat, rho_f, rho_g))return;
 	/* FIXME what about checking triple point pressure? */
 	
 
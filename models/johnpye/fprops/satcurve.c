@@ -0,0 +1,383 @@
+/*	ASCEND modelling environment
+	Copyright (C) 2015 John Pye
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2, or (at your option)
+	any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*//** @file
+	Saturation curve fit, see satcurve.h.
+*/
+
+#include "satcurve.h"
+#include "helmholtz.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+//#define SATCURVE_DEBUG
+#define SATCURVE_ERRORS
+
+#ifdef SATCURVE_DEBUG
+# include "color.h"
+# define MSG FPROPS_MSG
+#else
+# define MSG(ARGS...) ((void)0)
+#endif
+
+#ifdef SATCURVE_ERRORS
+# include "color.h"
+# define ERRMSG FPROPS_ERRMSG
+#else
+# define ERRMSG(ARGS...) ((void)0)
+#endif
+
+/* quantities along the curve */
+enum{SC_LNP, SC_LNRHOF, SC_LNRHOG, SC_HF, SC_HG, SC_N};
+
+/* number of nodes, and u at the one nearest to T_c */
+#define SATCURVE_N 48
+#define SATCURVE_U0 0.1
+
+struct SatCurve_struct{
+	double T_c, dT;  /* T = T_c - dT u^3 */
+	double u0, du;   /* u at node 0 (nearest T_c), and the node spacing */
+	unsigned n;      /* number of nodes */
+	double node[SATCURVE_N][SC_N][2]; /* value and d/du at each node */
+	double dh[SATCURVE_N - 1];        /* error in hf, hg from fprops_satcurve_p over each interval */
+	double hc;       /* h(T_c, rho_c) when built */
+};
+
+/*------------------------------------------------------------------------------
+  SLOPES ALONG THE SATURATION CURVE
+*/
+
+int fprops_sat_slopes(const PureFluid *P, double T, double psat, double rhof, double rhog, SatSlopes *S){
+	const FluidData *d = P->data;
+	HelmholtzDerivs Df, Dg;
+	FpropsError err = FPROPS_NO_ERROR;
+	double p_T, drho;
+	helmholtz_derivs(T, rhof, d, &Df);
+	helmholtz_derivs(T, rhog, d, &Dg);
+	S->hf = helmholtz_h_derivs(&Df, d, &err);
+	S->hg = helmholtz_h_derivs(&Dg, d, &err);
+	S->sf = helmholtz_s_derivs(&Df, d, &err);
+	S->sg = helmholtz_s_derivs(&Dg, d, &err);
+	S->dpsat = (S->hg - S->hf) / (T * (1/rhog - 1/rhof));
+
+	p_T = helmholtz_dpdT_rho_derivs(&Df, d, &err);
+	S->drhof = drho = (S->dpsat - p_T) / helmholtz_dpdrho_T_derivs(&Df, d, &err);
+	S->dhf = helmholtz_dhdT_rho_derivs(&Df, d, &err) + helmholtz_dhdrho_T_derivs(&Df, d, &err) * drho;
+	S->dsf = helmholtz_cv_derivs(&Df, d, &err) / T - p_T / (rhof*rhof) * drho;
+
+	p_T = helmholtz_dpdT_rho_derivs(&Dg, d, &err);
+	S->drhog = drho = (S->dpsat - p_T) / helmholtz_dpdrho_T_derivs(&Dg, d, &err);
+	S->dhg = helmholtz_dhdT_rho_derivs(&Dg, d, &err) + helmholtz_dhdrho_T_derivs(&Dg, d, &err) * drho;
+	S->dsg = helmholtz_cv_derivs(&Dg, d, &err) / T - p_T / (rhog*rhog) * drho;
+
+	return err || !(rhog < rhof) || isnan(S->drhof + S->drhog + S->dsf + S->dsg);
+}
+
+/*------------------------------------------------------------------------------
+  INTERPOLATION
+*/
+
+static double satcurve_T(const SatCurve *c, double u){
+	return c->T_c - c->dT * u*u*u;
+}
+
+/* cubic Hermite basis at fraction t of an interval of width d, as in table.c */
+static void satcurve_hermite(double t, double d, double a[4]){
+	double t2 = t*t, t3 = t2*t;
+	a[0] = 2*t3 - 3*t2 + 1;
+	a[1] = (t3 - 2*t2 + t) * d;
+	a[2] = 3*t2 - 2*t3;
+	a[3] = (t3 - t2) * d;
+}
+
+static double satcurve_cubic(const SatCurve *c, unsigned i, int q, const double a[4]){
+	return a[0]*c->node[i][q][0] + a[1]*c->node[i][q][1] + a[2]*c->node[i+1][q][0] + a[3]*c->node[i+1][q][1];
+}
+
+/* d/du of quantity q over interval i, at fraction t */
+static double satcurve_slope(const SatCurve *c, unsigned i, int q, double t){
+	double t2 = t*t, d = c->du;
+	return ((6*t2 - 6*t) * (c->node[i][q][0] - c->node[i+1][q][0])) / d
+		+ (3*t2 - 4*t + 1) * c->node[i][q][1] + (3*t2 - 2*t) * c->node[i+1][q][1];
+}
+
+/* interval and fraction of the way across it for T */
+static int satcurve_locate_T(const SatCurve *c, double T, unsigned *i, double *t){
+	double r;
+	if(!(T < c->T_c))return 1;
+	r = (cbrt((c->T_c - T) / c->dT) - c->u0) / c->du;
+	if(!(r >= 0 && r <= c->n - 1 + 1e-9))return 1; /* also catches NaN */
+	*i = (unsigned)r;
+	if(*i >= c->n - 1)*i = c->n - 2;
+	*t = r - *i;
+	return 0;
+}
+
+/* interval and fraction for ln p: ln psat decreases along the nodes */
+static int satcurve_locate_lnp(const SatCurve *c, double lnp, unsigned *i, double *t){
+	unsigned lo = 0, hi = c->n - 1, k;
+	double a = 0, b = 1, f;
+	if(!(lnp <= c->node[0][SC_LNP][0] && lnp >= c->node[c->n - 1][SC_LNP][0]))return 1;
+	while(hi - lo > 1){
+		unsigned mid = (lo + hi) / 2;
+		if(c->node[mid][SC_LNP][0] >= lnp)lo = mid;
+		else hi = mid;
+	}
+	*i = lo;
+	/* solve the cubic for t, by Newton's method kept within a bracket */
+	*t = (c->node[lo][SC_LNP][0] - lnp) / (c->node[lo][SC_LNP][0] - c->node[hi][SC_LNP][0]);
+	for(k = 0; k < 30; ++k){
+		double h[4], df;
+		satcurve_hermite(*t, c->du, h);
+		f = satcurve_cubic(c, lo, SC_LNP, h) - lnp;
+		if(f > 0)a = *t; else b = *t;
+		df = satcurve_slope(c, lo, SC_LNP, *t) * c->du;
+		double t1 = *t - f / df;
+		if(!(t1 > a && t1 < b))t1 = 0.5 * (a + b);
+		if(fabs(t1 - *t) < 1e-14){
+			*t = t1;
+			return 0;
+		}
+		*t = t1;
+	}
+	return 0;
+}
+
+static double satcurve_hc(const PureFluid *P){
+	FpropsError err = FPROPS_NO_ERROR;
+	return P->h_fn(P->data->T_c, P->data->rho_c, P->data, &err);
+}
+
+/*------------------------------------------------------------------------------
+  LOOKUPS
+*/
+
+int fprops_satcurve_T(const PureFluid *P, double T, double *psat, double *rhof, double *rhog){
+	const SatCurve *c = P->satcurve;
+	unsigned i;
+	double t, a[4];
+	if(c == NULL || satcurve_locate_T(c, T, &i, &t))return 1;
+	satcurve_hermite(t, c->du, a);
+	*psat = exp(satcurve_cubic(c, i, SC_LNP, a));
+	*rhof = exp(satcurve_cubic(c, i, SC_LNRHOF, a));
+	*rhog = exp(satcurve_cubic(c, i, SC_LNRHOG, a));
+	return 0;
+}
+
+int fprops_satcurve_p(const PureFluid *P, double p, double *Tsat, double *rhof, double *rhog
+		, double *hf, double *hg, double *dh
+){
+	const SatCurve *c = P->satcurve;
+	unsigned i;
+	double t, a[4];
+	if(c == NULL || !(p > 0) || satcurve_locate_lnp(c, log(p), &i, &t))return 1;
+	satcurve_hermite(t, c->du, a);
+	*Tsat = satcurve_T(c, c->u0 + c->du * (i + t));
+	*rhof = exp(satcurve_cubic(c, i, SC_LNRHOF, a));
+	*rhog = exp(satcurve_cubic(c, i, SC_LNRHOG, a));
+	if(hf){
+		double hc = satcurve_hc(P);
+		*hf = hc + satcurve_cubic(c, i, SC_HF, a);
+		*hg = hc + satcurve_cubic(c, i, SC_HG, a);
+		*dh = c->dh[i];
+	}
+	return 0;
+}
+
+/*------------------------------------------------------------------------------
+  WARM-STARTED SOLVES
+*/
+
+int fprops_satcurve_solve_T(const PureFluid *P, double T, double *psat, double *rhof, double *rhog){
+	FpropsError err = FPROPS_NO_ERROR;
+	double p, rf, rg;
+	if(fprops_satcurve_T(P, T, &p, &rf, &rg))return 1;
+	p = helmholtz_sat_newton(T, &rf, &rg, P->data, &err);
+	if(err)return 1;
+	*psat = p;
+	*rhof = rf;
+	*rhog = rg;
+	return 0;
+}
+
+/*
+	Newton's method on ln psat(T) = ln p, with the slope from the Clapeyron
+	equation, and each psat(T) solved from the previous rhof and rhog. Stops
+	when the step in T is within the tolerance that fprops_sat_p's Brent
+	solver uses.
+*/
+int fprops_satcurve_solve_p(const PureFluid *P, double p, double *Tsat, double *rhof, double *rhog){
+	const FluidData *d = P->data;
+	double T, rf, rg, lnp = log(p);
+	int k;
+	if(fprops_satcurve_p(P, p, &T, &rf, &rg, NULL, NULL, NULL))return 1;
+	for(k = 0; k < 10; ++k){
+		FpropsError err = FPROPS_NO_ERROR;
+		double psat = helmholtz_sat_newton(T, &rf, &rg, d, &err);
+		double hf = P->h_fn(T, rf, d, &err);
+		double hg = P->h_fn(T, rg, d, &err);
+		if(err)return 1;
+		double dlnp = (hg - hf) / (T * (1/rg - 1/rf)) / psat;
+		double dT = -(log(psat) - lnp) / dlnp;
+		if(fabs(dT) < 1e-10 * T){
+			MSG("Converged to T = %f in %d iterations", T, k + 1);
+			*Tsat = T;
+			*rhof = rf;
+			*rhog = rg;
+			return 0;
+		}
+		T += dT;
+		if(!(T >= d->T_t && T < d->T_c))return 1;
+	}
+	return 1;
+}
+
+/*------------------------------------------------------------------------------
+  CONSTRUCTION
+*/
+
+/* node i at u, from the exact saturation state there */
+static int satcurve_node(SatCurve *c, const PureFluid *P, unsigned i, double u
+		, double psat, double rhof, double rhog
+){
+	SatSlopes S;
+	double T = satcurve_T(c, u);
+	double dTdu = -3 * c->dT * u*u;
+	if(fprops_sat_slopes(P, T, psat, rhof, rhog, &S))return 1;
+	c->node[i][SC_LNP][0] = log(psat);
+	c->node[i][SC_LNP][1] = S.dpsat / psat * dTdu;
+	c->node[i][SC_LNRHOF][0] = log(rhof);
+	c->node[i][SC_LNRHOF][1] = S.drhof / rhof * dTdu;
+	c->node[i][SC_LNRHOG][0] = log(rhog);
+	c->node[i][SC_LNRHOG][1] = S.drhog / rhog * dTdu;
+	c->node[i][SC_HF][0] = S.hf - c->hc;
+	c->node[i][SC_HF][1] = S.dhf * dTdu;
+	c->node[i][SC_HG][0] = S.hg - c->hc;
+	c->node[i][SC_HG][1] = S.dhg * dTdu;
+	return 0;
+}
+
+/*
+	Exact saturation state at T, from guesses if those are given (and they
+	work), otherwise from scratch.
+*/
+static int satcurve_exact(const PureFluid *P, double T, double *psat, double *rhof, double *rhog, int guess){
+	FpropsError err = FPROPS_NO_ERROR;
+	if(guess){
+		double rf = *rhof, rg = *rhog;
+		double p = helmholtz_sat_newton(T, &rf, &rg, P->data, &err);
+		if(!err){
+			*psat = p;
+			*rhof = rf;
+			*rhog = rg;
+			return 0;
+		}
+		err = FPROPS_NO_ERROR;
+	}
+	*psat = P->sat_fn(T, rhof, rhog, P->data, &err);
+	return err || !(*rhog < *rhof);
+}
+
+SatCurve *fprops_satcurve_build(const PureFluid *P){
+	const FluidData *d = P->data;
+	SatCurve *c;
+	double psat, rhof, rhog;
+	int i, i0;
+
+	if(P->type != FPROPS_HELMHOLTZ || d->T_t <= 0 || d->T_t >= d->T_c)return NULL;
+
+	c = FPROPS_NEW(SatCurve);
+	c->T_c = d->T_c;
+	c->dT = d->T_c - d->T_t;
+	c->u0 = SATCURVE_U0;
+	c->du = (1 - SATCURVE_U0) / (SATCURVE_N - 1);
+	c->n = SATCURVE_N;
+	c->hc = satcurve_hc(P);
+
+	/* nodes from the triple point towards T_c, each solved from the last */
+	for(i = SATCURVE_N - 1; i >= 0; --i){
+		double u = c->u0 + c->du * i;
+		double T = satcurve_T(c, u);
+		if(i < SATCURVE_N - 1){
+			rhof = exp(c->node[i+1][SC_LNRHOF][0] - c->du * c->node[i+1][SC_LNRHOF][1]);
+			rhog = exp(c->node[i+1][SC_LNRHOG][0] - c->du * c->node[i+1][SC_LNRHOG][1]);
+		}
+		if(satcurve_exact(P, T, &psat, &rhof, &rhog, i < SATCURVE_N - 1)
+			|| satcurve_node(c, P, i, u, psat, rhof, rhog)
+		){
+			MSG("Stopped at T = %f", T);
+			break;
+		}
+	}
+	i0 = i + 1;
+	if(SATCURVE_N - i0 < 2){
+		ERRMSG("Unable to fit the saturation curve of '%s'", P->name);
+		FPROPS_FREE(c);
+		return NULL;
+	}
+	if(i0 > 0){
+		/* couldn't get as near T_c as intended: drop the missing nodes */
+		unsigned k;
+		for(k = 0; k + i0 < SATCURVE_N; ++k){
+			int q;
+			for(q = 0; q < SC_N; ++q){
+				c->node[k][q][0] = c->node[k + i0][q][0];
+				c->node[k][q][1] = c->node[k + i0][q][1];
+			}
+		}
+		c->u0 += c->du * i0;
+		c->n = SATCURVE_N - i0;
+	}
+
+	/*
+		How far hf and hg from fprops_satcurve_p are out in the middle of each
+		interval, which with a safety factor is taken as the error bound for
+		the whole interval.
+	*/
+	{
+		PureFluid P1 = *P;
+		unsigned k;
+		P1.satcurve = c;
+		for(k = 0; k + 1 < c->n; ++k){
+			FpropsError err = FPROPS_NO_ERROR;
+			double T = satcurve_T(c, c->u0 + c->du * (k + 0.5));
+			double Tsat, rf, rg, hf, hg, dh, hf1, hg1;
+			c->dh[k] = 0;
+			if(fprops_satcurve_T(&P1, T, &psat, &rhof, &rhog)
+				|| satcurve_exact(P, T, &psat, &rhof, &rhog, 1)
+				|| fprops_satcurve_p(&P1, psat, &Tsat, &rf, &rg, &hf, &hg, &dh)
+			){
+				c->dh[k] = INFINITY;
+				continue;
+			}
+			hf1 = P->h_fn(T, rhof, d, &err);
+			hg1 = P->h_fn(T, rhog, d, &err);
+			c->dh[k] = err ? INFINITY : 10 * fmax(fabs(hf - hf1), fabs(hg - hg1)) + 1e-9 * (fabs(hf1) + fabs(hg1));
+			MSG("T = %f: dh = %e", T, c->dh[k]);
+		}
+	}
+
+	MSG("Saturation curve of '%s' from T = %f to %f with %u nodes"
+		, P->name, satcurve_T(c, 1), satcurve_T(c, c->u0), c->n
+	);
+	return c;
+}
+
+void fprops_satcurve_destroy(SatCurve *c){
+	if(c)FPROPS_FREE(c);
+}
+
@@ -0,0 +1,91 @@
+/*	ASCEND modelling environment
+	Copyright (C) 2015 John Pye
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2, or (at your option)
+	any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*//** @file
+	A fit of the saturation curve of a pure fluid, made when the fluid is
+	prepared, to speed up the exact saturation solves and to tell most (p,h)
+	states' phase without any.
+
+	The curve is a cubic Hermite spline of ln psat, ln rhof, ln rhog, hf and
+	hg against u = ((T_c - T)/(T_c - T_t))^(1/3), on which the densities are
+	nearly linear even close to the critical point, with the values and
+	slopes at each node from the EOS. It stops a little short of T_c (where
+	the slopes are infinite). hf and hg are stored relative to h(T_c, rho_c),
+	so the curve stays valid when the reference state is changed.
+
+	fprops_sat_T and fprops_sat_p use the curve for starting guesses, and
+	then solve the saturation conditions to full accuracy in a few Newton
+	steps, rather than from generic guesses with a damped Newton iteration
+	(and for fprops_sat_p, inside a Brent solver). fprops_region_ph uses it
+	to classify states that aren't too close to the saturation curve, using
+	a margin from how far the curve was found to be from the EOS between the
+	nodes when it was made.
+
+	Only Helmholtz fluids have a saturation curve.
+*/
+#ifndef FPROPS_SATCURVE_H
+#define FPROPS_SATCURVE_H
+
+#include "rundata.h"
+
+/**
+	Fit the saturation curve of P, which must be a Helmholtz fluid.
+	@return the curve, or NULL if the saturation state couldn't be solved
+	near the triple point.
+*/
+SatCurve *fprops_satcurve_build(const PureFluid *P);
+
+void fprops_satcurve_destroy(SatCurve *c);
+
+/*
+	Saturation state from the curve alone. Each returns 0 if the curve covers
+	the requested state, in which case the outputs are set, and non-zero
+	otherwise. For fprops_satcurve_p, hf, hg and dh may be NULL; *dh is a
+	bound on the error in hf and hg.
+*/
+
+int fprops_satcurve_T(const PureFluid *P, double T, double *psat, double *rhof, double *rhog);
+
+int fprops_satcurve_p(const PureFluid *P, double p, double *Tsat, double *rhof, double *rhog
+	, double *hf, double *hg, double *dh
+);
+
+/*
+	Exact saturation state, solved from the curve's guesses. Each returns 0
+	on success, and non-zero if the state isn't covered or the solution
+	failed, in which case the caller should fall back to a cold start.
+*/
+
+int fprops_satcurve_solve_T(const PureFluid *P, double T, double *psat, double *rhof, double *rhog);
+
+int fprops_satcurve_solve_p(const PureFluid *P, double p, double *Tsat, double *rhof, double *rhog);
+
+/**
+	Saturated liquid and vapour enthalpy and entropy at T, given psat, rhof
+	and rhog there, and the derivatives wrt T along the saturation curve of
+	those and of psat, rhof and rhog. That of psat is from the Clapeyron
+	equation and the others follow from p(T, rho_f(T)) = p(T, rho_g(T)) =
+	psat(T).
+*/
+typedef struct SatSlopes_struct{
+	double hf, hg, sf, sg;
+	double dpsat, drhof, drhog, dhf, dhg, dsf, dsg; ///< d/dT along the saturation curve
+} SatSlopes;
+
+/** @return 0 on success (P must be a Helmholtz fluid) */
+int fprops_sat_slopes(const PureFluid *P, double T, double psat, double rhof, double rhog, SatSlopes *S);
+
+#endif
+
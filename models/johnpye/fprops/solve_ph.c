@@ -21,6 +21,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "sat.h"
 #include "derivs.h"
 #include "rundata.h"
+#include "table.h"
+#include "satcurve.h"
+#include "helmholtz.h"
 
 #include <stdio.h>
 #include <math.h>
@@ -79,6 +82,15 @@ int fprops_region_ph(double p, double h, const PureFluid *fluid, FpropsError *er
 
 	if(p >= p_c)return FPROPS_NON;
 
+	/* states clear of the saturation curve don't need it solved exactly */
+	if(fluid->satcurve){
+		double hf, hg, dh;
+		if(!fprops_satcurve_p(fluid, p, &Tsat, &rhof, &rhog, &hf, &hg, &dh)){
+			if(h < hf - dh || h > hg + dh)return FPROPS_NON;
+			if(h > hf + dh && h < hg - dh)return FPROPS_SAT;
+		}
+	}
+
 	fprops_sat_p(p, &Tsat, &rhof, &rhog, fluid, err);
 	if(*err){
 		*err = FPROPS_SAT_CVGC_ERROR;
@@ -105,8 +117,11 @@ void fprops_fpe(int sig){
 }
 #endif
 
-void fprops_solve_ph(double p, double h, double *T, double *rho, int use_guess
-		, const PureFluid *fluid, FpropsError *err
+/* report an error of the solve below, unless asked not to */
+#define SOLVE_ERRMSG(ARGS...) do{if(!quiet){ERRMSG(ARGS);}}while(0)
+
+static void solve_ph(double p, double h, double *T, double *rho, int use_guess
+		, const PureFluid *fluid, FpropsError *err, int quiet
 ){
 	double Tsat, rhof, rhog, hf, hg;
 	double T1, rho1;
@@ -117,6 +132,11 @@ void fprops_solve_ph(double p, double h, double *T, double *rho, int use_guess
 
 	MSG("Solving for p=%f bar, h=%f kJ/kgK (EOS type %d, '%s')",p/1e5,h/1e3,fluid->type,fluid->name);
 
+	if(fluid->table && !fprops_table_ph(fluid->table, p, h, T, rho)){
+		MSG("Got T = %f, rho = %f from the property table", *T, *rho);
+		return;
+	}
+
 #ifdef FPE_DEBUG
     feenableexcept(FE_DIVBYZERO | FE_INVALID | FE_OVERFLOW);
 	SignalHandler *old = signal(SIGFPE,&fprops_fpe);
@@ -130,7 +150,7 @@ void fprops_solve_ph(double p, double h, double *T, double *rho, int use_guess
 			MSG("Calculate saturation Tsat(p < p_c) with p = %f",p);
 			fprops_sat_p(p, &Tsat, &rhof, &rhog, fluid, err);
 			if(*err){
-				ERRMSG("Unable to solve saturation state");
+				SOLVE_ERRMSG("Unable to solve saturation state");
 				*err = FPROPS_SAT_CVGC_ERROR;
 				return;
 			}
@@ -213,7 +233,7 @@ void fprops_solve_ph(double p, double h, double *T, double *rho, int use_guess
 			double pt,rhogt;
 			fprops_triple_point(&pt, &rhof_t, &rhogt, fluid, err);
 			if(*err){
-				ERRMSG("Unable to solve triple point liquid density.");
+				SOLVE_ERRMSG("Unable to solve triple point liquid density.");
 				*err = FPROPS_SAT_CVGC_ERROR;
 				return;
 			}
@@ -281,7 +301,7 @@ void fprops_solve_ph(double p, double h, double *T, double *rho, int use_guess
 			assert(!isnan(f_T));
 
 			if(isnan(f_rho)){
-				ERRMSG("     rho1 = %f, T1 = %f",rho1, T1);
+				SOLVE_ERRMSG("     rho1 = %f, T1 = %f",rho1, T1);
 			}
 			assert(!isnan(f_rho));
 
@@ -296,8 +316,11 @@ void fprops_solve_ph(double p, double h, double *T, double *rho, int use_guess
 
 			delta_T = -1./det * (g_rho * f - f_rho * g);
 			delta_rho = -1./det * (f_T * g - g_T * f);
-			assert(!isnan(delta_T));
-			assert(!isnan(delta_rho));
+			if(isnan(delta_T) || isnan(delta_rho)){
+				/* eg landed on p1 ~ 0, where the derivatives blow up */
+				SOLVE_ERRMSG("Newton step is NaN at T1 = %f, rho1 = %f",T1,rho1);
+				break;
+			}
 			MSG("          dT   = %f", delta_T);
 			MSG("          drho = %f", delta_rho);
 
@@ -363,7 +386,7 @@ void fprops_solve_ph(double p, double h, double *T, double *rho, int use_guess
 
 	*T = T1;
 	*rho = rho1;
-	ERRMSG("Iteration failed for '%s' with p = %.12e, h = %.12e",fluid->name, p,h);
+	SOLVE_ERRMSG("Iteration failed for '%s' with p = %.12e, h = %.12e",fluid->name, p,h);
 	*err = FPROPS_NUMERIC_ERROR;
 	return;
 
@@ -374,3 +397,211 @@ void fprops_solve_ph(double p, double h, double *T, double *rho, int use_guess
 #endif
 }
 
+#undef SOLVE_ERRMSG
+
+void fprops_solve_ph(double p, double h, double *T, double *rho, int use_guess
+		, const PureFluid *fluid, FpropsError *err
+){
+	solve_ph(p, h, T, rho, use_guess, fluid, err, 0);
+}
+
+void fprops_solve_ph_quiet(double p, double h, double *T, double *rho, int use_guess
+		, const PureFluid *fluid, FpropsError *err
+){
+	solve_ph(p, h, T, rho, use_guess, fluid, err, 1);
+}
+
+
+/*
+	Solve a batch of (p,h) points in lockstep. Each point is classified and
+	given a starting guess as in fprops_solve_ph (with the saturation state
+	shared by consecutive points at the same pressure), then the Newton
+	iterations of all the single-phase points are taken together, with the
+	Helmholtz derivatives of every point still iterating evaluated in one
+	helmholtz_derivs_batch call per iteration. The step limits are those of
+	fprops_solve_ph. Points that don't converge, and supercritical points
+	without a guess that would need fprops_sat_hf to start, are passed to
+	fprops_solve_ph one at a time.
+*/
+void fprops_solve_ph_batch(unsigned n, const double *p, const double *h, double *T, double *rho, int use_guess
+		, const PureFluid *fluid, FpropsError *err
+){
+	const FluidData *data = fluid->data;
+	double Tsat = 0, rhof = 0, rhog = 0, hf = 0, hg = 0, psat = -1, hc = 0;
+	double rhof_t = 0, pt, rhogt;
+	int have_hc = 0, have_rhof_t = 0;
+	unsigned i, k, m = 0, nact, iter;
+	double *Ta, *rhoa, *dT, *drho, *rho_lo, *rho_hi;
+	unsigned *idx;
+	HelmholtzDerivs *D;
+	FpropsError err1 = FPROPS_NO_ERROR;
+
+	if(fluid->type != FPROPS_HELMHOLTZ){
+		for(i=0; i<n; ++i){
+			err[i] = FPROPS_NO_ERROR;
+			fprops_solve_ph(p[i], h[i], T + i, rho + i, use_guess, fluid, err + i);
+		}
+		return;
+	}
+
+	Ta = FPROPS_NEW_ARRAY(double, 6 * n);
+	rhoa = Ta + n;
+	dT = Ta + 2 * n;
+	drho = Ta + 3 * n;
+	rho_lo = Ta + 4 * n;
+	rho_hi = Ta + 5 * n;
+	idx = FPROPS_NEW_ARRAY(unsigned, n);
+	D = FPROPS_NEW_ARRAY(HelmholtzDerivs, n);
+
+	/* classify the points; idx[0..m) are those left to iterate */
+	for(i=0; i<n; ++i){
+		err[i] = FPROPS_NO_ERROR;
+		dT[i] = drho[i] = 0;
+		if(fluid->table && !fprops_table_ph(fluid->table, p[i], h[i], T + i, rho + i)){
+			continue;
+		}
+		rho_lo[i] = 0;
+		rho_hi[i] = INFINITY;
+		if(p[i] < data->p_c){
+			if(p[i] != psat){
+				err1 = FPROPS_NO_ERROR;
+				fprops_sat_p(p[i], &Tsat, &rhof, &rhog, fluid, &err1);
+				if(!err1){
+					hf = fluid->h_fn(Tsat, rhof, data, &err1);
+					hg = fluid->h_fn(Tsat, rhog, data, &err1);
+				}
+				psat = p[i];
+			}
+			if(err1){
+				ERRMSG("Unable to solve saturation state");
+				err[i] = FPROPS_SAT_CVGC_ERROR;
+				continue;
+			}
+			if(hf <= h[i] && h[i] <= hg){
+				double x = (h[i] - hf)/(hg - hf);
+				rho[i] = 1./(x/rhog + (1.-x)/rhof);
+				T[i] = Tsat;
+				continue;
+			}
+			if(h[i] < hf){
+				if(!have_rhof_t){
+					fprops_triple_point(&pt, &rhof_t, &rhogt, fluid, err + i);
+					if(err[i]){
+						ERRMSG("Unable to solve triple point liquid density.");
+						err[i] = FPROPS_SAT_CVGC_ERROR;
+						continue;
+					}
+					have_rhof_t = 1;
+				}
+				rho_lo[i] = rhof;
+				rho_hi[i] = rhof_t;
+				if(!use_guess){
+					T[i] = Tsat;
+					rho[i] = rhof;
+				}
+			}else{
+				rho_hi[i] = rhog;
+				if(!use_guess){
+					T[i] = 1.1 * Tsat;
+					rho[i] = rhog * 0.5;
+				}
+			}
+		}else if(!use_guess){
+			if(!have_hc){
+				hc = fluid->h_fn(data->T_c, data->rho_c, data, err + i);
+				have_hc = 1;
+			}
+			if(h[i] < 0.8*hc){
+				/* needs fprops_sat_hf for a starting guess */
+				fprops_solve_ph(p[i], h[i], T + i, rho + i, 0, fluid, err + i);
+				continue;
+			}
+			T[i] = data->T_c * 1.01;
+			rho[i] = data->rho_c * 1.05;
+		}
+		idx[m++] = i;
+	}
+
+	/* Newton iterations, all points together */
+	nact = m;
+	for(iter = 0; iter < 200 && nact; ++iter){
+		for(k=0; k<nact; ++k){
+			Ta[k] = T[idx[k]];
+			rhoa[k] = rho[idx[k]];
+		}
+		helmholtz_derivs_batch(nact, Ta, rhoa, data, D);
+
+		m = 0;
+		for(k=0; k<nact; ++k){
+			FpropsError e = FPROPS_NO_ERROR;
+			i = idx[k];
+			double T1 = T[i], rho1 = rho[i];
+			double p1 = helmholtz_p_derivs(D + k, data, &e);
+			double h1 = helmholtz_h_derivs(D + k, data, &e);
+
+			if(p1 <= 0 || e){
+				if(iter == 0){
+					/* no step to go back on: leave it to fprops_solve_ph */
+					dT[i] = NAN;
+					continue;
+				}
+				/* go back half of the last step, as fprops_solve_ph does */
+				T[i] -= (dT[i] *= 0.5);
+				rho[i] -= (drho[i] *= 0.5);
+				idx[m++] = i;
+				continue;
+			}
+			if(fabs(p1 - p[i]) < 1e-4 && fabs(h1 - h[i]) < 1e-8){
+				continue;
+			}
+
+			double f = log(p1) - log(p[i]);
+			double g = h1 - h[i];
+			double f_T = helmholtz_dpdT_rho_derivs(D + k, data, &e) / p1;
+			double f_rho = helmholtz_dpdrho_T_derivs(D + k, data, &e) / p1;
+			double g_T = helmholtz_dhdT_rho_derivs(D + k, data, &e);
+			double g_rho = helmholtz_dhdrho_T_derivs(D + k, data, &e);
+			double det = g_rho * f_T - f_rho * g_T;
+			double delta_T = -1./det * (g_rho * f - f_rho * g);
+			double delta_rho = -1./det * (f_T * g - g_T * f);
+			int nred = 0;
+
+			/* stay on the same side of the saturation curve */
+			while(rho1 + delta_rho > rho_hi[i] && nred++ < 20)delta_rho *= 0.5;
+			if(rho1 + delta_rho > rho_hi[i])delta_rho = rho_hi[i] - rho1;
+			nred = 0;
+			while(rho1 + delta_rho < rho_lo[i] && nred++ < 20)delta_rho *= 0.5;
+			if(rho_lo[i] > 0 && T1 + delta_T < data->T_t)delta_T = 0.5 * (data->T_t - T1);
+
+			/* don't go too hot, and avoid huge steps */
+			if(T1 + delta_T > 5000)delta_T = 5000 - T1;
+			while(fabs(delta_T / T1) > 0.7)delta_T *= 0.5;
+			while(fabs(delta_rho / rho1) > 0.7)delta_rho *= 0.5;
+
+			if(isnan(delta_T) || isnan(delta_rho)){
+				dT[i] = NAN;
+				continue;
+			}
+			dT[i] = delta_T;
+			drho[i] = delta_rho;
+			T[i] = T1 + delta_T;
+			if(T[i] < data->T_t)T[i] = data->T_t;
+			rho[i] = rho1 + delta_rho;
+			idx[m++] = i;
+		}
+		nact = m;
+	}
+
+	/* whatever failed or didn't converge is done one point at a time */
+	for(k=0; k<nact; ++k)dT[idx[k]] = NAN;
+	for(i=0; i<n; ++i){
+		if(!err[i] && isnan(dT[i])){
+			MSG("Point %u (p = %f bar, h = %f kJ/kg) passed to fprops_solve_ph",i,p[i]/1e5,h[i]/1e3);
+			fprops_solve_ph(p[i], h[i], T + i, rho + i, 0, fluid, err + i);
+		}
+	}
+
+	FPROPS_FREE(Ta);
+	FPROPS_FREE(idx);
+	FPROPS_FREE(D);
+}
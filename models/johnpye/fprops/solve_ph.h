@@ -26,6 +26,25 @@ void fprops_solve_ph(double p, double h, double *T, double *rho, int use_guess
 	, const PureFluid *fluid, FpropsError *err
 );
 
+/**
+	fprops_solve_ph without printing anything when it fails, for callers
+	that expect some points to fail and account for them themselves.
+*/
+void fprops_solve_ph_quiet(double p, double h, double *T, double *rho, int use_guess
+	, const PureFluid *fluid, FpropsError *err
+);
+
+/**
+	fprops_solve_ph for n points at once, (p[i],h[i]) -> (T[i],rho[i]), with
+	err[i] the error for each point. For a Helmholtz fluid the Newton
+	iterations of all the points are done in lockstep, evaluating the EOS for
+	all of them together; this is quicker than n calls to fprops_solve_ph,
+	especially when points share a pressure, as along a heat exchanger.
+*/
+void fprops_solve_ph_batch(unsigned n, const double *p, const double *h, double *T, double *rho, int use_guess
+	, const PureFluid *fluid, FpropsError *err
+);
+
 #if 0
 /* functions for reporting steps back to python */
 typedef struct{
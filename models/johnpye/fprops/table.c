@@ -0,0 +1,1056 @@
+/*	ASCEND modelling environment
+	Copyright (C) 2015 John Pye
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2, or (at your option)
+	any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*//** @file
+	Bicubic property tables, see table.h.
+*/
+
+#include "table.h"
+#include "helmholtz.h"
+#include "solve_ph.h"
+#include "sat.h"
+#include "satcurve.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef FPROPS_WITH_THREADS
+# include <pthread.h>
+# include <unistd.h>
+#endif
+
+//#define TABLE_DEBUG
+#define TABLE_ERRORS
+
+#ifdef TABLE_DEBUG
+# include "color.h"
+# define MSG FPROPS_MSG
+#else
+# define MSG(ARGS...) ((void)0)
+#endif
+
+#ifdef TABLE_ERRORS
+# include "color.h"
+# define ERRMSG FPROPS_ERRMSG
+#else
+# define ERRMSG(ARGS...) ((void)0)
+#endif
+
+/* quantities in the (T, ln rho) table */
+enum{TQ_P, TQ_H, TQ_S, TQ_N};
+/* quantities in the saturation table along T */
+enum{ST_LNP, ST_LNRHOF, ST_LNRHOG, ST_HF, ST_HG, ST_SF, ST_SG, ST_N};
+/* quantities in the (ln p, h) table */
+enum{PQ_T, PQ_LNRHO, PQ_N};
+/* quantities in the saturation table along p */
+enum{SP_T, SP_LNRHOF, SP_LNRHOG, SP_HF, SP_HG, SP_N};
+
+/* kinds of cell */
+enum{
+	CELL_EOS = 0   /**< not covered, use the EOS */
+	,CELL_SINGLE   /**< single-phase throughout, interpolate */
+	,CELL_TWOPHASE /**< two-phase throughout, use the lever rule */
+	,CELL_MIXED    /**< crossed by the saturation curve: lever rule if two-phase, else EOS */
+};
+
+/* kinds of node */
+enum{NODE_FAILED = -1, NODE_TWOPHASE = 0, NODE_SINGLE = 1};
+
+#define TABLE_MAGIC "FPROPSTB"
+#define TABLE_VERSION 1
+#define TABLE_NAMELEN 64
+#define TABLE_NPROBE 9
+
+/*
+	Nodes of the 2D tables hold {f, f_x, f_y, f_xy} for each quantity, those
+	of the saturation tables {f, f_x}. The saturation tables have a node for
+	each row of the corresponding 2D table that is below the critical point.
+*/
+struct PropTable_struct{
+	PropTableSpec spec; /* with the defaults filled in */
+	char name[TABLE_NAMELEN];
+	double probe[TABLE_NPROBE]; /* p, h, s at a few states, to recognise the EOS */
+	double T_c, p_c, R;
+
+	double dT, lrho_min, dlrho;
+	double *trho;              /* [nT][nrho][TQ_N][4] */
+	signed char *trho_node;    /* [nT][nrho] */
+	unsigned char *trho_cell;  /* [nT-1][nrho-1] */
+	unsigned nsatT;
+	double *satT;              /* [nsatT][ST_N][2] */
+	unsigned char *satT_ok;    /* [nsatT-1] */
+
+	double lp_min, dlp, dh;
+	double *ph;                /* [np][nh][PQ_N][4] */
+	signed char *ph_node;      /* [np][nh] */
+	unsigned char *ph_cell;    /* [np-1][nh-1] */
+	unsigned nsatp;
+	double *satp;              /* [nsatp][SP_N][2] */
+	unsigned char *satp_ok;    /* [nsatp-1] */
+
+	const PureFluid *P;        /* only used while building */
+};
+
+#define TRHO(T,I,J,Q) ((T)->trho + ((((I)*(T)->spec.nrho + (J))*TQ_N + (Q))*4))
+#define PH(T,I,J,Q) ((T)->ph + ((((I)*(T)->spec.nh + (J))*PQ_N + (Q))*4))
+#define SATT(T,I,Q) ((T)->satT + (((I)*ST_N + (Q))*2))
+#define SATP(T,I,Q) ((T)->satp + (((I)*SP_N + (Q))*2))
+
+/* is a within tol of b, relative to b or to 'scale' if that's bigger? */
+static int table_close(double a, double b, double scale, double tol){
+	return fabs(a - b) <= tol * fmax(fabs(b), scale);
+}
+
+/*------------------------------------------------------------------------------
+  INTERPOLATION
+*/
+
+/**
+	Cubic Hermite basis functions at u in [0,1], {h00, h10, h01, h11}, with
+	the ones that multiply derivatives scaled by the interval width d.
+*/
+static void hermite(double u, double d, double a[4]){
+	double u2 = u*u, u3 = u2*u;
+	a[0] = 2*u3 - 3*u2 + 1;
+	a[1] = (u3 - 2*u2 + u) * d;
+	a[2] = 3*u2 - 2*u3;
+	a[3] = (u3 - u2) * d;
+}
+
+/** interpolate {f, f_x} between nodes n0 and n1 */
+static double cubic(const double *n0, const double *n1, const double a[4]){
+	return a[0]*n0[0] + a[1]*n0[1] + a[2]*n1[0] + a[3]*n1[1];
+}
+
+/**
+	Interpolate {f, f_x, f_y, f_xy} over a cell with corners n00 (x0,y0),
+	n10 (x1,y0), n01 (x0,y1) and n11 (x1,y1).
+*/
+static double bicubic(const double *n00, const double *n10, const double *n01, const double *n11
+		, const double a[4], const double b[4]
+){
+	return a[0]*(b[0]*n00[0] + b[1]*n00[2]) + a[1]*(b[0]*n00[1] + b[1]*n00[3])
+		+ a[2]*(b[0]*n10[0] + b[1]*n10[2]) + a[3]*(b[0]*n10[1] + b[1]*n10[3])
+		+ a[0]*(b[2]*n01[0] + b[3]*n01[2]) + a[1]*(b[2]*n01[1] + b[3]*n01[3])
+		+ a[2]*(b[2]*n11[0] + b[3]*n11[2]) + a[3]*(b[2]*n11[1] + b[3]*n11[3]);
+}
+
+/**
+	Find the interval of a uniform grid of n points from x0 with spacing dx
+	that contains x.
+	@return 0 if x is on the grid, with *i the interval and *u the fraction of
+	the way across it.
+*/
+static int table_locate(double x, double x0, double dx, unsigned n, unsigned *i, double *u){
+	double r = (x - x0) / dx;
+	if(!(r >= 0 && r <= n - 1))return 1; /* also catches NaN */
+	*i = (unsigned)r;
+	if(*i >= n - 1)*i = n - 2;
+	*u = r - *i;
+	return 0;
+}
+
+/* saturation state at T from the saturation interval i of the (T,rho) table */
+static void table_satT_eval(const PropTable *t, unsigned i, double u, double *lnp
+		, double *lnrhof, double *lnrhog, double *hf, double *hg, double *sf, double *sg
+){
+	double a[4];
+	hermite(u, t->dT, a);
+#define C(Q) cubic(SATT(t,i,Q), SATT(t,i+1,Q), a)
+	*lnp = C(ST_LNP);
+	*lnrhof = C(ST_LNRHOF); *lnrhog = C(ST_LNRHOG);
+	if(hf){*hf = C(ST_HF); *hg = C(ST_HG);}
+	if(sf){*sf = C(ST_SF); *sg = C(ST_SG);}
+#undef C
+}
+
+/* saturation state at p from the saturation interval i of the (p,h) table */
+static void table_satp_eval(const PropTable *t, unsigned i, double u, double *T
+		, double *lnrhof, double *lnrhog, double *hf, double *hg
+){
+	double a[4];
+	hermite(u, t->dlp, a);
+#define C(Q) cubic(SATP(t,i,Q), SATP(t,i+1,Q), a)
+	*T = C(SP_T);
+	*lnrhof = C(SP_LNRHOF); *lnrhog = C(SP_LNRHOG);
+	if(hf){*hf = C(SP_HF); *hg = C(SP_HG);}
+#undef C
+}
+
+/*------------------------------------------------------------------------------
+  LOOKUPS
+*/
+
+int fprops_table_sat_T(const PropTable *t, double T, double *psat, double *rhof, double *rhog){
+	unsigned i;
+	double u, lnp, lnrhof, lnrhog;
+	if(t->nsatT < 2 || table_locate(T, t->spec.T_min, t->dT, t->nsatT, &i, &u))return 1;
+	if(!t->satT_ok[i])return 1;
+	table_satT_eval(t, i, u, &lnp, &lnrhof, &lnrhog, NULL, NULL, NULL, NULL);
+	*psat = exp(lnp);
+	*rhof = exp(lnrhof);
+	*rhog = exp(lnrhog);
+	return 0;
+}
+
+int fprops_table_sat_p(const PropTable *t, double p, double *Tsat, double *rhof, double *rhog){
+	unsigned i;
+	double u, lnrhof, lnrhog;
+	if(t->nsatp < 2 || table_locate(log(p), t->lp_min, t->dlp, t->nsatp, &i, &u))return 1;
+	if(!t->satp_ok[i])return 1;
+	table_satp_eval(t, i, u, Tsat, &lnrhof, &lnrhog, NULL, NULL);
+	*rhof = exp(lnrhof);
+	*rhog = exp(lnrhog);
+	return 0;
+}
+
+int fprops_table_Trho(const PropTable *t, double T, double rho, double *p, double *h, double *s){
+	unsigned i, j;
+	double u, v, a[4], b[4];
+	if(table_locate(T, t->spec.T_min, t->dT, t->spec.nT, &i, &u))return 1;
+	if(table_locate(log(rho), t->lrho_min, t->dlrho, t->spec.nrho, &j, &v))return 1;
+
+	switch(t->trho_cell[i*(t->spec.nrho - 1) + j]){
+	case CELL_SINGLE:
+		hermite(u, t->dT, a);
+		hermite(v, t->dlrho, b);
+#define B(Q) bicubic(TRHO(t,i,j,Q), TRHO(t,i+1,j,Q), TRHO(t,i,j+1,Q), TRHO(t,i+1,j+1,Q), a, b)
+		*p = B(TQ_P);
+		*h = B(TQ_H);
+		*s = B(TQ_S);
+#undef B
+		return 0;
+	case CELL_TWOPHASE:
+	case CELL_MIXED:{
+		double lnp, lnrhof, lnrhog, hf, hg, sf, sg;
+		if(!t->satT_ok[i])return 1;
+		table_satT_eval(t, i, u, &lnp, &lnrhof, &lnrhog, &hf, &hg, &sf, &sg);
+		double rhof = exp(lnrhof), rhog = exp(lnrhog);
+		if(rhog < rho && rho < rhof){
+			double x = rhog * (rhof/rho - 1) / (rhof - rhog);
+			*p = exp(lnp);
+			*h = x*hg + (1-x)*hf;
+			*s = x*sg + (1-x)*sf;
+			return 0;
+		}
+		return 1;
+	}
+	default:
+		return 1;
+	}
+}
+
+int fprops_table_ph(const PropTable *t, double p, double h, double *T, double *rho){
+	unsigned i, j;
+	double u, v, a[4], b[4];
+	if(table_locate(log(p), t->lp_min, t->dlp, t->spec.np, &i, &u))return 1;
+	if(table_locate(h, t->spec.h_min, t->dh, t->spec.nh, &j, &v))return 1;
+
+	switch(t->ph_cell[i*(t->spec.nh - 1) + j]){
+	case CELL_SINGLE:
+		hermite(u, t->dlp, a);
+		hermite(v, t->dh, b);
+#define B(Q) bicubic(PH(t,i,j,Q), PH(t,i+1,j,Q), PH(t,i,j+1,Q), PH(t,i+1,j+1,Q), a, b)
+		*T = B(PQ_T);
+		*rho = exp(B(PQ_LNRHO));
+#undef B
+		return 0;
+	case CELL_TWOPHASE:
+	case CELL_MIXED:{
+		double Tsat, lnrhof, lnrhog, hf, hg;
+		if(!t->satp_ok[i])return 1;
+		table_satp_eval(t, i, u, &Tsat, &lnrhof, &lnrhog, &hf, &hg);
+		if(hf <= h && h <= hg){
+			double x = (h - hf) / (hg - hf);
+			*T = Tsat;
+			*rho = 1. / (x/exp(lnrhog) + (1 - x)/exp(lnrhof));
+			return 0;
+		}
+		return 1;
+	}
+	default:
+		return 1;
+	}
+}
+
+/*------------------------------------------------------------------------------
+  BUILDING THE TABLE
+*/
+
+/**
+	Fill in the defaults of a spec for fluid P.
+*/
+static void table_spec_resolve(const PureFluid *P, const PropTableSpec *spec, PropTableSpec *S, FpropsError *err){
+	const FluidData *d = P->data;
+	double p_t, rhof_t, rhog_t;
+	PropTableSpec def = {0};
+	*S = spec ? *spec : def;
+
+	fprops_triple_point(&p_t, &rhof_t, &rhog_t, P, err);
+	if(*err){
+		ERRMSG("Unable to calculate the triple point of '%s'",P->name);
+		return;
+	}
+
+	if(S->T_min < d->T_t)S->T_min = d->T_t;
+	if(S->T_max == 0)S->T_max = 2 * d->T_c;
+	if(S->p_min == 0)S->p_min = p_t;
+	if(S->p_max == 0)S->p_max = 5 * d->p_c;
+	if(S->rho_min == 0)S->rho_min = 0.5 * S->p_min / (d->R * S->T_max);
+	if(S->rho_max == 0)S->rho_max = 1.1 * rhof_t;
+	if(S->h_min == 0)S->h_min = P->h_fn(d->T_t, rhof_t, d, err);
+	if(S->h_max == 0)S->h_max = P->h_fn(S->T_max, S->rho_min, d, err);
+	if(S->nT == 0)S->nT = 200;
+	if(S->nrho == 0)S->nrho = 200;
+	if(S->np == 0)S->np = 200;
+	if(S->nh == 0)S->nh = 200;
+	if(S->tol == 0)S->tol = 1e-6;
+
+	if(*err || S->nT < 2 || S->nrho < 2 || S->np < 2 || S->nh < 2
+		|| !(S->T_min < S->T_max && 0 < S->rho_min && S->rho_min < S->rho_max
+			&& 0 < S->p_min && S->p_min < S->p_max && S->h_min < S->h_max)
+	){
+		ERRMSG("Invalid property table spec for '%s'",P->name);
+		*err = FPROPS_INVALID_REQUEST;
+	}
+}
+
+/* p, h, s at a few states, which change if the EOS or reference state does */
+static void table_probe(const PureFluid *P, double probe[TABLE_NPROBE]){
+	const FluidData *d = P->data;
+	double T[3] = {1.2 * d->T_c, 1.5 * d->T_c, 2 * d->T_c};
+	double rho[3] = {0.1 * d->rho_c, d->rho_c, 2 * d->rho_c};
+	int k;
+	for(k = 0; k < 3; ++k){
+		FpropsError err = FPROPS_NO_ERROR;
+		probe[3*k] = P->p_fn(T[k], rho[k], d, &err);
+		probe[3*k + 1] = P->h_fn(T[k], rho[k], d, &err);
+		probe[3*k + 2] = P->s_fn(T[k], rho[k], d, &err);
+	}
+}
+
+/* set up a table of the right size for spec S, or NULL if out of memory */
+static PropTable *table_alloc(const PureFluid *P, const PropTableSpec *S){
+	PropTable *t = FPROPS_NEW(PropTable);
+	unsigned i;
+	if(t == NULL)return NULL;
+	t->spec = *S;
+	memset(t->name, 0, TABLE_NAMELEN);
+	strncpy(t->name, P->name, TABLE_NAMELEN - 1);
+	table_probe(P, t->probe);
+	t->T_c = P->data->T_c;
+	t->p_c = P->data->p_c;
+	t->R = P->data->R;
+	t->P = P;
+
+	t->dT = (S->T_max - S->T_min) / (S->nT - 1);
+	t->lrho_min = log(S->rho_min);
+	t->dlrho = (log(S->rho_max) - t->lrho_min) / (S->nrho - 1);
+	t->lp_min = log(S->p_min);
+	t->dlp = (log(S->p_max) - t->lp_min) / (S->np - 1);
+	t->dh = (S->h_max - S->h_min) / (S->nh - 1);
+
+	/* rows below the critical point have a saturation state */
+	for(i = 0; i < S->nT && S->T_min + i * t->dT < t->T_c; ++i);
+	t->nsatT = i;
+	for(i = 0; i < S->np && exp(t->lp_min + i * t->dlp) < t->p_c; ++i);
+	t->nsatp = i;
+
+	t->trho = FPROPS_NEW_ARRAY(double, S->nT * S->nrho * TQ_N * 4);
+	t->trho_node = FPROPS_NEW_ARRAY(signed char, S->nT * S->nrho);
+	t->trho_cell = FPROPS_NEW_ARRAY(unsigned char, (S->nT - 1) * (S->nrho - 1));
+	t->satT = FPROPS_NEW_ARRAY(double, (t->nsatT + 1) * ST_N * 2);
+	t->satT_ok = FPROPS_NEW_ARRAY(unsigned char, t->nsatT + 1);
+	t->ph = FPROPS_NEW_ARRAY(double, S->np * S->nh * PQ_N * 4);
+	t->ph_node = FPROPS_NEW_ARRAY(signed char, S->np * S->nh);
+	t->ph_cell = FPROPS_NEW_ARRAY(unsigned char, (S->np - 1) * (S->nh - 1));
+	t->satp = FPROPS_NEW_ARRAY(double, (t->nsatp + 1) * SP_N * 2);
+	t->satp_ok = FPROPS_NEW_ARRAY(unsigned char, t->nsatp + 1);
+	if(!t->trho || !t->trho_node || !t->trho_cell || !t->satT || !t->satT_ok
+		|| !t->ph || !t->ph_node || !t->ph_cell || !t->satp || !t->satp_ok
+	){
+		fprops_table_destroy(t);
+		return NULL;
+	}
+	memset(t->satT_ok, 0, t->nsatT + 1);
+	memset(t->satp_ok, 0, t->nsatp + 1);
+	return t;
+}
+
+void fprops_table_destroy(PropTable *t){
+	if(t == NULL)return;
+	free(t->trho); free(t->trho_node); free(t->trho_cell);
+	free(t->satT); free(t->satT_ok);
+	free(t->ph); free(t->ph_node); free(t->ph_cell);
+	free(t->satp); free(t->satp_ok);
+	FPROPS_FREE(t);
+}
+
+/**
+	Solve for (T, rho) at (p, h) by Newton's method on ln p and h in
+	(T, ln rho), from a guess close to the solution, such as a neighbouring
+	node. Cheaper than fprops_solve_ph, which has to find the saturation
+	state first.
+	@return 0 on convergence
+*/
+static int table_newton_ph(const PureFluid *P, double p, double h, double *T, double *rho){
+	const FluidData *d = P->data;
+	double T1 = *T, lr = log(*rho), hs = d->R * d->T_c;
+	int n;
+	for(n = 0; n < 50; ++n){
+		HelmholtzDerivs D;
+		FpropsError err = FPROPS_NO_ERROR;
+		double rho1 = exp(lr);
+		helmholtz_derivs(T1, rho1, d, &D);
+		double p1 = helmholtz_p_derivs(&D, d, &err);
+		double h1 = helmholtz_h_derivs(&D, d, &err);
+		if(err || !(p1 > 0))return 1;
+		/* residuals and their derivatives wrt T and ln rho */
+		double f = log(p1 / p), g = (h1 - h) / hs;
+		double f_T = helmholtz_dpdT_rho_derivs(&D, d, &err) / p1;
+		double f_lr = rho1 * helmholtz_dpdrho_T_derivs(&D, d, &err) / p1;
+		double g_T = helmholtz_dhdT_rho_derivs(&D, d, &err) / hs;
+		double g_lr = rho1 * helmholtz_dhdrho_T_derivs(&D, d, &err) / hs;
+		double det = f_T * g_lr - f_lr * g_T;
+		if(err || det == 0 || isnan(det))return 1;
+		double dT = -(g_lr * f - f_lr * g) / det;
+		double dlr = -(f_T * g - g_T * f) / det;
+		/* limit the step */
+		double lim = fmax(fabs(dT) / (0.2 * T1), fabs(dlr) / 0.5);
+		if(lim > 1){
+			dT /= lim;
+			dlr /= lim;
+		}
+		T1 += dT;
+		lr += dlr;
+		if(fabs(dT) < 1e-12 * T1 && fabs(dlr) < 1e-12){
+			*T = T1;
+			*rho = exp(lr);
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/**
+	Derivatives of T and ln rho wrt ln p and h at (T, rho), by inverting the
+	Jacobian of (ln p, h) wrt (T, ln rho).
+	@return 0 on success, non-zero if (T, rho) is mechanically unstable
+*/
+static int table_ph_node(const PureFluid *P, double T, double rho, double *nT, double *nlr){
+	const FluidData *d = P->data;
+	HelmholtzDerivs D;
+	FpropsError err = FPROPS_NO_ERROR;
+	helmholtz_derivs(T, rho, d, &D);
+	double p = helmholtz_p_derivs(&D, d, &err);
+	double p_T = helmholtz_dpdT_rho_derivs(&D, d, &err) / p;
+	double p_lr = rho * helmholtz_dpdrho_T_derivs(&D, d, &err) / p;
+	double h_T = helmholtz_dhdT_rho_derivs(&D, d, &err);
+	double h_lr = rho * helmholtz_dhdrho_T_derivs(&D, d, &err);
+	double det = p_T * h_lr - p_lr * h_T;
+	if(err || !(p_lr > 0) || det == 0 || isnan(det))return 1;
+	nT[0] = T;
+	nT[1] = h_lr / det;
+	nT[2] = -p_lr / det;
+	nT[3] = 0;
+	nlr[0] = log(rho);
+	nlr[1] = -h_T / det;
+	nlr[2] = p_T / det;
+	nlr[3] = 0;
+	return 0;
+}
+
+/**
+	The saturation state at T, given psat, rhof and rhog there, as
+	v = {ln psat, ln rhof, ln rhog, hf, hg, sf, sg} (indexed by ST_*), with its
+	derivatives dv along the saturation curve wrt T (see fprops_sat_slopes).
+	@return 0 on success
+*/
+static int table_sat_state(const PureFluid *P, double T, double psat, double rhof, double rhog
+		, double v[ST_N], double dv[ST_N]
+){
+	SatSlopes S;
+	if(fprops_sat_slopes(P, T, psat, rhof, rhog, &S))return 1;
+	v[ST_LNP] = log(psat);
+	v[ST_LNRHOF] = log(rhof);
+	v[ST_LNRHOG] = log(rhog);
+	v[ST_HF] = S.hf; v[ST_HG] = S.hg;
+	v[ST_SF] = S.sf; v[ST_SG] = S.sg;
+	dv[ST_LNP] = S.dpsat / psat;
+	dv[ST_LNRHOF] = S.drhof / rhof;
+	dv[ST_LNRHOG] = S.drhog / rhog;
+	dv[ST_HF] = S.dhf; dv[ST_HG] = S.dhg;
+	dv[ST_SF] = S.dsf; dv[ST_SG] = S.dsg;
+	return 0;
+}
+
+/**
+	Nodes along row i of the (T, ln rho) table, and the saturation state at
+	that temperature if it's below T_c.
+*/
+static void table_trho_row(PropTable *t, unsigned i){
+	const PureFluid *P = t->P;
+	const FluidData *d = P->data;
+	double T = t->spec.T_min + i * t->dT;
+	double rhof = 0, rhog = 0;
+	unsigned j;
+
+	if(i < t->nsatT){
+		FpropsError err = FPROPS_NO_ERROR;
+		double psat, v[ST_N], dv[ST_N];
+		unsigned q;
+		fprops_sat_T(T, &psat, &rhof, &rhog, P, &err);
+		if(err || table_sat_state(P, T, psat, rhof, rhog, v, dv)){
+			ERRMSG("Unable to solve saturation at T = %f for '%s'",T,P->name);
+			/* no interval either side of this one can be used */
+			SATT(t,i,ST_LNP)[0] = NAN;
+			rhof = rhog = 0;
+		}else{
+			for(q = 0; q < ST_N; ++q){
+				SATT(t,i,q)[0] = v[q];
+				SATT(t,i,q)[1] = dv[q];
+			}
+		}
+	}
+
+	for(j = 0; j < t->spec.nrho; ++j){
+		double rho = exp(t->lrho_min + j * t->dlrho);
+		HelmholtzDerivs D;
+		FpropsError err = FPROPS_NO_ERROR;
+		double *np = TRHO(t,i,j,TQ_P), *nh = TRHO(t,i,j,TQ_H), *ns = TRHO(t,i,j,TQ_S);
+		helmholtz_derivs(T, rho, d, &D);
+		np[0] = helmholtz_p_derivs(&D, d, &err);
+		np[1] = helmholtz_dpdT_rho_derivs(&D, d, &err);
+		np[2] = rho * helmholtz_dpdrho_T_derivs(&D, d, &err);
+		nh[0] = helmholtz_h_derivs(&D, d, &err);
+		nh[1] = helmholtz_dhdT_rho_derivs(&D, d, &err);
+		nh[2] = rho * helmholtz_dhdrho_T_derivs(&D, d, &err);
+		ns[0] = helmholtz_s_derivs(&D, d, &err);
+		ns[1] = helmholtz_cv_derivs(&D, d, &err) / T;
+		ns[2] = -np[1] / rho; /* Maxwell relation */
+		np[3] = nh[3] = ns[3] = 0;
+		if(err || isnan(np[0] + np[1] + np[2] + nh[0] + nh[1] + nh[2] + ns[0] + ns[1])){
+			t->trho_node[i*t->spec.nrho + j] = NODE_FAILED;
+		}else if(rhog < rho && rho < rhof){
+			t->trho_node[i*t->spec.nrho + j] = NODE_TWOPHASE;
+		}else{
+			t->trho_node[i*t->spec.nrho + j] = NODE_SINGLE;
+		}
+	}
+}
+
+/**
+	Nodes along row i of the (ln p, h) table, and the saturation state at
+	that pressure if it's below p_c. Each single-phase node is found by
+	Newton's method from the one before it on the same side of the
+	saturation curve, falling back to fprops_solve_ph_quiet.
+*/
+static void table_ph_row(PropTable *t, unsigned i){
+	const PureFluid *P = t->P;
+	double p = exp(t->lp_min + i * t->dlp);
+	double Tsat = 0, rhof = 0, rhog = 0, hf = 0, hg = 0;
+	double T1 = 0, rho1 = 0;
+	int sat = 0, side = -1, guess = 0;
+	unsigned j;
+
+	if(i < t->nsatp){
+		FpropsError err = FPROPS_NO_ERROR;
+		double v[ST_N], dv[ST_N];
+		fprops_sat_p(p, &Tsat, &rhof, &rhog, P, &err);
+		if(err || table_sat_state(P, Tsat, p, rhof, rhog, v, dv)){
+			ERRMSG("Unable to solve saturation at p = %f for '%s'",p,P->name);
+			SATP(t,i,SP_T)[0] = NAN;
+		}else{
+			/* derivatives wrt ln p, along the saturation curve */
+			double dT = 1 / dv[ST_LNP];
+			sat = 1;
+			hf = v[ST_HF];
+			hg = v[ST_HG];
+			SATP(t,i,SP_T)[0] = Tsat;
+			SATP(t,i,SP_T)[1] = dT;
+#define S(SP,ST) SATP(t,i,SP)[0] = v[ST]; SATP(t,i,SP)[1] = dv[ST] * dT
+			S(SP_LNRHOF, ST_LNRHOF); S(SP_LNRHOG, ST_LNRHOG);
+			S(SP_HF, ST_HF); S(SP_HG, ST_HG);
+#undef S
+		}
+	}
+
+	for(j = 0; j < t->spec.nh; ++j){
+		double h = t->spec.h_min + j * t->dh;
+		double *nT = PH(t,i,j,PQ_T), *nlr = PH(t,i,j,PQ_LNRHO);
+		signed char *node = &(t->ph_node[i*t->spec.nh + j]);
+		int side1 = 0;
+		if(sat){
+			if(hf <= h && h <= hg){
+				double x = (h - hf) / (hg - hf);
+				memset(nT, 0, 4*sizeof(double));
+				memset(nlr, 0, 4*sizeof(double));
+				nT[0] = Tsat;
+				nlr[0] = -log(x/rhog + (1 - x)/rhof);
+				*node = NODE_TWOPHASE;
+				continue;
+			}
+			side1 = (h > hg);
+			if(side1 != side){
+				/* the first vapour node is close to the saturated vapour;
+				the first liquid node could be far from saturation */
+				T1 = Tsat;
+				rho1 = rhog;
+				guess = side1;
+			}
+		}
+		side = side1;
+
+		*node = NODE_FAILED;
+		if(!guess || table_newton_ph(P, p, h, &T1, &rho1)){
+			FpropsError err = FPROPS_NO_ERROR;
+			/* failures are counted at the end of fprops_table_build */
+			fprops_solve_ph_quiet(p, h, &T1, &rho1, 0, P, &err);
+			guess = 0;
+			if(err)continue;
+		}
+		/* make sure we haven't landed on the wrong side of the saturation
+		curve, or on a metastable or unstable state */
+		if((sat && (side ? T1 < Tsat * (1 - 1e-9) || rho1 > rhog * (1 + 1e-9)
+				: T1 > Tsat * (1 + 1e-9) || rho1 < rhof * (1 - 1e-9)))
+			|| table_ph_node(P, T1, rho1, nT, nlr)
+		){
+			guess = 0;
+			continue;
+		}
+		*node = NODE_SINGLE;
+		guess = 1;
+	}
+}
+
+/**
+	Cross derivatives f_xy of the nodes of a 2D table, as differences of f_x
+	along y and of f_y along x, between single-phase nodes only.
+*/
+static void table_cross_derivs(double *tab, const signed char *node, unsigned nx, unsigned ny
+		, unsigned nq, double dx, double dy
+){
+#define N(I,J,Q) (tab + ((((I)*ny + (J))*nq + (Q))*4))
+#define OK(I,J) (node[(I)*ny + (J)] == NODE_SINGLE)
+	unsigned i, j, q;
+	for(i = 0; i < nx; ++i){
+		for(j = 0; j < ny; ++j){
+			if(!OK(i,j))continue;
+			for(q = 0; q < nq; ++q){
+				double sum = 0;
+				int n = 0;
+				int jm = j > 0 && OK(i,j-1), jp = j + 1 < ny && OK(i,j+1);
+				int im = i > 0 && OK(i-1,j), ip = i + 1 < nx && OK(i+1,j);
+				if(jm && jp){sum += (N(i,j+1,q)[1] - N(i,j-1,q)[1]) / (2*dy); n++;}
+				else if(jp){sum += (N(i,j+1,q)[1] - N(i,j,q)[1]) / dy; n++;}
+				else if(jm){sum += (N(i,j,q)[1] - N(i,j-1,q)[1]) / dy; n++;}
+				if(im && ip){sum += (N(i+1,j,q)[2] - N(i-1,j,q)[2]) / (2*dx); n++;}
+				else if(ip){sum += (N(i+1,j,q)[2] - N(i,j,q)[2]) / dx; n++;}
+				else if(im){sum += (N(i,j,q)[2] - N(i-1,j,q)[2]) / dx; n++;}
+				N(i,j,q)[3] = n ? sum / n : 0;
+			}
+		}
+	}
+#undef N
+#undef OK
+}
+
+/**
+	Kind of a cell spanning [y0, y1] between two rows, given the saturated
+	liquid values f0, f1 and vapour values g0, g1 of y on those rows, y being
+	ln rho if 'dens' and h otherwise. 'margin' allows for the saturation curve
+	bending between the rows. Unless the saturation state across the rows is
+	known ('sat'), the cell can't be classified.
+*/
+static int table_classify(int sat, int dens, double f0, double f1, double g0, double g1
+		, double y0, double y1, double margin
+){
+	double lo, hi, f_lo = fmin(f0,f1), f_hi = fmax(f0,f1), g_lo = fmin(g0,g1), g_hi = fmax(g0,g1);
+	if(!sat)return CELL_EOS;
+	if(dens){
+		/* y is ln rho: liquid above f, vapour below g */
+		if(y0 > f_hi + margin || y1 < g_lo - margin)return CELL_SINGLE;
+		lo = g_hi; hi = f_lo;
+	}else{
+		/* y is h: liquid below f, vapour above g */
+		if(y1 < f_lo - margin || y0 > g_hi + margin)return CELL_SINGLE;
+		lo = f_hi; hi = g_lo;
+	}
+	if(y0 > lo + margin && y1 < hi - margin)return CELL_TWOPHASE;
+	return CELL_MIXED;
+}
+
+/**
+	Check saturation interval i and classify and check the cells in row i of
+	the (T, ln rho) table.
+*/
+static void table_trho_check(PropTable *t, unsigned i){
+	const PureFluid *P = t->P;
+	const FluidData *d = P->data;
+	const PropTableSpec *S = &(t->spec);
+	double T0 = S->T_min + i * t->dT, T1 = T0 + t->dT, Tm = T0 + 0.5 * t->dT;
+	double hs = t->R * t->T_c;
+	int sat = 0, above = (T0 >= t->T_c);
+	unsigned j;
+
+	if(i + 1 < t->nsatT && !isnan(SATT(t,i,ST_LNP)[0]) && !isnan(SATT(t,i+1,ST_LNP)[0])){
+		FpropsError err = FPROPS_NO_ERROR;
+		double psat, rhof, rhog, lnp, lnrhof, lnrhog, hf, hg, sf, sg;
+		fprops_sat_T(Tm, &psat, &rhof, &rhog, P, &err);
+		table_satT_eval(t, i, 0.5, &lnp, &lnrhof, &lnrhog, &hf, &hg, &sf, &sg);
+		sat = !err && table_close(exp(lnp), psat, 0, S->tol)
+			&& table_close(exp(lnrhof), rhof, 0, S->tol)
+			&& table_close(exp(lnrhog), rhog, 0, S->tol)
+			&& table_close(hf, P->h_fn(Tm, rhof, d, &err), hs, S->tol)
+			&& table_close(hg, P->h_fn(Tm, rhog, d, &err), hs, S->tol)
+			&& table_close(sf, P->s_fn(Tm, rhof, d, &err), t->R, S->tol)
+			&& table_close(sg, P->s_fn(Tm, rhog, d, &err), t->R, S->tol)
+			&& !err;
+		t->satT_ok[i] = sat;
+	}
+
+	for(j = 0; j + 1 < S->nrho; ++j){
+		unsigned char *cell = &(t->trho_cell[i*(S->nrho - 1) + j]);
+		double lr0 = t->lrho_min + j * t->dlrho, lr1 = lr0 + t->dlrho;
+		int k = above ? CELL_SINGLE : CELL_EOS;
+		if(T1 < t->T_c && i + 1 < t->nsatT){
+			k = table_classify(sat, 1
+				, SATT(t,i,ST_LNRHOF)[0], SATT(t,i+1,ST_LNRHOF)[0]
+				, SATT(t,i,ST_LNRHOG)[0], SATT(t,i+1,ST_LNRHOG)[0]
+				, lr0, lr1, 0.25 * t->dlrho
+			);
+		}
+		if(k == CELL_SINGLE){
+			/* all corners single-phase, and the centre within tolerance */
+			unsigned n = S->nrho;
+			if(t->trho_node[i*n + j] != NODE_SINGLE || t->trho_node[i*n + j+1] != NODE_SINGLE
+				|| t->trho_node[(i+1)*n + j] != NODE_SINGLE || t->trho_node[(i+1)*n + j+1] != NODE_SINGLE
+			){
+				k = CELL_EOS;
+			}else{
+				FpropsError err = FPROPS_NO_ERROR;
+				double p, h, s, rho = exp(lr0 + 0.5 * t->dlrho);
+				HelmholtzDerivs D;
+				*cell = CELL_SINGLE;
+				fprops_table_Trho(t, Tm, rho, &p, &h, &s);
+				helmholtz_derivs(Tm, rho, d, &D);
+				if(!(table_close(p, helmholtz_p_derivs(&D, d, &err), 0, S->tol)
+					&& table_close(h, helmholtz_h_derivs(&D, d, &err), hs, S->tol)
+					&& table_close(s, helmholtz_s_derivs(&D, d, &err), t->R, S->tol)
+					&& !err
+				))k = CELL_EOS;
+			}
+		}
+		*cell = k;
+	}
+}
+
+/**
+	Check saturation interval i and classify and check the cells in row i of
+	the (ln p, h) table.
+*/
+static void table_ph_check(PropTable *t, unsigned i){
+	const PureFluid *P = t->P;
+	const FluidData *d = P->data;
+	const PropTableSpec *S = &(t->spec);
+	double lp0 = t->lp_min + i * t->dlp, pm = exp(lp0 + 0.5 * t->dlp);
+	double hs = t->R * t->T_c;
+	int sat = 0, above = (exp(lp0) >= t->p_c);
+	unsigned j;
+
+	if(i + 1 < t->nsatp && !isnan(SATP(t,i,SP_T)[0]) && !isnan(SATP(t,i+1,SP_T)[0])){
+		FpropsError err = FPROPS_NO_ERROR;
+		double Tsat, rhof, rhog, T, lnrhof, lnrhog, hf, hg;
+		fprops_sat_p(pm, &Tsat, &rhof, &rhog, P, &err);
+		table_satp_eval(t, i, 0.5, &T, &lnrhof, &lnrhog, &hf, &hg);
+		sat = !err && table_close(T, Tsat, 0, S->tol)
+			&& table_close(exp(lnrhof), rhof, 0, S->tol)
+			&& table_close(exp(lnrhog), rhog, 0, S->tol)
+			&& table_close(hf, P->h_fn(Tsat, rhof, d, &err), hs, S->tol)
+			&& table_close(hg, P->h_fn(Tsat, rhog, d, &err), hs, S->tol)
+			&& !err;
+		t->satp_ok[i] = sat;
+	}
+
+	for(j = 0; j + 1 < S->nh; ++j){
+		unsigned char *cell = &(t->ph_cell[i*(S->nh - 1) + j]);
+		double h0 = S->h_min + j * t->dh, h1 = h0 + t->dh;
+		int k = above ? CELL_SINGLE : CELL_EOS;
+		if(i + 1 < t->nsatp){
+			k = table_classify(sat, 0
+				, SATP(t,i,SP_HF)[0], SATP(t,i+1,SP_HF)[0]
+				, SATP(t,i,SP_HG)[0], SATP(t,i+1,SP_HG)[0]
+				, h0, h1, 0.25 * t->dh
+			);
+		}
+		if(k == CELL_SINGLE){
+			unsigned n = S->nh;
+			if(t->ph_node[i*n + j] != NODE_SINGLE || t->ph_node[i*n + j+1] != NODE_SINGLE
+				|| t->ph_node[(i+1)*n + j] != NODE_SINGLE || t->ph_node[(i+1)*n + j+1] != NODE_SINGLE
+			){
+				k = CELL_EOS;
+			}else{
+				/* refine the interpolated state to the EOS solution */
+				double hm = h0 + 0.5 * t->dh, T, rho, T1, rho1;
+				*cell = CELL_SINGLE;
+				fprops_table_ph(t, pm, hm, &T, &rho);
+				T1 = T;
+				rho1 = rho;
+				if(table_newton_ph(P, pm, hm, &T1, &rho1)
+					|| !table_close(T, T1, 0, S->tol) || !table_close(rho, rho1, 0, S->tol)
+				)k = CELL_EOS;
+			}
+		}
+		*cell = k;
+	}
+}
+
+/* work on rows of the table, shared out between threads */
+
+typedef void TableRowFn(PropTable *t, unsigned i);
+
+typedef struct{
+	PropTable *t;
+	TableRowFn *fn1, *fn2; /* fn1 for rows 0..n1-1, fn2 for the rest */
+	unsigned n1, n, next;
+#ifdef FPROPS_WITH_THREADS
+	pthread_mutex_t lock;
+#endif
+} TableWork;
+
+static void *table_worker(void *user){
+	TableWork *W = (TableWork *)user;
+	for(;;){
+		unsigned i;
+#ifdef FPROPS_WITH_THREADS
+		pthread_mutex_lock(&W->lock);
+#endif
+		i = W->next++;
+#ifdef FPROPS_WITH_THREADS
+		pthread_mutex_unlock(&W->lock);
+#endif
+		if(i >= W->n)break;
+		if(i < W->n1)(*W->fn1)(W->t, i);
+		else (*W->fn2)(W->t, i - W->n1);
+	}
+	return NULL;
+}
+
+/**
+	Run fn1 on rows 0..n1-1 and fn2 on rows 0..n2-1, using up to nthreads
+	threads. Rows are handed out one at a time, as they take very different
+	times to do.
+*/
+static void table_rows(PropTable *t, TableRowFn *fn1, unsigned n1, TableRowFn *fn2, unsigned n2, int nthreads){
+	TableWork W = {t, fn1, fn2, n1, n1 + n2, 0};
+#ifdef FPROPS_WITH_THREADS
+	pthread_t *th;
+	int k, nt = 0;
+	if(nthreads <= 0)nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if(nthreads > 1 && (th = FPROPS_NEW_ARRAY(pthread_t, nthreads - 1))){
+		pthread_mutex_init(&W.lock, NULL);
+		for(k = 0; k < nthreads - 1; ++k){
+			if(pthread_create(&th[nt], NULL, &table_worker, &W))break;
+			nt++;
+		}
+		table_worker(&W);
+		for(k = 0; k < nt; ++k)pthread_join(th[k], NULL);
+		pthread_mutex_destroy(&W.lock);
+		FPROPS_FREE(th);
+		return;
+	}
+	pthread_mutex_init(&W.lock, NULL);
+	table_worker(&W);
+	pthread_mutex_destroy(&W.lock);
+#else
+	(void)nthreads;
+	table_worker(&W);
+#endif
+}
+
+PropTable *fprops_table_build(const PureFluid *P, const PropTableSpec *spec, FpropsError *err){
+	PropTableSpec S;
+	PropTable *t;
+	unsigned i, n[4] = {0,0,0,0};
+
+	if(P->type != FPROPS_HELMHOLTZ){
+		ERRMSG("Property tables are only available for Helmholtz fluids ('%s' is type %d)",P->name,P->type);
+		*err = FPROPS_INVALID_REQUEST;
+		return NULL;
+	}
+	/* this also caches the triple point (see fprops_triple_point) before any threads start */
+	table_spec_resolve(P, spec, &S, err);
+	if(*err)return NULL;
+
+	t = table_alloc(P, &S);
+	if(t == NULL){
+		ERRMSG("Out of memory for property table of '%s'",P->name);
+		*err = FPROPS_INVALID_REQUEST;
+		return NULL;
+	}
+
+	MSG("Building %ux%u (T,rho) and %ux%u (p,h) tables for '%s'",S.nT,S.nrho,S.np,S.nh,P->name);
+	table_rows(t, &table_trho_row, S.nT, &table_ph_row, S.np, S.nthreads);
+	table_cross_derivs(t->trho, t->trho_node, S.nT, S.nrho, TQ_N, t->dT, t->dlrho);
+	table_cross_derivs(t->ph, t->ph_node, S.np, S.nh, PQ_N, t->dlp, t->dh);
+	table_rows(t, &table_trho_check, S.nT - 1, &table_ph_check, S.np - 1, S.nthreads);
+	t->P = NULL;
+
+	for(i = 0; i < S.np * S.nh; ++i)n[0] += (t->ph_node[i] == NODE_FAILED);
+	if(n[0]){
+		ERRMSG("No (p,h) solution at %u of %u nodes for '%s'; cells next to them will use the EOS",n[0],S.np * S.nh,P->name);
+	}
+	n[0] = 0;
+	for(i = 0; i < (S.nT - 1) * (S.nrho - 1); ++i)n[t->trho_cell[i]]++;
+	MSG("(T,rho) cells: %u interpolated, %u two-phase, %u mixed, %u EOS",n[CELL_SINGLE],n[CELL_TWOPHASE],n[CELL_MIXED],n[CELL_EOS]);
+	n[0] = n[1] = n[2] = n[3] = 0;
+	for(i = 0; i < (S.np - 1) * (S.nh - 1); ++i)n[t->ph_cell[i]]++;
+	MSG("(p,h) cells: %u interpolated, %u two-phase, %u mixed, %u EOS",n[CELL_SINGLE],n[CELL_TWOPHASE],n[CELL_MIXED],n[CELL_EOS]);
+	return t;
+}
+
+/*------------------------------------------------------------------------------
+  SAVING AND LOADING
+*/
+
+/*
+	The file is a header followed by the arrays of the table, in native byte
+	order; a file from a different kind of machine is recognised by 'one' not
+	reading as 1.0, and ignored.
+*/
+typedef struct{
+	char magic[8];
+	unsigned version;
+	double one;
+	char name[TABLE_NAMELEN];
+	double range[8];
+	unsigned npts[4];
+	double tol;
+	double probe[TABLE_NPROBE];
+	unsigned nsatT, nsatp;
+} TableFileHeader;
+
+static void table_header(const PropTable *t, TableFileHeader *H){
+	const PropTableSpec *S = &(t->spec);
+	memset(H, 0, sizeof(TableFileHeader));
+	memcpy(H->magic, TABLE_MAGIC, 8);
+	H->version = TABLE_VERSION;
+	H->one = 1.0;
+	memcpy(H->name, t->name, TABLE_NAMELEN);
+	H->range[0] = S->T_min; H->range[1] = S->T_max;
+	H->range[2] = S->rho_min; H->range[3] = S->rho_max;
+	H->range[4] = S->p_min; H->range[5] = S->p_max;
+	H->range[6] = S->h_min; H->range[7] = S->h_max;
+	H->npts[0] = S->nT; H->npts[1] = S->nrho;
+	H->npts[2] = S->np; H->npts[3] = S->nh;
+	H->tol = S->tol;
+	memcpy(H->probe, t->probe, sizeof(t->probe));
+	H->nsatT = t->nsatT;
+	H->nsatp = t->nsatp;
+}
+
+#define TABLE_ARRAYS(X) \
+	X(trho, double, S->nT * S->nrho * TQ_N * 4) \
+	X(trho_node, signed char, S->nT * S->nrho) \
+	X(trho_cell, unsigned char, (S->nT - 1) * (S->nrho - 1)) \
+	X(satT, double, t->nsatT * ST_N * 2) \
+	X(satT_ok, unsigned char, t->nsatT) \
+	X(ph, double, S->np * S->nh * PQ_N * 4) \
+	X(ph_node, signed char, S->np * S->nh) \
+	X(ph_cell, unsigned char, (S->np - 1) * (S->nh - 1)) \
+	X(satp, double, t->nsatp * SP_N * 2) \
+	X(satp_ok, unsigned char, t->nsatp)
+
+int fprops_table_save(const PropTable *t, const char *filename){
+	const PropTableSpec *S = &(t->spec);
+	TableFileHeader H;
+	FILE *f = fopen(filename, "wb");
+	int res = 0;
+	if(f == NULL){
+		ERRMSG("Unable to write property table to '%s'",filename);
+		return 1;
+	}
+	table_header(t, &H);
+	res |= (fwrite(&H, sizeof(H), 1, f) != 1);
+#define X(NAME,TYPE,SIZE) res |= (fwrite(t->NAME, sizeof(TYPE), SIZE, f) != (size_t)(SIZE));
+	TABLE_ARRAYS(X)
+#undef X
+	res |= fclose(f);
+	if(res){
+		ERRMSG("Failed writing property table to '%s'",filename);
+		remove(filename);
+	}
+	return res;
+}
+
+PropTable *fprops_table_load(const PureFluid *P, const PropTableSpec *spec, const char *filename){
+	FpropsError err = FPROPS_NO_ERROR;
+	PropTableSpec S1;
+	const PropTableSpec *S = &S1;
+	TableFileHeader H, H1;
+	PropTable *t;
+	int res = 0;
+	FILE *f;
+
+	if(P->type != FPROPS_HELMHOLTZ)return NULL;
+	table_spec_resolve(P, spec, &S1, &err);
+	if(err)return NULL;
+	f = fopen(filename, "rb");
+	if(f == NULL)return NULL;
+	if(fread(&H1, sizeof(H1), 1, f) != 1){
+		fclose(f);
+		return NULL;
+	}
+	t = table_alloc(P, &S1);
+	if(t == NULL){
+		fclose(f);
+		return NULL;
+	}
+	t->P = NULL;
+	table_header(t, &H);
+	if(memcmp(&H, &H1, sizeof(H))){
+		MSG("Property table in '%s' is not for this fluid or spec",filename);
+		res = 1;
+	}
+#define X(NAME,TYPE,SIZE) if(!res)res = (fread(t->NAME, sizeof(TYPE), SIZE, f) != (size_t)(SIZE));
+	TABLE_ARRAYS(X)
+#undef X
+	fclose(f);
+	if(res){
+		fprops_table_destroy(t);
+		return NULL;
+	}
+	return t;
+}
+
+void fprops_table_use(PureFluid *P, const PropTableSpec *spec, const char *cachefile, FpropsError *err){
+	PropTable *t = NULL;
+	fprops_table_release(P);
+	if(cachefile)t = fprops_table_load(P, spec, cachefile);
+	if(t == NULL){
+		t = fprops_table_build(P, spec, err);
+		if(t == NULL)return;
+		if(cachefile)fprops_table_save(t, cachefile);
+	}
+	P->table = t;
+}
+
+void fprops_table_release(PureFluid *P){
+	fprops_table_destroy(P->table);
+	P->table = NULL;
+}
+
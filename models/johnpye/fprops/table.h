@@ -0,0 +1,111 @@
+/*	ASCEND modelling environment
+	Copyright (C) 2015 John Pye
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2, or (at your option)
+	any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*//** @file
+	Tabulated properties of a pure fluid, as an optional faster alternative to
+	evaluating the equation of state, for models that call fprops_solve_ph or
+	fprops_sat_p millions of times.
+
+	A PropTable holds bicubic Hermite tables of p, h, s over (T, ln rho) and of
+	T, ln rho over (ln p, h), and cubic Hermite tables of the saturation state
+	along each grid's T or p rows. The values and first derivatives at every
+	node are taken from the Helmholtz EOS; the cross derivatives are finite
+	differences of those.
+
+	Each cell of the two tables is classified against the saturation curve:
+	cells that are entirely single-phase are interpolated, cells entirely in
+	the two-phase region use the lever rule on the interpolated saturation
+	state, and cells that the saturation curve passes through use the lever
+	rule for two-phase points but leave single-phase points to the EOS. Once
+	built, the interpolant is compared with the EOS at the centre of every
+	cell (and of every saturation interval), and cells where it is out by
+	more than the requested tolerance are left to the EOS too, so lookups are
+	within that tolerance as far as the check can tell.
+
+	When a fluid has a table attached with fprops_table_use, fprops_p, fprops_u,
+	fprops_h, fprops_s, fprops_solve_ph, fprops_sat_T and fprops_sat_p use it
+	for every state it covers, and the EOS otherwise.
+
+	Tables are only available for Helmholtz fluids. Building one is expensive
+	(one solution of the EOS per (p,h) node), and is done on several threads
+	if FPROPS is compiled with FPROPS_WITH_THREADS; tables can be saved to a
+	file and read back instead of being rebuilt each time.
+*/
+#ifndef FPROPS_TABLE_H
+#define FPROPS_TABLE_H
+
+#include "rundata.h"
+
+/**
+	Extent, resolution and accuracy of a property table. Any range left as
+	zero takes a default from the fluid data: T_t to 2 T_c, triple-point
+	pressure to 5 p_c, densities and enthalpies to cover those, and 200
+	points along each axis.
+*/
+typedef struct PropTableSpec_struct{
+	double T_min, T_max;     ///< temperature range / K (T_min is at least T_t)
+	double rho_min, rho_max; ///< density range / kg/m3, spaced logarithmically
+	double p_min, p_max;     ///< pressure range / Pa, spaced logarithmically
+	double h_min, h_max;     ///< enthalpy range / J/kg
+	unsigned nT, nrho;       ///< number of points in the (T,rho) table
+	unsigned np, nh;         ///< number of points in the (p,h) table
+	double tol;              ///< largest relative error allowed against the EOS (default 1e-6)
+	int nthreads;            ///< threads used to build the table (0 for one per CPU)
+} PropTableSpec;
+
+/**
+	Build a property table for the fluid P, which must be a Helmholtz fluid.
+	@param spec extent and resolution of the table, or NULL for the defaults.
+	@return the new table, or NULL if it couldn't be built (*err is set).
+*/
+PropTable *fprops_table_build(const PureFluid *P, const PropTableSpec *spec, FpropsError *err);
+
+void fprops_table_destroy(PropTable *t);
+
+/** @return 0 on success */
+int fprops_table_save(const PropTable *t, const char *filename);
+
+/**
+	Read a table saved by fprops_table_save, if it was built for the same
+	spec and for the same fluid with the same EOS and reference state.
+	@return the table, or NULL if the file can't be used.
+*/
+PropTable *fprops_table_load(const PureFluid *P, const PropTableSpec *spec, const char *filename);
+
+/**
+	Attach a property table to P, replacing any that it has already. The table
+	is read from 'cachefile' if possible, otherwise it's built and, if
+	cachefile isn't NULL, saved there for next time.
+*/
+void fprops_table_use(PureFluid *P, const PropTableSpec *spec, const char *cachefile, FpropsError *err);
+
+/** Detach and free the property table of P, if any. */
+void fprops_table_release(PureFluid *P);
+
+/*
+	Lookups. Each returns 0 if the table covers the requested state, in which
+	case the outputs are set, and non-zero if the EOS has to be used instead.
+*/
+
+int fprops_table_Trho(const PropTable *t, double T, double rho, double *p, double *h, double *s);
+
+int fprops_table_ph(const PropTable *t, double p, double h, double *T, double *rho);
+
+int fprops_table_sat_T(const PropTable *t, double T, double *psat, double *rhof, double *rhog);
+
+int fprops_table_sat_p(const PropTable *t, double p, double *Tsat, double *rhof, double *rhog);
+
+#endif
+
@@ -0,0 +1,175 @@
+/*
+	Check the batch functions (fprops_set_Trho_batch, fprops_p_batch etc and
+	fprops_solve_ph_batch) against the same functions one state at a time,
+	and time fprops_solve_ph_batch on the kind of problem it's for: points
+	along a heat exchanger, all at one pressure.
+*/
+#include "../fluids.h"
+#include "../fprops.h"
+#include "../solve_ph.h"
+#include "../sat.h"
+#include "../color.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define MSG FPROPS_MSG
+#define ERRMSG FPROPS_ERRMSG
+
+#define TOL_REL 1e-9
+#define TOL_PH 1e-7
+#define NPTS 1000
+
+static double relerr(double a, double b, double scale){
+	return fabs(a - b) / fmax(fabs(b), scale);
+}
+
+/* uniform random number in [a, b] */
+static double rnd(double a, double b){
+	return a + (b - a) * (rand() / (double)RAND_MAX);
+}
+
+int main(void){
+	const char *fluids[] = {"water", "carbondioxide", "nitrogen", "r134a", "toluene", NULL};
+	static double T[NPTS], rho[NPTS], p[NPTS], h[NPTS], T1[NPTS], rho1[NPTS];
+	static double pb[NPTS], hb[NPTS], sb[NPTS], cpb[NPTS], wb[NPTS];
+	static FluidState S[NPTS];
+	static FluidStateCache C[NPTS];
+	static FpropsError errb[NPTS];
+	int k, n, nerr = 0;
+	srand(1);
+
+	for(k = 0; fluids[k]; ++k){
+		const PureFluid *P = fprops_fluid(fluids[k],"helmholtz",NULL);
+		const FluidData *d;
+		FpropsError err = FPROPS_NO_ERROR;
+		if(P == NULL){
+			ERRMSG("Unable to load fluid '%s'",fluids[k]);
+			return 1;
+		}
+		d = P->data;
+		MSG("Testing %s",P->name);
+
+		/* states and their properties */
+		for(n = 0; n < NPTS; ++n){
+			T[n] = rnd(d->T_t, 2 * d->T_c);
+			rho[n] = d->rho_c * exp(rnd(log(1e-4), log(2.5)));
+		}
+		fprops_set_Trho_batch(NPTS, T, rho, P, S, C, &err);
+		fprops_p_batch(NPTS, S, pb, errb);
+		fprops_h_batch(NPTS, S, hb, errb);
+		fprops_s_batch(NPTS, S, sb, errb);
+		fprops_cp_batch(NPTS, S, cpb, errb);
+		fprops_w_batch(NPTS, S, wb, errb);
+		for(n = 0; n < NPTS; ++n){
+			FpropsError err1 = FPROPS_NO_ERROR;
+			FluidStateCache C1;
+			FluidState S1 = fprops_set_Trho_cached(T[n], rho[n], P, &C1, &err1);
+			if(C[n].have_derivs != C1.have_derivs){
+				ERRMSG("%s: batch and single states differ at T = %f, rho = %f",P->name,T[n],rho[n]);
+				nerr++;
+				continue;
+			}
+			double e = fmax(relerr(pb[n], fprops_p(S1,&err1), 1)
+				, fmax(relerr(hb[n], fprops_h(S1,&err1), d->R * d->T_c), relerr(sb[n], fprops_s(S1,&err1), d->R))
+			);
+			if(C1.have_derivs){
+				e = fmax(e, fmax(relerr(cpb[n], fprops_cp(S1,&err1), 0), relerr(wb[n], fprops_w(S1,&err1), 0)));
+			}
+			if(e > TOL_REL){
+				ERRMSG("%s: (T,rho) = (%f, %f): batch properties out by %e",P->name,T[n],rho[n],e);
+				nerr++;
+			}
+		}
+
+		/* solve_ph, against one point at a time */
+		for(n = 0; n < NPTS; ++n){
+			FluidState S1 = fprops_set_Trho(rnd(d->T_t, 1.9 * d->T_c), d->rho_c * exp(rnd(log(1e-3), log(2))), P, &err);
+			p[n] = fprops_p(S1, &err);
+			h[n] = fprops_h(S1, &err);
+			if(err || p[n] <= 0){
+				err = FPROPS_NO_ERROR;
+				p[n] = d->p_c;
+				h[n] = fprops_h(fprops_set_Trho(1.5 * d->T_c, d->rho_c, P, &err), &err);
+			}
+		}
+		fprops_solve_ph_batch(NPTS, p, h, T, rho, 0, P, errb);
+		for(n = 0; n < NPTS; ++n){
+			FpropsError err1 = FPROPS_NO_ERROR;
+			fprops_solve_ph(p[n], h[n], T1 + n, rho1 + n, 0, P, &err1);
+			if(err1 != errb[n]){
+				ERRMSG("%s: (p,h) = (%f, %f): error %d from the batch, %d alone",P->name,p[n],h[n],errb[n],err1);
+				nerr++;
+				continue;
+			}
+			if(err1)continue;
+			/* as for the property tables, accept either the same state or
+			one with the right p and h, as T and rho are ill-conditioned in
+			places */
+			FluidState S1 = fprops_set_Trho(T[n], rho[n], P, &err1);
+			double e = fmin(fmax(relerr(T[n], T1[n], 0), relerr(rho[n], rho1[n], 0))
+				, fmax(relerr(fprops_p(S1,&err1), p[n], 0), relerr(fprops_h(S1,&err1), h[n], d->R * d->T_c))
+			);
+			if(e > TOL_PH){
+				ERRMSG("%s: (p,h) = (%f, %f): batch gives (%f, %f), expected (%f, %f)",P->name,p[n],h[n],T[n],rho[n],T1[n],rho1[n]);
+				nerr++;
+			}
+		}
+
+		/* a heat exchanger: vapour cooling at constant pressure */
+		{
+			double pp = 0.5 * d->p_c, sum = 0, Tsat, rhof, rhog, hf, hg, hin, hout;
+			clock_t c0, c1, c2;
+			int r, NR = 5;
+			/* from superheated vapour to subcooled liquid */
+			fprops_sat_p(pp, &Tsat, &rhof, &rhog, P, &err);
+			hf = fprops_h(fprops_set_Trho(Tsat, rhof, P, &err), &err);
+			hg = fprops_h(fprops_set_Trho(Tsat, rhog, P, &err), &err);
+			if(err){
+				ERRMSG("%s: failed to solve saturation at p = %f bar",P->name,pp/1e5);
+				return 1;
+			}
+			hin = hg + 0.5 * (hg - hf);
+			hout = hf - 0.2 * (hg - hf);
+			for(n = 0; n < NPTS; ++n){
+				p[n] = pp;
+				h[n] = hout + (hin - hout) * n / (NPTS - 1.);
+			}
+			c0 = clock();
+			for(r = 0; r < NR; ++r){
+				for(n = 0; n < NPTS; ++n){
+					fprops_solve_ph(p[n], h[n], T1 + n, rho1 + n, 0, P, &err);
+					sum += T1[n];
+				}
+			}
+			c1 = clock();
+			for(r = 0; r < NR; ++r){
+				fprops_solve_ph_batch(NPTS, p, h, T, rho, 0, P, errb);
+				for(n = 0; n < NPTS; ++n)sum += T[n];
+			}
+			c2 = clock();
+			for(n = 0; n < NPTS; ++n){
+				if(errb[n] || relerr(T[n], T1[n], 0) > TOL_PH){
+					ERRMSG("%s: heat exchanger point %d: T = %f, expected %f (error %d)",P->name,n,T[n],T1[n],errb[n]);
+					nerr++;
+				}
+			}
+			MSG("%s: solve_ph of %d points along a heat exchanger: %.3f s one at a time, %.3f s as a batch (%g)"
+				,P->name,NPTS*NR,(c1 - c0)/(double)CLOCKS_PER_SEC,(c2 - c1)/(double)CLOCKS_PER_SEC,sum
+			);
+		}
+	}
+
+	if(nerr){
+		ERRMSG("%d failures",nerr);
+		return 1;
+	}
+	fprintf(stderr,"\n");
+	color_on(stderr,ASC_FG_BRIGHTGREEN);
+	fprintf(stderr,"SUCCESS (%s)",__FILE__);
+	color_off(stderr);
+	fprintf(stderr,"\n");
+	return 0;
+}
@@ -0,0 +1,125 @@
+/*
+	Check that the properties that fprops_set_Trho_cached caches for Helmholtz fluids
+	(evaluated from all the derivatives of phi in one pass, see
+	helmholtz_derivs) agree with the property functions evaluated one at a
+	time, and that the partial derivatives fprops_dpdT_rho etc agree with
+	finite differences.
+*/
+#include "../fluids.h"
+#include "../fprops.h"
+#include "../color.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+
+#define MSG FPROPS_MSG
+#define ERRMSG FPROPS_ERRMSG
+
+#define TOL_REL 1e-9
+#define TOL_FD 1e-5
+
+static int check(const char *fluid, const char *prop, double T, double rho, double a, double b, double tol){
+	double err = fabs(a - b) / (fabs(b) > 1e-10 ? fabs(b) : 1);
+	if(isnan(a) != isnan(b) || err > tol){
+		ERRMSG("%s: %s(T=%f, rho=%f) = %.12e, expected %.12e (rel err %e)",fluid,prop,T,rho,a,b,err);
+		return 1;
+	}
+	return 0;
+}
+
+int main(void){
+	const char *fluids[] = {"water", "carbondioxide", "methane", "nitrogen", "r134a", "ethanol", NULL};
+	int i, j, k, nerr = 0;
+
+	for(k=0; fluids[k]; ++k){
+		const PureFluid *P = fprops_fluid(fluids[k],"helmholtz",NULL);
+		if(P == NULL){
+			ERRMSG("Unable to load fluid '%s'",fluids[k]);
+			return 1;
+		}
+		const FluidData *d = P->data;
+		MSG("Testing %s",P->name);
+
+		for(i=0; i<12; ++i){
+			for(j=0; j<12; ++j){
+				FpropsError err = FPROPS_NO_ERROR, err1 = FPROPS_NO_ERROR;
+				double T = d->T_t + (2.5*d->T_c - d->T_t) * (i + 0.5) / 12.;
+				double rho = d->rho_c * (0.001 + 2.5 * j / 12.);
+				FluidStateCache C, CTp, CTm, Crp, Crm;
+				FluidState S = fprops_set_Trho_cached(T,rho,P,&C,&err);
+				/* a state without the cache */
+				FluidState S1 = {T,rho,P};
+
+#define CMP(VAR) \
+				nerr += check(P->name,#VAR,T,rho,fprops_##VAR(S,&err),fprops_##VAR(S1,&err1),TOL_REL)
+
+				CMP(p); CMP(u); CMP(h); CMP(s); CMP(a); CMP(g);
+				CMP(dpdrho_T); CMP(alphap); CMP(betap);
+				if(C.have_derivs){
+					CMP(cp); CMP(cv); CMP(w);
+				}
+#undef CMP
+				if(err != err1){
+					ERRMSG("%s: error %d with the cache, %d without, at T=%f, rho=%f",P->name,err,err1,T,rho);
+					nerr++;
+				}
+				if(err || !C.have_derivs)continue;
+
+				/* partial derivatives against central differences */
+				double dT = 1e-5 * T, drho = 1e-5 * rho;
+				FluidState Tp = fprops_set_Trho_cached(T + dT,rho,P,&CTp,&err);
+				FluidState Tm = fprops_set_Trho_cached(T - dT,rho,P,&CTm,&err);
+				FluidState rp = fprops_set_Trho_cached(T,rho + drho,P,&Crp,&err);
+				FluidState rm = fprops_set_Trho_cached(T,rho - drho,P,&Crm,&err);
+				if(!(CTp.have_derivs && CTm.have_derivs && Crp.have_derivs && Crm.have_derivs))continue;
+
+#define FD(VAR,X,Y,Z) \
+				nerr += check(P->name,#VAR "d" #X "_" #Z,T,rho,fprops_d##VAR##d##X##_##Z(S,&err)\
+					,(fprops_##VAR(Y##p,&err) - fprops_##VAR(Y##m,&err))/(2*d##X),TOL_FD)
+
+				FD(p,T,T,rho); FD(p,rho,r,T);
+				FD(h,T,T,rho); FD(h,rho,r,T);
+				FD(u,T,T,rho); FD(u,rho,r,T);
+#undef FD
+				if(err){
+					ERRMSG("%s: error %d evaluating derivatives at T=%f, rho=%f",P->name,err,T,rho);
+					nerr++;
+				}
+			}
+		}
+
+		/* the saving: p, h, s and w of one state, with and without the cache */
+		{
+			FpropsError err = FPROPS_NO_ERROR;
+			double T = 1.2 * d->T_c, rho = 0.8 * d->rho_c, sum = 0;
+			int n, N = 20000;
+			clock_t c0 = clock();
+			for(n=0; n<N; ++n){
+				FluidState S = {T + 1e-6*n,rho,P};
+				sum += fprops_p(S,&err) + fprops_h(S,&err) + fprops_s(S,&err) + fprops_w(S,&err);
+			}
+			clock_t c1 = clock();
+			for(n=0; n<N; ++n){
+				FluidStateCache C;
+				FluidState S = fprops_set_Trho_cached(T + 1e-6*n,rho,P,&C,&err);
+				sum += fprops_p(S,&err) + fprops_h(S,&err) + fprops_s(S,&err) + fprops_w(S,&err);
+			}
+			clock_t c2 = clock();
+			MSG("p, h, s, w of %d states: %.3f s one by one, %.3f s cached (%g)"
+				,N,(c1-c0)/(double)CLOCKS_PER_SEC,(c2-c1)/(double)CLOCKS_PER_SEC,sum
+			);
+		}
+	}
+
+	if(nerr){
+		ERRMSG("%d failures",nerr);
+		return 1;
+	}
+	fprintf(stderr,"\n");
+	color_on(stderr,ASC_FG_BRIGHTGREEN);
+	fprintf(stderr,"SUCCESS (%s)",__FILE__);
+	color_off(stderr);
+	fprintf(stderr,"\n");
+	return 0;
+}
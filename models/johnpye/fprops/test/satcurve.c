@@ -0,0 +1,153 @@
+/*
+	Check the saturation curve fit (see satcurve.h): fprops_sat_T started
+	from the fit has to agree with the solution from scratch (where that
+	doesn't collapse to rhof == rhog near T_c), fprops_sat_p has to give a
+	state in phase equilibrium at the pressure asked for, and
+	fprops_region_ph has to agree with the phase found from that state. Also
+	time fprops_sat_p and fprops_region_ph with and without the fit.
+
+	(fprops_sat_p without the fit is less accurate, and close to the critical
+	point fprops_sat_T without it can converge to rhof == rhog, so they
+	aren't the reference here.)
+*/
+#include "../fluids.h"
+#include "../fprops.h"
+#include "../sat.h"
+#include "../solve_ph.h"
+#include "../satcurve.h"
+#include "../color.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define MSG FPROPS_MSG
+#define ERRMSG FPROPS_ERRMSG
+
+#define TOL 1e-8
+#define NPTS 500
+
+static double relerr(double a, double b){
+	return fabs(a - b) / fabs(b);
+}
+
+/* uniform random number in [a, b] */
+static double rnd(double a, double b){
+	return a + (b - a) * (rand() / (double)RAND_MAX);
+}
+
+int main(void){
+	const char *fluids[] = {"water", "carbondioxide", "nitrogen", "r134a", "ethanol", "toluene", NULL};
+	static double T[NPTS], p[NPTS], h[NPTS];
+	int k, n, nerr = 0;
+	srand(1);
+
+	for(k = 0; fluids[k]; ++k){
+		const PureFluid *P = fprops_fluid(fluids[k],"helmholtz",NULL);
+		PureFluid P0;
+		const FluidData *d;
+		double emax = 0, sum = 0;
+		int ntriv = 0;
+		clock_t c0, c1, c2;
+		if(P == NULL){
+			ERRMSG("Unable to load fluid '%s'",fluids[k]);
+			return 1;
+		}
+		if(P->satcurve == NULL){
+			ERRMSG("No saturation curve for '%s'",P->name);
+			nerr++;
+			continue;
+		}
+		/* the same fluid without the fit */
+		P0 = *P;
+		P0.satcurve = NULL;
+		d = P->data;
+
+		for(n = 0; n < NPTS; ++n){
+			FpropsError err = FPROPS_NO_ERROR, err0 = FPROPS_NO_ERROR;
+			double psat, rhof, rhog, psat0, rhof0, rhog0, Tsat;
+			T[n] = rnd(d->T_t, d->T_c - 1e-3 * (d->T_c - d->T_t));
+			fprops_sat_T(T[n], &psat, &rhof, &rhog, P, &err);
+			fprops_sat_T(T[n], &psat0, &rhof0, &rhog0, &P0, &err0);
+			if(err || err0){
+				ERRMSG("%s: sat_T(%f): error %d with the fit, %d without",P->name,T[n],err,err0);
+				nerr++;
+				continue;
+			}
+			if(rhof0 - rhog0 > 1e-3 * rhof0){
+				emax = fmax(emax, fmax(relerr(psat, psat0), fmax(relerr(rhof, rhof0), relerr(rhog, rhog0))));
+			}else{
+				ntriv++;
+			}
+			p[n] = psat;
+
+			/* sat_p has to give a state in phase equilibrium at p (the
+			pressure of the liquid is too sensitive to rhof to check) */
+			fprops_sat_p(p[n], &Tsat, &rhof, &rhog, P, &err);
+			double pg = P->p_fn(Tsat, rhog, d, &err);
+			double gf = P->g_fn(Tsat, rhof, d, &err), gg = P->g_fn(Tsat, rhog, d, &err);
+			if(err || !(rhog < (1 - 1e-6) * rhof)){
+				ERRMSG("%s: sat_p(%f): error %d, rhof = %f, rhog = %f",P->name,p[n],err,rhof,rhog);
+				nerr++;
+				continue;
+			}
+			emax = fmax(emax, fmax(relerr(pg, p[n]), fabs(gf - gg) / (d->R * Tsat)));
+
+			/* states either side of the saturation curve, and near each end */
+			double hf = P->h_fn(Tsat, rhof, d, &err);
+			double hg = P->h_fn(Tsat, rhog, d, &err);
+			double hh[5] = {hf - 0.1 * (hg - hf), hf + 1e-4 * (hg - hf), 0.5 * (hf + hg)
+				, hg - 1e-4 * (hg - hf), hg + 0.1 * (hg - hf)};
+			int j;
+			for(j = 0; j < 5; ++j){
+				int r = fprops_region_ph(p[n], hh[j], P, &err);
+				int r0 = (hf < hh[j] && hh[j] < hg) ? FPROPS_SAT : FPROPS_NON;
+				if(r != r0 || err){
+					ERRMSG("%s: region(%f, %f) = %d, expected %d",P->name,p[n],hh[j],r,r0);
+					nerr++;
+				}
+			}
+			h[n] = hh[n % 5];
+		}
+		MSG("%s: max rel error in saturation state from the fit %.2e",P->name,emax);
+		if(ntriv){
+			MSG("%s: %d states near T_c where sat_T from scratch gave rhof == rhog",P->name,ntriv);
+		}
+		if(emax > TOL){
+			ERRMSG("%s: saturation state from the fit is out by %e",P->name,emax);
+			nerr++;
+		}
+
+		/* timing */
+		{
+			FpropsError err = FPROPS_NO_ERROR;
+			double Tsat, rhof, rhog;
+			c0 = clock();
+			for(n = 0; n < NPTS; ++n){
+				fprops_sat_p(p[n], &Tsat, &rhof, &rhog, &P0, &err);
+				sum += Tsat + fprops_region_ph(p[n], h[n], &P0, &err);
+			}
+			c1 = clock();
+			for(n = 0; n < NPTS; ++n){
+				fprops_sat_p(p[n], &Tsat, &rhof, &rhog, P, &err);
+				sum += Tsat + fprops_region_ph(p[n], h[n], P, &err);
+			}
+			c2 = clock();
+			MSG("%s: sat_p and region_ph of %d states: %.3f s without the fit, %.3f s with it (%g)"
+				,P->name,NPTS,(c1 - c0)/(double)CLOCKS_PER_SEC,(c2 - c1)/(double)CLOCKS_PER_SEC,sum
+			);
+		}
+	}
+
+	if(nerr){
+		ERRMSG("%d failures",nerr);
+		return 1;
+	}
+	fprintf(stderr,"\n");
+	color_on(stderr,ASC_FG_BRIGHTGREEN);
+	fprintf(stderr,"SUCCESS (%s)",__FILE__);
+	color_off(stderr);
+	fprintf(stderr,"\n");
+	return 0;
+}
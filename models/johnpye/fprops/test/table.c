@@ -0,0 +1,221 @@
+/*
+	Check property tables (see table.h) against the EOS: lookups over (T,rho)
+	and (p,h) and of the saturation state, at random points, have to agree
+	with the EOS to within a small multiple of the tolerance the table was
+	built for (the table is only checked at the centre of each cell). Also
+	check saving and loading tables, and time fprops_solve_ph with and
+	without one.
+*/
+#include "../fluids.h"
+#include "../fprops.h"
+#include "../solve_ph.h"
+#include "../sat.h"
+#include "../table.h"
+#include "../color.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define MSG FPROPS_MSG
+#define ERRMSG FPROPS_ERRMSG
+
+#define TOL 1e-6
+#define TOL_FACTOR 20
+#define NPTS 20000
+
+static double relerr(double a, double b, double scale){
+	return fabs(a - b) / fmax(fabs(b), scale);
+}
+
+/* uniform random number in [a, b] */
+static double rnd(double a, double b){
+	return a + (b - a) * (rand() / (double)RAND_MAX);
+}
+
+int main(void){
+	const char *fluids[] = {"water", "carbondioxide", "nitrogen", "r134a", NULL};
+	const char *file = "table_test.tab";
+	int k, n, nerr = 0;
+	srand(1);
+
+	for(k = 0; fluids[k]; ++k){
+		PureFluid *P = (PureFluid *)fprops_fluid(fluids[k],"helmholtz",NULL);
+		const FluidData *d;
+		FpropsError err = FPROPS_NO_ERROR;
+		PropTableSpec spec = {0};
+		PropTable *t, *t1;
+		if(P == NULL){
+			ERRMSG("Unable to load fluid '%s'",fluids[k]);
+			return 1;
+		}
+		d = P->data;
+		spec.tol = TOL;
+
+		clock_t c0 = clock();
+		t = fprops_table_build(P, &spec, &err);
+		if(t == NULL){
+			ERRMSG("Failed to build table for '%s'",P->name);
+			return 1;
+		}
+		MSG("%s: table built in %.2f s (CPU)",P->name,(clock() - c0)/(double)CLOCKS_PER_SEC);
+
+		/* (T,rho) */
+		{
+			double emax = 0;
+			int ncov = 0;
+			for(n = 0; n < NPTS; ++n){
+				double T = rnd(d->T_t, 2 * d->T_c), rho = d->rho_c * exp(rnd(log(1e-4), log(3)));
+				double p, h, s;
+				if(fprops_table_Trho(t, T, rho, &p, &h, &s))continue;
+				FluidState S = fprops_set_Trho(T, rho, P, &err);
+				double e = fmax(relerr(p, fprops_p(S,&err), 0)
+					, fmax(relerr(h, fprops_h(S,&err), d->R * d->T_c), relerr(s, fprops_s(S,&err), d->R))
+				);
+				if(err){err = FPROPS_NO_ERROR; continue;}
+				ncov++;
+				if(e > emax)emax = e;
+				if(e > TOL_FACTOR * TOL){
+					ERRMSG("%s: (T,rho) = (%f, %f): error %e",P->name,T,rho,e);
+					nerr++;
+				}
+			}
+			MSG("%s: (T,rho) table covers %.1f%% of points, max rel error %.2e",P->name,100.*ncov/NPTS,emax);
+		}
+
+		/* (p,h), for states in the (T,rho) range */
+		{
+			double emax = 0;
+			int ncov = 0;
+			for(n = 0; n < NPTS; ++n){
+				double T0 = rnd(d->T_t, 1.9 * d->T_c), rho0 = d->rho_c * exp(rnd(log(1e-3), log(2.5)));
+				FluidState S = fprops_set_Trho(T0, rho0, P, &err);
+				double p = fprops_p(S,&err), h = fprops_h(S,&err), T, rho, T1, rho1;
+				if(err || p <= 0){err = FPROPS_NO_ERROR; continue;}
+				if(fprops_table_ph(t, p, h, &T, &rho))continue;
+				fprops_solve_ph(p, h, &T1, &rho1, 0, P, &err);
+				if(err){err = FPROPS_NO_ERROR; continue;}
+				/* T and rho are very sensitive to p and h in places (such as
+				wet states with little vapour, or compressed liquid), so also
+				accept a state that has the right p and h */
+				FluidState S1 = fprops_set_Trho(T, rho, P, &err);
+				double e = fmin(fmax(relerr(T, T1, 0), relerr(rho, rho1, 0))
+					, fmax(relerr(fprops_p(S1,&err), p, 0), relerr(fprops_h(S1,&err), h, d->R * d->T_c))
+				);
+				ncov++;
+				if(e > emax)emax = e;
+				if(e > TOL_FACTOR * TOL){
+					ERRMSG("%s: (p,h) = (%f, %f): error %e (T = %f, rho = %f)",P->name,p,h,e,T1,rho1);
+					nerr++;
+				}
+			}
+			MSG("%s: (p,h) table covers %.1f%% of points, max rel error %.2e",P->name,100.*ncov/NPTS,emax);
+		}
+
+		/* saturation */
+		{
+			double emax = 0;
+			for(n = 0; n < 1000; ++n){
+				double T = rnd(d->T_t, d->T_c), psat, rhof, rhog, psat1, rhof1, rhog1, Tsat, Tsat1;
+				fprops_sat_T(T, &psat1, &rhof1, &rhog1, P, &err);
+				if(!fprops_table_sat_T(t, T, &psat, &rhof, &rhog)){
+					emax = fmax(emax, fmax(relerr(psat, psat1, 0), fmax(relerr(rhof, rhof1, 0), relerr(rhog, rhog1, 0))));
+				}
+				if(!fprops_table_sat_p(t, psat1, &Tsat, &rhof, &rhog)){
+					fprops_sat_p(psat1, &Tsat1, &rhof1, &rhog1, P, &err);
+					emax = fmax(emax, fmax(relerr(Tsat, Tsat1, 0), fmax(relerr(rhof, rhof1, 0), relerr(rhog, rhog1, 0))));
+				}
+			}
+			MSG("%s: saturation max rel error %.2e",P->name,emax);
+			if(emax > TOL_FACTOR * TOL || err){
+				ERRMSG("%s: saturation error too large",P->name);
+				nerr++;
+			}
+		}
+
+		/* saving and loading */
+		if(fprops_table_save(t, file)){
+			ERRMSG("%s: failed to save table",P->name);
+			nerr++;
+		}
+		t1 = fprops_table_load(P, &spec, file);
+		if(t1 == NULL){
+			ERRMSG("%s: failed to load saved table",P->name);
+			nerr++;
+		}else{
+			double p, h, s, p1, h1, s1, T = 1.3 * d->T_c, rho = 0.7 * d->rho_c;
+			if(fprops_table_Trho(t, T, rho, &p, &h, &s) != fprops_table_Trho(t1, T, rho, &p1, &h1, &s1)
+				|| p != p1 || h != h1 || s != s1
+			){
+				ERRMSG("%s: loaded table differs from the saved one",P->name);
+				nerr++;
+			}
+			fprops_table_destroy(t1);
+		}
+		spec.nh = 101;
+		if((t1 = fprops_table_load(P, &spec, file))){
+			ERRMSG("%s: loaded a table built for a different spec",P->name);
+			fprops_table_destroy(t1);
+			nerr++;
+		}
+		spec.nh = 0;
+		fprops_table_destroy(t);
+
+		/* solve_ph with the table attached, against the EOS */
+		{
+			static double p[NPTS], h[NPTS];
+			double sum = 0;
+			clock_t c1, c2;
+			for(n = 0; n < NPTS; ++n){
+				FluidState S = fprops_set_Trho(rnd(d->T_t, 1.9 * d->T_c), d->rho_c * exp(rnd(log(1e-3), log(2))), P, &err);
+				p[n] = fprops_p(S, &err);
+				h[n] = fprops_h(S, &err);
+				if(err || p[n] <= 0){
+					err = FPROPS_NO_ERROR;
+					p[n] = d->p_c;
+					h[n] = fprops_h(fprops_set_Trho(1.5 * d->T_c, d->rho_c, P, &err), &err);
+				}
+			}
+			c1 = clock();
+			for(n = 0; n < NPTS/10; ++n){
+				double T, rho;
+				fprops_solve_ph(p[n], h[n], &T, &rho, 0, P, &err);
+				sum += T;
+				err = FPROPS_NO_ERROR;
+			}
+			c2 = clock();
+			double t_eos = (c2 - c1) / (double)CLOCKS_PER_SEC * 10;
+
+			fprops_table_use(P, &spec, file, &err);
+			if(err || P->table == NULL){
+				ERRMSG("%s: failed to attach table",P->name);
+				return 1;
+			}
+			c1 = clock();
+			for(n = 0; n < NPTS; ++n){
+				double T, rho;
+				fprops_solve_ph(p[n], h[n], &T, &rho, 0, P, &err);
+				sum += T;
+				err = FPROPS_NO_ERROR;
+			}
+			c2 = clock();
+			MSG("%s: solve_ph of %d states: %.3f s with the EOS, %.3f s with the table (%g)"
+				,P->name,NPTS,t_eos,(c2 - c1)/(double)CLOCKS_PER_SEC,sum
+			);
+			fprops_table_release(P);
+		}
+		remove(file);
+	}
+
+	if(nerr){
+		ERRMSG("%d failures",nerr);
+		return 1;
+	}
+	fprintf(stderr,"\n");
+	color_on(stderr,ASC_FG_BRIGHTGREEN);
+	fprintf(stderr,"SUCCESS (%s)",__FILE__);
+	color_off(stderr);
+	fprintf(stderr,"\n");
+	return 0;
+}
@@ -131,11 +131,34 @@ static void integrator_ida_create(IntegratorSystem *integ) {
 	enginedata = ASC_NEW(IntegratorIdaData);
 	CONSOLE_DEBUG("enginedata = %p",enginedata);
 	enginedata->rellist = NULL;
+	enginedata->xsys = NULL;
+	enginedata->rsys = NULL;
+	enginedata->yindex = NULL;
+	enginedata->ydotindex = NULL;
+	enginedata->bndindex = NULL;
+	enginedata->bndlower = NULL;
+	enginedata->bndupper = NULL;
+	enginedata->bndbatch = NULL;
+	enginedata->bndres = NULL;
+	enginedata->nbounded = 0;
+	enginedata->jacrels = NULL;
+	enginedata->jacrow = NULL;
+	enginedata->njacrels = 0;
+	enginedata->fdrels = NULL;
+	enginedata->fdrow = NULL;
+	enginedata->nfdrels = 0;
+	enginedata->fdbatch = NULL;
+	enginedata->fdcolor = NULL;
+	enginedata->fdres = NULL;
+	enginedata->fdstep = NULL;
+	enginedata->fdvalue = NULL;
+	enginedata->xindex = -1;
 	enginedata->safeeval = 0;
 	enginedata->vfilter.matchbits = VAR_SVAR | VAR_INCIDENT | VAR_ACTIVE
 			| VAR_FIXED;
 	enginedata->vfilter.matchvalue = VAR_SVAR | VAR_INCIDENT | VAR_ACTIVE | 0;
 	enginedata->pfree = NULL;
+	enginedata->sjac = NULL;
 
 	enginedata->rfilter.matchbits = REL_EQUALITY | REL_INCLUDED | REL_ACTIVE;
 	enginedata->rfilter.matchvalue = REL_EQUALITY | REL_INCLUDED | REL_ACTIVE;
@@ -167,6 +190,8 @@ static void integrator_ida_free(void *enginedata) {
 	}
 
 	ASC_FREE(d->rellist);
+	mtx_csr_destroy(d->sjac);
+	integrator_ida_free_x(d);
 
 #ifdef DESTROY_DEBUG
 	CONSOLE_DEBUG("Now destroying the enginedata");
@@ -296,10 +321,10 @@ static int integrator_ida_params_default(IntegratorSystem *integ) {
 							,(SlvParameterInitChar) { {"linsolver"
 									,"Linear solver",1
 									,"See IDA manual, section 5.5.3. Choose 'ASCEND' to use the linsolqr"
-									" direct linear solver bundled with ASCEND, 'DENSE' to use the dense"
+									" sparse direct linear solver bundled with ASCEND (best for large"
+									" models), 'DENSE' to use the dense"
 									" solver bundled with IDA, or one of the Krylov solvers SPGMR, SPBCG"
-									" or SPTFQMR (which still need preconditioners to be implemented"
-									" before they can be very useful."
+									" or SPTFQMR (best used with one of the preconditioners, see 'prec')."
 								}, "DENSE"}, (char *[]) {"ASCEND","DENSE","BAND","SPGMR","SPBCG","SPTFQMR",NULL}
 					);
 
@@ -340,8 +365,12 @@ static int integrator_ida_params_default(IntegratorSystem *integ) {
 					slv_param_char(p,IDA_PARAM_PREC
 							,(SlvParameterInitChar) { {"prec"
 									,"Preconditioner",1
-									,"See IDA manual, section section 5.6.8."
-								},"NONE"}, (char *[]) {"NONE","DIAG",NULL}
+									,"See IDA manual, section section 5.6.8. 'DIAG' uses the inverse of the"
+									" diagonal of the Jacobian. 'ILU0' and 'ILUT' use incomplete LU factors"
+									" of it, without and with fill-in (ILUT is more robust for stiff models),"
+									" and 'BLOCKJACOBI' the exact LU factors of its diagonal blocks. These"
+									" last three are refactored only when IDA asks for a refresh."
+								},"NONE"}, (char *[]) {"NONE","DIAG","ILU0","ILUT","BLOCKJACOBI",NULL}
 					);
 
 					asc_assert(p->num_parms == IDA_PARAMS_SIZE);
@@ -411,7 +440,7 @@ int ida_load_rellist(IntegratorSystem *integ) {
 		return 1; /* failure */
 	}
 
-	return 0;
+	return integrator_ida_load_x(integ);
 }
 
 /*
@@ -559,6 +588,9 @@ int ida_set_optional_inputs(IntegratorSystem *integ, void *ida_mem) {
 	CONSOLE_DEBUG("ASSIGNING LINEAR SOLVER '%s'",linsolver);
 	if (strcmp(linsolver, "ASCEND") == 0) {
 		CONSOLE_DEBUG("ASCEND DIRECT SOLVER, size = %d",integ->n_y);
+		/* any pattern kept by integrator_ida_sjex was of an older matrix */
+		mtx_csr_destroy(enginedata->sjac);
+		enginedata->sjac = NULL;
 		IDAASCEND(ida_mem, integ->n_y);
 		IDAASCENDSetJacFn(ida_mem, &integrator_ida_sjex, (void *) integ);
 
@@ -624,8 +656,14 @@ int ida_set_optional_inputs(IntegratorSystem *integ, void *ida_mem) {
 		pname = SLV_PARAM_CHAR(&(integ->params),IDA_PARAM_PREC);
 		if (strcmp(pname, "NONE") == 0) {
 			prec = NULL;
-		} else if (strcmp(pname, "JACOBI") == 0) {
+		} else if (strcmp(pname, "DIAG") == 0 || strcmp(pname, "JACOBI") == 0) {
 			prec = &prec_jacobi;
+		} else if (strcmp(pname, "ILU0") == 0) {
+			prec = &prec_ilu0;
+		} else if (strcmp(pname, "ILUT") == 0) {
+			prec = &prec_ilut;
+		} else if (strcmp(pname, "BLOCKJACOBI") == 0) {
+			prec = &prec_blockjacobi;
 		} else {
 			ERROR_REPORTER_HERE(ASC_PROG_ERR,"Invalid preconditioner choice '%s'",pname);
 			return 7;
@@ -648,6 +686,10 @@ int ida_set_optional_inputs(IntegratorSystem *integ, void *ida_mem) {
 
 		if (prec) {
 			/* assign the preconditioner to the linear solver */
+			if (enginedata->pfree) {
+				/* left over from a previous run */
+				(enginedata->pfree)(enginedata);
+			}
 			(prec->pcreate)(integ);
 #if SUNDIALS_VERSION_MAJOR==2 && SUNDIALS_VERSION_MINOR>=4
 			IDASpilsSetPreconditioner(ida_mem,prec->psetup,prec->psolve);
@@ -1112,8 +1154,14 @@ static int integrator_ida_solve(IntegratorSystem *integ,
 						}
 					}
 #endif
+					/* the boundary code works on the compiler's values */
+					integrator_set_t(integ, (double) tret);
+					integrator_set_y(integ, NV_DATA_S(yret));
+					integrator_set_ydot(integ, NV_DATA_S(ypret));
 					need_to_reconfigure = ida_cross_boundary(integ, rootsfound,
 							bnd_cond_states);
+					/* values may have been changed at the boundary */
+					integrator_ida_load_x(integ);
 
 					if (need_to_reconfigure) {
 
@@ -1214,6 +1262,8 @@ static int integrator_ida_solve(IntegratorSystem *integ,
 
 	/* free solver memory */
 	IDAFree(&ida_mem);
+	mtx_csr_destroy(enginedata->sjac);
+	enginedata->sjac = NULL;
 
 	if (flag < -500) {
 		ERROR_REPORTER_HERE(ASC_PROG_ERR,"Interrupted while attempting t = %f", tout);
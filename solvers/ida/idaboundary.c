@@ -177,7 +177,7 @@ int ida_bnd_update_relist(IntegratorSystem *integ){
 		return 1; /* failure */
 	}
 
-	return 0;
+	return integrator_ida_load_x(integ);
 }
 
 N_Vector ida_bnd_new_zero_NV(long int vec_length){
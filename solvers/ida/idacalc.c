@@ -45,11 +45,15 @@
 #include <ascend/compiler/instance_enum.h>
 
 #include <ascend/system/slv_client.h>
+#include <ascend/system/system.h>
 #include <ascend/system/relman.h>
 #include <ascend/system/block.h>
 #include <ascend/system/slv_stdcalls.h>
 #include <ascend/system/jacobian.h>
+#include <ascend/system/coloring.h>
 #include <ascend/system/bndman.h>
+#include <ascend/linear/mtx_csr.h>
+#include <ascend/utilities/ascTask.h>
 
 #include <ascend/utilities/config.h>
 #include <ascend/integrator/integrator.h>
@@ -96,6 +100,238 @@ void integrator_ida_sig(int sig){
 }
 #endif
 
+void integrator_ida_free_x(IntegratorIdaData *enginedata){
+	if(enginedata->xsys != NULL)ASC_FREE(enginedata->xsys);
+	if(enginedata->rsys != NULL)ASC_FREE(enginedata->rsys);
+	if(enginedata->yindex != NULL)ASC_FREE(enginedata->yindex);
+	if(enginedata->ydotindex != NULL)ASC_FREE(enginedata->ydotindex);
+	if(enginedata->bndindex != NULL)ASC_FREE(enginedata->bndindex);
+	if(enginedata->bndlower != NULL)ASC_FREE(enginedata->bndlower);
+	if(enginedata->bndupper != NULL)ASC_FREE(enginedata->bndupper);
+	if(enginedata->bndres != NULL)ASC_FREE(enginedata->bndres);
+	relman_batch_destroy(enginedata->bndbatch);
+	enginedata->xsys = enginedata->rsys = NULL;
+	enginedata->yindex = enginedata->ydotindex = enginedata->bndindex = NULL;
+	enginedata->bndlower = enginedata->bndupper = enginedata->bndres = NULL;
+	enginedata->bndbatch = NULL;
+	enginedata->nbounded = 0;
+	enginedata->xindex = -1;
+
+	if(enginedata->jacrels != NULL)ASC_FREE(enginedata->jacrels);
+	if(enginedata->jacrow != NULL)ASC_FREE(enginedata->jacrow);
+	if(enginedata->fdrels != NULL)ASC_FREE(enginedata->fdrels);
+	if(enginedata->fdrow != NULL)ASC_FREE(enginedata->fdrow);
+	if(enginedata->fdres != NULL)ASC_FREE(enginedata->fdres);
+	if(enginedata->fdstep != NULL)ASC_FREE(enginedata->fdstep);
+	if(enginedata->fdvalue != NULL)ASC_FREE(enginedata->fdvalue);
+	relman_batch_destroy(enginedata->fdbatch);
+	system_coloring_destroy(enginedata->fdcolor);
+	enginedata->jacrels = enginedata->fdrels = NULL;
+	enginedata->jacrow = enginedata->fdrow = NULL;
+	enginedata->fdres = enginedata->fdstep = enginedata->fdvalue = NULL;
+	enginedata->fdbatch = NULL;
+	enginedata->fdcolor = NULL;
+	enginedata->njacrels = enginedata->nfdrels = 0;
+}
+
+/* bounds at or beyond the solver_var defaults are taken as no bound at all */
+#define IDA_NO_BOUND 1e20
+
+/**
+	Make the batch and residual space used by integrator_ida_rootfn to
+	evaluate the real-valued boundary conditions from xsys.
+	@return 0 on success
+*/
+static int integrator_ida_load_bnd(IntegratorSystem *integ){
+	IntegratorIdaData *enginedata = integrator_ida_enginedata(integ);
+	struct rel_relation **rels, *rel;
+	int32 i, n = 0, nres = 0;
+
+	for(i = 0; i < enginedata->nbnds; ++i){
+		if(bnd_kind(enginedata->bndlist[i]) == e_bnd_rel)++n;
+	}
+	if(n == 0)return 0;
+	rels = ASC_NEW_ARRAY(struct rel_relation *, n);
+	if(rels == NULL)return 1;
+	n = 0;
+	for(i = 0; i < enginedata->nbnds; ++i){
+		if(bnd_kind(enginedata->bndlist[i]) != e_bnd_rel)continue;
+		rel = bnd_rel(bnd_real_cond(enginedata->bndlist[i]));
+		rels[n++] = rel;
+		if(rel_sindex(rel) >= nres)nres = rel_sindex(rel) + 1;
+	}
+	enginedata->bndbatch = relman_batch_create(rels, n);
+	enginedata->bndres = ASC_NEW_ARRAY_CLEAR(double, nres + 1);
+	ASC_FREE(rels);
+	return (enginedata->bndbatch == NULL || enginedata->bndres == NULL);
+}
+
+int integrator_ida_load_x(IntegratorSystem *integ){
+	IntegratorIdaData *enginedata;
+	struct var_variable **vlist, *var;
+	int i, k, nvars, nrels;
+
+	enginedata = integrator_ida_enginedata(integ);
+	nvars = slv_get_num_solvers_vars(integ->system);
+	nrels = slv_get_num_solvers_rels(integ->system);
+	vlist = slv_get_solvers_var_list(integ->system);
+
+	integrator_ida_free_x(enginedata);
+	enginedata->xsys = ASC_NEW_ARRAY(double, nvars + 1);
+	enginedata->rsys = ASC_NEW_ARRAY_CLEAR(double, nrels + 1);
+	enginedata->yindex = ASC_NEW_ARRAY(int32, integ->n_y + 1);
+	enginedata->ydotindex = ASC_NEW_ARRAY(int32, integ->n_y + 1);
+	enginedata->bndindex = ASC_NEW_ARRAY(int32, 2 * integ->n_y + 1);
+	enginedata->bndlower = ASC_NEW_ARRAY(double, 2 * integ->n_y + 1);
+	enginedata->bndupper = ASC_NEW_ARRAY(double, 2 * integ->n_y + 1);
+	if(enginedata->xsys == NULL || enginedata->rsys == NULL
+		|| enginedata->yindex == NULL || enginedata->ydotindex == NULL
+		|| enginedata->bndindex == NULL || enginedata->bndlower == NULL
+		|| enginedata->bndupper == NULL || integrator_ida_load_bnd(integ)
+	){
+		ERROR_REPORTER_HERE(ASC_PROG_ERR,"Insufficient memory");
+		return 1;
+	}
+	for(i=0; i < nvars; ++i){
+		enginedata->xsys[i] = var_value(vlist[i]);
+	}
+
+	/* where each of t, y and ydot goes in xsys */
+	if(integ->x != NULL && var_flagbit(integ->x,VAR_SVAR)){
+		enginedata->xindex = var_sindex(integ->x);
+	}
+	for(i=0; i < integ->n_y; ++i){
+		enginedata->yindex[i] = var_sindex(integ->y[i]);
+		enginedata->ydotindex[i] = (integ->ydot[i] == NULL) ? -1
+			: var_sindex(integ->ydot[i]);
+	}
+
+	/* the states and derivatives that have any bounds worth checking */
+	for(i=0; i < integ->n_y; ++i){
+		for(k=0; k < 2; ++k){
+			var = (k == 0) ? integ->y[i] : integ->ydot[i];
+			if(var == NULL)continue;
+			if(var_lower_bound(var) > -IDA_NO_BOUND
+				|| var_upper_bound(var) < IDA_NO_BOUND
+			){
+				enginedata->bndindex[enginedata->nbounded] = var_sindex(var);
+				enginedata->bndlower[enginedata->nbounded] = var_lower_bound(var);
+				enginedata->bndupper[enginedata->nbounded] = var_upper_bound(var);
+				enginedata->nbounded++;
+			}
+		}
+	}
+	return 0;
+}
+
+int integrator_ida_check_bounds(IntegratorSystem *integ){
+	IntegratorIdaData *enginedata;
+	struct var_variable **vlist;
+	double val;
+	int i, err = 0;
+
+	enginedata = integrator_ida_enginedata(integ);
+	vlist = slv_get_solvers_var_list(integ->system);
+	for(i=0; i < enginedata->nbounded; ++i){
+		val = enginedata->xsys[enginedata->bndindex[i]];
+		if(val < enginedata->bndlower[i]){
+			ERROR_REPORTER_START_NOLINE(ASC_USER_ERROR);
+			FPRINTF(ASCERR,"The variable '");
+			var_write_name(integ->system,vlist[enginedata->bndindex[i]],ASCERR);
+			FPRINTF(ASCERR,"' was set below its lower bound.");
+			error_reporter_end_flush();
+			err = 1;
+		}else if(val > enginedata->bndupper[i]){
+			ERROR_REPORTER_START_NOLINE(ASC_USER_ERROR);
+			FPRINTF(ASCERR,"The variable '");
+			var_write_name(integ->system,vlist[enginedata->bndindex[i]],ASCERR);
+			FPRINTF(ASCERR,"' was set above its upper bound.");
+			error_reporter_end_flush();
+			err = 1;
+		}
+	}
+	return err;
+}
+
+int integrator_ida_set_x(IntegratorSystem *integ, realtype tt
+		, N_Vector yy, N_Vector yp
+){
+	IntegratorIdaData *enginedata;
+	double *x, *y = NV_DATA_S(yy), *ydot = NV_DATA_S(yp);
+	int32 *yindex, *ydotindex;
+	int i;
+
+	enginedata = integrator_ida_enginedata(integ);
+	if(enginedata->xsys == NULL && integrator_ida_load_x(integ)){
+		return -1;
+	}
+	x = enginedata->xsys;
+	yindex = enginedata->yindex;
+	ydotindex = enginedata->ydotindex;
+	if(enginedata->xindex >= 0){
+		x[enginedata->xindex] = (double)tt;
+	}
+	for(i=0; i < integ->n_y; ++i){
+		x[yindex[i]] = y[i];
+		if(ydotindex[i] >= 0){
+			x[ydotindex[i]] = ydot[i];
+		}
+	}
+	return 0;
+}
+
+/**
+	After a failed residual (or, if diffs, sparse Jacobian) evaluation,
+	evaluate the relations again one at a time on this thread, from values
+	passed back to the compiler, to name the ones that failed. Only used on
+	the error path.
+	@return the number of relations named
+*/
+static int integrator_ida_report_rels(IntegratorSystem *integ
+		, N_Vector yy, N_Vector yp, int fpe, int diffs
+){
+	IntegratorIdaData *enginedata = integrator_ida_enginedata(integ);
+	struct rel_relation **rels = enginedata->rellist;
+	struct var_variable **variables = NULL;
+	double *derivatives = NULL;
+	char *relname;
+	int i, nrels = enginedata->nrels, count, nvars, calc_ok, n = 0;
+
+	if(diffs){
+		rels = enginedata->jacrels;
+		nrels = enginedata->njacrels;
+		nvars = slv_get_num_solvers_vars(integ->system);
+		variables = ASC_NEW_ARRAY(struct var_variable *, nvars + 1);
+		derivatives = ASC_NEW_ARRAY(double, nvars + 1);
+	}
+	integrator_set_y(integ, NV_DATA_S(yy));
+	integrator_set_ydot(integ, NV_DATA_S(yp));
+	for(i=0; i < nrels; ++i){
+		Asc_FPEClear();
+		if(diffs){
+			calc_ok = !relman_diff3(rels[i], &enginedata->vfilter
+				, derivatives, variables, &count, enginedata->safeeval
+			);
+		}else{
+			relman_eval(rels[i], &calc_ok, enginedata->safeeval);
+		}
+		if(!calc_ok || (fpe && Asc_FPETest())){
+			relname = rel_make_name(integ->system, rels[i]);
+			if(calc_ok){
+				ERROR_REPORTER_HERE(ASC_PROG_ERR,"Floating point error in rel '%s'",relname);
+			}else{
+				ERROR_REPORTER_HERE(ASC_PROG_ERR,"Calculation error in rel '%s'",relname);
+			}
+			ASC_FREE(relname);
+			n++;
+		}
+	}
+	Asc_FPEClear();
+	if(variables != NULL)ASC_FREE(variables);
+	if(derivatives != NULL)ASC_FREE(derivatives);
+	return n;
+}
+
 /**
 	Function to evaluate system residuals, in the form required for IDA.
 
@@ -113,12 +349,11 @@ void integrator_ida_sig(int sig){
 int integrator_ida_fex(realtype tt, N_Vector yy, N_Vector yp, N_Vector rr, void *res_data){
 	IntegratorSystem *integ;
 	IntegratorIdaData *enginedata;
-	int i, calc_ok, is_error;
-	struct rel_relation** relptr;
-	double resid;
-	char *relname;
+	int i, nfail, is_error;
+	int flags;
 #ifdef FEX_DEBUG
 	char *varname;
+	char *relname;
 	char diffname[30];
 #endif
 
@@ -141,52 +376,45 @@ int integrator_ida_fex(realtype tt, N_Vector yy, N_Vector yp, N_Vector rr, void
 		return -1; /* unrecoverable */
 	}
 
-	/* pass the values of everything back to the compiler */
+	/*
+		put the values into the flat variable vector used for evaluation,
+		and check the bounds there: the compiler's copies of y and ydot are
+		not updated here.
+	*/
 	integrator_set_t(integ, (double)tt);
-	integrator_set_y(integ, NV_DATA_S(yy));
-	integrator_set_ydot(integ, NV_DATA_S(yp));
-
-	/* perform bounds checking on all variables */
-	if(slv_check_bounds(integ->system, 0, -1, NULL)){
+	if(integrator_ida_set_x(integ, tt, yy, yp)){
+		return -1;
+	}
+	if(integrator_ida_check_bounds(integ)){
 		/* ERROR_REPORTER_HERE(ASC_PROG_WARNING,"Variable(s) out of bounds"); */
 		return 1;
 	}
 
-	/* evaluate each residual in the rellist */
+	/* evaluate all the residuals in one pass */
 	is_error = 0;
-	relptr = enginedata->rellist;
-
-
-#ifdef ASC_SIGNAL_TRAPS
-	if(enginedata->safeeval){
-		Asc_SignalHandlerPush(SIGFPE,SIG_IGN);
-	}else{
-# ifdef FEX_DEBUG
-		ERROR_REPORTER_HERE(ASC_PROG_ERR,"SETTING TO CATCH SIGFPE...");
-# endif
-		Asc_SignalHandlerPushDefault(SIGFPE);
+	flags = SYS_EVAL_EQUALITY;
+	if(enginedata->safeeval)flags |= SYS_EVAL_SAFE;
+
+	/*
+		check the FPE flags rather than trapping SIGFPE, so that nothing here
+		depends on the one global g_fpe_env.
+	*/
+	Asc_FPEClear();
+
+	nfail = system_eval_residuals(integ->system, enginedata->xsys
+		, enginedata->rsys, flags
+	);
+	if(nfail){
+		if(nfail < 0){
+			ERROR_REPORTER_HERE(ASC_PROG_ERR,"Unable to evaluate residuals");
+		}else if(!integrator_ida_report_rels(integ, yy, yp, 0, 0)){
+			ERROR_REPORTER_HERE(ASC_PROG_ERR,"Calculation error in %d relations",nfail);
+		}
+		is_error = 1;
 	}
 
-	if (SETJMP(g_fpe_env)==0) {
-#endif
-
-
-	for(i=0, relptr = enginedata->rellist;
-				i< enginedata->nrels && relptr != NULL;
-				++i, ++relptr
-	){
-		resid = relman_eval(*relptr, &calc_ok, enginedata->safeeval);
-
-		NV_Ith_S(rr,i) = resid;
-		if(!calc_ok){
-			relname = rel_make_name(integ->system, *relptr);
-			ERROR_REPORTER_HERE(ASC_PROG_ERR,"Calculation error in rel '%s'",relname);
-			ASC_FREE(relname);
-			/* presumable some output already made? */
-			is_error = 1;
-		}/*else{
-			CONSOLE_DEBUG("Calc OK");
-		}*/
+	for(i=0; i < enginedata->nrels; ++i){
+		NV_Ith_S(rr,i) = enginedata->rsys[rel_sindex(enginedata->rellist[i])];
 	}
 
 	if(!is_error){
@@ -203,21 +431,13 @@ int integrator_ida_fex(realtype tt, N_Vector yy, N_Vector yp, N_Vector rr, void
 #endif
 	}
 
-#ifdef ASC_SIGNAL_TRAPS
-	}else{
-		relname = rel_make_name(integ->system, *relptr);
-		ERROR_REPORTER_HERE(ASC_PROG_ERR,"Floating point error (SIGFPE) in rel '%s'",relname);
-		ASC_FREE(relname);
+	if(!enginedata->safeeval && !is_error && Asc_FPETest()){
+		if(!integrator_ida_report_rels(integ, yy, yp, 1, 0)){
+			ERROR_REPORTER_HERE(ASC_PROG_ERR,"Floating point error evaluating residuals");
+		}
 		is_error = 1;
 	}
 
-	if(enginedata->safeeval){
-		Asc_SignalHandlerPop(SIGFPE,SIG_IGN);
-	}else{
-		Asc_SignalHandlerPopDefault(SIGFPE);
-	}
-#endif
-
 
 #ifdef FEX_DEBUG
 	/* output residuals to console */
@@ -249,9 +469,191 @@ int integrator_ida_fex(realtype tt, N_Vector yy, N_Vector yp, N_Vector rr, void
 	return 0;
 }
 
+/**
+	Column of the iteration matrix for a variable found in a gradient: the
+	index of y for a derivative, since dF/dy' goes in with dF/dy, else the
+	variable's own solver index. -1 for the independent variable.
+*/
+static int integrator_ida_sjac_col(IntegratorSystem *integ, struct var_variable *var){
+	if(var == integ->x){
+		return -1;
+	}
+	if(var_deriv(var)){
+		return integrator_ida_diffindex(integ,var);
+	}
+	return var_sindex(var);
+}
+
+/**
+	Split the rels into those whose gradients are calculated one by one
+	and the blackboxes differenced together, and color the y columns of
+	the latter. Called from integrator_ida_djex and integrator_ida_sjex
+	the first time they are needed; freed by integrator_ida_free_x.
+	@return 0 on success
+*/
+static int integrator_ida_load_jac(IntegratorSystem *integ){
+	IntegratorIdaData *enginedata = integrator_ida_enginedata(integ);
+	struct rel_relation *rel;
+	struct var_variable **incid;
+	int32 *rowptr, *colidx, *mark;
+	int32 i, k, n, col, nnz = 0;
+
+	enginedata->jacrels = ASC_NEW_ARRAY(struct rel_relation *, enginedata->nrels + 1);
+	enginedata->jacrow = ASC_NEW_ARRAY(int32, enginedata->nrels + 1);
+	enginedata->fdrels = ASC_NEW_ARRAY(struct rel_relation *, enginedata->nrels + 1);
+	enginedata->fdrow = ASC_NEW_ARRAY(int32, enginedata->nrels + 1);
+	if(enginedata->jacrels == NULL || enginedata->jacrow == NULL
+		|| enginedata->fdrels == NULL || enginedata->fdrow == NULL
+	){
+		return 1;
+	}
+	for(i = 0; i < enginedata->nrels; ++i){
+		rel = enginedata->rellist[i];
+		if(system_coloring_rel_fdiff(rel)){
+			enginedata->fdrow[enginedata->nfdrels] = i;
+			enginedata->fdrels[enginedata->nfdrels++] = rel;
+			nnz += rel_n_incidences(rel);
+		}else{
+			enginedata->jacrow[enginedata->njacrels] = i;
+			enginedata->jacrels[enginedata->njacrels++] = rel;
+		}
+	}
+	if(enginedata->nfdrels == 0){
+		return 0;
+	}
+
+	/* y columns of the blackbox rows, a variable and its derivative merged */
+	rowptr = ASC_NEW_ARRAY(int32, enginedata->nfdrels + 1);
+	colidx = ASC_NEW_ARRAY(int32, nnz + 1);
+	mark = ASC_NEW_ARRAY(int32, integ->n_y + 1);
+	if(rowptr == NULL || colidx == NULL || mark == NULL){
+		if(rowptr != NULL)ASC_FREE(rowptr);
+		if(colidx != NULL)ASC_FREE(colidx);
+		if(mark != NULL)ASC_FREE(mark);
+		return 1;
+	}
+	for(col = 0; col < integ->n_y; ++col){
+		mark[col] = -1;
+	}
+	nnz = 0;
+	for(i = 0; i < enginedata->nfdrels; ++i){
+		rowptr[i] = nnz;
+		rel = enginedata->fdrels[i];
+		incid = (struct var_variable **)rel_incidence_list(rel);
+		n = rel_n_incidences(rel);
+		for(k = 0; k < n; ++k){
+			if(!var_apply_filter(incid[k], &enginedata->vfilter))continue;
+			col = integrator_ida_sjac_col(integ, incid[k]);
+			if(col < 0 || col >= integ->n_y || mark[col] == i)continue;
+			mark[col] = i;
+			colidx[nnz++] = col;
+		}
+	}
+	rowptr[enginedata->nfdrels] = nnz;
+
+	enginedata->fdcolor = system_coloring_create(enginedata->nfdrels
+		, integ->n_y, rowptr, colidx
+	);
+	enginedata->fdbatch = relman_batch_create(enginedata->fdrels
+		, enginedata->nfdrels
+	);
+	enginedata->fdres = ASC_NEW_ARRAY(double, enginedata->nfdrels);
+	enginedata->fdstep = ASC_NEW_ARRAY(double, integ->n_y + 1);
+	enginedata->fdvalue = ASC_NEW_ARRAY(double, nnz + 1);
+	ASC_FREE(rowptr);
+	ASC_FREE(colidx);
+	ASC_FREE(mark);
+	if(enginedata->fdcolor == NULL || enginedata->fdbatch == NULL
+		|| enginedata->fdres == NULL || enginedata->fdstep == NULL
+		|| enginedata->fdvalue == NULL
+	){
+		return 1;
+	}
+	return 0;
+}
+
+struct IntegratorIdaSweep{
+	IntegratorSystem *integ;
+	double *y, *ydot;
+	realtype c_j;
+};
+
+/**
+	SystemColoringSweepFn for the blackbox rows: perturb y by dir and
+	ydot by c_j dir in the flat vector, so that the differences are
+	those of the iteration matrix dF/dy + c_j dF/dy'.
+*/
+static int integrator_ida_sweep(void *data, CONST real64 *dir, real64 *jv){
+	struct IntegratorIdaSweep *sw = (struct IntegratorIdaSweep *)data;
+	IntegratorIdaData *enginedata = integrator_ida_enginedata(sw->integ);
+	double *x = enginedata->xsys;
+	int32 *yindex = enginedata->yindex, *ydotindex = enginedata->ydotindex;
+	int32 i, j, nfail;
+
+	for(j = 0; j < sw->integ->n_y; ++j){
+		if(dir[j] == 0.0)continue;
+		x[yindex[j]] += dir[j];
+		if(ydotindex[j] >= 0){
+			x[ydotindex[j]] += sw->c_j * dir[j];
+		}
+	}
+	nfail = relman_batch_eval(enginedata->fdbatch, x, enginedata->rsys
+		, NULL, enginedata->safeeval
+	);
+	for(j = 0; j < sw->integ->n_y; ++j){
+		x[yindex[j]] = sw->y[j];
+		if(ydotindex[j] >= 0){
+			x[ydotindex[j]] = sw->ydot[j];
+		}
+	}
+	for(i = 0; i < enginedata->nfdrels; ++i){
+		jv[i] = enginedata->rsys[rel_sindex(enginedata->fdrels[i])]
+			- enginedata->fdres[i];
+	}
+	return nfail ? 1 : 0;
+}
+
+/**
+	Difference the blackbox rows of the iteration matrix, one sweep per
+	color, into enginedata->fdvalue. The flat vector must hold tt, yy and
+	yp (integrator_ida_set_x). The blackboxes' inputs in the instance tree
+	are left perturbed, so the caller must put y and ydot back there.
+	@return 0 on success
+*/
+static int integrator_ida_fdiff(IntegratorSystem *integ
+		, N_Vector yy, N_Vector yp, realtype c_j
+){
+	IntegratorIdaData *enginedata = integrator_ida_enginedata(integ);
+	struct IntegratorIdaSweep sw;
+	int32 i, j;
+
+	if(relman_batch_eval(enginedata->fdbatch, enginedata->xsys
+		, enginedata->rsys, NULL, enginedata->safeeval)
+	){
+		return 1;
+	}
+	for(i = 0; i < enginedata->nfdrels; ++i){
+		enginedata->fdres[i] = enginedata->rsys[rel_sindex(enginedata->fdrels[i])];
+	}
+	sw.integ = integ;
+	sw.y = NV_DATA_S(yy);
+	sw.ydot = NV_DATA_S(yp);
+	sw.c_j = c_j;
+	for(j = 0; j < integ->n_y; ++j){
+		enginedata->fdstep[j] = system_coloring_step(sw.y[j]);
+	}
+	return system_coloring_eval(enginedata->fdcolor, enginedata->fdstep
+		, &integrator_ida_sweep, &sw, enginedata->fdvalue
+	);
+}
+
 /**
 	Dense Jacobian evaluation. Only suitable for small problems!
 	Has been seen working for problems up to around 2000 vars, FWIW.
+
+	The gradients are evaluated with system_jacobian_eval, except those of
+	blackboxes with no derivative function, which are differenced all
+	together, one sweep per color of their columns (integrator_ida_fdiff).
 */
 #if SUNDIALS_VERSION_MAJOR==2 && SUNDIALS_VERSION_MINOR>=4
 int integrator_ida_djex(int Neq, realtype tt, realtype c_j
@@ -270,38 +672,56 @@ int integrator_ida_djex(long int Neq, realtype tt
 	IntegratorIdaData *enginedata;
 	char *relname;
 #ifdef DJEX_DEBUG
-	struct var_variable **varlist;
 	char *varname;
 #endif
-	struct rel_relation **relptr;
-	int i;
-	double *derivatives;
-	struct var_variable **variables;
-	int count, j;
-	int status, is_error = 0;
+	struct var_variable **vlist;
+	struct SystemJacobianEntries ent;
+	struct SystemJacobianBuffer *buf;
+	SystemColoring *fdc;
+	int i, j, b, k, col;
+	double v;
+	int is_error = 0;
 
 	integ = (IntegratorSystem *)jac_data;
 	enginedata = integrator_ida_enginedata(integ);
+	ent.nbuf = 0;
+	ent.buf = NULL;
+	ent.status = NULL;
+
+	/* perform bounds checking on the states and derivatives */
+	if(integrator_ida_set_x(integ, tt, yy, yp)
+		|| integrator_ida_check_bounds(integ)
+	){
+		/* ERROR_REPORTER_HERE(ASC_PROG_WARNING,"Variable(s) out of bounds"); */
+		return 1;
+	}
+	if(enginedata->jacrels == NULL && integrator_ida_load_jac(integ)){
+		ERROR_REPORTER_HERE(ASC_PROG_ERR,"Insufficient memory");
+		return -1;
+	}
 
-	/* allocate space for returns from relman_diff3 */
-	/** @TODO instead, we should use 'tmp1' and 'tmp2' here... */
-	variables = ASC_NEW_ARRAY(struct var_variable*, NV_LENGTH_S(yy) * 2);
-	derivatives = ASC_NEW_ARRAY(double, NV_LENGTH_S(yy) * 2);
+	/* the blackboxes first, all together, from the flat vector... */
+	if(enginedata->nfdrels){
+		if(integrator_ida_fdiff(integ, yy, yp, c_j)){
+			ERROR_REPORTER_HERE(ASC_PROG_ERR,"Error differencing blackbox relations");
+			is_error = 1;
+		}else{
+			fdc = enginedata->fdcolor;
+			for(j = 0; j < fdc->ncols; ++j){
+				for(k = fdc->colptr[j]; k < fdc->colptr[j + 1]; ++k){
+					DENSE_ELEM(Jac,enginedata->fdrow[fdc->row[k]],j)
+						= enginedata->fdvalue[fdc->slot[k]];
+				}
+			}
+		}
+	}
 
-	/* pass the values of everything back to the compiler */
+	/* ...then the gradients of the rest, from the compiler's values */
 	integrator_set_t(integ, (double)tt);
 	integrator_set_y(integ, NV_DATA_S(yy));
 	integrator_set_ydot(integ, NV_DATA_S(yp));
 
-	/* perform bounds checking on all variables */
-	if(slv_check_bounds(integ->system, 0, -1, NULL)){
-		/* ERROR_REPORTER_HERE(ASC_PROG_WARNING,"Variable(s) out of bounds"); */
-		return 1;
-	}
-
 #ifdef DJEX_DEBUG
-	varlist = slv_get_solvers_var_list(integ->system);
-
 	/* print vars */
 	for(i=0; i < integ->n_y; ++i){
 		varname = var_make_name(integ->system, integ->y[i]);
@@ -327,66 +747,36 @@ int integrator_ida_djex(long int Neq, realtype tt
 	CONSOLE_DEBUG("<c_j> = %g",c_j);
 #endif
 
-	/* build up the dense jacobian matrix... */
-	status = 0;
-	for(i=0, relptr = enginedata->rellist;
-			i< enginedata->nrels && relptr != NULL;
-			++i, ++relptr
+	vlist = slv_get_solvers_var_list(integ->system);
+	if(!is_error && system_jacobian_eval(enginedata->jacrels, enginedata->njacrels
+		, &enginedata->vfilter, enginedata->safeeval, asc_task_num_cpus(), &ent)
 	){
-		/* get derivatives for this particular relation */
-		status = relman_diff3(*relptr, &enginedata->vfilter, derivatives, variables, &count, enginedata->safeeval);
-
-		if(status){
-			relname = rel_make_name(integ->system, *relptr);
-			CONSOLE_DEBUG("ERROR calculating derivatives for relation '%s'",relname);
-			ASC_FREE(relname);
-			is_error = 1;
-			break;
-		}
-
-		/* output what's going on here ... */
-#ifdef DJEX_DEBUG
-		relname = rel_make_name(integ->system, *relptr);
-		fprintf(stderr,"%d: '%s': ",i,relname);
-		for(j=0;j<count;++j){
-			varname = var_make_name(integ->system, variables[j]);
-			if(var_deriv(variables[j])){
-				fprintf(stderr,"  '%s'=",varname);
-				fprintf(stderr,"ydot[%d]",integrator_ida_diffindex(integ,variables[j]));
-			}else{
-				fprintf(stderr,"  '%s'=y[%d]",varname,var_sindex(variables[j]));
+		for(i = 0; i < enginedata->njacrels; ++i){
+			if(ent.status[i]){
+				relname = rel_make_name(integ->system, enginedata->jacrels[i]);
+				CONSOLE_DEBUG("ERROR calculating derivatives for relation '%s'",relname);
+				ASC_FREE(relname);
 			}
-			ASC_FREE(varname);
 		}
-		/* relname is freed further down */
-		fprintf(stderr,"\n");
-#endif
-
-		/* insert values into the Jacobian row in appropriate spots (can assume Jac starts with zeros -- IDA manual) */
-		for(j=0; j < count; ++j){
-#ifdef DJEX_DEBUG
-			varname = var_make_name(integ->system,variables[j]);
-			fprintf(stderr,"d(%s)/d(%s) = %g",relname,varname,derivatives[j]);
-			ASC_FREE(varname);
-#endif
-			if(!var_deriv(variables[j])){
-#ifdef DJEX_DEBUG
-				fprintf(stderr," --> J[%d,%d] += %g\n", i,j,derivatives[j]);
-				asc_assert(var_sindex(variables[j]) >= 0);
-				ASC_ASSERT_LT(var_sindex(variables[j]) , Neq);
-#endif
-				DENSE_ELEM(Jac,i,var_sindex(variables[j])) += derivatives[j];
-			}else{
-				DENSE_ELEM(Jac,i,integrator_ida_diffindex(integ,variables[j])) += derivatives[j] * c_j;
-#ifdef DJEX_DEBUG
-				fprintf(stderr," --> * c_j --> J[%d,%d] += %g\n", i,j,derivatives[j] * c_j);
-#endif
+		is_error = 1;
+	}else if(!is_error){
+		/* insert values into the Jacobian in appropriate spots (can assume Jac starts with zeros -- IDA manual) */
+		for(b = 0; b < ent.nbuf; ++b){
+			buf = &(ent.buf[b]);
+			for(k = 0; k < buf->n; ++k){
+				col = integrator_ida_sjac_col(integ, vlist[buf->var[k]]);
+				if(col < 0)continue;
+				v = buf->value[k];
+				if(var_deriv(vlist[buf->var[k]])){
+					v *= c_j;
+				}
+				DENSE_ELEM(Jac,enginedata->jacrow[buf->rel[k]],col) += v;
 			}
 		}
 	}
+	system_jacobian_entries_destroy(&ent);
 
 #ifdef DJEX_DEBUG
-	ASC_FREE(relname);
 	CONSOLE_DEBUG("PRINTING JAC");
 	fprintf(stderr,"\t");
 	for(j=0; j < integ->n_y; ++j){
@@ -430,9 +820,6 @@ int integrator_ida_djex(long int Neq, realtype tt
 		is_error = 1;
 	}*/
 
-	ASC_FREE(variables);
-	ASC_FREE(derivatives);
-
 	if(is_error){
 		ERROR_REPORTER_HERE(ASC_PROG_ERR,"There were derivative evaluation errors in the dense jacobian");
 		return 1;
@@ -505,10 +892,7 @@ int integrator_ida_jvex(realtype tt, N_Vector yy, N_Vector yp, N_Vector rr
 	/* evaluate the derivatives... */
 	/* J = dG_dy = dF_dy + alpha * dF_dyp */
 
-#ifdef ASC_SIGNAL_TRAPS
-	Asc_SignalHandlerPushDefault(SIGFPE);
-	if (SETJMP(g_fpe_env)==0) {
-#endif
+	Asc_FPEClear();
 		for(i=0, relptr = enginedata->rellist;
 				i< enginedata->nrels && relptr != NULL;
 				++i, ++relptr
@@ -526,6 +910,13 @@ int integrator_ida_jvex(realtype tt, N_Vector yy, N_Vector yp, N_Vector rr
 				is_error = 1;
 				break;
 			}
+			if(!enginedata->safeeval && Asc_FPETest()){
+				relname = rel_make_name(integ->system, *relptr);
+				ERROR_REPORTER_HERE(ASC_PROG_ERR,"Floating point error in rel '%s'",relname);
+				ASC_FREE(relname);
+				is_error = 1;
+				break;
+			}
 
 			/*
 				Now we have the derivatives wrt each alg/diff variable in the
@@ -588,15 +979,6 @@ int integrator_ida_jvex(realtype tt, N_Vector yy, N_Vector yp, N_Vector rr
 			return 1;
 #endif
 		}
-#ifdef ASC_SIGNAL_TRAPS
-	}else{
-		relname = rel_make_name(integ->system, *relptr);
-		ERROR_REPORTER_HERE(ASC_PROG_ERR,"Floating point error (SIGFPE) in rel '%s'",relname);
-		ASC_FREE(relname);
-		is_error = 1;
-	}
-	Asc_SignalHandlerPopDefault(SIGFPE);
-#endif
 
 	if(is_error){
 		CONSOLE_DEBUG("SOME ERRORS FOUND IN EVALUATION");
@@ -605,14 +987,207 @@ int integrator_ida_jvex(realtype tt, N_Vector yy, N_Vector yp, N_Vector rr
 	return 0;
 }
 
-/* sparse jacobian evaluation for IDAASCEND sparse direct linear solver */
+/**
+	Sparse Jacobian evaluation for the IDAASCEND sparse direct linear
+	solver: Jac = dF/dy + c_j dF/dy'.
+
+	The gradients are evaluated with system_jacobian_eval, on as many
+	threads as there are processors, and those of blackboxes with no
+	derivative function by integrator_ida_fdiff. The first time, and
+	whenever the set of incidences changes, Jac is cleared and refilled
+	and its pattern is kept in enginedata->sjac; otherwise the values are put in place through
+	that pattern, so that the elements of Jac (and with them the pivot
+	sequence of a previous factorisation) stay where they were.
+*/
 int integrator_ida_sjex(long int Neq, realtype tt
 		, N_Vector yy, N_Vector yp, N_Vector rr
 		, realtype c_j, void *jac_data, mtx_matrix_t Jac
 		, N_Vector tmp1, N_Vector tmp2, N_Vector tmp3
 ){
-	ERROR_REPORTER_HERE(ASC_PROG_ERR,"Not implemented");
-	return -1;
+	IntegratorSystem *integ;
+	IntegratorIdaData *enginedata;
+	struct var_variable **vlist;
+	struct SystemJacobianEntries ent;
+	struct SystemJacobianBuffer *buf;
+	SystemColoring *fdc;
+	mtx_coord_t coord;
+	real64 *value, v;
+	int32 *pos, *cols, ncol, slot;
+	int32 b, k, i, col;
+	char *relname;
+	int is_error = 0, fpe = 0;
+
+	integ = (IntegratorSystem *)jac_data;
+	enginedata = integrator_ida_enginedata(integ);
+
+	if(integrator_ida_set_x(integ, tt, yy, yp)
+		|| integrator_ida_check_bounds(integ)
+	){
+		return 1;
+	}
+	if(enginedata->jacrels == NULL && integrator_ida_load_jac(integ)){
+		ERROR_REPORTER_HERE(ASC_PROG_ERR,"Insufficient memory");
+		return -1;
+	}
+	if(enginedata->nfdrels && integrator_ida_fdiff(integ, yy, yp, c_j)){
+		ERROR_REPORTER_HERE(ASC_PROG_ERR,"Error differencing blackbox relations");
+		return 1;
+	}
+	fdc = enginedata->fdcolor;
+
+	/* the gradients are evaluated from the compiler's values */
+	integrator_set_t(integ, (double)tt);
+	integrator_set_y(integ, NV_DATA_S(yy));
+	integrator_set_ydot(integ, NV_DATA_S(yp));
+
+	vlist = slv_get_solvers_var_list(integ->system);
+
+	Asc_FPEClear();
+	if(system_jacobian_eval(enginedata->jacrels, enginedata->njacrels
+		, &enginedata->vfilter, enginedata->safeeval, asc_task_num_cpus(), &ent)
+	){
+		for(i = 0; i < enginedata->njacrels; ++i){
+			if(ent.status[i]){
+				relname = rel_make_name(integ->system, enginedata->jacrels[i]);
+				ERROR_REPORTER_HERE(ASC_PROG_ERR,"Error calculating derivatives for relation '%s'",relname);
+				ASC_FREE(relname);
+			}
+		}
+		system_jacobian_entries_destroy(&ent);
+		return 1;
+	}
+
+	/* a pattern left over from some other matrix is no use */
+	if(enginedata->sjac != NULL
+		&& (mtx_csr_matrix(enginedata->sjac) != Jac
+			|| !mtx_csr_valid(enginedata->sjac, NULL))
+	){
+		mtx_csr_destroy(enginedata->sjac);
+		enginedata->sjac = NULL;
+	}
+
+	if(enginedata->sjac != NULL){
+		/* same pattern as last time, we hope: add up the values in place */
+		mtx_csr_zero(enginedata->sjac);
+		value = mtx_csr_values(enginedata->sjac);
+		for(b = 0; b < ent.nbuf && enginedata->sjac != NULL; ++b){
+			buf = &(ent.buf[b]);
+			for(k = 0; k < buf->n; ++k){
+				col = integrator_ida_sjac_col(integ, vlist[buf->var[k]]);
+				if(col < 0)continue;
+				slot = mtx_csr_find(enginedata->sjac
+					, enginedata->jacrow[buf->rel[k]], col
+				);
+				if(slot < 0){
+					/* new incidence: start again from an empty matrix */
+					mtx_csr_destroy(enginedata->sjac);
+					enginedata->sjac = NULL;
+					break;
+				}
+				v = buf->value[k];
+				if(var_deriv(vlist[buf->var[k]])){
+					v *= c_j;
+				}
+				value[slot] += v;
+			}
+		}
+		for(col = 0; fdc != NULL && enginedata->sjac != NULL && col < fdc->ncols; ++col){
+			for(k = fdc->colptr[col]; k < fdc->colptr[col + 1]; ++k){
+				slot = mtx_csr_find(enginedata->sjac
+					, enginedata->fdrow[fdc->row[k]], col
+				);
+				if(slot < 0){
+					mtx_csr_destroy(enginedata->sjac);
+					enginedata->sjac = NULL;
+					break;
+				}
+				value[slot] = enginedata->fdvalue[fdc->slot[k]];
+			}
+		}
+		if(enginedata->sjac != NULL){
+			mtx_csr_put(enginedata->sjac);
+		}
+	}
+
+	if(enginedata->sjac == NULL){
+		/*
+			Fill a cleared matrix. A variable and its derivative share a
+			column, so merge the entries of each row before filling; the
+			entries of a row are contiguous within one buffer.
+		*/
+		mtx_clear(Jac);
+		pos = ASC_NEW_ARRAY(int32, Neq);
+		cols = ASC_NEW_ARRAY(int32, Neq);
+		value = ASC_NEW_ARRAY(real64, Neq);
+		for(col = 0; col < Neq; ++col){
+			pos[col] = -1;
+		}
+		for(b = 0; b < ent.nbuf; ++b){
+			buf = &(ent.buf[b]);
+			k = 0;
+			while(k < buf->n){
+				i = enginedata->jacrow[buf->rel[k]];
+				ncol = 0;
+				for(; k < buf->n && enginedata->jacrow[buf->rel[k]] == i; ++k){
+					col = integrator_ida_sjac_col(integ, vlist[buf->var[k]]);
+					if(col < 0)continue;
+					v = buf->value[k];
+					if(var_deriv(vlist[buf->var[k]])){
+						v *= c_j;
+					}
+					if(pos[col] < 0){
+						pos[col] = ncol;
+						cols[ncol] = col;
+						value[ncol++] = v;
+					}else{
+						value[pos[col]] += v;
+					}
+				}
+				for(slot = 0; slot < ncol; ++slot){
+					mtx_fill_org_value(Jac
+						, mtx_coord(&coord, i, cols[slot]), value[slot]
+					);
+					pos[cols[slot]] = -1;
+				}
+			}
+		}
+		/* each blackbox row is all differenced, with no repeated cols */
+		for(col = 0; fdc != NULL && col < fdc->ncols; ++col){
+			for(k = fdc->colptr[col]; k < fdc->colptr[col + 1]; ++k){
+				mtx_fill_org_value(Jac
+					, mtx_coord(&coord, enginedata->fdrow[fdc->row[k]], col)
+					, enginedata->fdvalue[fdc->slot[k]]
+				);
+			}
+		}
+		ASC_FREE(pos);
+		ASC_FREE(cols);
+		ASC_FREE(value);
+		enginedata->sjac = mtx_csr_create(Jac, mtx_ENTIRE_MATRIX);
+	}
+	system_jacobian_entries_destroy(&ent);
+
+	/*
+		test for NANs. The FPE flags only show what was raised on this
+		thread, and the gradients may have been evaluated on others, so take
+		an infinite value as a floating point error too.
+	*/
+	value = mtx_csr_values(enginedata->sjac);
+	for(slot = 0; slot < mtx_csr_nonzeros(enginedata->sjac); ++slot){
+		if(isnan(value[slot])){
+			ERROR_REPORTER_HERE(ASC_PROG_ERR,"NAN detected in sparse jacobian");
+			is_error = 1;
+			break;
+		}
+		if(isinf(value[slot]))fpe = 1;
+	}
+	if(!enginedata->safeeval && !is_error && (fpe || Asc_FPETest())){
+		if(!integrator_ida_report_rels(integ, yy, yp, 1, 1)){
+			ERROR_REPORTER_HERE(ASC_PROG_ERR,"Floating point error evaluating Jacobian");
+		}
+		is_error = 1;
+	}
+	return is_error;
 }
 
 /* root finding function */
@@ -629,10 +1204,26 @@ int integrator_ida_rootfn(realtype tt, N_Vector yy, N_Vector yp, realtype *gout,
 	integ = (IntegratorSystem *)g_data;
 	enginedata = integrator_ida_enginedata(integ);
 
-	/* pass the values of everything back to the compiler */
+	/*
+		The real-valued boundaries are evaluated from xsys, as the residuals
+		are. Logical ones need the values in the compiler.
+	*/
 	integrator_set_t(integ, (double)tt);
-	integrator_set_y(integ, NV_DATA_S(yy));
-	integrator_set_ydot(integ, NV_DATA_S(yp));
+	if(integrator_ida_set_x(integ, tt, yy, yp)){
+		return -1;
+	}
+	if(enginedata->bndbatch != NULL){
+		relman_batch_eval(enginedata->bndbatch, enginedata->xsys
+			, enginedata->bndres, NULL, 1
+		);
+	}
+	for(i=0; i < enginedata->nbnds; ++i){
+		if(bnd_kind(enginedata->bndlist[i]) == e_bnd_logrel){
+			integrator_set_y(integ, NV_DATA_S(yy));
+			integrator_set_ydot(integ, NV_DATA_S(yp));
+			break;
+		}
+	}
 
 	asc_assert(gout!=NULL);
 
@@ -644,7 +1235,9 @@ int integrator_ida_rootfn(realtype tt, N_Vector yy, N_Vector yp, realtype *gout,
 	for(i=0; i < enginedata->nbnds; ++i){
 		switch(bnd_kind(enginedata->bndlist[i])){
 			case e_bnd_rel: /* real-valued boundary relation */
-				gout[i] = bndman_real_eval(enginedata->bndlist[i]);
+				gout[i] = enginedata->bndres[rel_sindex(
+					bnd_rel(bnd_real_cond(enginedata->bndlist[i]))
+				)];
 #ifdef ROOT_DEBUG
 				relname = bnd_make_name(integ->system,enginedata->bndlist[i]);
 				CONSOLE_DEBUG("gout[%d] = %f (boundary '%s')", i, gout[i], relname);
@@ -21,6 +21,44 @@
 
 #include "ida.h"
 #include "idalinear.h"
+#include "idatypes.h"
+
+#include <ascend/integrator/integrator.h>
+
+/**
+	(Re)load the flat vector of solver variable values used by
+	integrator_ida_fex from the instance tree. Must be called whenever
+	values or the solver's lists may have been changed other than via
+	integrator_ida_fex, eg after a boundary crossing.
+*/
+int integrator_ida_load_x(IntegratorSystem *integ);
+/**<
+	Also makes the maps from y and ydot into the flat vector, the list of
+	the states and derivatives that have bounds other than the defaults
+	(+/-1e20), and the evaluator of the real-valued boundary conditions.
+*/
+
+/**
+	Free what integrator_ida_load_x allocated, and the split of the rels
+	made for the Jacobian.
+*/
+void integrator_ida_free_x(IntegratorIdaData *enginedata);
+
+/**
+	Put t, y and ydot into the flat vector through the maps made by
+	integrator_ida_load_x. The instance tree is not touched.
+	@return 0 on success, -1 if the flat vector could not be allocated.
+*/
+int integrator_ida_set_x(IntegratorSystem *integ, realtype tt
+		, N_Vector yy, N_Vector yp);
+
+/**
+	Check the values of y and ydot held in the flat vector against the
+	bounds of the variables, in the manner of slv_check_bounds. Only the
+	variables found to have bounds by integrator_ida_load_x are looked at.
+	@return 0 if all values are within bounds.
+*/
+int integrator_ida_check_bounds(IntegratorSystem *integ);
 
 /* residual function forward declaration */
 int integrator_ida_fex(realtype tt, N_Vector yy, N_Vector yp, N_Vector rr, void *res_data);
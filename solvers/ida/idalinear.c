@@ -2,6 +2,8 @@
 
 #include <ascend/utilities/error.h>
 #include <ascend/general/ascMalloc.h>
+#include <ascend/linear/linsolqr.h>
+#include <ascend/linear/mtx_csr.h>
 
 /** FIXME should the following be moved to ida.h? */
 #include <sundials/sundials_math.h>
@@ -16,7 +18,11 @@ typedef struct IntegratorIdaAscendMemStruct{
 	int                    integ_lastflag;
 	unsigned long          integ_nje;
 	unsigned long          integ_nre;
+	unsigned long          integ_nor;   /* orderings done, for new patterns */
 	mtx_matrix_t           integ_sparse_jac_matrix;
+	mtx_csr_t              integ_pattern; /* pattern the ordering was made for */
+	linsolqr_system_t      integ_linsys;
+	real64 *               integ_rhs;   /* rhs given to linsolqr, by org row */
 } IntegratorIdaAscendMem;
 
 /* readability replacements (see also ida_dense.c from SUNDIALS distro */
@@ -30,6 +36,7 @@ typedef struct IntegratorIdaAscendMemStruct{
 #define tn           (IDA_mem->ida_tn)
 #define cjratio      (IDA_mem->ida_cjratio)
 #define cj           (IDA_mem->ida_cj)
+#define setupNonNull (IDA_mem->ida_setupNonNull)
 
 #define nje          (iamem->integ_nje)
 #define nre          (iamem->integ_nre)
@@ -37,7 +44,11 @@ typedef struct IntegratorIdaAscendMemStruct{
 #define neq          (iamem->integ_neq)
 #define jacfn        (iamem->integ_jacfn)
 #define jacdata      (iamem->integ_jac_data)
+#define nor          (iamem->integ_nor)
 #define JJ           (iamem->integ_sparse_jac_matrix)
+#define JPAT         (iamem->integ_pattern)
+#define LL           (iamem->integ_linsys)
+#define RHS          (iamem->integ_rhs)
 
 #define MSGD_IDAMEM_NULL "Integrator memory is NULL."
 #define MSGD_MEM_FAIL    "A memory request failed."
@@ -73,14 +84,14 @@ int IDAASCEND(void *ida_mem, long _neq){
 	}
 	IDA_mem = (IDAMem)ida_mem;
 
-	iamem = ASC_NEW(IntegratorIdaAscendMem);
+	/* free linsolver memory with the previous lfree fn, if allocated */
+	if(lfree != NULL)lfree(IDA_mem);
+
+	iamem = ASC_NEW_CLEAR(IntegratorIdaAscendMem);
 	if(iamem == NULL){
+		IDAProcessError(IDA_mem, IDAASCEND_MEM_FAIL, "IDAASCEND", __FUNCTION__, MSGD_MEM_FAIL);
 		return IDAASCEND_MEM_FAIL;
 	}
-	lmem = (void *)iamem;
-
-	/* free linsolver memory with the previous lfree fn, if allocated */
-	if(lfree != NULL)lfree(ida_mem);
 
 	/* set the internal-use linear solver function pointers for IDA */
 	linit  = &integrator_ida_linit;
@@ -88,14 +99,25 @@ int IDAASCEND(void *ida_mem, long _neq){
 	lsolve = &integrator_ida_lsolve;
 	lperf  = NULL;
 	lfree  = &integrator_ida_lfree;
+	setupNonNull = TRUE;
 
 	/* no jacobian assigned, initially (we will throw an error if the user doesn't assign it though) */
 	jacfn = NULL;
+	jacdata = NULL;
 	lastflag = IDAASCEND_SUCCESS;
 	neq = _neq;
 
-	/* allocate memory required for Jacobian mtx_matrix_t ?? */
+	/* the matrix and its linsolqr system live as long as the solver */
+	JJ = mtx_create();
+	mtx_set_order(JJ, neq);
+	LL = linsolqr_create_default();
+	linsolqr_set_matrix(LL, JJ);
+	linsolqr_prep(LL, linsolqr_fmethod_to_fclass(linsolqr_fmethod(LL)));
+	RHS = ASC_NEW_ARRAY_CLEAR(real64, neq + 1);
+	linsolqr_add_rhs(LL, RHS, FALSE);
+	JPAT = NULL;
 
+	lmem = (void *)iamem;
 	return IDAASCEND_SUCCESS;
 }
 
@@ -116,6 +138,7 @@ int IDAASCENDSetJacFn(void *ida_mem, IntegratorSparseJacFn *_jacfn, void *_jac_d
 	iamem = (IntegratorIdaAscendMem *)lmem;
 
 	jacfn = _jacfn;
+	jacdata = _jac_data;
 
 	return IDAASCEND_SUCCESS;
 }
@@ -156,6 +179,8 @@ char *IDAASCENDGetReturnFlagName(int flag){
 		FLAG(IDAASCEND_JACFN_UNDEF);
 		FLAG(IDAASCEND_JACFN_UNRECVR);
 		FLAG(IDAASCEND_JACFN_RECVR);
+		FLAG(IDAASCEND_SINGULAR);
+		FLAG(IDAASCEND_STRUCT_SINGULAR);
 		default:
 			sprintf(name,"Unknown flag value '%d'",flag);
 	}
@@ -171,14 +196,59 @@ char *IDAASCENDGetReturnFlagName(int flag){
 int integrator_ida_linit(IDAMem IDA_mem){
   	IntegratorIdaAscendMem *iamem;
 	iamem = (IntegratorIdaAscendMem *)lmem;
-  
+
 	CONSOLE_DEBUG("Initialising IDA linear solver");
 	nje = 0;
 	nre = 0;
-	jacfn = NULL;
+	nor = 0;
+
+	if(jacfn==NULL){
+		lastflag = IDAASCEND_JACFN_UNDEF;
+		IDAProcessError(IDA_mem, IDAASCEND_JACFN_UNDEF, "IDAASCEND", __FUNCTION__, MSGD_JACFN_UNDEF);
+		return -1;
+	}
+	lastflag = IDAASCEND_SUCCESS;
+	return 0;
+}
+
+/**
+	Order the matrix for factoring, for a pattern we haven't seen before.
 
-	/* initialise anything else in the IntegratorIdaAscendMem that needs it */
+	The rows and columns are first permuted to put the matrix in block lower
+	triangular form, with mtx_output_assign and mtx_partition as
+	slv_block_partition does for the solver's incidence matrix. Each block
+	is then reordered by SPK1, and the whole matrix is factored as one
+	region: the pivots of a row are then always found within its own
+	block, so there is no fill above the diagonal blocks.
 
+	@return 0 on success, 1 if the matrix is structurally singular.
+*/
+static int integrator_ida_lorder(IntegratorIdaAscendMem *iamem){
+	mtx_region_t reg;
+	int32 b, nb;
+
+	nor++;
+	mtx_output_assign(JJ, neq, neq);
+	if(mtx_symbolic_rank(JJ) < neq){
+		ERROR_REPORTER_HERE(ASC_PROG_ERR,"Jacobian is structurally singular"
+			" (rank %d of %ld)",mtx_symbolic_rank(JJ),neq
+		);
+		return 1;
+	}
+	mtx_partition(JJ);
+	nb = mtx_number_of_blocks(JJ);
+	for(b = 0; b < nb; ++b){
+		mtx_block(JJ, b, &reg);
+		if(reg.row.high > reg.row.low){
+			linsolqr_reorder(LL, &reg, spk1);
+		}
+	}
+
+	/* then the whole matrix, left as it is, is the region to factor */
+	reg.row.low = reg.col.low = 0;
+	reg.row.high = reg.col.high = neq - 1;
+	linsolqr_set_region(LL, reg);
+	linsolqr_reorder(LL, &reg, natural);
 	return 0;
 }
 
@@ -191,8 +261,6 @@ int integrator_ida_lsetup(IDAMem IDA_mem
   	IntegratorIdaAscendMem *iamem;
 	iamem = (IntegratorIdaAscendMem *)lmem;
 
-	CONSOLE_DEBUG("Setting up IDA linear problem");
-
 	if(jacfn==NULL){
 		lastflag = IDAASCEND_JACFN_UNDEF;
 		return -1; /* unrecoverable */
@@ -201,11 +269,8 @@ int integrator_ida_lsetup(IDAMem IDA_mem
 	/* Increment nje counter. */
 	nje++;
 
-	/* clear the jacobian matrix */
-	/* ... */
-
-	/* evaluate the jacobian */
-	retval = jacfn(neq, tn, yyp, ypp, rrp, cj, jacdata, JJ, 
+	/* evaluate the jacobian; the elements of the last one are still there */
+	retval = jacfn(neq, tn, yyp, ypp, rrp, cj, jacdata, JJ,
 		tmp1, tmp2, tmp3
 	);
 
@@ -218,54 +283,87 @@ int integrator_ida_lsetup(IDAMem IDA_mem
 		return +1;
 	}
 
-	/* do block decomposition, LU factorisation or whatever, return success or fail flag */
-	/* ... */
+	/*
+		A new pattern needs a new ordering. With the old pattern, only the
+		values have changed and linsolqr_refactor replays the pivot sequence
+		of the last factorization if it can.
+	*/
+	linsolqr_matrix_was_changed(LL);
+	if(JPAT == NULL || !mtx_csr_valid(JPAT, NULL)){
+		mtx_csr_destroy(JPAT);
+		JPAT = NULL;
+		if(integrator_ida_lorder(iamem)){
+			lastflag = IDAASCEND_STRUCT_SINGULAR;
+			return -1;
+		}
+		JPAT = mtx_csr_create(JJ, mtx_ENTIRE_MATRIX);
+	}
+
+	if(linsolqr_refactor(LL, linsolqr_fmethod(LL))
+		|| linsolqr_rank(LL) < neq
+	){
+		lastflag = IDAASCEND_SINGULAR;
+		return +1; /* a smaller step may help */
+	}
 
-	ERROR_REPORTER_HERE(ASC_PROG_ERR,"Not implemented");
-	return(-1);
+	lastflag = IDAASCEND_SUCCESS;
+	return 0;
 }
 
 /**
 	This routines handles the linear solve operation for the IDAASCEND linear
-	solver. It interfaces to the appropriate mtx_matrix routines for this,
+	solver. It interfaces to the appropriate linsolqr routines for this,
 	but also scales solution vector according to cjratio.
 
+	The factors are those of the last call to integrator_ida_lsetup. IDA
+	calls that only when c_j has changed a lot, or the Newton iteration is
+	doing badly, so the same factors serve over several steps.
+
 	@return IDAASCEND_SUCESS on success
 */
 int integrator_ida_lsolve(IDAMem IDA_mem
 	, N_Vector b, N_Vector weight
 	, N_Vector ycur, N_Vector ypcur, N_Vector rrcur
 ){
-#ifdef STILL_NEED_TO_IMPLEMENT_THIS_STUFF
 	realtype *bd;
-  
+	long i;
+
   	IntegratorIdaAscendMem *iamem;
 	iamem = (IntegratorIdaAscendMem *)lmem;
-  
+
 	/* retrieve the data array for the RHS vector, 'b' */
 	bd = N_VGetArrayPointer(b);
 
-	/* call the necessary linsolqr routine here */
-	/* ... */
-	/* For IDADENSE, it's: DenseGETRS(JJ, pivots, bd); */
+	/* rows of JJ are equations, columns are the states, both in IDA order */
+	for(i = 0; i < neq; ++i){
+		RHS[i] = bd[i];
+	}
+	linsolqr_rhs_was_changed(LL, RHS);
+	if(linsolqr_solve(LL, RHS) || linsolqr_copy_solution(LL, RHS, bd)){
+		lastflag = IDAASCEND_SINGULAR;
+		return +1;
+	}
 
-	/* not sure what this is doing yet */
-	/* For IDADENSE, it's: Scale the correction to account for change in cj. */
+	/* Scale the correction to account for change in cj. */
 	if(cjratio != ONE){
 		N_VScale(TWO/(ONE + cjratio), b, b);
 	}
-#endif
 
-	ERROR_REPORTER_HERE(ASC_PROG_ERR,"Not implemented");
-	return -1;
+	lastflag = IDAASCEND_SUCCESS;
+	return 0;
 }
 
 int integrator_ida_lfree(IDAMem IDA_mem){
+  	IntegratorIdaAscendMem *iamem;
 	CONSOLE_DEBUG("Freeing IDA linear solver data");
 
-	/* free jacobian mtx_matrix_t data ?? */
-
 	if(lmem!=NULL){
+		iamem = (IntegratorIdaAscendMem *)lmem;
+		mtx_csr_destroy(JPAT);
+		linsolqr_remove_rhs(LL, RHS);
+		linsolqr_destroy(LL);
+		mtx_destroy(JJ);
+		ASC_FREE(RHS);
 		ASC_FREE(lmem);
 		lmem=NULL;
 	}
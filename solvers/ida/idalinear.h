@@ -19,7 +19,13 @@
 	ASCEND linsolqr routines internally, and takes advantage of the block
 	decomposition functionality available in ASCEND.
 
-	EXPERIMENTAL -- INCOMPLETE -- UNDER DEVELOPMENT
+	The iteration matrix dF/dy + c_j dF/dy' is kept in an mtx_matrix_t. The
+	first time, and whenever its pattern changes, it is put in block lower
+	triangular form and each block is reordered; after that only its values
+	change, and the pivot sequence of the last factorization is replayed
+	(linsolqr_refactor). IDA itself decides when a new Jacobian is needed,
+	so one factorization is used over several steps while c_j changes
+	little.
 
 	This file and idalinear.c are modelled fairly closely on ida_dense.c from
 	the SUNDIALS distribution, which maps out the expected use of ida_lmem
@@ -35,7 +41,17 @@
 #include <ascend/linear/mtx.h>
 
 /**
-	Function prototype for sparse jacobian evaluation as required by this linear solver
+	Function prototype for sparse jacobian evaluation as required by this linear solver.
+
+	Jac is empty on the first call. On later calls it still holds the
+	elements of the previous one: set their values in place where the
+	pattern is unchanged, so that the ordering and pivot sequence can be
+	reused; otherwise clear Jac (mtx_clear) and fill it afresh. Rows are
+	the equations and columns the states, in IDA's order, with no more
+	than one element for each (row, column).
+
+	@return 0 on success, positive on recoverable error, and negative on
+		unrecoverable error.
 */
 typedef int IntegratorSparseJacFn(long int Neq, realtype tt
 		, N_Vector yy, N_Vector yp, N_Vector rr
@@ -46,12 +62,14 @@ typedef int IntegratorSparseJacFn(long int Neq, realtype tt
 #define IDAASCEND_SUCCESS 0
 
 #define IDAASCEND_JACFN_RECVR 1
+#define IDAASCEND_SINGULAR 2
 
 #define IDAASCEND_MEM_NULL -1
 #define IDAASCEND_LMEM_NULL -2
 #define IDAASCEND_MEM_FAIL -4
 #define IDAASCEND_JACFN_UNDEF -5
 #define IDAASCEND_JACFN_UNRECVR -6
+#define IDAASCEND_STRUCT_SINGULAR -7
 
 /*------------------------------------
   User functions (called from ida.c in this directory)
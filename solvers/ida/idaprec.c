@@ -26,9 +26,14 @@
 
 #include "idaprec.h"
 #include "idaio.h"
+#include "idacalc.h"
+
+#include <math.h>
+#include <float.h>
 
 #include <ascend/general/platform.h>
 #include <ascend/system/relman.h>
+#include <ascend/linear/mtx_csr.h>
 
 #define PREC_DEBUG
 
@@ -84,6 +89,46 @@ const IntegratorIdaPrec prec_jacobi = {
 	, integrator_ida_psolve_jacobi
 };
 
+/*------
+  ILU and block-Jacobi preconditioners
+*/
+
+static int integrator_ida_psetup_ilu(realtype tt,
+		 N_Vector yy, N_Vector yp, N_Vector rr,
+		 realtype c_j, void *prec_data,
+		 N_Vector tmp1, N_Vector tmp2,
+		 N_Vector tmp3
+);
+
+static int integrator_ida_psolve_ilu(realtype tt,
+		 N_Vector yy, N_Vector yp, N_Vector rr,
+		 N_Vector rvec, N_Vector zvec,
+		 realtype c_j, realtype delta, void *prec_data,
+		 N_Vector tmp
+);
+
+static void integrator_ida_pcreate_ilu0(IntegratorSystem *integ);
+static void integrator_ida_pcreate_ilut(IntegratorSystem *integ);
+static void integrator_ida_pcreate_blockjacobi(IntegratorSystem *integ);
+
+const IntegratorIdaPrec prec_ilu0 = {
+	integrator_ida_pcreate_ilu0
+	, integrator_ida_psetup_ilu
+	, integrator_ida_psolve_ilu
+};
+
+const IntegratorIdaPrec prec_ilut = {
+	integrator_ida_pcreate_ilut
+	, integrator_ida_psetup_ilu
+	, integrator_ida_psolve_ilu
+};
+
+const IntegratorIdaPrec prec_blockjacobi = {
+	integrator_ida_pcreate_blockjacobi
+	, integrator_ida_psetup_ilu
+	, integrator_ida_psolve_ilu
+};
+
 /*----------------------------------------------
   FULL JACOBIAN PRECONDITIONER -- EXPERIMENTAL.
 */
@@ -157,6 +202,11 @@ static int integrator_ida_psetup_jacobian(realtype tt,
 
 	CONSOLE_DEBUG("Setting up Jacobian preconditioner");
 
+	/* integrator_ida_fex no longer passes values back to the compiler */
+	integrator_set_t(integ, (double)tt);
+	integrator_set_y(integ, NV_DATA_S(yy));
+	integrator_set_ydot(integ, NV_DATA_S(yp));
+
 	variables = ASC_NEW_ARRAY(struct var_variable*, NV_LENGTH_S(yy) * 2);
 	derivatives = ASC_NEW_ARRAY(double, NV_LENGTH_S(yy) * 2);
 
@@ -242,6 +292,390 @@ static int integrator_ida_psolve_jacobian(realtype tt,
 };
 
 
+/*----------------------------------------------
+  INCOMPLETE LU AND BLOCK-JACOBI PRECONDITIONERS
+*/
+
+#define ILUT_DROPTOL 1e-3
+#define ILUT_FILL 10
+#define ILU_PIVMIN 1e-4 /* replacement for a zero pivot, relative to the row */
+
+static void integrator_ida_pcreate_ilu(IntegratorSystem *integ, enum IntegratorIdaPrecILUType type){
+	IntegratorIdaData *enginedata = integ->enginedata;
+	IntegratorIdaPrecDataILU *pd;
+	int32 n, i;
+
+	asc_assert(integ->n_y);
+	n = integ->n_y;
+	pd = ASC_NEW_CLEAR(IntegratorIdaPrecDataILU);
+	pd->type = type;
+	pd->n = n;
+	pd->P = mtx_create();
+	mtx_set_order(pd->P, n);
+	pd->pat = NULL;
+	pd->rowperm = ASC_NEW_ARRAY(int32, n);
+	pd->colperm = ASC_NEW_ARRAY(int32, n);
+	pd->blklo = ASC_NEW_ARRAY(int32, n);
+	pd->blkhi = ASC_NEW_ARRAY(int32, n);
+	pd->rowptr = ASC_NEW_ARRAY(int32, n + 1);
+	pd->diag = ASC_NEW_ARRAY(int32, n);
+	pd->cap = 4 * n;
+	pd->col = ASC_NEW_ARRAY(int32, pd->cap);
+	pd->val = ASC_NEW_ARRAY(real64, pd->cap);
+	pd->wpos = ASC_NEW_ARRAY(int32, n);
+	pd->lcol = ASC_NEW_ARRAY(int32, n);
+	pd->ucol = ASC_NEW_ARRAY(int32, n);
+	pd->lval = ASC_NEW_ARRAY(real64, n);
+	pd->uval = ASC_NEW_ARRAY(real64, n);
+	pd->y = ASC_NEW_ARRAY(real64, n);
+	for(i = 0; i < n; ++i){
+		pd->wpos[i] = -1;
+	}
+
+	enginedata->pfree = &integrator_ida_pfree_ilu;
+	enginedata->precdata = pd;
+}
+
+static void integrator_ida_pcreate_ilu0(IntegratorSystem *integ){
+	integrator_ida_pcreate_ilu(integ, IDA_PREC_ILU0);
+}
+
+static void integrator_ida_pcreate_ilut(IntegratorSystem *integ){
+	integrator_ida_pcreate_ilu(integ, IDA_PREC_ILUT);
+}
+
+static void integrator_ida_pcreate_blockjacobi(IntegratorSystem *integ){
+	integrator_ida_pcreate_ilu(integ, IDA_PREC_BLOCKJACOBI);
+}
+
+void integrator_ida_pfree_ilu(IntegratorIdaData *enginedata){
+	IntegratorIdaPrecDataILU *pd;
+
+	if(enginedata->precdata){
+		pd = (IntegratorIdaPrecDataILU *)enginedata->precdata;
+		if(enginedata->sjac != NULL && mtx_csr_matrix(enginedata->sjac) == pd->P){
+			mtx_csr_destroy(enginedata->sjac);
+			enginedata->sjac = NULL;
+		}
+		mtx_csr_destroy(pd->pat);
+		mtx_destroy(pd->P);
+		ASC_FREE(pd->rowperm);
+		ASC_FREE(pd->colperm);
+		ASC_FREE(pd->blklo);
+		ASC_FREE(pd->blkhi);
+		ASC_FREE(pd->rowptr);
+		ASC_FREE(pd->diag);
+		ASC_FREE(pd->col);
+		ASC_FREE(pd->val);
+		ASC_FREE(pd->wpos);
+		ASC_FREE(pd->lcol);
+		ASC_FREE(pd->ucol);
+		ASC_FREE(pd->lval);
+		ASC_FREE(pd->uval);
+		ASC_FREE(pd->y);
+		ASC_FREE(pd);
+		enginedata->precdata = NULL;
+	}
+	enginedata->pfree = NULL;
+}
+
+/**
+	Put P in block lower triangular form, for a pattern we haven't seen
+	before, and note where the blocks are.
+	@return 0 on success, 1 if P is structurally singular.
+*/
+static int integrator_ida_porder_ilu(IntegratorIdaPrecDataILU *pd){
+	mtx_region_t reg;
+	int32 b, nb, r;
+
+	mtx_csr_destroy(pd->pat);
+	pd->pat = NULL;
+
+	mtx_output_assign(pd->P, pd->n, pd->n);
+	if(mtx_symbolic_rank(pd->P) < pd->n){
+		ERROR_REPORTER_HERE(ASC_PROG_ERR,"Jacobian is structurally singular"
+			" (rank %d of %d)",mtx_symbolic_rank(pd->P),pd->n
+		);
+		return 1;
+	}
+	mtx_partition(pd->P);
+	nb = mtx_number_of_blocks(pd->P);
+	for(b = 0; b < nb; ++b){
+		mtx_block(pd->P, b, &reg);
+		for(r = reg.row.low; r <= reg.row.high; ++r){
+			pd->blklo[r] = reg.row.low;
+			pd->blkhi[r] = reg.row.high;
+		}
+	}
+	for(r = 0; r < pd->n; ++r){
+		pd->rowperm[r] = mtx_row_to_org(pd->P, r);
+		pd->colperm[r] = mtx_col_to_org(pd->P, r);
+	}
+	pd->pat = mtx_csr_create(pd->P, mtx_ENTIRE_MATRIX);
+	return 0;
+}
+
+/**
+	Keep the m largest (by magnitude) of the n entries col/val, moving them
+	to the front. Quick-split, as in Saad's ILUT.
+*/
+static void integrator_ida_pilu_split(int32 *col, real64 *val, int32 n, int32 m){
+	int32 first = 0, last = n - 1, mid, j, itmp;
+	real64 abskey, tmp;
+
+	if(m <= 0 || m >= n)return;
+	for(;;){
+		mid = first;
+		abskey = fabs(val[mid]);
+		for(j = first + 1; j <= last; ++j){
+			if(fabs(val[j]) > abskey){
+				++mid;
+				tmp = val[mid]; val[mid] = val[j]; val[j] = tmp;
+				itmp = col[mid]; col[mid] = col[j]; col[j] = itmp;
+			}
+		}
+		tmp = val[mid]; val[mid] = val[first]; val[first] = tmp;
+		itmp = col[mid]; col[mid] = col[first]; col[first] = itmp;
+		if(mid == m - 1 || mid == m)return;
+		if(mid > m){
+			last = mid - 1;
+		}else{
+			first = mid + 1;
+		}
+	}
+}
+
+/**
+	Factor P, row by row in the IKJ order, without pivoting. What is kept
+	depends on pd->type; see idaprec.h.
+*/
+static void integrator_ida_pfactor_ilu(IntegratorIdaPrecDataILU *pd){
+	mtx_coord_t nz;
+	mtx_range_t rng;
+	real64 v, mult, tnorm, droptol;
+	int32 i, j, k, p, jj, kk, itmp, nl, nu, nl0, nu0, need, len, npivfix = 0;
+	int32 *wpos = pd->wpos, *lcol = pd->lcol, *ucol = pd->ucol;
+	real64 *lval = pd->lval, *uval = pd->uval;
+	int fill = (pd->type != IDA_PREC_ILU0);
+
+	droptol = (pd->type == IDA_PREC_ILUT) ? ILUT_DROPTOL : 0.0;
+	pd->rowptr[0] = 0;
+	for(i = 0; i < pd->n; ++i){
+		/* load row i, only its own block for block-Jacobi */
+		if(pd->type == IDA_PREC_BLOCKJACOBI){
+			rng.low = pd->blklo[i];
+			rng.high = pd->blkhi[i];
+		}else{
+			rng.low = 0;
+			rng.high = pd->n - 1;
+		}
+		nl = 0;
+		nu = 1;
+		ucol[0] = i;
+		uval[0] = 0.0;
+		wpos[i] = 0;
+		tnorm = 0.0;
+		len = 0;
+		nz.row = i;
+		nz.col = mtx_FIRST;
+		while(v = mtx_next_in_row(pd->P, &nz, &rng), nz.col != mtx_LAST){
+			if(nz.col < i){
+				wpos[nz.col] = nl;
+				lcol[nl] = nz.col;
+				lval[nl++] = v;
+			}else if(nz.col == i){
+				uval[0] = v;
+			}else{
+				wpos[nz.col] = nu;
+				ucol[nu] = nz.col;
+				uval[nu++] = v;
+			}
+			tnorm += fabs(v);
+			++len;
+		}
+		tnorm = len ? tnorm / len : 1.0;
+		nl0 = nl;
+		nu0 = nu - 1;
+
+		/* eliminate with the rows above, in increasing column order */
+		for(jj = 0; jj < nl; ++jj){
+			kk = jj;
+			for(p = jj + 1; p < nl; ++p){
+				if(lcol[p] < lcol[kk])kk = p;
+			}
+			if(kk != jj){
+				itmp = lcol[jj]; lcol[jj] = lcol[kk]; lcol[kk] = itmp;
+				v = lval[jj]; lval[jj] = lval[kk]; lval[kk] = v;
+				wpos[lcol[jj]] = jj;
+				wpos[lcol[kk]] = kk;
+			}
+			k = lcol[jj];
+			mult = lval[jj] / pd->val[pd->diag[k]];
+			if(fabs(mult) <= droptol * tnorm){
+				lval[jj] = 0.0;
+				continue;
+			}
+			lval[jj] = mult;
+			for(p = pd->diag[k] + 1; p < pd->rowptr[k + 1]; ++p){
+				j = pd->col[p];
+				v = mult * pd->val[p];
+				if(wpos[j] >= 0){
+					if(j < i){
+						lval[wpos[j]] -= v;
+					}else{
+						uval[wpos[j]] -= v;
+					}
+				}else if(fill){
+					if(j < i){
+						wpos[j] = nl;
+						lcol[nl] = j;
+						lval[nl++] = -v;
+					}else{
+						wpos[j] = nu;
+						ucol[nu] = j;
+						uval[nu++] = -v;
+					}
+				}
+			}
+		}
+
+		for(p = 0; p < nl; ++p)wpos[lcol[p]] = -1;
+		for(p = 0; p < nu; ++p)wpos[ucol[p]] = -1;
+
+		/* ILUT: drop the small ones, then all but the largest few */
+		if(pd->type == IDA_PREC_ILUT){
+			for(p = 0, jj = 0; p < nl; ++p){
+				if(fabs(lval[p]) > droptol * tnorm){
+					lcol[jj] = lcol[p];
+					lval[jj++] = lval[p];
+				}
+			}
+			nl = jj;
+			integrator_ida_pilu_split(lcol, lval, nl, nl0 + ILUT_FILL);
+			if(nl > nl0 + ILUT_FILL)nl = nl0 + ILUT_FILL;
+			for(p = 1, jj = 1; p < nu; ++p){
+				if(fabs(uval[p]) > droptol * tnorm){
+					ucol[jj] = ucol[p];
+					uval[jj++] = uval[p];
+				}
+			}
+			nu = jj;
+			integrator_ida_pilu_split(ucol + 1, uval + 1, nu - 1, nu0 + ILUT_FILL);
+			if(nu - 1 > nu0 + ILUT_FILL)nu = nu0 + ILUT_FILL + 1;
+		}
+
+		if(fabs(uval[0]) <= DBL_EPSILON * tnorm){
+			uval[0] = (ILU_PIVMIN + droptol) * tnorm;
+			++npivfix;
+		}
+
+		/* store row i */
+		need = pd->rowptr[i] + nl + nu;
+		if(need > pd->cap){
+			pd->cap = (need > 2 * pd->cap) ? need : 2 * pd->cap;
+			pd->col = (int32 *)ASC_REALLOC(pd->col, pd->cap * sizeof(int32));
+			pd->val = (real64 *)ASC_REALLOC(pd->val, pd->cap * sizeof(real64));
+		}
+		p = pd->rowptr[i];
+		for(jj = 0; jj < nl; ++jj, ++p){
+			pd->col[p] = lcol[jj];
+			pd->val[p] = lval[jj];
+		}
+		pd->diag[i] = p;
+		for(jj = 0; jj < nu; ++jj, ++p){
+			pd->col[p] = ucol[jj];
+			pd->val[p] = uval[jj];
+		}
+		pd->rowptr[i + 1] = p;
+	}
+
+	if(npivfix){
+		ERROR_REPORTER_HERE(ASC_PROG_NOTE,"%d zero pivots replaced in the"
+			" preconditioner", npivfix
+		);
+	}
+}
+
+/**
+	ILU and block-Jacobi preconditioners for use with IDA Krylov solvers
+
+	'setup' function. The matrix is assembled by integrator_ida_sjex; its
+	ordering is redone only when its pattern has changed.
+*/
+static int integrator_ida_psetup_ilu(realtype tt,
+		 N_Vector yy, N_Vector yp, N_Vector rr,
+		 realtype c_j, void *p_data,
+		 N_Vector tmp1, N_Vector tmp2,
+		 N_Vector tmp3
+){
+	IntegratorSystem *integ;
+	IntegratorIdaData *enginedata;
+	IntegratorIdaPrecDataILU *pd;
+	int res;
+
+	integ = (IntegratorSystem *)p_data;
+	enginedata = integ->enginedata;
+	pd = (IntegratorIdaPrecDataILU *)(enginedata->precdata);
+
+	res = integrator_ida_sjex(pd->n, tt, yy, yp, rr, c_j, p_data, pd->P
+		, tmp1, tmp2, tmp3
+	);
+	if(res){
+		return 1; /* recoverable */
+	}
+	if(pd->pat == NULL || !mtx_csr_valid(pd->pat, NULL)){
+		if(integrator_ida_porder_ilu(pd)){
+			return -1;
+		}
+	}
+	integrator_ida_pfactor_ilu(pd);
+	return 0;
+}
+
+/**
+	ILU and block-Jacobi preconditioners for use with IDA Krylov solvers
+
+	'solve' function: z = U^-1 L^-1 r, in the permuted order.
+*/
+static int integrator_ida_psolve_ilu(realtype tt,
+		 N_Vector yy, N_Vector yp, N_Vector rr,
+		 N_Vector rvec, N_Vector zvec,
+		 realtype c_j, realtype delta, void *p_data,
+		 N_Vector tmp
+){
+	IntegratorSystem *integ;
+	IntegratorIdaData *data;
+	IntegratorIdaPrecDataILU *pd;
+	real64 *r, *z, *y, v;
+	int32 i, p;
+
+	integ = (IntegratorSystem *)p_data;
+	data = integ->enginedata;
+	pd = (IntegratorIdaPrecDataILU *)(data->precdata);
+	r = NV_DATA_S(rvec);
+	z = NV_DATA_S(zvec);
+	y = pd->y;
+
+	for(i = 0; i < pd->n; ++i){
+		v = r[pd->rowperm[i]];
+		for(p = pd->rowptr[i]; p < pd->diag[i]; ++p){
+			v -= pd->val[p] * y[pd->col[p]];
+		}
+		y[i] = v;
+	}
+	for(i = pd->n - 1; i >= 0; --i){
+		v = y[i];
+		for(p = pd->diag[i] + 1; p < pd->rowptr[i + 1]; ++p){
+			v -= pd->val[p] * y[pd->col[p]];
+		}
+		y[i] = v / pd->val[pd->diag[i]];
+	}
+	for(i = 0; i < pd->n; ++i){
+		z[pd->colperm[i]] = y[i];
+	}
+	return 0;
+}
+
 /*----------------------------------------------
   JACOBI PRECONDITIONER -- EXPERIMENTAL.
 */
@@ -298,6 +732,11 @@ static int integrator_ida_psetup_jacobi(realtype tt,
 
 	CONSOLE_DEBUG("Setting up Jacobi preconditioner");
 
+	/* integrator_ida_fex no longer passes values back to the compiler */
+	integrator_set_t(integ, (double)tt);
+	integrator_set_y(integ, NV_DATA_S(yy));
+	integrator_set_ydot(integ, NV_DATA_S(yp));
+
 	variables = ASC_NEW_ARRAY(struct var_variable*, NV_LENGTH_S(yy) * 2);
 	derivatives = ASC_NEW_ARRAY(double, NV_LENGTH_S(yy) * 2);
 
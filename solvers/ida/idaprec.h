@@ -58,6 +58,61 @@ void integrator_ida_pfree_jacobian(IntegratorIdaData *enginedata);
 
 const IntegratorIdaPrec prec_jacobian;
 
+/*------------------------------------------------------------------------------
+  INCOMPLETE LU AND BLOCK-JACOBI PRECONDITIONERS
+
+  These work on the iteration matrix dF/dy + c_j dF/dy', assembled by
+  integrator_ida_sjex. Its rows and columns are first put in block lower
+  triangular form (mtx_output_assign and mtx_partition, as for the solver's
+  own block partition), which also puts a nonzero on every diagonal, and
+  then factored without pivoting:
+    - ILU0: incomplete LU, keeping only the entries of the matrix itself;
+    - ILUT: incomplete LU with threshold dropping, keeping entries larger
+      than ILUT_DROPTOL times the mean of the row, and at most ILUT_FILL
+      more of them in each of L and U than the row had to begin with;
+    - BLOCKJACOBI: exact LU of each diagonal block, the coupling between
+      blocks being ignored.
+  The ordering is kept for as long as the pattern of the matrix stays the
+  same, so a refresh of the preconditioner is only a numerical factoring.
+*/
+
+enum IntegratorIdaPrecILUType{
+	IDA_PREC_ILU0,
+	IDA_PREC_ILUT,
+	IDA_PREC_BLOCKJACOBI
+};
+
+/**
+	Internal data for the ILU and block-Jacobi preconditioners. The factors
+	are stored by row in the permuted order: for row i, the entries of L
+	(unit diagonal not stored) come first, then the diagonal of U at
+	diag[i], then the rest of U.
+*/
+typedef struct IntegratorIdaPrecDataILUStruct{
+	enum IntegratorIdaPrecILUType type;
+	mtx_matrix_t P;   /**< iteration matrix, filled by integrator_ida_sjex */
+	mtx_csr_t pat;    /**< pattern of P for which the ordering was made */
+	int32 n;
+	int32 *rowperm;   /**< org row (relation) of each permuted row */
+	int32 *colperm;   /**< org col (state) of each permuted col */
+	int32 *blklo;     /**< first row of the block containing each row */
+	int32 *blkhi;     /**< last row of the block containing each row */
+	int32 *rowptr;    /**< factors: row i is rowptr[i]..rowptr[i+1]-1 */
+	int32 *diag;
+	int32 *col;
+	real64 *val;
+	int32 cap;        /**< allocated length of col and val */
+	int32 *wpos;      /**< work space, of length n */
+	int32 *lcol, *ucol;
+	real64 *lval, *uval, *y;
+} IntegratorIdaPrecDataILU;
+
+void integrator_ida_pfree_ilu(IntegratorIdaData *enginedata);
+
+const IntegratorIdaPrec prec_ilu0;
+const IntegratorIdaPrec prec_ilut;
+const IntegratorIdaPrec prec_blockjacobi;
+
 /*------------------------------------------------------------------------------
   JACOBI PRECONDITIONER
   FIXME need to add some description here!
@@ -23,10 +23,14 @@
 #define ASC_IDATYPES_H
 
 #include <ascend/integrator/integrator.h>
+#include <ascend/linear/mtx_csr.h>
 
 /* forward dec needed for IntegratorIdaPrecFreeFn */
 struct IntegratorIdaDataStruct;
 
+struct relman_batch; /* see relman.h */
+struct SystemColoringStruct; /* see coloring.h */
+
 /**
 	Function type for freeing of preconditioner data. FIXME should this be part
 	of the precdata, perhaps? @see idaprec.h
@@ -51,11 +55,35 @@ typedef struct IntegratorIdaDataStruct{
 	struct bnd_boundary **bndlist;	 /**< NULL-terminated list of boundaries, for use in the root-finding  code */
 	int nbnds; /* number of boundaries */
 
+	double *xsys;                    /**< values of all solver vars by var_sindex, for system_eval_residuals */
+	double *rsys;                    /**< residuals of all solver rels by rel_sindex */
+	int32 xindex;                    /**< var_sindex of the independent variable, or -1 */
+	int32 *yindex;                   /**< var_sindex of each y, where it goes in xsys */
+	int32 *ydotindex;                /**< var_sindex of each ydot, or -1 */
+	int32 nbounded;                  /**< number of states and derivatives having bounds */
+	int32 *bndindex;                 /**< ...their var_sindex */
+	double *bndlower, *bndupper;     /**< ...and their bounds */
+	struct relman_batch *bndbatch;   /**< real-valued boundary conditions, for integrator_ida_rootfn */
+	double *bndres;                  /**< their residuals by rel_sindex */
+
+	struct rel_relation **jacrels;   /**< rels whose gradients are calculated one by one... */
+	int32 *jacrow;                   /**< ...and their rows in rellist */
+	int32 njacrels;
+	struct rel_relation **fdrels;    /**< blackbox rels differenced together instead... */
+	int32 *fdrow;                    /**< ...their rows in rellist */
+	int32 nfdrels;
+	struct relman_batch *fdbatch;    /**< ...the batch to evaluate them */
+	struct SystemColoringStruct *fdcolor; /**< ...the coloring of their y columns */
+	double *fdres;                   /**< ...their unperturbed residuals */
+	double *fdstep;                  /**< ...the step for each y */
+	double *fdvalue;                 /**< ...and the result, by slot of fdcolor */
+
 	int safeeval;                    /**< whether to pass the 'safe' flag to relman_eval */
 	var_filter_t vfilter;
 	rel_filter_t rfilter;            /**< Used to filter relations from solver's rellist (@TODO needs work) */
 	void *precdata;                  /**< For use by the preconditioner */
 	IntegratorIdaPrecFreeFn *pfree;	 /**< Store instructions here on how to free precdata */
+	mtx_csr_t sjac;                  /**< pattern of the sparse Jacobian, for integrator_ida_sjex */
 
 	/* Error flag look-up data */
 	IdaFlagFn *flagfn;
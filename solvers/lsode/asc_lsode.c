@@ -65,6 +65,7 @@
 #include <ascend/solver/solver.h>
 
 #include <ascend/packages/sensitivity.h>
+#include <ascend/system/slv_stdcalls.h>
 
 #include <ascend/linear/densemtx.h>
 
@@ -202,7 +203,9 @@ typedef struct IntegratorLsodeDataStruct{
 	struct var_variable **ydot_vars; /**< NULL-terminated list of derivative vars*/
 	struct rel_relation **rlist;     /**< NULL-terminated list of relevant rels
 	                                    to be differentiated */
-	DenseMatrix dydot_dy;               /**< change in derivatives wrt states */
+	DenseMatrix dydot_dy;               /**< change in derivatives wrt states (full Jacobian only) */
+	int ml, mu;                      /**< lower and upper half-bandwidths of dydot_dy */
+	int banded;                      /**< LSODE has been asked for a banded Jacobian */
 
 	IntegratorLsodeLastCallType lastcall;  /* type of last call; func or grad */
 	IntegratorLsodeStatusCode   status;    /* solve status */
@@ -286,6 +289,8 @@ static void integrator_lsode_create(IntegratorSystem *blsys){
 	d->ydot_vars=NULL;
 	d->rlist=NULL;
 	d->dydot_dy=DENSEMATRIX_EMPTY;
+	d->ml = d->mu = 0;
+	d->banded = 0;
 	blsys->enginedata=(void*)d;
 	integrator_lsode_params_default(blsys);
 
@@ -327,6 +332,7 @@ enum ida_parameters{
 	LSODE_PARAM_METH
 	,LSODE_PARAM_MITER
 	,LSODE_PARAM_MAXORD
+	,LSODE_PARAM_BANDED
 	,LSODE_PARAM_TIMING
 	,LSODE_PARAM_RTOLVECT
 	,LSODE_PARAM_RTOL
@@ -391,6 +397,19 @@ static int integrator_lsode_params_default(IntegratorSystem *blsys){
 		}, 12, 1, 12}
 	);
 
+	slv_param_bool(p,LSODE_PARAM_BANDED
+			,(SlvParameterInitBool){{"banded"
+			,"Use a banded Jacobian where possible?",1
+			,"If TRUE, and miter is 1 or 2, the bandwidth of the Jacobian is"
+			" found from the structure of the model and, if it is narrow"
+			" enough, LSODE is given a banded Jacobian (MF = 24 or 25, or 14"
+			" or 15 for AM), which takes far less memory and time for large"
+			" systems. Method-of-lines models with states numbered along the"
+			" grid are usually banded. See 'Description and Use of LSODE',"
+			" section 3.1."
+		}, TRUE}
+	);
+
 	slv_param_bool(p,LSODE_PARAM_TIMING
 			,(SlvParameterInitBool){{"timing"
 			,"Output timing statistics?",1
@@ -496,6 +515,133 @@ static int integrator_lsode_setup_diffs(IntegratorSystem *blsys) {
 	return 0;
 }
 
+/**
+	Find the half-bandwidths of dydot/dy from the structure of the model,
+	without evaluating anything.
+
+	The states are fixed while the derivatives are solved for, so the free
+	vars and the included rels make a square system whose block lower
+	triangular form (from mtx_output_assign and mtx_partition) gives the
+	order in which its vars are found. Going through the blocks in that
+	order, each block depends on the states incident in its own rels and
+	on those of every earlier block whose vars appear there. Only the
+	lowest and highest state index of that set are kept, which is all the
+	bandwidth needs.
+
+	If the structure can't be worked out, the band is the whole matrix.
+
+	@return 0 on success
+*/
+static int integrator_lsode_bandwidth(IntegratorSystem *blsys
+		, int *ml, int *mu
+){
+	IntegratorLsodeData *d = (IntegratorLsodeData *)blsys->enginedata;
+	var_filter_t vfilter;
+	rel_filter_t rfilter;
+	struct rel_relation **rlist;
+	const struct var_variable **incid;
+	mtx_matrix_t mtx;
+	mtx_region_t reg;
+	int32 nrels, nvars, order, nblocks, b, row, col, r, k, n, sindex;
+	int32 *yindex, *ydotindex, *colblock, *lo, *hi;
+	int32 blo, bhi, i, neq = d->n_eqns;
+
+	*ml = *mu = neq - 1;
+	nrels = slv_get_num_solvers_rels(blsys->system);
+	nvars = slv_get_num_solvers_vars(blsys->system);
+	rlist = slv_get_solvers_rel_list(blsys->system);
+	order = MAX(nrels,nvars);
+	if(order == 0)return 1;
+
+	vfilter.matchbits = VAR_SVAR | VAR_INCIDENT | VAR_ACTIVE | VAR_FIXED;
+	vfilter.matchvalue = VAR_SVAR | VAR_INCIDENT | VAR_ACTIVE;
+	rfilter.matchbits = REL_INCLUDED | REL_EQUALITY | REL_ACTIVE;
+	rfilter.matchvalue = REL_INCLUDED | REL_EQUALITY | REL_ACTIVE;
+
+	mtx = mtx_create();
+	mtx_set_order(mtx,order);
+	if(slv_make_incidence_mtx(blsys->system,mtx,&vfilter,&rfilter)){
+		mtx_destroy(mtx);
+		return 1;
+	}
+	mtx_output_assign(mtx,nrels,nvars);
+	mtx_partition(mtx);
+	nblocks = mtx_number_of_blocks(mtx);
+	if(nblocks <= 0){
+		mtx_destroy(mtx);
+		return 1;
+	}
+
+	yindex = ASC_NEW_ARRAY(int32,nvars);
+	ydotindex = ASC_NEW_ARRAY(int32,nvars);
+	colblock = ASC_NEW_ARRAY(int32,nvars);
+	lo = ASC_NEW_ARRAY(int32,nblocks);
+	hi = ASC_NEW_ARRAY(int32,nblocks);
+	for(k = 0; k < nvars; ++k){
+		yindex[k] = ydotindex[k] = colblock[k] = -1;
+	}
+	for(i = 0; i < neq; ++i){
+		yindex[var_sindex(blsys->y[i])] = i;
+		ydotindex[var_sindex(blsys->ydot[i])] = i;
+	}
+	for(b = 0; b < nblocks; ++b){
+		mtx_block(mtx,b,&reg);
+		for(col = reg.col.low; col <= reg.col.high; ++col){
+			sindex = mtx_col_to_org(mtx,col);
+			if(sindex < nvars)colblock[sindex] = b;
+		}
+	}
+
+	*ml = *mu = 0;
+	for(b = 0; b < nblocks; ++b){
+		mtx_block(mtx,b,&reg);
+		blo = neq;
+		bhi = -1;
+		for(row = reg.row.low; row <= reg.row.high; ++row){
+			r = mtx_row_to_org(mtx,row);
+			if(r >= nrels)continue;
+			incid = rel_incidence_list(rlist[r]);
+			n = rel_n_incidences(rlist[r]);
+			for(k = 0; k < n; ++k){
+				sindex = var_sindex(incid[k]);
+				if(yindex[sindex] >= 0){
+					blo = MIN(blo,yindex[sindex]);
+					bhi = MAX(bhi,yindex[sindex]);
+				}else if(colblock[sindex] >= 0 && colblock[sindex] < b){
+					blo = MIN(blo,lo[colblock[sindex]]);
+					bhi = MAX(bhi,hi[colblock[sindex]]);
+				}
+			}
+		}
+		lo[b] = blo;
+		hi[b] = bhi;
+		if(bhi < 0)continue;
+		for(col = reg.col.low; col <= reg.col.high; ++col){
+			sindex = mtx_col_to_org(mtx,col);
+			if(sindex >= nvars || ydotindex[sindex] < 0)continue;
+			i = ydotindex[sindex];
+			*ml = MAX(*ml, i - blo);
+			*mu = MAX(*mu, bhi - i);
+		}
+	}
+
+	/* a derivative that the partition didn't place could depend on anything */
+	for(i = 0; i < neq; ++i){
+		if(colblock[var_sindex(blsys->ydot[i])] < 0 || var_fixed(blsys->ydot[i])){
+			*ml = *mu = neq - 1;
+			break;
+		}
+	}
+
+	ASC_FREE(yindex);
+	ASC_FREE(ydotindex);
+	ASC_FREE(colblock);
+	ASC_FREE(lo);
+	ASC_FREE(hi);
+	mtx_destroy(mtx);
+	return 0;
+}
+
 /**
 	allocates, fills, and returns the atol vector based on LSODE
 
@@ -653,6 +799,16 @@ static void lsode_free_mem(double *y, double *reltol, double *abtol, double *rwo
 	Ben says: "The proper permanent fix for lsode is to dump it in favor of
 	cvode or dassl." (so: see ida.c)
 
+	Each column of dydot/dy takes a solve with the factored Jacobian. Only
+	ydot[j-mu..j+ml] depend on y[j], so columns ml+mu+1 apart never touch
+	the same derivative and are solved for together, with the sum of their
+	right-hand sides. That is ml+mu+1 solves rather than neq, and for the
+	full band (ml = mu = neq-1) one per column, as before.
+
+	The result goes into pd, column-major with leading dimension nrpd: in
+	LSODE's banded form, df(i)/dy(j) at pd[i-j+mu + j*nrpd], if the system
+	is banded; otherwise via dydot_dy, as a full matrix.
+
 	@return 0 on success
 
 	@NOTE It is assumed the system has been solved at the current point. @ENDNOTE
@@ -660,24 +816,30 @@ static void lsode_free_mem(double *y, double *reltol, double *abtol, double *rwo
 static int integrator_lsode_derivatives(IntegratorSystem *blsys
 		, int ninputs
 		, int noutputs
+		, double *pd
+		, int nrpd
 ){
   static int n_calls = 0;
   linsolqr_system_t linsys;	/* stuff for the linear system & matrix */
   mtx_matrix_t mtx;
   int32 capacity;
   real64 *scratch_vector = NULL;
+  real64 *column = NULL;
+  real64 *solution = NULL;
   int result=0;
+  int i, j, k, c, ngroup, ml, mu;
   IntegratorLsodeData *enginedata;
 
   asc_assert(blsys!=NULL);
   enginedata = (IntegratorLsodeData *)blsys->enginedata;
   asc_assert(enginedata!=NULL);
-  asc_assert(DENSEMATRIX_DATA(enginedata->dydot_dy)!=NULL);
+  asc_assert(enginedata->banded || DENSEMATRIX_DATA(enginedata->dydot_dy)!=NULL);
   asc_assert(enginedata->input_indices!=NULL);
 
   int *inputs_ndx_list = enginedata->input_indices;
   int *outputs_ndx_list = enginedata->output_indices;
   asc_assert(ninputs == blsys->n_y);
+  asc_assert(noutputs == ninputs);
 
   (void)NumberFreeVars(NULL);		/* used to re-init the system */
   (void)NumberIncludedRels(NULL);	/* used to re-init the system */
@@ -704,21 +866,84 @@ static int integrator_lsode_derivatives(IntegratorSystem *blsys
   }
   capacity = mtx_capacity(mtx);
   scratch_vector = ASC_NEW_ARRAY_CLEAR(real64,capacity);
+  column = ASC_NEW_ARRAY_CLEAR(real64,capacity);
+  solution = ASC_NEW_ARRAY_CLEAR(real64,capacity);
+  if(scratch_vector==NULL || column==NULL || solution==NULL){
+    FPRINTF(stderr,"Early termination due to lack of memory.\n");
+    result = 1;
+    goto error;
+  }
   linsolqr_add_rhs(linsys,scratch_vector,FALSE);
 
   result = LUFactorJacobian(blsys->system);
   if (result) {
     FPRINTF(stderr,"Early termination due to failure in LUFactorJacobian\n");
+    linsolqr_remove_rhs(linsys,scratch_vector);
     goto error;
   }
-  result = Compute_dy_dx_smart(blsys->system, scratch_vector, enginedata->dydot_dy,
-                               inputs_ndx_list, ninputs,
-                               outputs_ndx_list, noutputs);
 
+  ml = enginedata->ml;
+  mu = enginedata->mu;
+  ngroup = MIN(ml + mu + 1, ninputs);
+  if(!enginedata->banded){
+    for(j = 0; j < ninputs; ++j){
+      for(i = 0; i < noutputs; ++i){
+        DENSEMATRIX_ELEM(enginedata->dydot_dy,i,j) = 0.0;
+      }
+    }
+  }
+
+  /*
+	The inputs are original var indices; the solution comes back in the
+	original order too, but the columns of mtx are fetched by current
+	index, hence mtx_org_to_col.
+  */
+  for(c = 0; c < ngroup; ++c){
+    for(j = c; j < ninputs; j += ngroup){
+      k = mtx_org_to_col(mtx,inputs_ndx_list[j]);
+      mtx_org_col_vec(mtx,k,column,mtx_ALL_ROWS);
+      for(i = 0; i < capacity; ++i){
+        scratch_vector[i] += column[i];
+      }
+      mtx_zr_org_vec_using_col(mtx,k,column,mtx_ALL_ROWS);
+    }
+
+    linsolqr_rhs_was_changed(linsys,scratch_vector);
+    linsolqr_solve(linsys,scratch_vector);
+    linsolqr_copy_solution(linsys,scratch_vector,solution);
+
+    /* the only column of the group within the band of row i */
+    for(i = 0; i < noutputs; ++i){
+      j = i - ml;
+      if(j < 0)j = 0;
+      j += ((c - j) % ngroup + ngroup) % ngroup;
+      if(j > i + mu || j >= ninputs)continue;
+      if(enginedata->banded){
+        pd[(i - j + mu) + j * nrpd] = -1.0 * solution[outputs_ndx_list[i]];
+      }else{
+        DENSEMATRIX_ELEM(enginedata->dydot_dy,i,j) = -1.0 * solution[outputs_ndx_list[i]];
+      }
+    }
+
+    for(j = c; j < ninputs; j += ngroup){
+      k = mtx_org_to_col(mtx,inputs_ndx_list[j]);
+      mtx_zr_org_vec_using_col(mtx,k,scratch_vector,mtx_ALL_ROWS);
+    }
+  }
   linsolqr_remove_rhs(linsys,scratch_vector);
-  if (result) {
-    FPRINTF(stderr,"Early termination due to failure in Compute_dy_dx\n");
-    goto error;
+
+  /*
+	Map data from C based matrix to Fortan matrix.
+	We will send in a column major ordering vector for pd.
+  */
+  if(!enginedata->banded){
+    asc_assert(ninputs == DENSEMATRIX_NCOLS(enginedata->dydot_dy));
+    asc_assert(nrpd == DENSEMATRIX_NROWS(enginedata->dydot_dy));
+    for (j=0;j<ninputs;j++) { /* loop through columnns */
+      for (i=0;i<nrpd;i++){ /* loop through rows */
+        *pd++ = DENSEMATRIX_ELEM(enginedata->dydot_dy,i,j);
+      }
+    }
   }
 
 error:
@@ -726,6 +951,12 @@ error:
   if(scratch_vector){
     ascfree((char *)scratch_vector);
   }
+  if(column){
+    ascfree((char *)column);
+  }
+  if(solution){
+    ascfree((char *)solution);
+  }
   return result;
 }
 
@@ -846,12 +1077,12 @@ static void LSODE_JEX(int *neq ,double *t, double *y
 ){
 	static short clockcheck = 0;
   int nok = 0;
-  int i,j;
 
   LSODEDATA_GET(lsodedata);
 
   UNUSED_PARAMETER(t);
   UNUSED_PARAMETER(y);
+  asc_assert(!lsodedata->banded || (*ml == lsodedata->ml && *mu == lsodedata->mu));
   UNUSED_PARAMETER(ml);
   UNUSED_PARAMETER(mu);
 
@@ -868,6 +1099,8 @@ static void LSODE_JEX(int *neq ,double *t, double *y
 
   nok = integrator_lsode_derivatives(l_lsode_blsys
 		, *neq
+		, *neq
+		, pd
 		, *nrpd
   );
 
@@ -894,19 +1127,6 @@ static void LSODE_JEX(int *neq ,double *t, double *y
 		}
 	}
 
-  /*
-	Map data from C based matrix to Fortan matrix.
-	We will send in a column major ordering vector for pd.
-  */
-  asc_assert(*neq == DENSEMATRIX_NCOLS(lsodedata->dydot_dy));
-  asc_assert(*nrpd == DENSEMATRIX_NROWS(lsodedata->dydot_dy));
-  for (j=0;j<*neq;j++) { /* loop through columnns */
-    for (i=0;i<*nrpd;i++){ /* loop through rows */
-			/* CONSOLE_DEBUG("JAC[r=%d,c=%d]=%f",i,j,lsodedata.dydot_dy[i][j]); */
-      *pd++ = DENSEMATRIX_ELEM(lsodedata->dydot_dy,i,j);
-    }
-  }
-
 #ifdef TIMING_DEBUG
   time1 = clock() - time1;
   CONSOLE_DEBUG("Time to do gradient evaluation %ld ticks",time1);
@@ -952,7 +1172,6 @@ static int integrator_lsode_solve(IntegratorSystem *blsys
 
 	d->input_indices = ASC_NEW_ARRAY_CLEAR(int, d->n_eqns);
 	d->output_indices = ASC_NEW_ARRAY_CLEAR(int, d->n_eqns);
-	d->dydot_dy = densematrix_create(d->n_eqns,d->n_eqns);
 
 	d->y_vars = ASC_NEW_ARRAY(struct var_variable *,d->n_eqns+1);
 	d->ydot_vars = ASC_NEW_ARRAY(struct var_variable *, d->n_eqns+1);
@@ -1009,6 +1228,26 @@ static int integrator_lsode_solve(IntegratorSystem *blsys
 		return 5;
 	}
 
+	/*
+		With a Newton corrector, use LSODE's banded storage if the band is
+		no more than about half the matrix; otherwise keep the full matrix,
+		which still needs only ml+mu+1 solves per evaluation.
+	*/
+	d->banded = 0;
+	if(integrator_lsode_bandwidth(blsys,&(d->ml),&(d->mu))){
+		d->ml = d->mu = d->n_eqns - 1;
+	}
+	CONSOLE_DEBUG("Jacobian half-bandwidths: ml = %d, mu = %d",d->ml,d->mu);
+	if((miter == 1 || miter == 2)
+		&& SLV_PARAM_BOOL(&(blsys->params),LSODE_PARAM_BANDED)
+		&& 2 * (2 * d->ml + d->mu + 1) <= d->n_eqns
+	){
+		d->banded = 1;
+		mf += 3;
+	}else{
+		d->dydot_dy = densematrix_create(d->n_eqns,d->n_eqns);
+	}
+
 	CONSOLE_DEBUG("MF = %d",mf);
 
   nsamples = integrator_getnsamples(blsys);
@@ -1037,6 +1276,9 @@ static int integrator_lsode_solve(IntegratorSystem *blsys
 		case 13: case 23:
 			lrw = 22 + neq * (maxord + 1) + 4 * neq;
 			break;
+		case 14: case 15: case 24: case 25:
+			lrw = 22 + neq * (maxord + 1) + 3 * neq + (2 * d->ml + d->mu + 1) * neq;
+			break;
 		default:
 			ERROR_REPORTER_HERE(ASC_USER_ERROR,"Unknown size requirements for this value of 'mf'");
 			return 4;
@@ -1070,6 +1312,10 @@ static int integrator_lsode_solve(IntegratorSystem *blsys
   iwork[5] = integrator_get_maxsubsteps(blsys);
 	iwork[4] = maxord;
 	CONSOLE_DEBUG("MAXORD = %d",maxord);
+	if(d->banded){
+		iwork[0] = d->ml;
+		iwork[1] = d->mu;
+	}
 
   if(x[0] > integrator_getsample(blsys, 2)){
     ERROR_REPORTER_HERE(ASC_USER_ERROR,"Invalid initialisation time: exceeds second timestep value");
@@ -1116,6 +1362,10 @@ static int integrator_lsode_solve(IntegratorSystem *blsys
       switch(mf){
 		case 10:
 			CONSOLE_DEBUG("Non-stiff (Adams) method; no Jacobian will be used"); break;
+		case 14:
+			CONSOLE_DEBUG("Non-stiff (Adams) method, user-supplied banded jacobian"); break;
+		case 15:
+			CONSOLE_DEBUG("Non-stiff (Adams) method, internally generated banded jacobian"); break;
 		case 21:
 			CONSOLE_DEBUG("Stiff (BDF) method, user-supplied full Jacobian"); break;
 		case 22:
@@ -1374,7 +1624,8 @@ static int integrator_lsode_write_matrix(const IntegratorSystem *blsys, FILE *fp
 	enginedata = (IntegratorLsodeData *)blsys->enginedata;
 
 	if(!DENSEMATRIX_DATA(enginedata->dydot_dy)){
-		ERROR_REPORTER_HERE(ASC_PROG_ERR,"dydot_dy contains no data");
+		ERROR_REPORTER_HERE(ASC_PROG_ERR,"dydot_dy contains no data (it is not kept for a banded Jacobian)");
+		return 1;
 	}
 
 #ifdef ASC_WITH_MMIO
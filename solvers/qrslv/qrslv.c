@@ -38,6 +38,7 @@
 
 #include <ascend/general/ascMalloc.h>
 #include <ascend/utilities/set.h>
+#include <ascend/utilities/ascTask.h>
 #include <ascend/general/mathmacros.h>
 #include <ascend/general/tm_time.h>
 #include <ascend/general/mem.h>
@@ -45,10 +46,12 @@
 #include <ascend/general/list.h>
 
 #include <ascend/linear/mtx_vector.h>
+#include <ascend/linear/mtx_csr.h>
 
 #include <ascend/system/calc.h>
 #include <ascend/system/slv_stdcalls.h>
 #include <ascend/system/relman.h>
+#include <ascend/system/jacobian.h>
 #include <ascend/system/block.h>
 #include <ascend/solver/solver.h>
 
@@ -66,6 +69,9 @@
 
 #define SOLVER_QRSLV_EXT 33
 
+/* fewest rows in a block for its Jacobian to be shared among threads */
+#define QRSLV_JAC_THREAD_ROWS 200
+
 enum QRSLV_PARAMS{
 	IGNORE_BOUNDS
 	,SHOW_MORE_IMPT
@@ -111,6 +117,8 @@ enum QRSLV_PARAMS{
 	,ITSCALETOL
 	,FACTOR_OPTION
 	,MAX_MINOR
+	,REFACTOR
+	,THREADS
 	,qrslv_PA_SIZE
 };
 
@@ -168,6 +176,7 @@ struct update_data {
 struct jacobian_data {
   linsolqr_system_t      sys;            /* Linear system */
   mtx_matrix_t           mtx;            /* Transpose gradient of residuals */
+  mtx_csr_t              csr;            /* Values of the block, once known */
   real64                 *rhs;           /* RHS from linear system */
   unsigned               *varpivots;     /* Pivoted variables */
   unsigned               *relpivots;     /* Pivoted relations */
@@ -197,6 +206,8 @@ struct reduced_data {
   boolean          accurate;     /* Ready to re-compute ? */
 };
 
+struct qrslv_parallel;
+
 struct qrslv_system_structure {
 
   /* Problem definition */
@@ -220,6 +231,10 @@ struct qrslv_system_structure {
   double                 clock;        /* CPU time */
   void *parm_array[qrslv_PA_SIZE];      /* array of pointers to param values */
   struct slv_parameter pa[qrslv_PA_SIZE];/* &pa[0] => sys->p.parms */
+  struct qrslv_parallel  *par;         /* NULL, or shared by the workers
+                                          this is one of */
+  boolean                eval_alone;   /* ? worker may evaluate its block
+                                          without par->eval */
 
   /* Calculated data (scaled) */
   struct jacobian_data   J;            /* linearized system */
@@ -231,6 +246,9 @@ struct qrslv_system_structure {
   struct vec_vector     relnoms;      /* Relation nominals */
   struct vec_vector     variables;    /* Variable values */
   struct vec_vector     residuals;    /* Relation residuals */
+  struct relman_batch   *resbatch;     /* Residual evaluator for the block */
+  mtx_range_t           resbatch_rows; /* Rows resbatch was made for */
+  real64                *resbatch_r;   /* Residuals by relation index */
   struct vec_vector     gradient;     /* Objective gradient */
   struct vec_vector     multipliers;  /* Relation multipliers */
   struct vec_vector     stationary;   /* Lagrange gradient */
@@ -256,6 +274,23 @@ struct qrslv_system_structure {
 
 typedef struct qrslv_system_structure *qrslv_system_t;
 
+/**
+	State shared by the workers solving independent blocks in parallel.
+	Each worker is a copy of the master system with its own linear system
+	and matrix; the vectors are shared, since blocks do not overlap.
+*/
+struct qrslv_parallel {
+  qrslv_system_t         master;
+  qrslv_system_t         *worker;      /* one copy of master per thread */
+  int                    nworker;
+  asc_mutex_t            eval;         /* held by a worker except while
+                                          it factors or evaluates */
+  boolean                unlock_linear;/* ? may factor without eval */
+  int                    *err;         /* qrslv_iterate codes, per worker */
+  int32                  failed;       /* block that failed, or -1 */
+  int                    failed_worker;
+};
+
 
 /*-----------------------------------------------------------------------------
   INTEGRITY CHECKS
@@ -523,39 +558,96 @@ static boolean calc_inequalities( qrslv_system_t sys){
 
 	@return 0 on failure, non-zero on success
 */
+/**
+	A worker whose block has only relations that may be evaluated on
+	several threads at once (relman_thread_safe) lets the others run while
+	it evaluates them; the rest of the iteration stays under par->eval.
+*/
+static void eval_unlock(qrslv_system_t sys){
+  if(sys->par != NULL && sys->eval_alone){
+    asc_mutex_unlock(sys->par->eval);
+  }
+}
+
+static void eval_relock(qrslv_system_t sys){
+  if(sys->par != NULL && sys->eval_alone){
+    asc_mutex_lock(sys->par->eval);
+  }
+}
+
 static boolean calc_residuals( qrslv_system_t sys){
-  int32 row;
+  int32 row, org;
   struct rel_relation *rel;
+  struct rel_relation **blockrels;
   double time0;
   boolean calc_ok = TRUE;
   int calc_ok_1;
+  int32 nfail;
 
   if(sys->residuals.accurate)return TRUE;
 
-  row = sys->residuals.rng->low;
+  /* relations of the current block, grouped for evaluation */
+  if(sys->resbatch != NULL && (
+      sys->resbatch_rows.low != sys->residuals.rng->low
+      || sys->resbatch_rows.high != sys->residuals.rng->high)
+  ){
+    relman_batch_destroy(sys->resbatch);
+    sys->resbatch = NULL;
+  }
+  if(sys->resbatch == NULL && sys->residuals.rng->high >= sys->residuals.rng->low){
+    sys->resbatch_rows = *(sys->residuals.rng);
+    blockrels = ASC_NEW_ARRAY(struct rel_relation *
+      ,sys->resbatch_rows.high - sys->resbatch_rows.low + 1
+    );
+    for(row = sys->resbatch_rows.low; row <= sys->resbatch_rows.high; row++){
+      blockrels[row - sys->resbatch_rows.low]
+        = sys->rlist[mtx_row_to_org(sys->J.mtx,row)];
+    }
+    sys->resbatch = relman_batch_create(blockrels
+      ,sys->resbatch_rows.high - sys->resbatch_rows.low + 1
+    );
+    ascfree(blockrels);
+    if(sys->resbatch == NULL){
+      ERROR_REPORTER_HERE(ASC_PROG_WARNING
+        ,"Unable to group the relations of block %d, evaluating them singly"
+        ,sys->s.block.current_block
+      );
+    }
+  }
+
   time0=tm_cpu_time();
 #ifdef ASC_SIGNAL_TRAPS
   Asc_SignalHandlerPush(SIGFPE,SIG_IGN);
 #endif
 
-  for( ; row <= sys->residuals.rng->high; row++ ) {
-    rel = sys->rlist[mtx_row_to_org(sys->J.mtx,row)];
+  if(sys->resbatch != NULL){
+    eval_unlock(sys);
+    nfail = relman_batch_eval(sys->resbatch, NULL
+      ,sys->resbatch_r, NULL, SLV_PARAM_BOOL(&(sys->p),SAFE_CALC)
+    );
+    eval_relock(sys);
+    if(nfail != 0){
+      calc_ok = FALSE;
 #if DEBUG
-    if(!rel) {
-      int r;
-      r=mtx_row_to_org(sys->J.mtx,row);
-      ERROR_REPORTER_HERE(ASC_PROG_ERROR
-        ,"NULL relation found at ropw %d rel %d !"
-        ,(int)row,r
-      );
-    }
+      CONSOLE_DEBUG("error calculating residuals for block");
 #endif
-    sys->residuals.vec[row] = relman_eval(rel,&calc_ok_1,SLV_PARAM_BOOL(&(sys->p),SAFE_CALC));
-    if(!calc_ok_1){
+    }
+  }
+
+  row = sys->residuals.rng->low;
+  for( ; row <= sys->residuals.rng->high; row++ ) {
+    org = mtx_row_to_org(sys->J.mtx,row);
+    rel = sys->rlist[org];
+    if(sys->resbatch != NULL){
+      sys->residuals.vec[row] = sys->resbatch_r[org];
+    }else{
+      sys->residuals.vec[row] = relman_eval(rel,&calc_ok_1,SLV_PARAM_BOOL(&(sys->p),SAFE_CALC));
+      if(!calc_ok_1){
         calc_ok = FALSE;
 #if DEBUG
         CONSOLE_DEBUG("error calculating residual for row %d",row);
 #endif
+      }
     }
 
     if(strcmp(SLV_PARAM_CHAR(&(sys->p),CONVOPT),"ABSOLUTE") == 0) {
@@ -579,15 +671,86 @@ static boolean calc_residuals( qrslv_system_t sys){
 }
 
 
+/**
+	@return the number of threads on which to calculate the Jacobian of
+	the current block. Blocks being solved in parallel (sys->par) each
+	keep to their own thread, and small blocks are not worth sharing out.
+*/
+static int calc_J_threads(qrslv_system_t sys){
+  int n = SLV_PARAM_INT(&(sys->p),THREADS);
+  if(n <= 1 || sys->par != NULL
+      || sys->J.reg.row.high - sys->J.reg.row.low + 1 < QRSLV_JAC_THREAD_ROWS
+  ){
+    return 1;
+  }
+  return n;
+}
+
+/**
+	calc_J on nthread threads (see system_jacobian_eval): straight into
+	the values of the cached pattern when there is one, otherwise through
+	per-thread buffers that are then put into the matrix.
+*/
+static void calc_J_threaded(qrslv_system_t sys, const var_filter_t *vfilter
+		, int nthread
+){
+  struct rel_relation **rels;
+  struct SystemJacobianEntries ent;
+  struct SystemJacobianBuffer *buf;
+  mtx_coord_t coord;
+  int32 nrels, row, k;
+  int b, safe = SLV_PARAM_BOOL(&(sys->p),SAFE_CALC);
+
+  nrels = sys->J.reg.row.high - sys->J.reg.row.low + 1;
+  rels = ASC_NEW_ARRAY(struct rel_relation *,nrels);
+  for( row = sys->J.reg.row.low; row <= sys->J.reg.row.high; row++ ) {
+    rels[row - sys->J.reg.row.low] = sys->rlist[mtx_row_to_org(sys->J.mtx,row)];
+  }
+  if(sys->J.csr != NULL){
+    mtx_csr_zero(sys->J.csr);
+    if(2 == system_jacobian_eval_csr(rels,nrels,vfilter,safe,nthread
+        ,sys->J.csr)
+    ){
+      /* pattern has changed */
+      mtx_csr_destroy(sys->J.csr);
+      sys->J.csr = NULL;
+    }else{
+      mtx_csr_put(sys->J.csr);
+    }
+  }
+  if(sys->J.csr == NULL){
+    mtx_clear_region(sys->J.mtx,&(sys->J.reg));
+    (void)system_jacobian_eval(rels,nrels,vfilter,safe,nthread,&ent);
+    for(b = 0; b < ent.nbuf; b++){
+      buf = &(ent.buf[b]);
+      for(k = 0; k < buf->n; k++){
+        coord.row = rel_sindex(rels[buf->rel[k]]);
+        coord.col = buf->var[k];
+        mtx_fill_org_value(sys->J.mtx,&coord,buf->value[k]);
+      }
+    }
+    system_jacobian_entries_destroy(&ent);
+    sys->J.csr = mtx_csr_create(sys->J.mtx,&(sys->J.reg));
+  }
+  ASC_FREE(rels);
+}
+
 /**
 	Calculates the current block of the jacobian.
 	It is initially unscaled.
+
+	The incidence of the block does not change while we iterate on it,
+	so after the first evaluation we keep a compressed copy (J.csr) and
+	later evaluations just refill its values in place, through the grouping
+	of the block made for the residuals when there is one.
 */
 static boolean calc_J( qrslv_system_t sys){
   int32 row;
   var_filter_t vfilter;
   double time0;
   real64 resid;
+  struct rel_relation *rel;
+  int nthread;
 
   if(sys->J.accurate)return TRUE;
 
@@ -595,11 +758,55 @@ static boolean calc_J( qrslv_system_t sys){
   vfilter.matchbits = (VAR_INBLOCK | VAR_ACTIVE);
   vfilter.matchvalue = (VAR_INBLOCK | VAR_ACTIVE);
   time0=tm_cpu_time();
-  mtx_clear_region(sys->J.mtx,&(sys->J.reg));
-  for( row = sys->J.reg.row.low; row <= sys->J.reg.row.high; row++ ) {
-    struct rel_relation *rel;
-    rel = sys->rlist[mtx_row_to_org(sys->J.mtx,row)];
-    relman_diffs(rel,&vfilter,sys->J.mtx,&resid,SLV_PARAM_BOOL(&(sys->p),SAFE_CALC));
+  if(sys->J.csr != NULL && !mtx_csr_valid(sys->J.csr,&(sys->J.reg))){
+    mtx_csr_destroy(sys->J.csr);
+    sys->J.csr = NULL;
+  }
+  nthread = calc_J_threads(sys);
+  if(nthread > 1){
+    calc_J_threaded(sys,&vfilter,nthread);
+  }else{
+    eval_unlock(sys);
+    if(sys->J.csr != NULL && sys->resbatch != NULL
+      && sys->resbatch_rows.low == sys->J.reg.row.low
+      && sys->resbatch_rows.high == sys->J.reg.row.high
+    ){
+      /* the block's relations, already grouped for the residuals */
+      mtx_csr_zero(sys->J.csr);
+      if(2 == relman_batch_diffs_csr(sys->resbatch,&vfilter,sys->J.csr
+          ,SLV_PARAM_BOOL(&(sys->p),SAFE_CALC))
+      ){
+        mtx_csr_destroy(sys->J.csr);
+        sys->J.csr = NULL;
+      }else{
+        mtx_csr_put(sys->J.csr);
+      }
+    }else if(sys->J.csr != NULL){
+      mtx_csr_zero(sys->J.csr);
+      for( row = sys->J.reg.row.low; row <= sys->J.reg.row.high; row++ ) {
+        rel = sys->rlist[mtx_row_to_org(sys->J.mtx,row)];
+        if(2 == relman_diffs_csr(rel,&vfilter,sys->J.csr,&resid
+            ,SLV_PARAM_BOOL(&(sys->p),SAFE_CALC))
+        ){
+          /* pattern has changed */
+          mtx_csr_destroy(sys->J.csr);
+          sys->J.csr = NULL;
+          break;
+        }
+      }
+      if(sys->J.csr != NULL){
+        mtx_csr_put(sys->J.csr);
+      }
+    }
+    if(sys->J.csr == NULL){
+      mtx_clear_region(sys->J.mtx,&(sys->J.reg));
+      for( row = sys->J.reg.row.low; row <= sys->J.reg.row.high; row++ ) {
+        rel = sys->rlist[mtx_row_to_org(sys->J.mtx,row)];
+        relman_diffs(rel,&vfilter,sys->J.mtx,&resid,SLV_PARAM_BOOL(&(sys->p),SAFE_CALC));
+      }
+      sys->J.csr = mtx_csr_create(sys->J.mtx,&(sys->J.reg));
+    }
+    eval_relock(sys);
   }
   sys->s.block.jactime += (tm_cpu_time() - time0);
   sys->s.block.jacs++;
@@ -1243,7 +1450,7 @@ static void calc_B( qrslv_system_t sys){
 	@return value is the row rank deficiency, which we hope is 0.
 */
 static int calc_pivots(qrslv_system_t sys){
-  int row_rank_defect=0, oldtiming;
+  int row_rank_defect=0, oldtiming=0;
 #if defined(PIVOT_DEBUG) && defined(ASC_WITH_MMIO)
   FILE *fmtx = NULL;
 #endif
@@ -1251,10 +1458,23 @@ static int calc_pivots(qrslv_system_t sys){
   linsolqr_system_t lsys = sys->J.sys;
   FILE *fp = LIF(sys);
 
-  oldtiming = g_linsolqr_timing;
-  g_linsolqr_timing =SLV_PARAM_BOOL(&(sys->p),LINTIME);
-  linsolqr_factor(lsys,sys->J.fm); /* factor */
-  g_linsolqr_timing = oldtiming;
+  /* workers leave the timing flag to the master, see solve_blocks_parallel */
+  if(sys->par == NULL){
+    oldtiming = g_linsolqr_timing;
+    g_linsolqr_timing =SLV_PARAM_BOOL(&(sys->p),LINTIME);
+  }else if(sys->par->unlock_linear){
+    asc_mutex_unlock(sys->par->eval);
+  }
+  if(SLV_PARAM_BOOL(&(sys->p),REFACTOR)){
+    linsolqr_refactor(lsys,sys->J.fm); /* factor, reusing pivots if we can */
+  }else{
+    linsolqr_factor(lsys,sys->J.fm); /* factor */
+  }
+  if(sys->par == NULL){
+    g_linsolqr_timing = oldtiming;
+  }else if(sys->par->unlock_linear){
+    asc_mutex_lock(sys->par->eval);
+  }
 
   if(OPTIMIZING(sys)){
     CONSOLE_DEBUG("OPTIMISING");
@@ -2433,20 +2653,15 @@ static boolean block_feasible( qrslv_system_t sys){
 }
 
 /**
-	Moves on to the next block, updating all of the solver information.
-	To move to the first block, set sys->s.block.current_block to -1 before
-	calling.  If already at the last block, then sys->s.block.current_block
-	will equal the number of blocks and the system will be declared
-	converged.  Otherwise, the residuals for the new block will be computed
-	and sys->s.calc_ok set according.
+	Records the cost of the current block, if any, and takes it out of
+	the block.
 */
-static void move_to_next_block( qrslv_system_t sys){
+static void end_block( qrslv_system_t sys){
   struct var_variable *var;
   struct rel_relation *rel;
   int32 row;
   int32 col;
   int32 ci;
-  boolean ok;
 
   if(sys->s.block.current_block >= 0 ) {
 
@@ -2478,172 +2693,207 @@ static void move_to_next_block( qrslv_system_t sys){
     }
     sys->s.block.previous_total_size += sys->s.block.current_size;
   }
+  relman_batch_destroy(sys->resbatch);
+  sys->resbatch = NULL;
+  mtx_csr_destroy(sys->J.csr);
+  sys->J.csr = NULL;
+}
 
-  sys->s.block.current_block++;
-  if(sys->s.block.current_block < sys->s.block.number_of ) {
+/**
+	Sets up sys->s.block.current_block for iteration: the residuals for
+	it are computed and sys->s.calc_ok set according.
+*/
+static void begin_block( qrslv_system_t sys){
+  int32 row;
+  int32 col;
+  boolean ok;
 
-    /* Initialize next block */
-    if(OPTIMIZING(sys)){
-      mtx_region(&(sys->J.reg), 0, sys->rank-1, 0, sys->vused-1 );
-    }else{
-      sys->J.reg =
-        (slv_get_solvers_blocks(SERVER))->block[sys->s.block.current_block];
-    }
+  /* Initialize next block */
+  if(OPTIMIZING(sys)){
+    mtx_region(&(sys->J.reg), 0, sys->rank-1, 0, sys->vused-1 );
+  }else{
+    sys->J.reg =
+      (slv_get_solvers_blocks(SERVER))->block[sys->s.block.current_block];
+  }
 
-    row = sys->J.reg.row.high - sys->J.reg.row.low + 1;
-    col = sys->J.reg.col.high - sys->J.reg.col.low + 1;
-    sys->s.block.current_size = MAX(row,col);
+  row = sys->J.reg.row.high - sys->J.reg.row.low + 1;
+  col = sys->J.reg.col.high - sys->J.reg.col.low + 1;
+  sys->s.block.current_size = MAX(row,col);
 
-    sys->s.block.iteration = 0;
-    sys->s.block.cpu_elapsed = 0.0;
-    sys->s.block.functime = 0.0;
-    sys->s.block.jactime = 0.0;
-    sys->s.block.funcs = 0;
-    sys->s.block.jacs = 0;
+  sys->s.block.iteration = 0;
+  sys->s.block.cpu_elapsed = 0.0;
+  sys->s.block.functime = 0.0;
+  sys->s.block.jactime = 0.0;
+  sys->s.block.funcs = 0;
+  sys->s.block.jacs = 0;
+
+  if(SLV_PARAM_BOOL(&(sys->p),SHOW_LESS_IMPT) && (SLV_PARAM_BOOL(&(sys->p),LIFDS) ||
+    sys->s.block.current_size > 1)) {
+    debug_delimiter(LIF(sys));
+    debug_delimiter(LIF(sys));
+  }
+  if(SLV_PARAM_BOOL(&(sys->p),SHOW_LESS_IMPT) && SLV_PARAM_BOOL(&(sys->p),LIFDS)) {
+    ERROR_REPORTER_HERE(ASC_PROG_NOTE,"\n%-40s ---> %d in [%d..%d]\n",
+            "Current block number", sys->s.block.current_block,
+            0, sys->s.block.number_of-1);
+    ERROR_REPORTER_HERE(ASC_PROG_NOTE,"%-40s ---> %d\n", "Current block size",
+      sys->s.block.current_size);
+  }
+  sys->s.calc_ok = TRUE;
 
-    if(SLV_PARAM_BOOL(&(sys->p),SHOW_LESS_IMPT) && (SLV_PARAM_BOOL(&(sys->p),LIFDS) ||
-      sys->s.block.current_size > 1)) {
-      debug_delimiter(LIF(sys));
-      debug_delimiter(LIF(sys));
-    }
-    if(SLV_PARAM_BOOL(&(sys->p),SHOW_LESS_IMPT) && SLV_PARAM_BOOL(&(sys->p),LIFDS)) {
-      ERROR_REPORTER_HERE(ASC_PROG_NOTE,"\n%-40s ---> %d in [%d..%d]\n",
-              "Current block number", sys->s.block.current_block,
-              0, sys->s.block.number_of-1);
-      ERROR_REPORTER_HERE(ASC_PROG_NOTE,"%-40s ---> %d\n", "Current block size",
-        sys->s.block.current_size);
-    }
-    sys->s.calc_ok = TRUE;
+  if(!(ok = calc_objective(sys)) ) {
+    ERROR_REPORTER_HERE(ASC_PROG_WARNING,"Objective calculation errors detected");
+  }
+  if(SLV_PARAM_BOOL(&(sys->p),SHOW_LESS_IMPT) && sys->obj) {
+    ERROR_REPORTER_HERE(ASC_PROG_NOTE,"%-40s ---> %g\n", "Objective", sys->objective);
+  }
+  sys->s.calc_ok = sys->s.calc_ok && ok;
 
-    if(!(ok = calc_objective(sys)) ) {
-      ERROR_REPORTER_HERE(ASC_PROG_WARNING,"Objective calculation errors detected");
-    }
-    if(SLV_PARAM_BOOL(&(sys->p),SHOW_LESS_IMPT) && sys->obj) {
-      ERROR_REPORTER_HERE(ASC_PROG_NOTE,"%-40s ---> %g\n", "Objective", sys->objective);
-    }
-    sys->s.calc_ok = sys->s.calc_ok && ok;
+  if(!(sys->p.ignore_bounds) ) {
+    slv_ensure_bounds(SERVER, sys->J.reg.col.low,
+                      sys->J.reg.col.high,MIF(sys));
+  }
 
-    if(!(sys->p.ignore_bounds) ) {
-      slv_ensure_bounds(SERVER, sys->J.reg.col.low,
-                        sys->J.reg.col.high,MIF(sys));
-    }
+  sys->residuals.accurate = FALSE;
+  if(!(ok = calc_residuals(sys)) ) {
+    /* error_reporter will have been called somewhere else already */
+    CONSOLE_DEBUG("Residual calculation errors detected in move_to_next_block.");
+  }
+  if(SLV_PARAM_BOOL(&(sys->p),SHOW_LESS_IMPT) &&
+      (sys->s.block.current_size >1 ||
+       SLV_PARAM_BOOL(&(sys->p),LIFDS)) ) {
+    ERROR_REPORTER_HERE(ASC_PROG_NOTE,"%-40s ---> %g\n", "Residual norm (unscaled)",
+      sys->s.block.residual);
+  }
+  sys->s.calc_ok = sys->s.calc_ok && ok;
+
+  /* Must be updated as soon as required */
+  sys->J.accurate = FALSE;
+  sys->update.weights = 0;
+  sys->update.nominals = 0;
+  sys->update.relnoms = 0;
+  sys->update.iterative = 0;
+  sys->ZBZ.accurate = FALSE;
+  sys->variables.accurate = FALSE;
+  sys->gradient.accurate = FALSE;
+  sys->multipliers.accurate = FALSE;
+  sys->stationary.accurate = FALSE;
+  sys->newton.accurate = FALSE;
+  sys->Bnewton.accurate = FALSE;
+  sys->nullspace.accurate = FALSE;
+  sys->gamma.accurate = FALSE;
+  sys->Jgamma.accurate = FALSE;
+  sys->varstep1.accurate = FALSE;
+  sys->Bvarstep1.accurate = FALSE;
+  sys->varstep2.accurate = FALSE;
+  sys->Bvarstep2.accurate = FALSE;
+  sys->mulstep1.accurate = FALSE;
+  sys->mulstep2.accurate = FALSE;
+  sys->varstep.accurate = FALSE;
+  sys->mulstep.accurate = FALSE;
 
-    sys->residuals.accurate = FALSE;
-    if(!(ok = calc_residuals(sys)) ) {
-      /* error_reporter will have been called somewhere else already */
-      CONSOLE_DEBUG("Residual calculation errors detected in move_to_next_block.");
-    }
-    if(SLV_PARAM_BOOL(&(sys->p),SHOW_LESS_IMPT) &&
-        (sys->s.block.current_size >1 ||
-         SLV_PARAM_BOOL(&(sys->p),LIFDS)) ) {
-      ERROR_REPORTER_HERE(ASC_PROG_NOTE,"%-40s ---> %g\n", "Residual norm (unscaled)",
-        sys->s.block.residual);
+  if(!OPTIMIZING(sys)){
+    sys->ZBZ.accurate = TRUE;
+    sys->gradient.accurate = TRUE;
+    sys->multipliers.accurate = TRUE;
+    sys->stationary.accurate = TRUE;
+    sys->Bnewton.accurate = TRUE;
+    sys->nullspace.accurate = TRUE;
+    sys->Bvarstep1.accurate = TRUE;
+    sys->Bvarstep2.accurate = TRUE;
+  }
+}
+
+/**
+	Checks the left over relations and inequalities once all the blocks
+	are solved, declaring the system converged if they are satisfied.
+*/
+static void blocks_done( qrslv_system_t sys){
+  boolean ok;
+
+  /*
+   * Before we claim convergence, we must check if we left behind
+   * some unassigned relations.  If and only if they happen to be
+   * satisfied at the current point, convergence has been obtained.
+   *
+   * Also insures that all included relations have valid residuals.
+   * Included inequalities will have correct residuals.
+   * Unsatisfied included inequalities cause inconsistency.
+   *
+   * This of course ignores that fact an objective function might
+   * be present.  Then, feasibility isn't enough, is it now.
+   */
+  if(sys->s.struct_singular ) {
+     /* black box w/singletons provoking bug here, maybe */
+    sys->s.block.current_size = sys->rused - sys->rank;
+    if(SLV_PARAM_BOOL(&(sys->p),SHOW_LESS_IMPT)) {
+      debug_delimiter(LIF(sys));
+      ERROR_REPORTER_HERE(ASC_PROG_NOTE,"%-40s ---> %d\n", "Unassigned Relations",
+              sys->s.block.current_size);
     }
-    sys->s.calc_ok = sys->s.calc_ok && ok;
-
-    /* Must be updated as soon as required */
-    sys->J.accurate = FALSE;
-    sys->update.weights = 0;
-    sys->update.nominals = 0;
-    sys->update.relnoms = 0;
-    sys->update.iterative = 0;
-    sys->ZBZ.accurate = FALSE;
-    sys->variables.accurate = FALSE;
-    sys->gradient.accurate = FALSE;
-    sys->multipliers.accurate = FALSE;
-    sys->stationary.accurate = FALSE;
-    sys->newton.accurate = FALSE;
-    sys->Bnewton.accurate = FALSE;
-    sys->nullspace.accurate = FALSE;
-    sys->gamma.accurate = FALSE;
-    sys->Jgamma.accurate = FALSE;
-    sys->varstep1.accurate = FALSE;
-    sys->Bvarstep1.accurate = FALSE;
-    sys->varstep2.accurate = FALSE;
-    sys->Bvarstep2.accurate = FALSE;
-    sys->mulstep1.accurate = FALSE;
-    sys->mulstep2.accurate = FALSE;
-    sys->varstep.accurate = FALSE;
-    sys->mulstep.accurate = FALSE;
-
-    if(!OPTIMIZING(sys)){
-      sys->ZBZ.accurate = TRUE;
-      sys->gradient.accurate = TRUE;
-      sys->multipliers.accurate = TRUE;
-      sys->stationary.accurate = TRUE;
-      sys->Bnewton.accurate = TRUE;
-      sys->nullspace.accurate = TRUE;
-      sys->Bvarstep1.accurate = TRUE;
-      sys->Bvarstep2.accurate = TRUE;
+    sys->J.reg.row.low = sys->J.reg.col.low = sys->rank;
+    sys->J.reg.row.high = sys->J.reg.col.high = sys->rused - 1;
+    sys->residuals.accurate = FALSE;
+    if(!(ok=calc_residuals(sys)) ) {
+       FPRINTF(MIF(sys),
+         "Residual calculation errors detected in leftover equations.\n");
     }
 
-  }else{
-    /*
-     * Before we claim convergence, we must check if we left behind
-     * some unassigned relations.  If and only if they happen to be
-     * satisfied at the current point, convergence has been obtained.
-     *
-     * Also insures that all included relations have valid residuals.
-     * Included inequalities will have correct residuals.
-     * Unsatisfied included inequalities cause inconsistency.
-     *
-     * This of course ignores that fact an objective function might
-     * be present.  Then, feasibility isn't enough, is it now.
-     */
-    if(sys->s.struct_singular ) {
-       /* black box w/singletons provoking bug here, maybe */
-      sys->s.block.current_size = sys->rused - sys->rank;
-      if(SLV_PARAM_BOOL(&(sys->p),SHOW_LESS_IMPT)) {
-        debug_delimiter(LIF(sys));
-        ERROR_REPORTER_HERE(ASC_PROG_NOTE,"%-40s ---> %d\n", "Unassigned Relations",
-                sys->s.block.current_size);
-      }
-      sys->J.reg.row.low = sys->J.reg.col.low = sys->rank;
-      sys->J.reg.row.high = sys->J.reg.col.high = sys->rused - 1;
-      sys->residuals.accurate = FALSE;
-      if(!(ok=calc_residuals(sys)) ) {
-         FPRINTF(MIF(sys),
-           "Residual calculation errors detected in leftover equations.\n");
-      }
-
-      /** @TODO does this 'ok' needed to be ANDed with sys->s.calc_ok? */
+    /** @TODO does this 'ok' needed to be ANDed with sys->s.calc_ok? */
 
+    if(SLV_PARAM_BOOL(&(sys->p),SHOW_LESS_IMPT)) {
+      ERROR_REPORTER_HERE(ASC_PROG_NOTE,"%-40s ---> %g\n", "Residual norm (unscaled)",
+              sys->s.block.residual);
+    }
+    if(block_feasible(sys) ) {
       if(SLV_PARAM_BOOL(&(sys->p),SHOW_LESS_IMPT)) {
-        ERROR_REPORTER_HERE(ASC_PROG_NOTE,"%-40s ---> %g\n", "Residual norm (unscaled)",
-                sys->s.block.residual);
+        ERROR_REPORTER_HERE(ASC_PROG_NOTE,"\nUnassigned relations ok. Lucky you.\n");
       }
-      if(block_feasible(sys) ) {
-        if(SLV_PARAM_BOOL(&(sys->p),SHOW_LESS_IMPT)) {
-          ERROR_REPORTER_HERE(ASC_PROG_NOTE,"\nUnassigned relations ok. Lucky you.\n");
-        }
-        sys->s.converged = TRUE;
-      }else{
-        ERROR_REPORTER_HERE(ASC_PROG_WARNING,"Problem inconsistent: unassigned relations not satisfied");
+      sys->s.converged = TRUE;
+    }else{
+      ERROR_REPORTER_HERE(ASC_PROG_WARNING,"Problem inconsistent: unassigned relations not satisfied");
 /*        if(SLV_PARAM_BOOL(&(sys->p),SHOW_LESS_IMPT)) {
-          ERROR_REPORTER_HERE(ASC_PROG_NOTE,"\nProblem inconsistent:  %s.\n",
-                  "Unassigned relations not satisfied");
-        }
-*/
-        sys->s.inconsistent = TRUE;
-      }
-      if(SLV_PARAM_BOOL(&(sys->p),SHOW_LESS_IMPT)) {
-        debug_delimiter(LIF(sys));
+        ERROR_REPORTER_HERE(ASC_PROG_NOTE,"\nProblem inconsistent:  %s.\n",
+                "Unassigned relations not satisfied");
       }
-    }else{
-      sys->s.converged = TRUE;
+*/
+      sys->s.inconsistent = TRUE;
     }
-    /* nearly done checking. Must verify included inequalities if
-       we think equalities are ok. */
-    if(sys->s.converged) {
-      ok = calc_inequalities(sys);
-      if(!ok && sys->s.inconsistent){
-        sys->s.inconsistent = TRUE;
-        ERROR_REPORTER_HERE(ASC_PROG_ERR,"System marked inconsistent after inspecting inequalities");
-      }
+    if(SLV_PARAM_BOOL(&(sys->p),SHOW_LESS_IMPT)) {
+      debug_delimiter(LIF(sys));
+    }
+  }else{
+    sys->s.converged = TRUE;
+  }
+  /* nearly done checking. Must verify included inequalities if
+     we think equalities are ok. */
+  if(sys->s.converged) {
+    ok = calc_inequalities(sys);
+    if(!ok && sys->s.inconsistent){
+      sys->s.inconsistent = TRUE;
+      ERROR_REPORTER_HERE(ASC_PROG_ERR,"System marked inconsistent after inspecting inequalities");
     }
   }
 }
 
+/**
+	Moves on to the next block, updating all of the solver information.
+	To move to the first block, set sys->s.block.current_block to -1 before
+	calling.  If already at the last block, then sys->s.block.current_block
+	will equal the number of blocks and the system will be declared
+	converged.  Otherwise, the residuals for the new block will be computed
+	and sys->s.calc_ok set according.
+*/
+static void move_to_next_block( qrslv_system_t sys){
+  end_block(sys);
+  sys->s.block.current_block++;
+  if(sys->s.block.current_block < sys->s.block.number_of ) {
+    begin_block(sys);
+  }else{
+    blocks_done(sys);
+  }
+}
+
 /**
 	Calls the appropriate reorder function on a block
 */
@@ -2720,6 +2970,19 @@ static void find_next_unconverged_block( qrslv_system_t sys){
    reorder_new_block(sys);
 }
 
+/**
+	Called when the current block has converged. A worker of the parallel
+	block solver (see solve_blocks_parallel) only solves the block it was
+	given, so it is finished; otherwise we go on to the next block.
+*/
+static void block_converged( qrslv_system_t sys){
+  if(sys->par != NULL){
+    sys->s.converged = TRUE;
+    return;
+  }
+  find_next_unconverged_block(sys);
+}
+
 /*------------------------------------------------------------------------------
   ITERATION BEGIN/END ROUTINES
 */
@@ -2828,7 +3091,7 @@ int32 qrslv_get_default_parameters(slv_system_t server, SlvClientToken asys
   }
 
   parameters->num_parms = 0;
-  asc_assert(qrslv_PA_SIZE==44);
+  asc_assert(qrslv_PA_SIZE==46);
   /* begin defining parameters */
 
   slv_param_bool(parameters,IGNORE_BOUNDS
@@ -3139,7 +3402,7 @@ int32 qrslv_get_default_parameters(slv_system_t server, SlvClientToken asys
   	}, "Fastest-SPK1/MR-RANKI"}, (char *[]){
 		"SPK1/RANKI","SPK1/RANKI+ROW",
 		"Fast-SPK1/RANKI","Fast-SPK1/RANKI+ROW",
-		"Fastest-SPK1/MR-RANKI","CondQR","CPQR",NULL
+		"Fastest-SPK1/MR-RANKI","SPK1/SUPERNODAL-LU","CondQR","CPQR",NULL
   	}   /*,"GAUSS","GAUSS_EASY"  currently only works for ken */
   );
 
@@ -3150,6 +3413,27 @@ int32 qrslv_get_default_parameters(slv_system_t server, SlvClientToken asys
   	}, 30, 5, 100}
   );
 
+  slv_param_bool(parameters,REFACTOR
+  	,(SlvParameterInitBool){{"refactor"
+  		,"reuse pivot sequence",2
+  		,"If TRUE, refactor the Jacobian using the pivot sequence of the"
+		" previous factorization of the block while its pivots remain"
+		" acceptable (ranki methods only)"
+  	}, 1}
+  );
+
+  slv_param_int(parameters,THREADS
+  	,(SlvParameterInitInt){{"threads"
+  		,"threads for independent blocks",2
+  		,"Number of threads on which to solve blocks that do not depend on"
+		" each other. Token relations are evaluated and blocks factored"
+		" in parallel; blocks with blackbox or glassbox relations are"
+		" evaluated by one thread at a time. When blocks are"
+		" solved one after another, the Jacobian of a large block is"
+		" calculated on this many threads instead"
+  	}, 1, 1, 64}
+  );
+
   asc_assert(parameters->num_parms==qrslv_PA_SIZE);
 
   return 1;
@@ -3217,6 +3501,8 @@ static void destroy_matrices( qrslv_system_t sys)
       for( ; count >= 0; count-- ) {
          destroy_array(linsolqr_get_rhs(sys->J.sys,count));
        }
+      mtx_csr_destroy(sys->J.csr);
+      sys->J.csr = NULL;
       mtx_destroy(linsolqr_get_matrix(sys->J.sys));
       linsolqr_set_matrix(sys->J.sys,NULL);
       linsolqr_destroy(sys->J.sys);
@@ -3254,6 +3540,9 @@ static void destroy_vectors( qrslv_system_t sys)
    destroy_array(sys->relnoms.vec);
    destroy_array(sys->variables.vec);
    destroy_array(sys->residuals.vec);
+   destroy_array(sys->resbatch_r);
+   relman_batch_destroy(sys->resbatch);
+   sys->resbatch = NULL;
    destroy_array(sys->gradient.vec);
    destroy_array(sys->multipliers.vec);
    destroy_array(sys->stationary.vec);
@@ -3395,6 +3684,8 @@ static void set_factor_options (qrslv_system_t sys)
     sys->J.fm = ranki_jz2;
   }else if(strcmp(SLV_PARAM_CHAR(&(sys->p),FACTOR_OPTION),"Fastest-SPK1/MR-RANKI") == 0) {
     sys->J.fm = ranki_ba2;
+  }else if(strcmp(SLV_PARAM_CHAR(&(sys->p),FACTOR_OPTION),"SPK1/SUPERNODAL-LU") == 0) {
+    sys->J.fm = supernodal_lu;
 /*  }else if(strcmp(SLV_PARAM_CHAR(&(sys->p),FACTOR_OPTION),"GAUSS") == 0) {
     sys->J.fm = gauss_ba2;
   }else if(strcmp(SLV_PARAM_CHAR(&(sys->p),FACTOR_OPTION),"GAUSS_EASY") == 0) {
@@ -3418,14 +3709,13 @@ static void set_factor_options (qrslv_system_t sys)
 }
 
 /*
-  configures linsolqr system, among other things.
-  sets type to be ranki_kw or ranki_jz as determined by
-  parameters.
+  creates the linsolqr system, its matrix and right hand sides.
 */
-static void create_matrices(slv_system_t server, qrslv_system_t sys)
+static void create_linsolqr(qrslv_system_t sys)
 {
   sys->J.sys = linsolqr_create();
   sys->J.mtx = mtx_create();
+  sys->J.csr = NULL;
 
   set_factor_options(sys);
 
@@ -3438,6 +3728,16 @@ static void create_matrices(slv_system_t server, qrslv_system_t sys)
   /* rhs 2 for sys->mulstep2 */
   sys->J.rhs = ASC_NEW_ARRAY_OR_NULL(real64,sys->cap);
   linsolqr_add_rhs(sys->J.sys,sys->J.rhs,TRUE);
+}
+
+/*
+  configures linsolqr system, among other things.
+  sets type to be ranki_kw or ranki_jz as determined by
+  parameters.
+*/
+static void create_matrices(slv_system_t server, qrslv_system_t sys)
+{
+  create_linsolqr(sys);
   sys->J.relpivots = set_create(sys->cap);
   sys->J.varpivots = set_create(sys->cap);
 
@@ -3466,6 +3766,8 @@ qrslv_system_t sys;
   sys->variables.rng = &(sys->J.reg.col);
   sys->residuals.vec = ASC_NEW_ARRAY_OR_NULL(real64,sys->cap);
   sys->residuals.rng = &(sys->J.reg.row);
+  sys->resbatch_r = ASC_NEW_ARRAY_OR_NULL(real64,sys->cap);
+  sys->resbatch = NULL;
   if(OPTIMIZING(sys)){
     sys->gradient.vec = ASC_NEW_ARRAY_OR_NULL(real64,sys->cap);
     sys->gradient.rng = &(sys->J.reg.col);
@@ -3586,6 +3888,8 @@ static void qrslv_update_linsolqr(qrslv_system_t sys){
     sys->J.fm = ranki_jz2;
   }else if(strcmp(SLV_PARAM_CHAR(&(sys->p),FACTOR_OPTION),"Fastest-SPK1/MR-RANKI") == 0) {
     sys->J.fm = ranki_ba2;
+  }else if(strcmp(SLV_PARAM_CHAR(&(sys->p),FACTOR_OPTION),"SPK1/SUPERNODAL-LU") == 0) {
+    sys->J.fm = supernodal_lu;
 /*  }else if(strcmp(SLV_PARAM_CHAR(&(sys->p),FACTOR_OPTION),"GAUSS_EASY") == 0) {
     sys->J.fm = gauss_easy;
   }else if(strcmp(SLV_PARAM_CHAR(&(sys->p),FACTOR_OPTION),"NGSLV-2-LEVEL") == 0) {
@@ -3857,7 +4161,7 @@ static int qrslv_iterate(slv_system_t server, SlvClientToken asys){
       sys->s.calc_ok = calc_residuals(sys);
       if(sys->s.calc_ok) {
         iteration_ends(sys);
-        find_next_unconverged_block(sys);
+        block_converged(sys);
         update_status(sys);
         return 0;
       }
@@ -3918,7 +4222,7 @@ static int qrslv_iterate(slv_system_t server, SlvClientToken asys){
 	&& calc_sqrt_D0(sys->stationary.norm2) <= SLV_PARAM_REAL(&(sys->p),STAT_TOL)
   ){
     iteration_ends(sys);
-    find_next_unconverged_block(sys);
+    block_converged(sys);
     update_status(sys);
     return 0;
   }
@@ -4160,15 +4464,250 @@ static int qrslv_iterate(slv_system_t server, SlvClientToken asys){
         "You may wish to check for numeric dependency at solution."
         , sys->s.block.current_block);
     }
-    find_next_unconverged_block(sys);
+    block_converged(sys);
   }
   update_status(sys);
   return 0;
 }
 
 
+/*------------------------------------------------------------------------------
+  PARALLEL BLOCK SOLUTION
+*/
+
+/**
+	@return the number of threads to solve the blocks on, or 1 if they
+	are to be solved one after another by qrslv_iterate.
+*/
+static int qrslv_threads(qrslv_system_t sys){
+  int n = SLV_PARAM_INT(&(sys->p),THREADS);
+  if(n <= 1 || OPTIMIZING(sys) || !sys->s.ready_to_solve
+      || sys->s.block.current_block != -1 || sys->s.block.number_of < 2){
+    return 1;
+  }
+  return MIN(n,sys->s.block.number_of);
+}
+
+/**
+	Reorders all the blocks up front, rather than as each is reached,
+	since reordering changes the solver lists that the workers share.
+*/
+static void reorder_all_blocks(qrslv_system_t sys){
+  const mtx_block_t *b = slv_get_solvers_blocks(SERVER);
+  int32 c;
+
+  for(sys->s.block.current_block = 0
+      ; sys->s.block.current_block < sys->s.block.number_of
+      ; sys->s.block.current_block++
+  ){
+    sys->J.reg = b->block[sys->s.block.current_block];
+    reorder_new_block(sys);
+    /* the next reordering wants no other block flagged */
+    for(c = sys->J.reg.col.low; c <= sys->J.reg.col.high; c++){
+      var_set_in_block(sys->vlist[mtx_col_to_org(sys->J.mtx,c)],FALSE);
+    }
+    for(c = sys->J.reg.row.low; c <= sys->J.reg.row.high; c++){
+      rel_set_in_block(sys->rlist[mtx_row_to_org(sys->J.mtx,c)],FALSE);
+    }
+  }
+  sys->s.block.current_block = -1;
+}
+
+/**
+	Makes a worker: a copy of the master with its own linear system and
+	matrix. Its vectors share their storage with the master's, but range
+	over the worker's own current block.
+*/
+static qrslv_system_t worker_create(qrslv_system_t master
+		,struct qrslv_parallel *par
+){
+  qrslv_system_t sys;
+  int k;
+
+  sys = ASC_NEW(struct qrslv_system_structure);
+  *sys = *master;
+  sys->par = par;
+  sys->eval_alone = FALSE;
+  sys->B = NULL;
+  sys->J.relpivots = NULL;
+  sys->J.varpivots = NULL;
+  sys->resbatch = NULL;
+  sys->s.iteration = 0;
+  sys->s.block.previous_total_size = 0;
+  create_linsolqr(sys);
+  {
+    struct vec_vector *vec[] = {
+      &(sys->nominals), &(sys->weights), &(sys->relnoms), &(sys->variables)
+      ,&(sys->residuals), &(sys->gradient), &(sys->multipliers)
+      ,&(sys->stationary), &(sys->gamma), &(sys->Jgamma), &(sys->newton)
+      ,&(sys->Bnewton), &(sys->nullspace), &(sys->varstep1)
+      ,&(sys->Bvarstep1), &(sys->varstep2), &(sys->Bvarstep2)
+      ,&(sys->mulstep1), &(sys->mulstep2), &(sys->varstep), &(sys->mulstep)
+    };
+    for(k = 0; k < (int)(sizeof(vec)/sizeof(vec[0])); k++){
+      if(vec[k]->rng == &(master->J.reg.row)){
+        vec[k]->rng = &(sys->J.reg.row);
+      }else if(vec[k]->rng == &(master->J.reg.col)){
+        vec[k]->rng = &(sys->J.reg.col);
+      }
+    }
+  }
+  return sys;
+}
+
+static void worker_destroy(qrslv_system_t sys){
+  relman_batch_destroy(sys->resbatch);
+  destroy_matrices(sys); /* just the worker's own linear system */
+  ascfree(sys);
+}
+
+/**
+	@return TRUE if the relations of the worker's current block may all be
+	evaluated while other workers evaluate theirs (see eval_unlock).
+*/
+static boolean block_thread_safe(qrslv_system_t sys){
+  int32 row;
+  for(row = sys->J.reg.row.low; row <= sys->J.reg.row.high; row++){
+    if(!relman_thread_safe(sys->rlist[mtx_row_to_org(sys->J.mtx,row)])){
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+/**
+	Task for asc_task_graph_run: solve one block on the given worker.
+	@return 0 if the block converged.
+*/
+static int solve_block_task(void *data, int worker, int32 block){
+  struct qrslv_parallel *par = (struct qrslv_parallel *)data;
+  qrslv_system_t sys = par->worker[worker];
+  int failed = 0;
+
+  asc_mutex_lock(par->eval);
+  sys->s.block.current_block = block;
+  sys->s.converged = FALSE;
+  sys->eval_alone = FALSE;
+  begin_block(sys);
+  sys->eval_alone = block_thread_safe(sys);
+  if(!block_feasible(sys)){
+    slv_set_up_block(SERVER,block);
+    linsolqr_reorder(sys->J.sys,&(sys->J.reg),natural);
+    sys->s.ready_to_solve = TRUE;
+    while(sys->s.ready_to_solve){
+      par->err[worker] |= qrslv_iterate(SERVER,(SlvClientToken)sys);
+    }
+    failed = !sys->s.converged;
+  }
+  if(failed){
+    if(par->failed < 0){
+      par->failed = block;
+      par->failed_worker = worker;
+    }
+  }else{
+    end_block(sys);
+  }
+  asc_mutex_unlock(par->eval);
+  return failed;
+}
+
+static void worker_thread_done(void *data, int worker){
+  (void)data;
+  (void)worker;
+  linsolqr_free_reused_mem();
+  mtx_free_reused_mem();
+  relman_free_reused_mem();
+}
+
+/**
+	Solves the blocks on several threads, each block as soon as the blocks
+	it depends on are solved (see slv_block_graph_create).
+
+	Everything that touches the instance tree is serialised by par.eval,
+	except the evaluation of residuals and Jacobians of blocks made only of
+	token relations (see eval_unlock) and, when LINTIME is off, the
+	factorizations. Blocks with other relations (blackbox, glassbox) are
+	evaluated one at a time. Unlike the serial path, it does not leave the
+	Jacobian of the last block in sys->J.
+
+	@return the qrslv_iterate error codes, or'ed, or -1 if nothing was done
+	and the blocks must be solved in order after all.
+*/
+static int solve_blocks_parallel(qrslv_system_t sys, int nworker){
+  struct qrslv_parallel par;
+  slv_block_graph_t *g;
+  qrslv_system_t fw;
+  int32 total;
+  int w, err = 0, oldtiming;
+  double time0;
+
+  g = slv_block_graph_create(SERVER);
+  if(g == NULL){
+    return -1;
+  }
+  time0 = tm_cpu_time();
+  if(SLV_PARAM_BOOL(&(sys->p),RELNOMSCALE) == 1){
+    calc_relnoms(sys);
+  }
+  reorder_all_blocks(sys);
+
+  par.master = sys;
+  par.nworker = nworker;
+  par.eval = asc_mutex_create();
+  par.unlock_linear = !SLV_PARAM_BOOL(&(sys->p),LINTIME);
+  par.failed = -1;
+  par.failed_worker = -1;
+  par.err = ASC_NEW_ARRAY_CLEAR(int,nworker);
+  par.worker = ASC_NEW_ARRAY(qrslv_system_t,nworker);
+  for(w = 0; w < nworker; w++){
+    par.worker[w] = worker_create(sys,&par);
+  }
+
+  oldtiming = g_linsolqr_timing;
+  g_linsolqr_timing = SLV_PARAM_BOOL(&(sys->p),LINTIME);
+  asc_task_graph_run(g->nblocks,g->npred,g->succptr,g->succ,nworker
+    ,&solve_block_task,&worker_thread_done,&par
+  );
+  g_linsolqr_timing = oldtiming;
+
+  for(w = 0; w < nworker; w++){
+    err |= par.err[w];
+    sys->s.iteration += par.worker[w]->s.iteration;
+    sys->s.block.previous_total_size
+      += par.worker[w]->s.block.previous_total_size;
+  }
+  if(par.failed < 0){
+    sys->s.block.current_block = sys->s.block.number_of;
+    blocks_done(sys);
+  }else{
+    /* leave the master as if it had stopped in the failed block */
+    fw = par.worker[par.failed_worker];
+    total = sys->s.block.previous_total_size;
+    sys->s.block = fw->s.block;
+    sys->s.block.previous_total_size = total;
+    sys->s.calc_ok = fw->s.calc_ok;
+    sys->s.diverged = fw->s.diverged;
+    sys->s.inconsistent = fw->s.inconsistent;
+    sys->s.iteration_limit_exceeded = fw->s.iteration_limit_exceeded;
+    sys->s.time_limit_exceeded = fw->s.time_limit_exceeded;
+    sys->J.reg = fw->J.reg;
+  }
+  /* cpu time of all the threads */
+  sys->s.cpu_elapsed += (double)(tm_cpu_time() - time0);
+  update_status(sys);
+
+  for(w = 0; w < nworker; w++){
+    worker_destroy(par.worker[w]);
+  }
+  ascfree(par.worker);
+  ascfree(par.err);
+  asc_mutex_destroy(par.eval);
+  slv_block_graph_destroy(g);
+  return err;
+}
+
 static int qrslv_solve(slv_system_t server, SlvClientToken asys){
-  int err = 0;
+  int err = 0, nthreads;
   qrslv_system_t sys;
   sys = QRSLV(asys);
   if(server == NULL || sys==NULL) return 1;
@@ -4205,6 +4744,11 @@ static int qrslv_solve(slv_system_t server, SlvClientToken asys){
   }
 #endif
 
+  nthreads = qrslv_threads(sys);
+  if(nthreads > 1){
+    /* -1 if it declined, and we go on as usual */
+    err = MAX(0,solve_blocks_parallel(sys,nthreads));
+  }
   while(sys->s.ready_to_solve) err = err | qrslv_iterate(server,sys);
   if(err)ERROR_REPORTER_HERE(ASC_PROG_ERR,"Solver error %d",err);
   return err;
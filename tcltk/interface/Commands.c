@@ -615,6 +615,9 @@ void Asc_CreateCommands(Tcl_Interp *interp)
   ASCADDCOM(interp, Asc_SimBinTokenSetOptionsHN, Asc_SimBinTokenSetOptions,
     "library", Asc_SimBinTokenSetOptionsHU, Asc_SimBinTokenSetOptionsHS,
     Asc_SimBinTokenSetOptionsHLF);
+  ASCADDCOM(interp, Asc_SimBinTokenSetJITOptionsHN, Asc_SimBinTokenSetJITOptions,
+    "library", Asc_SimBinTokenSetJITOptionsHU, Asc_SimBinTokenSetJITOptionsHS,
+    Asc_SimBinTokenSetJITOptionsHLF);
 
   ASCADDCOM(interp,"sims", Asc_SimsQueryCmd,
     "simulations",
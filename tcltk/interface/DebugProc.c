@@ -3154,7 +3154,7 @@ int Asc_DebuCheckRelFp(ClientData cdata, Tcl_Interp *interp,
   for (i=0; i<maxrel; i++) {
     rel=rp[i];
     rinst =(struct Instance *)rel_instance(rel);
-    status = RelationCalcExceptionsInfix(rinst);
+    status = RelationCalcExceptionsInfix(rinst,NULL);
     if (status != RCE_OK && status != RCE_BADINPUT) {
       sprintf(tmps,"%d %d %d %d %d",i,
         ISTRUE(RCE_ERR_LHS & status),
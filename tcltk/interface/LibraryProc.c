@@ -86,12 +86,13 @@ int Asc_LibrOptionsCmd(ClientData cdata, Tcl_Interp *interp,
 ){
 
 /* keep the names here < 60 chars. Data for Options command */
-#define OPTIONCOUNT 4
+#define OPTIONCOUNT 5
   struct int_option option_list[OPTIONCOUNT] = {
     {&g_compiler_warnings,"-compilerWarnings",0,INT_MAX},
     {&g_parser_warnings,"-parserWarnings",0,5},
     {&g_simplify_relations,"-simplifyRelations",0,1},
-    {&g_use_copyanon,"-useCopyAnon",0,1}
+    {&g_use_copyanon,"-useCopyAnon",0,1},
+    {&g_pass2_threads,"-pass2Threads",0,256}
   };
 #define GOL option_list
 
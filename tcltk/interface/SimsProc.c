@@ -630,3 +630,34 @@ int Asc_SimBinTokenSetOptions(ClientData cdata, Tcl_Interp *interp,
                      (unsigned long)maxrels,verbose,housekeep);
   return TCL_OK;
 }
+
+
+STDHLF(Asc_SimBinTokenSetJITOptions, (Asc_SimBinTokenSetJITOptionsHL,HLFSTOP));
+int Asc_SimBinTokenSetJITOptions(ClientData cdata, Tcl_Interp *interp,
+                                 int argc, CONST84 char **argv)
+{
+  const char *cachename;
+  long maxrels;
+
+  ASCUSE;  /* see if first arg is -help */
+  if (argc != 3 ) {
+    Asc_HelpGetUsage(interp,Asc_SimBinTokenSetJITOptionsHN);
+    return TCL_ERROR;
+  };
+  cachename = argv[1];
+  if (Tcl_ExprLong(interp,argv[2],&maxrels) != TCL_OK) {
+    Tcl_ResetResult(interp);
+    Tcl_AppendResult(interp,argv[0],": Error converting input",(char *)NULL);
+    return TCL_ERROR;
+  }
+  Tcl_ResetResult(interp);
+  if (cachename[0] == '\0') {
+    cachename = NULL;
+  }
+  if (BinTokenSetJITOptions(cachename,(unsigned long)maxrels)) {
+    Tcl_SetResult(interp, "1", TCL_STATIC);
+  } else {
+    Tcl_SetResult(interp, "0", TCL_STATIC);
+  }
+  return TCL_OK;
+}
@@ -209,5 +209,25 @@ extern int Asc_SimBinTokenSetOptions(ClientData, Tcl_Interp*, int, CONST84 char*
  *  Sim_SetupBinTokenCC in LibraryProc.tcl\n\
 "
 
+STDHLF_H(Asc_SimBinTokenSetJITOptions);
+extern int Asc_SimBinTokenSetJITOptions(ClientData, Tcl_Interp*, int, CONST84 char**);
+/**  Registered as */
+#define Asc_SimBinTokenSetJITOptionsHN "sim_BinTokenSetJITOptions"
+/**  Usage */
+#define Asc_SimBinTokenSetJITOptionsHU \
+  Asc_SimBinTokenSetJITOptionsHN " <cachefile maxrels>"
+/**  Short help text */
+#define Asc_SimBinTokenSetJITOptionsHS \
+  "Generates binary token code in-process instead of with a C compiler"
+/**  Long help text */
+#define Asc_SimBinTokenSetJITOptionsHL "\
+ *  Makes the next compilations of binary token relations generate native\n\
+ *  code in-process (no C compiler or build files needed) instead of using\n\
+ *  the options of sim_BinTokenSetOptions, until that is called again.\n\
+ *  cachefile keeps the generated code between runs (\"\" for none).\n\
+ *  maxrels is as for sim_BinTokenSetOptions. Returns 1 if native code\n\
+ *  cannot be generated on this platform, in which case binary tokens are\n\
+ *  turned off, else 0.\n"
+
 #endif  /* ASCTK_SIMSPROC_H */
 
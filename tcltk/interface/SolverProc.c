@@ -2210,18 +2210,20 @@ int Asc_SolvImportQlfdid(ClientData cdata, Tcl_Interp *interp
   }
 
   if(argc == 2){ /*not just testing */
-    /* Here we will check to see if we really need to do
-        all of this work by:
-        1) Checking if the potential and current instance pointers are equal
-        2) Checking a global counter to see if the compiler has been called
+    /* If the instance is the one we already have a system for, bring that
+       system up to date with whatever METHODs (or the compiler) have done
+       to the instance tree since, rather than building it all again.
     */
-    if (g_solvsys_cur == NULL) {
-      g_compiler_counter = 1; /* initialize compiler counter */
-    }
-    if (g_solvinst_cur == solvinst_pot && g_compiler_counter == 0
-        && g_solvinst_cur != NULL) {
+    if (g_solvinst_cur == solvinst_pot && g_solvinst_cur != NULL
+        && g_solvsys_cur != NULL) {
       prevs = slv_get_selected_solver(g_solvsys_cur);
-      CONSOLE_DEBUG("...");
+      g_solvsys_cur = system_rebuild(g_solvsys_cur);
+      if( g_solvsys_cur == NULL ) {
+        FPRINTF(ASCERR,"system_rebuild returned NULL.\n");
+        Tcl_SetResult(interp, "Bad relations found: solve system not created.",
+                      TCL_STATIC);
+        return TCL_ERROR;
+      }
       slv_select_solver(g_solvsys_cur,prevs);
       Tcl_SetResult(interp, "Solver instance created.", TCL_STATIC);
 #if SP_DEBUG
@@ -2260,7 +2262,6 @@ int Asc_SolvImportQlfdid(ClientData cdata, Tcl_Interp *interp
 	CONSOLE_DEBUG("...");
     slv_select_solver(g_solvsys_cur,prevs);
     Tcl_SetResult(interp, "Solver instance created.", TCL_STATIC);
-    g_compiler_counter = 0;  /* set counter to 0 after full import */
   } else {
     Tcl_SetResult(interp, "0", TCL_STATIC);
   }
@@ -43,6 +43,7 @@ proc set_Library_Defaults {} {
   # in the file selection box on repeated calls.
 
   set ascLibrVect(compileC) 0
+  set ascLibrVect(compileJIT) 0
   set ascLibrVect(btuifstop) 1
   set ascLibrVect(ignorestop) 0
   set ascLibrVect(parserWarnings) 1
@@ -165,6 +166,16 @@ proc Sims_SetupBinTokenCC {} {
     }
    ;# done first time only
   }
+  if {$ascLibrVect(compileJIT)} {
+   # native code generated in-process: no build files or C compiler needed,
+   # and the code is kept in one file from run to run.
+    set cachename \
+      [file nativename $ascUtilVect(asctmp)/asc[ascwhoami]bt.jit]
+    if {[sim_BinTokenSetJITOptions $cachename $ascLibrVect(btmaxrel)]} {
+      puts "In-process (JIT) binary generation is not available here."
+    }
+    return
+  }
   incr ascLibrVect(g_uid)
   set srcname $ascLibrVect(bttarg)$ascLibrVect(g_uid).c
   set objname $ascLibrVect(bttarg)$ascLibrVect(g_uid).o
@@ -730,6 +730,7 @@ proc Set_View_Option_Values {} {
   set ascLibrVect(controloptions) [list \
     ignorestop \
     compileC \
+    compileJIT \
     compilerWarnings \
     parserWarnings \
     simplifyRelations \
@@ -420,6 +420,11 @@ proc ShowWindow.library { args} {
     -label {Generate C binary} \
     -accelerator {Alt-o b} \
     -underline 11
+  .library.menubar.option add checkbutton \
+    -offvalue {0} \
+    -onvalue {1} \
+    -variable {ascLibrVect(compileJIT)} \
+    -label {Generate binary in-process (JIT)}
   .library.menubar.option add checkbutton \
     -offvalue {1} \
     -onvalue {0} \